@@ -63,6 +63,7 @@ export default function StudioScreen() {
   const [title, setTitle] = useState('')
   const [selectedVideo, setSelectedVideo] = useState<string | null>(null)
   const [selectedCategory, setSelectedCategory] = useState('Other')
+  const [hlsLadder, setHlsLadder] = useState(false) // Native: also encode a 1080p/720p/360p HLS ladder
   const categoryOptions = ['Music', 'Gaming', 'Tech', 'Education', 'Entertainment', 'Vlog', 'Other']
   const [filePath, setFilePath] = useState<string | null>(null) // Pear: actual file path
   const [fileSize, setFileSize] = useState<number>(0)
@@ -280,6 +281,7 @@ export default function StudioScreen() {
           description: '',
           category: selectedCategory,
           skipThumbnailGeneration: skipThumbnail,
+          hlsLadder,
         })
         videoId = result?.video?.id
         console.log('[Studio] Upload complete, videoId:', videoId, 'skippedThumbnail:', skipThumbnail)
@@ -316,6 +318,7 @@ export default function StudioScreen() {
       setThumbnailFilePath(null)
       setVideoDuration(null)
       setSelectedCategory('Other')
+      setHlsLadder(false)
       Alert.alert('Success', 'Video uploaded successfully!')
     } catch (err: any) {
       console.error('[Studio] Upload failed:', err)
@@ -492,6 +495,22 @@ export default function StudioScreen() {
               </View>
             </View>
 
+            {/* Multi-bitrate HLS ladder (native backend only) */}
+            {!isPear && (
+              <Pressable
+                onPress={() => setHlsLadder(!hlsLadder)}
+                className="flex-row items-center gap-3 bg-pear-bg-card rounded-lg p-4"
+              >
+                <Feather name={hlsLadder ? 'check-square' : 'square'} color={hlsLadder ? colors.primary : colors.textMuted} size={20} />
+                <View className="flex-1">
+                  <Text className="text-label text-pear-text">Encode streaming qualities</Text>
+                  <Text className="text-caption text-pear-text-muted mt-1">
+                    Adds 1080p/720p/360p versions for weak connections. Slow, and the app is less responsive while it runs.
+                  </Text>
+                </View>
+              </Pressable>
+            )}
+
             {/* Upload button or progress bar */}
             {uploading ? (
               <View className="gap-2">
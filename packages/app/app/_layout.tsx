@@ -238,9 +238,11 @@ export default function RootLayout() {
     try {
       const backendSource = require('../backend.bundle.js')
       const downloaderWorkerSource = require('../downloader-worker.bundle.js')
+      const codecProbeWorkerSource = require('../codec-probe-worker.bundle.js')
+      const hlsLadderWorkerSource = require('../hls-ladder-worker.bundle.js')
       console.log('[App] Backend bundle length:', backendSource?.length || 0)
       console.log('[App] Downloader worker bundle length:', downloaderWorkerSource?.length || 0)
-      await platformRPC.initPlatformRPC({ backendSource, downloaderWorkerSource })
+      await platformRPC.initPlatformRPC({ backendSource, downloaderWorkerSource, codecProbeWorkerSource, hlsLadderWorkerSource })
     } catch (err) {
       console.error('[App] Failed to initialize platform RPC:', err)
       setBackendError(err instanceof Error ? err.message : 'Failed to initialize backend')
@@ -0,0 +1,39 @@
+/**
+ * Codec Probe Worker
+ *
+ * Runs codec-probe.mjs candidate tests off the JS thread. Loads bare-ffmpeg,
+ * reports { type: 'ready' } (with error if it could not), then answers each
+ * { type: 'probe', kind, name } with { type: 'result', name, entry }.
+ */
+
+import Worker from 'bare-worker'
+import { probeCandidate } from './codec-probe.mjs'
+
+async function loadFfmpeg() {
+  if (typeof require === 'function') {
+    try {
+      const mod = require('bare-ffmpeg')
+      return mod?.default ?? mod
+    } catch {}
+  }
+  const mod = await import('bare-ffmpeg')
+  return mod?.default ?? mod
+}
+
+let ffmpeg = null
+
+Worker.parentPort.on('message', (msg) => {
+  if (msg?.type !== 'probe') {
+    console.warn('[CodecProbeWorker] Unknown message type:', msg?.type)
+    return
+  }
+  const entry = probeCandidate(ffmpeg, msg.kind, msg.name)
+  Worker.parentPort.postMessage({ type: 'result', name: msg.name, entry })
+})
+
+loadFfmpeg().then((mod) => {
+  ffmpeg = mod
+  Worker.parentPort.postMessage({ type: 'ready' })
+}, (err) => {
+  Worker.parentPort.postMessage({ type: 'ready', error: 'bare-ffmpeg unavailable: ' + (err?.message || err) })
+})
@@ -0,0 +1,528 @@
+/**
+ * Codec Capability Probe
+ *
+ * Tests every H.264/AAC encoder and hardware decoder candidate once, ranks
+ * the working ones by measured speed, and persists the table so later
+ * launches skip probing entirely. hls-transcoder consults the table instead
+ * of opening CodecContexts on every session.
+ *
+ * The table is keyed by platform/arch, OS release (driver updates ship with
+ * it on Android/iOS/macOS) and the FFmpeg library version, so an OS or
+ * bare-ffmpeg update triggers a fresh probe. Candidates that failed are
+ * probed again after FAILED_RETRY_MS, as a hardware codec can be busy or
+ * missing a driver for a while without being broken for good.
+ *
+ * Candidates are tested on a worker thread (codec-probe-worker.mjs), one at
+ * a time, so opening encoders and test-encoding never blocks the JS thread.
+ *
+ * Crash safety: broken hardware drivers can take the process down while an
+ * encoder is opened, worker thread or not. Before each candidate is tested
+ * its name is written to the cache as "pending"; if we find a pending entry
+ * on the next launch that candidate is recorded as crashed and not tried
+ * again until FAILED_RETRY_MS has passed.
+ */
+
+import fs from 'bare-fs'
+import path from 'bare-path'
+import os from 'bare-os'
+import Worker from 'bare-worker'
+
+const CACHE_FILE = 'codec-capabilities.json'
+const CACHE_VERSION = 1
+
+// Failed and crashed candidates are probed again after this long
+const FAILED_RETRY_MS = 7 * 24 * 60 * 60 * 1000
+
+// Synthetic probe input: frames at a realistic size so setup costs and
+// encoder speed are representative (hardware encoders often reject tiny
+// frames or run them at unrepresentative speed)
+const PROBE_WIDTH = 256
+const PROBE_HEIGHT = 256
+const PROBE_VIDEO_FRAMES = 8
+const PROBE_AUDIO_FRAMES = 4
+const AAC_FRAME_SIZE = 1024
+
+export const H264_ENCODER_CANDIDATES = ['h264_mediacodec', 'h264_videotoolbox', 'libx264', 'h264']
+export const AAC_ENCODER_CANDIDATES = ['aac', 'libfdk_aac', 'libvo_aacenc']
+export const DECODER_CANDIDATES = [
+  'h264_mediacodec', 'h264_videotoolbox', 'h264',
+  'hevc_mediacodec', 'hevc_videotoolbox', 'hevc'
+]
+
+const HW_CODECS = new Set([
+  'h264_mediacodec', 'h264_videotoolbox',
+  'hevc_mediacodec', 'hevc_videotoolbox'
+])
+
+const WORKER_PATHS = [
+  './codec-probe-worker.mjs',             // Source file (dev)
+  './codec-probe-worker.bundle.js',       // Bundled worker (same dir)
+  '../codec-probe-worker.bundle.js',      // Bundled worker (parent dir)
+  '../../codec-probe-worker.bundle.js',   // Bundled worker (grandparent dir)
+  '/codec-probe-worker.bundle.js'         // Bundled worker (root)
+]
+
+// Startup of a worker, including loading bare-ffmpeg in it
+const WORKER_START_TIMEOUT_MS = 30000
+
+// Probe state (once per process)
+let capabilities = null
+let probePromise = null
+
+/**
+ * Get the capability table if it has been loaded or probed
+ * @returns {{key: string, probedAt: number, h264: Array, aac: Array, decoders: Array}|null}
+ */
+export function getCodecCapabilities() {
+  return capabilities
+}
+
+/**
+ * Use a table probed on another thread (the HLS ladder worker gets the
+ * main thread's instead of probing again)
+ * @param {Object|null} table
+ */
+export function setCodecCapabilities(table) {
+  if (table && !capabilities) capabilities = table
+}
+
+/**
+ * Order candidate names by the probed table: working codecs only, hardware
+ * first (unless preferSoftware), then fastest first. Names missing from the
+ * table keep their original relative order after the ranked ones.
+ *
+ * @param {Array} entries - Probe entries for one codec kind
+ * @param {string[]} candidates - Names in default preference order
+ * @param {boolean} [preferSoftware]
+ * @returns {string[]}
+ */
+export function rankCandidates(entries, candidates, preferSoftware = false) {
+  const byName = new Map(entries.map((e) => [e.name, e]))
+  const ranked = candidates
+    .filter((name) => byName.get(name)?.ok)
+    .sort((a, b) => {
+      const ea = byName.get(a)
+      const eb = byName.get(b)
+      if (ea.isHardware !== eb.isHardware) {
+        const hardwareFirst = ea.isHardware ? -1 : 1
+        return preferSoftware ? -hardwareFirst : hardwareFirst
+      }
+      return (eb.fps || 0) - (ea.fps || 0)
+    })
+  const unknown = candidates.filter((name) => !byName.has(name))
+  return [...ranked, ...unknown]
+}
+
+/**
+ * Load the persisted table or run the probe (once per process).
+ *
+ * @param {Object} ffmpeg - Loaded bare-ffmpeg module
+ * @param {Object} opts
+ * @param {string} opts.cacheDir - Directory for codec-capabilities.json
+ * @returns {Promise<Object|null>}
+ */
+export function ensureCodecCapabilities(ffmpeg, opts = {}) {
+  if (capabilities) return Promise.resolve(capabilities)
+  if (probePromise) return probePromise
+
+  probePromise = (async () => {
+    try {
+      capabilities = await loadOrProbe(ffmpeg, opts.cacheDir)
+    } catch (err) {
+      console.warn('[CodecProbe] Probe failed:', err?.message || err)
+      capabilities = null
+    }
+    return capabilities
+  })()
+
+  return probePromise
+}
+
+function capabilityKey(ffmpeg) {
+  let release = 'unknown'
+  try { release = os.release?.() || release } catch {}
+
+  let libVersion = 'unknown'
+  try {
+    libVersion = ffmpeg.versions?.avcodec || ffmpeg.version || libVersion
+  } catch {}
+  if (libVersion === 'unknown' && typeof require === 'function') {
+    try {
+      libVersion = 'bare-ffmpeg@' + (require('bare-ffmpeg/package').version || 'unknown')
+    } catch {}
+  }
+
+  return `${os.platform()}-${os.arch()}|${release}|${libVersion}`
+}
+
+function readCache(file) {
+  try {
+    const data = JSON.parse(fs.readFileSync(file, 'utf-8'))
+    if (data?.version === CACHE_VERSION && data.entries) return data
+  } catch {}
+  return { version: CACHE_VERSION, entries: {}, pending: null }
+}
+
+function writeCache(file, cache) {
+  try {
+    fs.writeFileSync(file, JSON.stringify(cache))
+  } catch (err) {
+    console.warn('[CodecProbe] Could not persist capability table:', err?.message)
+  }
+}
+
+/**
+ * Start the probe worker from the first path that loads
+ * @returns {Promise<Worker>}
+ */
+async function startProbeWorker() {
+  // On mobile the bundles are written next to the downloader worker
+  const paths = [...WORKER_PATHS]
+  const downloaderPath = globalThis.__PEARTUBE_WORKER_PATH__
+  if (typeof downloaderPath === 'string' && downloaderPath.includes('/')) {
+    paths.unshift(downloaderPath.slice(0, downloaderPath.lastIndexOf('/') + 1) + 'codec-probe-worker.bundle.js')
+  }
+
+  let lastError = null
+  for (const spec of paths) {
+    try {
+      return await spawnProbeWorker(spec.startsWith('/') ? new URL(`file://${spec}`) : new URL(spec, import.meta.url))
+    } catch (err) {
+      lastError = err
+    }
+  }
+  throw lastError || new Error('Probe worker not found')
+}
+
+function spawnProbeWorker(spec) {
+  return new Promise((resolve, reject) => {
+    let worker
+    try {
+      worker = new Worker(spec)
+    } catch (err) {
+      reject(err)
+      return
+    }
+
+    const fail = (err) => {
+      clearTimeout(timeout)
+      try { worker.terminate() } catch {}
+      reject(err)
+    }
+    const timeout = setTimeout(() => fail(new Error('Probe worker start timeout')), WORKER_START_TIMEOUT_MS)
+
+    worker.once('error', fail)
+    worker.once('message', (msg) => {
+      if (msg?.type !== 'ready') return fail(new Error('Unexpected probe worker message'))
+      if (msg.error) return fail(new Error(msg.error))
+      clearTimeout(timeout)
+      worker.off('error', fail)
+      resolve(worker)
+    })
+  })
+}
+
+/**
+ * Test one candidate on the worker
+ * @param {Worker} worker
+ * @param {'h264'|'aac'|'decoders'} kind
+ * @param {string} name
+ * @returns {Promise<Object>} probe entry
+ */
+function probeOnWorker(worker, kind, name) {
+  return new Promise((resolve, reject) => {
+    const cleanup = () => {
+      worker.off('message', onMessage)
+      worker.off('error', onError)
+      worker.off('exit', onExit)
+    }
+    const onMessage = (msg) => {
+      if (msg?.type !== 'result' || msg.name !== name) return
+      cleanup()
+      resolve(msg.entry)
+    }
+    const onError = (err) => {
+      cleanup()
+      reject(err)
+    }
+    const onExit = () => {
+      cleanup()
+      reject(new Error('Probe worker exited'))
+    }
+
+    worker.on('message', onMessage)
+    worker.on('error', onError)
+    worker.on('exit', onExit)
+    worker.postMessage({ type: 'probe', kind, name })
+  })
+}
+
+/**
+ * Test one candidate in this thread; used by the probe worker
+ * @param {Object} ffmpeg - Loaded bare-ffmpeg module
+ * @param {'h264'|'aac'|'decoders'} kind
+ * @param {string} name
+ * @returns {Object} probe entry
+ */
+export function probeCandidate(ffmpeg, kind, name) {
+  try {
+    if (kind === 'h264') return probeVideoEncoder(ffmpeg, name)
+    if (kind === 'aac') return probeAudioEncoder(ffmpeg, name)
+    return probeDecoder(ffmpeg, name)
+  } catch (err) {
+    return { name, ok: false, error: err?.message || String(err), isHardware: HW_CODECS.has(name) }
+  }
+}
+
+async function loadOrProbe(ffmpeg, cacheDir) {
+  const key = capabilityKey(ffmpeg)
+  const file = cacheDir ? path.join(cacheDir, CACHE_FILE) : null
+  const cache = file ? readCache(file) : { version: CACHE_VERSION, entries: {}, pending: null }
+
+  // A pending marker for our key means the previous probe died on it
+  const crashed = new Set()
+  if (cache.pending?.key === key && cache.pending.name) {
+    console.warn('[CodecProbe] Previous probe crashed on', cache.pending.name, '- marking unusable')
+    crashed.add(cache.pending.name)
+    for (const name of cache.pending.crashed || []) crashed.add(name)
+  }
+
+  // Working entries are kept; failed ones until FAILED_RETRY_MS has passed.
+  // Entries from before per-entry timestamps use the table's.
+  const previous = cache.entries[key]
+  const now = Date.now()
+  const reusable = (kind, name) => {
+    const entry = previous?.[kind]?.find((e) => e.name === name)
+    if (!entry) return null
+    if (entry.ok || now - (entry.probedAt || previous.probedAt || 0) < FAILED_RETRY_MS) return entry
+    return null
+  }
+
+  const kinds = [['h264', H264_ENCODER_CANDIDATES], ['aac', AAC_ENCODER_CANDIDATES], ['decoders', DECODER_CANDIDATES]]
+  const stale = kinds.some(([kind, names]) => names.some((name) => crashed.has(name) || !reusable(kind, name)))
+  if (previous && !stale) {
+    console.log('[CodecProbe] Loaded capability table for', key)
+    return previous
+  }
+
+  const start = Date.now()
+  const table = { key, probedAt: now, h264: [], aac: [], decoders: [] }
+  let worker = null
+  let probed = 0
+
+  try {
+    for (const [kind, names] of kinds) {
+      for (const name of names) {
+        const kept = crashed.has(name) ? null : reusable(kind, name)
+        if (kept) {
+          table[kind].push(kept)
+          continue
+        }
+        if (crashed.has(name)) {
+          table[kind].push({ name, ok: false, crashed: true, isHardware: HW_CODECS.has(name), probedAt: now })
+          continue
+        }
+
+        if (file) {
+          cache.pending = { key, name, crashed: [...crashed] }
+          writeCache(file, cache)
+        }
+
+        if (!worker) {
+          try {
+            worker = await startProbeWorker()
+          } catch (err) {
+            // No worker thread here: keep what we had rather than probe on
+            // the JS thread
+            console.warn('[CodecProbe] Probe worker unavailable:', err?.message || err)
+            if (file) {
+              cache.pending = null
+              writeCache(file, cache)
+            }
+            return previous || null
+          }
+        }
+
+        let entry
+        try {
+          entry = await probeOnWorker(worker, kind, name)
+        } catch (err) {
+          // Worker gone: this candidate is unknown, not broken, so leave it
+          // out and let rankCandidates keep its default position; the next
+          // candidate gets a fresh worker
+          console.warn('[CodecProbe] Could not probe', name + ':', err?.message || err)
+          if (worker) {
+            try { worker.terminate() } catch {}
+            worker = null
+          }
+          continue
+        }
+        entry.probedAt = Date.now()
+        table[kind].push(entry)
+        probed++
+      }
+    }
+  } finally {
+    if (worker) {
+      try { worker.terminate() } catch {}
+    }
+  }
+
+  if (file) {
+    cache.pending = null
+    cache.entries[key] = table
+    writeCache(file, cache)
+  }
+
+  const summary = (entries) => entries.filter((e) => e.ok).map((e) => e.name + (e.fps ? `@${Math.round(e.fps)}fps` : '')).join(', ') || 'none'
+  console.log('[CodecProbe] Probed', probed, 'candidates in', (Date.now() - start) + 'ms -',
+    'h264:', summary(table.h264), '| aac:', summary(table.aac), '| decoders:', summary(table.decoders))
+
+  return table
+}
+
+function probeVideoEncoder(ffmpeg, name) {
+  const isHardware = HW_CODECS.has(name)
+  const encoder = ffmpeg.findEncoderByName?.(name)
+  if (!encoder || !encoder._handle) return { name, ok: false, isHardware, error: 'not built' }
+
+  const pixelFormat = isHardware ? ffmpeg.constants.pixelFormats.NV12 : ffmpeg.constants.pixelFormats.YUV420P
+
+  let ctx = null
+  let frame = null
+  let packet = null
+  try {
+    ctx = new ffmpeg.CodecContext(encoder)
+    ctx.width = PROBE_WIDTH
+    ctx.height = PROBE_HEIGHT
+    ctx.pixelFormat = pixelFormat
+    ctx.timeBase = { numerator: 1, denominator: 25 }
+    ctx.bitRate = 100000
+    ctx.gopSize = 12
+    ctx.maxBFrames = 0
+    if (!isHardware) {
+      try { ctx.setOption('preset', 'ultrafast') } catch {}
+    }
+
+    const openStart = Date.now()
+    ctx.open()
+    const openMs = Date.now() - openStart
+
+    frame = new ffmpeg.Frame()
+    frame.width = PROBE_WIDTH
+    frame.height = PROBE_HEIGHT
+    frame.format = pixelFormat
+    frame.alloc()
+    packet = new ffmpeg.Packet()
+
+    let packets = 0
+    const encodeStart = Date.now()
+    for (let i = 0; i < PROBE_VIDEO_FRAMES; i++) {
+      frame.pts = i
+      if (ctx.sendFrame(frame)) {
+        while (ctx.receivePacket(packet)) {
+          packets++
+          packet.unref?.()
+        }
+      }
+    }
+    ctx.sendFrame(null)
+    while (ctx.receivePacket(packet)) {
+      packets++
+      packet.unref?.()
+    }
+    const encodeMs = Date.now() - encodeStart
+
+    return {
+      name,
+      ok: packets > 0,
+      isHardware,
+      openMs,
+      encodeMs,
+      fps: PROBE_VIDEO_FRAMES / Math.max(encodeMs, 1) * 1000,
+      error: packets > 0 ? undefined : 'no packets produced'
+    }
+  } finally {
+    if (packet) { try { packet.destroy() } catch {} }
+    if (frame) { try { frame.destroy() } catch {} }
+    if (ctx) { try { ctx.destroy() } catch {} }
+  }
+}
+
+function probeAudioEncoder(ffmpeg, name) {
+  const encoder = ffmpeg.findEncoderByName?.(name)
+  if (!encoder || !encoder._handle) return { name, ok: false, isHardware: false, error: 'not built' }
+
+  let ctx = null
+  let frame = null
+  let packet = null
+  try {
+    ctx = new ffmpeg.CodecContext(encoder)
+    ctx.sampleRate = 48000
+    ctx.sampleFormat = ffmpeg.constants.sampleFormats.FLTP
+    ctx.timeBase = { numerator: 1, denominator: 48000 }
+    ctx.channelLayout = ffmpeg.constants.channelLayouts.STEREO
+
+    const openStart = Date.now()
+    ctx.open()
+    const openMs = Date.now() - openStart
+
+    frame = new ffmpeg.Frame()
+    frame.format = ctx.sampleFormat
+    frame.channelLayout = ffmpeg.constants.channelLayouts.STEREO
+    frame.sampleRate = 48000
+    frame.nbSamples = AAC_FRAME_SIZE
+    frame.alloc()
+    packet = new ffmpeg.Packet()
+
+    let packets = 0
+    const encodeStart = Date.now()
+    for (let i = 0; i < PROBE_AUDIO_FRAMES; i++) {
+      frame.pts = i * AAC_FRAME_SIZE
+      if (ctx.sendFrame(frame)) {
+        while (ctx.receivePacket(packet)) {
+          packets++
+          packet.unref?.()
+        }
+      }
+    }
+    ctx.sendFrame(null)
+    while (ctx.receivePacket(packet)) {
+      packets++
+      packet.unref?.()
+    }
+    const encodeMs = Date.now() - encodeStart
+
+    return {
+      name,
+      ok: packets > 0,
+      isHardware: false,
+      openMs,
+      encodeMs,
+      fps: PROBE_AUDIO_FRAMES / Math.max(encodeMs, 1) * 1000,
+      error: packets > 0 ? undefined : 'no packets produced'
+    }
+  } finally {
+    if (packet) { try { packet.destroy() } catch {} }
+    if (frame) { try { frame.destroy() } catch {} }
+    if (ctx) { try { ctx.destroy() } catch {} }
+  }
+}
+
+function probeDecoder(ffmpeg, name) {
+  const isHardware = HW_CODECS.has(name)
+  const decoder = ffmpeg.findDecoderByName?.(name)
+  if (!decoder || !decoder._handle) return { name, ok: false, isHardware, error: 'not built' }
+
+  let ctx = null
+  try {
+    ctx = new ffmpeg.CodecContext(decoder)
+    ctx.width = PROBE_WIDTH
+    ctx.height = PROBE_HEIGHT
+    const openStart = Date.now()
+    ctx.open()
+    return { name, ok: true, isHardware, openMs: Date.now() - openStart }
+  } finally {
+    if (ctx) { try { ctx.destroy() } catch {} }
+  }
+}
@@ -0,0 +1,60 @@
+/**
+ * HLS Ladder Worker
+ *
+ * Runs hls-ladder.mjs generateHlsLadder() off the JS thread. Loads
+ * bare-ffmpeg, reports { type: 'ready' } (with error if it could not), then
+ * on { type: 'start', fd, renditions, capabilities } encodes from the fd.
+ * Each blob is posted as { type: 'put', seq, data } and stored by the main
+ * thread, which answers { type: 'stored', seq, blobId } (or error). Ends
+ * with { type: 'result', ladder } or { type: 'error', error }.
+ */
+
+import Worker from 'bare-worker'
+import { generateHlsLadder } from './hls-ladder.mjs'
+import { loadBareFfmpeg } from './hls-transcoder.mjs'
+import { setCodecCapabilities } from './codec-probe.mjs'
+
+let seq = 0
+const waiting = new Map()
+
+function put(data) {
+  return new Promise((resolve, reject) => {
+    const id = ++seq
+    waiting.set(id, { resolve, reject })
+    Worker.parentPort.postMessage({ type: 'put', seq: id, data })
+  })
+}
+
+async function run(msg) {
+  setCodecCapabilities(msg.capabilities)
+  try {
+    const ladder = await generateHlsLadder(msg.fd, {
+      put,
+      renditions: msg.renditions,
+      onProgress: (progress) => Worker.parentPort.postMessage({ type: 'progress', progress })
+    })
+    Worker.parentPort.postMessage({ type: 'result', ladder })
+  } catch (err) {
+    Worker.parentPort.postMessage({ type: 'error', error: err?.message || String(err) })
+  }
+}
+
+Worker.parentPort.on('message', (msg) => {
+  if (msg?.type === 'stored') {
+    const entry = waiting.get(msg.seq)
+    if (!entry) return
+    waiting.delete(msg.seq)
+    if (msg.error) entry.reject(new Error(msg.error))
+    else entry.resolve(msg.blobId)
+  } else if (msg?.type === 'start') {
+    run(msg)
+  } else {
+    console.warn('[HlsLadderWorker] Unknown message type:', msg?.type)
+  }
+})
+
+loadBareFfmpeg().then((ok) => {
+  Worker.parentPort.postMessage(ok ? { type: 'ready' } : { type: 'ready', error: 'bare-ffmpeg unavailable' })
+}, (err) => {
+  Worker.parentPort.postMessage({ type: 'ready', error: 'bare-ffmpeg unavailable: ' + (err?.message || err) })
+})
@@ -0,0 +1,896 @@
+/**
+ * HLS Ladder Module
+ *
+ * Upload-time multi-bitrate HLS using bare-ffmpeg, so viewers on weak peers
+ * pick a rendition instead of pulling the original or transcoding on the fly.
+ *
+ * Architecture:
+ * - One demux + one video decode; every decoded frame is handed to each
+ *   rendition's Scaler and H.264 encoder (1080p/720p/360p by default)
+ * - Fixed GOP with scene-cut disabled, and keyframes forced on the same
+ *   SEGMENT_SECONDS grid of source timestamps, so all renditions (hardware
+ *   encoders included) put IDR frames on the same source frames and segment
+ *   boundaries line up
+ * - CODECS in the master playlist come from each rung's own SPS, so they
+ *   match what the encoder actually produced (hardware encoders run
+ *   constrained baseline, x264 high)
+ * - Audio is decoded and AAC-encoded once into its own audio-only rendition
+ *   that every variant references (EXT-X-MEDIA), instead of once per variant
+ * - Segments, media playlists and the master playlist are stored as blobs;
+ *   playlist URIs are blob ids, turned into URLs at playback time by
+ *   resolveLadderPlaylist()
+ * - Uploads encode on a worker thread (hls-ladder-worker.mjs) reading an fd
+ *   the caller holds open, so the encode never blocks the JS thread and the
+ *   source can't be removed under it; blobs are stored by the main thread
+ * - serveLadders() serves them from the HLS transcoder's HTTP server under
+ *   /ladder/{blobsCoreKey}/: m/ is the master, p/ a media playlist, s/ a
+ *   segment, with playlist URIs rewritten to relative paths so the same
+ *   playlists work for a cast receiver on the LAN
+ */
+
+import fs from 'bare-fs'
+import b4a from 'b4a'
+import Worker from 'bare-worker'
+
+import {
+  loadBareFfmpeg,
+  getFfmpeg,
+  selectH264Encoder,
+  selectAacEncoder,
+  addHttpRoute,
+  getHttpPort
+} from './hls-transcoder.mjs'
+import { getCodecCapabilities } from './codec-probe.mjs'
+
+// Renditions, largest first. Rungs that would upscale the source are dropped.
+export const DEFAULT_RENDITIONS = [
+  { name: '1080p', height: 1080, bitRate: 5000000 },
+  { name: '720p', height: 720, bitRate: 2800000 },
+  { name: '360p', height: 360, bitRate: 800000 }
+]
+
+const SEGMENT_SECONDS = 4
+const AUDIO_BITRATE = 128000
+const AUDIO_SAMPLE_RATE = 48000
+const AAC_FRAME_SIZE = 1024
+const AUDIO_CODECS = 'mp4a.40.2'
+
+const PICTURE_TYPE_NONE = 0
+const PICTURE_TYPE_I = 1
+
+// H.264 levels (Table A-1): level_idc, max frame size and max rate in macroblocks
+const H264_LEVELS = [
+  [30, 1620, 40500],
+  [31, 3600, 108000],
+  [32, 5120, 216000],
+  [40, 8192, 245760],
+  [42, 8704, 522240],
+  [50, 22080, 589824],
+  [51, 36864, 983040],
+  [52, 36864, 2073600]
+]
+
+const MPEGTS_TIME_BASE = { numerator: 1, denominator: 90000 }
+const ENCODER_TIME_BASE = { numerator: 1, denominator: 1000 }
+
+// Yield to the event loop every N demuxed packets so put() replies (and
+// uploads/RPC when encoding on the JS thread) stay live
+const YIELD_EVERY_PACKETS = 50
+
+const WORKER_PATHS = [
+  './hls-ladder-worker.mjs',             // Source file (dev)
+  './hls-ladder-worker.bundle.js',       // Bundled worker (same dir)
+  '../hls-ladder-worker.bundle.js',      // Bundled worker (parent dir)
+  '../../hls-ladder-worker.bundle.js',   // Bundled worker (grandparent dir)
+  '/hls-ladder-worker.bundle.js'         // Bundled worker (root)
+]
+
+// Startup of the worker, including loading bare-ffmpeg in it
+const WORKER_START_TIMEOUT_MS = 30000
+
+/**
+ * Pick the renditions for a source size. Each rung is a 16:9 bounding box
+ * (1280x720 for 720p, 720x1280 for portrait) the source is fitted into, so
+ * portrait and scope sources keep their aspect ratio. Rungs that would upscale are dropped; a
+ * source smaller than every rung gets one rung at its own size. Sizes are
+ * rounded to even for 4:2:0.
+ *
+ * @param {number} width - Source width
+ * @param {number} height - Source height
+ * @param {Array<{name: string, height: number, bitRate: number}>} [ladder]
+ * @returns {Array<{name: string, width: number, height: number, bitRate: number}>}
+ */
+export function planRenditions(width, height, ladder = DEFAULT_RENDITIONS) {
+  if (!width || !height) return []
+  const even = (n) => Math.max(2, Math.round(n / 2) * 2)
+
+  const long = Math.max(width, height)
+  const short = Math.min(width, height)
+
+  const rungs = []
+  for (const r of ladder) {
+    const scale = Math.min((r.height * 16) / 9 / long, r.height / short)
+    if (scale > 1) continue
+    rungs.push({ name: r.name, width: even(width * scale), height: even(height * scale), bitRate: r.bitRate })
+  }
+
+  if (rungs.length === 0 && ladder.length > 0) {
+    const smallest = ladder[ladder.length - 1]
+    rungs.push({ name: `${even(short)}p`, width: even(width), height: even(height), bitRate: smallest.bitRate })
+  }
+  return rungs
+}
+
+function avc1(profile, constraints, level) {
+  const hex = (n) => n.toString(16).padStart(2, '0').toUpperCase()
+  return `avc1.${hex(profile)}${hex(constraints)}${hex(level)}`
+}
+
+/**
+ * RFC 6381 codec string (avc1.PPCCLL) from the SPS in H.264 extradata
+ * (avcC) or an Annex B packet.
+ * @param {Uint8Array} data
+ * @returns {string|null}
+ */
+export function avcCodecString(data) {
+  if (!data || data.length < 4) return null
+  if (data[0] === 1) return avc1(data[1], data[2], data[3])
+  for (let i = 0; i + 6 < data.length; i++) {
+    if (data[i] === 0 && data[i + 1] === 0 && data[i + 2] === 1 && (data[i + 3] & 0x1f) === 7) {
+      return avc1(data[i + 4], data[i + 5], data[i + 6])
+    }
+  }
+  return null
+}
+
+/**
+ * Codec string for the profile we ask an encoder for and the lowest level
+ * that fits the rung, for when its SPS could not be read.
+ * @param {boolean} isHardware - Constrained baseline, else high
+ * @param {{width: number, height: number}} rendition
+ * @param {number} fps
+ */
+export function expectedAvcCodecString(isHardware, rendition, fps) {
+  const frameMbs = Math.ceil(rendition.width / 16) * Math.ceil(rendition.height / 16)
+  const level = H264_LEVELS.find(([, maxFs, maxMbps]) => frameMbs <= maxFs && frameMbs * fps <= maxMbps) || H264_LEVELS[H264_LEVELS.length - 1]
+  return isHardware ? avc1(0x42, 0xe0, level[0]) : avc1(0x64, 0x00, level[0])
+}
+
+/**
+ * VOD media playlist for one rendition.
+ * @param {Array<{duration: number, uri: string}>} segments
+ */
+export function buildMediaPlaylist(segments) {
+  const target = Math.max(1, ...segments.map((s) => Math.ceil(s.duration)))
+  const lines = [
+    '#EXTM3U',
+    '#EXT-X-VERSION:3',
+    `#EXT-X-TARGETDURATION:${target}`,
+    '#EXT-X-MEDIA-SEQUENCE:0',
+    '#EXT-X-PLAYLIST-TYPE:VOD',
+    '#EXT-X-INDEPENDENT-SEGMENTS'
+  ]
+  for (const segment of segments) {
+    lines.push(`#EXTINF:${segment.duration.toFixed(3)},`)
+    lines.push(segment.uri)
+  }
+  lines.push('#EXT-X-ENDLIST')
+  return lines.join('\n') + '\n'
+}
+
+/**
+ * Master playlist over the video variants and the optional shared audio.
+ * CODECS is left out of a variant whose video codec string is unknown.
+ * @param {Array<{width: number, height: number, bandwidth: number, codecs?: string, uri: string}>} variants
+ * @param {{uri: string}|null} audio
+ */
+export function buildMasterPlaylist(variants, audio) {
+  const lines = ['#EXTM3U', '#EXT-X-VERSION:3', '#EXT-X-INDEPENDENT-SEGMENTS']
+  if (audio) {
+    lines.push(`#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID="aac",NAME="Audio",DEFAULT=YES,AUTOSELECT=YES,URI="${audio.uri}"`)
+  }
+  for (const v of variants) {
+    const bandwidth = v.bandwidth + (audio ? AUDIO_BITRATE : 0)
+    let info = `#EXT-X-STREAM-INF:BANDWIDTH=${bandwidth},RESOLUTION=${v.width}x${v.height}`
+    if (v.codecs) info += `,CODECS="${audio ? v.codecs + ',' + AUDIO_CODECS : v.codecs}"`
+    if (audio) info += ',AUDIO="aac"'
+    lines.push(info)
+    lines.push(v.uri)
+  }
+  return lines.join('\n') + '\n'
+}
+
+/**
+ * Rewrite the blob-id URIs of a stored ladder playlist (master or media)
+ * into playable URLs.
+ * @param {string} text - Playlist text
+ * @param {(blobId: string) => string} toUrl
+ */
+export function resolveLadderPlaylist(text, toUrl) {
+  return text
+    .split('\n')
+    .map((line) => {
+      if (!line) return line
+      if (line.startsWith('#')) {
+        return line.replace(/URI="([^"]+)"/, (_, id) => `URI="${toUrl(id)}"`)
+      }
+      return toUrl(line)
+    })
+    .join('\n')
+}
+
+const LADDER_PATH = /^\/ladder\/([0-9a-f]{64})\/([mps])\/(\d+:\d+:\d+:\d+)\.(m3u8|ts)$/
+
+/**
+ * Serve stored ladders from the HLS server
+ * @param {(coreKeyHex: string, blobId: string) => Promise<Uint8Array|null>} getBlob
+ */
+export function serveLadders(getBlob) {
+  addHttpRoute('/ladder/', async (req, res) => {
+    const match = (req.url || '').split('?')[0].match(LADDER_PATH)
+    if (!match) {
+      res.statusCode = 404
+      res.end('Not found')
+      return
+    }
+    const [, coreKey, kind, blobId] = match
+
+    let data
+    try {
+      data = await getBlob(coreKey, blobId)
+    } catch (err) {
+      console.warn('[HlsLadder] Blob unavailable:', coreKey.slice(0, 16), blobId, err?.message)
+    }
+    if (!data) {
+      res.statusCode = 404
+      res.end('Blob not found')
+      return
+    }
+
+    if (kind !== 's') {
+      // Master URIs point at media playlists, media playlist URIs at segments
+      const prefix = kind === 'm' ? '../p/' : '../s/'
+      const suffix = kind === 'm' ? '.m3u8' : '.ts'
+      const text = resolveLadderPlaylist(b4a.toString(data), (id) => prefix + id + suffix)
+      data = b4a.from(text)
+    }
+
+    // Blobs are immutable, so everything here can be cached
+    res.statusCode = 200
+    res.setHeader('Content-Type', kind === 's' ? 'video/mp2t' : 'application/vnd.apple.mpegurl')
+    res.setHeader('Content-Length', data.length)
+    res.setHeader('Cache-Control', 'max-age=3600')
+    if ((req.method || '').toUpperCase() === 'HEAD') res.end()
+    else res.end(data)
+  })
+}
+
+/**
+ * URL of a stored ladder's master playlist
+ * @param {string} coreKeyHex - Blobs core holding the ladder
+ * @param {string} masterBlobId
+ * @returns {Promise<string>}
+ */
+export async function getLadderUrl(coreKeyHex, masterBlobId) {
+  const port = await getHttpPort()
+  return `http://127.0.0.1:${port}/ladder/${coreKeyHex}/m/${masterBlobId}.m3u8`
+}
+
+/**
+ * Synchronous file-backed IOContext for the source. A path is opened and
+ * closed here; an fd belongs to the caller and is left open.
+ */
+function openFileIO(ffmpeg, file) {
+  const owned = typeof file !== 'number'
+  const fd = owned ? fs.openSync(file, 'r') : file
+  const size = fs.fstatSync(fd).size
+  let pos = 0
+
+  const io = new ffmpeg.IOContext(256 * 1024, {
+    onread: (buffer) => {
+      if (pos >= size) return 0
+      const n = fs.readSync(fd, buffer, 0, Math.min(buffer.length, size - pos), pos)
+      pos += n
+      return n
+    },
+    onseek: (offset, whence) => {
+      const SEEK_CUR = 1
+      const SEEK_END = 2
+      const AVSEEK_SIZE = 0x10000
+      if (whence === AVSEEK_SIZE) return size
+      if (whence === SEEK_CUR) pos += offset
+      else if (whence === SEEK_END) pos = size + offset
+      else pos = offset
+      pos = Math.max(0, Math.min(pos, size))
+      return pos
+    }
+  })
+
+  return { io, size, close: () => { if (owned) { try { fs.closeSync(fd) } catch {} } } }
+}
+
+/**
+ * One MPEGTS muxer per output. Segments are cut by flushing the muxer and
+ * taking what it wrote since the last cut, like the live transcoder's
+ * continuous muxer.
+ */
+function createSegmentMuxer(ffmpeg, configureStream) {
+  let chunks = []
+  const io = new ffmpeg.IOContext(1024 * 1024, {
+    onwrite: (data) => {
+      chunks.push(Buffer.from(data))
+      return data.length
+    },
+    onseek: () => 0
+  })
+
+  const format = new ffmpeg.OutputFormatContext('mpegts', io)
+  const stream = format.createStream()
+  configureStream(stream)
+  stream.timeBase = MPEGTS_TIME_BASE
+
+  format.writeHeader(ffmpeg.Dictionary.from({
+    'mpegts_flags': 'pat_pmt_at_frames',
+    'pcr_period': '20'
+  }))
+
+  return {
+    format,
+    stream,
+    take() {
+      const data = Buffer.concat(chunks)
+      chunks = []
+      return data
+    }
+  }
+}
+
+function openVideoEncoder(ffmpeg, selection, rendition, frameRate, gop) {
+  const enc = new ffmpeg.CodecContext(selection.encoder)
+  enc.width = rendition.width
+  enc.height = rendition.height
+  enc.pixelFormat = selection.pixelFormat
+  enc.timeBase = ENCODER_TIME_BASE
+  enc.bitRate = rendition.bitRate
+  enc.gopSize = gop
+  enc.maxBFrames = 0
+  try { enc.frameRate = frameRate } catch {}
+
+  // Same keyframe cadence on every rung: fixed closed GOP, no scene-cut
+  // IDRs. Hardware encoders ignore some of these, so keyframes are also
+  // forced per frame (see the encode loop).
+  const options = selection.isHardware
+    ? [
+        ['bf', '0'],
+        ['profile', 'constrained_baseline'],
+        ['b', String(rendition.bitRate)],
+        ['g', String(gop)],
+        ['keyint_min', String(gop)],
+        ['sc_threshold', '0'],
+        ['flags', '+cgop'],
+        ['i-frame-interval', String(SEGMENT_SECONDS)]
+      ]
+    : [
+        ['preset', 'veryfast'],
+        ['profile', 'high'],
+        ['bf', '0'],
+        ['g', String(gop)],
+        ['keyint_min', String(gop)],
+        ['sc_threshold', '0'],
+        ['maxrate', String(Math.round(rendition.bitRate * 1.5))],
+        ['bufsize', String(rendition.bitRate * 2)],
+        ['x264-params', 'repeat-headers=1:bframes=0:annexb=1:scenecut=0']
+      ]
+  for (const [key, value] of options) {
+    try { enc.setOption(key, value) } catch {}
+  }
+
+  enc.open()
+  return enc
+}
+
+function openAudioEncoder(ffmpeg) {
+  const selection = selectAacEncoder()
+  if (!selection) return null
+
+  const enc = new ffmpeg.CodecContext(selection.encoder)
+  enc.sampleRate = AUDIO_SAMPLE_RATE
+  enc.sampleFormat = ffmpeg.constants.sampleFormats.FLTP
+  enc.timeBase = { numerator: 1, denominator: AUDIO_SAMPLE_RATE }
+  enc.channelLayout = ffmpeg.constants.channelLayouts.STEREO
+  try { enc.setOption('b', String(AUDIO_BITRATE)) } catch {}
+  try { enc.setOption('profile', 'aac_low') } catch {}
+  enc.open()
+  return enc
+}
+
+/**
+ * Transcode a local file into an HLS ladder and store it. Encodes on the
+ * calling thread; uploads use runHlsLadderWorker() instead.
+ *
+ * @param {string|number} file - Source video on local disk, as a path or an open fd
+ * @param {Object} options
+ * @param {(data: Buffer) => Promise<string>} options.put - Store bytes, resolve to a blob id
+ * @param {Array} [options.renditions] - Ladder (see DEFAULT_RENDITIONS)
+ * @param {(progress: number) => void} [options.onProgress] - 0..100 by bytes demuxed
+ * @returns {Promise<{masterBlobId: string, renditions: Array<{name: string, width: number, height: number, bitRate: number, codecs: string, playlistBlobId: string, segments: number}>, audioPlaylistBlobId: string|null}|null>}
+ *   null when bare-ffmpeg or an H.264 encoder is unavailable, or the file has no video
+ */
+export async function generateHlsLadder(file, options = {}) {
+  const { put, renditions: ladder = DEFAULT_RENDITIONS, onProgress } = options
+  if (typeof put !== 'function') throw new Error('generateHlsLadder needs a put(data) callback')
+
+  if (!(await loadBareFfmpeg())) return null
+  const ffmpeg = getFfmpeg()
+  const h264 = selectH264Encoder(false)
+  if (!h264) return null
+
+  const source = openFileIO(ffmpeg, file)
+  let input = null
+  let videoDecoder = null
+  let audioDecoder = null
+  let audioEncoder = null
+  let resampler = null
+  let audioFifo = null
+  let packet = null
+  let frame = null
+  let audioFrame = null
+  let resampledFrame = null
+  let encoderFrame = null
+  let outPacket = null
+  const outputs = []
+  let audioOut = null
+
+  // Blob puts run behind the encode loop; awaited before playlists are built
+  const pending = []
+  const store = (out, data, duration) => {
+    if (data.length === 0 || duration <= 0) return
+    const index = out.segments.length
+    out.segments.push({ duration, uri: null })
+    pending.push(put(data).then((id) => { out.segments[index].uri = id }))
+  }
+
+  try {
+    input = new ffmpeg.InputFormatContext(source.io)
+    const videoStream = input.getBestStream(ffmpeg.constants.mediaTypes.VIDEO)
+    const audioStream = input.getBestStream(ffmpeg.constants.mediaTypes.AUDIO)
+    if (!videoStream) return null
+
+    const srcWidth = videoStream.codecParameters.width
+    const srcHeight = videoStream.codecParameters.height
+    const plan = planRenditions(srcWidth, srcHeight, ladder)
+    if (plan.length === 0) return null
+
+    videoDecoder = videoStream.decoder()
+    videoDecoder.timeBase = videoStream.timeBase
+    videoDecoder.open()
+
+    let frameRate = videoStream.avgFramerate
+    if (!frameRate || frameRate.numerator === 0) frameRate = { numerator: 30, denominator: 1 }
+    const frameSeconds = frameRate.denominator / frameRate.numerator
+    const gop = Math.max(1, Math.round(SEGMENT_SECONDS / frameSeconds))
+
+    let decoderFormat = videoDecoder.pixelFormat
+    if (!decoderFormat || decoderFormat < 0) decoderFormat = ffmpeg.constants.pixelFormats.YUV420P
+
+    for (const rendition of plan) {
+      const encoder = openVideoEncoder(ffmpeg, h264, rendition, frameRate, gop)
+      const scaled = new ffmpeg.Frame()
+      scaled.width = rendition.width
+      scaled.height = rendition.height
+      scaled.format = h264.pixelFormat
+      scaled.alloc()
+
+      outputs.push({
+        rendition,
+        encoder,
+        scaled,
+        scaler: new ffmpeg.Scaler(decoderFormat, srcWidth, srcHeight, h264.pixelFormat, rendition.width, rendition.height),
+        muxer: createSegmentMuxer(ffmpeg, (stream) => {
+          stream.codecParameters.type = ffmpeg.constants.mediaTypes.VIDEO
+          stream.codecParameters.id = ffmpeg.constants.codecs.H264
+          stream.codecParameters.width = rendition.width
+          stream.codecParameters.height = rendition.height
+          stream.codecParameters.format = h264.pixelFormat
+          if (encoder.extradata?.length > 0) stream.codecParameters.extraData = encoder.extradata
+        }),
+        segments: [],
+        segmentStart: null,
+        lastPts: 0,
+        codecs: avcCodecString(encoder.extradata)
+      })
+    }
+
+    if (audioStream) {
+      try {
+        audioDecoder = audioStream.decoder()
+        audioDecoder.timeBase = audioStream.timeBase
+        audioDecoder.open()
+        audioEncoder = openAudioEncoder(ffmpeg)
+      } catch (err) {
+        console.warn('[HlsLadder] Audio setup failed, ladder will be video-only:', err?.message)
+        audioEncoder = null
+      }
+    }
+
+    if (audioEncoder) {
+      audioOut = {
+        muxer: createSegmentMuxer(ffmpeg, (stream) => {
+          stream.codecParameters.fromContext(audioEncoder)
+        }),
+        segments: [],
+        segmentStart: null,
+        lastPts: 0
+      }
+      audioFifo = new ffmpeg.AudioFIFO(audioEncoder.sampleFormat, 2, AAC_FRAME_SIZE * 4)
+      audioFrame = new ffmpeg.Frame()
+      resampledFrame = new ffmpeg.Frame()
+      resampledFrame.format = audioEncoder.sampleFormat
+      resampledFrame.channelLayout = ffmpeg.constants.channelLayouts.STEREO
+      resampledFrame.sampleRate = audioEncoder.sampleRate
+      resampledFrame.nbSamples = 4096
+      resampledFrame.alloc()
+      encoderFrame = new ffmpeg.Frame()
+    }
+
+    console.log('[HlsLadder] Source', srcWidth + 'x' + srcHeight, 'encoder', h264.name, '-> renditions:',
+      plan.map((r) => r.name).join(', '), 'audio:', !!audioOut)
+
+    packet = new ffmpeg.Packet()
+    frame = new ffmpeg.Frame()
+    outPacket = new ffmpeg.Packet()
+
+    const inputTB = videoStream.timeBase
+    const toMs = (pts) => Math.round((pts * inputTB.numerator * 1000) / inputTB.denominator)
+
+    // Write one encoded video packet, cutting a segment before a keyframe
+    // once the current one is long enough
+    const writeVideo = (out) => {
+      const ptsMs = outPacket.pts || 0
+      const seconds = ptsMs / 1000
+      if (out.segmentStart === null) out.segmentStart = seconds
+
+      const keyframe = (outPacket.flags & 1) !== 0
+      if (keyframe && !out.codecs) out.codecs = avcCodecString(outPacket.data)
+
+      const elapsed = seconds - out.segmentStart
+      if (keyframe && elapsed >= SEGMENT_SECONDS * 0.9) {
+        out.muxer.format.flush()
+        store(out, out.muxer.take(), elapsed)
+        out.segmentStart = seconds
+      }
+      out.lastPts = seconds + frameSeconds
+
+      outPacket.streamIndex = out.muxer.stream.index
+      outPacket.dts = outPacket.pts
+      outPacket.timeBase = ENCODER_TIME_BASE
+      outPacket.rescaleTimestamps(ENCODER_TIME_BASE, MPEGTS_TIME_BASE)
+      outPacket.timeBase = MPEGTS_TIME_BASE
+      out.muxer.format.writeFrame(outPacket)
+      outPacket.unref()
+    }
+
+    const drainVideo = (out) => {
+      while (out.encoder.receivePacket(outPacket)) {
+        if (!outPacket.data || outPacket.data.length === 0) {
+          outPacket.unref()
+          continue
+        }
+        writeVideo(out)
+      }
+    }
+
+    let audioBaseMs = null
+    let audioSamples = 0
+
+    // Audio segments follow a fixed time grid; players only need them close
+    // to the video boundaries
+    const writeAudio = () => {
+      const ms = audioBaseMs + (outPacket.pts * 1000) / audioEncoder.sampleRate
+      const seconds = ms / 1000
+      if (audioOut.segmentStart === null) audioOut.segmentStart = seconds
+      const elapsed = seconds - audioOut.segmentStart
+      if (elapsed >= SEGMENT_SECONDS) {
+        audioOut.muxer.format.flush()
+        store(audioOut, audioOut.muxer.take(), elapsed)
+        audioOut.segmentStart = seconds
+      }
+      audioOut.lastPts = seconds + AAC_FRAME_SIZE / audioEncoder.sampleRate
+
+      const pts90k = Math.round(ms * 90)
+      outPacket.streamIndex = audioOut.muxer.stream.index
+      outPacket.pts = pts90k
+      outPacket.dts = pts90k
+      outPacket.timeBase = MPEGTS_TIME_BASE
+      audioOut.muxer.format.writeFrame(outPacket)
+      outPacket.unref()
+    }
+
+    const drainAudio = () => {
+      while (audioEncoder.receivePacket(outPacket)) {
+        if (outPacket.pts < 0) {
+          outPacket.unref()
+          continue
+        }
+        writeAudio()
+      }
+    }
+
+    const encodeFifo = () => {
+      while (audioFifo.size >= AAC_FRAME_SIZE) {
+        encoderFrame.unref()
+        encoderFrame.format = audioEncoder.sampleFormat
+        encoderFrame.channelLayout = ffmpeg.constants.channelLayouts.STEREO
+        encoderFrame.sampleRate = audioEncoder.sampleRate
+        encoderFrame.nbSamples = AAC_FRAME_SIZE
+        encoderFrame.alloc()
+        if (audioFifo.read(encoderFrame, AAC_FRAME_SIZE) !== AAC_FRAME_SIZE) break
+
+        encoderFrame.pts = audioSamples
+        encoderFrame.timeBase = audioEncoder.timeBase
+        if (!audioEncoder.sendFrame(encoderFrame)) break
+        audioSamples += AAC_FRAME_SIZE
+        drainAudio()
+      }
+    }
+
+    let packets = 0
+    let bytes = 0
+    let lastProgress = -1
+    // Next forced keyframe, on the source timeline (ms)
+    let nextKeyframeMs = null
+
+    while (input.readFrame(packet)) {
+      packets++
+      bytes += packet.data ? packet.data.length : 0
+
+      try {
+        if (packet.streamIndex === videoStream.index) {
+          packet.timeBase = videoStream.timeBase
+          if (videoDecoder.sendPacket(packet)) {
+            while (videoDecoder.receiveFrame(frame)) {
+              // The decoded frame is shared: each rung scales it into its
+              // own buffer and encodes that
+              const ptsMs = toMs(frame.pts || 0)
+              if (nextKeyframeMs === null) nextKeyframeMs = ptsMs
+              const forceKeyframe = ptsMs >= nextKeyframeMs
+              if (forceKeyframe) {
+                while (nextKeyframeMs <= ptsMs) nextKeyframeMs += SEGMENT_SECONDS * 1000
+              }
+              for (const out of outputs) {
+                out.scaler.scale(frame, out.scaled)
+                out.scaled.pts = ptsMs
+                out.scaled.timeBase = ENCODER_TIME_BASE
+                try { out.scaled.pictType = forceKeyframe ? PICTURE_TYPE_I : PICTURE_TYPE_NONE } catch {}
+                if (out.encoder.sendFrame(out.scaled)) drainVideo(out)
+              }
+              frame.unref()
+            }
+          }
+        } else if (audioOut && packet.streamIndex === audioStream.index) {
+          const tb = audioStream.timeBase
+          if (audioBaseMs === null) audioBaseMs = ((packet.pts || 0) * tb.numerator * 1000) / tb.denominator
+          packet.timeBase = tb
+          if (audioDecoder.sendPacket(packet)) {
+            while (audioDecoder.receiveFrame(audioFrame)) {
+              if (!resampler) {
+                const layout = ffmpeg.ChannelLayout.from(audioFrame.channelLayout) || ffmpeg.constants.channelLayouts.STEREO
+                resampler = new ffmpeg.Resampler(
+                  audioFrame.sampleRate || AUDIO_SAMPLE_RATE, layout, audioFrame.format,
+                  audioEncoder.sampleRate, ffmpeg.constants.channelLayouts.STEREO, audioEncoder.sampleFormat
+                )
+              }
+              const capacity = resampledFrame.nbSamples
+              resampledFrame.nbSamples = resampler.convert(audioFrame, resampledFrame)
+              audioFifo.write(resampledFrame)
+              resampledFrame.nbSamples = capacity
+              encodeFifo()
+              audioFrame.unref()
+            }
+          }
+        }
+      } catch (err) {
+        console.warn('[HlsLadder] Packet', packets, 'failed:', err?.message)
+      }
+
+      packet.unref()
+
+      if (packets % YIELD_EVERY_PACKETS === 0) {
+        const progress = Math.min(99, Math.floor((bytes / source.size) * 100))
+        if (onProgress && progress > lastProgress) {
+          lastProgress = progress
+          onProgress(progress)
+        }
+        await new Promise((resolve) => setImmediate(resolve))
+      }
+    }
+
+    // Flush encoders and close the last segment of every output
+    for (const out of outputs) {
+      try {
+        out.encoder.sendFrame(null)
+        drainVideo(out)
+      } catch (err) {
+        console.warn('[HlsLadder] Flushing', out.rendition.name, 'failed:', err?.message)
+      }
+      out.muxer.format.writeTrailer()
+      store(out, out.muxer.take(), out.lastPts - (out.segmentStart ?? 0))
+    }
+    if (audioOut) {
+      try {
+        audioEncoder.sendFrame(null)
+        drainAudio()
+      } catch (err) {
+        console.warn('[HlsLadder] Flushing audio failed:', err?.message)
+      }
+      audioOut.muxer.format.writeTrailer()
+      store(audioOut, audioOut.muxer.take(), audioOut.lastPts - (audioOut.segmentStart ?? 0))
+    }
+
+    await Promise.all(pending)
+
+    // Media playlists, then the master pointing at them
+    const variants = []
+    const result = { masterBlobId: null, renditions: [], audioPlaylistBlobId: null }
+    for (const out of outputs) {
+      const playlistBlobId = await put(Buffer.from(buildMediaPlaylist(out.segments)))
+      const { name, width, height, bitRate } = out.rendition
+      const codecs = out.codecs || expectedAvcCodecString(h264.isHardware, out.rendition, 1 / frameSeconds)
+      variants.push({ width, height, bandwidth: bitRate, codecs, uri: playlistBlobId })
+      result.renditions.push({ name, width, height, bitRate, codecs, playlistBlobId, segments: out.segments.length })
+    }
+    if (audioOut && audioOut.segments.length > 0) {
+      result.audioPlaylistBlobId = await put(Buffer.from(buildMediaPlaylist(audioOut.segments)))
+    }
+    const audio = result.audioPlaylistBlobId ? { uri: result.audioPlaylistBlobId } : null
+    result.masterBlobId = await put(Buffer.from(buildMasterPlaylist(variants, audio)))
+
+    if (onProgress) onProgress(100)
+    console.log('[HlsLadder] Done:', result.renditions.map((r) => r.name + '=' + r.segments).join(', '),
+      'master:', result.masterBlobId)
+    return result
+  } finally {
+    if (encoderFrame) { try { encoderFrame.destroy() } catch {} }
+    if (resampledFrame) { try { resampledFrame.destroy() } catch {} }
+    if (audioFrame) { try { audioFrame.destroy() } catch {} }
+    if (frame) { try { frame.destroy() } catch {} }
+    if (outPacket) { try { outPacket.destroy() } catch {} }
+    if (packet) { try { packet.destroy() } catch {} }
+
+    if (audioFifo) { try { audioFifo.destroy() } catch {} }
+    if (resampler) { try { resampler.destroy() } catch {} }
+    for (const out of outputs) {
+      try { out.scaled.destroy() } catch {}
+      try { out.scaler.destroy() } catch {}
+      try { out.encoder.destroy() } catch {}
+      try { out.muxer.format.destroy() } catch {}
+    }
+    if (audioOut) { try { audioOut.muxer.format.destroy() } catch {} }
+    if (audioEncoder) { try { audioEncoder.destroy() } catch {} }
+    if (audioDecoder) { try { audioDecoder.destroy() } catch {} }
+    if (videoDecoder) { try { videoDecoder.destroy() } catch {} }
+
+    if (input) { try { input.destroy() } catch {} }
+    source.close()
+  }
+}
+
+/**
+ * Start the ladder worker from the first path that loads
+ * @returns {Promise<Worker>}
+ */
+async function startLadderWorker() {
+  // On mobile the bundles are written next to the downloader worker
+  const paths = [...WORKER_PATHS]
+  const downloaderPath = globalThis.__PEARTUBE_WORKER_PATH__
+  if (typeof downloaderPath === 'string' && downloaderPath.includes('/')) {
+    paths.unshift(downloaderPath.slice(0, downloaderPath.lastIndexOf('/') + 1) + 'hls-ladder-worker.bundle.js')
+  }
+
+  let lastError = null
+  for (const spec of paths) {
+    try {
+      return await spawnLadderWorker(spec.startsWith('/') ? new URL(`file://${spec}`) : new URL(spec, import.meta.url))
+    } catch (err) {
+      lastError = err
+    }
+  }
+  throw lastError || new Error('Ladder worker not found')
+}
+
+function spawnLadderWorker(spec) {
+  return new Promise((resolve, reject) => {
+    let worker
+    try {
+      worker = new Worker(spec)
+    } catch (err) {
+      reject(err)
+      return
+    }
+
+    const fail = (err) => {
+      clearTimeout(timeout)
+      try { worker.terminate() } catch {}
+      reject(err)
+    }
+    const timeout = setTimeout(() => fail(new Error('Ladder worker start timeout')), WORKER_START_TIMEOUT_MS)
+
+    worker.once('error', fail)
+    worker.once('message', (msg) => {
+      if (msg?.type !== 'ready') return fail(new Error('Unexpected ladder worker message'))
+      if (msg.error) return fail(new Error(msg.error))
+      clearTimeout(timeout)
+      worker.off('error', fail)
+      resolve(worker)
+    })
+  })
+}
+
+/**
+ * generateHlsLadder() on a worker thread. The worker posts each encoded
+ * blob back and put() runs here, where the channel lives.
+ *
+ * @param {number} fd - Open source file; stays open until this settles, closing it is up to the caller
+ * @param {Object} options - As generateHlsLadder()
+ * @returns {Promise<Object|null>} As generateHlsLadder()
+ */
+export async function runHlsLadderWorker(fd, options = {}) {
+  const { put, renditions, onProgress } = options
+  if (typeof put !== 'function') throw new Error('runHlsLadderWorker needs a put(data) callback')
+
+  const worker = await startLadderWorker()
+  try {
+    return await new Promise((resolve, reject) => {
+      const cleanup = () => {
+        worker.off('message', onMessage)
+        worker.off('error', onError)
+        worker.off('exit', onExit)
+      }
+      const onMessage = (msg) => {
+        if (msg?.type === 'put') {
+          put(b4a.from(msg.data)).then(
+            (blobId) => worker.postMessage({ type: 'stored', seq: msg.seq, blobId }),
+            (err) => worker.postMessage({ type: 'stored', seq: msg.seq, error: err?.message || String(err) })
+          )
+        } else if (msg?.type === 'progress') {
+          if (onProgress) onProgress(msg.progress)
+        } else if (msg?.type === 'result') {
+          cleanup()
+          resolve(msg.ladder)
+        } else if (msg?.type === 'error') {
+          cleanup()
+          reject(new Error(msg.error))
+        }
+      }
+      const onError = (err) => {
+        cleanup()
+        reject(err)
+      }
+      const onExit = () => {
+        cleanup()
+        reject(new Error('Ladder worker exited'))
+      }
+
+      worker.on('message', onMessage)
+      worker.on('error', onError)
+      worker.on('exit', onExit)
+      worker.postMessage({ type: 'start', fd, renditions, capabilities: getCodecCapabilities() })
+    })
+  } finally {
+    try { worker.terminate() } catch {}
+  }
+}
+
+export default {
+  DEFAULT_RENDITIONS,
+  planRenditions,
+  avcCodecString,
+  expectedAvcCodecString,
+  buildMediaPlaylist,
+  buildMasterPlaylist,
+  resolveLadderPlaylist,
+  serveLadders,
+  getLadderUrl,
+  generateHlsLadder,
+  runHlsLadderWorker
+}
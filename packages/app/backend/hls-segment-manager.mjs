@@ -77,6 +77,10 @@ export class HlsSegmentManager {
     // This is required for each HLS segment to be independently playable
     this.mpegtsHeader = null
 
+    // Optional (index, duration, data) => void, called for each added segment
+    // (used to publish segments to the HLS cache as they are produced)
+    this.onSegment = null
+
     // Stats
     this.totalSegments = 0
     this.totalBytes = 0
@@ -399,7 +403,7 @@ export class HlsSegmentManager {
   }
 
   /**
-   * Add a complete segment (API compatible with HlsHyperblobsSegmentManager)
+   * Add a complete segment
    * @param {number} index - Segment index
    * @param {number} duration - Segment duration in seconds
    * @param {Buffer} data - Complete MPEGTS segment data
@@ -423,6 +427,12 @@ export class HlsSegmentManager {
 
     console.log('[HlsSegmentManager] Segment', index, 'added:', segmentData.length, 'bytes, duration:', duration.toFixed(2) + 's')
 
+    if (this.onSegment) {
+      try { this.onSegment(index, duration, segmentData) } catch (err) {
+        console.error('[HlsSegmentManager] onSegment failed:', err?.message)
+      }
+    }
+
     // Manage memory - spill to disk if too many in memory
     this._manageMemory()
   }
@@ -22,6 +22,7 @@ import { HlsSegmentManager } from './hls-segment-manager.mjs'
 import { getHttpFileSize } from './channel-stream-reader.mjs'
 import TempFileReader from './temp-file-reader.mjs'
 import { HypercoreIOReader } from './hypercore-io-reader.mjs'
+import { ensureCodecCapabilities, getCodecCapabilities, rankCandidates } from './codec-probe.mjs'
 
 console.log('[HlsTranscoder] Module loaded')
 
@@ -197,6 +198,23 @@ export function getLoadError() {
   return ffmpegLoadError
 }
 
+/**
+ * Loaded bare-ffmpeg module (null until loadBareFfmpeg() succeeds)
+ */
+export function getFfmpeg() {
+  return ffmpeg
+}
+
+/**
+ * Load (or probe once and persist) the codec capability table so sessions
+ * pick encoders/decoders without opening test CodecContexts.
+ * @param {string} cacheDir - Directory for the persisted table
+ */
+export async function probeCodecCapabilities(cacheDir) {
+  if (!(await loadBareFfmpeg())) return null
+  return ensureCodecCapabilities(ffmpeg, { cacheDir })
+}
+
 // Active HLS sessions
 const sessions = new Map()
 
@@ -284,6 +302,10 @@ let httpServer = null
 let httpPort = 0
 let httpReady = null
 
+// Other handlers on the HLS server, by path prefix (hls-ladder.mjs serves
+// stored ladders under /ladder/)
+const httpRoutes = new Map()
+
 // CRITICAL: Mutex to prevent concurrent access between transcoding and HTTP handler
 // When this is > 0, HTTP handler should wait or return 503
 let transcodingBusy = 0
@@ -325,6 +347,13 @@ async function handleHttpRequest(req, res) {
       return
     }
 
+    for (const [prefix, handler] of httpRoutes) {
+      if (url.startsWith(prefix)) {
+        await handler(req, res)
+        return
+      }
+    }
+
     // Parse URL: /hls/{sessionId}/stream.m3u8 or /hls/{sessionId}/segment{N}.ts
     const playlistMatch = url.match(/^\/hls\/([^\/]+)\/stream\.m3u8/)
     const segmentMatch = url.match(/^\/hls\/([^\/]+)\/segment(\d+)\.ts/)
@@ -528,6 +557,23 @@ async function ensureHttpServer() {
   return httpReady
 }
 
+/**
+ * Serve a path prefix from the HLS server
+ * @param {string} prefix - e.g. '/ladder/'
+ * @param {(req: any, res: any) => Promise<void>} handler
+ */
+export function addHttpRoute(prefix, handler) {
+  httpRoutes.set(prefix, handler)
+}
+
+/**
+ * Port of the HLS server, starting it if needed
+ * @returns {Promise<number>}
+ */
+export function getHttpPort() {
+  return ensureHttpServer()
+}
+
 /**
  * Check if transcoding is needed based on URL/title detection
  */
@@ -842,7 +888,7 @@ async function hlsRemux(session, inputIO, segmentManager, totalSize, onProgress)
  * Returns encoder info including whether it's a hardware encoder (needs NV12)
  * @param {boolean} preferSoftware - If true, prefer software encoder (fallback mode)
  */
-function selectH264Encoder(preferSoftware = false) {
+export function selectH264Encoder(preferSoftware = false) {
   if (!ffmpeg) return null
 
   // Hardware encoders require NV12 pixel format
@@ -864,7 +910,11 @@ function selectH264Encoder(preferSoftware = false) {
         'h264'                // Generic fallback
       ]
 
-  for (const name of candidates) {
+  // Probed table (if any) drops broken encoders and ranks by measured speed
+  const caps = getCodecCapabilities()
+  const ordered = caps ? rankCandidates(caps.h264, candidates, preferSoftware) : candidates
+
+  for (const name of ordered) {
     try {
       const encoder = ffmpeg.findEncoderByName?.(name)
       if (encoder && encoder._handle) {
@@ -893,11 +943,13 @@ function selectH264Encoder(preferSoftware = false) {
   return null
 }
 
-function selectAacEncoder() {
+export function selectAacEncoder() {
   if (!ffmpeg) return null
 
   const candidates = ['aac', 'libfdk_aac', 'libvo_aacenc']
-  for (const name of candidates) {
+  const caps = getCodecCapabilities()
+  const ordered = caps ? rankCandidates(caps.aac, candidates) : candidates
+  for (const name of ordered) {
     try {
       const encoder = ffmpeg.findEncoderByName?.(name)
       if (encoder && encoder._handle) {
@@ -931,6 +983,9 @@ function selectDecoderForId(codecId) {
     candidates = ['hevc_mediacodec', 'hevc_videotoolbox', 'hevc']
   }
 
+  const caps = getCodecCapabilities()
+  if (caps) candidates = rankCandidates(caps.decoders, candidates)
+
   for (const name of candidates) {
     try {
       const decoder = ffmpeg.findDecoderByName?.(name)
@@ -951,6 +1006,10 @@ function selectDecoderForId(codecId) {
 function isH264EncoderAvailable() {
   if (!ffmpeg) return false
 
+  // Probed table already test-encoded every candidate
+  const caps = getCodecCapabilities()
+  if (caps) return caps.h264.some((entry) => entry.ok)
+
   try {
     const selection = selectH264Encoder()
     if (!selection) return false
@@ -2280,13 +2339,62 @@ async function hlsTranscodeVideo(session, inputIO, segmentManager, totalSize, on
   }
 }
 
+// Bump when segmenting/encoding changes so stale renderings are not reused
+const HLS_CACHE_PROFILE_VERSION = 1
+
+/**
+ * Output profile of a cast rendering, part of its HLS cache key
+ * @param {{needsVideoTranscode: boolean, needsAudioTranscode: boolean}} detection
+ */
+function castProfile(detection) {
+  const video = detection.needsVideoTranscode ? 'h264' : 'copy'
+  const audio = detection.needsAudioTranscode ? 'aac' : 'copy'
+  return `cast${HLS_CACHE_PROFILE_VERSION}-${video}-${audio}`
+}
+
+/**
+ * Fill a session's segment manager from a stored rendering instead of
+ * transcoding. Segments are fetched in order, so the playlist grows the
+ * same way it does during a live transcode.
+ * @returns {Promise<boolean>} false if a segment could not be fetched
+ */
+async function replayCachedSegments(session, cached, segmentManager, onProgress) {
+  const { segments } = cached.manifest
+  console.log('[HlsTranscoder] Reusing stored rendering:', segments.length, 'segments, profile:', cached.manifest.profile)
+  session.status = 'transcoding'
+  session.cached = true
+
+  for (let i = 0; i < segments.length; i++) {
+    if (!sessions.has(session.id)) return true // stopped
+    let data
+    try {
+      data = await cached.read(segments[i])
+    } catch (err) {
+      console.warn('[HlsTranscoder] Stored segment', segments[i].index, 'unavailable, transcoding instead:', err?.message)
+      session.cached = false
+      return false
+    }
+    await segmentManager.addSegment(segments[i].index, segments[i].duration, data)
+
+    const pct = Math.floor(((i + 1) / segments.length) * 100)
+    if (pct !== session.progress) {
+      session.progress = pct
+      onProgress(pct)
+    }
+  }
+
+  segmentManager.finish()
+  return true
+}
+
 /**
  * Start HLS transcode session
  * @param {string} sourceUrl - Video URL (from blob server)
- * @param {object} options - { title, onProgress, store, isVideoComplete, blobInfo, blobsCoreKey }
+ * @param {object} options - { title, onProgress, store, isVideoComplete, blobInfo, blobsCoreKey, hlsCache }
  *   - store: Corestore instance (for direct Hypercore access)
  *   - isVideoComplete: If true, video is fully synced - enables direct Hypercore read
  *   - blobInfo/blobsCoreKey: For direct Hypercore block access (fastest path)
+ *   - hlsCache: HlsSegmentCache (@peartube/backend/hls-cache) - reuse/publish segments
  */
 export async function startHlsTranscode(sourceUrl, options = {}) {
   const {
@@ -2296,7 +2404,9 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
     isVideoComplete = false,
     // Optional: Direct Hypercore access (bypasses HTTP)
     blobInfo = null,        // { blockOffset, blockLength, byteOffset, byteLength }
-    blobsCoreKey = null     // hex string of the blobs Hypercore key
+    blobsCoreKey = null,    // hex string of the blobs Hypercore key
+    // Optional: stored renderings keyed by source blob (needs blobInfo/blobsCoreKey)
+    hlsCache = null
   } = options
 
   // Check for existing session for this URL - reuse if still active
@@ -2329,6 +2439,7 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
       try {
         if (session.streamReader) session.streamReader.destroy()
       } catch {}
+      if (session.publisher) session.publisher.abort()
       try {
         if (session.segmentManager) session.segmentManager.destroy()
       } catch {}
@@ -2384,8 +2495,8 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
   const lanHost = await getLanIp()
   console.log('[HlsTranscoder] LAN host for Chromecast:', lanHost)
 
-  // Use simple transient segment manager (memory + disk spillover)
-  // Hyperblobs append-only log is not ideal for temporary HLS segments
+  // Transient segment manager (memory + disk spillover) serves the session;
+  // hlsCache, when given, keeps a content-addressed copy in hyperblobs
   const segmentManager = new HlsSegmentManager(sessionId, os.tmpdir())
   console.log('[HlsTranscoder] Using HlsSegmentManager (transient storage)')
 
@@ -2436,11 +2547,58 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
     let hypercoreReader = null
 
     try {
+      session.status = 'initializing'
+
+      // Detect transcode mode (from URL/title only, before any input is opened)
+      const detection = detectTranscodeNeeded(sourceUrl, title)
+      console.log('[HlsTranscoder] Detection:', detection)
+
+      // Check H.264 encoder availability for HEVC transcoding
+      if (detection.needsVideoTranscode) {
+        if (h264EncoderAvailable === null) {
+          h264EncoderAvailable = isH264EncoderAvailable()
+        }
+        if (!h264EncoderAvailable) {
+          console.warn('[HlsTranscoder] HEVC video detected but H.264 encoder not available')
+          console.warn('[HlsTranscoder] Falling back to remux (Chromecast may not support HEVC)')
+          detection.needsVideoTranscode = false
+          detection.needsRemux = true
+          detection.reason += ' (x264 unavailable, remux fallback)'
+        }
+      }
+
+      const progressCallback = (pct) => {
+        if (onProgress) onProgress(sessionId, pct)
+      }
+
+      // Use transcode path when video OR audio needs transcoding
+      // HEVC video -> H.264, E-AC3/DDP/DTS audio -> AAC
+      const needsTranscode = detection.needsVideoTranscode || detection.needsAudioTranscode
+      console.log('[HlsTranscoder] Transcode decision: needsVideo=' + detection.needsVideoTranscode + 
+        ' needsAudio=' + detection.needsAudioTranscode + ' -> ' + (needsTranscode ? 'TRANSCODE' : 'REMUX'))
+
+      // Reuse a stored rendering of this source if one was published;
+      // otherwise publish ours as segments are produced
+      if (hlsCache && blobInfo && blobsCoreKey) {
+        const source = { blobsCoreKey, blobId: blobInfo, profile: castProfile(detection) }
+        const sourceKey = hlsCache.sourceKey(source.blobsCoreKey, source.blobId, source.profile)
+        const cached = await hlsCache.find(sourceKey, source).catch((err) => {
+          console.warn('[HlsTranscoder] HLS cache lookup failed:', err?.message)
+          return null
+        })
+        if (cached && await replayCachedSegments(session, cached, segmentManager, progressCallback)) {
+          session.status = 'complete'
+          session.progress = 100
+          console.log('[HlsTranscoder] Session complete from HLS cache:', sessionId)
+          return
+        }
+        session.publisher = hlsCache.publish(sourceKey, source)
+        segmentManager.onSegment = (index, duration, data) => session.publisher.addSegment(index, duration, data)
+      }
+
       // ============================================
       // Input source selection
       // ============================================
-      session.status = 'initializing'
-
       let inputIO = null
 
       // Option 1: Direct Hypercore access (fastest, no HTTP overhead)
@@ -2473,7 +2631,7 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
             // DEBUG: Test direct read from HypercoreIOReader before creating IOContext
             console.log('[HlsTranscoder] Testing direct read from HypercoreIOReader...')
             console.log('[HlsTranscoder] Reader position:', hypercoreReader.position, 'totalSize:', hypercoreReader.totalSize)
-            console.log('[HlsTranscoder] Blocks loaded:', hypercoreReader.blocks?.size)
+            console.log('[HlsTranscoder] Blocks loaded:', hypercoreReader.getStats().blocksLoaded)
 
             // Also log raw first block bytes for comparison
             const firstBlock = hypercoreReader.blocks.get(hypercoreReader.startBlock)
@@ -2562,34 +2720,6 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
       session.inputIO = inputIO
       console.log('[HlsTranscoder] Input source:', session.hypercoreReader ? 'HypercoreIOReader' : 'TempFileReader', 'inputIO:', !!inputIO)
 
-      // Detect transcode mode
-      const detection = detectTranscodeNeeded(sourceUrl, title)
-      console.log('[HlsTranscoder] Detection:', detection)
-
-      // Check H.264 encoder availability for HEVC transcoding
-      if (detection.needsVideoTranscode) {
-        if (h264EncoderAvailable === null) {
-          h264EncoderAvailable = isH264EncoderAvailable()
-        }
-        if (!h264EncoderAvailable) {
-          console.warn('[HlsTranscoder] HEVC video detected but H.264 encoder not available')
-          console.warn('[HlsTranscoder] Falling back to remux (Chromecast may not support HEVC)')
-          detection.needsVideoTranscode = false
-          detection.needsRemux = true
-          detection.reason += ' (x264 unavailable, remux fallback)'
-        }
-      }
-
-      const progressCallback = (pct) => {
-        if (onProgress) onProgress(sessionId, pct)
-      }
-
-      // Use transcode path when video OR audio needs transcoding
-      // HEVC video -> H.264, E-AC3/DDP/DTS audio -> AAC
-      const needsTranscode = detection.needsVideoTranscode || detection.needsAudioTranscode
-      console.log('[HlsTranscoder] Transcode decision: needsVideo=' + detection.needsVideoTranscode + 
-        ' needsAudio=' + detection.needsAudioTranscode + ' -> ' + (needsTranscode ? 'TRANSCODE' : 'REMUX'))
-
       if (needsTranscode) {
         await hlsTranscodeVideo(session, inputIO, segmentManager, fileSize, progressCallback)
       } else {
@@ -2600,9 +2730,16 @@ export async function startHlsTranscode(sourceUrl, options = {}) {
       session.progress = 100
       console.log('[HlsTranscoder] Session complete:', sessionId)
 
+      if (session.publisher) {
+        session.publisher.finish().catch((err) => {
+          console.warn('[HlsTranscoder] HLS cache publish failed:', err?.message)
+        })
+      }
+
     } catch (err) {
       session.status = 'error'
       session.error = err?.message || 'Transcode failed'
+      if (session.publisher) session.publisher.abort()
       console.error('[HlsTranscoder] Error:', session.error)
       if (err?.stack) console.error(err.stack)
     } finally {
@@ -2647,6 +2784,9 @@ export function stopHlsTranscode(sessionId) {
   if (session.hypercoreReader) {
     try { session.hypercoreReader.destroy() } catch {}
   }
+  if (session.publisher) {
+    session.publisher.abort()
+  }
   if (session.segmentManager) {
     try { session.segmentManager.destroy() } catch {}
   }
@@ -8,6 +8,8 @@
  * - Pre-loads blocks into memory buffer for sync IOContext access
  * - Handles byte offsets within blocks (Hyperblobs format)
  * - Provides seek support for FFmpeg demuxing
+ * - With bare-range-cache, blocks are preloaded into native pages and the
+ *   IOContext reads/seeks them natively (no JS block lookup per read)
  *
  * Usage:
  *   const reader = new HypercoreIOReader(blobsCore, blobInfo)
@@ -15,6 +17,8 @@
  *   const ioContext = reader.createIOContext(ffmpeg)
  */
 
+import { createRangeCache } from './range-cache.mjs'
+
 console.log('[HypercoreIOReader] === MODULE LOADED ===')
 
 // SEEK constants matching FFmpeg's whence values
@@ -54,6 +58,8 @@ export class HypercoreIOReader {
     // State
     this.position = 0
     this.blocks = new Map() // blockIndex -> Buffer
+    this.cache = null // native RangeCache holding the blocks instead, when available
+    this.cachedBlocks = 0
     this.totalSize = this.byteLength
     this.preloaded = false
 
@@ -103,14 +109,26 @@ export class HypercoreIOReader {
     let loadedCount = 0
     let errorCount = 0
 
+    // The native cache copies each block in at its byte position, which is
+    // only known once every earlier block has loaded; writing stops at the
+    // first missing block, like getBlockPosition() does
+    this.cache = await createRangeCache(this.totalSize)
+    this.cachedBlocks = 0
+    let cacheOffset = 0
+    let cacheBroken = false
+
     for (let batchStart = this.startBlock; batchStart < this.endBlock; batchStart += BATCH_SIZE) {
       const batchEnd = Math.min(batchStart + BATCH_SIZE, this.endBlock)
       const batchPromises = []
+      const batchBlocks = []
 
       for (let i = batchStart; i < batchEnd; i++) {
         batchPromises.push(
           this.core.get(i).then(data => {
-            if (data) {
+            if (data && this.cache) {
+              batchBlocks[i - batchStart] = data
+              loadedCount++
+            } else if (data) {
               // CRITICAL: Make a defensive copy to avoid native write-after-free
               // The native Hypercore may reuse/free the buffer after returning
               const copy = Buffer.alloc(data.length)
@@ -130,6 +148,19 @@ export class HypercoreIOReader {
 
       await Promise.all(batchPromises)
 
+      if (this.cache) {
+        for (let i = 0; i < batchEnd - batchStart && !cacheBroken; i++) {
+          const data = batchBlocks[i]
+          if (!data) {
+            cacheBroken = true
+            break
+          }
+          const start = batchStart + i === this.startBlock ? this.byteOffset : 0
+          cacheOffset += this.cache.write(cacheOffset, data.subarray(start))
+          this.cachedBlocks++
+        }
+      }
+
       // Log progress for large videos
       if (totalBlocks > BATCH_SIZE) {
         const progress = Math.round(((batchEnd - this.startBlock) / totalBlocks) * 100)
@@ -143,8 +174,12 @@ export class HypercoreIOReader {
     const elapsed = Date.now() - startTime
 
     let totalBytes = 0
-    for (const block of this.blocks.values()) {
-      if (block) totalBytes += block.length
+    if (this.cache) {
+      totalBytes = this.cache.stats().bytesCached
+    } else {
+      for (const block of this.blocks.values()) {
+        if (block) totalBytes += block.length
+      }
     }
 
     console.log('[HypercoreIOReader] Preloaded', loadedCount, '/', this.blockLength, 'blocks,',
@@ -152,6 +187,8 @@ export class HypercoreIOReader {
       errorCount > 0 ? '(' + errorCount + ' errors)' : '')
 
     if (loadedCount === 0) {
+      this.cache?.destroy()
+      this.cache = null
       throw new Error('Failed to load any blocks')
     }
 
@@ -210,6 +247,12 @@ export class HypercoreIOReader {
       return -1  // Error: not initialized
     }
 
+    if (this.cache) {
+      const n = this.cache.read(buffer)
+      this.position = this.cache.position
+      return n < 0 ? 0 : n
+    }
+
     this.readCount++
     const requestedLen = buffer.length
 
@@ -273,6 +316,12 @@ export class HypercoreIOReader {
    * @returns {number} New position, or -1 for error
    */
   seek(offset, whence) {
+    if (this.cache) {
+      const pos = this.cache.seek(offset, whence)
+      if (whence !== AVSEEK_SIZE) this.position = this.cache.position
+      return pos
+    }
+
     this.seekCount++
 
     // Handle AVSEEK_SIZE - FFmpeg asking for total size
@@ -320,6 +369,14 @@ export class HypercoreIOReader {
       throw new Error('Must call preload() before createIOContext()')
     }
 
+    if (this.cache) {
+      // Reads past a block that failed to load return EOF, as in syncRead()
+      const ioContext = this.cache.createIOContext(ffmpeg, { bufferSize: 128 * 1024 })
+      console.log('[HypercoreIOReader] Native IOContext created, totalSize:', this.totalSize,
+        'blocks:', this.blockLength)
+      return ioContext
+    }
+
     const self = this
 
     // Use 128KB buffer for IOContext
@@ -342,6 +399,20 @@ export class HypercoreIOReader {
    * Get reader stats
    */
   getStats() {
+    if (this.cache) {
+      const stats = this.cache.stats()
+      return {
+        totalSize: this.totalSize,
+        position: stats.position,
+        blocksLoaded: this.cachedBlocks,
+        readCount: stats.hits + stats.misses,
+        seekCount: stats.seeks,
+        bytesRead: stats.bytesRead,
+        progress: Math.round((stats.position / this.totalSize) * 100),
+        native: true
+      }
+    }
+
     return {
       totalSize: this.totalSize,
       position: this.position,
@@ -357,9 +428,12 @@ export class HypercoreIOReader {
    * Clean up resources
    */
   destroy() {
-    console.log('[HypercoreIOReader] Destroying - reads:', this.readCount,
-      'seeks:', this.seekCount, 'bytesRead:', Math.round(this.bytesRead / 1024 / 1024) + 'MB')
+    const stats = this.getStats()
+    console.log('[HypercoreIOReader] Destroying - reads:', stats.readCount,
+      'seeks:', stats.seekCount, 'bytesRead:', Math.round(stats.bytesRead / 1024 / 1024) + 'MB')
     this.blocks.clear()
+    this.cache?.destroy()
+    this.cache = null
     this.preloaded = false
   }
 }
@@ -10,6 +10,7 @@
 import HRPC from '@peartube/spec'
 import { createBackendContext } from '@peartube/backend/orchestrator'
 import { loadDrive } from '@peartube/backend/storage'
+import { HlsSegmentCache } from '@peartube/backend/hls-cache'
 import path from 'bare-path'
 import fs from 'bare-fs'
 import os from 'bare-os'
@@ -17,6 +18,7 @@ import b4a from 'b4a'
 import http1 from 'bare-http1'
 import * as transcoder from './transcoder.mjs'
 import * as hlsTranscoder from './hls-transcoder.mjs'
+import * as hlsLadder from './hls-ladder.mjs'
 
 // Get IPC from BareKit, args from Bare
 const { IPC } = BareKit
@@ -806,6 +808,15 @@ if (!backend) {
 
 const { ctx, api, identityManager, uploadManager, publicFeed, seedingManager, videoStats } = backend
 
+// Cast HLS renderings stored in hyperblobs, reused instead of re-transcoding
+const hlsCache = new HlsSegmentCache(ctx.store, ctx.metaDb, { channels: ctx.channels })
+
+// Upload-time HLS ladders, played instead of the original when a video has one
+hlsLadder.serveLadders((coreKeyHex, blobId) => hlsCache.readBlob(coreKeyHex, blobId))
+// Ladder URL -> original blob URL. Casting sends the original, which the
+// Chromecast path probes and transcodes as before
+const ladderSources = new Map()
+
 const blobPort = ctx.blobServer?.port || ctx.blobServerPort || 0
 console.log('[Backend] Backend initialized, blob server port:', blobPort, '(from blobServer.port:', ctx.blobServer?.port, ', from ctx.blobServerPort:', ctx.blobServerPort, ')')
 
@@ -1001,6 +1012,19 @@ rpc.onListVideos(async (req) => {
 rpc.onGetVideoUrl(async (req) => {
   console.log('[HRPC] getVideoUrl:', req.channelKey?.slice(0, 16), req.videoId)
   const result = await api.getVideoUrl(req.channelKey, req.videoId)
+
+  const meta = await api.getVideoData(req.channelKey, req.videoId).catch(() => null)
+  if (meta?.hlsMasterBlobId && meta.blobsCoreKey) {
+    try {
+      const url = await hlsLadder.getLadderUrl(meta.blobsCoreKey, meta.hlsMasterBlobId)
+      ladderSources.set(url, result.url)
+      console.log('[HRPC] getVideoUrl: playing HLS ladder', meta.hlsMasterBlobId)
+      return { url }
+    } catch (err) {
+      console.warn('[HRPC] getVideoUrl: HLS ladder unavailable:', err?.message)
+    }
+  }
+
   return { url: result.url }
 })
 
@@ -1070,6 +1094,37 @@ rpc.onUploadVideo(async (req) => {
     console.error('[HRPC] Upload failed:', result?.error)
   }
 
+  // Multi-bitrate HLS ladder (1080p/720p/360p), opt-in per upload. Runs in
+  // the background; the original stays playable meanwhile and the video
+  // gains hlsMasterBlobId once it is stored, after which getVideoUrl serves
+  // the ladder
+  if (result?.success && req.hlsLadder && hlsTranscoder.isAvailable()) {
+    const videoId = result.videoId
+    // Held until the ladder is done; the picked file may be removed once we return
+    let fd = -1
+    try {
+      fd = fs.openSync(filePath, 'r')
+    } catch (err) {
+      console.warn('[HRPC] HLS ladder skipped, cannot open source:', err?.message)
+    }
+    if (fd >= 0) {
+      hlsLadder.runHlsLadderWorker(fd, {
+        put: async (data) => (await channel.putBlob(data)).id
+      }).then(async (ladder) => {
+        if (!ladder) return
+        await channel.updateVideo(videoId, {
+          hlsMasterBlobId: ladder.masterBlobId,
+          hlsRenditions: ladder.renditions.map(({ name, width, height, bitRate }) => ({ name, width, height, bitRate }))
+        })
+        console.log('[HRPC] HLS ladder stored for', videoId, ladder.renditions.map((r) => r.name).join(','))
+      }).catch((err) => {
+        console.warn('[HRPC] HLS ladder failed for', videoId, err?.message)
+      }).finally(() => {
+        try { fs.closeSync(fd) } catch {}
+      })
+    }
+  }
+
   console.log('[HRPC] Returning upload response')
   return {
     video: {
@@ -1601,6 +1656,8 @@ let lastCastPlayTime = 0
 const CAST_PLAY_DEBOUNCE_MS = 2000 // Minimum 2 seconds between cast plays
 
 rpc.onCastPlay(async (req) => {
+  if (ladderSources.has(req.url)) req = { ...req, url: ladderSources.get(req.url) }
+
   // Debounce: prevent rapid repeated calls - return success to avoid error UI
   const now = Date.now()
   if (now - lastCastPlayTime < CAST_PLAY_DEBOUNCE_MS) {
@@ -1703,6 +1760,7 @@ rpc.onCastPlay(async (req) => {
                 // Direct Hypercore access (HypercoreIOReader) - bypasses HTTP for synced videos
                 blobInfo: syncStatus?.blobInfo || null,
                 blobsCoreKey: syncStatus?.blobsCoreKey || null,
+                hlsCache,
                 onProgress: (sessionId, percent) => {
                   if (percent % 10 === 0) {
                     console.log(`[Backend] HLS transcode progress: ${percent}%`)
@@ -2134,6 +2192,14 @@ Promise.all([
   hlsTranscoder.loadBareFfmpeg()
 ]).then(([legacyLoaded, hlsLoaded]) => {
   backendLog('[Backend] bare-ffmpeg pre-load: legacy=' + legacyLoaded + ', hls=' + hlsLoaded)
+  // Codec capability table: loaded from disk, or probed once per OS/FFmpeg version
+  if (hlsLoaded) {
+    setTimeout(() => {
+      hlsTranscoder.probeCodecCapabilities(storageDir).catch((err) => {
+        backendLog('[Backend] Codec probe error: ' + (err?.message || err))
+      })
+    }, 2000)
+  }
 }).catch(err => {
   backendLog('[Backend] bare-ffmpeg pre-load error: ' + (err?.message || err))
 })
@@ -0,0 +1,100 @@
+/**
+ * Media Index Planner
+ *
+ * Thin loader around the bare-media-index native addon. Readers use it to
+ * find the exact byte ranges of MKV Cues / MP4 moov before FFmpeg opens the
+ * input, instead of prefetching a fixed-size tail.
+ *
+ * When the addon is not available (no prebuild for this platform) every
+ * call resolves to null and callers keep their fixed-size fallbacks.
+ */
+
+// bare-media-index module (loaded dynamically)
+let mediaIndex = null
+let mediaIndexLoadError = null
+let mediaIndexLoadPromise = null
+
+/**
+ * Load bare-media-index module
+ */
+export async function loadMediaIndex() {
+  if (mediaIndex) return true
+  if (mediaIndexLoadError) return false
+  if (mediaIndexLoadPromise) return mediaIndexLoadPromise
+
+  mediaIndexLoadPromise = (async () => {
+    let lastError
+
+    if (typeof require === 'function') {
+      try {
+        const mod = require('bare-media-index')
+        mediaIndex = mod?.default ?? mod
+        console.log('[MediaIndex] bare-media-index loaded via require')
+        return true
+      } catch (err) {
+        lastError = err
+      }
+    }
+
+    try {
+      const mod = await import('bare-media-index')
+      mediaIndex = mod?.default ?? mod
+      console.log('[MediaIndex] bare-media-index loaded via import')
+      return true
+    } catch (err) {
+      lastError = err
+    }
+
+    mediaIndexLoadError = lastError?.message || 'Failed to load bare-media-index'
+    console.warn('[MediaIndex] bare-media-index not available:', mediaIndexLoadError)
+    return false
+  })()
+
+  return mediaIndexLoadPromise
+}
+
+/**
+ * Plan which byte ranges hold the container's seek index.
+ *
+ * @param {number} fileSize - Total file size in bytes
+ * @param {(offset: number, length: number) => Promise<Uint8Array|null>} read - Range reader
+ * @returns {Promise<{container: string, ranges: Array<{start: number, end: number, kind: string}>, bytesFed: number, roundTrips: number}|null>}
+ */
+export async function planIndexPrefetch(fileSize, read) {
+  if (!fileSize || !(await loadMediaIndex())) return null
+
+  const start = Date.now()
+  try {
+    const plan = await mediaIndex.planPrefetch(fileSize, read)
+    if (plan) {
+      console.log('[MediaIndex] Plan for', plan.container, 'in', (Date.now() - start) + 'ms,',
+        plan.roundTrips, 'reads,', Math.round(plan.bytesFed / 1024) + 'KB:',
+        plan.ranges.map((r) => `${r.kind}@${r.start}+${r.end - r.start}`).join(', ') || 'index in head')
+    }
+    return plan
+  } catch (err) {
+    console.warn('[MediaIndex] Planning failed:', err?.message)
+    return null
+  }
+}
+
+/**
+ * Collapse the planned ranges that lie past `headBytes` into one span, or
+ * null when the whole index is already covered by the head.
+ *
+ * @param {{ranges: Array<{start: number, end: number}>}|null} plan
+ * @param {number} headBytes - Bytes from offset 0 the caller fetches anyway
+ * @returns {{start: number, end: number}|null}
+ */
+export function indexSpanBeyond(plan, headBytes) {
+  if (!plan) return null
+  let span = null
+  for (const r of plan.ranges) {
+    if (r.end <= headBytes) continue
+    const start = Math.max(r.start, headBytes)
+    span = span
+      ? { start: Math.min(span.start, start), end: Math.max(span.end, r.end) }
+      : { start, end: r.end }
+  }
+  return span
+}
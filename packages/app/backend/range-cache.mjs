@@ -0,0 +1,73 @@
+/**
+ * Range Cache
+ *
+ * Thin loader around the bare-range-cache native addon. Readers keep the
+ * bytes FFmpeg demuxes in its native pages, so IOContext read/seek copy
+ * straight into FFmpeg's buffer without per-read JS bookkeeping, and learn
+ * about reads that found nothing cached asynchronously.
+ *
+ * When the addon is not available (no prebuild for this platform)
+ * createRangeCache() resolves to null and readers keep their JS buffers.
+ */
+
+// bare-range-cache module (loaded dynamically)
+let rangeCache = null
+let rangeCacheLoadError = null
+let rangeCacheLoadPromise = null
+
+/**
+ * Load bare-range-cache module
+ */
+export async function loadRangeCache() {
+  if (rangeCache) return true
+  if (rangeCacheLoadError) return false
+  if (rangeCacheLoadPromise) return rangeCacheLoadPromise
+
+  rangeCacheLoadPromise = (async () => {
+    let lastError
+
+    if (typeof require === 'function') {
+      try {
+        const mod = require('bare-range-cache')
+        rangeCache = mod?.default ?? mod
+        console.log('[RangeCache] bare-range-cache loaded via require')
+        return true
+      } catch (err) {
+        lastError = err
+      }
+    }
+
+    try {
+      const mod = await import('bare-range-cache')
+      rangeCache = mod?.default ?? mod
+      console.log('[RangeCache] bare-range-cache loaded via import')
+      return true
+    } catch (err) {
+      lastError = err
+    }
+
+    rangeCacheLoadError = lastError?.message || 'Failed to load bare-range-cache'
+    console.warn('[RangeCache] bare-range-cache not available:', rangeCacheLoadError)
+    return false
+  })()
+
+  return rangeCacheLoadPromise
+}
+
+/**
+ * Create a native cache for a file of the given size.
+ *
+ * @param {number} size - Total file size in bytes
+ * @param {Object} [opts] - RangeCache options (pageSize, capacity, onmiss)
+ * @returns {Promise<Object|null>} RangeCache, or null without the addon
+ */
+export async function createRangeCache(size, opts = {}) {
+  if (!size || !(await loadRangeCache())) return null
+
+  try {
+    return new rangeCache.RangeCache(size, opts)
+  } catch (err) {
+    console.warn('[RangeCache] Create failed:', err?.message)
+    return null
+  }
+}
@@ -6,13 +6,19 @@
  *
  * Key features:
  * - Priority queue for seek requests (Cues = HIGH, sequential = NORMAL)
- * - Sparse buffer map for caching downloaded byte ranges
- * - Pre-fetches last 10MB for MKV Cues on initialization
+ * - Sparse buffer map for caching downloaded byte ranges (native pages via
+ *   bare-range-cache when available, so cache hits copy straight into
+ *   FFmpeg's buffer and gaps trigger background fetches)
+ * - Pre-fetches the exact MKV Cues / MP4 moov range on initialization
+ *   (falls back to the last 15MB when the index cannot be located)
  * - Creates IOContext for bare-ffmpeg with sync read/seek callbacks
  */
 
 import http from 'bare-http1'
 
+import { planIndexPrefetch, indexSpanBeyond } from './media-index.mjs'
+import { createRangeCache } from './range-cache.mjs'
+
 // Priority levels for fetch queue
 const PRIORITY_HIGH = 0   // MKK Cues, critical seeks
 const PRIORITY_NORMAL = 1 // Sequential reads
@@ -20,7 +26,8 @@ const PRIORITY_NORMAL = 1 // Sequential reads
 // Default chunk size for HTTP range requests
 const CHUNK_SIZE = 4 * 1024 * 1024 // 4MB chunks (larger for fewer requests)
 
-// Cues prefetch size (last N bytes of file)
+// Cues prefetch size (last N bytes of file), used when the index planner
+// cannot locate the Cues/moov range
 const CUES_PREFETCH_SIZE = 15 * 1024 * 1024 // 15MB (MKV Cues can be large)
 
 // Start prefetch size - INCREASED to avoid sync read deadlock on BareKit
@@ -108,9 +115,11 @@ export class StreamingHttpReader {
     this.fileSize = fileSize
     this.parsedUrl = new URL(url)
 
-    // Sparse buffer map - array of CachedRange
+    // Sparse buffer map - array of CachedRange, or the native RangeCache
+    // once prefetchForInit() created it
     this.cache = []
     this.cacheSize = 0
+    this.native = null
 
     // Priority queue for fetch requests
     this.fetchQueue = new FetchQueue()
@@ -137,6 +146,9 @@ export class StreamingHttpReader {
     this.initPrefetched = false
     this.initPrefetchPromise = null
 
+    // Exact index range from the container planner (null = unknown)
+    this.indexSpan = null
+
     // Background prefetch tracking
     this.backgroundPrefetches = new Set()
 
@@ -153,31 +165,54 @@ export class StreamingHttpReader {
     if (this.initPrefetched) return
     if (this.initPrefetchPromise) return this.initPrefetchPromise
 
-    // Prefetch sizes
+    this.initPrefetchPromise = this._prefetchForInit()
+    return this.initPrefetchPromise
+  }
+
+  async _prefetchForInit() {
     const startSize = Math.min(START_PREFETCH_SIZE, this.fileSize)
-    const endOffset = Math.max(0, this.fileSize - CUES_PREFETCH_SIZE)
-    const endSize = this.fileSize - endOffset
-
-    // Also prefetch a middle chunk for files that have index in middle
-    const midOffset = Math.floor(this.fileSize / 2)
-    const midSize = Math.min(CHUNK_SIZE, this.fileSize - midOffset)
-
-    console.log('[StreamingHttpReader] Pre-fetching start (0-' + Math.round(startSize / 1024 / 1024) + 'MB), mid (' + Math.round(midOffset / 1024 / 1024) + 'MB), and end (' + Math.round(endOffset / 1024 / 1024) + 'MB-' + Math.round(this.fileSize / 1024 / 1024) + 'MB)...')
-
-    // Start all prefetches in parallel (up to MAX_CONCURRENT_FETCHES)
-    const fetches = [
-      // Fetch start of file (for format detection, headers) - HIGH priority
-      this.fetchRange(0, startSize, PRIORITY_HIGH),
-      // Fetch end of file (for MKV Cues/index) - HIGH priority
-      endOffset > startSize ? this.fetchRange(endOffset, endSize, PRIORITY_HIGH) : Promise.resolve(null)
-    ]
-
-    // Add middle prefetch if file is large enough and doesn't overlap
-    if (this.fileSize > START_PREFETCH_SIZE + CUES_PREFETCH_SIZE + CHUNK_SIZE * 2) {
-      fetches.push(this.fetchRange(midOffset, midSize, PRIORITY_NORMAL))
+
+    await this._createNativeCache()
+
+    // Fetch start of file (for format detection, headers) - HIGH priority.
+    // Started before planning so the head downloads while the index is located
+    const head = this.fetchRange(0, startSize, PRIORITY_HIGH)
+    head.catch(() => {}) // Awaited below; don't report it unhandled meanwhile
+    const fetches = [head]
+
+    // Locate the index exactly (a 64KB head read plus a few header reads)
+    const plan = await planIndexPrefetch(this.fileSize, (offset, length) =>
+      this.fetchRange(offset, length, PRIORITY_HIGH).catch(() => null)
+    )
+
+    if (plan) {
+      this.indexSpan = indexSpanBeyond(plan, startSize)
+      console.log('[StreamingHttpReader] Pre-fetching start (0-' + Math.round(startSize / 1024 / 1024) + 'MB)' +
+        (this.indexSpan ? ' and ' + plan.container + ' index (' + this.indexSpan.start + '-' + this.indexSpan.end + ')' : ', index within start') + '...')
+      if (this.indexSpan) {
+        fetches.push(this.fetchRange(this.indexSpan.start, this.indexSpan.end - this.indexSpan.start, PRIORITY_HIGH))
+      }
+    } else {
+      // Index location unknown - guess: end of file for MKV Cues, plus a
+      // middle chunk for files that have index in middle
+      const endOffset = Math.max(0, this.fileSize - CUES_PREFETCH_SIZE)
+      const endSize = this.fileSize - endOffset
+      const midOffset = Math.floor(this.fileSize / 2)
+      const midSize = Math.min(CHUNK_SIZE, this.fileSize - midOffset)
+
+      console.log('[StreamingHttpReader] Pre-fetching start (0-' + Math.round(startSize / 1024 / 1024) + 'MB), mid (' + Math.round(midOffset / 1024 / 1024) + 'MB), and end (' + Math.round(endOffset / 1024 / 1024) + 'MB-' + Math.round(this.fileSize / 1024 / 1024) + 'MB)...')
+
+      if (endOffset > startSize) {
+        fetches.push(this.fetchRange(endOffset, endSize, PRIORITY_HIGH))
+      }
+
+      // Add middle prefetch if file is large enough and doesn't overlap
+      if (this.fileSize > START_PREFETCH_SIZE + CUES_PREFETCH_SIZE + CHUNK_SIZE * 2) {
+        fetches.push(this.fetchRange(midOffset, midSize, PRIORITY_NORMAL))
+      }
     }
 
-    this.initPrefetchPromise = Promise.all(fetches)
+    return Promise.all(fetches)
       .then((results) => {
         this.initPrefetched = true
         const totalPrefetched = results.reduce((sum, d) => sum + (d?.length || 0), 0)
@@ -187,8 +222,26 @@ export class StreamingHttpReader {
         console.error('[StreamingHttpReader] Init pre-fetch failed:', err.message)
         throw err
       })
+  }
 
-    return this.initPrefetchPromise
+  /**
+   * Move the cache into native pages. Reads that hit a gap report it
+   * asynchronously, which becomes a background fetch of the chunk there.
+   */
+  async _createNativeCache() {
+    if (this.native) return
+    const native = await createRangeCache(this.fileSize, {
+      capacity: MAX_CACHE_SIZE,
+      onmiss: (offset) => {
+        this._backgroundPrefetch(offset, Math.min(CHUNK_SIZE, this.fileSize - offset))
+      }
+    })
+    if (!native) return
+
+    for (const range of this.cache) native.write(range.start, range.data)
+    this.native = native
+    this.cache = []
+    this.cacheSize = 0
   }
 
   /**
@@ -310,6 +363,12 @@ export class StreamingHttpReader {
    * Read from cache if available
    */
   readFromCache(offset, length) {
+    if (this.native) {
+      if (!this.native.has(offset, length)) return null
+      const data = Buffer.alloc(length)
+      this.native.readAt(offset, data)
+      return data
+    }
     for (const range of this.cache) {
       if (range.contains(offset, length)) {
         return range.read(offset, length)
@@ -322,6 +381,11 @@ export class StreamingHttpReader {
    * Add data to cache, evicting old entries if needed
    */
   addToCache(offset, data) {
+    if (this.native) {
+      this.native.write(offset, data)
+      return
+    }
+
     // Check if this range overlaps/extends existing ranges
     // For simplicity, just add as new range (could optimize with merge)
     const newRange = new CachedRange(offset, data)
@@ -362,6 +426,7 @@ export class StreamingHttpReader {
    * Check if range is fully in cache
    */
   hasInCache(offset, length) {
+    if (this.native) return this.native.has(offset, length)
     for (const range of this.cache) {
       if (range.contains(offset, length)) return true
     }
@@ -396,8 +461,17 @@ export class StreamingHttpReader {
     }
     this.lastReadPos = this.currentPos
 
-    // Try cache first
-    const cached = this.readFromCache(this.currentPos, toRead)
+    // Try cache first: natively, whatever is cached at the position
+    // (FFmpeg takes short reads), straight into its buffer
+    if (this.native) {
+      const n = this.native.readAt(this.currentPos, buffer.subarray(0, toRead))
+      if (n > 0) {
+        this.currentPos += n
+        return n
+      }
+    }
+
+    const cached = this.native ? null : this.readFromCache(this.currentPos, toRead)
     if (cached) {
       cached.copy(buffer, 0, 0, cached.length)
       this.currentPos += cached.length
@@ -500,8 +574,14 @@ export class StreamingHttpReader {
         this._backgroundPrefetch(newPos, Math.min(CHUNK_SIZE * 2, this.fileSize - newPos))
       }
 
-      // If seeking to end of file, also prefetch MKV Cues region
-      if (newPos > this.fileSize - CUES_PREFETCH_SIZE) {
+      // If seeking into the index, make sure the whole index is cached
+      if (this.indexSpan) {
+        const { start, end } = this.indexSpan
+        if (newPos >= start && newPos < end && !this.hasInCache(start, end - start)) {
+          this._backgroundPrefetch(start, end - start)
+        }
+      } else if (newPos > this.fileSize - CUES_PREFETCH_SIZE) {
+        // Index location unknown - prefetch the MKV Cues tail guess
         const cuesStart = Math.max(0, this.fileSize - CUES_PREFETCH_SIZE)
         if (!this.hasInCache(cuesStart, CUES_PREFETCH_SIZE)) {
           this._backgroundPrefetch(cuesStart, CUES_PREFETCH_SIZE)
@@ -552,7 +632,7 @@ export class StreamingHttpReader {
       : 0
     return {
       bytesDownloaded: this.bytesDownloaded,
-      cacheSize: this.cacheSize,
+      cacheSize: this.native ? this.native.stats().bytesCached : this.cacheSize,
       cacheHits: this.cacheHits,
       cacheMisses: this.cacheMisses,
       hitRate,
@@ -570,6 +650,8 @@ export class StreamingHttpReader {
     console.log('[StreamingHttpReader] Destroying - downloaded:', Math.round(stats.bytesDownloaded / 1024 / 1024) + 'MB, hit rate:', stats.hitRate + '%')
     this.cache = []
     this.cacheSize = 0
+    this.native?.destroy()
+    this.native = null
     this.pendingFetches.clear()
     this.backgroundPrefetches.clear()
   }
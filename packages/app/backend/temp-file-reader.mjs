@@ -25,6 +25,8 @@ import path from 'bare-path'
 import os from 'bare-os'
 import http from 'bare-http1'
 
+import { planIndexPrefetch, indexSpanBeyond } from './media-index.mjs'
+
 // Initial buffer before starting transcode
 // Keep this small for faster startup - we'll handle catching up gracefully
 const MIN_INITIAL_BUFFER = 20 * 1024 * 1024   // 20MB minimum - quick start
@@ -35,9 +37,13 @@ const MAX_INITIAL_BUFFER = 50 * 1024 * 1024   // 50MB max - balance between star
 const BUFFER_WAIT_TIMEOUT_MS = 30000
 
 // Tail prefetch to grab MKV Cues near end of file
+// Only used when the container index planner cannot locate the index exactly
 const TAIL_PREFETCH_BYTES = 10 * 1024 * 1024 // 10MB
 const TAIL_PREFETCH_TIMEOUT_MS = 30000
 
+// Timeout for each small range read made by the index planner
+const INDEX_PLAN_READ_TIMEOUT_MS = 15000
+
 // Abort if download stalls for too long (no new bytes)
 const DOWNLOAD_IDLE_TIMEOUT_MS = 60000
 
@@ -110,9 +116,12 @@ export class TempFileReader {
       fileSize
     )
 
-    // Tail prefetch (for MKV cues)
+    // Tail prefetch (for MKV cues / MP4 moov). Defaults to a fixed-size tail;
+    // _planTail() narrows it to the exact index range when it can.
     this.tailBytes = Math.min(TAIL_PREFETCH_BYTES, this.fileSize)
     this.tailStart = Math.max(0, this.fileSize - this.tailBytes)
+    this.tailEnd = this.fileSize
+    this.indexPlan = null
     this.tailDownloaded = 0
     this.tailComplete = this.fileSize <= this.initialBufferSize
     this.tailError = null
@@ -149,6 +158,7 @@ export class TempFileReader {
     // Prefetch tail first so MKV cues are available before FFmpeg starts.
     // Some environments appear to serialize HTTP reads, so doing tail first
     // avoids waiting on a long full-file download.
+    await this._planTail()
     this.tailPromise = this._prefetchTail()
     await this._waitForTail(TAIL_PREFETCH_TIMEOUT_MS)
 
@@ -300,6 +310,73 @@ export class TempFileReader {
     })
   }
 
+  /**
+   * Locate the container index (MKV Cues / MP4 moov) and narrow the tail
+   * prefetch to exactly that range. Costs a 64KB head read plus a few tiny
+   * header reads; falls back to the fixed-size tail when planning fails.
+   */
+  async _planTail() {
+    if (this.tailComplete || this.tailBytes <= 0 || this.fileSize <= this.initialBufferSize) return
+
+    const plan = await planIndexPrefetch(this.fileSize, (offset, length) => this._fetchRange(offset, length))
+    if (!plan) return
+
+    this.indexPlan = plan
+    const span = indexSpanBeyond(plan, this.initialBufferSize)
+    if (!span) {
+      // Index lives inside the initial buffer (faststart MP4, front Cues) or
+      // the file has none - nothing to fetch out of order.
+      console.log('[TempFileReader] Index within initial buffer, skipping tail prefetch')
+      this.tailBytes = 0
+      this.tailComplete = true
+      return
+    }
+
+    this.tailStart = span.start
+    this.tailEnd = span.end
+    this.tailBytes = span.end - span.start
+    console.log('[TempFileReader] Planned index prefetch:', this.tailStart + '-' + this.tailEnd,
+      '(' + Math.round(this.tailBytes / 1024) + 'KB instead of', Math.round(TAIL_PREFETCH_BYTES / 1024 / 1024) + 'MB)')
+  }
+
+  /**
+   * Fetch a small byte range into memory (used by the index planner)
+   * @returns {Promise<Buffer|null>}
+   */
+  _fetchRange(offset, length) {
+    return new Promise((resolve) => {
+      const options = {
+        method: 'GET',
+        hostname: this.parsedUrl.hostname,
+        port: this.parsedUrl.port || 80,
+        path: this.parsedUrl.pathname + this.parsedUrl.search,
+        headers: {
+          Range: `bytes=${offset}-${offset + length - 1}`
+        }
+      }
+
+      const chunks = []
+      const req = http.request(options, (res) => {
+        if (res.statusCode !== 206) {
+          res.resume()
+          resolve(null)
+          return
+        }
+        res.on('data', (chunk) => chunks.push(chunk))
+        res.on('end', () => resolve(Buffer.concat(chunks)))
+        res.on('error', () => resolve(null))
+      })
+
+      req.on('error', () => resolve(null))
+      req.setTimeout(INDEX_PLAN_READ_TIMEOUT_MS, () => {
+        req.destroy()
+        resolve(null)
+      })
+
+      req.end()
+    })
+  }
+
   /**
    * Prefetch tail bytes for MKV cues (range request)
    */
@@ -316,7 +393,7 @@ export class TempFileReader {
         port: this.parsedUrl.port || 80,
         path: this.parsedUrl.pathname + this.parsedUrl.search,
         headers: {
-          Range: `bytes=${this.tailStart}-${this.fileSize - 1}`
+          Range: `bytes=${this.tailStart}-${this.tailEnd - 1}`
         }
       }
 
@@ -638,6 +715,8 @@ export class TempFileReader {
       tailDownloaded: this.tailDownloaded,
       tailComplete: this.tailComplete,
       tailStart: this.tailStart,
+      tailEnd: this.tailEnd,
+      indexContainer: this.indexPlan?.container || null,
       fileSize: this.fileSize,
       currentPos: this.currentPos,
       readCount: this.readCount,
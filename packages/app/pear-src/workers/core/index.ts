@@ -116,7 +116,49 @@ let mpvFrameServerReady: Promise<number> | null = null;
 let castProxyServer: any = null;
 let castProxyPort = 0;
 let castProxyReady: Promise<number> | null = null;
-const castProxySessions = new Map<string, { url: string; createdAt: number; lastAccessAt?: number; transcodeSessionId?: string }>();
+const castProxySessions = new Map<string, { url: string; createdAt: number; lastAccessAt?: number; transcodeSessionId?: string; nativeRequests?: number }>();
+
+// bare-cast-proxy: native front for the cast proxy. It serves media bytes
+// off the JS thread and hands everything else (playlists, pings, unknown
+// tokens) to castProxyServer.
+let NativeCastProxy: any = null;
+let castProxyNative: any = null;
+let nativeCastProxyLoadError: string | null = null;
+let nativeCastProxyLoadPromise: Promise<void> | null = null;
+
+async function loadBareCastProxy(): Promise<void> {
+  if (NativeCastProxy || nativeCastProxyLoadError) return;
+  if (nativeCastProxyLoadPromise) return nativeCastProxyLoadPromise;
+  nativeCastProxyLoadPromise = (async () => {
+    let lastError: any;
+    if (typeof require === 'function') {
+      try {
+        const mod = require('bare-cast-proxy');
+        NativeCastProxy = mod?.CastProxy ?? mod?.default?.CastProxy ?? null;
+        if (NativeCastProxy) {
+          console.log('[Worker] bare-cast-proxy loaded');
+          return;
+        }
+      } catch (err: any) {
+        lastError = err;
+      }
+    }
+    try {
+      const mod = await import('bare-cast-proxy');
+      NativeCastProxy = (mod as any)?.CastProxy ?? (mod as any)?.default?.CastProxy ?? null;
+      if (!NativeCastProxy) {
+        throw new Error('bare-cast-proxy export missing CastProxy');
+      }
+      console.log('[Worker] bare-cast-proxy loaded');
+      return;
+    } catch (err: any) {
+      lastError = err;
+    }
+    nativeCastProxyLoadError = lastError?.message || 'Unknown error';
+    console.warn('[Worker] bare-cast-proxy not available:', nativeCastProxyLoadError);
+  })();
+  return nativeCastProxyLoadPromise;
+}
 const CAST_PROXY_TTL_MS = 30 * 60 * 1000;
 const castProxyPlaylistLogged = new Set<string>();
 
@@ -222,15 +264,69 @@ async function ensureMpvFrameServer(): Promise<number> {
   return mpvFrameServerReady;
 }
 
+function removeCastProxySession(token: string) {
+  castProxySessions.delete(token);
+  if (!castProxyNative) return;
+  try {
+    const stats = castProxyNative.stats(token);
+    if (stats?.requests) {
+      console.log('[CastProxy] native session', token, 'requests:', stats.requests,
+        'cache hits:', stats.cacheHits, 'coalesced:', stats.coalesced,
+        'MB out:', (stats.bytesOut / 1048576).toFixed(1),
+        'MB/s:', (stats.throughput / 1048576).toFixed(1),
+        'cpu ms:', stats.cpuTime.toFixed(1), `(${stats.cpuPercent.toFixed(1)}%)`);
+    }
+    castProxyNative.removeSession(token);
+  } catch {}
+}
+
+function clearCastProxySessions() {
+  for (const token of Array.from(castProxySessions.keys())) {
+    removeCastProxySession(token);
+  }
+}
+
 function cleanupCastProxySessions(now = Date.now()) {
   for (const [token, entry] of castProxySessions.entries()) {
+    // Requests the native proxy served never reach castProxyServer
+    const native = castProxyNative?.stats(token);
+    if (native && (native.active > 0 || native.requests !== entry.nativeRequests)) {
+      entry.nativeRequests = native.requests;
+      entry.lastAccessAt = now;
+    }
     const lastSeen = entry.lastAccessAt || entry.createdAt;
     if (now - lastSeen > CAST_PROXY_TTL_MS) {
-      castProxySessions.delete(token);
+      removeCastProxySession(token);
     }
   }
 }
 
+/**
+ * Put the native proxy in front of castProxyServer (listening on
+ * fallbackPort); returns its port, or 0 to use castProxyServer directly
+ */
+function startNativeCastProxy(fallbackPort: number): number {
+  if (!NativeCastProxy || !fallbackPort) return 0;
+  try {
+    castProxyNative = new NativeCastProxy();
+    const port = castProxyNative.listen({ fallbackPort, host: '0.0.0.0' });
+    console.log('[CastProxy] native proxy on port', port, '-> fallback', fallbackPort);
+    return port;
+  } catch (err: any) {
+    console.warn('[CastProxy] native proxy unavailable:', err?.message || err);
+    stopNativeCastProxy();
+    return 0;
+  }
+}
+
+function stopNativeCastProxy() {
+  if (!castProxyNative) return;
+  try {
+    castProxyNative.destroy();
+  } catch {}
+  castProxyNative = null;
+}
+
 function buildLocalProxyTarget(url: string): URL | null {
   try {
     const parsed = new URL(url);
@@ -248,11 +344,16 @@ async function ensureCastProxyServer(): Promise<number> {
   if (castProxyReady) return castProxyReady;
 
   const resetProxyState = () => {
+    stopNativeCastProxy();
     castProxyPort = 0;
     castProxyReady = null;
     castProxyServer = null;
   };
 
+  await loadBareCastProxy();
+  if (castProxyPort) return castProxyPort;
+  if (castProxyReady) return castProxyReady;
+
   castProxyReady = new Promise((resolve, reject) => {
     const setCorsHeaders = (res: any) => {
       res.setHeader('Access-Control-Allow-Origin', '*');
@@ -606,8 +707,8 @@ async function ensureCastProxyServer(): Promise<number> {
 
     castProxyServer.listen(0, '0.0.0.0', () => {
       const addr = castProxyServer.address?.() || null;
-      castProxyPort = addr?.port || 0;
-      console.log('[CastProxy] listening on', addr?.address || '0.0.0.0', 'port:', castProxyPort);
+      console.log('[CastProxy] listening on', addr?.address || '0.0.0.0', 'port:', addr?.port || 0);
+      castProxyPort = startNativeCastProxy(addr?.port || 0) || addr?.port || 0;
       resolve(castProxyPort);
     });
   });
@@ -628,6 +729,15 @@ async function createCastProxyUrl(targetHost: string | undefined, sourceUrl: str
   cleanupCastProxySessions();
   const token = `${Date.now().toString(36)}${Math.random().toString(36).slice(2, 10)}`;
   castProxySessions.set(token, { url: sourceUrl, createdAt: Date.now(), lastAccessAt: Date.now(), transcodeSessionId });
+  if (castProxyNative) {
+    try {
+      if (!castProxyNative.addSession(token, sourceUrl)) {
+        console.log('[CastProxy] source not served natively, using JS proxy:', sourceUrl);
+      }
+    } catch (err: any) {
+      console.warn('[CastProxy] native session failed:', err?.message || err);
+    }
+  }
   return `http://${localIp}:${castProxyPort}/cast/${token}`;
 }
 
@@ -4204,7 +4314,7 @@ rpc.onCastDisconnect(async () => {
   if (!castContext) return { success: true };
   try {
     await castContext.disconnect();
-    castProxySessions.clear();
+    clearCastProxySessions();
 
     // Clean up transcoded file cache when cast session ends
     if (activeCastTranscodeId) {
@@ -4567,7 +4677,7 @@ rpc.onCastStop(async () => {
   }
   try {
     await castContext.stop();
-    castProxySessions.clear();
+    clearCastProxySessions();
 
     // Clean up transcoded file cache when cast stops
     if (activeCastTranscodeId) {
@@ -4783,10 +4893,11 @@ if (castProxyServer) {
   } catch (err: any) {
     console.warn('[CastProxy] close error:', err?.message);
   }
+  clearCastProxySessions();
+  stopNativeCastProxy();
   castProxyServer = null;
   castProxyPort = 0;
   castProxyReady = null;
-  castProxySessions.clear();
 }
 
 // Clean up transcode sessions
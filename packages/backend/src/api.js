@@ -10,7 +10,8 @@ import crypto from 'hypercore-crypto';
 import HypercoreID from 'hypercore-id-encoding';
 import z32 from 'z32';
 import c from 'compact-encoding';
-import { loadDrive, createDrive, getVideoUrl, getVideoUrlFromBlob, waitForDriveSync, loadChannel, loadPublicBee, pairDevice as pairChannelDevice, suspendNetworking, resumeNetworking, getNetworkStats, getNetworkStatsReadable } from './storage.js';
+import { loadDrive, createDrive, getVideoUrl, getVideoUrlFromBlob, waitForDriveSync, loadChannel, loadPublicBee, pairDevice as pairChannelDevice, suspendNetworking, resumeNetworking, getNetworkStats, getNetworkStatsReadable, getPeerStats, getPeerNetworkStats } from './storage.js';
+import { PlaybackScheduler } from './block-scheduler.js';
 import { SemanticFinder } from './search/semantic-finder.js';
 import { FederatedSearch } from './search/federated-search.js';
 import { Recommender } from './recommendations/recommender.js';
@@ -76,7 +77,12 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
    */
   async function ensureSemanticFinder(context) {
     if (!context.semanticFinder) {
-      context.semanticFinder = new SemanticFinder({ metaDb: context.metaDb })
+      context.semanticFinder = new SemanticFinder({
+        metaDb: context.metaDb,
+        indexPath: context.storagePath ? context.storagePath + '/semantic-index.bvi' : null,
+        // Optional int8 model for the native encoder (bare-embed convert.js)
+        encoderPath: context.storagePath ? context.storagePath + '/models/sentence-encoder.bin' : null
+      })
       await context.semanticFinder.init()
       await context.semanticFinder.loadIndex()
       console.log('[API] SemanticFinder initialized, index size:', context.semanticFinder.globalSize())
@@ -95,13 +101,7 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
     ;(async () => {
       try {
         const finder = await ensureSemanticFinder(ctx)
-        let indexed = 0
-        for (const video of videos) {
-          if (!finder.hasVideo(video.id)) {
-            await finder.indexFromMetadata(video, channelKey)
-            indexed++
-          }
-        }
+        const indexed = await finder.indexFromMetadataBatch(videos, channelKey)
         if (indexed > 0) {
           console.log('[API] Background indexed', indexed, 'videos from channel:', channelKey?.slice(0, 16))
         }
@@ -1073,7 +1073,9 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
           blobMeta = {
             blobsCoreKey: v.blobsCoreKey,
             blobId: v.blobId,
-            byteLength: v?.size || v?.byteLength || 0
+            byteLength: v?.size || v?.byteLength || 0,
+            durationMs: (v?.duration || 0) * 1000,
+            keyframeIndexBlobId: v?.keyframeIndexBlobId || null
           }
           console.log('[API] Prefetch using blobsCoreKey:', v.blobsCoreKey?.slice(0, 16))
         } else if (v?.blobsCoreKey && v?.path) {
@@ -1243,17 +1245,50 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
             uploadSpeed: () => (Date.now() - lastUploadTime > 2000 ? 0 : uploadSpeed)
           }
 
+          // Fetch in deadline order from the player's read position when the
+          // scheduler addon is available, otherwise as one range download
+          const scheduler = !wasCached && PlaybackScheduler.available
+            ? new PlaybackScheduler(core, {
+                start: startBlock,
+                end: endBlock,
+                byteLength: totalBytes,
+                durationMs: blobMeta.durationMs,
+                peerStats: getPeerNetworkStats()
+              })
+            : null
+
+          // Keyframe index (stored next to the video at upload, same blobs
+          // core): gives the scheduler real media time per block. Fetched
+          // alongside, so prefetch never waits on it
+          if (scheduler && typeof blobMeta.keyframeIndexBlobId === 'string') {
+            const parts = blobMeta.keyframeIndexBlobId.split(':').map(Number)
+            if (parts.length === 4) {
+              const [blockOffset, blockLength, byteOffset, byteLength] = parts
+              import('hyperblobs').then(async ({ default: Hyperblobs }) => {
+                const blobs = new Hyperblobs(core)
+                await blobs.ready()
+                const bytes = await blobs.get({ blockOffset, blockLength, byteOffset, byteLength }, { timeout: 15000 })
+                if (bytes && !scheduler.destroyed && scheduler.useKeyframeIndex(bytes)) {
+                  console.log('[API] Prefetch using keyframe index')
+                }
+              }).catch((err) => {
+                console.log('[API] Keyframe index unavailable:', err?.message)
+              })
+            }
+          }
+
           core.on('download', onDownload)
           core.on('upload', onUpload)
           if (videoStats) {
             videoStats.registerMonitor(driveKey, videoPath, monitor, () => {
               core.off('download', onDownload)
               core.off('upload', onUpload)
+              scheduler?.destroy()
             })
           }
 
           if (!wasCached) {
-            const downloadRange = core.download({ start: startBlock, end: endBlock })
+            const downloadRange = scheduler ? scheduler.begin() : core.download({ start: startBlock, end: endBlock })
             downloadRange.done().then(() => {
               console.log('[API] Download complete (blobs)')
               downloadSpeed = 0
@@ -1347,7 +1382,7 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
         if (initialAvailable === totalBlocks) {
           console.log('[API] Already fully cached');
           if (seedingManager) {
-            await seedingManager.addSeed(resolvedDriveKey, resolvedPath, 'watched', blob);
+            await seedingManager.addSeed(resolvedDriveKey, resolvedPath, 'watched', { ...blob, blobsCoreKey: b4a.toString(core.key, 'hex') });
           }
           return {
             success: true,
@@ -1394,7 +1429,7 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
               markedAsCached = true;
               console.log('[API] 100% complete');
               if (seedingManager) {
-                await seedingManager.addSeed(resolvedDriveKey, resolvedPath, 'watched', blob);
+                await seedingManager.addSeed(resolvedDriveKey, resolvedPath, 'watched', { ...blob, blobsCoreKey: b4a.toString(core.key, 'hex') });
               }
             }
           } catch (e) {
@@ -1973,10 +2008,11 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
      * @param {string} query - Search query
      * @param {Object} [options]
      * @param {number} [options.topK=50] - Max results to return
+     * @param {string} [options.channelKey] - Restrict results to one channel
      * @returns {Promise<Array<{id: string, score: number, metadata: any}>>}
      */
     async globalSearchVideos(query, options = {}) {
-      const { topK = 50 } = options
+      const { topK = 50, channelKey = null } = options
 
       console.log('[API] globalSearchVideos:', query, 'topK:', topK)
 
@@ -1995,7 +2031,7 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
       }
 
       // Fast global search - O(1) not O(channels)
-      const results = await finder.globalSearch(query, topK)
+      const results = await finder.globalSearch(query, topK, { channelKey })
       console.log('[API] globalSearchVideos: found', results.length, 'results in global index')
 
       return results
@@ -2706,12 +2742,13 @@ export function createApi({ ctx, publicFeed, seedingManager, videoStats }) {
 
     /**
      * Get network stats for debugging.
-     * @returns {{stats: Object|null, readable: string}}
+     * @returns {{stats: Object|null, readable: string, peers: Object|null}}
      */
     getNetworkDebugStats() {
       return {
         stats: getNetworkStats(),
-        readable: getNetworkStatsReadable()
+        readable: getNetworkStatsReadable(),
+        peers: getPeerStats()
       }
     }
   };
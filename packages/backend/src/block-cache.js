@@ -0,0 +1,257 @@
+/**
+ * BlockAccessMap - Block-granular access tracking for seeded blobs
+ *
+ * Records when each range of hyperblobs blocks was last read locally (blob
+ * server streams, HypercoreIOReader), so quota enforcement can clear the
+ * cold parts of a partly watched video instead of keeping or dropping the
+ * whole blob. Ranges are fixed runs of CHUNK_BLOCKS blocks of one core.
+ *
+ * Also remembers what was cleared, so a later read of it counts as a cold
+ * miss: the player had to wait for peers to refetch data we evicted.
+ * Reclaimed bytes against cold misses is the measure of how well eviction
+ * picks ranges. Several blobs can share a range, so cleared state is kept
+ * per blob: the block span [start, end) of one blob inside one range.
+ *
+ * Persisted as one compact-encoded buffer: per core, delta-coded range
+ * indexes with last-access seconds, then the cleared spans.
+ */
+
+import b4a from 'b4a';
+import c from 'compact-encoding';
+
+// 64 blocks = 4 MiB at the default 64 KiB hyperblobs block size
+export const CHUNK_BLOCKS = 64;
+
+const VERSION = 2;
+
+/**
+ * @typedef {Object} CoreAccess
+ * @property {Map<number, number>} access - range index -> last access (unix seconds)
+ * @property {Map<number, Array<[number, number]>>} cleared - range index -> block spans cleared from disk
+ */
+
+function sortedSpans(cleared) {
+  const spans = [];
+  for (const list of cleared.values()) spans.push(...list);
+  return spans.sort((a, b) => a[0] - b[0]);
+}
+
+const coreAccess = {
+  preencode(state, m) {
+    c.fixed32.preencode(state, m.key);
+    const access = [...m.access.keys()].sort((a, b) => a - b);
+    c.uint.preencode(state, access.length);
+    let prev = 0;
+    for (const i of access) {
+      c.uint.preencode(state, i - prev);
+      c.uint32.preencode(state, m.access.get(i));
+      prev = i;
+    }
+    const cleared = sortedSpans(m.cleared);
+    c.uint.preencode(state, cleared.length);
+    prev = 0;
+    for (const [start, end] of cleared) {
+      c.uint.preencode(state, start - prev);
+      c.uint.preencode(state, end - start);
+      prev = start;
+    }
+  },
+  encode(state, m) {
+    c.fixed32.encode(state, m.key);
+    const access = [...m.access.keys()].sort((a, b) => a - b);
+    c.uint.encode(state, access.length);
+    let prev = 0;
+    for (const i of access) {
+      c.uint.encode(state, i - prev);
+      c.uint32.encode(state, m.access.get(i));
+      prev = i;
+    }
+    const cleared = sortedSpans(m.cleared);
+    c.uint.encode(state, cleared.length);
+    prev = 0;
+    for (const [start, end] of cleared) {
+      c.uint.encode(state, start - prev);
+      c.uint.encode(state, end - start);
+      prev = start;
+    }
+  },
+  decode(state) {
+    const key = c.fixed32.decode(state);
+    const access = new Map();
+    let i = 0;
+    for (let n = c.uint.decode(state); n > 0; n--) {
+      i += c.uint.decode(state);
+      access.set(i, c.uint32.decode(state));
+    }
+    const cleared = new Map();
+    i = 0;
+    for (let n = c.uint.decode(state); n > 0; n--) {
+      i += c.uint.decode(state);
+      const range = Math.floor(i / CHUNK_BLOCKS);
+      const spans = cleared.get(range);
+      const span = [i, i + c.uint.decode(state)];
+      if (spans) spans.push(span);
+      else cleared.set(range, [span]);
+    }
+    return { key, access, cleared };
+  }
+};
+
+const accessMapEncoding = {
+  preencode(state, cores) {
+    c.uint.preencode(state, VERSION);
+    c.uint.preencode(state, cores.length);
+    for (const core of cores) coreAccess.preencode(state, core);
+  },
+  encode(state, cores) {
+    c.uint.encode(state, VERSION);
+    c.uint.encode(state, cores.length);
+    for (const core of cores) coreAccess.encode(state, core);
+  },
+  decode(state) {
+    if (c.uint.decode(state) !== VERSION) return [];
+    const cores = [];
+    for (let n = c.uint.decode(state); n > 0; n--) cores.push(coreAccess.decode(state));
+    return cores;
+  }
+};
+
+export class BlockAccessMap {
+  constructor() {
+    /** @type {Map<string, CoreAccess>} blobs core key (hex) -> ranges */
+    this.cores = new Map();
+    /** @type {((coreKeyHex: string, range: number, start: number) => void) | null} called with the cleared span's first block */
+    this.onColdMiss = null;
+    this.dirty = false;
+    this.stats = { touches: 0, coldMisses: 0 };
+  }
+
+  /**
+   * @param {string} coreKeyHex
+   * @returns {CoreAccess}
+   */
+  _core(coreKeyHex) {
+    let entry = this.cores.get(coreKeyHex);
+    if (!entry) {
+      entry = { access: new Map(), cleared: new Map() };
+      this.cores.set(coreKeyHex, entry);
+    }
+    return entry;
+  }
+
+  /**
+   * Record a local read of one block
+   * @param {string} coreKeyHex
+   * @param {number} block
+   * @param {number} [now] - ms
+   */
+  touch(coreKeyHex, block, now = Date.now()) {
+    const range = Math.floor(block / CHUNK_BLOCKS);
+    const entry = this._core(coreKeyHex);
+    const seconds = Math.floor(now / 1000);
+    this.stats.touches++;
+
+    const spans = entry.cleared.get(range);
+    const i = spans ? spans.findIndex(([start, end]) => block >= start && block < end) : -1;
+    if (i !== -1) {
+      const [start] = spans[i];
+      spans.splice(i, 1);
+      if (spans.length === 0) entry.cleared.delete(range);
+      this.dirty = true;
+      this.stats.coldMisses++;
+      if (this.onColdMiss) this.onColdMiss(coreKeyHex, range, start);
+    }
+    if (entry.access.get(range) !== seconds) {
+      entry.access.set(range, seconds);
+      this.dirty = true;
+    }
+  }
+
+  /**
+   * Last access of a range in ms, or 0 if never read
+   * @param {string} coreKeyHex
+   * @param {number} range
+   * @returns {number}
+   */
+  lastAccess(coreKeyHex, range) {
+    const seconds = this.cores.get(coreKeyHex)?.access.get(range);
+    return seconds ? seconds * 1000 : 0;
+  }
+
+  /**
+   * Whether a block lies in a cleared span
+   * @param {string} coreKeyHex
+   * @param {number} block
+   * @returns {boolean}
+   */
+  isCleared(coreKeyHex, block) {
+    const spans = this.cores.get(coreKeyHex)?.cleared.get(Math.floor(block / CHUNK_BLOCKS));
+    return spans ? spans.some(([start, end]) => block >= start && block < end) : false;
+  }
+
+  /**
+   * Record one blob's blocks [start, end) inside a range as cleared
+   * @param {string} coreKeyHex
+   * @param {number} start
+   * @param {number} end
+   */
+  markCleared(coreKeyHex, start, end) {
+    if (end <= start || this.isCleared(coreKeyHex, start)) return;
+    const cleared = this._core(coreKeyHex).cleared;
+    const range = Math.floor(start / CHUNK_BLOCKS);
+    const spans = cleared.get(range);
+    if (spans) spans.push([start, end]);
+    else cleared.set(range, [[start, end]]);
+    this.dirty = true;
+  }
+
+  /**
+   * Forget a blob's blocks [startBlock, endBlock) (its seed is gone and the
+   * whole blob cleared). Its cleared spans go; access times go only for
+   * ranges no other blob still uses.
+   * @param {string} coreKeyHex
+   * @param {number} startBlock
+   * @param {number} endBlock
+   * @param {(range: number) => boolean} [shared] - Whether another blob uses a range
+   */
+  forget(coreKeyHex, startBlock, endBlock, shared = () => false) {
+    const entry = this.cores.get(coreKeyHex);
+    if (!entry) return;
+    const first = Math.floor(startBlock / CHUNK_BLOCKS);
+    const last = Math.ceil(endBlock / CHUNK_BLOCKS);
+    for (let range = first; range < last; range++) {
+      const spans = entry.cleared.get(range);
+      if (spans) {
+        const kept = spans.filter(([start]) => start < startBlock || start >= endBlock);
+        if (kept.length > 0) entry.cleared.set(range, kept);
+        else entry.cleared.delete(range);
+      }
+      if (!shared(range)) entry.access.delete(range);
+    }
+    if (entry.access.size === 0 && entry.cleared.size === 0) this.cores.delete(coreKeyHex);
+    this.dirty = true;
+  }
+
+  /**
+   * @returns {Buffer}
+   */
+  encode() {
+    const cores = [];
+    for (const [hex, entry] of this.cores) {
+      cores.push({ key: b4a.from(hex, 'hex'), access: entry.access, cleared: entry.cleared });
+    }
+    return c.encode(accessMapEncoding, cores);
+  }
+
+  /**
+   * @param {Buffer|Uint8Array} buffer
+   * @returns {BlockAccessMap}
+   */
+  static decode(buffer) {
+    const map = new BlockAccessMap();
+    for (const core of c.decode(accessMapEncoding, buffer)) {
+      map.cores.set(b4a.toString(core.key, 'hex'), { access: core.access, cleared: core.cleared });
+    }
+    return map;
+  }
+}
@@ -0,0 +1,339 @@
+/**
+ * PlaybackScheduler - Deadline-ordered block fetching for a video blob
+ *
+ * Prefetching used to be one core.download() over the whole blob, which
+ * hypercore fills in its own order, so blocks right after the playhead (or
+ * after a seek) compete with blocks minutes ahead. This drives the
+ * bare-block-scheduler addon instead:
+ *
+ * - playhead: inferred from block reads of the blob core by any session
+ *   (the blob server feeding the player); a jump restarts the estimate,
+ *   and the buffer level is media read since then minus time elapsed.
+ *   Media time per block comes from the upload-time keyframe index when
+ *   the video has one (useKeyframeIndex), else from the average bitrate
+ * - peers: the core's replication peers, seeded with their round trip and
+ *   received rate from PeerNetworkStats; throughput is then learnt from
+ *   deliveries ('download' events carry the sending peer)
+ * - actions: requests become single-block downloads; cancels (preemption
+ *   after a seek, losing copies) destroy them; a failed download is
+ *   reported as transient and retried after the scheduler's backoff
+ *
+ * Hypercore's replicator picks the wire peer for a block and has no public
+ * per-peer request, so the scheduler's peer assignment bounds how many
+ * blocks are in flight and in what order. A block has at most one download:
+ * a hedge of a block already downloading is released back to the scheduler
+ * rather than counted as a second copy, and hypercore retries on its own.
+ */
+
+import b4a from 'b4a';
+
+// Native scheduler (Bare only); without it prefetch keeps its range download
+let NativeBlockScheduler = null;
+try {
+  const mod = await import('bare-block-scheduler');
+  NativeBlockScheduler = (mod.default || mod).BlockScheduler || null;
+} catch {}
+
+// Keyframe index decoder (Bare only, as is the scheduler)
+let decodeKeyframeIndex = null;
+try {
+  const mod = await import('bare-media-index');
+  decodeKeyframeIndex = (mod.default || mod).decodeKeyframeIndex || null;
+} catch {}
+
+const POLL_MS = 50;
+const PEER_REFRESH_MS = 1000;
+
+// Media byte rate assumed when the video has no duration (5 Mbit/s)
+const DEFAULT_BYTES_PER_SECOND = 625000;
+
+// A read further than this from the last one is a seek
+const SEEK_BLOCKS = 8;
+
+// Blocks checked per has() while looking for what is already local
+const LOCAL_SCAN_CHUNK = 256;
+
+export class PlaybackScheduler {
+  /** Whether the native scheduler is available */
+  static get available() {
+    return Boolean(NativeBlockScheduler);
+  }
+
+  /**
+   * @param {any} core - Hypercore holding the blob (ready)
+   * @param {Object} opts
+   * @param {number} opts.start - First block of the blob
+   * @param {number} opts.end - End block (exclusive)
+   * @param {number} [opts.byteLength] - Blob size in bytes
+   * @param {number} [opts.durationMs] - Media duration
+   * @param {import('./peer-stats.js').PeerNetworkStats|null} [opts.peerStats]
+   */
+  constructor(core, opts) {
+    if (!NativeBlockScheduler) throw new Error('bare-block-scheduler is not available');
+
+    const blocks = Math.max(1, opts.end - opts.start);
+    const blockBytes = opts.byteLength > 0 ? opts.byteLength / blocks : 65536;
+    const bytesPerSecond = opts.durationMs > 0 && opts.byteLength > 0
+      ? opts.byteLength / (opts.durationMs / 1000)
+      : DEFAULT_BYTES_PER_SECOND;
+
+    this.core = core;
+    this.start = opts.start;
+    this.end = opts.end;
+    this.blockBytes = blockBytes;
+    this.blockMs = blockBytes / bytesPerSecond * 1000;
+    /** @type {{durationMs: number, headEnd: number, times: Float64Array, offsets: Float64Array}|null} */
+    this.keyframes = null;
+    this.peerStats = opts.peerStats || null;
+    this.keyHex = b4a.toString(core.key, 'hex');
+
+    this.scheduler = new NativeBlockScheduler({
+      start: opts.start,
+      end: opts.end,
+      blockBytes: Math.max(1, Math.round(blockBytes)),
+      blockMs: Math.max(1, this.blockMs)
+    });
+
+    /** @type {Set<string>} peers known to the scheduler */
+    this.peers = new Set();
+    /** @type {Map<number, {download: any, peer: string, cancelled: boolean}>} block -> pending download */
+    this.downloads = new Map();
+
+    // Read position: block reads since the last jump
+    this.readFrom = -1;
+    this.readStartedAt = 0;
+    this.lastRead = -1;
+
+    this.destroyed = false;
+    this._timer = null;
+    this._peersAt = 0;
+    this._offRead = null;
+    this._ondownload = null;
+    this._onclose = null;
+    this._done = null;
+  }
+
+  /**
+   * Start fetching; resolves done() and frees the scheduler once every
+   * block is local
+   * @returns {PlaybackScheduler}
+   */
+  begin() {
+    if (this._timer || this.destroyed) return this;
+
+    let resolve, reject;
+    const promise = new Promise((res, rej) => {
+      resolve = res;
+      reject = rej;
+    });
+    promise.catch(() => {});
+    this._done = { promise, resolve, reject };
+
+    if (this.peerStats) this._offRead = this.peerStats.onRead(this.keyHex, (index) => this._onRead(index));
+
+    this._ondownload = (index, byteLength, from) => {
+      if (this.destroyed || index < this.start || index >= this.end) return;
+      const peer = from?.remotePublicKey ? b4a.toString(from.remotePublicKey, 'hex') : null;
+      this.scheduler.received(index, peer, byteLength);
+    };
+    this.core.on('download', this._ondownload);
+    this._onclose = () => this.destroy();
+    this.core.once('close', this._onclose);
+
+    this._scanLocal().catch(() => {});
+    this._timer = setInterval(() => this._tick(), POLL_MS);
+    this._tick();
+    return this;
+  }
+
+  /**
+   * @returns {Promise<void>}
+   */
+  done() {
+    if (!this._done) this.begin();
+    return this._done.promise;
+  }
+
+  // Blocks already stored (partially watched videos) are marked in chunks
+  async _scanLocal() {
+    for (let i = this.start; i < this.end && !this.destroyed; i += LOCAL_SCAN_CHUNK) {
+      const to = Math.min(this.end, i + LOCAL_SCAN_CHUNK);
+      if (!(await this.core.has(i, to)) || this.destroyed) continue;
+      for (let b = i; b < to; b++) this.scheduler.have(b);
+    }
+  }
+
+  _onRead(index) {
+    if (index < this.start || index >= this.end) return;
+    if (this.readFrom === -1 || index < this.lastRead || index > this.lastRead + SEEK_BLOCKS) {
+      this.readFrom = index;
+      this.readStartedAt = Date.now();
+      this.lastRead = index;
+      return;
+    }
+    this.lastRead = index;
+  }
+
+  /**
+   * Use the video's keyframe index (bare-media-index format, stored at
+   * upload as keyframeIndexBlobId) for the media time of blocks, so the
+   * buffer level follows the real bitrate rather than the average
+   * @param {Uint8Array} bytes
+   * @returns {boolean} whether the index was usable
+   */
+  useKeyframeIndex(bytes) {
+    const index = decodeKeyframeIndex ? decodeKeyframeIndex(bytes) : null;
+    if (!index || index.times.length < 2) return false;
+    this.keyframes = index;
+    return true;
+  }
+
+  // Media time (ms) at the start of a block: interpolated between the
+  // keyframes around its byte offset; the header before headEnd is time 0
+  _mediaMs(block) {
+    const { headEnd, times, offsets } = this.keyframes;
+    const byte = (block - this.start) * this.blockBytes;
+    if (byte <= headEnd || byte <= offsets[0]) return 0;
+
+    let lo = 0;
+    let hi = offsets.length - 1;
+    while (lo < hi) {
+      const mid = (lo + hi + 1) >>> 1;
+      if (offsets[mid] <= byte) lo = mid;
+      else hi = mid - 1;
+    }
+    // After the last keyframe, run on to the end of the media
+    const last = lo === offsets.length - 1;
+    const nextOffset = last ? (this.end - this.start) * this.blockBytes : offsets[lo + 1];
+    const nextTime = last ? Math.max(times[lo], this.keyframes.durationMs || 0) : times[lo + 1];
+    const span = nextOffset - offsets[lo];
+    const fraction = span > 0 ? Math.min(1, (byte - offsets[lo]) / span) : 0;
+    return times[lo] + fraction * (nextTime - times[lo]);
+  }
+
+  // Next block the player needs and the media it holds before needing it
+  _position(now) {
+    if (this.readFrom === -1) return { next: this.start, bufferMs: 0 };
+    const next = this.lastRead + 1;
+    const readMs = this.keyframes
+      ? this._mediaMs(next) - this._mediaMs(this.readFrom)
+      : (next - this.readFrom) * this.blockMs;
+    return { next, bufferMs: Math.max(0, readMs - (now - this.readStartedAt)) };
+  }
+
+  _refreshPeers(now) {
+    this._peersAt = now;
+
+    const entries = new Map();
+    try {
+      for (const entry of this.peerStats?.snapshot().peers || []) entries.set(entry.key, entry);
+    } catch {}
+
+    const live = new Set();
+    for (const peer of this.core.peers || []) {
+      if (!peer?.remotePublicKey) continue;
+      const key = b4a.toString(peer.remotePublicKey, 'hex');
+      live.add(key);
+      const entry = entries.get(key);
+      // Throughput only seeds a new peer; after that it is learnt
+      this.scheduler.addPeer(key, {
+        throughput: this.peers.has(key) ? 0 : entry?.rxRateSlow || 0,
+        rtt: entry?.rtt || 0
+      });
+    }
+    for (const key of this.peers) {
+      if (!live.has(key)) this.scheduler.removePeer(key);
+    }
+    this.peers = live;
+  }
+
+  _tick() {
+    if (this.destroyed) return;
+    const now = Date.now();
+    try {
+      if (now - this._peersAt >= PEER_REFRESH_MS) this._refreshPeers(now);
+
+      const { next, bufferMs } = this._position(now);
+      this.scheduler.playhead(next, bufferMs, now);
+      for (const action of this.scheduler.poll(now)) this._apply(action);
+
+      if (this.scheduler.missing === 0) {
+        this._done?.resolve();
+        this.destroy();
+      }
+    } catch (err) {
+      this._done?.reject(err);
+      this.destroy();
+    }
+  }
+
+  _apply(action) {
+    const block = action.block;
+    const pending = this.downloads.get(block);
+
+    if (action.type === 'cancel') {
+      if (!pending || pending.peer !== action.peer) return;
+      this.downloads.delete(block);
+      pending.cancelled = true;
+      pending.download.destroy?.();
+      return;
+    }
+
+    if (pending) {
+      // A hedge is not a second download; a request is the block requeued
+      // after its peer left, still covered by the download in flight
+      if (action.type === 'hedge') this.scheduler.release(block, action.peer);
+      else pending.peer = action.peer;
+      return;
+    }
+
+    const entry = { download: this.core.download({ blocks: [block] }), peer: action.peer, cancelled: false };
+    this.downloads.set(block, entry);
+    const settle = () => {
+      if (this.downloads.get(block) !== entry) return false;
+      this.downloads.delete(block);
+      return !this.destroyed;
+    };
+    entry.download.done().then(() => {
+      // Local blocks complete without a 'download' event
+      if (settle()) this.scheduler.have(block);
+    }, () => {
+      // The download was the block's only copy; retry it after a backoff
+      if (settle() && !entry.cancelled) this.scheduler.failed(block, entry.peer);
+    });
+  }
+
+  /**
+   * Progress counters
+   * @returns {{missing: number, inflight: number, peers: number, requests: number, hedges: number, hedgeWins: number, cancels: number, preemptions: number, received: number, late: number, failures: number, memory: number}|null}
+   */
+  stats() {
+    return this.destroyed ? null : this.scheduler.stats();
+  }
+
+  _stop() {
+    if (this._timer) clearInterval(this._timer);
+    this._timer = null;
+    this._offRead?.();
+    this._offRead = null;
+    if (this._ondownload) this.core.off('download', this._ondownload);
+    this._ondownload = null;
+    if (this._onclose) this.core.off('close', this._onclose);
+    this._onclose = null;
+  }
+
+  /** Stop fetching and free the native scheduler; safe to call repeatedly */
+  destroy() {
+    if (this.destroyed) return;
+    this._stop();
+    this.destroyed = true;
+    for (const entry of this.downloads.values()) {
+      entry.cancelled = true;
+      entry.download.destroy?.();
+    }
+    this.downloads.clear();
+    this.scheduler.destroy();
+    // No-op once done() has resolved
+    this._done?.reject(new Error('Playback scheduler closed'));
+  }
+}
@@ -90,6 +90,12 @@ export class MultiWriterChannel extends ReadyResource {
     /** @type {Map<string, {count: number, windowStartMs: number}>} */
     this._localRateLimits = new Map()
 
+    // Source blob -> video id, as of view length `length` (findVideoByBlob)
+    /** @type {{view: any, length: number, videos: Map<string, string>}} */
+    this._blobIndex = { view: null, length: 0, videos: new Map() }
+    /** @type {Promise<void>|null} */
+    this._blobIndexing = null
+
     this.ready().catch(() => {})
   }
 
@@ -1146,6 +1152,58 @@ export class MultiWriterChannel extends ReadyResource {
     return res?.value || null
   }
 
+  /**
+   * Find a video by its source blob, from the current view without waiting
+   * for an update (callers already have the video on screen). Goes through
+   * a blob -> video id index kept up to date from the view's diffs.
+   * @param {string} blobsCoreKey
+   * @param {string} blobId
+   */
+  async findVideoByBlob(blobsCoreKey, blobId) {
+    if (!this.view) return null
+    while (this._blobIndexing) await this._blobIndexing
+    const view = this.view
+    const length = view.core?.length || 0
+    if (this._blobIndex.view !== view || this._blobIndex.length !== length) {
+      this._blobIndexing = this._indexBlobs(view, length).finally(() => { this._blobIndexing = null })
+      await this._blobIndexing
+    }
+
+    const id = this._blobIndex.videos.get(blobsCoreKey + '/' + blobId)
+    if (!id) return null
+    const res = await view.get(prefixedKey('videos', id)).catch(() => null)
+    return res?.value || null
+  }
+
+  async _indexBlobs(view, length) {
+    const index = this._blobIndex
+    const range = { gt: 'videos/', lt: 'videos/\xff' }
+    const blobKey = (video) => video?.id && video.blobsCoreKey && video.blobId ? video.blobsCoreKey + '/' + video.blobId : null
+
+    try {
+      if (index.view === view && index.length > 0 && length > index.length && typeof view.createDiffStream === 'function') {
+        for await (const { left, right } of view.createDiffStream(index.length, range)) {
+          const before = blobKey(right?.value)
+          if (before && index.videos.get(before) === right.value.id) index.videos.delete(before)
+          const after = blobKey(left?.value)
+          if (after) index.videos.set(after, left.value.id)
+        }
+      } else {
+        index.videos.clear()
+        for await (const { value } of view.createReadStream(range)) {
+          const key = blobKey(value)
+          if (key) index.videos.set(key, value.id)
+        }
+      }
+      index.view = view
+      index.length = length
+    } catch (err) {
+      // Rebuilt from scratch next time
+      index.view = null
+      throw err
+    }
+  }
+
   async addVideo(meta) {
     const id = meta.id
     if (!id) throw new Error('Video id required')
@@ -108,6 +108,9 @@ function validateAddVideo(op) {
   if (op.blobDriveKey !== undefined && typeof op.blobDriveKey !== 'string') {
     return { valid: false, error: 'add-video.blobDriveKey must be a string' }
   }
+  if (op.keyframeIndexBlobId !== undefined && typeof op.keyframeIndexBlobId !== 'string') {
+    return { valid: false, error: 'add-video.keyframeIndexBlobId must be a string' }
+  }
   if (op.mimeType !== undefined && typeof op.mimeType !== 'string') {
     return { valid: false, error: 'add-video.mimeType must be a string' }
   }
@@ -148,6 +151,19 @@ function validateUpdateVideo(op) {
   if (op.updatedAt !== undefined && typeof op.updatedAt !== 'number') {
     return { valid: false, error: 'update-video.updatedAt must be a number' }
   }
+  if (op.hlsMasterBlobId !== undefined && typeof op.hlsMasterBlobId !== 'string') {
+    return { valid: false, error: 'update-video.hlsMasterBlobId must be a string' }
+  }
+  if (op.hlsRenditions !== undefined && !Array.isArray(op.hlsRenditions)) {
+    return { valid: false, error: 'update-video.hlsRenditions must be an array' }
+  }
+  if (op.hlsCast !== undefined) {
+    const cast = op.hlsCast
+    if (!cast || typeof cast !== 'object' || typeof cast.sourceKey !== 'string' ||
+        typeof cast.coreKey !== 'string' || typeof cast.manifestBlobId !== 'string') {
+      return { valid: false, error: 'update-video.hlsCast must have string sourceKey, coreKey and manifestBlobId' }
+    }
+  }
   if (op.updatedBy !== undefined && typeof op.updatedBy !== 'string') {
     return { valid: false, error: 'update-video.updatedBy must be a string' }
   }
@@ -0,0 +1,415 @@
+/**
+ * HlsSegmentCache - Hyperblobs-backed store for cast HLS output
+ *
+ * Casting remuxes or transcodes a video into MPEG-TS segments on the
+ * casting device (app/backend/hls-transcoder.mjs). The output only depends
+ * on the source blob and the output profile, so once one device has
+ * produced it, others can serve the stored segments instead of running
+ * FFmpeg again.
+ *
+ * - Segments are appended to a hyperblobs core as they are produced. Each
+ *   is addressed by the BLAKE2b-256 hash of its bytes: identical segments
+ *   are stored once per core, and every read is checked against the hash.
+ * - When the source finishes, a JSON manifest (the playlist: index,
+ *   duration, hash and blob id per segment) is stored on the same core.
+ * - A source is keyed by hlsSourceKey(blobs core key, blob id, profile),
+ *   which any peer can derive from the video metadata.
+ *
+ * If this device can write the channel that owns the video, the blobs go
+ * into its channel blobs core and the manifest is recorded on the video as
+ * `hlsCast`, so peers replicating the channel find it and fetch the
+ * segments from us. Otherwise a local core is used and the result is only
+ * reused on this device. Either way the manifest ref is indexed in metaDb.
+ *
+ * Renderings stored on a core are capped (maxCoreBytes, counted in metaDb):
+ * a channel core over the cap sends new renderings to the local core, and
+ * a rendering that would pass the cap stops publishing.
+ */
+
+import b4a from 'b4a';
+import crypto from 'hypercore-crypto';
+import Hyperblobs from 'hyperblobs';
+
+const MANIFEST_VERSION = 1;
+const LOCAL_CORE_NAME = 'peartube-hls';
+
+// Remote segment/manifest reads give up after this long
+const FETCH_TIMEOUT_MS = 15 * 1000;
+
+// Rendering bytes stored per core; channel cores replicate to every viewer
+const MAX_CORE_BYTES = 2 * 1024 * 1024 * 1024;
+
+/**
+ * @typedef {Object} HlsCastRef
+ * @property {string} sourceKey - hlsSourceKey() of the source
+ * @property {string} coreKey - Hex key of the blobs core holding segments and manifest
+ * @property {string} manifestBlobId - Blob ID of the manifest
+ */
+
+/**
+ * @typedef {Object} HlsManifest
+ * @property {number} version
+ * @property {string} sourceKey
+ * @property {string} profile
+ * @property {Array<{index: number, duration: number, hash: string, blobId: string}>} segments
+ */
+
+/**
+ * @param {{blockOffset: number, blockLength: number, byteOffset: number, byteLength: number}|string} id
+ * @returns {string}
+ */
+export function blobIdString(id) {
+  if (typeof id === 'string') return id;
+  return `${id.blockOffset}:${id.blockLength}:${id.byteOffset}:${id.byteLength}`;
+}
+
+/**
+ * @param {string} id
+ */
+function parseBlobId(id) {
+  const parts = id.split(':').map(Number);
+  if (parts.length !== 4 || parts.some((n) => !Number.isInteger(n) || n < 0)) {
+    throw new Error('Invalid blob ID: ' + id);
+  }
+  return { blockOffset: parts[0], blockLength: parts[1], byteOffset: parts[2], byteLength: parts[3] };
+}
+
+/**
+ * Stable key for one source blob rendered with one output profile
+ * @param {string} blobsCoreKey - Hex key of the source video's blobs core
+ * @param {object|string} blobId - Source video blob ID
+ * @param {string} profile - Output profile (codec decisions, transcoder version)
+ * @returns {string} hex
+ */
+export function hlsSourceKey(blobsCoreKey, blobId, profile) {
+  const input = `peartube-hls/${MANIFEST_VERSION}/${profile}/${blobsCoreKey}/${blobIdString(blobId)}`;
+  return b4a.toString(crypto.hash(b4a.from(input)), 'hex');
+}
+
+/**
+ * @param {Uint8Array} data
+ * @returns {string} hex BLAKE2b-256 of the segment bytes
+ */
+export function segmentHash(data) {
+  return b4a.toString(crypto.hash(data), 'hex');
+}
+
+export class HlsSegmentCache {
+  /**
+   * @param {any} store - Corestore
+   * @param {any} metaDb - Hyperbee (json values)
+   * @param {{channels?: Map<string, any>, maxCoreBytes?: number}} [opts] - Loaded channels (ctx.channels)
+   */
+  constructor(store, metaDb, opts = {}) {
+    this.store = store;
+    this.metaDb = metaDb;
+    this.channels = opts.channels || null;
+    this.maxCoreBytes = opts.maxCoreBytes || MAX_CORE_BYTES;
+    /** @type {Map<string, Promise<{bytes: number}>>} core key hex -> stored rendering bytes */
+    this._usage = new Map();
+    /** @type {Promise<Hyperblobs>|null} */
+    this._local = null;
+    /** @type {Map<string, Hyperblobs>} core key hex -> read handle */
+    this._readers = new Map();
+    this.stats = { published: 0, deduped: 0, reusedSources: 0, reusedBytes: 0 };
+  }
+
+  /**
+   * @param {string} blobsCoreKey
+   * @param {object|string} blobId
+   * @param {string} profile
+   * @returns {string}
+   */
+  sourceKey(blobsCoreKey, blobId, profile) {
+    return hlsSourceKey(blobsCoreKey, blobId, profile);
+  }
+
+  /**
+   * @returns {Promise<Hyperblobs>}
+   */
+  _localBlobs() {
+    if (!this._local) {
+      this._local = (async () => {
+        const core = this.store.get({ name: LOCAL_CORE_NAME });
+        await core.ready();
+        return new Hyperblobs(core);
+      })();
+    }
+    return this._local;
+  }
+
+  /**
+   * @param {string} coreKeyHex
+   * @returns {Promise<Hyperblobs>}
+   */
+  async _readerFor(coreKeyHex) {
+    const local = await this._localBlobs();
+    if (b4a.toString(local.core.key, 'hex') === coreKeyHex) return local;
+
+    let blobs = this._readers.get(coreKeyHex);
+    if (!blobs) {
+      const core = this.store.get(b4a.from(coreKeyHex, 'hex'));
+      await core.ready();
+      blobs = new Hyperblobs(core);
+      this._readers.set(coreKeyHex, blobs);
+    }
+    return blobs;
+  }
+
+  /**
+   * Channel and video metadata for a source blob among the loaded channels
+   * @param {string} blobsCoreKey
+   * @param {string} blobId
+   * @returns {Promise<{channel: any, video: any}|null>}
+   */
+  async _findVideo(blobsCoreKey, blobId) {
+    if (!this.channels) return null;
+    // The channel owning the blobs core nearly always holds the video
+    const channels = [...this.channels.values()].sort((a, b) =>
+      (b?.blobsKeyHex === blobsCoreKey) - (a?.blobsKeyHex === blobsCoreKey));
+    for (const channel of channels) {
+      if (typeof channel?.findVideoByBlob !== 'function') continue;
+      const video = await channel.findVideoByBlob(blobsCoreKey, blobId).catch(() => null);
+      if (video) return { channel, video };
+    }
+    return null;
+  }
+
+  /**
+   * Find a complete stored rendering of a source
+   * @param {string} sourceKey
+   * @param {{blobsCoreKey: string, blobId: object|string}} source
+   * @returns {Promise<{manifest: HlsManifest, read: (segment: HlsManifest['segments'][number]) => Promise<Buffer>}|null>}
+   */
+  async find(sourceKey, source) {
+    /** @type {HlsCastRef|null} */
+    let ref = null;
+
+    const indexed = await this.metaDb.get(`hls-cache/${sourceKey}`).catch(() => null);
+    if (indexed?.value?.manifestBlobId) ref = indexed.value;
+
+    if (!ref) {
+      const found = await this._findVideo(source.blobsCoreKey, blobIdString(source.blobId));
+      const cast = found?.video?.hlsCast;
+      if (cast?.sourceKey === sourceKey && cast.coreKey && cast.manifestBlobId) ref = cast;
+    }
+    if (!ref) return null;
+
+    let manifest;
+    try {
+      const blobs = await this._readerFor(ref.coreKey);
+      const raw = await blobs.get(parseBlobId(ref.manifestBlobId), { timeout: FETCH_TIMEOUT_MS });
+      manifest = raw ? JSON.parse(b4a.toString(raw)) : null;
+    } catch (err) {
+      console.log('[HlsSegmentCache] Manifest unavailable for', sourceKey.slice(0, 16), err?.message);
+      return null;
+    }
+    if (!manifest || manifest.version !== MANIFEST_VERSION || manifest.sourceKey !== sourceKey ||
+        !Array.isArray(manifest.segments) || manifest.segments.length === 0) {
+      return null;
+    }
+
+    if (!indexed?.value) {
+      await this.metaDb.put(`hls-cache/${sourceKey}`, { ...ref, sourceKey }).catch(() => {});
+    }
+    this.stats.reusedSources++;
+
+    const blobs = await this._readerFor(ref.coreKey);
+    return {
+      manifest,
+      read: async (segment) => {
+        const data = await blobs.get(parseBlobId(segment.blobId), { timeout: FETCH_TIMEOUT_MS });
+        if (!data || segmentHash(data) !== segment.hash) {
+          throw new Error('Segment ' + segment.index + ' missing or corrupt');
+        }
+        this.stats.reusedBytes += data.length;
+        return data;
+      }
+    };
+  }
+
+  /**
+   * Read one blob from any blobs core (used to serve stored HLS ladders)
+   * @param {string} coreKeyHex
+   * @param {string} blobId
+   * @returns {Promise<Buffer|null>}
+   */
+  async readBlob(coreKeyHex, blobId) {
+    const blobs = await this._readerFor(coreKeyHex);
+    return blobs.get(parseBlobId(blobId), { timeout: FETCH_TIMEOUT_MS });
+  }
+
+  /**
+   * Start storing a rendering of a source as it is produced
+   * @param {string} sourceKey
+   * @param {{blobsCoreKey: string, blobId: object|string, profile: string}} source
+   * @returns {HlsSegmentPublisher}
+   */
+  publish(sourceKey, source) {
+    return new HlsSegmentPublisher(this, sourceKey, source);
+  }
+
+  /**
+   * Rendering bytes stored on a core
+   * @param {string} coreKeyHex
+   * @returns {Promise<{bytes: number}>}
+   */
+  _usageOf(coreKeyHex) {
+    let usage = this._usage.get(coreKeyHex);
+    if (!usage) {
+      usage = this.metaDb.get(`hls-bytes/${coreKeyHex}`)
+        .then((entry) => ({ bytes: entry?.value?.bytes || 0 }), () => ({ bytes: 0 }));
+      this._usage.set(coreKeyHex, usage);
+    }
+    return usage;
+  }
+
+  /**
+   * Store blob bytes on a core within its cap
+   * @param {string} coreKeyHex
+   * @param {Uint8Array} data
+   * @param {(data: Uint8Array) => Promise<string>} put
+   * @returns {Promise<string>} blob ID
+   */
+  async _putCounted(coreKeyHex, data, put) {
+    const usage = await this._usageOf(coreKeyHex);
+    if (usage.bytes + data.length > this.maxCoreBytes) {
+      throw new Error('HLS renderings on core ' + coreKeyHex.slice(0, 16) + ' reached ' + this.maxCoreBytes + ' bytes');
+    }
+    usage.bytes += data.length;
+    let id;
+    try {
+      id = await put(data);
+    } catch (err) {
+      usage.bytes -= data.length;
+      throw err;
+    }
+    await this.metaDb.put(`hls-bytes/${coreKeyHex}`, { bytes: usage.bytes });
+    return id;
+  }
+
+  /**
+   * Where a source's output goes: the owning channel's blobs if writable
+   * and under the cap, else the local core
+   * @param {{blobsCoreKey: string, blobId: object|string}} source
+   */
+  async _target(source) {
+    const found = await this._findVideo(source.blobsCoreKey, blobIdString(source.blobId));
+    if (found?.channel?.writable && found.channel.blobs &&
+        (await this._usageOf(found.channel.blobsKeyHex)).bytes < this.maxCoreBytes) {
+      const { channel, video } = found;
+      const coreKey = channel.blobsKeyHex;
+      return {
+        coreKey,
+        put: (data) => this._putCounted(coreKey, data, async (bytes) => (await channel.putBlob(bytes)).id),
+        record: (ref) => channel.updateVideo(video.id, { hlsCast: ref })
+      };
+    }
+
+    const blobs = await this._localBlobs();
+    const coreKey = b4a.toString(blobs.core.key, 'hex');
+    return {
+      coreKey,
+      put: (data) => this._putCounted(coreKey, data, async (bytes) => blobIdString(await blobs.put(bytes))),
+      record: null
+    };
+  }
+}
+
+/**
+ * Appends one source's segments as they arrive. Puts run one at a time in
+ * arrival order; the transcoder never waits on them.
+ */
+export class HlsSegmentPublisher {
+  /**
+   * @param {HlsSegmentCache} cache
+   * @param {string} sourceKey
+   * @param {{blobsCoreKey: string, blobId: object|string, profile: string}} source
+   */
+  constructor(cache, sourceKey, source) {
+    this.cache = cache;
+    this.sourceKey = sourceKey;
+    this.profile = source.profile;
+    /** @type {Map<number, {index: number, duration: number, hash: string, blobId: string}>} */
+    this.segments = new Map();
+    this.failed = null;
+    this.closed = false;
+    this._target = cache._target(source);
+    /** @type {Promise<void>} */
+    this._queue = this._target.then(() => {}, (err) => { this.failed = err; });
+  }
+
+  /**
+   * @param {number} index
+   * @param {number} duration - seconds
+   * @param {Buffer} data - Complete MPEG-TS segment
+   */
+  addSegment(index, duration, data) {
+    if (this.closed || this.failed) return;
+    this._queue = this._queue.then(() => this._store(index, duration, data)).catch((err) => {
+      this.failed = err;
+      console.log('[HlsSegmentCache] Publishing stopped for', this.sourceKey.slice(0, 16), err?.message);
+    });
+  }
+
+  async _store(index, duration, data) {
+    if (this.failed) return;
+    const target = await this._target;
+    const hash = segmentHash(data);
+    const dedupeKey = `hls-seg/${target.coreKey}/${hash}`;
+
+    const existing = await this.cache.metaDb.get(dedupeKey);
+    let blobId = existing?.value?.blobId;
+    if (blobId) {
+      this.cache.stats.deduped++;
+    } else {
+      blobId = await target.put(data);
+      await this.cache.metaDb.put(dedupeKey, { blobId });
+      this.cache.stats.published++;
+    }
+    this.segments.set(index, { index, duration, hash, blobId });
+  }
+
+  /**
+   * Store the manifest once every segment is in. Only call after the
+   * transcode ran to the end; an incomplete rendering is never published.
+   * @returns {Promise<HlsCastRef|null>}
+   */
+  async finish() {
+    if (this.closed) return null;
+    this.closed = true;
+    await this._queue;
+    if (this.failed || this.segments.size === 0) return null;
+
+    const target = await this._target;
+    /** @type {HlsManifest} */
+    const manifest = {
+      version: MANIFEST_VERSION,
+      sourceKey: this.sourceKey,
+      profile: this.profile,
+      segments: [...this.segments.values()].sort((a, b) => a.index - b.index)
+    };
+    const manifestBlobId = await target.put(b4a.from(JSON.stringify(manifest)));
+
+    /** @type {HlsCastRef} */
+    const ref = { sourceKey: this.sourceKey, coreKey: target.coreKey, manifestBlobId };
+    await this.cache.metaDb.put(`hls-cache/${this.sourceKey}`, ref);
+    if (target.record) {
+      await target.record(ref).catch((err) => {
+        console.log('[HlsSegmentCache] Could not record hlsCast on video:', err?.message);
+      });
+    }
+
+    console.log('[HlsSegmentCache] Published', manifest.segments.length, 'segments for',
+      this.sourceKey.slice(0, 16), 'on core', target.coreKey.slice(0, 16));
+    return ref;
+  }
+
+  /**
+   * Drop the rendering (transcode failed or was stopped). Segments already
+   * stored stay and are deduped into the next attempt.
+   */
+  abort() {
+    this.closed = true;
+  }
+}
@@ -17,6 +17,12 @@ export {
   getVideoUrl
 } from './storage.js';
 
+// Peer stats - Per-peer / per-core bandwidth and latency
+export { PeerNetworkStats, JsPeerStats } from './peer-stats.js';
+
+// Playback scheduler - Deadline-ordered block fetching for video blobs
+export { PlaybackScheduler } from './block-scheduler.js';
+
 // Public Feed - P2P channel discovery
 export { PublicFeedManager } from './public-feed.js';
 
@@ -26,6 +32,9 @@ export { VideoStatsTracker } from './video-stats.js';
 // Seeding - Distributed content availability
 export { SeedingManager } from './seeding.js';
 
+// HLS cache - Cast segments stored in hyperblobs for reuse
+export { HlsSegmentCache, hlsSourceKey } from './hls-cache.js';
+
 // API - Shared backend methods
 export { createApi } from './api.js';
 
@@ -9,7 +9,7 @@
  *   const { ctx, api, identityManager, uploadManager, publicFeed, seedingManager, videoStats } = backend;
  */
 
-import { initializeStorage, loadDrive } from './storage.js';
+import { initializeStorage, loadDrive, getPeerNetworkStats } from './storage.js';
 import { PublicFeedManager } from './public-feed.js';
 import { VideoStatsTracker } from './video-stats.js';
 import { SeedingManager } from './seeding.js';
@@ -104,7 +104,7 @@ export async function createBackendContext(config) {
   // Phase 2: Create managers (synchronous, fast)
   const publicFeed = new PublicFeedManager(ctx.swarm, ctx.metaDb);
   const videoStats = new VideoStatsTracker();
-  const seedingManager = new SeedingManager(ctx.store, ctx.metaDb);
+  const seedingManager = new SeedingManager(ctx.store, ctx.metaDb, { peerStats: getPeerNetworkStats() });
   const identityManager = createIdentityManager({ ctx });
   const uploadManager = createUploadManager({ ctx });
 
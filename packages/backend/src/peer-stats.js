@@ -0,0 +1,416 @@
+/**
+ * PeerNetworkStats - Per-peer and per-core bandwidth and latency
+ *
+ * hyperswarm-stats (getNetworkStats) only has swarm-wide counters, which
+ * cannot tell which peer is throttling playback. This collects samples per
+ * peer and per core:
+ *
+ * - bytes: hypercore 'download' / 'upload' events (block payload bytes,
+ *   attributed to the remote peer and the core)
+ * - fetch latency: time from a local core.get() of a block to its
+ *   'download' event, i.e. how long the player waited on the network
+ * - rtt: the UDX stream's smoothed round trip, polled per connection
+ *
+ * Samples go to the bare-peer-stats native aggregator (decayed rates, HDR
+ * latency histograms, batched ingestion) when it is available, and to an
+ * equivalent JS aggregator otherwise. snapshot() returns compact rows for
+ * the UI and for choosing peers.
+ */
+
+import b4a from 'b4a';
+
+// Native aggregator (Bare only); absent under Node and in builds without the addon
+let NativePeerStats = null;
+try {
+  const mod = await import('bare-peer-stats');
+  NativePeerStats = (mod.default || mod).PeerStats || null;
+} catch {}
+
+const RTT_POLL_MS = 1000;
+
+// Disconnected peers keep their series this long (they often come back)
+const PEER_FORGET_MS = 10 * 60 * 1000;
+
+// Reads still waiting on a download after this long are dropped (on the
+// poll timer); past the size cap the oldest one is dropped per new read
+const PENDING_MAX_AGE_MS = 60 * 1000;
+const PENDING_MAX_SIZE = 4096;
+
+// Fetch latency histogram: 16 sub-buckets per power of two of microseconds
+const SUB_BITS = 4;
+const SUB_COUNT = 1 << SUB_BITS;
+const MAX_BITS = 26;
+const BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+function bucketOf(us) {
+  if (us < SUB_COUNT) return us;
+  if (us >= 2 ** MAX_BITS) us = 2 ** MAX_BITS - 1;
+  const shift = Math.floor(Math.log2(us)) - SUB_BITS;
+  return (shift + 1) * SUB_COUNT + Math.floor(us / 2 ** shift) - SUB_COUNT;
+}
+
+function bucketValue(bucket) {
+  if (bucket < SUB_COUNT) return bucket;
+  const shift = Math.floor(bucket / SUB_COUNT) - 1;
+  return (bucket % SUB_COUNT + SUB_COUNT) * 2 ** shift + (2 ** shift - 1) / 2;
+}
+
+/**
+ * JS aggregator (fallback when the native addon is not available). Same
+ * API and arithmetic as bare-peer-stats.
+ */
+export class JsPeerStats {
+  /**
+   * @param {{rateHalfLife?: number, slowHalfLife?: number, latencyHalfLife?: number}} [opts]
+   */
+  constructor(opts = {}) {
+    this.rateHalfLife = opts.rateHalfLife || 2000;
+    this.slowHalfLife = opts.slowHalfLife || 30000;
+    this.latencyHalfLife = opts.latencyHalfLife || 60000;
+    this.scopes = { peers: new Map(), cores: new Map() };
+    this.samples = 0;
+  }
+
+  _series(scope, key) {
+    let s = this.scopes[scope].get(key);
+    if (!s) {
+      s = { rateTime: 0, rxFast: 0, txFast: 0, rxSlow: 0, txSlow: 0, rxBytes: 0, txBytes: 0, rtt: 0, lastSeen: 0, counts: null, total: 0, lastDecay: 0 };
+      this.scopes[scope].set(key, s);
+    }
+    return s;
+  }
+
+  _bytes(s, rx, bytes, time) {
+    const dt = time - s.rateTime;
+    if (dt > 0) {
+      const fast = 2 ** (-dt / this.rateHalfLife);
+      const slow = 2 ** (-dt / this.slowHalfLife);
+      s.rxFast *= fast;
+      s.txFast *= fast;
+      s.rxSlow *= slow;
+      s.txSlow *= slow;
+      s.rateTime = time;
+    }
+    if (rx) {
+      s.rxFast += bytes;
+      s.rxSlow += bytes;
+      s.rxBytes += bytes;
+    } else {
+      s.txFast += bytes;
+      s.txSlow += bytes;
+      s.txBytes += bytes;
+    }
+  }
+
+  _fetch(s, us, time) {
+    if (!s.counts) s.counts = new Uint32Array(BUCKET_COUNT);
+    if (s.total === 0) {
+      s.lastDecay = time;
+    } else if (time - s.lastDecay >= this.latencyHalfLife) {
+      const steps = Math.floor((time - s.lastDecay) / this.latencyHalfLife);
+      s.total = 0;
+      for (let i = 0; i < BUCKET_COUNT; i++) {
+        s.counts[i] = steps >= 32 ? 0 : s.counts[i] >>> steps;
+        s.total += s.counts[i];
+      }
+      s.lastDecay += steps * this.latencyHalfLife;
+    }
+    s.counts[bucketOf(us)]++;
+    s.total++;
+  }
+
+  _record(kind, peer, core, value, time = Date.now()) {
+    if (!(value >= 0) || !Number.isFinite(value)) return;
+    this.samples++;
+    for (const [scope, key] of [['peers', peer], ['cores', kind === 'rtt' ? null : core]]) {
+      if (!key) continue;
+      const s = this._series(scope, key);
+      if (time > s.lastSeen) s.lastSeen = time;
+      if (kind === 'rx' || kind === 'tx') this._bytes(s, kind === 'rx', value, time);
+      else if (kind === 'fetch') this._fetch(s, value, time);
+      else s.rtt = s.rtt === 0 ? value : s.rtt + 0.2 * (value - s.rtt);
+    }
+  }
+
+  received(peer, core, bytes, time) {
+    this._record('rx', peer, core, bytes, time);
+  }
+
+  sent(peer, core, bytes, time) {
+    this._record('tx', peer, core, bytes, time);
+  }
+
+  fetch(peer, core, ms, time) {
+    this._record('fetch', peer, core, Math.round(ms * 1000), time);
+  }
+
+  rtt(peer, ms, time) {
+    this._record('rtt', peer, null, Math.round(ms * 1000), time);
+  }
+
+  flush() {}
+
+  snapshot(scope = 'peers', now = Date.now()) {
+    const fastRate = Math.LN2 / this.rateHalfLife * 1000;
+    const slowRate = Math.LN2 / this.slowHalfLife * 1000;
+    const out = [];
+    for (const [key, s] of this.scopes[scope]) {
+      const dt = Math.max(0, now - s.rateTime);
+      const fast = 2 ** (-dt / this.rateHalfLife);
+      const slow = 2 ** (-dt / this.slowHalfLife);
+      const entry = {
+        key,
+        rxRate: s.rxFast * fast * fastRate,
+        txRate: s.txFast * fast * fastRate,
+        rxRateSlow: s.rxSlow * slow * slowRate,
+        txRateSlow: s.txSlow * slow * slowRate,
+        rxBytes: s.rxBytes,
+        txBytes: s.txBytes,
+        rtt: s.rtt / 1000,
+        fetches: s.total,
+        fetchP50: 0,
+        fetchP90: 0,
+        fetchP99: 0,
+        fetchMax: 0,
+        lastSeen: s.lastSeen
+      };
+      if (s.total > 0) {
+        const fields = ['fetchP50', 'fetchP90', 'fetchP99'];
+        const ranks = [0.5, 0.9, 0.99].map((q) => Math.max(1, Math.ceil(q * s.total)));
+        let seen = 0;
+        let next = 0;
+        let last = 0;
+        for (let b = 0; b < BUCKET_COUNT; b++) {
+          if (!s.counts[b]) continue;
+          seen += s.counts[b];
+          last = b;
+          while (next < 3 && seen >= ranks[next]) entry[fields[next++]] = bucketValue(b) / 1000;
+        }
+        entry.fetchMax = bucketValue(last) / 1000;
+      }
+      out.push(entry);
+    }
+    return out;
+  }
+
+  forget(scope, key) {
+    this.scopes[scope].delete(key);
+  }
+
+  stats() {
+    return { samples: this.samples, peers: this.scopes.peers.size, cores: this.scopes.cores.size, memory: 0 };
+  }
+
+  destroy() {
+    this.scopes.peers.clear();
+    this.scopes.cores.clear();
+  }
+}
+
+/**
+ * @typedef {Object} PeerStatsEntry
+ * @property {string} key - Peer public key or core key (hex)
+ * @property {number} rxRate - Bytes/s received (2s half life)
+ * @property {number} txRate - Bytes/s sent (2s half life)
+ * @property {number} rxRateSlow - Bytes/s received (30s half life)
+ * @property {number} txRateSlow - Bytes/s sent (30s half life)
+ * @property {number} rxBytes
+ * @property {number} txBytes
+ * @property {number} rtt - Smoothed transport round trip in ms (peers only)
+ * @property {number} fetches - Fetch latency samples (decayed)
+ * @property {number} fetchP50 - ms
+ * @property {number} fetchP90 - ms
+ * @property {number} fetchP99 - ms
+ * @property {number} fetchMax - ms
+ * @property {number} lastSeen - Last sample time (ms)
+ * @property {boolean} [connected] - Peers only
+ */
+
+export class PeerNetworkStats {
+  constructor() {
+    this.stats = NativePeerStats ? new NativePeerStats() : new JsPeerStats();
+    this.native = Boolean(NativePeerStats);
+    /** @type {Map<string, any>} peer key hex -> open connection */
+    this.connections = new Map();
+    /** @type {Map<string, number>} peer key hex -> disconnect time */
+    this.disconnected = new Map();
+    /** @type {Map<string, any>} core key hex -> session whose events are counted */
+    this.cores = new Map();
+    /** @type {Map<string, number>} `${coreKey}:${index}` -> local get() start */
+    this.pending = new Map();
+    /** @type {Map<string, Set<(index: number) => void>>} core key hex -> read listeners */
+    this.readers = new Map();
+    this._timer = null;
+  }
+
+  /**
+   * Start collecting from a corestore and a swarm
+   * @param {any} store - Corestore
+   * @param {any} swarm - Hyperswarm
+   */
+  attach(store, swarm) {
+    if (store && typeof store.get === 'function' && !store._peerStatsTracked) {
+      const originalGet = store.get.bind(store);
+      store.get = (...args) => {
+        const core = originalGet(...args);
+        this._trackCore(core);
+        return core;
+      };
+      store._peerStatsTracked = true;
+    }
+
+    if (swarm) {
+      swarm.on('connection', (conn, info) => this._onConnection(conn, info));
+      for (const conn of swarm.connections || []) this._onConnection(conn, null);
+    }
+
+    if (!this._timer) {
+      this._timer = setInterval(() => this._poll(), RTT_POLL_MS);
+      this._timer.unref?.();
+    }
+  }
+
+  /**
+   * Observe block reads of a core from any session (e.g. the blob server
+   * serving the player). The one read hook on the store: the playback
+   * scheduler and the seeding access map subscribe here
+   * @param {string} keyHex
+   * @param {(index: number) => void} fn
+   * @returns {() => void} Stops observing
+   */
+  onRead(keyHex, fn) {
+    let readers = this.readers.get(keyHex);
+    if (!readers) {
+      readers = new Set();
+      this.readers.set(keyHex, readers);
+    }
+    readers.add(fn);
+    return () => {
+      readers.delete(fn);
+      if (readers.size === 0 && this.readers.get(keyHex) === readers) this.readers.delete(keyHex);
+    };
+  }
+
+  _onConnection(conn, info) {
+    const publicKey = info?.publicKey || conn?.remotePublicKey;
+    if (!publicKey) return;
+    const peer = b4a.toString(publicKey, 'hex');
+    this.connections.set(peer, conn);
+    this.disconnected.delete(peer);
+    conn.once('close', () => {
+      if (this.connections.get(peer) !== conn) return;
+      this.connections.delete(peer);
+      this.disconnected.set(peer, Date.now());
+    });
+  }
+
+  _trackCore(core) {
+    if (!core || typeof core.get !== 'function' || core._peerStatsTracked) return;
+    core._peerStatsTracked = true;
+
+    let keyHex = core.key ? b4a.toString(core.key, 'hex') : null;
+
+    // Every session's reads start the latency clock; a read that settles
+    // without a download (a local hit) stops it
+    const get = core.get.bind(core);
+    core.get = (index, opts) => {
+      if (keyHex === null && core.key) keyHex = b4a.toString(core.key, 'hex');
+      if (keyHex === null) return get(index, opts);
+
+      const id = keyHex + ':' + index;
+      const readers = this.readers.get(keyHex);
+      if (readers) for (const fn of readers) fn(index);
+      if (this.pending.has(id)) return get(index, opts);
+
+      const start = Date.now();
+      this.pending.set(id, start);
+      if (this.pending.size > PENDING_MAX_SIZE) this.pending.delete(this.pending.keys().next().value);
+
+      const result = get(index, opts);
+      const settle = () => {
+        if (this.pending.get(id) === start) this.pending.delete(id);
+      };
+      if (typeof result?.then === 'function') result.then(settle, settle);
+      else settle();
+      return result;
+    };
+
+    // Byte and latency events are counted on one session per core, since
+    // hypercore emits them on every open session
+    core.ready().then(() => {
+      keyHex = b4a.toString(core.key, 'hex');
+      this._listen(keyHex, core);
+    }).catch(() => {});
+  }
+
+  _listen(keyHex, core) {
+    if (this.cores.has(keyHex) || core.closed) return;
+    this.cores.set(keyHex, core);
+
+    const ondownload = (index, byteLength, from) => {
+      const now = Date.now();
+      const peer = from?.remotePublicKey ? b4a.toString(from.remotePublicKey, 'hex') : null;
+      this.stats.received(peer, keyHex, byteLength, now);
+      const id = keyHex + ':' + index;
+      const start = this.pending.get(id);
+      if (start !== undefined) {
+        this.pending.delete(id);
+        this.stats.fetch(peer, keyHex, now - start, now);
+      }
+    };
+    const onupload = (index, byteLength, to) => {
+      const peer = to?.remotePublicKey ? b4a.toString(to.remotePublicKey, 'hex') : null;
+      this.stats.sent(peer, keyHex, byteLength);
+    };
+
+    core.on('download', ondownload);
+    core.on('upload', onupload);
+    core.once('close', () => {
+      core.off('download', ondownload);
+      core.off('upload', onupload);
+      if (this.cores.get(keyHex) === core) this.cores.delete(keyHex);
+    });
+  }
+
+  // Insertion order is start order, so stop at the first recent read
+  _prunePending(now) {
+    const cutoff = now - PENDING_MAX_AGE_MS;
+    for (const [id, start] of this.pending) {
+      if (start >= cutoff) break;
+      this.pending.delete(id);
+    }
+  }
+
+  _poll() {
+    const now = Date.now();
+    this._prunePending(now);
+    for (const [peer, conn] of this.connections) {
+      const rtt = conn.rawStream?.rtt;
+      if (typeof rtt === 'number' && rtt > 0) this.stats.rtt(peer, rtt, now);
+    }
+    for (const [peer, since] of this.disconnected) {
+      if (now - since < PEER_FORGET_MS) continue;
+      this.disconnected.delete(peer);
+      this.stats.forget('peers', peer);
+    }
+  }
+
+  /**
+   * Peer rows (fastest first) and core rows (busiest first)
+   * @returns {{native: boolean, peers: PeerStatsEntry[], cores: PeerStatsEntry[], samples: number}}
+   */
+  snapshot() {
+    const now = Date.now();
+    const peers = this.stats.snapshot('peers', now);
+    for (const entry of peers) entry.connected = this.connections.has(entry.key);
+    peers.sort((a, b) => b.rxRateSlow - a.rxRateSlow);
+    const cores = this.stats.snapshot('cores', now).sort((a, b) => b.rxRateSlow - a.rxRateSlow);
+    return { native: this.native, peers, cores, samples: this.stats.stats().samples };
+  }
+
+  destroy() {
+    if (this._timer) clearInterval(this._timer);
+    this._timer = null;
+    this.stats.destroy();
+  }
+}
@@ -0,0 +1,199 @@
+/**
+ * Recommendation Candidate Table
+ *
+ * Per-video ranking features (watches, completions, similarity to recent
+ * watches, upload time, channel), updated as events arrive and ranked in
+ * one call. Uses the bare-vector-index native table (columnar, top-K heap)
+ * when it is available, and a plain JS table otherwise.
+ */
+
+// Native table (Bare only); absent under Node and in builds without the addon
+let NativeCandidateTable = null
+try {
+  const mod = await import('bare-vector-index')
+  NativeCandidateTable = (mod.default || mod).CandidateTable || null
+} catch {}
+
+// Term weights, watches at which the volume half of popularity reaches 0.5,
+// and the recency half-life; both tables share them
+const DEFAULT_WEIGHTS = { similarity: 0.6, popularity: 0.4, recency: 0.1, affinity: 0.2 }
+const DEFAULT_POPULARITY_HALF = 10
+const DEFAULT_RECENCY_HALF_LIFE = 14 * 24 * 3600 * 1000
+
+const REASONS = ['similar_content', 'popular', 'recent', 'channel_content']
+
+/**
+ * JS candidate table (fallback when the native addon is not available).
+ * Scores are
+ *   w.similarity * similarity + w.popularity * popularity +
+ *   w.recency * recency + w.affinity * channel affinity
+ * with every term in [0, 1]; the dominant term is reported as the reason.
+ */
+export class JsCandidateTable {
+  /**
+   * @param {Object} [opts]
+   * @param {{similarity?: number, popularity?: number, recency?: number, affinity?: number}} [opts.weights]
+   * @param {number} [opts.popularityHalf] - Watches at which the volume
+   *   half of popularity reaches 0.5 (default 10)
+   * @param {number} [opts.recencyHalfLife] - Age in ms at which recency
+   *   halves (default 14 days)
+   */
+  constructor(opts = {}) {
+    this.weights = { ...DEFAULT_WEIGHTS, ...opts.weights }
+    this.popularityHalf = opts.popularityHalf ?? DEFAULT_POPULARITY_HALF
+    this.recencyHalfLife = opts.recencyHalfLife ?? DEFAULT_RECENCY_HALF_LIFE
+    /** @type {Map<string, {live: boolean, watches: number, completed: number, similarity: number, createdAt: number, channelKey: string|null}>} */
+    this.rows = new Map()
+    /** @type {Set<string>} ids with a non-zero similarity */
+    this._similar = new Set()
+    /** @type {Map<string|null, number>} */
+    this._affinity = new Map()
+    this._size = 0
+  }
+
+  _row(id) {
+    let row = this.rows.get(id)
+    if (!row) {
+      row = { live: false, watches: 0, completed: 0, similarity: 0, createdAt: 0, channelKey: null }
+      this.rows.set(id, row)
+    }
+    return row
+  }
+
+  /**
+   * Offer a video (or update its features); watch counts are kept
+   * @param {string} id
+   * @param {{createdAt?: number, channelKey?: string|null}} [features]
+   */
+  set(id, features = {}) {
+    const row = this._row(id)
+    if (!row.live) this._size++
+    row.live = true
+    row.createdAt = features.createdAt || 0
+    row.channelKey = features.channelKey ?? null
+  }
+
+  /**
+   * Stop offering a video; its watch counts are kept
+   * @param {string} id
+   */
+  remove(id) {
+    const row = this.rows.get(id)
+    if (!row?.live) return
+    row.live = false
+    this._size--
+  }
+
+  /**
+   * @param {string} id
+   * @returns {boolean}
+   */
+  has(id) {
+    return this.rows.get(id)?.live === true
+  }
+
+  /**
+   * Count watches of a video (need not be offered yet)
+   * @param {string} id
+   * @param {number} [count] - Watches to add; negative retracts
+   * @param {number} [completed] - How many of them were completed
+   */
+  watch(id, count = 1, completed = 0) {
+    const row = this._row(id)
+    row.watches = Math.max(0, row.watches + count)
+    row.completed = Math.min(row.watches, Math.max(0, row.completed + completed))
+  }
+
+  /**
+   * Replace the similarity column (unlisted ids get 0)
+   * @param {Map<string, number>|Iterable<[string, number]>} scores
+   */
+  setSimilarity(scores) {
+    for (const id of this._similar) {
+      const row = this.rows.get(id)
+      if (row) row.similarity = 0
+    }
+    this._similar.clear()
+    for (const [id, score] of scores) {
+      this._row(id).similarity = Math.min(1, Math.max(0, score))
+      this._similar.add(id)
+    }
+  }
+
+  /**
+   * Replace the channel affinities (share of recent watches per channel)
+   * @param {Map<string|null, number>|Iterable<[string|null, number]>} shares
+   */
+  setAffinity(shares) {
+    this._affinity = new Map(shares)
+  }
+
+  _terms(row, now) {
+    const w = this.weights
+    const popularity = row.watches > 0
+      ? 0.5 * row.watches / (row.watches + this.popularityHalf) + 0.5 * row.completed / row.watches
+      : 0
+    const recency = row.createdAt <= 0 ? 0 : row.createdAt >= now ? 1 : Math.pow(2, (row.createdAt - now) / this.recencyHalfLife)
+    return [
+      w.similarity * row.similarity,
+      w.popularity * popularity,
+      w.recency * recency,
+      w.affinity * Math.min(1, Math.max(0, this._affinity.get(row.channelKey) || 0))
+    ]
+  }
+
+  /**
+   * Best offered videos
+   * @param {number} topK
+   * @param {{exclude?: Iterable<string>, now?: number}} [opts]
+   * @returns {Array<{id: string, score: number, reason: string}>}
+   */
+  rank(topK = 10, opts = {}) {
+    if (topK <= 0) return []
+    const now = opts.now ?? Date.now()
+    const exclude = opts.exclude ? new Set(opts.exclude) : null
+
+    // Sorted best-first, at most topK long: one compare per row once full
+    const top = []
+    for (const [id, row] of this.rows) {
+      if (!row.live || exclude?.has(id)) continue
+      const terms = this._terms(row, now)
+      const score = terms[0] + terms[1] + terms[2] + terms[3]
+      if (top.length === topK && score <= top[top.length - 1].score) continue
+
+      let i = top.length === topK ? topK - 1 : top.length
+      while (i > 0 && top[i - 1].score < score) {
+        top[i] = top[i - 1]
+        i--
+      }
+      top[i] = { id, score, reason: REASONS[terms.indexOf(Math.max(...terms))] }
+    }
+    return top
+  }
+
+  /**
+   * Offered video count
+   * @returns {number}
+   */
+  size() {
+    return this._size
+  }
+
+  clear() {
+    this.rows.clear()
+    this._similar.clear()
+    this._affinity.clear()
+    this._size = 0
+  }
+
+  destroy() {
+    this.clear()
+  }
+}
+
+/**
+ * Candidate table used by the recommender: native when available, JS otherwise.
+ * Both expose set/remove/has/watch/setSimilarity/setAffinity/rank/size/clear/destroy.
+ * @type {typeof JsCandidateTable}
+ */
+export const CandidateTable = NativeCandidateTable || JsCandidateTable
@@ -0,0 +1,152 @@
+/**
+ * Watch Event Store
+ *
+ * Append-only per-video event history (time, type, value) with windowed
+ * and time-decayed aggregations. Uses the bare-event-store native store
+ * (compressed columns, ~9 bytes an event) when it is available, and plain
+ * JS columns otherwise.
+ */
+
+// Native store (Bare only); absent under Node and in builds without the addon
+let NativeEventStore = null
+try {
+  const mod = await import('bare-event-store')
+  NativeEventStore = (mod.default || mod).EventStore || null
+} catch {}
+
+const MAX_VALUE = 0xffff
+
+/**
+ * Per-type weights from a query's `types` (all 1 when absent)
+ * @param {Object<number, number>|number[]|undefined} types
+ * @returns {(type: number) => number}
+ */
+function typeWeight(types) {
+  if (!types) return () => 1
+  return (type) => types[type] || 0
+}
+
+/**
+ * JS event store (fallback when the native addon is not available)
+ */
+export class JsEventStore {
+  constructor() {
+    /** @type {string[]} */
+    this.ids = []
+    /** @type {number[]} */
+    this.times = []
+    /** @type {number[]} */
+    this.types = []
+    /** @type {number[]} */
+    this.values = []
+  }
+
+  /**
+   * Record one event
+   * @param {string} id - Video id
+   * @param {number} time - Event time in ms
+   * @param {number} [type=0] - Event type (0-255)
+   * @param {number} [value=0] - Event value (rounded, capped to 0-65535)
+   */
+  append(id, time, type = 0, value = 0) {
+    this.ids.push(id)
+    this.times.push(time || 0)
+    this.types.push(type)
+    this.values.push(Math.min(MAX_VALUE, Math.max(0, Math.round(value || 0))))
+  }
+
+  /**
+   * @param {Array<{id: string, time: number, type?: number, value?: number}>} events
+   */
+  appendBatch(events) {
+    for (const event of events) this.append(event.id, event.time, event.type, event.value)
+  }
+
+  /**
+   * Weight of event `i` under a query, 0 when it is left out
+   * @returns {(i: number) => number}
+   */
+  _weigher(opts) {
+    const since = opts.since ?? -Infinity
+    const until = opts.until ?? Infinity
+    const halfLife = opts.halfLife || 0
+    const now = opts.now ?? Date.now()
+    const weight = typeWeight(opts.types)
+    return (i) => {
+      const t = this.times[i]
+      if (t < since || t >= until) return 0
+      const w = weight(this.types[i])
+      return halfLife > 0 && w !== 0 ? w * Math.pow(2, Math.min(0, (t - now) / halfLife)) : w
+    }
+  }
+
+  /**
+   * Per-video totals of the matching events
+   * @param {{since?: number, until?: number, types?: Object<number, number>|number[], halfLife?: number, now?: number}} [opts]
+   * @returns {Map<string, {weight: number, value: number}>}
+   */
+  aggregate(opts = {}) {
+    const weigh = this._weigher(opts)
+    const totals = new Map()
+    for (let i = 0; i < this.ids.length; i++) {
+      const w = weigh(i)
+      if (w === 0) continue
+      const row = totals.get(this.ids[i])
+      if (row) {
+        row.weight += w
+        row.value += w * this.values[i]
+      } else {
+        totals.set(this.ids[i], { weight: w, value: w * this.values[i] })
+      }
+    }
+    for (const [id, row] of totals) {
+      if (row.weight === 0 && row.value === 0) totals.delete(id)
+    }
+    return totals
+  }
+
+  /**
+   * Totals of one video's matching events, or of all events
+   * @param {string|null} id
+   * @param {Object} [opts] - As for aggregate()
+   * @returns {{weight: number, value: number}}
+   */
+  totals(id = null, opts = {}) {
+    const weigh = this._weigher(opts)
+    let weight = 0
+    let value = 0
+    for (let i = 0; i < this.ids.length; i++) {
+      if (id !== null && this.ids[i] !== id) continue
+      const w = weigh(i)
+      weight += w
+      value += w * this.values[i]
+    }
+    return { weight, value }
+  }
+
+  /**
+   * Stored event count
+   * @returns {number}
+   */
+  size() {
+    return this.ids.length
+  }
+
+  clear() {
+    this.ids = []
+    this.times = []
+    this.types = []
+    this.values = []
+  }
+
+  destroy() {
+    this.clear()
+  }
+}
+
+/**
+ * Event store used by the watch logger: native when available, JS otherwise.
+ * Both expose append/appendBatch/aggregate/totals/size/clear/destroy.
+ * @type {typeof JsEventStore}
+ */
+export const EventStore = NativeEventStore || JsEventStore
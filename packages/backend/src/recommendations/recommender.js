@@ -2,136 +2,250 @@
  * Recommendation Engine
  *
  * Generates video recommendations based on watch patterns, vector similarity, and co-watch patterns.
+ * Candidate features live in a per-channel CandidateTable that is kept up
+ * to date from view diffs and the watch logger's events, so a request is
+ * one ranking pass rather than a listing, a stats scan per video and a sort.
  */
 
 import { SemanticFinder } from '../search/semantic-finder.js'
 import { WatchEventLogger } from './watch-events.js'
+import { CandidateTable } from './candidate-table.js'
+
+// Recently watched videos used as similarity queries
+const SIMILAR_SEED_VIDEOS = 3
+// Similar videos per seed kept in the similarity column
+const SIMILAR_PER_SEED = 50
+// Recent local watches that set channel affinity and are not recommended
+const RECENT_WATCHES = 50
+// Longest wait for the view to catch up before ranking
+const SYNC_TIMEOUT_MS = 1000
+
+/** @type {WeakMap<object, ChannelFeatures>} channel -> features (Recommenders are per request) */
+const channelFeatures = new WeakMap()
 
 /**
- * Recommendation engine
+ * Candidate features of one channel: its videos plus similar videos found
+ * in the global index, with watch counts from the watch logger's store
  */
-export class Recommender {
+class ChannelFeatures {
   /**
-   * @param {import('../channel/multi-writer-channel.js').MultiWriterChannel} channel - Channel instance
-   * @param {SemanticFinder} semanticFinder - Semantic finder for vector similarity
-   * @param {WatchEventLogger} watchLogger - Watch event logger
+   * @param {import('../channel/multi-writer-channel.js').MultiWriterChannel} channel
    */
-  constructor(channel, semanticFinder, watchLogger) {
+  constructor(channel) {
     this.channel = channel
-    this.semanticFinder = semanticFinder
-    this.watchLogger = watchLogger
+    this.table = new CandidateTable()
+    /** View length the table reflects (0: never synced) */
+    this.viewLength = 0
+    /** Watch logger store generation the counts came from (-1: none yet) */
+    this.generation = -1
+    /** @type {Set<string>} candidates added only because they are similar */
+    this.external = new Set()
+    /** Seeds and index size the similarity column was built for */
+    this.similarKey = null
+    this.watchLogger = null
+    this._unsubscribe = null
+    this._syncing = null
   }
 
   /**
-   * Generate recommendations for a user
-   * @param {Object} [options]
-   * @param {number} [options.limit=10] - Number of recommendations
-   * @param {string[]} [options.excludeVideoIds] - Video IDs to exclude
-   * @returns {Promise<Array<{videoId: string, score: number, reason: string}>>}
+   * Take watch counts from the logger's store, and follow its events
+   * @param {WatchEventLogger|null} watchLogger
    */
-  async generateRecommendations(options = {}) {
-    const { limit = 10, excludeVideoIds = [] } = options
+  attach(watchLogger) {
+    if (!watchLogger || watchLogger === this.watchLogger) return
+    this._unsubscribe?.()
+    this.watchLogger = watchLogger
+    this.generation = -1
+    this._unsubscribe = watchLogger.onEvent((event, sign) => {
+      this.table.watch(event.videoId, sign, event.completed ? sign : 0)
+    })
+  }
 
-    // Get user's watch history
-    const watchEvents = this.watchLogger.getLocalEvents({ limit: 50 })
-    const watchedVideoIds = new Set(watchEvents.map(e => e.videoId))
+  _video(value) {
+    if (!value?.id) return
+    this.external.delete(value.id)
+    this.table.set(value.id, { createdAt: value.uploadedAt || value.createdAt || 0, channelKey: this.channel.keyHex })
+  }
 
-    // Get all videos in channel
-    const allVideos = await this.channel.listVideos()
-    const candidateVideos = allVideos.filter(v => 
-      !watchedVideoIds.has(v.id) && !excludeVideoIds.includes(v.id)
-    )
+  /**
+   * Bring the table up to the current view: only the diff since the last
+   * sync, or a full scan the first time
+   * @returns {Promise<void>}
+   */
+  sync() {
+    if (!this._syncing) this._syncing = this._sync().finally(() => { this._syncing = null })
+    return this._syncing
+  }
 
-    if (candidateVideos.length === 0) {
-      return []
+  async _sync() {
+    const channel = this.channel
+    const watchLogger = this.watchLogger
+    if (watchLogger) {
+      // Updates the view and feeds new watch events to the listener
+      await watchLogger.sync()
+    } else {
+      try {
+        await Promise.race([
+          channel.base.update(),
+          new Promise((resolve) => setTimeout(resolve, SYNC_TIMEOUT_MS))
+        ])
+      } catch {}
     }
 
-    const recommendations = []
+    const view = channel.view
+    const length = view?.core?.length || 0
+    const generation = watchLogger ? watchLogger.generation : 0
+    if (length === this.viewLength && generation === this.generation) return
 
-    // Strategy 1: Similar videos (vector similarity)
-    if (watchEvents.length > 0 && this.semanticFinder) {
-      // Get most recently watched video
-      const recentVideo = watchEvents[0]
-      const recentVideoData = allVideos.find(v => v.id === recentVideo.videoId)
-
-      if (recentVideoData) {
-        const query = `${recentVideoData.title || ''} ${recentVideoData.description || ''}`
-        const similar = await this.semanticFinder.search(query, limit * 2)
-
-        for (const result of similar) {
-          if (!watchedVideoIds.has(result.id) && !excludeVideoIds.includes(result.id)) {
-            recommendations.push({
-              videoId: result.id,
-              score: result.score * 0.6, // Weight vector similarity
-              reason: 'similar_content'
-            })
-          }
-        }
+    const videos = { gt: 'videos/', lt: 'videos/\xff' }
+
+    if (this.viewLength > 0 && length > this.viewLength && generation === this.generation && typeof view.createDiffStream === 'function') {
+      for await (const { left, right } of view.createDiffStream(this.viewLength, videos)) {
+        if (left) this._video(left.value)
+        else if (right?.value?.id) this.table.remove(right.value.id)
+      }
+    } else {
+      this.table.clear()
+      this.external.clear()
+      this.similarKey = null
+      // Counts before the first await: later events arrive via the listener
+      for (const [videoId, { watches, completed }] of watchLogger?.watchCounts() || []) {
+        this.table.watch(videoId, watches, completed)
       }
+      for await (const { value } of view.createReadStream(videos)) this._video(value)
     }
+    this.viewLength = length
+    this.generation = generation
+  }
 
-    // Strategy 2: Popular videos (based on watch stats)
-    const popularVideos = await this._getPopularVideos(candidateVideos, limit)
-    for (const video of popularVideos) {
-      if (!recommendations.find(r => r.videoId === video.id)) {
-        recommendations.push({
-          videoId: video.id,
-          score: video.popularityScore * 0.4, // Weight popularity
-          reason: 'popular'
-        })
-      }
+  /**
+   * Set each channel's affinity to its share of the recent watches
+   * @param {Array<{channelKey?: string|null}>} watchEvents
+   */
+  setAffinity(watchEvents) {
+    const shares = new Map()
+    for (const event of watchEvents) {
+      const channelKey = event.channelKey ?? this.channel.keyHex
+      shares.set(channelKey, (shares.get(channelKey) || 0) + 1 / watchEvents.length)
     }
+    if (shares.size === 0) shares.set(this.channel.keyHex, 1)
+    this.table.setAffinity(shares)
+  }
+
+  /**
+   * Rebuild the similarity column from the seeds' nearest videos, unless
+   * neither the seeds nor the index changed since the last build
+   * @param {SemanticFinder} finder
+   * @param {string[]} seeds - Video ids, most recent first
+   * @param {Set<string>} watched - Never worth a similarity slot
+   */
+  async refreshSimilarity(finder, seeds, watched) {
+    const key = seeds.join('\n') + '\n' + (finder.globalSize?.() ?? 0)
+    if (key === this.similarKey) return
 
-    // Strategy 3: Co-watch patterns (videos watched by users who watched similar videos)
-    // Simplified: just boost videos from same channel
-    for (const video of candidateVideos) {
-      if (!recommendations.find(r => r.videoId === video.id)) {
-        recommendations.push({
-          videoId: video.id,
-          score: 0.2, // Base score
-          reason: 'channel_content'
+    const videos = (await Promise.all(seeds.map((id) => this.channel.getVideo(id).catch(() => null)))).filter(Boolean)
+    const batches = videos.length > 0
+      ? await finder.searchBatch(videos.map((video) => ({
+        query: `${video.title || ''} ${video.description || ''}`,
+        topK: SIMILAR_PER_SEED,
+        exclude: watched
+      })))
+      : []
+
+    // Best score per video across the seeds; videos of other channels
+    // become candidates for as long as they stay similar
+    const scores = new Map()
+    const found = new Set()
+    for (const results of batches) {
+      for (const result of results) {
+        if (!(scores.get(result.id) >= result.score)) scores.set(result.id, result.score)
+        if (this.table.has(result.id) && !this.external.has(result.id)) continue
+        found.add(result.id)
+        if (this.external.has(result.id)) continue
+        this.external.add(result.id)
+        this.table.set(result.id, {
+          createdAt: result.metadata?.createdAt || 0,
+          channelKey: result.metadata?.channelKey ?? null
         })
       }
     }
-
-    // Deduplicate and sort by score
-    const deduplicated = new Map()
-    for (const rec of recommendations) {
-      const existing = deduplicated.get(rec.videoId)
-      if (!existing || existing.score < rec.score) {
-        deduplicated.set(rec.videoId, rec)
-      } else {
-        // Merge scores
-        existing.score = (existing.score + rec.score) / 2
-      }
+    for (const id of this.external) {
+      if (found.has(id)) continue
+      this.external.delete(id)
+      this.table.remove(id)
     }
 
-    const sorted = Array.from(deduplicated.values())
-      .sort((a, b) => b.score - a.score)
-      .slice(0, limit)
+    this.table.setSimilarity(scores)
+    this.similarKey = key
+  }
+}
 
-    return sorted
+/**
+ * Recommendation engine
+ */
+export class Recommender {
+  /**
+   * @param {import('../channel/multi-writer-channel.js').MultiWriterChannel} channel - Channel instance
+   * @param {SemanticFinder} semanticFinder - Semantic finder for vector similarity
+   * @param {WatchEventLogger} watchLogger - Watch event logger
+   */
+  constructor(channel, semanticFinder, watchLogger) {
+    this.channel = channel
+    this.semanticFinder = semanticFinder
+    this.watchLogger = watchLogger
   }
 
   /**
-   * Get popular videos based on watch statistics
-   * @param {Array} videos - Candidate videos
-   * @param {number} limit - Number of videos to return
-   * @returns {Promise<Array<{id: string, popularityScore: number}>>}
+   * Features of this channel, shared with earlier Recommenders for it
+   * @returns {ChannelFeatures}
    */
-  async _getPopularVideos(videos, limit) {
-    const statsPromises = videos.map(async (video) => {
-      const stats = await this.watchLogger.getWatchStats(video.id)
-      return {
-        id: video.id,
-        popularityScore: stats.totalWatches * 0.5 + stats.completionRate * 0.5
+  _features() {
+    let features = channelFeatures.get(this.channel)
+    if (!features) {
+      features = new ChannelFeatures(this.channel)
+      channelFeatures.set(this.channel, features)
+    }
+    features.attach(this.watchLogger)
+    return features
+  }
+
+  /**
+   * Generate recommendations for a user. Candidates are scored on
+   * similarity to the recent watches, popularity (watches and completion
+   * rate), recency and channel affinity; the reason is the term that
+   * contributed most.
+   * @param {Object} [options]
+   * @param {number} [options.limit=10] - Number of recommendations
+   * @param {string[]} [options.excludeVideoIds] - Video IDs to exclude
+   * @returns {Promise<Array<{videoId: string, score: number, reason: string}>>}
+   */
+  async generateRecommendations(options = {}) {
+    const { limit = 10, excludeVideoIds = [] } = options
+
+    const features = this._features()
+    await features.sync()
+
+    // Get user's watch history
+    const watchEvents = this.watchLogger ? this.watchLogger.getLocalEvents({ limit: RECENT_WATCHES }) : []
+    const watchedVideoIds = new Set(watchEvents.map(e => e.videoId))
+    features.setAffinity(watchEvents)
+
+    // Similar videos, seeded by the most recently watched videos
+    if (watchEvents.length > 0 && this.semanticFinder) {
+      const seeds = []
+      for (const event of watchEvents) {
+        if (seeds.length >= SIMILAR_SEED_VIDEOS) break
+        if (!seeds.includes(event.videoId)) seeds.push(event.videoId)
       }
-    })
+      await features.refreshSimilarity(this.semanticFinder, seeds, watchedVideoIds)
+    }
 
-    const stats = await Promise.all(statsPromises)
-    return stats
-      .sort((a, b) => b.popularityScore - a.popularityScore)
-      .slice(0, limit)
+    const exclude = excludeVideoIds.length > 0 ? [...watchedVideoIds, ...excludeVideoIds] : watchedVideoIds
+    return features.table.rank(limit, { exclude }).map(r => ({
+      videoId: r.id,
+      score: r.score,
+      reason: r.reason
+    }))
   }
 
   /**
@@ -149,11 +263,9 @@ export class Recommender {
     // Use semantic similarity
     if (this.semanticFinder) {
       const query = `${video.title || ''} ${video.description || ''}`
-      const similar = await this.semanticFinder.search(query, limit + 1) // +1 to exclude self
+      const similar = await this.semanticFinder.search(query, limit, { exclude: [videoId], hybrid: false })
 
       return similar
-        .filter(r => r.id !== videoId)
-        .slice(0, limit)
         .map(r => ({
           videoId: r.id,
           score: r.score,
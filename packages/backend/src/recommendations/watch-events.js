@@ -3,14 +3,31 @@
  *
  * Logs watch events for videos to enable recommendation generation.
  * Events are stored locally and optionally shared (with privacy controls).
+ * Local and replicated events are also kept in a columnar EventStore, fed
+ * from view diffs, so watch statistics are one aggregation pass instead of
+ * a view scan per request.
  */
 
 import b4a from 'b4a'
 import crypto from 'hypercore-crypto'
-import { prefixedKey } from '../channel/util.js'
+import { EventStore } from './event-store.js'
 
 const CURRENT_SCHEMA_VERSION = 1
 
+// Event types in the store. An event the view dropped is recorded again
+// with RETRACTED added to its type and counts -1, so the store stays
+// append-only.
+const EVENT_WATCH = 0
+const EVENT_COMPLETED = 1
+const RETRACTED = 2
+
+// Type weights for counting watches and completions
+const WATCHES = { [EVENT_WATCH]: 1, [EVENT_COMPLETED]: 1, [EVENT_WATCH + RETRACTED]: -1, [EVENT_COMPLETED + RETRACTED]: -1 }
+const COMPLETIONS = { [EVENT_COMPLETED]: 1, [EVENT_COMPLETED + RETRACTED]: -1 }
+
+// Longest wait for the view to catch up before reading it
+const SYNC_TIMEOUT_MS = 1000
+
 /**
  * Watch event logger for a multi-writer channel
  */
@@ -21,6 +38,29 @@ export class WatchEventLogger {
   constructor(channel) {
     this.channel = channel
     this.localEvents = [] // Local event cache (not shared)
+    /** Local and replicated events */
+    this.store = new EventStore()
+    /** View length the store reflects (0: never synced) */
+    this.viewLength = 0
+    /** Bumped each time the store is rebuilt from a full view scan */
+    this.generation = 0
+    /** @type {Set<string>} local events (skipped when they replicate back) */
+    this._localEventIds = new Set()
+    /** @type {Set<(event: Object, sign: number) => void>} */
+    this._listeners = new Set()
+    this._syncing = null
+  }
+
+  /**
+   * Be told about each watch event the store records: local events as they
+   * are logged, replicated ones as sync() reads them from the view (sign -1
+   * when the view dropped one). Full rebuilds bump `generation` instead.
+   * @param {(event: Object, sign: number) => void} listener
+   * @returns {() => void} Unsubscribe
+   */
+  onEvent(listener) {
+    this._listeners.add(listener)
+    return () => this._listeners.delete(listener)
   }
 
   /**
@@ -54,6 +94,9 @@ export class WatchEventLogger {
 
     // Always store locally
     this.localEvents.push(event)
+    this._localEventIds.add(eventId)
+    this._record(event, 1)
+    for (const listener of this._listeners) listener(event, 1)
 
     // Only share if explicitly requested (privacy by default)
     if (share) {
@@ -99,56 +142,102 @@ export class WatchEventLogger {
   }
 
   /**
-   * Get aggregated watch statistics (for recommendations)
-   * @param {string} [videoId] - Filter by video ID
-   * @returns {Promise<{totalWatches: number, totalDuration: number, completionRate: number}>}
+   * Append an event to the store (sign -1 records its retraction)
+   * @param {{videoId: string, timestamp?: number, duration?: number, completed?: boolean}} event
+   * @param {number} sign
    */
-  async getWatchStats(videoId = null) {
-    // Ensure view is up to date
+  _record(event, sign) {
+    const type = (event.completed ? EVENT_COMPLETED : EVENT_WATCH) + (sign < 0 ? RETRACTED : 0)
+    this.store.append(event.videoId, event.timestamp || 0, type, event.duration || 0)
+  }
+
+  _viewEvent(value, sign) {
+    if (!value?.videoId || this._localEventIds.has(value.eventId)) return
+    this._record(value, sign)
+    for (const listener of this._listeners) listener(value, sign)
+  }
+
+  /**
+   * Bring the store up to the current view: only the diff since the last
+   * sync, or a full rebuild the first time
+   * @returns {Promise<void>}
+   */
+  sync() {
+    if (!this._syncing) this._syncing = this._sync().finally(() => { this._syncing = null })
+    return this._syncing
+  }
+
+  async _sync() {
+    const channel = this.channel
     try {
       await Promise.race([
-        this.channel.base.update(),
-        new Promise((resolve) => setTimeout(resolve, 1000))
+        channel.base.update(),
+        new Promise((resolve) => setTimeout(resolve, SYNC_TIMEOUT_MS))
       ])
     } catch {}
 
-    const prefix = prefixedKey('watch-events', videoId ? `${videoId}/` : '')
-    const start = `${prefix}`
-    const end = `${prefix}\xff`
-
-    let totalWatches = 0
-    let totalDuration = 0
-    let completedWatches = 0
-
-    for await (const { value } of this.channel.view.createReadStream({ gt: start, lt: end })) {
-      if (value && (!videoId || value.videoId === videoId)) {
-        totalWatches++
-        totalDuration += value.duration || 0
-        if (value.completed) {
-          completedWatches++
-        }
-      }
-    }
+    const view = channel.view
+    const length = view?.core?.length || 0
+    if (length === this.viewLength) return
 
-    // Add local events
-    const localFiltered = videoId
-      ? this.localEvents.filter(e => e.videoId === videoId)
-      : this.localEvents
+    const range = { gt: 'watch-events/', lt: 'watch-events/\xff' }
 
-    for (const event of localFiltered) {
-      totalWatches++
-      totalDuration += event.duration || 0
-      if (event.completed) {
-        completedWatches++
+    if (this.viewLength > 0 && length > this.viewLength && typeof view.createDiffStream === 'function') {
+      for await (const { left, right } of view.createDiffStream(this.viewLength, range)) {
+        if (right) this._viewEvent(right.value, -1)
+        if (left) this._viewEvent(left.value, 1)
       }
+    } else {
+      // Events logged during the scan are appended by logWatchEvent
+      this.store.clear()
+      for (const event of this.localEvents) this._record(event, 1)
+      for await (const { value } of view.createReadStream(range)) {
+        if (value?.videoId && !this._localEventIds.has(value.eventId)) this._record(value, 1)
+      }
+      this.generation++
+    }
+    this.viewLength = length
+  }
+
+  /**
+   * Watches and completions per video (local and replicated)
+   * @param {{since?: number, until?: number}} [options] - Time window in ms
+   * @returns {Map<string, {watches: number, completed: number}>}
+   */
+  watchCounts(options = {}) {
+    const { since, until } = options
+    const watches = this.store.aggregate({ since, until, types: WATCHES })
+    const completions = this.store.aggregate({ since, until, types: COMPLETIONS })
+    const counts = new Map()
+    for (const [videoId, row] of watches) {
+      counts.set(videoId, { watches: row.weight, completed: completions.get(videoId)?.weight || 0 })
     }
+    return counts
+  }
+
+  /**
+   * Get aggregated watch statistics (for recommendations)
+   * @param {string} [videoId] - Filter by video ID
+   * @param {Object} [options]
+   * @param {number} [options.since] - Only events at or after this time (ms)
+   * @param {number} [options.halfLife] - Decay events by age with this
+   *   half-life in ms, for a recency-weighted popularity
+   * @returns {Promise<{totalWatches: number, totalDuration: number, completionRate: number, averageDuration: number}>}
+   */
+  async getWatchStats(videoId = null, options = {}) {
+    await this.sync()
+
+    const query = { since: options.since, halfLife: options.halfLife || 0, now: Date.now() }
+    const watches = this.store.totals(videoId, { ...query, types: WATCHES })
+    const completed = this.store.totals(videoId, { ...query, types: COMPLETIONS }).weight
 
-    const completionRate = totalWatches > 0 ? completedWatches / totalWatches : 0
+    const totalWatches = watches.weight
+    const totalDuration = watches.value
 
     return {
       totalWatches,
       totalDuration,
-      completionRate,
+      completionRate: totalWatches > 0 ? completed / totalWatches : 0,
       averageDuration: totalWatches > 0 ? totalDuration / totalWatches : 0
     }
   }
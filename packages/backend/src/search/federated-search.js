@@ -2,13 +2,112 @@
  * Federated Search Coordinator
  *
  * Coordinates distributed search across multiple peers via Hyperswarm.
- * Each peer searches locally and results are merged client-side.
+ * Each peer searches locally and results are merged client-side: every
+ * response is fed to a k-way merger as it arrives, and the search answers
+ * once enough peers have responded rather than waiting for the timeout.
  */
 
 import crypto from 'hypercore-crypto'
 import b4a from 'b4a'
 import Protomux from 'protomux'
 import c from 'compact-encoding'
+import { ResultMerger, hashIds } from './result-merger.js'
+
+// Peer queries arriving within this window are answered with one batched
+// index pass; a full batch is flushed immediately
+const REMOTE_BATCH_WINDOW_MS = 5
+const REMOTE_BATCH_MAX = 64
+
+// Peer responses to wait for before answering (fewer if fewer are connected)
+const DEFAULT_MIN_PEERS = 3
+
+/**
+ * Wire format. A response carries its results as packed columns, best
+ * first: 64-bit id hashes (hashIds) and float32 scores, which the requester
+ * merges as they are; ids and JSON metadata are only read for the results
+ * that make the final top-K.
+ */
+const searchQuery = {
+  preencode(state, m) {
+    c.fixed32.preencode(state, m.queryId)
+    c.string.preencode(state, m.channelKey || '')
+    c.string.preencode(state, m.query)
+    c.uint.preencode(state, m.topK)
+  },
+  encode(state, m) {
+    c.fixed32.encode(state, m.queryId)
+    c.string.encode(state, m.channelKey || '')
+    c.string.encode(state, m.query)
+    c.uint.encode(state, m.topK)
+  },
+  decode(state) {
+    return {
+      queryId: c.fixed32.decode(state),
+      channelKey: c.string.decode(state) || null,
+      query: c.string.decode(state),
+      topK: c.uint.decode(state)
+    }
+  }
+}
+
+const idList = c.array(c.string)
+const metadataList = c.array(c.buffer)
+
+const searchResponse = {
+  preencode(state, m) {
+    c.fixed32.preencode(state, m.queryId)
+    c.uint32array.preencode(state, m.hashes)
+    c.float32array.preencode(state, m.scores)
+    idList.preencode(state, m.ids)
+    metadataList.preencode(state, m.metadata)
+  },
+  encode(state, m) {
+    c.fixed32.encode(state, m.queryId)
+    c.uint32array.encode(state, m.hashes)
+    c.float32array.encode(state, m.scores)
+    idList.encode(state, m.ids)
+    metadataList.encode(state, m.metadata)
+  },
+  decode(state) {
+    return {
+      queryId: c.fixed32.decode(state),
+      hashes: c.uint32array.decode(state),
+      scores: c.float32array.decode(state),
+      ids: idList.decode(state),
+      metadata: metadataList.decode(state)
+    }
+  }
+}
+
+/**
+ * Pack search results into a response
+ * @param {Uint8Array} queryId
+ * @param {Array<{id: string, score: number, metadata?: any}>} results - Best first
+ */
+function packResults(queryId, results) {
+  return {
+    queryId,
+    hashes: hashIds(results.map((r) => r.id)),
+    scores: Float32Array.from(results, (r) => r.score),
+    ids: results.map((r) => String(r.id)),
+    metadata: results.map((r) => (r.metadata == null ? null : b4a.from(JSON.stringify(r.metadata))))
+  }
+}
+
+/**
+ * Result `position` of a decoded response
+ * @returns {{id: string, score: number, metadata: any}}
+ */
+function unpackResult(response, position, score) {
+  let metadata = null
+  const bytes = response.metadata[position]
+  if (bytes) {
+    try {
+      metadata = JSON.parse(b4a.toString(bytes, 'utf-8'))
+    } catch {}
+  }
+  return { id: response.ids[position], score, metadata }
+}
 
 /**
  * Federated search coordinator
@@ -25,16 +124,20 @@ export class FederatedSearch {
     this.finder = finder
     this.ensureIndexed = typeof opts.ensureIndexed === 'function' ? opts.ensureIndexed : null
     this.searchTopic = null
-    /** @type {Map<string, {resultSets: Array<Array>, timeoutId: any, resolve: Function}>} */
-    this.pendingQueries = new Map() // queryId -> aggregation state
+    /** @type {Map<string, {merger: InstanceType<typeof ResultMerger>, responses: Array<Object>, topK: number, minPeers: number, timeoutId: any, finish: Function}>} */
+    this.pendingQueries = new Map() // queryId hex -> aggregation state
 
     /** @type {Map<any, any>} conn -> protomux channel */
     this.peerChannels = new Map()
     this._connectionHandler = null
+
+    /** @type {Array<{request: {query: string, topK: number, channelKey: string|null}, resolve: Function}>} */
+    this._remoteQueue = []
+    this._remoteTimer = null
   }
 
   static protocolName() {
-    return 'peartube-search-v1'
+    return 'peartube-search-v2'
   }
 
   /**
@@ -94,8 +197,11 @@ export class FederatedSearch {
     const channel = mux.createChannel({
       protocol: FederatedSearch.protocolName(),
       messages: [{
-        encoding: c.json,
-        onmessage: (msg) => this._handleMessage(msg, conn)
+        encoding: searchQuery,
+        onmessage: (msg) => this._handleQuery(msg, conn)
+      }, {
+        encoding: searchResponse,
+        onmessage: (msg) => this._handleResponse(msg)
       }],
       onopen: () => {
         // Channel ready for requests
@@ -110,41 +216,77 @@ export class FederatedSearch {
     channel.open()
   }
 
-  async _handleMessage(msg, conn) {
-    if (!msg || typeof msg !== 'object') return
+  async _handleQuery(msg, conn) {
+    if (!msg || typeof msg.query !== 'string') return
 
-    if (msg.type === 'SEARCH_QUERY' && msg.queryId && typeof msg.query === 'string') {
-      const channelKey = typeof msg.channelKey === 'string' ? msg.channelKey : null
-      const topK = typeof msg.topK === 'number' ? msg.topK : 10
+    try {
+      if (this.ensureIndexed && msg.channelKey) {
+        await this.ensureIndexed(msg.channelKey)
+      }
+    } catch {}
 
-      try {
-        if (this.ensureIndexed && channelKey) {
-          await this.ensureIndexed(channelKey)
-        }
-      } catch {}
+    const results = await this._queueRemoteQuery({ query: msg.query, topK: msg.topK || 10, channelKey: msg.channelKey })
+
+    const ch = this.peerChannels.get(conn)
+    if (!ch) return
+    try {
+      ch.messages[1].send(packResults(msg.queryId, results))
+    } catch {}
+  }
 
-      let results = []
-      try {
-        results = await this.finder.search(msg.query, topK, channelKey ? { channelKey } : {})
-      } catch {
-        results = []
+  _handleResponse(msg) {
+    if (!msg) return
+    const pending = this.pendingQueries.get(b4a.toString(msg.queryId, 'hex'))
+    if (!pending) return
+
+    const count = msg.scores.length
+    if (msg.hashes.length !== count * 2 || msg.ids.length !== count || msg.metadata.length !== count) return
+
+    // Source i + 1 is responses[i]; source 0 is the local search
+    pending.merger.add(msg.hashes, msg.scores, pending.topK)
+    pending.responses.push(msg)
+    if (pending.responses.length >= pending.minPeers) pending.finish()
+  }
+
+  /**
+   * Queue a peer's query for the next batched local search
+   * @param {{query: string, topK: number, channelKey: string|null}} request
+   * @returns {Promise<Array>} Results (empty on failure)
+   */
+  _queueRemoteQuery(request) {
+    return new Promise((resolve) => {
+      this._remoteQueue.push({ request, resolve })
+      if (this._remoteQueue.length >= REMOTE_BATCH_MAX) {
+        this._flushRemoteQueries()
+      } else if (!this._remoteTimer) {
+        this._remoteTimer = setTimeout(() => this._flushRemoteQueries(), REMOTE_BATCH_WINDOW_MS)
       }
+    })
+  }
+
+  async _flushRemoteQueries() {
+    if (this._remoteTimer) {
+      clearTimeout(this._remoteTimer)
+      this._remoteTimer = null
+    }
+
+    const queue = this._remoteQueue
+    this._remoteQueue = []
+    if (queue.length === 0) return
 
-      const ch = this.peerChannels.get(conn)
-      if (!ch) return
-      try {
-        ch.messages[0].send({
-          type: 'SEARCH_RESPONSE',
-          queryId: msg.queryId,
-          results
-        })
-      } catch {}
-    } else if (msg.type === 'SEARCH_RESPONSE' && msg.queryId) {
-      const pending = this.pendingQueries.get(msg.queryId)
-      if (!pending) return
-      const results = Array.isArray(msg.results) ? msg.results : []
-      pending.resultSets.push(results)
+    const requests = queue.map((q) => q.request)
+    let results
+    try {
+      if (typeof this.finder.searchBatch === 'function') {
+        results = await this.finder.searchBatch(requests)
+      } else {
+        results = await Promise.all(requests.map((r) => this.finder.search(r.query, r.topK, r.channelKey ? { channelKey: r.channelKey } : {})))
+      }
+    } catch {
+      results = []
     }
+
+    queue.forEach((q, i) => q.resolve(results[i] || []))
   }
 
   /**
@@ -154,6 +296,8 @@ export class FederatedSearch {
    * @param {number} [options.topK=10] - Number of results
    * @param {boolean} [options.federated=true] - Whether to search peers
    * @param {number} [options.timeout=5000] - Timeout for federated search in ms
+   * @param {number} [options.minPeers=3] - Answer as soon as this many peers
+   *   have responded (or every peer asked, if fewer)
    * @param {string} [options.channelKey] - Channel key to scope the search
    * @returns {Promise<Array<{id: string, score: number, metadata: any}>>}
    */
@@ -162,6 +306,7 @@ export class FederatedSearch {
       topK = 10,
       federated = true,
       timeout = 5000,
+      minPeers = DEFAULT_MIN_PEERS,
       channelKey = null
     } = options
 
@@ -174,46 +319,63 @@ export class FederatedSearch {
     // Search locally first
     const localResults = await this.finder.search(query, topK, channelKey ? { channelKey } : {})
 
-    if (!federated || !this.swarm || !this.searchTopic) {
+    if (!federated || !this.swarm || !this.searchTopic || this.peerChannels.size === 0) {
       return localResults
     }
 
-    // Broadcast query to peers and collect results
-    const peerResults = await this._broadcastSearch(query, topK, timeout, channelKey)
-
-    // Merge results: combine local and peer results, deduplicate by ID, re-rank
-    return this._mergeResults(localResults, peerResults, topK)
+    const merger = new ResultMerger()
+    try {
+      merger.add(hashIds(localResults.map((r) => r.id)), Float32Array.from(localResults, (r) => r.score), topK)
+
+      // Broadcast query to peers; their responses are merged as they arrive
+      const responses = await this._broadcastSearch(query, topK, timeout, channelKey, merger, minPeers)
+
+      // Best topK distinct results; each keeps its best score
+      return merger.merge(topK).map(({ source, position, score }) => (
+        source === 0
+          ? localResults[position]
+          : unpackResult(responses[source - 1], position, score)
+      ))
+    } finally {
+      merger.destroy()
+    }
   }
 
   /**
-   * Broadcast search query to peers
+   * Broadcast search query to peers, feeding their responses to `merger`
    * @param {string} query
    * @param {number} topK
    * @param {number} timeout
-   * @returns {Promise<Array<Array>>}
+   * @param {string|null} channelKey
+   * @param {InstanceType<typeof ResultMerger>} merger
+   * @param {number} minPeers
+   * @returns {Promise<Array<Object>>} Responses in merger source order (from 1)
    */
-  async _broadcastSearch(query, topK, timeout, channelKey) {
-    const queryId = b4a.toString(crypto.randomBytes(16), 'hex')
+  async _broadcastSearch(query, topK, timeout, channelKey, merger, minPeers) {
+    const queryId = crypto.randomBytes(32)
+    const key = b4a.toString(queryId, 'hex')
 
     // Snapshot of current peers with protocol channels open
     const channels = Array.from(this.peerChannels.values())
 
     return new Promise((resolve) => {
       const state = {
-        resultSets: [],
-        resolve,
-        timeoutId: null
+        merger,
+        responses: [],
+        topK,
+        minPeers: Math.max(1, Math.min(minPeers, channels.length)),
+        timeoutId: null,
+        finish: () => {
+          clearTimeout(state.timeoutId)
+          this.pendingQueries.delete(key)
+          resolve(state.responses)
+        }
       }
 
-      state.timeoutId = setTimeout(() => {
-        this.pendingQueries.delete(queryId)
-        resolve(state.resultSets)
-      }, timeout)
-
-      this.pendingQueries.set(queryId, state)
+      state.timeoutId = setTimeout(state.finish, timeout)
+      this.pendingQueries.set(key, state)
 
       const msg = {
-        type: 'SEARCH_QUERY',
         queryId,
         channelKey: channelKey || null,
         query,
@@ -228,38 +390,5 @@ export class FederatedSearch {
     })
   }
 
-  /**
-   * Merge local and peer search results
-   * @param {Array} localResults
-   * @param {Array<Array>} peerResults
-   * @param {number} topK
-   * @returns {Array}
-   */
-  _mergeResults(localResults, peerResults, topK) {
-    const merged = new Map()
-
-    // Add local results
-    for (const result of localResults) {
-      merged.set(result.id, result)
-    }
-
-    // Add peer results (aggregate scores for duplicates)
-    for (const peerResultSet of peerResults) {
-      for (const result of peerResultSet) {
-        const existing = merged.get(result.id)
-        if (existing) {
-          // Average scores for duplicates
-          existing.score = (existing.score + result.score) / 2
-        } else {
-          merged.set(result.id, result)
-        }
-      }
-    }
-
-    // Sort by score and return top K
-    const sorted = Array.from(merged.values()).sort((a, b) => b.score - a.score)
-    return sorted.slice(0, topK)
-  }
-
   // Incoming peer queries are handled by the protomux channel `onmessage` handler.
 }
@@ -0,0 +1,166 @@
+/**
+ * Feature-hashing text embedding
+ *
+ * Offline embedding used when no transformers.js model loads. Each word adds
+ * a word feature, a bigram feature with the previous word and the 3/4/5-byte
+ * grams of "<word>", hashed with murmur3 into signed buckets, and the sum is
+ * L2-normalised. One pass over the text, so cost is linear in its length.
+ *
+ * Uses the bare-embed native addon when it is available; the JS version
+ * below follows the same scheme step for step (see bare-embed/src/hash_embed.h)
+ * so peers with and without the addon produce matching vectors.
+ */
+
+import b4a from 'b4a'
+
+// Native embedder (Bare only); absent under Node and in builds without the addon
+let native = null
+try {
+  const mod = await import('bare-embed')
+  native = mod.default || mod
+} catch (e) {
+  console.log('[HashEmbed] bare-embed not available, using JS embedder')
+}
+
+/** Names the scheme; persisted next to indexes built with it */
+export const HASH_EMBEDDER = 'feature-hash-v1'
+
+const BIGRAM_WEIGHT = 0.5
+const MIN_GRAM = 3
+const MAX_GRAM = 5
+
+/**
+ * MurmurHash3 x86_32 over bytes[start, end)
+ * @param {Uint8Array} bytes
+ * @param {number} start
+ * @param {number} end
+ * @param {number} seed
+ * @returns {number} Unsigned 32-bit hash
+ */
+export function murmur3(bytes, start, end, seed) {
+  let h = seed | 0
+  let i = start
+
+  for (; i + 4 <= end; i += 4) {
+    let k = bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16) | (bytes[i + 3] << 24)
+    k = Math.imul(k, 0xcc9e2d51)
+    k = (k << 15) | (k >>> 17)
+    k = Math.imul(k, 0x1b873593)
+
+    h ^= k
+    h = (h << 13) | (h >>> 19)
+    h = (Math.imul(h, 5) + 0xe6546b64) | 0
+  }
+
+  const tail = end - i
+  if (tail > 0) {
+    let k = 0
+    if (tail === 3) k ^= bytes[i + 2] << 16
+    if (tail >= 2) k ^= bytes[i + 1] << 8
+    k ^= bytes[i]
+    k = Math.imul(k, 0xcc9e2d51)
+    k = (k << 15) | (k >>> 17)
+    k = Math.imul(k, 0x1b873593)
+    h ^= k
+  }
+
+  h ^= end - start
+  h ^= h >>> 16
+  h = Math.imul(h, 0x85ebca6b)
+  h ^= h >>> 13
+  h = Math.imul(h, 0xc2b2ae35)
+  h ^= h >>> 16
+  return h >>> 0
+}
+
+function isWordByte(c) {
+  return (c >= 0x61 && c <= 0x7a) || (c >= 0x41 && c <= 0x5a) || (c >= 0x30 && c <= 0x39) || c >= 0x80
+}
+
+function add(out, hash, weight) {
+  const i = Math.floor((hash * out.length) / 0x100000000)
+  out[i] = out[i] + (hash & 1 ? -weight : weight)
+}
+
+/**
+ * Pure JS embedder (same vectors as the native one)
+ * @param {string} text
+ * @param {number} dimension
+ * @returns {Float32Array}
+ */
+export function jsHashEmbed(text, dimension) {
+  const out = new Float32Array(dimension)
+  const bytes = b4a.from(typeof text === 'string' ? text : '', 'utf8')
+  const len = bytes.length
+  // "<word>", lowercased
+  let word = new Uint8Array(64)
+  let prev = 0
+  let hasPrev = false
+  let i = 0
+
+  while (i < len) {
+    while (i < len && !isWordByte(bytes[i])) i++
+    if (i === len) break
+
+    let w = 0
+    word[w++] = 0x3c
+    while (i < len && isWordByte(bytes[i])) {
+      if (w + 1 >= word.length) {
+        const grown = new Uint8Array(word.length * 2)
+        grown.set(word)
+        word = grown
+      }
+      const c = bytes[i++]
+      word[w++] = c >= 0x41 && c <= 0x5a ? c + 32 : c
+    }
+    word[w++] = 0x3e
+
+    const hash = murmur3(word, 1, w - 1, 0)
+    add(out, hash, 1)
+    if (hasPrev) add(out, murmur3(word, 1, w - 1, prev), BIGRAM_WEIGHT)
+    prev = hash
+    hasPrev = true
+
+    let grams = 0
+    for (let n = MIN_GRAM; n <= MAX_GRAM; n++) {
+      if (w >= n) grams += w - n + 1
+    }
+    if (grams === 0) continue
+
+    const weight = 1 / Math.sqrt(grams)
+    for (let n = MIN_GRAM; n <= MAX_GRAM; n++) {
+      for (let start = 0; start + n <= w; start++) add(out, murmur3(word, start, start + n, n), weight)
+    }
+  }
+
+  let sum = 0
+  for (let j = 0; j < dimension; j++) sum += out[j] * out[j]
+  if (sum > 0) {
+    const scale = 1 / Math.sqrt(sum)
+    for (let j = 0; j < dimension; j++) out[j] *= scale
+  }
+  return out
+}
+
+/**
+ * Embed one text
+ * @param {string} text
+ * @param {number} dimension
+ * @returns {Float32Array}
+ */
+export function hashEmbed(text, dimension) {
+  return native ? native.hashEmbed(text, dimension) : jsHashEmbed(text, dimension)
+}
+
+/**
+ * Embed many texts (one native call when the addon is loaded)
+ * @param {string[]} texts
+ * @param {number} dimension
+ * @returns {Float32Array[]}
+ */
+export function hashEmbedBatch(texts, dimension) {
+  return native ? native.hashEmbedBatch(texts, dimension) : texts.map((text) => jsHashEmbed(text, dimension))
+}
+
+/** @type {'native'|'js'} */
+export const hashEmbedBackend = native ? 'native' : 'js'
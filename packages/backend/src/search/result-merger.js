@@ -0,0 +1,109 @@
+/**
+ * Federated Result Merger
+ *
+ * K-way merge of ranked result lists (the local search plus each peer's
+ * response) identified by 64-bit id hashes, keeping each result's best
+ * score. Uses the bare-vector-index native merger when it is available and
+ * a JS merge otherwise.
+ */
+
+import b4a from 'b4a'
+import { murmur3 } from './hash-embed.js'
+
+// Native merger (Bare only); absent under Node and in builds without the addon
+let NativeResultMerger = null
+try {
+  const mod = await import('bare-vector-index')
+  NativeResultMerger = (mod.default || mod).ResultMerger || null
+} catch {}
+
+/**
+ * 64-bit hashes of result ids as (low, high) Uint32Array word pairs: two
+ * murmur3 passes over the UTF-8 bytes. Part of the search wire format.
+ * @param {string[]} ids
+ * @returns {Uint32Array}
+ */
+export function hashIds(ids) {
+  const words = new Uint32Array(ids.length * 2)
+  for (let i = 0; i < ids.length; i++) {
+    const bytes = b4a.from(String(ids[i]), 'utf-8')
+    words[i * 2] = murmur3(bytes, 0, bytes.length, 0)
+    words[i * 2 + 1] = murmur3(bytes, 0, bytes.length, 0x9747b28c)
+  }
+  return words
+}
+
+/**
+ * JS result merger (fallback when the native addon is not available)
+ */
+export class JsResultMerger {
+  constructor() {
+    /** @type {Array<Array<{key: string, score: number, position: number}>>} best-first */
+    this._sources = []
+  }
+
+  /**
+   * Add one source's results
+   * @param {Uint32Array} hashes - Two words per result
+   * @param {Float32Array} scores
+   * @param {number} [limit] - Keep at most this many of its best results
+   * @returns {number} Source index
+   */
+  add(hashes, scores, limit = scores.length) {
+    if (hashes.length !== scores.length * 2) throw new Error('Expected two hash words per score')
+    const entries = []
+    for (let i = 0; i < scores.length; i++) {
+      if (Number.isNaN(scores[i])) continue
+      entries.push({ key: `${hashes[i * 2 + 1]}:${hashes[i * 2]}`, score: scores[i], position: i })
+    }
+    entries.sort((a, b) => b.score - a.score || a.position - b.position)
+    this._sources.push(entries.slice(0, limit))
+    return this._sources.length - 1
+  }
+
+  /**
+   * Best distinct results across the sources added so far
+   * @param {number} topK
+   * @returns {Array<{source: number, position: number, score: number}>}
+   */
+  merge(topK) {
+    const all = []
+    this._sources.forEach((entries, source) => {
+      for (const entry of entries) all.push({ ...entry, source })
+    })
+    all.sort((a, b) => b.score - a.score || a.source - b.source || a.position - b.position)
+
+    const seen = new Set()
+    const results = []
+    for (const entry of all) {
+      if (results.length >= topK) break
+      if (seen.has(entry.key)) continue
+      seen.add(entry.key)
+      results.push({ source: entry.source, position: entry.position, score: entry.score })
+    }
+    return results
+  }
+
+  /**
+   * Sources added
+   * @returns {number}
+   */
+  sources() {
+    return this._sources.length
+  }
+
+  clear() {
+    this._sources = []
+  }
+
+  destroy() {
+    this.clear()
+  }
+}
+
+/**
+ * Merger used by federated search: native when available, JS otherwise.
+ * Both expose add/merge/sources/clear/destroy.
+ * @type {typeof JsResultMerger}
+ */
+export const ResultMerger = NativeResultMerger || JsResultMerger
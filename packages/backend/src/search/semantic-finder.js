@@ -2,8 +2,9 @@
  * Semantic Finder - Embedding Generation and Search
  *
  * Generates embeddings for video titles/descriptions and provides semantic search.
- * Uses Hugging Face transformers.js embeddings when available, with a lightweight
- * fallback for runtimes that cannot load models.
+ * Uses the native int8 sentence encoder when a converted model file is present,
+ * then Hugging Face transformers.js embeddings, with a lightweight fallback for
+ * runtimes that cannot load models.
  *
  * YouTube-Fast Architecture:
  * - Single GLOBAL index (not per-channel) for O(1) search
@@ -12,11 +13,28 @@
  */
 
 import b4a from 'b4a'
-import { VectorIndex } from './vector-index.js'
+import { VectorIndex, ApproximateVectorIndex } from './vector-index.js'
+import { HASH_EMBEDDER, hashEmbed, hashEmbedBatch } from './hash-embed.js'
+import { openSentenceEncoder } from './sentence-encoder.js'
 
 const DEFAULT_EMBEDDING_MODEL = 'Xenova/all-MiniLM-L6-v2'
 const DEFAULT_DIMENSION = 384
 const INDEX_STORAGE_KEY = 'semantic-vector-index'
+const CURSOR_STORAGE_KEY = 'semantic-vector-cursors'
+const EMBEDDER_STORAGE_KEY = 'semantic-embedder'
+// Texts per native encoder call (one synchronous, multi-threaded pass)
+const NATIVE_EMBED_BATCH = 32
+// Vector records handed to the index per native batch while ingesting a view
+const INGEST_BATCH = 256
+// Delay before checksumming a freshly opened index file (reads every page)
+const INDEX_VERIFY_DELAY_MS = 30000
+// Fold the delta log into the base file once it outgrows this or half the
+// vector matrix, whichever is larger (keeps compaction amortised O(1)/add)
+const LOG_COMPACT_MIN_BYTES = 8 * 1024 * 1024
+// Metadata fields keyword-scored for hybrid search: the global index holds
+// title/description, channel indexes the text stored with the view vector
+const GLOBAL_TEXT_KEYS = ['title', 'description']
+const CHANNEL_TEXT_KEYS = ['text']
 
 /**
  * Semantic Finder for video search
@@ -26,27 +44,39 @@ export class SemanticFinder {
    * @param {Object} [opts]
    * @param {string} [opts.model] - transformers.js model id
    * @param {Object} [opts.metaDb] - Hyperbee for persistence
+   * @param {string} [opts.indexPath] - Binary index file plus delta log
+   *   (native index only); the metaDb copy is then only read once to migrate
+   * @param {string} [opts.encoderPath] - Model file for the native sentence
+   *   encoder (bare-embed); preferred over transformers.js when it opens
    */
   constructor(opts = {}) {
     this.model = opts.model || DEFAULT_EMBEDDING_MODEL
     this.metaDb = opts.metaDb || null
-    // Single GLOBAL index for fast search across all channels
-    this.globalIndex = new VectorIndex()
+    this.indexPath = typeof ApproximateVectorIndex.load === 'function' ? opts.indexPath || null : null
+    this.encoderPath = opts.encoderPath || null
+    // Single GLOBAL index for fast search across all channels (HNSW when native)
+    this.globalIndex = new ApproximateVectorIndex({ textKeys: GLOBAL_TEXT_KEYS })
     // Legacy per-channel indexes (for backward compatibility)
     this.index = this.globalIndex // alias
     /** @type {Map<string, VectorIndex>} */
     this._channelIndexes = new Map()
-    /** @type {Map<string, number>} channelKey -> last seen view core length */
-    this._channelVectorViewLengths = new Map()
-    /** @type {Map<string, number>} channelKey -> last seen view core length (global index) */
-    this._globalVectorViewLengths = new Map()
+    /** @type {Map<string, {length: number, key: string|null}>} channelKey -> view cursor (channel indexes) */
+    this._channelVectorCursors = new Map()
+    /** @type {Map<string, {length: number, key: string|null}>} channelKey -> view cursor (global index, persisted) */
+    this._globalVectorCursors = new Map()
+    this._cursorsDirty = false
     /** @type {Set<string>} Track which videos are already indexed */
     this._indexedVideoIds = new Set()
     this.initialized = false
     this._initPromise = null
     this._extractor = null
+    this._encoder = null
     this._saveTimeout = null
+    this._verifyTimeout = null
     this._dirty = false
+    this._legacyStored = false
+    // Set once the global index is backed by the file at indexPath
+    this._fileBacked = false
   }
 
   /**
@@ -58,6 +88,15 @@ export class SemanticFinder {
 
     this._initPromise = (async () => {
       console.log('[SemanticFinder] Starting init...')
+      // Native encoder first: maps the model file, no load timeout needed
+      this._encoder = openSentenceEncoder(this.encoderPath)
+      if (this._encoder) {
+        this._setDimension(this._encoder.dimension)
+        this.initialized = true
+        console.log('[SemanticFinder] Native encoder loaded:', this._encoder.name, 'dimension:', this.index.dimension)
+        return
+      }
+
       // Default to hash embedding; upgrade to transformers.js when possible.
       try {
         // Hide module name from bare-pack static analysis by using string concatenation
@@ -93,16 +132,15 @@ export class SemanticFinder {
         try {
           const probe = await this._extractor('probe', { pooling: 'mean', normalize: true })
           const vec = probe?.data instanceof Float32Array ? probe.data : null
-          const dim = vec?.length || DEFAULT_DIMENSION
-          this.index.dimension = dim
+          this._setDimension(vec?.length || DEFAULT_DIMENSION)
         } catch {
-          this.index.dimension = DEFAULT_DIMENSION
+          this._setDimension(DEFAULT_DIMENSION)
         }
       } catch (err) {
         // transformers.js not installed or model load failed — continue with fallback
         console.log('[SemanticFinder] transformers.js not available, using hash fallback:', err?.message)
         this._extractor = null
-        this.index.dimension = DEFAULT_DIMENSION
+        this._setDimension(DEFAULT_DIMENSION)
       } finally {
         this.initialized = true
         console.log('[SemanticFinder] Init complete, dimension:', this.index.dimension)
@@ -112,6 +150,27 @@ export class SemanticFinder {
     return this._initPromise
   }
 
+  /**
+   * Use the embedder's dimension for the global index. An index opened from
+   * the file is reopened at that dimension instead of resized in place,
+   * which would detach its delta log; the file's vectors, of the old
+   * dimension, are dropped and rebuilt by proactive indexing.
+   * @param {number} dimension
+   */
+  _setDimension(dimension) {
+    if (this.globalIndex.dimension === dimension) return
+    if (this._fileBacked) {
+      console.log('[SemanticFinder] Index file has dimension', this.globalIndex.dimension, '- rebuilding at', dimension)
+      if (this._openIndexFile(dimension)) {
+        this.clear()
+        this._dirty = true
+        this._scheduleSave()
+        return
+      }
+    }
+    this.globalIndex.dimension = dimension
+  }
+
   /**
    * Generate embedding for text
    * @param {string} text - Text to embed
@@ -120,7 +179,9 @@ export class SemanticFinder {
   async embed(text) {
     if (!this.initialized) await this.init()
 
-    // transformers.js path (preferred)
+    if (this._encoder) return this._encoder.embed(text)
+
+    // transformers.js path
     if (this._extractor) {
       try {
         const out = await this._extractor(text, { pooling: 'mean', normalize: true })
@@ -137,6 +198,44 @@ export class SemanticFinder {
     return this._simpleEmbed(text)
   }
 
+  /**
+   * Generate embeddings for many texts (bulk indexing, batched queries)
+   * @param {string[]} texts
+   * @returns {Promise<Float32Array[]>}
+   */
+  async embedBatch(texts) {
+    if (!this.initialized) await this.init()
+    if (this._encoder) return this._embedNative(texts)
+    if (this._extractor) return Promise.all(texts.map((text) => this.embed(text)))
+    return hashEmbedBatch(texts.map((text) => String(text ?? '').toLowerCase()), this.index.dimension || DEFAULT_DIMENSION)
+  }
+
+  /**
+   * Name of the embedder producing this finder's vectors
+   * @returns {string}
+   */
+  embedderId() {
+    if (this._encoder) return this._encoder.name
+    return this._extractor ? this.model : HASH_EMBEDDER
+  }
+
+  /**
+   * Native encoder over many texts, a slice at a time with a yield in
+   * between so a large channel does not hold the event loop for its whole
+   * duration
+   * @param {string[]} texts
+   * @returns {Promise<Float32Array[]>}
+   */
+  async _embedNative(texts) {
+    const out = []
+    for (let i = 0; i < texts.length; i += NATIVE_EMBED_BATCH) {
+      if (i > 0) await new Promise((resolve) => setTimeout(resolve, 0))
+      const batch = texts.slice(i, i + NATIVE_EMBED_BATCH).map((text) => String(text ?? ''))
+      for (const vec of this._encoder.embedBatch(batch)) out.push(vec)
+    }
+    return out
+  }
+
   /**
    * Ensure a channel-specific index exists.
    * @param {string} channelKey
@@ -146,31 +245,15 @@ export class SemanticFinder {
     if (!channelKey) return this.index
     const existing = this._channelIndexes.get(channelKey)
     if (existing) return existing
-    const idx = new VectorIndex()
+    // Channel indexes are rebuilt from the replicated view, never persisted,
+    // so they keep int8 codes only (~4x smaller; ignored by the JS index)
+    const idx = new VectorIndex({ quantization: 'int8', rerank: 0, textKeys: CHANNEL_TEXT_KEYS })
     // Keep dimension in sync with the embedder
     idx.dimension = this.index.dimension || DEFAULT_DIMENSION
     this._channelIndexes.set(channelKey, idx)
     return idx
   }
 
-  /**
-   * Decode a base64-encoded Float32Array vector into a Float32Array.
-   * @param {string} base64
-   * @returns {Float32Array|null}
-   */
-  _decodeVector(base64) {
-    if (!base64 || typeof base64 !== 'string') return null
-    try {
-      const buf = b4a.from(base64, 'base64')
-      if (!buf || buf.byteLength % 4 !== 0) return null
-      const f32 = new Float32Array(buf.buffer, buf.byteOffset, buf.byteLength / 4)
-      // Copy into a standalone buffer to avoid retaining the larger underlying ArrayBuffer
-      return new Float32Array(f32)
-    } catch {
-      return null
-    }
-  }
-
   /**
    * Rebuild or update the local ANN index for a channel from the replicated view (`vectors/` prefix).
    * This is the persistence layer: vectors are replicated via Autobase ops, and re-indexed locally.
@@ -181,52 +264,15 @@ export class SemanticFinder {
   async ensureIndexedFromChannelView(channelKey, channel) {
     if (!channelKey || !channel?.view) return
 
-    // Best-effort catch-up so we see newly replicated vector records.
-    try {
-      await Promise.race([
-        channel.base?.update?.(),
-        new Promise((resolve) => setTimeout(resolve, 1000))
-      ])
-    } catch {}
-
-    const viewLen = channel.view?.core?.length || 0
-    const lastLen = this._channelVectorViewLengths.get(channelKey) || 0
-    if (viewLen && viewLen === lastLen) return
-
-    const idx = this._getChannelIndex(channelKey)
-    idx.dimension = this.index.dimension || DEFAULT_DIMENSION
-
-    // For now we do a full scan (bounded by number of videos). If needed, we can later
-    // implement incremental scanning by keeping a last key cursor.
-    idx.clear()
-
-    const start = 'vectors/'
-    const end = 'vectors/\xff'
-
-    for await (const { value } of channel.view.createReadStream({ gt: start, lt: end })) {
-      if (!value?.videoId) continue
-      const vec = value.vector ? this._decodeVector(value.vector) : null
-      if (!vec) continue
-      if (vec.length !== idx.dimension) continue
-
-      let meta = {}
-      if (typeof value.metadata === 'string') {
-        try { meta = JSON.parse(value.metadata) } catch {}
-      }
-
-      idx.add(value.videoId, vec, {
-        channelKey,
-        text: value.text || '',
-        ...meta
-      })
-    }
-
-    this._channelVectorViewLengths.set(channelKey, viewLen)
+    await this._ingestChannelView(channelKey, channel, this._getChannelIndex(channelKey), this._channelVectorCursors, {
+      // Channel indexes hold nothing else, so a rescan can start clean
+      clearOnRescan: true
+    })
   }
 
   /**
    * Import replicated vectors into the global index for cross-channel search.
-   * Best-effort: skips when the view length hasn't changed.
+   * Only records added since the persisted cursor are read.
    *
    * @param {string} channelKey
    * @param {import('../channel/multi-writer-channel.js').MultiWriterChannel} channel
@@ -234,6 +280,45 @@ export class SemanticFinder {
   async ensureGlobalIndexedFromChannelView(channelKey, channel) {
     if (!channelKey || !channel?.view) return
 
+    const before = this._globalVectorCursors.get(channelKey)
+    const indexed = await this._ingestChannelView(channelKey, channel, this.globalIndex, this._globalVectorCursors, {
+      skip: (videoId) => this._indexedVideoIds.has(videoId),
+      onAdd: (videoId) => this._indexedVideoIds.add(videoId),
+      onRemove: (videoId) => this._indexedVideoIds.delete(videoId)
+    })
+
+    if (indexed > 0 || this._globalVectorCursors.get(channelKey) !== before) {
+      this._cursorsDirty = true
+      this._dirty = true
+      this._scheduleSave()
+    }
+  }
+
+  /**
+   * Bring `idx` up to date with a channel view's `vectors/` records.
+   *
+   * The cursor holds the view length the index is current with and, while a
+   * full scan is in progress, the last key it reached. When the view has
+   * only grown, Hyperbee's diff stream yields just the records changed since
+   * that length. Otherwise (first sight, a truncated view after an Autobase
+   * reorder, no diff support) the range is scanned, resuming after the last
+   * key; a resumed scan keeps its starting length so the next diff also
+   * covers keys before the resume point. Records go to the index in batches
+   * of base64 strings, decoded natively.
+   *
+   * @param {string} channelKey
+   * @param {any} channel
+   * @param {any} idx - Index with addEncoded/remove/has
+   * @param {Map<string, {length: number, key: string|null}>} cursors
+   * @param {Object} [opts]
+   * @param {(videoId: string) => boolean} [opts.skip] - Ignore records for these videos
+   * @param {(videoId: string) => void} [opts.onAdd]
+   * @param {(videoId: string) => void} [opts.onRemove]
+   * @param {boolean} [opts.clearOnRescan] - Clear `idx` before a scan from the start
+   * @returns {Promise<number>} Records added
+   */
+  async _ingestChannelView(channelKey, channel, idx, cursors, opts = {}) {
+    // Best-effort catch-up so we see newly replicated vector records.
     try {
       await Promise.race([
         channel.base?.update?.(),
@@ -241,75 +326,88 @@ export class SemanticFinder {
       ])
     } catch {}
 
-    const viewLen = channel.view?.core?.length || 0
-    const lastLen = this._globalVectorViewLengths.get(channelKey) || 0
-    if (viewLen && viewLen === lastLen) return
+    const view = channel.view
+    const viewLen = view.core?.length || 0
+    const cursor = cursors.get(channelKey) || { length: 0, key: null }
+    if (viewLen && viewLen === cursor.length && cursor.key === null) return 0
 
-    const idx = this.globalIndex
     idx.dimension = this.index.dimension || DEFAULT_DIMENSION
 
     const start = 'vectors/'
     const end = 'vectors/\xff'
-    let indexed = 0
-
-    for await (const { value } of channel.view.createReadStream({ gt: start, lt: end })) {
-      if (!value?.videoId) continue
-      if (this._indexedVideoIds.has(value.videoId)) continue
+    const ids = []
+    const encoded = []
+    const metadata = []
+    let added = 0
 
-      const vec = value.vector ? this._decodeVector(value.vector) : null
-      if (!vec) continue
-      if (vec.length !== idx.dimension) continue
+    const push = (value) => {
+      if (!value?.videoId || typeof value.vector !== 'string') return
+      if (opts.skip?.(value.videoId)) return
 
       let meta = {}
       if (typeof value.metadata === 'string') {
         try { meta = JSON.parse(value.metadata) } catch {}
       }
 
-      idx.add(value.videoId, vec, {
-        channelKey,
-        text: value.text || '',
-        ...meta
-      })
-      this._indexedVideoIds.add(value.videoId)
-      indexed++
+      ids.push(value.videoId)
+      encoded.push(value.vector)
+      metadata.push({ channelKey, text: value.text || '', ...meta })
     }
 
-    if (indexed > 0) {
-      this._dirty = true
-      this._scheduleSave()
+    const flush = () => {
+      if (ids.length === 0) return
+      added += idx.addEncoded(ids, encoded, metadata)
+      if (opts.onAdd) {
+        for (const id of ids) if (idx.has(id)) opts.onAdd(id)
+      }
+      ids.length = 0
+      encoded.length = 0
+      metadata.length = 0
     }
-    this._globalVectorViewLengths.set(channelKey, viewLen)
-  }
 
-  /**
-   * Simple embedding using text hashing (fallback)
-   * @param {string} text
-   * @returns {Float32Array}
-   */
-  _simpleEmbed(text) {
-    const normalized = text.toLowerCase().trim()
-    const dimension = this.index.dimension || DEFAULT_DIMENSION
-    const vector = new Float32Array(dimension)
-
-    // Simple hash-based approach (not semantic, but works for basic search)
-    for (let i = 0; i < dimension; i++) {
-      let hash = 0
-      for (let j = 0; j < normalized.length; j++) {
-        hash = ((hash << 5) - hash) + normalized.charCodeAt(j) + i
-        hash = hash & hash // Convert to 32bit integer
+    const incremental = cursor.length > 0 && cursor.key === null && viewLen > cursor.length &&
+      typeof view.createDiffStream === 'function'
+
+    if (incremental) {
+      for await (const { left, right } of view.createDiffStream(cursor.length, { gt: start, lt: end })) {
+        if (left) {
+          push(left.value)
+        } else if (right?.value?.videoId) {
+          idx.remove(right.value.videoId)
+          opts.onRemove?.(right.value.videoId)
+        }
+        if (ids.length >= INGEST_BATCH) flush()
       }
-      vector[i] = (hash % 1000) / 1000 - 0.5 // Normalize to [-0.5, 0.5]
+      flush()
+      cursors.set(channelKey, { length: viewLen, key: null })
+      return added
     }
 
-    // Normalize vector
-    const norm = Math.sqrt(vector.reduce((sum, v) => sum + v * v, 0))
-    if (norm > 0) {
-      for (let i = 0; i < dimension; i++) {
-        vector[i] /= norm
+    const resume = cursor.key !== null && viewLen >= cursor.length
+    const scanLength = resume ? cursor.length : viewLen
+    if (!resume && opts.clearOnRescan) idx.clear()
+
+    for await (const { key, value } of view.createReadStream({ gt: resume ? cursor.key : start, lt: end })) {
+      push(value)
+      if (ids.length >= INGEST_BATCH) {
+        flush()
+        cursors.set(channelKey, { length: scanLength, key: typeof key === 'string' ? key : b4a.toString(key) })
       }
     }
+    flush()
+    cursors.set(channelKey, { length: scanLength, key: null })
+    return added
+  }
 
-    return vector
+  /**
+   * Feature-hashing embedding (fallback when no model loads); linear in the
+   * text length, native when bare-embed is available. Lowercased here as
+   * well so non-ASCII capitals fold like ASCII ones do in the embedder.
+   * @param {string} text
+   * @returns {Float32Array}
+   */
+  _simpleEmbed(text) {
+    return hashEmbed(text.toLowerCase(), this.index.dimension || DEFAULT_DIMENSION)
   }
 
   /**
@@ -329,6 +427,7 @@ export class SemanticFinder {
       videoId,
       title,
       description,
+      text,
       ...metadata
     })
   }
@@ -345,13 +444,59 @@ export class SemanticFinder {
    * Search for videos
    * @param {string} query - Search query
    * @param {number} topK - Number of results
+   * @param {Object} [options]
+   * @param {string|null} [options.channelKey] - Search this channel's index
+   * @param {Iterable<string>} [options.exclude] - Video ids never returned
+   * @param {boolean} [options.hybrid] - Blend in keyword (BM25) matches of
+   *   the query (default true; false ranks by embedding similarity only)
+   * @param {number} [options.textWeight] - Keyword share of hybrid scores
    * @returns {Promise<Array<{id: string, score: number, metadata: any}>>}
    */
   async search(query, topK = 10, options = {}) {
     const queryEmbedding = await this.embed(query)
     const channelKey = options?.channelKey || null
     const idx = channelKey ? this._getChannelIndex(channelKey) : this.index
-    return idx.search(queryEmbedding, topK)
+    return idx.search(queryEmbedding, topK, searchOptions(query, options))
+  }
+
+  /**
+   * Answer several searches together. Queries against the same index are
+   * handed to it as one searchBatch() call (a single blocked pass on the
+   * native indexes) instead of one scan each. Batched searches rank by
+   * embedding similarity only; `exclude` is applied inside the index, so
+   * each request still gets topK results.
+   * @param {Array<{query: string, topK?: number, channelKey?: string|null, exclude?: Iterable<string>}>} requests
+   * @returns {Promise<Array<Array<{id: string, score: number, metadata: any}>>>}
+   */
+  async searchBatch(requests) {
+    const embeddings = await this.embedBatch(requests.map((r) => r.query))
+
+    // Requests sharing an index and an exclusion set (the same object, as
+    // the recommender passes) go out as one batch
+    /** @type {Map<string|null, Map<Iterable<string>|null, number[]>>} channelKey -> exclude -> request positions */
+    const groups = new Map()
+    requests.forEach((r, i) => {
+      const channelKey = r.channelKey || null
+      const exclude = r.exclude || null
+      let byExclude = groups.get(channelKey)
+      if (!byExclude) groups.set(channelKey, byExclude = new Map())
+      const group = byExclude.get(exclude)
+      if (group) group.push(i)
+      else byExclude.set(exclude, [i])
+    })
+
+    const results = new Array(requests.length)
+    for (const [channelKey, byExclude] of groups) {
+      const idx = channelKey ? this._getChannelIndex(channelKey) : this.index
+      for (const [exclude, positions] of byExclude) {
+        const topK = Math.max(...positions.map((i) => requests[i].topK ?? 10))
+        const hits = idx.searchBatch(positions.map((i) => embeddings[i]), topK, exclude ? { exclude } : {})
+        positions.forEach((i, j) => {
+          results[i] = hits[j].slice(0, requests[i].topK ?? 10)
+        })
+      }
+    }
+    return results
   }
 
   /**
@@ -368,8 +513,9 @@ export class SemanticFinder {
   clear() {
     this.globalIndex.clear()
     this._indexedVideoIds.clear()
-    this._channelVectorViewLengths.clear()
-    this._globalVectorViewLengths.clear()
+    this._channelVectorCursors.clear()
+    this._globalVectorCursors.clear()
+    this._cursorsDirty = true
   }
 
   // ============================================
@@ -399,18 +545,7 @@ export class SemanticFinder {
 
     try {
       const embedding = await this.embed(text)
-      this.globalIndex.add(video.id, embedding, {
-        videoId: video.id,
-        channelKey,
-        title: video.title,
-        description: video.description,
-        duration: video.duration,
-        thumbnail: video.thumbnail,
-        category: video.category,
-        createdAt: video.createdAt || video.uploadedAt,
-        size: video.size,
-        publicBeeKey: video.publicBeeKey || null
-      })
+      this.globalIndex.add(video.id, embedding, this._videoMetadata(video, channelKey))
       this._indexedVideoIds.add(video.id)
       this._dirty = true
       this._scheduleSave()
@@ -420,19 +555,77 @@ export class SemanticFinder {
     }
   }
 
+  /**
+   * Index many videos from metadata with one batched embedding call
+   * @param {Object[]} videos - Video metadata objects
+   * @param {string} channelKey - Channel key
+   * @returns {Promise<number>} Videos newly indexed
+   */
+  async indexFromMetadataBatch(videos, channelKey) {
+    const pending = []
+    const texts = []
+    for (const video of videos || []) {
+      if (!video?.id || this._indexedVideoIds.has(video.id)) continue
+      const text = `${video.title || ''} ${video.description || ''}`.trim()
+      if (!text) continue
+      pending.push(video)
+      texts.push(text)
+    }
+    if (pending.length === 0) return 0
+
+    try {
+      const embeddings = await this.embedBatch(texts)
+      pending.forEach((video, i) => {
+        // Another caller may have indexed it while we were embedding
+        if (this._indexedVideoIds.has(video.id)) return
+        this.globalIndex.add(video.id, embeddings[i], this._videoMetadata(video, channelKey))
+        this._indexedVideoIds.add(video.id)
+      })
+      this._dirty = true
+      this._scheduleSave()
+      return pending.length
+    } catch (err) {
+      console.error('[SemanticFinder] Failed to index videos:', err?.message)
+      return 0
+    }
+  }
+
+  _videoMetadata(video, channelKey) {
+    return {
+      videoId: video.id,
+      channelKey,
+      title: video.title,
+      description: video.description,
+      duration: video.duration,
+      thumbnail: video.thumbnail,
+      category: video.category,
+      createdAt: video.createdAt || video.uploadedAt,
+      size: video.size,
+      publicBeeKey: video.publicBeeKey || null
+    }
+  }
+
   /**
    * Search the global index (fast O(1) search)
    * @param {string} query
    * @param {number} topK
+   * @param {Object} [options]
+   * @param {string|null} [options.channelKey] - Restrict results to one channel
+   * @param {Iterable<string>} [options.exclude] - Video ids never returned
+   * @param {boolean} [options.hybrid] - As for search()
+   * @param {number} [options.textWeight] - As for search()
    * @returns {Promise<Array<{id: string, score: number, metadata: any}>>}
    */
-  async globalSearch(query, topK = 50) {
+  async globalSearch(query, topK = 50, options = {}) {
     console.log('[SemanticFinder] globalSearch:', query, 'topK:', topK, 'initialized:', this.initialized)
     if (!this.initialized) await this.init()
     console.log('[SemanticFinder] globalSearch: init complete, index size:', this.globalIndex.size())
     const embedding = await this.embed(query)
     console.log('[SemanticFinder] globalSearch: embedding computed, dim:', embedding?.length)
-    const results = this.globalIndex.search(embedding, topK)
+    const results = this.globalIndex.search(embedding, topK, {
+      channelKey: options?.channelKey ?? null,
+      ...searchOptions(query, options)
+    })
     console.log('[SemanticFinder] globalSearch: returning', results.length, 'results')
     return results
   }
@@ -441,7 +634,54 @@ export class SemanticFinder {
    * Load persisted index from storage
    */
   async loadIndex() {
-    console.log('[SemanticFinder] loadIndex: metaDb:', !!this.metaDb)
+    console.log('[SemanticFinder] loadIndex: metaDb:', !!this.metaDb, 'indexPath:', this.indexPath)
+    // The file is opened at the embedder's dimension, so resolve it first
+    if (!this.initialized) await this.init()
+    if (!(this.indexPath && this._openIndexFile() && this.globalIndex.size() > 0)) {
+      await this._loadStoredIndex()
+    }
+    await this._checkEmbedder()
+    // Cursors describe what the saved index holds; an empty index rescans
+    if (this.globalIndex.size() > 0) await this._loadCursors()
+  }
+
+  /**
+   * Drop a persisted index built by a different embedder: its vectors live
+   * in another space from the queries this finder produces. Indexes saved
+   * before the embedder was recorded count as the old hash fallback unless a
+   * model is loaded now.
+   */
+  async _checkEmbedder() {
+    if (!this.metaDb) return
+    if (!this.initialized) await this.init()
+
+    const current = this.embedderId()
+    let stored = null
+    try {
+      stored = (await this.metaDb.get(EMBEDDER_STORAGE_KEY))?.value ?? null
+    } catch {}
+
+    const previous = stored ?? (this._extractor ? current : null)
+    if (previous !== current && this.globalIndex.size() > 0) {
+      console.log('[SemanticFinder] Index was built by', previous || 'the legacy hash embedder', '- rebuilding with', current)
+      this.clear()
+      this._dirty = true
+      this._scheduleSave()
+    }
+
+    if (stored !== current) {
+      try {
+        await this.metaDb.put(EMBEDDER_STORAGE_KEY, current)
+      } catch (err) {
+        console.error('[SemanticFinder] Failed to save embedder id:', err?.message)
+      }
+    }
+  }
+
+  /**
+   * Load the JSON + base64 index kept in metaDb (JS index, or migration)
+   */
+  async _loadStoredIndex() {
     if (!this.metaDb) return
 
     try {
@@ -453,10 +693,17 @@ export class SemanticFinder {
           : Buffer.from(JSON.stringify(entry.value))
         this.globalIndex.deserialize(buf)
         // Rebuild _indexedVideoIds from loaded index
-        for (const [id] of this.globalIndex.vectors) {
+        for (const id of this.globalIndex.ids()) {
           this._indexedVideoIds.add(id)
         }
         console.log('[SemanticFinder] Loaded', this.globalIndex.size(), 'vectors from storage')
+        if (this.indexPath) {
+          // Migrated into the binary file; the metaDb copy is dropped at the
+          // next compaction
+          this._legacyStored = true
+          this._dirty = true
+          this._scheduleSave()
+        }
       }
     } catch (err) {
       console.error('[SemanticFinder] Failed to load index:', err?.message)
@@ -464,10 +711,120 @@ export class SemanticFinder {
   }
 
   /**
-   * Save index to storage
+   * Load the persisted per-channel view cursors of the global index
+   */
+  async _loadCursors() {
+    if (!this.metaDb) return
+
+    try {
+      const entry = await this.metaDb.get(CURSOR_STORAGE_KEY)
+      for (const [channelKey, cursor] of Object.entries(entry?.value || {})) {
+        if (!Number.isInteger(cursor?.length)) continue
+        this._globalVectorCursors.set(channelKey, {
+          length: cursor.length,
+          key: typeof cursor.key === 'string' ? cursor.key : null
+        })
+      }
+    } catch (err) {
+      console.error('[SemanticFinder] Failed to load view cursors:', err?.message)
+    }
+  }
+
+  /**
+   * Persist the global index's view cursors. Called after the index itself
+   * has been flushed, so a cursor never runs ahead of the data it covers.
+   */
+  async _saveCursors() {
+    if (!this.metaDb || !this._cursorsDirty) return
+
+    try {
+      this._cursorsDirty = false
+      await this.metaDb.put(CURSOR_STORAGE_KEY, Object.fromEntries(this._globalVectorCursors))
+    } catch (err) {
+      this._cursorsDirty = true
+      console.error('[SemanticFinder] Failed to save view cursors:', err?.message)
+    }
+  }
+
+  /**
+   * Map the binary index file and replay its delta log. Only the header is
+   * checked here so startup does not read the whole file; the checksums are
+   * verified a little later and a corrupt index is dropped and rebuilt by
+   * proactive indexing. A file of another dimension is ignored and replaced
+   * at the next compaction.
+   * @param {number} [dimension] - Defaults to the current index's
+   * @returns {boolean} true if the index is now backed by the file
+   */
+  _openIndexFile(dimension = this.globalIndex.dimension) {
+    let index
+    try {
+      index = ApproximateVectorIndex.load(this.indexPath, {
+        dimension,
+        textKeys: GLOBAL_TEXT_KEYS
+      })
+    } catch (err) {
+      console.error('[SemanticFinder] Could not open index file, using metaDb:', err?.message)
+      this.indexPath = null
+      this._fileBacked = false
+      return false
+    }
+
+    this.globalIndex.destroy()
+    this.globalIndex = index
+    this.index = index
+    this._fileBacked = true
+    for (const id of index.ids()) {
+      this._indexedVideoIds.add(id)
+    }
+    console.log('[SemanticFinder] Mapped', index.size(), 'vectors from', this.indexPath, 'log:', index.logStats().records, 'records')
+
+    this._verifyTimeout = setTimeout(() => {
+      this._verifyTimeout = null
+      if (this.globalIndex !== index) return
+      try {
+        index.verify()
+      } catch (err) {
+        console.error('[SemanticFinder] Index file is corrupt, rebuilding:', err?.message)
+        this.clear()
+        this._dirty = true
+        this._scheduleSave()
+      }
+    }, INDEX_VERIFY_DELAY_MS)
+    this._verifyTimeout.unref?.()
+
+    return true
+  }
+
+  /**
+   * Save index to storage. With an index file every change is already in
+   * the delta log, so this only syncs it, compacting once it has grown.
    */
   async saveIndex() {
-    if (!this.metaDb || !this._dirty) return
+    if (!this._dirty) return
+
+    if (this.indexPath) {
+      try {
+        const index = this.globalIndex
+        const matrixBytes = index.size() * index.dimension * 4
+        if (this._legacyStored || index.logStats().bytes > Math.max(LOG_COMPACT_MIN_BYTES, matrixBytes / 2)) {
+          index.compact()
+          console.log('[SemanticFinder] Compacted', index.size(), 'vectors into', this.indexPath)
+        } else {
+          index.sync()
+        }
+        this._dirty = false
+        if (this._legacyStored && this.metaDb) {
+          await this.metaDb.del(INDEX_STORAGE_KEY)
+          this._legacyStored = false
+        }
+        await this._saveCursors()
+      } catch (err) {
+        console.error('[SemanticFinder] Failed to save index:', err?.message)
+      }
+      return
+    }
+
+    if (!this.metaDb) return
 
     try {
       const buf = this.globalIndex.serialize()
@@ -475,6 +832,7 @@ export class SemanticFinder {
       await this.metaDb.put(INDEX_STORAGE_KEY, buf.toString('base64'))
       this._dirty = false
       console.log('[SemanticFinder] Saved', this.globalIndex.size(), 'vectors to storage')
+      await this._saveCursors()
     } catch (err) {
       console.error('[SemanticFinder] Failed to save index:', err?.message)
     }
@@ -499,3 +857,20 @@ export class SemanticFinder {
     return this.globalIndex.size()
   }
 }
+
+/**
+ * Index search options for a text query: exclusions plus, unless
+ * `hybrid: false`, the query itself for keyword scoring
+ * @param {string} query
+ * @param {{exclude?: Iterable<string>, hybrid?: boolean, textWeight?: number}} [options]
+ * @returns {{exclude?: Iterable<string>, text?: string, textWeight?: number}}
+ */
+function searchOptions(query, options) {
+  const opts = {}
+  if (options?.exclude) opts.exclude = options.exclude
+  if (options?.hybrid !== false) {
+    opts.text = query
+    if (options?.textWeight !== undefined) opts.textWeight = options.textWeight
+  }
+  return opts
+}
@@ -0,0 +1,32 @@
+/**
+ * Native sentence encoder
+ *
+ * Runs a MiniLM-class transformer on the CPU from an int8 model file
+ * (converted with bare-embed's convert.js), with no GPU, network or WASM
+ * runtime. Only available under Bare with the bare-embed addon.
+ */
+
+// Native encoder (Bare only); absent under Node and in builds without the addon
+let SentenceEncoder = null
+try {
+  const mod = await import('bare-embed')
+  SentenceEncoder = (mod.default || mod).SentenceEncoder || null
+} catch (e) {
+  console.log('[SentenceEncoder] bare-embed not available, native encoder disabled')
+}
+
+/**
+ * Open a model file, or null when the addon or the file is missing
+ * @param {string|null} path
+ * @returns {Object|null} bare-embed SentenceEncoder
+ */
+export function openSentenceEncoder(path) {
+  if (!SentenceEncoder || !path) return null
+
+  try {
+    return SentenceEncoder.open(path)
+  } catch (err) {
+    console.log('[SentenceEncoder] No usable model at', path + ':', err?.message)
+    return null
+  }
+}
@@ -2,20 +2,44 @@
  * Local Vector Index Manager
  *
  * Manages a local approximate nearest neighbor (ANN) index for video embeddings.
- * Uses a simple in-memory index with cosine similarity for mobile compatibility.
+ * Uses the bare-vector-index native addon (SIMD scan over a contiguous matrix)
+ * when it is available, and a simple in-memory JS index otherwise.
  */
 
 import b4a from 'b4a'
 
+// Native indexes (Bare only); absent under Node and in builds without the addon
+let NativeVectorIndex = null
+let NativeHnswIndex = null
+try {
+  const mod = await import('bare-vector-index')
+  NativeVectorIndex = (mod.default || mod).VectorIndex || null
+  NativeHnswIndex = (mod.default || mod).HnswIndex || null
+} catch (e) {
+  console.log('[VectorIndex] bare-vector-index not available, using JS index')
+}
+
+// Share of the (max-normalised) BM25 score in hybrid results, and the BM25
+// constants; both match the native index
+const DEFAULT_TEXT_WEIGHT = 0.3
+const BM25_K1 = 1.2
+const BM25_B = 0.75
+
 /**
- * Simple vector index using cosine similarity
- * For production, consider using hnswlib-node or FAISS bindings
+ * Simple vector index using cosine similarity (fallback when the native
+ * addon is not available)
  */
-export class VectorIndex {
-  constructor() {
-    /** @type {Map<string, {vector: Float32Array, metadata: any}>} */
+export class JsVectorIndex {
+  /**
+   * @param {Object} [opts]
+   * @param {string[]} [opts.textKeys] - Metadata fields scored by BM25 for
+   *   hybrid search (search() `text` option)
+   */
+  constructor(opts = {}) {
+    /** @type {Map<string, {vector: Float32Array, metadata: any, terms?: Map<string, number>, length?: number}>} */
     this.vectors = new Map()
     this.dimension = 384 // Default dimension for sentence transformers
+    this.textKeys = opts.textKeys || []
   }
 
   /**
@@ -32,6 +56,29 @@ export class VectorIndex {
     this.vectors.set(id, { vector: vec, metadata })
   }
 
+  /**
+   * Add a batch of base64-encoded vectors (packed float32, as stored in
+   * channel views). Entries of the wrong size are skipped.
+   * @param {string[]} ids
+   * @param {string[]} encoded
+   * @param {any[]} [metadata]
+   * @returns {number} Vectors added or updated
+   */
+  addEncoded(ids, encoded, metadata = []) {
+    let added = 0
+    for (let i = 0; i < ids.length; i++) {
+      if (typeof encoded[i] !== 'string') continue
+      const buf = b4a.from(encoded[i], 'base64')
+      if (buf.byteLength !== this.dimension * 4) continue
+      // Copy out: the decoded buffer may be a view into a shared pool
+      const vec = new Float32Array(this.dimension)
+      new Uint8Array(vec.buffer).set(buf)
+      this.vectors.set(ids[i], { vector: vec, metadata: metadata[i] ?? {} })
+      added++
+    }
+    return added
+  }
+
   /**
    * Remove a vector from the index
    * @param {string} id - Video ID or document ID
@@ -44,18 +91,33 @@ export class VectorIndex {
    * Search for similar vectors
    * @param {Float32Array|number[]} queryVector - Query embedding
    * @param {number} topK - Number of results to return
+   * @param {Object} [opts]
+   * @param {string} [opts.channelKey] - Only return vectors from this channel
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned
+   * @param {string} [opts.text] - Keyword query for hybrid ranking (needs
+   *   `textKeys`): scores become (1 - textWeight) * cosine +
+   *   textWeight * BM25 / best BM25
+   * @param {number} [opts.textWeight] - Share of the text score (default 0.3)
    * @returns {Array<{id: string, score: number, metadata: any}>}
    */
-  search(queryVector, topK = 10) {
+  search(queryVector, topK = 10, opts = {}) {
     const query = queryVector instanceof Float32Array ? queryVector : new Float32Array(queryVector)
     if (query.length !== this.dimension) {
       throw new Error(`Query vector dimension mismatch: expected ${this.dimension}, got ${query.length}`)
     }
 
+    const channelKey = opts?.channelKey ?? null
+    const exclude = opts?.exclude ? new Set(opts.exclude) : null
+    const text = this.textKeys.length > 0 && typeof opts?.text === 'string' && opts.text !== '' ? this._bm25(opts.text) : null
+    const weight = text === null ? 0 : (opts.textWeight ?? DEFAULT_TEXT_WEIGHT)
     const results = []
 
-    for (const [id, { vector, metadata }] of this.vectors.entries()) {
-      const score = cosineSimilarity(query, vector)
+    for (const [id, entry] of this.vectors.entries()) {
+      const { vector, metadata } = entry
+      if (channelKey !== null && metadata?.channelKey !== channelKey) continue
+      if (exclude !== null && exclude.has(id)) continue
+      let score = cosineSimilarity(query, vector)
+      if (text !== null) score = (1 - weight) * score + weight * (text.scores.get(entry) || 0) / text.best
       results.push({ id, score, metadata })
     }
 
@@ -64,6 +126,81 @@ export class VectorIndex {
     return results.slice(0, topK)
   }
 
+  /**
+   * Search several queries (one scan each; the native indexes do this as a
+   * single blocked pass)
+   * @param {Array<Float32Array|number[]>} queryVectors
+   * @param {number} topK - Results per query
+   * @param {Object} [opts] - As for search()
+   * @returns {Array<Array<{id: string, score: number, metadata: any}>>}
+   */
+  searchBatch(queryVectors, topK = 10, opts = {}) {
+    return queryVectors.map((query) => this.search(query, topK, opts))
+  }
+
+  /**
+   * BM25 score of every entry matching a term of `query` (exact: the JS
+   * index scans everything anyway)
+   * @param {string} query
+   * @returns {{scores: Map<object, number>, best: number}|null}
+   */
+  _bm25(query) {
+    const terms = new Set(tokenize(query))
+    const scores = new Map()
+    let documents = 0
+    let total = 0
+
+    for (const entry of this.vectors.values()) {
+      if (entry.terms === undefined) {
+        const tokens = tokenize(textOf(entry.metadata, this.textKeys))
+        entry.terms = new Map()
+        for (const token of tokens) entry.terms.set(token, (entry.terms.get(token) || 0) + 1)
+        entry.length = tokens.length
+      }
+      if (entry.length === 0) continue
+      documents++
+      total += entry.length
+    }
+    if (documents === 0) return null
+
+    const avg = total / documents
+    for (const term of terms) {
+      const matches = []
+      for (const entry of this.vectors.values()) {
+        if (entry.terms.has(term)) matches.push(entry)
+      }
+      if (matches.length === 0) continue
+
+      const idf = Math.log(1 + (documents - matches.length + 0.5) / (matches.length + 0.5))
+      for (const entry of matches) {
+        const tf = entry.terms.get(term)
+        const score = idf * tf * (BM25_K1 + 1) / (tf + BM25_K1 * (1 - BM25_B + BM25_B * entry.length / avg))
+        scores.set(entry, (scores.get(entry) || 0) + score)
+      }
+    }
+
+    let best = 0
+    for (const score of scores.values()) best = Math.max(best, score)
+    return best > 0 ? { scores, best } : null
+  }
+
+  /**
+   * Check whether an id is indexed
+   * @param {string} id
+   * @returns {boolean}
+   */
+  has(id) {
+    return this.vectors.has(id)
+  }
+
+  /**
+   * Indexed ids
+   * @returns {IterableIterator<string>}
+   */
+  ids() {
+    return this.vectors.keys()
+  }
+
   /**
    * Get vector count
    * @returns {number}
@@ -112,6 +249,52 @@ export class VectorIndex {
   }
 }
 
+/**
+ * Vector index used by search: native when available, JS otherwise.
+ * Both expose add/remove/search/searchBatch/has/ids/size/clear/serialize/deserialize,
+ * take { textKeys } at construction and accept { exclude, text, textWeight }
+ * in search().
+ * @type {typeof JsVectorIndex}
+ */
+export const VectorIndex = NativeVectorIndex || JsVectorIndex
+
+/**
+ * Index for large cross-channel collections: native HNSW graph when
+ * available (approximate, channel-filtered search), exact JS scan otherwise.
+ * search() takes optional { channelKey, exclude, text, textWeight } on both.
+ * @type {typeof JsVectorIndex}
+ */
+export const ApproximateVectorIndex = NativeHnswIndex || JsVectorIndex
+
+/** @type {'native'|'js'} */
+export const vectorIndexBackend = NativeVectorIndex ? 'native' : 'js'
+
+/**
+ * Text indexed for hybrid search: the string `keys` fields of metadata
+ * @param {any} metadata
+ * @param {string[]} keys
+ * @returns {string}
+ */
+function textOf(metadata, keys) {
+  const parts = []
+  for (const key of keys) {
+    const value = metadata?.[key]
+    if (typeof value === 'string' && value !== '') parts.push(value)
+  }
+  return parts.join(' ')
+}
+
+/**
+ * Split text into terms the way the native BM25 index does: runs of ASCII
+ * letters/digits and non-ASCII characters, ASCII lowercased
+ * @param {string} text
+ * @returns {string[]}
+ */
+function tokenize(text) {
+  const tokens = text.match(/[A-Za-z0-9\u0080-\uffff]+/g) || []
+  return tokens.map((token) => token.replace(/[A-Z]+/g, (s) => s.toLowerCase()))
+}
+
 /**
  * Compute cosine similarity between two vectors
  * @param {Float32Array} a
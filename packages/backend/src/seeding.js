@@ -5,21 +5,166 @@
  * Handles content seeding with storage quotas and prioritization.
  */
 
+import b4a from 'b4a';
+import { BlockAccessMap, CHUNK_BLOCKS } from './block-cache.js';
+
 /**
  * @typedef {import('./types.js').SeedingConfig} SeedingConfig
  * @typedef {import('./types.js').SeedInfo} SeedInfo
  */
 
+// Eviction order: lower rank goes first, then older addedAt
+const REASON_RANK = { watched: 1, subscribed: 2, pinned: 3 };
+
+// A block range unread for this long (and not freshly seeded) may be cleared
+const COLD_RANGE_MS = 15 * 60 * 1000;
+
+// Access map writes are batched
+const ACCESS_PERSIST_DELAY_MS = 30 * 1000;
+
+/**
+ * Min-heap of evictable seeds keyed by (reason rank, addedAt), with a
+ * position index so a seed can be removed by key, and a running byte total
+ * over everything tracked (pinned seeds are counted but never queued).
+ * Insert, remove and evict are O(log n); the total is O(1).
+ */
+class SeedQueue {
+  constructor() {
+    /** @type {Array<{key: string, rank: number, addedAt: number, bytes: number, pos: number}>} */
+    this.heap = [];
+    /** @type {Map<string, {key: string, rank: number, addedAt: number, bytes: number, pos: number}>} */
+    this.nodes = new Map();
+    /** @type {Map<string, number>} bytes of pinned seeds, which are not in the heap */
+    this.pinned = new Map();
+    this.totalBytes = 0;
+  }
+
+  /**
+   * @param {string} key
+   * @param {SeedInfo} seed
+   */
+  add(key, seed) {
+    this.remove(key);
+    const bytes = Math.max(0, (seed.bytes || 0) - (seed.clearedBytes || 0));
+    this.totalBytes += bytes;
+
+    if (seed.reason === 'pinned') {
+      this.pinned.set(key, bytes);
+      return;
+    }
+
+    const node = { key, rank: REASON_RANK[seed.reason] || 0, addedAt: seed.addedAt || 0, bytes, pos: this.heap.length };
+    this.heap.push(node);
+    this.nodes.set(key, node);
+    this._up(node.pos);
+  }
+
+  /**
+   * @param {string} key
+   * @returns {boolean}
+   */
+  remove(key) {
+    if (this.pinned.has(key)) {
+      this.totalBytes -= this.pinned.get(key);
+      this.pinned.delete(key);
+      return true;
+    }
+
+    const node = this.nodes.get(key);
+    if (!node) return false;
+    this.nodes.delete(key);
+    this.totalBytes -= node.bytes;
+
+    const last = this.heap.pop();
+    if (last !== node) {
+      last.pos = node.pos;
+      this.heap[node.pos] = last;
+      this._down(last.pos);
+      this._up(last.pos);
+    }
+    return true;
+  }
+
+  /**
+   * Next seed to evict, or null if only pinned seeds remain
+   * @returns {string|null}
+   */
+  peek() {
+    return this.heap.length > 0 ? this.heap[0].key : null;
+  }
+
+  clear() {
+    this.heap = [];
+    this.nodes.clear();
+    this.pinned.clear();
+    this.totalBytes = 0;
+  }
+
+  _less(a, b) {
+    return a.rank !== b.rank ? a.rank < b.rank : a.addedAt < b.addedAt;
+  }
+
+  _swap(i, j) {
+    const a = this.heap[i];
+    const b = this.heap[j];
+    this.heap[i] = b;
+    this.heap[j] = a;
+    a.pos = j;
+    b.pos = i;
+  }
+
+  _up(i) {
+    while (i > 0) {
+      const parent = (i - 1) >> 1;
+      if (!this._less(this.heap[i], this.heap[parent])) break;
+      this._swap(i, parent);
+      i = parent;
+    }
+  }
+
+  _down(i) {
+    const n = this.heap.length;
+    for (;;) {
+      const l = 2 * i + 1;
+      const r = l + 1;
+      let min = i;
+      if (l < n && this._less(this.heap[l], this.heap[min])) min = l;
+      if (r < n && this._less(this.heap[r], this.heap[min])) min = r;
+      if (min === i) break;
+      this._swap(i, min);
+      i = min;
+    }
+  }
+}
+
 export class SeedingManager {
   /**
    * @param {import('corestore')} store - Corestore instance
    * @param {import('hyperbee')} metaDb - Metadata database
+   * @param {Object} [opts]
+   * @param {import('./peer-stats.js').PeerNetworkStats|null} [opts.peerStats] - Reports local
+   *   block reads of the store's cores (feeds the access map)
    */
-  constructor(store, metaDb) {
+  constructor(store, metaDb, opts = {}) {
     this.store = store;
     this.metaDb = metaDb;
+    this.peerStats = opts.peerStats || null;
+    /** @type {Map<string, () => void>} blobs core key (hex) -> stops observing its reads */
+    this._readObservers = new Map();
     /** @type {Map<string, SeedInfo>} key: `${driveKey}:${videoPath}` -> seed info */
     this.activeSeeds = new Map();
+    /** Eviction order and byte total over activeSeeds, kept in step with it */
+    this.queue = new SeedQueue();
+    /** @type {Map<string, Set<string>>} blobs core key (hex) -> seed keys on it */
+    this.seedsByCore = new Map();
+    /** Last local read per block range of seeded cores */
+    this.access = new BlockAccessMap();
+    this.access.onColdMiss = (coreKeyHex, range, start) => this._onColdMiss(coreKeyHex, range, start);
+    this._accessTimer = null;
+    /** @type {Array<{label: string, seedKey: string, coreKeyHex: string, start: number, end: number, bytes: number, range: number|null}>} block ranges waiting to be cleared */
+    this.reclaimQueue = [];
+    this.reclaiming = null;
+    this.reclaimStats = { seeds: 0, ranges: 0, bytes: 0, elapsedMs: 0, failed: 0 };
     /** @type {Set<string>} driveKeys that are pinned (always seed) */
     this.pinnedChannels = new Set();
     /** @type {SeedingConfig} */
@@ -56,10 +201,180 @@ export class SeedingManager {
     const seedsData = await this.metaDb.get('active-seeds');
     if (seedsData?.value) {
       for (const [key, info] of Object.entries(seedsData.value)) {
-        this.activeSeeds.set(key, /** @type {SeedInfo} */ (info));
+        this._track(key, /** @type {SeedInfo} */ (info));
       }
       console.log('[SeedingManager] Loaded', this.activeSeeds.size, 'active seeds');
     }
+
+    // Load the block access map
+    const accessData = await this.metaDb.get('block-access');
+    if (typeof accessData?.value === 'string') {
+      try {
+        this.access = BlockAccessMap.decode(b4a.from(accessData.value, 'base64'));
+        this.access.onColdMiss = (coreKeyHex, range, start) => this._onColdMiss(coreKeyHex, range, start);
+      } catch (err) {
+        console.log('[SeedingManager] Ignoring unreadable block access map:', err?.message);
+      }
+    }
+  }
+
+  /**
+   * @param {string} key
+   * @param {SeedInfo} seed
+   */
+  _track(key, seed) {
+    this.activeSeeds.set(key, seed);
+    this.queue.add(key, seed);
+    if (seed.blobsCoreKey) {
+      let keys = this.seedsByCore.get(seed.blobsCoreKey);
+      if (!keys) {
+        keys = new Set();
+        this.seedsByCore.set(seed.blobsCoreKey, keys);
+        this._observeReads(seed.blobsCoreKey);
+      }
+      keys.add(key);
+    }
+  }
+
+  /**
+   * @param {string} key
+   * @returns {SeedInfo|undefined}
+   */
+  _untrack(key) {
+    const seed = this.activeSeeds.get(key);
+    if (!seed) return undefined;
+    this.activeSeeds.delete(key);
+    this.queue.remove(key);
+    const keys = seed.blobsCoreKey ? this.seedsByCore.get(seed.blobsCoreKey) : null;
+    if (keys) {
+      keys.delete(key);
+      if (keys.size === 0) {
+        this.seedsByCore.delete(seed.blobsCoreKey);
+        this._readObservers.get(seed.blobsCoreKey)?.();
+        this._readObservers.delete(seed.blobsCoreKey);
+      }
+    }
+    return seed;
+  }
+
+  /**
+   * Record local block reads of a seeded core (blob server streams,
+   * HypercoreIOReader preloads) in the access map, through the peer stats
+   * read hook rather than wrapping core.get() a second time.
+   * @param {string} coreKeyHex
+   */
+  _observeReads(coreKeyHex) {
+    if (!this.peerStats || this._readObservers.has(coreKeyHex)) return;
+    this._readObservers.set(coreKeyHex, this.peerStats.onRead(coreKeyHex, (index) => {
+      this.access.touch(coreKeyHex, index);
+      if (this.access.dirty && !this._accessTimer) {
+        this._accessTimer = setTimeout(() => {
+          this._accessTimer = null;
+          this.persistAccessMap().catch(() => {});
+        }, ACCESS_PERSIST_DELAY_MS);
+        this._accessTimer.unref?.();
+      }
+    }));
+  }
+
+  /**
+   * A seed's cleared part of a range was read again: peers are refetching
+   * it, so count its bytes against that seed's quota again
+   * @param {string} coreKeyHex
+   * @param {number} range
+   * @param {number} start - First block of the cleared span
+   */
+  _onColdMiss(coreKeyHex, range, start) {
+    const key = this._seedAt(coreKeyHex, start);
+    const seed = key && this.activeSeeds.get(key);
+    if (!seed?.clearedBytes) return;
+    const bytes = this._rangeBytes(seed, range);
+    if (bytes === 0) return;
+    seed.clearedBytes = Math.max(0, seed.clearedBytes - bytes);
+    this.queue.add(key, seed);
+  }
+
+  /**
+   * Key of the seed whose blob holds a block, or null
+   * @param {string} coreKeyHex
+   * @param {number} block
+   * @returns {string|null}
+   */
+  _seedAt(coreKeyHex, block) {
+    for (const key of this.seedsByCore.get(coreKeyHex) || []) {
+      const seed = this.activeSeeds.get(key);
+      if (typeof seed?.blockOffset === 'number' && block >= seed.blockOffset && block < seed.blockOffset + (seed.blocks || 0)) return key;
+    }
+    return null;
+  }
+
+  /**
+   * Parts of [start, end) on a core that no live seed other than `except`
+   * holds, i.e. blocks that are safe to clear
+   * @param {string} coreKeyHex
+   * @param {number} start
+   * @param {number} end
+   * @param {string} [except] - Seed key to ignore
+   * @returns {Array<[number, number]>}
+   */
+  _unsharedSpans(coreKeyHex, start, end, except) {
+    let spans = [[start, end]];
+    for (const key of this.seedsByCore.get(coreKeyHex) || []) {
+      if (key === except) continue;
+      const seed = this.activeSeeds.get(key);
+      if (typeof seed?.blockOffset !== 'number' || !seed.blocks) continue;
+      const from = seed.blockOffset;
+      const to = seed.blockOffset + seed.blocks;
+      const next = [];
+      for (const [s, e] of spans) {
+        if (to <= s || from >= e) {
+          next.push([s, e]);
+          continue;
+        }
+        if (s < from) next.push([s, from]);
+        if (to < e) next.push([to, e]);
+      }
+      spans = next;
+    }
+    return spans;
+  }
+
+  /**
+   * Whether a live seed's blob reaches into a range
+   * @param {string} coreKeyHex
+   * @param {number} range
+   */
+  _rangeUsed(coreKeyHex, range) {
+    for (const key of this.seedsByCore.get(coreKeyHex) || []) {
+      const seed = this.activeSeeds.get(key);
+      if (typeof seed?.blockOffset !== 'number' || !seed.blocks) continue;
+      const { start, end } = this._rangeSpan(seed, range);
+      if (end > start) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Block span [start, end) of a range, clipped to a seed's blob
+   * @param {SeedInfo} seed
+   * @param {number} range
+   */
+  _rangeSpan(seed, range) {
+    const start = Math.max(range * CHUNK_BLOCKS, seed.blockOffset);
+    const end = Math.min((range + 1) * CHUNK_BLOCKS, seed.blockOffset + seed.blocks);
+    return { start, end: Math.max(start, end) };
+  }
+
+  /**
+   * Estimated bytes of a seed's blob inside a range (blocks are equal size
+   * but for the last)
+   * @param {SeedInfo} seed
+   * @param {number} range
+   */
+  _rangeBytes(seed, range) {
+    if (!seed.blocks || typeof seed.blockOffset !== 'number') return 0;
+    const { start, end } = this._rangeSpan(seed, range);
+    return Math.round(((seed.bytes || 0) * (end - start)) / seed.blocks);
   }
 
   /**
@@ -67,7 +382,8 @@ export class SeedingManager {
    * @param {string} driveKey
    * @param {string} videoPath
    * @param {'watched'|'pinned'|'subscribed'} reason
-   * @param {{blockLength?: number, byteLength?: number}} [blobInfo]
+   * @param {{blockOffset?: number, blockLength?: number, byteLength?: number, blobsCoreKey?: string}} [blobInfo]
+   *   blockOffset and blobsCoreKey let the blocks be cleared from disk on eviction
    * @returns {Promise<boolean>}
    */
   async addSeed(driveKey, videoPath, reason, blobInfo) {
@@ -93,8 +409,12 @@ export class SeedingManager {
       blocks: blobInfo?.blockLength || 0,
       bytes: blobInfo?.byteLength || 0
     };
+    if (blobInfo?.blobsCoreKey && typeof blobInfo.blockOffset === 'number') {
+      seedInfo.blobsCoreKey = blobInfo.blobsCoreKey;
+      seedInfo.blockOffset = blobInfo.blockOffset;
+    }
 
-    this.activeSeeds.set(key, seedInfo);
+    this._track(key, seedInfo);
     await this.persistSeeds();
 
     console.log('[SeedingManager] Added seed:', videoPath, 'reason:', reason, 'bytes:', seedInfo.bytes);
@@ -114,7 +434,7 @@ export class SeedingManager {
   async removeSeed(driveKey, videoPath) {
     const key = `${driveKey}:${videoPath}`;
     if (this.activeSeeds.has(key)) {
-      this.activeSeeds.delete(key);
+      this._untrack(key);
       await this.persistSeeds();
       console.log('[SeedingManager] Removed seed:', key.slice(0, 32));
       return true;
@@ -164,6 +484,7 @@ export class SeedingManager {
       storageUsedBytes: storageUsed,
       storageUsedGB: (storageUsed / (1024 * 1024 * 1024)).toFixed(2),
       maxStorageGB: this.config.maxStorageGB,
+      reclaim: this.getReclaimStats(),
       config: this.config,
       seeds: Array.from(this.activeSeeds.values()).map(s => ({
         videoPath: s.videoPath,
@@ -175,54 +496,199 @@ export class SeedingManager {
   }
 
   /**
-   * Calculate total storage used by seeds
+   * Calculate total storage used by seeds (running total, O(1))
    * @returns {number}
    */
   calculateStorage() {
-    let total = 0;
-    for (const seed of this.activeSeeds.values()) {
-      total += seed.bytes || 0;
-    }
-    return total;
+    return this.queue.totalBytes;
   }
 
   /**
-   * Enforce storage quota by removing old/low-priority seeds
+   * Enforce storage quota. Cold block ranges go first: ranges of non-pinned
+   * seeds unread for COLD_RANGE_MS, least recently read first, so the
+   * unwatched tail of a long video is cleared before any video is dropped.
+   * Then whole seeds from the front of the priority queue (watched before
+   * subscribed, oldest first; pinned never), O(log n) per eviction.
+   * Evicted blocks are cleared from disk in the background.
    */
   async enforceQuota() {
     const maxBytes = this.config.maxStorageGB * 1024 * 1024 * 1024;
-    let currentBytes = this.calculateStorage();
-
-    if (currentBytes <= maxBytes) {
+    if (this.queue.totalBytes <= maxBytes) {
       return; // Under quota
     }
 
-    console.log('[SeedingManager] Over quota, current:', currentBytes, 'max:', maxBytes);
+    console.log('[SeedingManager] Over quota, current:', this.queue.totalBytes, 'max:', maxBytes);
+
+    let ranges = 0;
+    for (const cold of this._coldRanges(Date.now())) {
+      if (this.queue.totalBytes <= maxBytes) break;
+      this._evictRange(cold.key, cold.range);
+      ranges++;
+    }
+    if (ranges > 0) console.log('[SeedingManager] Cleared', ranges, 'cold ranges to meet quota');
+
+    let evicted = 0;
+    while (this.queue.totalBytes > maxBytes) {
+      const key = this.queue.peek();
+      if (key === null) break; // Only pinned seeds left
 
-    // Get seeds sorted by priority (pinned > subscribed > watched) then by age
-    const seeds = Array.from(this.activeSeeds.entries())
-      .map(([key, info]) => ({ key, ...info }))
-      .sort((a, b) => {
-        // Priority order: pinned (keep) > subscribed > watched (remove first)
-        const priorityOrder = { pinned: 3, subscribed: 2, watched: 1 };
-        const priorityDiff = (priorityOrder[a.reason] || 0) - (priorityOrder[b.reason] || 0);
-        if (priorityDiff !== 0) return priorityDiff;
+      this.reclaim(this._untrack(key));
+      evicted++;
+      console.log('[SeedingManager] Removed seed to meet quota:', key.slice(0, 32));
+    }
 
-        // Older first for same priority
-        return a.addedAt - b.addedAt;
+    if (ranges > 0 || evicted > 0) {
+      await this.persistSeeds();
+      await this.persistAccessMap();
+    }
+  }
+
+  /**
+   * Cold ranges of every clearable seed, least recently read first. A range
+   * never read counts as read when its seed was added, so fresh seeds are
+   * not cold. Seeds sharing a range are cleared separately, each its own
+   * part; seeds of unknown size are skipped as clearing them frees nothing
+   * from the quota. O(ranges log ranges), only when over quota.
+   * @param {number} now
+   * @returns {Array<{key: string, range: number, lastAccess: number, rank: number}>}
+   */
+  _coldRanges(now) {
+    const cold = [];
+    for (const [key, seed] of this.activeSeeds) {
+      if (seed.reason === 'pinned' || !seed.blobsCoreKey || typeof seed.blockOffset !== 'number' || !seed.blocks || !seed.bytes) continue;
+
+      const first = Math.floor(seed.blockOffset / CHUNK_BLOCKS);
+      const last = Math.ceil((seed.blockOffset + seed.blocks) / CHUNK_BLOCKS);
+      for (let range = first; range < last; range++) {
+        if (this.access.isCleared(seed.blobsCoreKey, this._rangeSpan(seed, range).start)) continue;
+        const lastAccess = Math.max(this.access.lastAccess(seed.blobsCoreKey, range), seed.addedAt || 0);
+        if (now - lastAccess < COLD_RANGE_MS) continue;
+        cold.push({ key, range, lastAccess, rank: REASON_RANK[seed.reason] || 0 });
+      }
+    }
+    return cold.sort((a, b) => (a.lastAccess - b.lastAccess) || (a.rank - b.rank));
+  }
+
+  /**
+   * Clear one range of a seed that stays seeded
+   * @param {string} key
+   * @param {number} range
+   */
+  _evictRange(key, range) {
+    const seed = this.activeSeeds.get(key);
+    if (!seed) return;
+    const bytes = this._rangeBytes(seed, range);
+    if (bytes === 0) return;
+    const { start, end } = this._rangeSpan(seed, range);
+
+    seed.clearedBytes = Math.min(seed.bytes, (seed.clearedBytes || 0) + bytes);
+    this.queue.add(key, seed);
+    this.access.markCleared(seed.blobsCoreKey, start, end);
+    this._queueReclaim({ label: seed.videoPath, seedKey: key, coreKeyHex: seed.blobsCoreKey, start, end, bytes, range });
+  }
+
+  /**
+   * Queue an evicted (already untracked) seed's blocks for clearing from the
+   * local blobs core. Access times of ranges other seeds still use are kept.
+   * Seeds without a known block range (recorded before blockOffset was
+   * kept) only stop being tracked.
+   * @param {SeedInfo|undefined} seed
+   */
+  reclaim(seed) {
+    if (!seed?.blobsCoreKey || typeof seed.blockOffset !== 'number' || !seed.blocks) return;
+    const start = seed.blockOffset;
+    const end = seed.blockOffset + seed.blocks;
+    this.access.forget(seed.blobsCoreKey, start, end, (range) => this._rangeUsed(seed.blobsCoreKey, range));
+    this._queueReclaim({
+      label: seed.videoPath,
+      seedKey: `${seed.driveKey}:${seed.videoPath}`,
+      coreKeyHex: seed.blobsCoreKey,
+      start,
+      end,
+      bytes: Math.max(0, (seed.bytes || 0) - (seed.clearedBytes || 0)),
+      range: null
+    });
+  }
+
+  _queueReclaim(item) {
+    this.reclaimQueue.push(item);
+    if (!this.reclaiming) {
+      this.reclaiming = this._reclaimLoop().finally(() => {
+        this.reclaiming = null;
       });
+    }
+  }
+
+  async _reclaimLoop() {
+    while (this.reclaimQueue.length > 0) {
+      const item = this.reclaimQueue.shift();
 
-    // Remove oldest/lowest priority seeds until under quota
-    for (const seed of seeds) {
-      if (currentBytes <= maxBytes) break;
-      if (seed.reason === 'pinned') continue; // Never remove pinned
+      if (item.range === null) {
+        // Re-seeded since eviction: keep the blocks
+        if (this.activeSeeds.has(item.seedKey)) continue;
+      } else if (!this.access.isCleared(item.coreKeyHex, item.start)) {
+        // Read again before we got to it
+        continue;
+      }
 
-      this.activeSeeds.delete(seed.key);
-      currentBytes -= seed.bytes || 0;
-      console.log('[SeedingManager] Removed seed to meet quota:', seed.key.slice(0, 32));
+      // Blocks another live seed holds (the same blob seeded twice) stay
+      const spans = this._unsharedSpans(item.coreKeyHex, item.start, item.end, item.seedKey);
+      if (spans.length === 0) continue;
+
+      const started = Date.now();
+      let core = null;
+      try {
+        core = this.store.get(b4a.from(item.coreKeyHex, 'hex'));
+        await core.ready();
+        // Never clear a core we write to (our own uploads)
+        if (core.writable) continue;
+
+        let freed = 0;
+        for (const [start, end] of spans) {
+          const cleared = await core.clear(start, end, { diff: true });
+          freed += cleared?.blocks ?? Math.round((item.bytes * (end - start)) / (item.end - item.start));
+        }
+        if (item.range === null) this.reclaimStats.seeds++;
+        else this.reclaimStats.ranges++;
+        this.reclaimStats.bytes += freed;
+        this.reclaimStats.elapsedMs += Date.now() - started;
+        console.log('[SeedingManager] Reclaimed', freed, 'bytes from', item.label, item.range === null ? '' : 'range ' + item.range);
+      } catch (err) {
+        this.reclaimStats.failed++;
+        console.log('[SeedingManager] Reclaim failed for', item.label, err?.message);
+      } finally {
+        if (core) await core.close().catch(() => {});
+      }
     }
+  }
 
-    await this.persistSeeds();
+  /**
+   * Background reclamation progress; bytesPerSecond is over time spent
+   * clearing. coldMisses counts reads of ranges we had cleared (each one a
+   * refetch from peers, i.e. a likely rebuffer), to weigh against
+   * reclaimedBytes.
+   * @returns {{ pending: number, reclaimedSeeds: number, reclaimedRanges: number, reclaimedBytes: number, bytesPerSecond: number, coldMisses: number, failed: number }}
+   */
+  getReclaimStats() {
+    const { seeds, ranges, bytes, elapsedMs, failed } = this.reclaimStats;
+    return {
+      pending: this.reclaimQueue.length,
+      reclaimedSeeds: seeds,
+      reclaimedRanges: ranges,
+      reclaimedBytes: bytes,
+      bytesPerSecond: elapsedMs > 0 ? Math.round((bytes * 1000) / elapsedMs) : 0,
+      coldMisses: this.access.stats.coldMisses,
+      failed
+    };
+  }
+
+  /**
+   * Persist the block access map to database
+   */
+  async persistAccessMap() {
+    if (!this.access.dirty) return;
+    this.access.dirty = false;
+    await this.metaDb.put('block-access', b4a.toString(this.access.encode(), 'base64'));
   }
 
   /**
@@ -290,7 +756,7 @@ export class SeedingManager {
 
   /**
    * Get storage stats for UI display
-   * @returns {{ usedBytes: number, maxBytes: number, usedGB: string, maxGB: number, seedCount: number, pinnedCount: number }}
+   * @returns {{ usedBytes: number, maxBytes: number, usedGB: string, maxGB: number, seedCount: number, pinnedCount: number, reclaim: Object }}
    */
   getStorageStats() {
     const usedBytes = this.calculateStorage();
@@ -301,7 +767,8 @@ export class SeedingManager {
       usedGB: (usedBytes / (1024 * 1024 * 1024)).toFixed(2),
       maxGB: this.config.maxStorageGB,
       seedCount: this.activeSeeds.size,
-      pinnedCount: this.pinnedChannels.size
+      pinnedCount: this.pinnedChannels.size,
+      reclaim: this.getReclaimStats()
     };
   }
 
@@ -315,16 +782,17 @@ export class SeedingManager {
 
     for (const [key, seed] of this.activeSeeds.entries()) {
       if (seed.reason !== 'pinned') {
-        clearedBytes += seed.bytes || 0;
+        clearedBytes += Math.max(0, (seed.bytes || 0) - (seed.clearedBytes || 0));
         toRemove.push(key);
       }
     }
 
     for (const key of toRemove) {
-      this.activeSeeds.delete(key);
+      this.reclaim(this._untrack(key));
     }
 
     await this.persistSeeds();
+    await this.persistAccessMap();
     console.log('[SeedingManager] Cleared cache:', clearedBytes, 'bytes from', toRemove.length, 'seeds');
     return clearedBytes;
   }
@@ -13,6 +13,7 @@ import b4a from 'b4a';
 import crypto from 'hypercore-crypto';
 import { MultiWriterChannel, ChannelPairer } from './channel/index.js'
 import { PublicChannelBee } from './channel/public-channel-bee.js'
+import { PeerNetworkStats } from './peer-stats.js';
 
 // Network stats for debugging connection issues
 let HyperswarmStats = null;
@@ -25,6 +26,9 @@ try {
 // Global network stats instance (set after swarm is created)
 let networkStats = null;
 
+// Per-peer / per-core bandwidth and latency (set after swarm is created)
+let peerStats = null;
+
 // Global references for suspend/resume (set in initializeStorage)
 let globalSwarm = null;
 let globalBlobServer = null;
@@ -211,6 +215,15 @@ export async function initializeStorage(config) {
     }
   }
 
+  try {
+    peerStats = new PeerNetworkStats();
+    peerStats.attach(store, swarm);
+    console.log('[Storage] Peer stats initialized, native:', peerStats.native);
+  } catch (e) {
+    console.log('[Storage] Peer stats init failed:', e?.message);
+    peerStats = null;
+  }
+
   // Join the PearTube network topic for peer pool building
   // More connected peers = better relay options for symmetric NAT holepunching
   const PEARTUBE_NETWORK_TOPIC = crypto.data(b4a.from('peartube-network', 'utf-8'));
@@ -394,6 +407,7 @@ export async function initializeStorage(config) {
   return {
     store,
     metaDb,
+    storagePath,
     swarm,
     blobServer,
     blobServerPort,
@@ -1141,6 +1155,32 @@ export function getNetworkStats() {
   }
 }
 
+/**
+ * Per-peer and per-core rates and fetch latency percentiles, for the UI and
+ * for picking peers.
+ *
+ * @returns {{native: boolean, peers: import('./peer-stats.js').PeerStatsEntry[], cores: import('./peer-stats.js').PeerStatsEntry[], samples: number}|null}
+ */
+export function getPeerStats() {
+  if (!peerStats) return null;
+  try {
+    return peerStats.snapshot();
+  } catch (err) {
+    console.log('[Network] Peer stats snapshot error:', err?.message);
+    return null;
+  }
+}
+
+/**
+ * The live per-peer stats collector (null before storage is initialized),
+ * for components that weigh peers, such as the playback scheduler.
+ *
+ * @returns {PeerNetworkStats|null}
+ */
+export function getPeerNetworkStats() {
+  return peerStats;
+}
+
 /**
  * Get human-readable network stats for debugging.
  *
@@ -15,6 +15,7 @@
  * @typedef {Object} StorageContext
  * @property {import('corestore')} store - Corestore instance
  * @property {import('hyperbee')} metaDb - Metadata database (Hyperbee)
+ * @property {string} [storagePath] - Storage directory (for files kept beside the Corestore)
  * @property {import('hyperswarm')} swarm - Hyperswarm instance
  * @property {import('hypercore-blob-server')} blobServer - Blob server instance
  * @property {number} blobServerPort - Blob server port
@@ -73,6 +74,9 @@
  * @property {number} addedAt - When added
  * @property {number} blocks - Block count
  * @property {number} bytes - Byte count
+ * @property {string} [blobsCoreKey] - Hex key of the blobs core holding the blocks
+ * @property {number} [blockOffset] - First block in that core (with blocks, the range cleared on eviction)
+ * @property {number} [clearedBytes] - Estimated bytes of cold ranges already cleared (not counted against quota)
  */
 
 /**
@@ -113,6 +117,10 @@
  * @property {string} [channelKey] - Channel key
  * @property {number} [duration] - Duration in seconds
  * @property {string} [thumbnail] - Thumbnail path
+ * @property {string} [keyframeIndexBlobId] - Blob ID of the keyframe index (bare-media-index format)
+ * @property {string} [hlsMasterBlobId] - Blob ID of the upload-time HLS master playlist (URIs are blob IDs)
+ * @property {Array<{name: string, width: number, height: number, bitRate: number}>} [hlsRenditions] - Renditions in that ladder
+ * @property {{sourceKey: string, coreKey: string, manifestBlobId: string}} [hlsCast] - Published cast HLS rendering (see hls-cache.js)
  */
 
 export const FEED_TOPIC_STRING = 'peartube-public-feed-v1';
@@ -8,11 +8,34 @@
  * - Video bytes are stored in the channel's shared Hyperblobs instance
  * - Video metadata is stored in Autobase via channel.addVideo()
  * - Blob IDs (4 numbers: blockOffset, blockLength, byteOffset, byteLength) are stored in metadata
+ * - MP4s are rewritten faststart (moov in front of the media data) on the way in, and a
+ *   keyframe time -> byte offset index is stored as its own blob (keyframeIndexBlobId)
+ * - File uploads are read ahead off the event loop by bare-ingest when available
  */
 
 import crypto from 'hypercore-crypto';
 import b4a from 'b4a';
 
+// Native faststart planner (Bare only); absent under Node and in builds without the addon
+let planFaststart = null;
+try {
+  const mod = await import('bare-media-index');
+  planFaststart = (mod.default || mod).planFaststart || null;
+} catch {}
+
+// Native read-ahead pipeline (Bare only); absent under Node and in builds without the addon
+let Ingest = null;
+try {
+  const mod = await import('bare-ingest');
+  Ingest = (mod.default || mod).Ingest || null;
+} catch {}
+
+// Hyperblobs' default block size
+const DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+// ISO-BMFF types the faststart planner understands
+const FASTSTART_MIME_TYPES = new Set(['video/mp4', 'video/quicktime', 'video/x-m4v', 'video/3gpp']);
+
 /**
  * Video file signatures (magic bytes) for MIME type detection
  * Based on file format specifications
@@ -130,6 +153,171 @@ function getExtensionForMime(mimeType) {
   return mimeToExt[mimeType] || 'mp4';
 }
 
+/**
+ * Read a byte range of a file
+ * Uses a bounded read stream where available (large positional reads are unreliable in bare)
+ * @param {Object} fs - File system module (bare-fs or node fs)
+ * @param {string} filePath - Path to file
+ * @param {number} offset - First byte
+ * @param {number} length - Bytes to read
+ * @returns {Promise<Buffer>}
+ */
+async function readFileRange(fs, filePath, offset, length) {
+  if (length <= 0) return b4a.alloc(0);
+
+  if (!fs.createReadStream) {
+    const fd = fs.openSync(filePath, 'r');
+    const buffer = b4a.alloc(length);
+    try {
+      fs.readSync(fd, buffer, 0, length, offset);
+    } finally {
+      fs.closeSync(fd);
+    }
+    return buffer;
+  }
+
+  return new Promise((resolve, reject) => {
+    const chunks = [];
+    const stream = fs.createReadStream(filePath, { start: offset, end: offset + length - 1 });
+    stream.on('data', chunk => chunks.push(chunk));
+    stream.on('end', () => resolve(b4a.concat(chunks)));
+    stream.on('error', reject);
+  });
+}
+
+/**
+ * Plan a faststart copy and keyframe index for an MP4
+ * @param {string} mimeType - Detected MIME type
+ * @param {number} fileSize - Source size in bytes
+ * @param {(offset: number, length: number) => Promise<Uint8Array>} read - Range reader
+ * @returns {Promise<Object|null>} planFaststart() result, or null to upload as-is
+ */
+async function planUploadFaststart(mimeType, fileSize, read) {
+  if (!planFaststart || !FASTSTART_MIME_TYPES.has(mimeType)) return null;
+
+  try {
+    const plan = await planFaststart(fileSize, read);
+    if (plan) {
+      console.log(`[Upload] Faststart: ${plan.remux ? 'moving moov to the front' : 'already faststart'}, ${plan.keyframes} keyframes indexed`);
+    }
+    return plan;
+  } catch (err) {
+    console.warn('[Upload] Faststart planning failed, uploading as-is:', err.message);
+    return null;
+  }
+}
+
+/**
+ * Wait for a write stream to drain
+ * @param {Object} writeStream - Hyperblobs write stream
+ * @returns {Promise<void>} Rejects if the stream errors or closes first
+ */
+function drained(writeStream) {
+  if (writeStream.destroyed) return Promise.reject(new Error('Write stream closed'));
+
+  return new Promise((resolve, reject) => {
+    const done = (err) => {
+      writeStream.off('drain', ondrain);
+      writeStream.off('error', onerror);
+      writeStream.off('close', onclose);
+      if (err) reject(err);
+      else resolve();
+    };
+    const ondrain = () => done(null);
+    const onerror = (err) => done(err);
+    const onclose = () => done(new Error('Write stream closed'));
+    writeStream.on('drain', ondrain);
+    writeStream.on('error', onerror);
+    writeStream.on('close', onclose);
+  });
+}
+
+/**
+ * Write the planned output segments of a file to a blob write stream, with backpressure
+ * @param {Object} fs - File system module (bare-fs or node fs)
+ * @param {string} filePath - Source file
+ * @param {Array<{start: number, end: number}|{bytes: Uint8Array}>} segments - Output in order
+ * @param {Object} writeStream - Hyperblobs write stream
+ * @param {(bytes: number) => void} onChunk - Called with the size of every chunk written
+ * @returns {Promise<void>}
+ */
+async function writeSegments(fs, filePath, segments, writeStream, onChunk) {
+  for (const segment of segments) {
+    if (segment.bytes) {
+      onChunk(segment.bytes.byteLength);
+      if (!writeStream.write(b4a.from(segment.bytes.buffer, segment.bytes.byteOffset, segment.bytes.byteLength))) {
+        await drained(writeStream);
+      }
+      continue;
+    }
+    if (segment.end <= segment.start) continue;
+
+    await new Promise((resolve, reject) => {
+      const readStream = fs.createReadStream(filePath, { start: segment.start, end: segment.end - 1 });
+      readStream.on('data', (chunk) => {
+        onChunk(chunk.length);
+        if (!writeStream.write(chunk)) {
+          readStream.pause();
+          drained(writeStream).then(() => readStream.resume(), (err) => {
+            readStream.destroy();
+            reject(err);
+          });
+        }
+      });
+      readStream.on('end', resolve);
+      readStream.on('error', reject);
+    });
+  }
+}
+
+/**
+ * Write the planned output segments through the native ingest pipeline
+ * Worker threads read ahead in large aligned buffers; JS sees one batch per 4 MB instead
+ * of one chunk per stream read, and waits for batches without blocking the event loop
+ * @param {string} filePath - Source file
+ * @param {Array<{start: number, end: number}|{bytes: Uint8Array}>} segments - Output in order
+ * @param {Object} writeStream - Hyperblobs write stream
+ * @param {number} blockSize - Hyperblobs block size, so batches are whole blocks of the core
+ * @param {(bytes: number) => void} onChunk - Called with the size of every batch written
+ * @returns {Promise<void>}
+ */
+async function ingestSegments(filePath, segments, writeStream, blockSize, onChunk) {
+  const ingest = new Ingest(filePath, { segments, blockSize });
+
+  try {
+    for await (const batch of ingest) {
+      onChunk(batch.data.byteLength);
+      if (!writeStream.write(b4a.from(batch.data.buffer, batch.data.byteOffset, batch.data.byteLength))) {
+        await drained(writeStream);
+      }
+    }
+
+    const stats = ingest.stats();
+    console.log(`[Upload] Ingest: ${(stats.throughput / 1024 / 1024).toFixed(1)} MB/s on ${stats.threads} threads (read ${stats.readTime.toFixed(0)}ms, waited ${stats.waitTime.toFixed(0)}ms)`);
+  } finally {
+    ingest.destroy();
+  }
+}
+
+/**
+ * Store a keyframe index next to the video
+ * @param {MultiWriterChannel} channel - Target channel
+ * @param {Object|null} plan - planFaststart() result
+ * @returns {Promise<string|undefined>} Blob ID of the index
+ */
+async function storeKeyframeIndex(channel, plan) {
+  if (!plan?.keyframeIndex) return undefined;
+
+  try {
+    const index = plan.keyframeIndex;
+    const blobResult = await channel.putBlob(b4a.from(index.buffer, index.byteOffset, index.byteLength));
+    return blobResult.id;
+  } catch (err) {
+    console.warn('[Upload] Storing keyframe index failed:', err.message);
+    return undefined;
+  }
+}
+
 /**
  * @typedef {import('./channel/multi-writer-channel.js').MultiWriterChannel} MultiWriterChannel
  * @typedef {import('./types.js').StorageContext} StorageContext
@@ -200,35 +388,20 @@ export function createUploadManager({ ctx }) {
 
         // Detect MIME type from file magic bytes (first 4KB is enough)
         // Use chunked read to avoid issues with large files in bare runtime
-        const headerSize = Math.min(4100, fileSize);
-        let headerBuffer;
-
-        if (fs.createReadStream) {
-          // Use streaming for header detection
-          headerBuffer = await new Promise((resolve, reject) => {
-            const chunks = [];
-            let bytesRead = 0;
-            const stream = fs.createReadStream(filePath, { start: 0, end: headerSize - 1 });
-            stream.on('data', chunk => {
-              chunks.push(chunk);
-              bytesRead += chunk.length;
-            });
-            stream.on('end', () => resolve(b4a.concat(chunks)));
-            stream.on('error', reject);
-          });
-        } else {
-          // Fallback for environments without createReadStream
-          const fd = fs.openSync(filePath, 'r');
-          headerBuffer = b4a.alloc(headerSize);
-          fs.readSync(fd, headerBuffer, 0, headerSize, 0);
-          fs.closeSync(fd);
-        }
+        const headerBuffer = await readFileRange(fs, filePath, 0, Math.min(4100, fileSize));
 
         const detectedMimeType = detectMimeType(headerBuffer);
         const mimeType = detectedMimeType || providedMimeType || 'video/mp4';
 
         console.log(`[Upload] Starting: ${filePath} (${(fileSize / 1024 / 1024).toFixed(2)} MB)`);
 
+        // Move moov to the front of MP4s so viewers can start without fetching the tail
+        const plan = fs.createReadStream
+          ? await planUploadFaststart(mimeType, fileSize, (offset, length) => readFileRange(fs, filePath, offset, length))
+          : null;
+        const segments = plan ? plan.segments : [{ start: 0, end: fileSize }];
+        const outputSize = plan ? plan.outputSize : fileSize;
+
         const startTime = Date.now();
         let bytesWritten = 0;
         let lastProgressUpdate = Date.now();
@@ -236,43 +409,52 @@ export function createUploadManager({ ctx }) {
         // Use streaming upload for large files
         const blobResult = await new Promise((resolve, reject) => {
           const writeStream = channel.blobs.createWriteStream();
-          const readStream = fs.createReadStream(filePath);
 
-          readStream.on('data', (chunk) => {
-            bytesWritten += chunk.length;
+          writeStream.on('error', reject);
+          writeStream.on('close', () => {
+            // Format blob ID as string like putBlob does
+            const id = writeStream.id;
+            const idStr = `${id.blockOffset}:${id.blockLength}:${id.byteOffset}:${id.byteLength}`;
+            resolve({ id: idStr, ...id });
+          });
+
+          const onChunk = (length) => {
+            bytesWritten += length;
             const now = Date.now();
             // Update progress every 500ms to avoid flooding
-            if (onProgress && (now - lastProgressUpdate > 500 || bytesWritten === fileSize)) {
-              const progress = Math.round((bytesWritten / fileSize) * 100);
+            if (onProgress && (now - lastProgressUpdate > 500 || bytesWritten === outputSize)) {
+              const progress = Math.round((bytesWritten / outputSize) * 100);
               const elapsed = (now - startTime) / 1000;
               const speed = elapsed > 0 ? bytesWritten / elapsed : 0;
-              const remaining = fileSize - bytesWritten;
+              const remaining = outputSize - bytesWritten;
               const eta = speed > 0 ? remaining / speed : 0;
-              onProgress(progress, bytesWritten, fileSize, { speed, eta });
+              onProgress(progress, bytesWritten, outputSize, { speed, eta });
               lastProgressUpdate = now;
             }
-          });
+          };
 
-          readStream.on('error', reject);
-          writeStream.on('error', reject);
-          writeStream.on('close', () => {
-            // Format blob ID as string like putBlob does
-            const id = writeStream.id;
-            const idStr = `${id.blockOffset}:${id.blockLength}:${id.byteOffset}:${id.byteLength}`;
-            resolve({ id: idStr, ...id });
-          });
+          const pump = Ingest
+            ? ingestSegments(filePath, segments, writeStream, channel.blobs.blockSize || DEFAULT_BLOCK_SIZE, onChunk)
+            : writeSegments(fs, filePath, segments, writeStream, onChunk);
 
-          readStream.pipe(writeStream);
+          pump.then(() => {
+            writeStream.end();
+          }, (err) => {
+            writeStream.destroy(err);
+            reject(err);
+          });
         });
 
         if (onProgress) {
-          onProgress(100, fileSize, fileSize, { speed: 0, eta: 0 });
+          onProgress(100, outputSize, outputSize, { speed: 0, eta: 0 });
         }
 
         const totalTime = (Date.now() - startTime) / 1000;
-        const avgSpeed = fileSize / totalTime;
+        const avgSpeed = outputSize / totalTime;
         console.log(`[Upload] Transfer complete in ${totalTime.toFixed(1)}s (avg ${(avgSpeed / 1024 / 1024).toFixed(2)} MB/s)`);
 
+        const keyframeIndexBlobId = await storeKeyframeIndex(channel, plan);
+
         // Create video metadata and store in Autobase
         // Ensure all string fields are actually strings to pass validation
         const metadata = {
@@ -280,11 +462,12 @@ export function createUploadManager({ ctx }) {
           title: String(title || ''),
           description: String(description || ''),
           mimeType: String(mimeType || 'video/mp4'),
-          size: fileSize,
+          size: outputSize,
           uploadedAt: Date.now(),
           uploadedBy: channel.localWriterKeyHex,
           blobId: blobResult.id,
           blobsCoreKey: channel.blobsKeyHex, // Which device's blobs core has this video
+          keyframeIndexBlobId,
           duration,
           thumbnail,
           category: String(category || '')
@@ -336,11 +519,19 @@ export function createUploadManager({ ctx }) {
 
         console.log(`[Upload] Starting buffer upload (${(fileSize / 1024 / 1024).toFixed(2)} MB), MIME: ${mimeType}`);
 
+        // Move moov to the front of MP4s so viewers can start without fetching the tail
+        const plan = await planUploadFaststart(mimeType, fileSize, async (offset, length) => buffer.subarray(offset, offset + length));
+        const output = plan?.remux
+          ? b4a.concat(plan.segments.map((s) => (s.bytes ? s.bytes : buffer.subarray(s.start, s.end))))
+          : buffer;
+        const outputSize = output.length;
+
         // Store video bytes in Hyperblobs
-        const blobResult = await channel.putBlob(buffer);
+        const blobResult = await channel.putBlob(output);
+        const keyframeIndexBlobId = await storeKeyframeIndex(channel, plan);
 
         if (onProgress) {
-          onProgress(100, fileSize, fileSize);
+          onProgress(100, outputSize, outputSize);
         }
 
         // Create video metadata and store in Autobase
@@ -350,11 +541,12 @@ export function createUploadManager({ ctx }) {
           title: String(title || ''),
           description: String(description || ''),
           mimeType: String(mimeType || 'video/mp4'),
-          size: fileSize,
+          size: outputSize,
           uploadedAt: Date.now(),
           uploadedBy: channel.localWriterKeyHex,
           blobId: blobResult.id,
           blobsCoreKey: channel.blobsKeyHex, // Which device's blobs core has this video
+          keyframeIndexBlobId,
           duration,
           thumbnail,
           category: String(category || '')
@@ -0,0 +1,151 @@
+import { EventEmitter } from 'node:events'
+
+import b4a from 'b4a'
+
+import { PlaybackScheduler } from '../src/block-scheduler.js'
+
+function sleep(ms) {
+  return new Promise(resolve => setTimeout(resolve, ms))
+}
+
+function withTimeout(promise, ms, label) {
+  let timer
+  const timeout = new Promise((resolve, reject) => {
+    timer = setTimeout(() => reject(new Error(`Timed out: ${label}`)), ms)
+  })
+  return Promise.race([promise, timeout]).finally(() => clearTimeout(timer))
+}
+
+// Keyframe index bytes in the bare-media-index format
+function keyframeIndex(durationMs, headEnd, keyframes) {
+  const bytes = [...b4a.from('PKFI'), 1]
+  const uvarint = (v) => {
+    while (v >= 0x80) {
+      bytes.push((v % 0x80) | 0x80)
+      v = Math.floor(v / 0x80)
+    }
+    bytes.push(v)
+  }
+  const svarint = (v) => uvarint(v >= 0 ? v * 2 : -v * 2 - 1)
+  uvarint(durationMs)
+  uvarint(headEnd)
+  uvarint(keyframes.length)
+  let time = 0
+  let offset = 0
+  for (const [t, o] of keyframes) {
+    svarint(t - time)
+    svarint(o - offset)
+    time = t
+    offset = o
+  }
+  return new Uint8Array(bytes)
+}
+
+// A blob core with one peer whose first download of `failBlock` fails
+function mockCore({ start, end, failBlock }) {
+  const core = new EventEmitter()
+  const peer = { remotePublicKey: b4a.alloc(32, 1) }
+  const local = new Set()
+  const attempts = new Map()
+
+  core.key = b4a.alloc(32, 7)
+  core.peers = [peer]
+  core.attempts = attempts
+  core.has = async (from, to) => {
+    for (let i = from; i < to; i++) if (!local.has(i)) return false
+    return true
+  }
+  core.download = ({ blocks: [block] }) => {
+    const n = (attempts.get(block) || 0) + 1
+    attempts.set(block, n)
+
+    let resolve, reject
+    const promise = new Promise((res, rej) => {
+      resolve = res
+      reject = rej
+    })
+    promise.catch(() => {})
+    const timer = setTimeout(() => {
+      if (block === failBlock && n === 1) return reject(new Error('Request timed out'))
+      local.add(block)
+      core.emit('download', block, 65536, peer)
+      resolve()
+    }, 20)
+    return {
+      done: () => promise,
+      destroy() {
+        clearTimeout(timer)
+        reject(new Error('Download was cancelled'))
+      }
+    }
+  }
+  core.complete = () => {
+    for (let i = start; i < end; i++) if (!local.has(i)) return false
+    return true
+  }
+  return core
+}
+
+async function main() {
+  if (!PlaybackScheduler.available) {
+    console.log('SKIP: bare-block-scheduler is not available')
+    return
+  }
+
+  const start = 10
+  const end = 40
+  const core = mockCore({ start, end, failBlock: 12 })
+  const scheduler = new PlaybackScheduler(core, {
+    start,
+    end,
+    byteLength: (end - start) * 65536,
+    durationMs: 30000
+  })
+
+  // A failed download is retried after a backoff, so prefetch completes
+  // with a single peer
+  await withTimeout(scheduler.begin().done(), 10000, 'prefetch with a failed download')
+  if (!core.complete()) throw new Error('Prefetch resolved with blocks missing')
+  if (core.attempts.get(12) !== 2) throw new Error(`Expected 2 attempts for the failed block, got ${core.attempts.get(12)}`)
+  console.log('ok - prefetch completes after a failed download')
+
+  // Completion frees the native scheduler and detaches from the core
+  if (scheduler.stats() !== null) throw new Error('Scheduler not destroyed on completion')
+  if (core.listenerCount('download') !== 0 || core.listenerCount('close') !== 0) {
+    throw new Error('Core listeners left attached')
+  }
+  scheduler.destroy()
+  console.log('ok - scheduler destroyed on completion, destroy() idempotent')
+
+  // The keyframe index drives media time per block: keyframes at 0/2/4 s
+  // on blocks 1/10/50 of a 10 s video
+  const indexed = new PlaybackScheduler(mockCore({ start: 0, end: 100 }), {
+    start: 0,
+    end: 100,
+    byteLength: 100 * 65536,
+    durationMs: 10000
+  })
+  if (indexed.useKeyframeIndex(keyframeIndex(10000, 65536, [[0, 65536], [2000, 10 * 65536], [4000, 50 * 65536]]))) {
+    if (indexed._mediaMs(10) !== 2000 || indexed._mediaMs(30) !== 3000 || indexed._mediaMs(75) !== 7000) {
+      throw new Error(`Unexpected media times ${indexed._mediaMs(10)}, ${indexed._mediaMs(30)}, ${indexed._mediaMs(75)}`)
+    }
+    indexed.readFrom = 10
+    indexed.lastRead = 29
+    indexed.readStartedAt = Date.now()
+    const { bufferMs } = indexed._position(indexed.readStartedAt)
+    if (bufferMs !== 1000) throw new Error(`Expected 1000 ms buffered from the index, got ${bufferMs}`)
+    console.log('ok - buffer level follows the keyframe index')
+  } else {
+    console.log('SKIP: bare-media-index is not available')
+  }
+  indexed.destroy()
+
+  // No stray timers keep polling
+  await sleep(150)
+  console.log('PASS')
+}
+
+main().catch((err) => {
+  console.error('FAIL:', err)
+  process.exitCode = 1
+})
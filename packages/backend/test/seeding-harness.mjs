@@ -0,0 +1,134 @@
+import b4a from 'b4a'
+
+import { SeedingManager } from '../src/seeding.js'
+import { BlockAccessMap } from '../src/block-cache.js'
+import { PeerNetworkStats } from '../src/peer-stats.js'
+
+const BLOCK = 1000
+const CORE = b4a.alloc(32, 9)
+const CORE_HEX = b4a.toString(CORE, 'hex')
+const HOUR = 60 * 60 * 1000
+
+function mockMetaDb() {
+  const values = new Map()
+  return {
+    async get(key) {
+      return values.has(key) ? { key, value: values.get(key) } : null
+    },
+    async put(key, value) {
+      values.set(key, value)
+    }
+  }
+}
+
+// A peer's blobs core: records what gets cleared
+function mockStore() {
+  const clears = []
+  return {
+    clears,
+    get() {
+      return {
+        key: CORE,
+        writable: false,
+        async ready() {},
+        async close() {},
+        async get(index) {
+          return b4a.alloc(0)
+        },
+        async clear(start, end) {
+          clears.push([start, end])
+          return { blocks: (end - start) * BLOCK }
+        }
+      }
+    }
+  }
+}
+
+function assert(ok, message) {
+  if (!ok) throw new Error(message)
+}
+
+function same(a, b, message) {
+  assert(JSON.stringify(a) === JSON.stringify(b), `${message}: expected ${JSON.stringify(b)}, got ${JSON.stringify(a)}`)
+}
+
+async function addSeed(manager, path, blockOffset, blockLength, byteLength = blockLength * BLOCK) {
+  await manager.addSeed('drive', path, 'watched', { blobsCoreKey: CORE_HEX, blockOffset, blockLength, byteLength })
+  manager.activeSeeds.get('drive:' + path).addedAt = Date.now() - HOUR
+}
+
+async function main() {
+  const store = mockStore()
+  const peerStats = new PeerNetworkStats()
+  peerStats.attach(store, null)
+  const manager = new SeedingManager(store, mockMetaDb(), { peerStats })
+  await manager.init()
+
+  // Two blobs on one core sharing range 1 (blocks 64..128): a is 0..100, b is 100..200
+  await addSeed(manager, '/a.mp4', 0, 100)
+  await addSeed(manager, '/b.mp4', 100, 100)
+  await addSeed(manager, '/empty.mp4', 200, 10, 0)
+  const a = manager.activeSeeds.get('drive:/a.mp4')
+  const b = manager.activeSeeds.get('drive:/b.mp4')
+
+  // Seeds of unknown size are never range cleared
+  assert(!manager._coldRanges(Date.now()).some(c => c.key === 'drive:/empty.mp4'), 'Seed with no bytes offered for clearing')
+  console.log('ok - seeds without bytes are not range cleared')
+
+  // Clearing a's part of the shared range leaves b's part cold and uncleared
+  manager._evictRange('drive:/a.mp4', 1)
+  await manager.reclaiming
+  same(a.clearedBytes, 36 * BLOCK, 'a cleared bytes')
+  same(b.clearedBytes || 0, 0, 'b cleared bytes')
+  same(store.clears, [[64, 100]], 'cleared blocks')
+  assert(manager._coldRanges(Date.now()).some(c => c.key === 'drive:/b.mp4' && c.range === 1), 'b skipped after a cleared the shared range')
+  console.log('ok - shared range cleared per seed')
+
+  manager._evictRange('drive:/b.mp4', 1)
+  await manager.reclaiming
+  same(b.clearedBytes, 28 * BLOCK, 'b cleared bytes')
+  same(store.clears, [[64, 100], [100, 128]], 'cleared blocks')
+
+  // A read of b's part credits b only
+  const core = store.get()
+  await core.get(110)
+  same(b.clearedBytes, 0, 'b after its cold miss')
+  same(a.clearedBytes, 36 * BLOCK, 'a after b cold miss')
+  assert(manager.access.isCleared(CORE_HEX, 70), 'a span uncleared by b read')
+  await core.get(70)
+  same(a.clearedBytes, 0, 'a after its cold miss')
+  same(manager.access.stats.coldMisses, 2, 'cold misses')
+  console.log('ok - cold miss credits the seed that was read')
+
+  // Cleared spans survive a round trip
+  manager._evictRange('drive:/b.mp4', 1)
+  await manager.reclaiming
+  const decoded = BlockAccessMap.decode(manager.access.encode())
+  assert(decoded.isCleared(CORE_HEX, 100) && decoded.isCleared(CORE_HEX, 127), 'b span lost in encoding')
+  assert(!decoded.isCleared(CORE_HEX, 70), 'a span appeared in encoding')
+
+  // Evicting a keeps the shared range's access time and b's cleared span
+  await core.get(20)
+  manager.reclaim(manager._untrack('drive:/a.mp4'))
+  await manager.reclaiming
+  assert(manager.access.lastAccess(CORE_HEX, 0) === 0, 'a only range not forgotten')
+  assert(manager.access.lastAccess(CORE_HEX, 1) > 0, 'shared range access forgotten')
+  assert(manager.access.isCleared(CORE_HEX, 100), 'b cleared span forgotten')
+  same(store.clears.at(-1), [0, 100], 'a reclaim')
+  console.log('ok - evicting one seed keeps state the other uses')
+
+  // The same blob seeded twice: evicting one copy clears nothing
+  await addSeed(manager, '/b-copy.mp4', 100, 100)
+  const before = store.clears.length
+  manager.reclaim(manager._untrack('drive:/b.mp4'))
+  await manager.reclaiming
+  same(store.clears.length, before, 'clears of a blob still seeded')
+  console.log('ok - blocks another seed holds are not cleared')
+
+  console.log('PASS')
+}
+
+main().catch((err) => {
+  console.error('FAIL:', err)
+  process.exitCode = 1
+})
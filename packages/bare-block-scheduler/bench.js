@@ -0,0 +1,154 @@
+/**
+ * Benchmark for bare-block-scheduler.
+ *
+ *   bare bench.js [blocks...]
+ *
+ * Schedules a range (default 20000 200000 blocks, 1.3 GB and 13 GB of
+ * 64 KiB blocks) over 32 peers of mixed throughput and round trip: every
+ * round the playhead advances, each peer delivers one of its requests and
+ * poll() hands out the replacements. Reports the cost of a round. The JS
+ * baseline is the usual hand-rolled approach, collecting and sorting the
+ * missing blocks by deadline each round before assigning them by expected
+ * completion, and is skipped above 20000 blocks. The end-to-end simulator
+ * run (simulate.js) shows stalls over a long video with a slow peer.
+ */
+
+const { BlockScheduler } = require('./index')
+const { simulate, schedulerPolicy } = require('./simulate')
+
+const PEERS = 32
+const BLOCK = 65536
+const BLOCK_MS = 64
+const ROUNDS = 2000
+const JS_BASELINE_MAX = 20000
+
+function peers() {
+  return Array.from({ length: PEERS }, (_, i) => ({
+    key: `peer-${i}`,
+    throughput: 2e5 + (i % 8) * 5e5,
+    rtt: 20 + (i % 5) * 60
+  }))
+}
+
+class JsScheduler {
+  constructor(blocks, list) {
+    this.blocks = blocks
+    this.have = new Uint8Array(blocks)
+    this.inflight = new Map() // block -> peer
+    this.peers = list.map((p) => ({ ...p, throughput: p.throughput / 1000, inflight: 0 }))
+    this.next = 0
+    this.time = 0
+  }
+
+  playhead(next, now) {
+    this.next = next
+    this.time = now
+  }
+
+  received(block) {
+    this.have[block] = 1
+    const p = this.inflight.get(block)
+    if (p) p.inflight--
+    this.inflight.delete(block)
+  }
+
+  poll(now) {
+    const deadline = (b) => this.time + (b >= this.next ? b - this.next : this.blocks - 1 - b) * BLOCK_MS
+    const missing = []
+    for (let b = 0; b < this.blocks; b++) {
+      if (!this.have[b] && !this.inflight.has(b)) missing.push(b)
+    }
+    missing.sort((a, b) => deadline(a) - deadline(b))
+    const out = []
+    for (const b of missing) {
+      let best = null
+      let bestAt = Infinity
+      for (const p of this.peers) {
+        const cap = Math.min(16, Math.ceil(p.throughput * p.rtt / BLOCK) + 2)
+        if (p.inflight >= cap) continue
+        const at = now + p.rtt + (p.inflight + 1) * BLOCK / p.throughput
+        if (at < bestAt) {
+          best = p
+          bestAt = at
+        }
+      }
+      if (!best) break
+      best.inflight++
+      this.inflight.set(b, best)
+      out.push({ block: b, peer: best.key })
+    }
+    return out
+  }
+}
+
+// Rounds of: advance, deliver one request per peer, poll
+function run(scheduler, blocks) {
+  const queues = new Map()
+  let next = 0
+  let actions = 0
+  const start = Date.now()
+  for (let round = 0; round < ROUNDS; round++) {
+    const now = round * 10
+    if (round % 6 === 0 && next < blocks) next++
+    scheduler.playhead(next, 2000, now)
+    for (const [peer, queue] of queues) {
+      if (queue.length > 0) scheduler.received(queue.shift(), peer, BLOCK, now)
+    }
+    for (const a of scheduler.poll(now)) {
+      if (a.type === 'cancel') continue
+      if (!queues.has(a.peer)) queues.set(a.peer, [])
+      queues.get(a.peer).push(a.block)
+      actions++
+    }
+  }
+  return { ms: Date.now() - start, actions }
+}
+
+function bench(blocks) {
+  const list = peers()
+  const scheduler = new BlockScheduler({ end: blocks, blockBytes: BLOCK, blockMs: BLOCK_MS })
+  for (const p of list) scheduler.addPeer(p.key, p)
+  const native = run({
+    playhead: (next, buffer, now) => scheduler.playhead(next, buffer, now),
+    received: (block, peer, bytes, now) => scheduler.received(block, peer, bytes, now),
+    poll: (now) => scheduler.poll(now)
+  }, blocks)
+  const info = scheduler.stats()
+  scheduler.destroy()
+
+  console.log(`\n${blocks} blocks, ${PEERS} peers, ${ROUNDS} rounds, ${(info.memory / 1024).toFixed(1)} KB`)
+  console.log(`  native: ${(native.ms * 1000 / ROUNDS).toFixed(1)} us/round, ${native.actions} requests`)
+
+  if (blocks <= JS_BASELINE_MAX) {
+    const js = new JsScheduler(blocks, list)
+    const baseline = run({
+      playhead: (next, buffer, now) => js.playhead(next, now),
+      received: (block) => js.received(block),
+      poll: (now) => js.poll(now)
+    }, blocks)
+    console.log(`  js:     ${(baseline.ms * 1000 / ROUNDS).toFixed(1)} us/round, ${baseline.actions} requests`)
+  }
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+const sizes = args.length > 0 ? args.map(Number) : [20000, 200000]
+for (const blocks of sizes) bench(blocks)
+
+// Ten minutes of 1 MB/s video from a fast, a medium and a slow peer
+{
+  const opts = { blocks: 9375, blockMs: BLOCK_MS }
+  const policy = schedulerPolicy(BlockScheduler, opts)
+  const start = Date.now()
+  const result = simulate(policy, {
+    ...opts,
+    limit: 1200000,
+    peers: [
+      { key: 'fast', bandwidth: 2e6, latency: 20 },
+      { key: 'medium', bandwidth: 8e5, latency: 60 },
+      { key: 'slow', bandwidth: 1.5e5, latency: 150 }
+    ]
+  })
+  const stats = policy.scheduler.stats()
+  policy.scheduler.destroy()
+  console.log(`\nsimulated ${(result.endedAt / 1000).toFixed(0)} s in ${Date.now() - start} ms: startup ${result.startupMs} ms, stalled ${result.stallMs} ms, served ${JSON.stringify(result.served)}, ${stats.hedges} hedges, ${stats.late} late`)
+}
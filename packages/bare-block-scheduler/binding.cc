@@ -0,0 +1,431 @@
+/**
+ * bare-block-scheduler - Bare native addon for playback block scheduling
+ * Earliest-deadline-first block requests assigned to peers by expected
+ * completion time, with hedging of overdue requests
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/block_scheduler.h"
+
+using bare_block_scheduler::action_width;
+using bare_block_scheduler::BlockScheduler;
+using bare_block_scheduler::config_t;
+
+// Handle wrapper for BlockScheduler
+typedef struct {
+  BlockScheduler *scheduler;
+} bare_block_scheduler_t;
+
+static bare_block_scheduler_t *
+bare_block_scheduler__scheduler(js_env_t *env, js_value_t *value) {
+  bare_block_scheduler_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->scheduler) {
+    js_throw_error(env, NULL, "Block scheduler has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Peer column: -1 (or anything out of range) is `none`
+static uint32_t
+bare_block_scheduler__peer(double value) {
+  if (!(value >= 0) || value >= double(bare_block_scheduler::none)) return bare_block_scheduler::none;
+  return uint32_t(value);
+}
+
+// Read `count` doubles from argv into `out`
+static int
+bare_block_scheduler__doubles(js_env_t *env, js_value_t **argv, size_t count, double *out) {
+  for (size_t i = 0; i < count; i++) {
+    int err = js_get_value_double(env, argv[i], &out[i]);
+    if (err != 0) return err;
+  }
+  return 0;
+}
+
+// (blocks, blockBytes, blockMs, maxInflight, lookaheadMs, urgentMs,
+// hedgeFactor, hedgeMinMs)
+static js_value_t *
+bare_block_scheduler_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 8;
+  js_value_t *argv[8];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  double args[8];
+  err = bare_block_scheduler__doubles(env, argv, 8, args);
+  if (err != 0) return NULL;
+
+  if (!(args[0] >= 0) || args[0] >= double(bare_block_scheduler::none)) {
+    js_throw_error(env, NULL, "Block count out of range");
+    return NULL;
+  }
+  if (!(args[1] > 0) || !(args[2] > 0) || !(args[3] >= 1) || !(args[4] >= 0) || !(args[5] >= 0) || !(args[6] > 0) || !(args[7] >= 0)) {
+    js_throw_error(env, NULL, "Invalid scheduler options");
+    return NULL;
+  }
+
+  config_t config;
+  config.blocks = uint32_t(args[0]);
+  config.block_bytes = args[1];
+  config.block_ms = args[2];
+  config.max_inflight = uint32_t(std::min(args[3], 1024.0));
+  config.lookahead_ms = args[4];
+  config.urgent_ms = args[5];
+  config.hedge_factor = args[6];
+  config.hedge_min_ms = args[7];
+
+  js_value_t *result;
+  bare_block_scheduler_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_block_scheduler_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->scheduler = new BlockScheduler(config);
+  return result;
+}
+
+// (handle, peer, throughput bytes/s, rtt ms)
+static js_value_t *
+bare_block_scheduler_set_peer(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  double args[3];
+  err = bare_block_scheduler__doubles(env, argv + 1, 3, args);
+  if (err != 0) return NULL;
+
+  uint32_t peer = bare_block_scheduler__peer(args[0]);
+  if (peer != bare_block_scheduler::none) handle->scheduler->set_peer(peer, args[1], args[2]);
+  return NULL;
+}
+
+// (handle, peer)
+static js_value_t *
+bare_block_scheduler_remove_peer(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t peer;
+  err = js_get_value_uint32(env, argv[1], &peer);
+  if (err != 0) return NULL;
+
+  handle->scheduler->remove_peer(peer);
+  return NULL;
+}
+
+// (handle, peer, start, end, lacks)
+static js_value_t *
+bare_block_scheduler_set_lacks(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t peer, start, end;
+  err = js_get_value_uint32(env, argv[1], &peer);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &start);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[3], &end);
+  if (err != 0) return NULL;
+
+  bool lacks;
+  err = js_get_value_bool(env, argv[4], &lacks);
+  if (err != 0) return NULL;
+
+  handle->scheduler->set_lacks(peer, start, end, lacks);
+  return NULL;
+}
+
+// (handle, next, bufferMs, now)
+static js_value_t *
+bare_block_scheduler_playhead(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t next;
+  err = js_get_value_uint32(env, argv[1], &next);
+  if (err != 0) return NULL;
+
+  double args[2];
+  err = bare_block_scheduler__doubles(env, argv + 2, 2, args);
+  if (err != 0) return NULL;
+
+  handle->scheduler->playhead(next, args[0], args[1]);
+  return NULL;
+}
+
+// (handle, block)
+static js_value_t *
+bare_block_scheduler_have(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t block;
+  err = js_get_value_uint32(env, argv[1], &block);
+  if (err != 0) return NULL;
+
+  handle->scheduler->have(block);
+  return NULL;
+}
+
+// (handle, block, peer, bytes, now); peer -1 for unknown
+static js_value_t *
+bare_block_scheduler_received(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t block;
+  err = js_get_value_uint32(env, argv[1], &block);
+  if (err != 0) return NULL;
+
+  double args[3];
+  err = bare_block_scheduler__doubles(env, argv + 2, 3, args);
+  if (err != 0) return NULL;
+
+  handle->scheduler->received(block, bare_block_scheduler__peer(args[0]), args[1], args[2]);
+  return NULL;
+}
+
+// (handle, block, peer, lacks, now); peer -1 for unknown
+static js_value_t *
+bare_block_scheduler_failed(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t block;
+  err = js_get_value_uint32(env, argv[1], &block);
+  if (err != 0) return NULL;
+
+  double peer;
+  err = js_get_value_double(env, argv[2], &peer);
+  if (err != 0) return NULL;
+
+  bool lacks;
+  err = js_get_value_bool(env, argv[3], &lacks);
+  if (err != 0) return NULL;
+
+  double now;
+  err = js_get_value_double(env, argv[4], &now);
+  if (err != 0) return NULL;
+
+  handle->scheduler->failed(block, bare_block_scheduler__peer(peer), lacks, now);
+  return NULL;
+}
+
+// (handle, block, peer)
+static js_value_t *
+bare_block_scheduler_release(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t block, peer;
+  err = js_get_value_uint32(env, argv[1], &block);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &peer);
+  if (err != 0) return NULL;
+
+  handle->scheduler->release(block, peer);
+  return NULL;
+}
+
+// Write action rows into a Uint32Array: (handle, now, out) -> rows written;
+// the array holds floor(length / 3) rows
+static js_value_t *
+bare_block_scheduler_poll(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  double now;
+  err = js_get_value_double(env, argv[1], &now);
+  if (err != 0) return NULL;
+
+  js_typedarray_type_t type;
+  uint32_t *out;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], &type, (void **) &out, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_uint32array) {
+    js_throw_error(env, NULL, "Output must be a Uint32Array");
+    return NULL;
+  }
+
+  size_t rows = handle->scheduler->poll(now, out, len / action_width);
+
+  js_value_t *result;
+  err = js_create_uint32(env, uint32_t(rows), &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+static js_value_t *
+bare_block_scheduler_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle = bare_block_scheduler__scheduler(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  BlockScheduler *scheduler = handle->scheduler;
+  const bare_block_scheduler::stats_t &stats = scheduler->stats();
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("missing", scheduler->missing());
+  SET_NUMBER("inflight", scheduler->inflight());
+  SET_NUMBER("peers", scheduler->peers());
+  SET_NUMBER("requests", stats.requests);
+  SET_NUMBER("hedges", stats.hedges);
+  SET_NUMBER("hedgeWins", stats.hedge_wins);
+  SET_NUMBER("cancels", stats.cancels);
+  SET_NUMBER("preemptions", stats.preemptions);
+  SET_NUMBER("received", stats.received);
+  SET_NUMBER("late", stats.late);
+  SET_NUMBER("failures", stats.failures);
+  SET_NUMBER("memory", scheduler->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_block_scheduler_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_block_scheduler_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->scheduler;
+  handle->scheduler = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_block_scheduler_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_block_scheduler_create);
+  EXPORT_FUNCTION(setPeer, bare_block_scheduler_set_peer);
+  EXPORT_FUNCTION(removePeer, bare_block_scheduler_remove_peer);
+  EXPORT_FUNCTION(setLacks, bare_block_scheduler_set_lacks);
+  EXPORT_FUNCTION(playhead, bare_block_scheduler_playhead);
+  EXPORT_FUNCTION(have, bare_block_scheduler_have);
+  EXPORT_FUNCTION(received, bare_block_scheduler_received);
+  EXPORT_FUNCTION(failed, bare_block_scheduler_failed);
+  EXPORT_FUNCTION(release, bare_block_scheduler_release);
+  EXPORT_FUNCTION(poll, bare_block_scheduler_poll);
+  EXPORT_FUNCTION(stats, bare_block_scheduler_stats);
+  EXPORT_FUNCTION(destroy, bare_block_scheduler_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_block_scheduler, bare_block_scheduler_exports)
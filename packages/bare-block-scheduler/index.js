@@ -0,0 +1,237 @@
+/**
+ * bare-block-scheduler - Deadline scheduling of playback block fetches
+ * The player's position and buffer level give every missing block of a
+ * range a deadline; poll() returns the requests to make now, earliest
+ * deadline first, each assigned to the peer expected to deliver it soonest
+ * (round trip plus queued bytes over learnt throughput). Requests overdue
+ * at one peer are hedged to another, urgent blocks may preempt far-ahead
+ * requests, and the losing copies come back as cancels.
+ */
+
+const binding = require('./binding')
+
+const ACTIONS = ['request', 'hedge', 'cancel']
+const ACTION_WIDTH = 3
+
+class Keys {
+  constructor() {
+    /** @type {Array<string|null>} index -> key */
+    this.keys = []
+    /** @type {Map<string, number>} key -> index */
+    this.indexes = new Map()
+    /** @type {number[]} indexes freed by release() */
+    this.free = []
+  }
+
+  index(key) {
+    let index = this.indexes.get(key)
+    if (index === undefined) {
+      index = this.free.length > 0 ? this.free.pop() : this.keys.length
+      this.keys[index] = key
+      this.indexes.set(key, index)
+    }
+    return index
+  }
+
+  release(key) {
+    const index = this.indexes.get(key)
+    if (index === undefined) return -1
+    this.indexes.delete(key)
+    this.keys[index] = null
+    this.free.push(index)
+    return index
+  }
+}
+
+class BlockScheduler {
+  /**
+   * @param {Object} opts
+   * @param {number} [opts.start=0] - First block of the range (core index)
+   * @param {number} opts.end - End of the range (exclusive)
+   * @param {number} [opts.blockBytes=65536] - Expected bytes per block
+   * @param {number} [opts.blockMs=500] - Media time per block in ms
+   * @param {number} [opts.maxInflight=16] - Requests in flight per peer, at most
+   * @param {number} [opts.lookaheadMs=Infinity] - Only request blocks due within this long
+   * @param {number} [opts.urgentMs=5000] - Blocks due within this long may be hedged or preempt others
+   * @param {number} [opts.hedgeFactor=2] - Hedge after this many times the expected response time
+   * @param {number} [opts.hedgeMinMs=250] - ...but never sooner than this
+   */
+  constructor(opts = {}) {
+    this.start = opts.start || 0
+    this.end = opts.end
+    if (!Number.isInteger(this.start) || !Number.isInteger(this.end) || this.end < this.start) {
+      throw new Error('Block range must be integers with start <= end')
+    }
+    this._handle = binding.create(
+      this.end - this.start,
+      opts.blockBytes || 65536,
+      opts.blockMs || 500,
+      opts.maxInflight || 16,
+      opts.lookaheadMs ?? Infinity,
+      opts.urgentMs ?? 5000,
+      opts.hedgeFactor || 2,
+      opts.hedgeMinMs ?? 250
+    )
+    this._peers = new Keys()
+    this._actions = new Uint32Array(256 * ACTION_WIDTH)
+  }
+
+  _scheduler() {
+    if (this._handle === null) throw new Error('Block scheduler has been destroyed')
+    return this._handle
+  }
+
+  _block(index) {
+    return index - this.start
+  }
+
+  _peer(key) {
+    if (key === null || key === undefined) return -1
+    const index = this._peers.indexes.get(key)
+    return index === undefined ? -1 : index
+  }
+
+  /**
+   * Add a peer or update its estimates
+   * @param {string} key - Remote peer key
+   * @param {Object} [estimate]
+   * @param {number} [estimate.throughput] - bytes/s (kept learnt if omitted)
+   * @param {number} [estimate.rtt] - ms
+   */
+  addPeer(key, estimate = {}) {
+    const handle = this._scheduler()
+    binding.setPeer(handle, this._peers.index(key), estimate.throughput || 0, estimate.rtt || 0)
+  }
+
+  /**
+   * Drop a peer; its in-flight blocks are requeued
+   * @param {string} key
+   */
+  removePeer(key) {
+    const handle = this._scheduler()
+    const index = this._peers.release(key)
+    if (index !== -1) binding.removePeer(handle, index)
+  }
+
+  /**
+   * Mark blocks [start, end) as missing at a peer (or present again)
+   * @param {string} key
+   * @param {number} start
+   * @param {number} end
+   * @param {boolean} [lacks=true]
+   */
+  lacks(key, start, end, lacks = true) {
+    const handle = this._scheduler()
+    const peer = this._peer(key)
+    if (peer === -1) return
+    const from = Math.max(0, this._block(start))
+    const to = Math.max(from, Math.min(this.end, end) - this.start)
+    binding.setLacks(handle, peer, from, to, lacks)
+  }
+
+  /**
+   * Player position
+   * @param {number} block - Next block the player will read (core index)
+   * @param {number} [bufferMs=0] - Media the player holds before it needs that block
+   * @param {number} [now] - ms (default Date.now())
+   */
+  playhead(block, bufferMs = 0, now = Date.now()) {
+    const handle = this._scheduler()
+    const next = Math.min(Math.max(0, this._block(block)), this.end - this.start)
+    binding.playhead(handle, next, bufferMs, now)
+  }
+
+  /**
+   * A block turned out to be available locally
+   * @param {number} block
+   */
+  have(block) {
+    const handle = this._scheduler()
+    const offset = this._block(block)
+    if (offset >= 0 && block < this.end) binding.have(handle, offset)
+  }
+
+  /**
+   * A block arrived
+   * @param {number} block
+   * @param {string|null} peer - Peer it came from, if known
+   * @param {number} bytes
+   * @param {number} [now]
+   */
+  received(block, peer, bytes, now = Date.now()) {
+    const handle = this._scheduler()
+    const offset = this._block(block)
+    if (offset >= 0 && block < this.end) binding.received(handle, offset, this._peer(peer), bytes, now)
+  }
+
+  /**
+   * A request failed. Unless the peer lacks the block, the block is retried
+   * after a backoff that doubles with each failure.
+   * @param {number} block
+   * @param {string|null} peer - Peer the request was made to, if known
+   * @param {boolean} [lacks=false] - The peer does not have the block
+   * @param {number} [now]
+   */
+  failed(block, peer, lacks = false, now = Date.now()) {
+    const handle = this._scheduler()
+    const offset = this._block(block)
+    if (offset >= 0 && block < this.end) binding.failed(handle, offset, this._peer(peer), lacks, now)
+  }
+
+  /**
+   * Withdraw a request or hedge that was not issued; the block is requeued
+   * unless another copy is in flight
+   * @param {number} block
+   * @param {string} peer
+   */
+  release(block, peer) {
+    const handle = this._scheduler()
+    const offset = this._block(block)
+    const index = this._peer(peer)
+    if (offset >= 0 && block < this.end && index !== -1) binding.release(handle, offset, index)
+  }
+
+  /**
+   * Requests, hedges and cancels to issue now
+   * @param {number} [now]
+   * @returns {Array<{type: 'request'|'hedge'|'cancel', block: number, peer: string}>}
+   */
+  poll(now = Date.now()) {
+    const handle = this._scheduler()
+    const out = []
+    const actions = this._actions
+    let rows
+    do {
+      rows = binding.poll(handle, now, actions)
+      for (let r = 0; r < rows; r++) {
+        const base = r * ACTION_WIDTH
+        out.push({
+          type: ACTIONS[actions[base]],
+          block: actions[base + 1] + this.start,
+          peer: this._peers.keys[actions[base + 2]]
+        })
+      }
+    } while (rows === actions.length / ACTION_WIDTH)
+    return out
+  }
+
+  /** Blocks neither present nor received yet */
+  get missing() {
+    return binding.stats(this._scheduler()).missing
+  }
+
+  /**
+   * @returns {{missing: number, inflight: number, peers: number, requests: number, hedges: number, hedgeWins: number, cancels: number, preemptions: number, received: number, late: number, failures: number, memory: number}}
+   */
+  stats() {
+    return binding.stats(this._scheduler())
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+  }
+}
+
+module.exports = { BlockScheduler }
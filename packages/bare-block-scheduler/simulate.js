@@ -0,0 +1,204 @@
+/**
+ * Playback simulator for bare-block-scheduler tests and benchmarks.
+ *
+ * Simulated peers have a bandwidth (bytes/s), a one-way latency (ms) and
+ * optionally a time after which they stop serving. Each serves its queue
+ * in order: a request reaches the peer after one latency, waits for the
+ * blocks ahead of it, takes bytes / bandwidth to send and arrives one
+ * latency later. Requests cancelled before service starts are dropped.
+ *
+ * A player consumes one block every `blockMs` once the block under the
+ * playhead is present, and counts the time it spends waiting (stalls). A
+ * seek moves the playhead. A policy sees the playhead and buffer level
+ * every tick and returns request / hedge / cancel actions (see
+ * schedulerPolicy and inOrderPolicy).
+ */
+
+const TICK_MS = 5
+
+class SimPeer {
+  /**
+   * @param {string} key
+   * @param {Object} opts
+   * @param {number} opts.bandwidth - bytes/s
+   * @param {number} opts.latency - One-way ms
+   * @param {number} [opts.stallAt=Infinity] - Stops serving at this time
+   */
+  constructor(key, opts) {
+    this.key = key
+    this.bandwidth = opts.bandwidth
+    this.latency = opts.latency
+    this.stallAt = opts.stallAt ?? Infinity
+    this.queue = [] // { block, arrive }
+    this.freeAt = 0
+    this.served = 0
+  }
+
+  send(block, now) {
+    this.queue.push({ block, arrive: now + this.latency })
+  }
+
+  cancel(block) {
+    const i = this.queue.findIndex((r) => r.block === block)
+    if (i !== -1) this.queue.splice(i, 1)
+  }
+
+  // Start every request that can start by `now`; returns deliveries
+  // { block, at } in order
+  serve(now, blockBytes) {
+    const out = []
+    while (this.queue.length > 0) {
+      const head = this.queue[0]
+      const start = Math.max(head.arrive, this.freeAt)
+      if (start > now || start >= this.stallAt) break
+      this.queue.shift()
+      this.freeAt = start + blockBytes / this.bandwidth * 1000
+      this.served++
+      out.push({ block: head.block, at: this.freeAt + this.latency })
+    }
+    return out
+  }
+}
+
+/**
+ * @param {Object} policy - { start(peers), step(now, next, bufferMs) -> actions, received(block, peer, bytes, now) }
+ * @param {Object} opts
+ * @param {number} opts.blocks
+ * @param {number} [opts.blockBytes=65536]
+ * @param {number} [opts.blockMs=64]
+ * @param {Array<{key: string, bandwidth: number, latency: number, stallAt?: number}>} opts.peers
+ * @param {{at: number, to: number}} [opts.seek]
+ * @param {number} [opts.limit=120000] - Give up after this much simulated time
+ * @returns {{finished: boolean, startupMs: number, stallMs: number, stalls: number, seekResumeMs: number, endedAt: number, served: Object<string, number>}}
+ */
+function simulate(policy, opts) {
+  const blocks = opts.blocks
+  const blockBytes = opts.blockBytes || 65536
+  const blockMs = opts.blockMs || 64
+  const limit = opts.limit || 120000
+  const peers = new Map(opts.peers.map((p) => [p.key, new SimPeer(p.key, p)]))
+  const have = new Uint8Array(blocks)
+  const inflight = [] // deliveries not yet arrived: { block, at, peer }
+
+  policy.start(opts.peers)
+
+  let position = 0 // media ms
+  let started = false
+  let startupMs = 0
+  let stallMs = 0
+  let stalls = 0
+  let waiting = false
+  let seekAt = -1
+  let seekResumeMs = 0
+
+  let now = 0
+  for (; now <= limit; now += TICK_MS) {
+    if (opts.seek && seekAt === -1 && now >= opts.seek.at) {
+      position = opts.seek.to * blockMs
+      seekAt = now
+    }
+
+    // Serve and deliver
+    for (const peer of peers.values()) {
+      for (const d of peer.serve(now, blockBytes)) inflight.push({ ...d, peer: peer.key })
+    }
+    for (let i = inflight.length - 1; i >= 0; i--) {
+      const d = inflight[i]
+      if (d.at > now) continue
+      inflight.splice(i, 1)
+      if (!have[d.block]) have[d.block] = 1
+      policy.received(d.block, d.peer, blockBytes, d.at)
+    }
+
+    // Play
+    const block = Math.floor(position / blockMs)
+    if (block >= blocks) break
+    if (have[block]) {
+      if (!started) {
+        started = true
+        startupMs = now
+      }
+      if (seekAt !== -1 && seekResumeMs === 0 && now > seekAt) seekResumeMs = now - seekAt
+      waiting = false
+      position += TICK_MS
+    } else if (started) {
+      if (!waiting) stalls++
+      waiting = true
+      stallMs += TICK_MS
+    }
+
+    let next = Math.min(blocks, Math.floor(position / blockMs))
+    while (next < blocks && have[next]) next++
+    const bufferMs = Math.max(0, next * blockMs - position)
+
+    for (const a of policy.step(now, next, bufferMs)) {
+      const peer = peers.get(a.peer)
+      if (!peer) continue
+      if (a.type === 'cancel') peer.cancel(a.block)
+      else peer.send(a.block, now)
+    }
+  }
+
+  const served = {}
+  for (const peer of peers.values()) served[peer.key] = peer.served
+  return { finished: now <= limit, startupMs, stallMs, stalls, seekResumeMs, endedAt: now, served }
+}
+
+/**
+ * Drive a BlockScheduler. Peers are added with their transport round trip
+ * (as UDX reports it) and no throughput estimate, which is learnt.
+ */
+function schedulerPolicy(BlockScheduler, opts) {
+  let scheduler = null
+  return {
+    get scheduler() {
+      return scheduler
+    },
+    start(peers) {
+      scheduler = new BlockScheduler({ end: opts.blocks, blockBytes: opts.blockBytes || 65536, blockMs: opts.blockMs || 64, ...opts.scheduler })
+      for (const p of peers) scheduler.addPeer(p.key, { rtt: 2 * p.latency })
+    },
+    step(now, next, bufferMs) {
+      scheduler.playhead(next, bufferMs, now)
+      return scheduler.poll(now)
+    },
+    received(block, peer, bytes, now) {
+      scheduler.received(block, peer, bytes, now)
+    }
+  }
+}
+
+/**
+ * The reader-order baseline: a fixed window of requests ahead of the
+ * playhead, spread round-robin over peers, never re-requested.
+ */
+function inOrderPolicy(opts) {
+  const window = opts.window || 8
+  const requested = new Uint8Array(opts.blocks)
+  const have = new Uint8Array(opts.blocks)
+  let keys = []
+  let turn = 0
+  let outstanding = 0
+  return {
+    start(peers) {
+      keys = peers.map((p) => p.key)
+    },
+    step(now, next) {
+      const out = []
+      for (let b = next; b < opts.blocks && outstanding < window; b++) {
+        if (requested[b]) continue
+        requested[b] = 1
+        outstanding++
+        out.push({ type: 'request', block: b, peer: keys[turn++ % keys.length] })
+      }
+      return out
+    },
+    received(block) {
+      if (have[block]) return
+      have[block] = 1
+      if (requested[block]) outstanding--
+    }
+  }
+}
+
+module.exports = { simulate, schedulerPolicy, inOrderPolicy, SimPeer }
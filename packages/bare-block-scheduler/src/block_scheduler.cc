@@ -0,0 +1,468 @@
+#include "block_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bare_block_scheduler {
+
+namespace {
+
+// Peers are interned densely on the JS side; this bounds a bad index
+constexpr uint32_t max_peer = 1 << 16;
+
+// Missing blocks examined per poll, at most
+constexpr size_t max_scan = 4096;
+
+// Floor for throughput estimates (bytes/ms), so an unproven or penalised
+// peer still gets a finite expected completion
+constexpr double min_throughput = 1e-3;
+
+// Backoff after a transient failure, doubling per failure of the block
+constexpr double retry_base_ms = 250;
+constexpr double retry_max_ms = 8000;
+
+inline bool
+bit(const std::vector<uint64_t> &bits, uint32_t i) {
+  size_t w = i >> 6;
+  return w < bits.size() && (bits[w] >> (i & 63)) & 1;
+}
+
+inline void
+set_bit(std::vector<uint64_t> &bits, uint32_t i, bool value) {
+  uint64_t mask = uint64_t(1) << (i & 63);
+  if (value) bits[i >> 6] |= mask;
+  else bits[i >> 6] &= ~mask;
+}
+
+// First clear bit at or after `from`, or none
+uint32_t
+find_clear_up(const std::vector<uint64_t> &bits, uint32_t from) {
+  for (size_t w = from >> 6; w < bits.size(); w++) {
+    uint64_t word = ~bits[w];
+    if (w == (from >> 6)) word &= ~uint64_t(0) << (from & 63);
+    if (word) return uint32_t(w * 64 + __builtin_ctzll(word));
+  }
+  return none;
+}
+
+// Last clear bit at or before `from`, or none
+uint32_t
+find_clear_down(const std::vector<uint64_t> &bits, uint32_t from) {
+  if (from == none) return none;
+  for (size_t w = (from >> 6) + 1; w-- > 0;) {
+    uint64_t word = ~bits[w];
+    if (w == (from >> 6) && (from & 63) != 63) word &= (uint64_t(1) << ((from & 63) + 1)) - 1;
+    if (word) return uint32_t(w * 64 + 63 - __builtin_clzll(word));
+  }
+  return none;
+}
+
+} // namespace
+
+void
+BlockScheduler::writer_t::push(uint32_t action, uint32_t block, uint32_t peer) {
+  uint32_t *row = out + rows * action_width;
+  row[0] = action;
+  row[1] = block;
+  row[2] = peer;
+  rows++;
+}
+
+BlockScheduler::BlockScheduler(const config_t &config) : config_(config), missing_(config.blocks) {
+  size_t words = (size_t(config_.blocks) + 63) / 64;
+  have_.assign(words, 0);
+  busy_.assign(words, 0);
+  waiting_.assign(words, 0);
+  copies_.assign(config_.blocks, 0);
+
+  // Bits past the last block read as busy so scans never return them
+  if (config_.blocks & 63) busy_[words - 1] = ~uint64_t(0) << (config_.blocks & 63);
+}
+
+peer_t *
+BlockScheduler::peer(uint32_t index) {
+  if (index >= peers_.size() || !peers_[index].live) return nullptr;
+  return &peers_[index];
+}
+
+bool
+BlockScheduler::has(uint32_t block) const {
+  return bit(have_, block);
+}
+
+bool
+BlockScheduler::lacks(const peer_t &p, uint32_t block) const {
+  return bit(p.lacks, block);
+}
+
+double
+BlockScheduler::deadline(uint32_t block) const {
+  double slots = block >= next_ ? double(block - next_) : double(config_.blocks - 1 - block);
+  return playhead_time_ + buffer_ms_ + slots * config_.block_ms;
+}
+
+uint32_t
+BlockScheduler::next_candidate(uint32_t block) const {
+  uint32_t blocks = config_.blocks;
+  if (block == none || block >= next_) {
+    uint32_t from = block == none ? next_ : block + 1;
+    if (from < blocks) {
+      uint32_t found = find_clear_up(busy_, from);
+      if (found != none && found < blocks) return found;
+    }
+    return next_ == 0 ? none : find_clear_down(busy_, next_ - 1);
+  }
+  return block == 0 ? none : find_clear_down(busy_, block - 1);
+}
+
+double
+BlockScheduler::expected(const peer_t &p, double now) const {
+  double throughput = std::max(p.throughput, min_throughput);
+  return now + p.rtt + (p.inflight_bytes + config_.block_bytes) / throughput;
+}
+
+uint32_t
+BlockScheduler::capacity(const peer_t &p) const {
+  // Enough requests to cover the bandwidth-delay product, plus slack for
+  // response jitter
+  double bdp = p.throughput * p.rtt / config_.block_bytes;
+  double cap = std::ceil(bdp) + 2;
+  return uint32_t(std::min(cap, double(config_.max_inflight)));
+}
+
+void
+BlockScheduler::best(uint32_t block, uint32_t exclude, double now, uint32_t &free, uint32_t &any) const {
+  free = none;
+  any = none;
+  double free_at = 0, any_at = 0;
+  for (uint32_t i = 0; i < peers_.size(); i++) {
+    const peer_t &p = peers_[i];
+    if (!p.live || i == exclude || lacks(p, block)) continue;
+    double at = expected(p, now);
+    if (any == none || at < any_at) {
+      any = i;
+      any_at = at;
+    }
+    if (p.inflight < capacity(p) && (free == none || at < free_at)) {
+      free = i;
+      free_at = at;
+    }
+  }
+}
+
+void
+BlockScheduler::assign(uint32_t block, uint32_t index, double now, bool hedge, writer_t &w) {
+  peer_t &p = peers_[index];
+  request_t r;
+  r.block = block;
+  r.peer = index;
+  r.sent = now;
+  r.expected = expected(p, now);
+  r.hedge = hedge;
+  r.hedged = false;
+  requests_.push_back(r);
+
+  p.inflight++;
+  p.inflight_bytes += config_.block_bytes;
+  copies_[block]++;
+  set_bit(busy_, block, true);
+
+  if (hedge) stats_.hedges++;
+  else stats_.requests++;
+  w.push(hedge ? action_hedge : action_request, block, index);
+}
+
+void
+BlockScheduler::drop(size_t i) {
+  request_t r = requests_[i];
+  requests_[i] = requests_.back();
+  requests_.pop_back();
+
+  if (peer_t *p = peer(r.peer)) {
+    p->inflight--;
+    p->inflight_bytes = std::max(0.0, p->inflight_bytes - config_.block_bytes);
+  }
+  copies_[r.block]--;
+  settle(r.block);
+}
+
+void
+BlockScheduler::settle(uint32_t block) {
+  set_bit(busy_, block, has(block) || copies_[block] > 0 || bit(waiting_, block));
+}
+
+uint32_t
+BlockScheduler::preempt(uint32_t block, double now, writer_t &w) {
+  if (w.rows + 2 > w.max) return none;
+
+  double due = deadline(block);
+  size_t victim = requests_.size();
+  double victim_due = std::max(due, now + config_.urgent_ms);
+  for (size_t i = 0; i < requests_.size(); i++) {
+    const request_t &r = requests_[i];
+    if (copies_[r.block] > 1) continue;
+    double d = deadline(r.block);
+    if (d <= victim_due || lacks(peers_[r.peer], block)) continue;
+    victim = i;
+    victim_due = d;
+  }
+  if (victim == requests_.size()) return none;
+
+  request_t r = requests_[victim];
+  drop(victim);
+  stats_.cancels++;
+  stats_.preemptions++;
+  w.push(action_cancel, r.block, r.peer);
+  return r.peer;
+}
+
+void
+BlockScheduler::set_peer(uint32_t index, double throughput, double rtt) {
+  if (index >= max_peer) return;
+  if (index >= peers_.size()) peers_.resize(index + 1);
+  peer_t &p = peers_[index];
+  if (!p.live) {
+    p = peer_t();
+    p.live = true;
+  }
+  if (throughput > 0) p.throughput = throughput / 1000;
+  if (rtt > 0) p.rtt = rtt;
+}
+
+void
+BlockScheduler::remove_peer(uint32_t index) {
+  if (!peer(index)) return;
+  for (size_t i = requests_.size(); i-- > 0;) {
+    if (requests_[i].peer == index) drop(i);
+  }
+  cancels_.erase(
+    std::remove_if(cancels_.begin(), cancels_.end(), [&](const request_t &r) { return r.peer == index; }),
+    cancels_.end()
+  );
+  peers_[index] = peer_t();
+}
+
+void
+BlockScheduler::set_lacks(uint32_t index, uint32_t start, uint32_t end, bool value) {
+  peer_t *p = peer(index);
+  if (!p) return;
+  end = std::min(end, config_.blocks);
+  if (start >= end) return;
+  if (p->lacks.empty()) {
+    if (!value) return;
+    p->lacks.assign(have_.size(), 0);
+  }
+  for (uint32_t i = start; i < end; i++) set_bit(p->lacks, i, value);
+}
+
+void
+BlockScheduler::playhead(uint32_t next, double buffer_ms, double now) {
+  next_ = std::min(next, config_.blocks);
+  buffer_ms_ = std::max(0.0, buffer_ms);
+  playhead_time_ = now;
+}
+
+void
+BlockScheduler::have(uint32_t block) {
+  received(block, none, 0, -std::numeric_limits<double>::infinity());
+}
+
+void
+BlockScheduler::received(uint32_t block, uint32_t index, double bytes, double now) {
+  if (block >= config_.blocks || has(block)) return;
+
+  set_bit(have_, block, true);
+  set_bit(busy_, block, true);
+  missing_--;
+
+  if (bit(waiting_, block) || !retries_.empty()) {
+    set_bit(waiting_, block, false);
+    retries_.erase(
+      std::remove_if(retries_.begin(), retries_.end(), [&](const retry_t &r) { return r.block == block; }),
+      retries_.end()
+    );
+  }
+  if (std::isfinite(now)) {
+    stats_.received++;
+    if (now > deadline(block)) stats_.late++;
+  }
+
+  // The request made to the delivering peer, or else the earliest one for
+  // the block: the transport may pick its own peer
+  double sent = std::numeric_limits<double>::infinity();
+  bool matched = false, hedge_win = false;
+  for (const request_t &r : requests_) {
+    if (r.block != block || matched) continue;
+    if (r.peer == index) {
+      matched = true;
+      hedge_win = r.hedge;
+      sent = r.sent;
+    } else {
+      sent = std::min(sent, r.sent);
+    }
+  }
+
+  peer_t *p = peer(index);
+  if (p && std::isfinite(sent)) {
+    // Time since the later of the earliest possible response and the
+    // previous delivery: the service time of this block when requests are
+    // pipelined
+    double start = std::max(sent + p->rtt, p->last_delivery);
+    double sample = bytes / std::max(1.0, now - start);
+    double a = config_.throughput_alpha;
+    p->throughput = p->throughput > 0 ? (1 - a) * p->throughput + a * sample : sample;
+    p->last_delivery = now;
+  }
+  if (hedge_win) stats_.hedge_wins++;
+
+  for (size_t i = requests_.size(); i-- > 0;) {
+    const request_t r = requests_[i];
+    if (r.block != block) continue;
+    if (r.peer != index) {
+      cancels_.push_back(r);
+      stats_.cancels++;
+    }
+    drop(i);
+  }
+}
+
+void
+BlockScheduler::failed(uint32_t block, uint32_t index, bool lacks, double now) {
+  if (block >= config_.blocks || has(block)) return;
+
+  for (size_t i = requests_.size(); i-- > 0;) {
+    if (requests_[i].block != block || requests_[i].peer != index) continue;
+    drop(i);
+    stats_.failures++;
+
+    peer_t &p = peers_[index];
+    p.failures++;
+    p.throughput /= 2;
+    break;
+  }
+
+  if (lacks) {
+    set_lacks(index, block, block + 1, true);
+    return;
+  }
+
+  auto it = std::find_if(retries_.begin(), retries_.end(), [&](const retry_t &r) { return r.block == block; });
+  if (it == retries_.end()) it = retries_.insert(retries_.end(), retry_t{block, 0, 0, false});
+  it->attempts++;
+  it->at = now + std::min(retry_max_ms, retry_base_ms * std::ldexp(1.0, int(std::min(it->attempts, 16u)) - 1));
+  it->waiting = true;
+  set_bit(waiting_, block, true);
+  set_bit(busy_, block, true);
+}
+
+void
+BlockScheduler::release(uint32_t block, uint32_t index) {
+  for (size_t i = requests_.size(); i-- > 0;) {
+    if (requests_[i].block != block || requests_[i].peer != index) continue;
+    if (requests_[i].hedge) stats_.hedges--;
+    else stats_.requests--;
+    drop(i);
+    return;
+  }
+}
+
+size_t
+BlockScheduler::poll(double now, uint32_t *out, size_t max_actions) {
+  writer_t w{out, max_actions};
+
+  // Cancels of losing copies
+  size_t emitted = 0;
+  while (emitted < cancels_.size() && !w.full()) {
+    const request_t &r = cancels_[emitted++];
+    w.push(action_cancel, r.block, r.peer);
+  }
+  cancels_.erase(cancels_.begin(), cancels_.begin() + emitted);
+
+  // Blocks whose backoff has run out are requestable again
+  for (retry_t &r : retries_) {
+    if (!r.waiting || r.at > now) continue;
+    r.waiting = false;
+    set_bit(waiting_, r.block, false);
+    settle(r.block);
+  }
+
+  // Hedge overdue requests for blocks due soon, most urgent first
+  std::vector<size_t> overdue;
+  for (size_t i = 0; i < requests_.size(); i++) {
+    const request_t &r = requests_[i];
+    if (r.hedge || r.hedged || copies_[r.block] > 1) continue;
+    if (deadline(r.block) - now > config_.urgent_ms) continue;
+    double limit = std::max(config_.hedge_min_ms, config_.hedge_factor * (r.expected - r.sent));
+    if (now - r.sent > limit) overdue.push_back(i);
+  }
+  std::sort(overdue.begin(), overdue.end(), [&](size_t a, size_t b) {
+    return requests_[a].block == requests_[b].block ? a < b : deadline(requests_[a].block) < deadline(requests_[b].block);
+  });
+  for (size_t i : overdue) {
+    if (w.full()) break;
+    uint32_t slow = requests_[i].peer;
+    uint32_t free, any;
+    best(requests_[i].block, slow, now, free, any);
+    if (free == none) continue;
+
+    requests_[i].hedged = true;
+    peer_t &p = peers_[slow];
+    if (now - p.penalized >= config_.hedge_min_ms) {
+      p.throughput /= 2;
+      p.penalized = now;
+    }
+    assign(requests_[i].block, free, now, true, w);
+  }
+
+  // New requests in deadline order
+  size_t scanned = 0;
+  for (uint32_t block = next_candidate(none); block != none && !w.full() && scanned < max_scan; scanned++) {
+    double due = deadline(block);
+    if (due - now > config_.lookahead_ms) break;
+
+    uint32_t free, any;
+    best(block, none, now, free, any);
+
+    if (free != none) {
+      // Leave the block for a busy faster peer if this one would miss the
+      // deadline anyway; a later block may still suit it
+      if (free == any || expected(peers_[free], now) <= due) assign(block, free, now, false, w);
+    } else if (any != none && due - now <= config_.urgent_ms) {
+      uint32_t freed = preempt(block, now, w);
+      if (freed != none) assign(block, freed, now, false, w);
+    } else if (any != none) {
+      // Every capable peer is full and nothing later can preempt
+      bool open = false;
+      for (const peer_t &p : peers_) {
+        if (p.live && p.inflight < capacity(p)) open = true;
+      }
+      if (!open) break;
+    }
+
+    block = next_candidate(block);
+  }
+
+  return w.rows;
+}
+
+size_t
+BlockScheduler::peers() const {
+  size_t n = 0;
+  for (const peer_t &p : peers_) n += p.live;
+  return n;
+}
+
+size_t
+BlockScheduler::memory_usage() const {
+  size_t bytes = sizeof(*this);
+  bytes += peers_.capacity() * sizeof(peer_t);
+  for (const peer_t &p : peers_) bytes += p.lacks.capacity() * sizeof(uint64_t);
+  bytes += requests_.capacity() * sizeof(request_t);
+  bytes += cancels_.capacity() * sizeof(request_t);
+  bytes += retries_.capacity() * sizeof(retry_t);
+  bytes += (have_.capacity() + busy_.capacity() + waiting_.capacity()) * sizeof(uint64_t);
+  bytes += copies_.capacity();
+  return bytes;
+}
+
+} // namespace bare_block_scheduler
@@ -0,0 +1,213 @@
+/**
+ * Deadline scheduler for playback block fetches.
+ *
+ * A video is a range of `blocks` blocks (offsets 0..blocks-1). The player
+ * reports the next block it will read and how much media it has buffered;
+ * every missing block then has a deadline:
+ *
+ *   ahead of the playhead:  buffer + (block - next) * block_ms
+ *   behind it:              after every block ahead, nearest first
+ *
+ * poll() walks missing blocks in deadline order (earliest deadline first)
+ * and hands each to the peer with the earliest expected completion,
+ *
+ *   now + rtt + (bytes in flight at the peer + block bytes) / throughput
+ *
+ * Each peer can have up to about a bandwidth-delay product of requests in
+ * flight. Peer throughput is learnt from deliveries, using the time between
+ * successive responses so that pipelined requests are not undercounted.
+ *
+ * Requests that run well past their expected completion are hedged to
+ * another peer when the block is due soon, and the slow peer's throughput
+ * estimate is halved. If an urgent block finds every capable peer full (for
+ * example after a seek), the in-flight request with the latest non-urgent
+ * deadline is cancelled to make room. Whichever copy of a block arrives
+ * first wins, and the others are cancelled.
+ *
+ * A failed request either marks the block missing at that peer or, for
+ * transient failures (timeouts, dropped connections), holds the block back
+ * for a backoff that doubles with every failure before it is handed out
+ * again.
+ *
+ * Times are ms on any monotonic clock supplied by the caller.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace bare_block_scheduler {
+
+constexpr uint32_t none = UINT32_MAX;
+
+// Action rows written by poll(): (action, block, peer)
+enum action_t : uint32_t {
+  action_request = 0,
+  action_hedge = 1,
+  action_cancel = 2,
+};
+
+constexpr size_t action_width = 3;
+
+struct config_t {
+  uint32_t blocks = 0;
+  // Expected bytes per block
+  double block_bytes = 65536;
+  // Media time covered by one block
+  double block_ms = 500;
+  // Requests in flight per peer, at most
+  uint32_t max_inflight = 16;
+  // Only blocks due within this long are requested
+  double lookahead_ms = std::numeric_limits<double>::infinity();
+  // Blocks due within this long may be hedged and may preempt others
+  double urgent_ms = 5000;
+  // A request is overdue after max(hedge_min_ms, hedge_factor * expected)
+  double hedge_factor = 2;
+  double hedge_min_ms = 250;
+  // Weight of a new throughput sample
+  double throughput_alpha = 0.3;
+};
+
+struct peer_t {
+  bool live = false;
+  double throughput = 0; // bytes/ms
+  double rtt = 0;        // ms
+  uint32_t inflight = 0;
+  double inflight_bytes = 0;
+  double last_delivery = 0;
+  uint32_t failures = 0;
+  // Last time the throughput estimate was cut for an overdue request
+  double penalized = -std::numeric_limits<double>::infinity();
+  // Bitset of blocks the peer does not have; empty while it has them all
+  std::vector<uint64_t> lacks;
+};
+
+struct request_t {
+  uint32_t block;
+  uint32_t peer;
+  double sent;
+  double expected; // expected completion time
+  bool hedge;      // a second copy of an overdue request
+  bool hedged;     // this request has been hedged
+};
+
+struct stats_t {
+  uint64_t requests = 0;
+  uint64_t hedges = 0;
+  uint64_t hedge_wins = 0; // blocks whose hedge arrived first
+  uint64_t cancels = 0;
+  uint64_t preemptions = 0;
+  uint64_t received = 0;
+  uint64_t late = 0; // blocks that arrived after their deadline
+  uint64_t failures = 0;
+};
+
+struct retry_t {
+  uint32_t block;
+  uint32_t attempts;
+  double at;    // when the block may be requested again
+  bool waiting; // held back until `at`
+};
+
+class BlockScheduler {
+public:
+  explicit BlockScheduler(const config_t &config);
+
+  // Add a peer or update its estimates; throughput in bytes/s. A zero keeps
+  // the current (learnt) value.
+  void set_peer(uint32_t peer, double throughput, double rtt);
+
+  // Forget a peer; its requests are dropped without cancel actions
+  void remove_peer(uint32_t peer);
+
+  // Mark blocks [start, end) as missing (or present) at a peer
+  void set_lacks(uint32_t peer, uint32_t start, uint32_t end, bool lacks);
+
+  void playhead(uint32_t next, double buffer_ms, double now);
+
+  // A block became available without a scheduled delivery (local hit)
+  void have(uint32_t block);
+
+  // A block arrived; `peer` may be none or a peer it was not requested from
+  void received(uint32_t block, uint32_t peer, double bytes, double now);
+
+  // A request failed. With `lacks` the peer is taken not to have the block;
+  // otherwise the block is retried after a backoff. Other copies of the
+  // block stay in flight.
+  void failed(uint32_t block, uint32_t peer, bool lacks, double now);
+
+  // Withdraw a request the caller did not issue (say, a hedge its transport
+  // cannot place); no cancel is emitted and the peer is not penalised
+  void release(uint32_t block, uint32_t peer);
+
+  // Write up to `max_actions` rows of action_width uint32s; returns rows
+  size_t poll(double now, uint32_t *out, size_t max_actions);
+
+  uint32_t missing() const { return missing_; }
+
+  size_t inflight() const { return requests_.size(); }
+
+  size_t peers() const;
+
+  const stats_t &stats() const { return stats_; }
+
+  size_t memory_usage() const;
+
+private:
+  struct writer_t {
+    uint32_t *out;
+    size_t max;
+    size_t rows = 0;
+
+    bool full() const { return rows >= max; }
+    void push(uint32_t action, uint32_t block, uint32_t peer);
+  };
+
+  peer_t *peer(uint32_t index);
+
+  bool has(uint32_t block) const;
+  bool lacks(const peer_t &p, uint32_t block) const;
+
+  double deadline(uint32_t block) const;
+
+  // Next busy-free block in deadline order after `block` (none at the end);
+  // start with none
+  uint32_t next_candidate(uint32_t block) const;
+
+  double expected(const peer_t &p, double now) const;
+  uint32_t capacity(const peer_t &p) const;
+
+  // Best peer for a block: earliest expected completion among peers with
+  // free capacity (`free`), and among all capable peers (`any`)
+  void best(uint32_t block, uint32_t exclude, double now, uint32_t &free, uint32_t &any) const;
+
+  void assign(uint32_t block, uint32_t peer, double now, bool hedge, writer_t &w);
+  void drop(size_t request);
+  void settle(uint32_t block);
+  // Cancel the latest-deadline, non-urgent request at a peer able to serve
+  // `block`; returns that peer, or none
+  uint32_t preempt(uint32_t block, double now, writer_t &w);
+
+  config_t config_;
+  std::vector<peer_t> peers_;
+  std::vector<request_t> requests_;
+  // Per block: present; present or in flight; copies in flight
+  std::vector<uint64_t> have_;
+  std::vector<uint64_t> busy_;
+  std::vector<uint8_t> copies_;
+  // Cancels produced outside poll(), emitted by the next one
+  std::vector<request_t> cancels_;
+  // Blocks that failed transiently, and the ones held back for a backoff
+  std::vector<retry_t> retries_;
+  std::vector<uint64_t> waiting_;
+  uint32_t missing_;
+  uint32_t next_ = 0;
+  double buffer_ms_ = 0;
+  double playhead_time_ = 0;
+  stats_t stats_;
+};
+
+} // namespace bare_block_scheduler
@@ -0,0 +1,185 @@
+/**
+ * Simple test for bare-block-scheduler addon
+ * Checks deadline order, peer assignment and hedging directly, then plays
+ * videos against simulated peers (simulate.js) and compares stalls with the
+ * reader-order baseline.
+ */
+
+const { BlockScheduler } = require('./index')
+const { simulate, schedulerPolicy, inOrderPolicy } = require('./simulate')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+function ok(label, value, detail = '') {
+  if (!value) throw new Error(`${label} failed ${detail}`)
+  console.log('ok -', label, detail)
+}
+
+const blocksOf = (actions, type = 'request') => actions.filter((a) => a.type === type).map((a) => a.block)
+
+// Deadline order: ahead of the playhead first, then behind it nearest first
+{
+  // 1 MB/s x 100 ms is 1.5 blocks in flight, so 4 requests with slack
+  const s = new BlockScheduler({ start: 1000, end: 1010, blockMs: 100 })
+  s.addPeer('a', { throughput: 1e6, rtt: 100 })
+  s.playhead(1008, 0, 0)
+  check('ahead, then behind nearest first', blocksOf(s.poll(0)), [1008, 1009, 1007, 1006])
+
+  s.received(1008, 'a', 65536, 200)
+  check('next after a delivery', blocksOf(s.poll(200)), [1005])
+  check('inflight', s.stats().inflight, 4)
+
+  s.playhead(1000, 0, 210)
+  s.received(1009, 'a', 65536, 300)
+  check('after a seek back', blocksOf(s.poll(300)), [1000])
+  s.destroy()
+}
+
+// Peer choice: earliest expected completion, never a peer lacking the block
+{
+  const s = new BlockScheduler({ end: 100, blockMs: 100 })
+  s.addPeer('fast', { throughput: 4e6, rtt: 20 })
+  s.addPeer('slow', { throughput: 2e5, rtt: 200 })
+  s.playhead(0, 0, 0)
+  const first = s.poll(0).filter((a) => a.type === 'request')
+  check('most urgent block to the fast peer', first[0].peer, 'fast')
+  ok('slow peer only gets blocks it can deliver in time', first.filter((a) => a.peer === 'slow').every((a) => a.block >= 4))
+
+  const t = new BlockScheduler({ end: 20, blockMs: 100 })
+  t.addPeer('a', { throughput: 4e6, rtt: 20 })
+  t.addPeer('b', { throughput: 1e6, rtt: 40 })
+  t.lacks('a', 0, 5)
+  t.playhead(0, 0, 0)
+  ok('lacked blocks go elsewhere', t.poll(0).every((a) => a.block >= 5 || a.peer === 'b'))
+
+  // A failure the peer reports as lacking requeues the block elsewhere
+  t.failed(5, 'a', true)
+  check('failure counted', t.stats().failures, 1)
+  for (const block of [0, 1, 2]) t.received(block, 'b', 65536, 150)
+  const retry = t.poll(150).find((a) => a.block === 5)
+  check('failed block retried elsewhere', retry && retry.peer, 'b')
+
+  // Removing a peer requeues its blocks
+  t.removePeer('b')
+  check('removed peer requests dropped', t.stats().peers, 1)
+  ok('blocks requeued to remaining peer', t.poll(160).every((a) => a.peer === 'a' && a.block >= 5))
+  s.destroy()
+  t.destroy()
+}
+
+// Hedging: overdue requests for urgent blocks get a second copy elsewhere,
+// and the losing copy is cancelled
+{
+  const s = new BlockScheduler({ end: 50, blockMs: 100 })
+  s.addPeer('a', { throughput: 1e6, rtt: 20 })
+  s.playhead(0, 0, 0)
+  check('first requests', blocksOf(s.poll(0)), [0, 1, 2])
+
+  s.addPeer('b', { throughput: 1e6, rtt: 20 })
+  s.playhead(0, 0, 1000)
+  const actions = s.poll(1000)
+  check('overdue blocks hedged to the other peer', actions.filter((a) => a.type === 'hedge').map((a) => [a.block, a.peer]), [[0, 'b'], [1, 'b'], [2, 'b']])
+
+  // A hedge the caller could not place is withdrawn without a cancel
+  s.release(2, 'b')
+  check('released hedge uncounted', [s.stats().hedges, s.stats().inflight], [2, 5])
+
+  s.received(0, 'b', 65536, 1050)
+  check('losing copy cancelled', s.poll(1050).filter((a) => a.type === 'cancel').map((a) => [a.block, a.peer]), [[0, 'a']])
+  check('hedge win', s.stats().hedgeWins, 1)
+  s.destroy()
+}
+
+// Transient failures back off and retry, even with a single peer
+{
+  const s = new BlockScheduler({ end: 3, blockMs: 100 })
+  s.addPeer('a', { throughput: 1e6, rtt: 20 })
+  s.playhead(0, 0, 0)
+  check('all requested', blocksOf(s.poll(0)), [0, 1, 2])
+
+  s.failed(1, 'a', false, 10)
+  s.received(0, 'a', 65536, 50)
+  s.received(2, 'a', 65536, 60)
+  check('held back during the backoff', blocksOf(s.poll(100)), [])
+  check('retried after it', blocksOf(s.poll(300)), [1])
+
+  s.failed(1, 'a', false, 300)
+  check('backoff doubles', blocksOf(s.poll(700)), [])
+  check('retried again', blocksOf(s.poll(800)), [1])
+
+  s.received(1, 'a', 65536, 850)
+  check('complete after failures', [s.missing, s.stats().inflight, s.stats().failures], [0, 0, 2])
+  s.destroy()
+}
+
+// More actions than one output batch
+{
+  const s = new BlockScheduler({ end: 5000, blockMs: 100 })
+  for (let i = 0; i < 100; i++) s.addPeer(`p${i}`, { throughput: 5e6, rtt: 200 })
+  s.playhead(0, 0, 0)
+  const actions = s.poll(0)
+  check('16 per peer across batches', actions.length, 1600)
+  check('in block order', actions.every((a, i) => a.block === i), true)
+  s.destroy()
+}
+
+// Simulated playback: 400 blocks of 64 KiB at 1 MB/s (~26 s of media)
+const base = { blocks: 400, blockMs: 64 }
+
+function play(label, scenario) {
+  const policy = schedulerPolicy(BlockScheduler, base)
+  const scheduled = simulate(policy, { ...base, ...scenario })
+  const stats = policy.scheduler.stats()
+  policy.scheduler.destroy()
+  const baseline = simulate(inOrderPolicy(base), { ...base, ...scenario })
+  console.log(`# ${label}: stalled ${scheduled.stallMs} ms (baseline ${baseline.finished ? baseline.stallMs + ' ms' : 'did not finish'}), served ${JSON.stringify(scheduled.served)}`)
+  return { scheduled, baseline, stats }
+}
+
+// A fast and a slow peer: the slow one only gets what it can deliver in time
+{
+  const { scheduled, baseline } = play('fast + slow peer', {
+    peers: [{ key: 'fast', bandwidth: 3e6, latency: 15 }, { key: 'slow', bandwidth: 2.5e5, latency: 120 }]
+  })
+  ok('finished', scheduled.finished)
+  ok('stalls far less than reader order', scheduled.stallMs * 10 < baseline.stallMs, `${scheduled.stallMs} vs ${baseline.stallMs}`)
+  ok('fast peer serves most blocks', scheduled.served.fast > 0.85 * base.blocks)
+}
+
+// A peer stops serving mid-stream: its overdue requests are hedged
+{
+  const { scheduled, baseline, stats } = play('peer stops serving', {
+    peers: [{ key: 'a', bandwidth: 2e6, latency: 20, stallAt: 4000 }, { key: 'b', bandwidth: 1.5e6, latency: 40 }],
+    limit: 60000
+  })
+  ok('finished despite the dead peer', scheduled.finished)
+  ok('baseline waits forever', !baseline.finished)
+  ok('hedged', stats.hedges > 0 && stats.hedgeWins > 0, JSON.stringify(stats))
+  ok('hardly stalls', scheduled.stallMs < 500, `${scheduled.stallMs} ms`)
+}
+
+// Seeking: urgent blocks at the new position preempt far-ahead requests
+{
+  const { scheduled, baseline, stats } = play('seek', {
+    peers: [{ key: 'a', bandwidth: 1.2e6, latency: 30 }, { key: 'b', bandwidth: 1.2e6, latency: 50 }],
+    seek: { at: 3000, to: 300 }
+  })
+  ok('finished', scheduled.finished)
+  ok('preempted', stats.preemptions > 0)
+  ok('resumes faster than reader order', scheduled.seekResumeMs < baseline.seekResumeMs, `${scheduled.seekResumeMs} vs ${baseline.seekResumeMs} ms`)
+}
+
+{
+  const s = new BlockScheduler({ end: 1 })
+  s.destroy()
+  let threw = false
+  try { s.poll() } catch { threw = true }
+  check('destroyed scheduler throws', threw, true)
+}
+
+console.log('all tests passed')
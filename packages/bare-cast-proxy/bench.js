@@ -0,0 +1,109 @@
+/**
+ * Benchmark for bare-cast-proxy.
+ *
+ *   bare bench.js [streams...]
+ *
+ * Streams a 64 MB file from a local upstream to N concurrent clients
+ * (default 1 and 4) directly, through a JS proxy that pipes the way the
+ * worker's cast proxy does, and through the native proxy. Reports
+ * throughput and process CPU time per stream; the proxy's own share is the
+ * CPU above the direct run, since client and upstream share the process.
+ * The native proxy also reports its own thread's CPU time.
+ */
+
+const http = require('bare-http1')
+const os = require('bare-os')
+const { CastProxy } = require('./index')
+
+const SIZE = 64 * 1024 * 1024
+const media = Buffer.alloc(SIZE, 7)
+
+function cpuMs() {
+  const { user, system } = os.cpuUsage()
+  return (user + system) / 1000
+}
+
+function listen(server) {
+  return new Promise((resolve) => server.listen(0, '127.0.0.1', () => resolve(server.address().port)))
+}
+
+function fetchLength(port, path) {
+  return new Promise((resolve, reject) => {
+    const req = http.request({ method: 'GET', hostname: '127.0.0.1', port, path }, (res) => {
+      let length = 0
+      res.on('data', (chunk) => { length += chunk.byteLength })
+      res.on('end', () => resolve(length))
+      res.on('error', reject)
+    })
+    req.on('error', reject)
+    req.end()
+  })
+}
+
+// Pipes upstream responses with backpressure, like the worker's proxy
+function jsProxy(upstreamPort) {
+  return http.createServer((req, res) => {
+    const proxyReq = http.request({ method: 'GET', hostname: '127.0.0.1', port: upstreamPort, path: '/media', headers: {} }, (proxyRes) => {
+      res.statusCode = proxyRes.statusCode
+      for (const [key, value] of Object.entries(proxyRes.headers)) res.setHeader(key, value)
+      proxyRes.on('data', (chunk) => {
+        if (!res.write(chunk)) {
+          proxyRes.pause()
+          res.once('drain', () => proxyRes.resume())
+        }
+      })
+      proxyRes.on('end', () => res.end())
+    })
+    proxyReq.end()
+  })
+}
+
+async function run(label, port, path, streams, baseline, extra) {
+  const cpuStart = cpuMs()
+  const start = Date.now()
+  const lengths = await Promise.all(Array.from({ length: streams }, () => fetchLength(port, path)))
+  const ms = Date.now() - start
+  const cpu = cpuMs() - cpuStart
+  if (lengths.some((length) => length !== SIZE)) throw new Error(`${label}: short body`)
+
+  const mbps = (SIZE * streams) / 1048576 / (ms / 1000)
+  const perStream = cpu / streams
+  const proxyCpu = baseline === null ? '' : `, proxy ~${Math.max(0, perStream - baseline).toFixed(1)} ms`
+  console.log(`  ${label.padEnd(7)} ${mbps.toFixed(0).padStart(6)} MB/s   cpu ${perStream.toFixed(1)} ms/stream${proxyCpu}${extra ? extra() : ''}`)
+  return perStream
+}
+
+async function main() {
+  const upstream = http.createServer((req, res) => {
+    res.setHeader('Content-Type', 'video/mp4')
+    res.setHeader('Content-Length', SIZE)
+    res.end(media)
+  })
+  const upstreamPort = await listen(upstream)
+  const js = jsProxy(upstreamPort)
+  const jsPort = await listen(js)
+
+  const proxy = new CastProxy()
+  const nativePort = proxy.listen({ fallbackPort: jsPort, host: '127.0.0.1' })
+  proxy.addSession('bench', `http://127.0.0.1:${upstreamPort}/media`)
+
+  const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+  const counts = args.length > 0 ? args.map(Number) : [1, 4]
+
+  for (const streams of counts) {
+    console.log(`\n${streams} stream(s) of ${SIZE / 1048576} MB`)
+    const baseline = await run('direct', upstreamPort, '/media', streams, null)
+    await run('js', jsPort, '/media', streams, baseline)
+    const before = proxy.stats('bench')
+    await run('native', nativePort, '/cast/bench', streams, baseline, () => {
+      const after = proxy.stats('bench')
+      return `, proxy thread ${((after.cpuTime - before.cpuTime) / streams).toFixed(1)} ms`
+    })
+  }
+
+  proxy.destroy()
+  js.close()
+  upstream.close()
+}
+
+main()
@@ -0,0 +1,314 @@
+/**
+ * bare-cast-proxy - Bare native addon for the cast proxy
+ * Forwards cast receivers' media requests to local servers off the JS
+ * thread, with splice() forwarding and a per-session range cache
+ */
+
+#include <cstdint>
+#include <string>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/cast_proxy.h"
+
+using bare_cast_proxy::CastProxy;
+using bare_cast_proxy::options_t;
+using bare_cast_proxy::stats_t;
+
+// Handle wrapper for CastProxy
+typedef struct {
+  CastProxy *proxy;
+} bare_cast_proxy_t;
+
+static bare_cast_proxy_t *
+bare_cast_proxy__proxy(js_env_t *env, js_value_t *value) {
+  bare_cast_proxy_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->proxy) {
+    js_throw_error(env, NULL, "Cast proxy has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static bool
+bare_cast_proxy__string(js_env_t *env, js_value_t *value, std::string *out) {
+  size_t len;
+  int err = js_get_value_string_utf8(env, value, NULL, 0, &len);
+  if (err != 0) return false;
+
+  out->assign(len + 1, '\0');
+  err = js_get_value_string_utf8(env, value, (utf8_t *) &(*out)[0], len + 1, NULL);
+  if (err != 0) return false;
+
+  out->resize(len);
+  return true;
+}
+
+static js_value_t *
+bare_cast_proxy__stats(js_env_t *env, const stats_t &stats) {
+  int err;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("requests", stats.requests);
+  SET_NUMBER("cacheHits", stats.cache_hits);
+  SET_NUMBER("coalesced", stats.coalesced);
+  SET_NUMBER("fetches", stats.fetches);
+  SET_NUMBER("bytesOut", stats.bytes_out);
+  SET_NUMBER("bytesForwarded", stats.bytes_forwarded);
+  SET_NUMBER("bytesCached", stats.bytes_cached);
+  SET_NUMBER("bytesUpstream", stats.bytes_upstream);
+  SET_NUMBER("bytesTunnelled", stats.bytes_tunnelled);
+  SET_NUMBER("active", stats.active);
+  SET_NUMBER("cpuTime", stats.cpu_ns / 1e6);
+  SET_NUMBER("activeTime", stats.active_ns / 1e6);
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+// (chunkSize, cacheChunks, maxCachedRange)
+static js_value_t *
+bare_cast_proxy_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t chunk_size, cache_chunks, max_cached_range;
+  err = js_get_value_uint32(env, argv[0], &chunk_size);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[1], &cache_chunks);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &max_cached_range);
+  if (err != 0) return NULL;
+
+  options_t options;
+  options.chunk_size = chunk_size;
+  options.cache_chunks = cache_chunks;
+  options.max_cached_range = max_cached_range;
+
+  js_value_t *result;
+  bare_cast_proxy_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_cast_proxy_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->proxy = new CastProxy(options);
+  return result;
+}
+
+// (handle, host, port, fallbackHost, fallbackPort) -> bound port
+static js_value_t *
+bare_cast_proxy_listen(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string host, fallback_host;
+  int32_t port, fallback_port;
+  if (!bare_cast_proxy__string(env, argv[1], &host)) return NULL;
+  err = js_get_value_int32(env, argv[2], &port);
+  if (err != 0) return NULL;
+  if (!bare_cast_proxy__string(env, argv[3], &fallback_host)) return NULL;
+  err = js_get_value_int32(env, argv[4], &fallback_port);
+  if (err != 0) return NULL;
+
+  int bound = handle->proxy->listen(host, port, fallback_host, fallback_port);
+  if (bound < 0) {
+    js_throw_error(env, NULL, handle->proxy->error().c_str());
+    return NULL;
+  }
+
+  js_value_t *result;
+  err = js_create_int32(env, bound, &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+// (handle, token, host, port, pathname, search) -> false if host is not
+// an IPv4 address
+static js_value_t *
+bare_cast_proxy_add_session(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 6;
+  js_value_t *argv[6];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string token, host, pathname, search;
+  int32_t port;
+  if (!bare_cast_proxy__string(env, argv[1], &token)) return NULL;
+  if (!bare_cast_proxy__string(env, argv[2], &host)) return NULL;
+  err = js_get_value_int32(env, argv[3], &port);
+  if (err != 0) return NULL;
+  if (!bare_cast_proxy__string(env, argv[4], &pathname)) return NULL;
+  if (!bare_cast_proxy__string(env, argv[5], &search)) return NULL;
+
+  js_value_t *result;
+  err = js_get_boolean(env, handle->proxy->add_session(token, host, port, pathname, search), &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+static js_value_t *
+bare_cast_proxy_remove_session(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string token;
+  if (!bare_cast_proxy__string(env, argv[1], &token)) return NULL;
+
+  handle->proxy->remove_session(token);
+  return NULL;
+}
+
+// (handle, token) -> stats of the session, or null
+static js_value_t *
+bare_cast_proxy_session_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string token;
+  if (!bare_cast_proxy__string(env, argv[1], &token)) return NULL;
+
+  stats_t stats;
+  if (!handle->proxy->session_stats(token, &stats)) {
+    js_value_t *result;
+    err = js_get_null(env, &result);
+    if (err != 0) return NULL;
+    return result;
+  }
+
+  return bare_cast_proxy__stats(env, stats);
+}
+
+static js_value_t *
+bare_cast_proxy_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  js_value_t *result = bare_cast_proxy__stats(env, handle->proxy->stats());
+  if (result == NULL) return NULL;
+
+  js_value_t *sessions;
+  err = js_create_double(env, double(handle->proxy->sessions()), &sessions);
+  if (err != 0) return NULL;
+  js_set_named_property(env, result, "sessions", sessions);
+
+  return result;
+}
+
+static js_value_t *
+bare_cast_proxy_close(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle = bare_cast_proxy__proxy(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->proxy->close();
+  return NULL;
+}
+
+static js_value_t *
+bare_cast_proxy_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_cast_proxy_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->proxy;
+  handle->proxy = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_cast_proxy_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_cast_proxy_create);
+  EXPORT_FUNCTION(listen, bare_cast_proxy_listen);
+  EXPORT_FUNCTION(addSession, bare_cast_proxy_add_session);
+  EXPORT_FUNCTION(removeSession, bare_cast_proxy_remove_session);
+  EXPORT_FUNCTION(sessionStats, bare_cast_proxy_session_stats);
+  EXPORT_FUNCTION(stats, bare_cast_proxy_stats);
+  EXPORT_FUNCTION(close, bare_cast_proxy_close);
+  EXPORT_FUNCTION(destroy, bare_cast_proxy_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_cast_proxy, bare_cast_proxy_exports)
@@ -0,0 +1,127 @@
+/**
+ * bare-cast-proxy - Native proxy for cast receivers
+ * Serves /cast/<token>[/<path>] for sessions registered with addSession():
+ * streaming reads are forwarded with splice() on Linux (a buffer
+ * elsewhere), and small ranges such as container probes and seeks go
+ * through a per-session read-ahead cache that coalesces overlapping
+ * requests into one upstream fetch. The loop runs on its own thread.
+ * Any other request is passed to a fallback HTTP server unchanged.
+ */
+
+const binding = require('./binding')
+
+const DEFAULT_CHUNK_SIZE = 256 * 1024
+const DEFAULT_CACHE_CHUNKS = 16
+const DEFAULT_MAX_CACHED_RANGE = 1024 * 1024
+
+const LOCALHOSTS = new Set(['localhost', '127.0.0.1', '::1', '[::1]'])
+const IPV4 = /^\d{1,3}(\.\d{1,3}){3}$/
+
+function withRates(stats) {
+  const seconds = stats.activeTime / 1000
+  stats.throughput = seconds > 0 ? stats.bytesOut / seconds : 0
+  stats.cpuPercent = stats.activeTime > 0 ? (stats.cpuTime / stats.activeTime) * 100 : 0
+  return stats
+}
+
+class CastProxy {
+  /**
+   * @param {Object} [opts]
+   * @param {number} [opts.chunkSize=262144] - Read-ahead cache chunk in bytes
+   * @param {number} [opts.cacheChunks=16] - Cached chunks per session
+   * @param {number} [opts.maxCachedRange=1048576] - Largest range served
+   *   through the cache; larger ones are forwarded
+   */
+  constructor(opts = {}) {
+    this._handle = binding.create(
+      opts.chunkSize || DEFAULT_CHUNK_SIZE,
+      opts.cacheChunks || DEFAULT_CACHE_CHUNKS,
+      opts.maxCachedRange || DEFAULT_MAX_CACHED_RANGE
+    )
+    this.port = 0
+  }
+
+  _proxy() {
+    if (this._handle === null) throw new Error('Cast proxy has been destroyed')
+    return this._handle
+  }
+
+  /**
+   * Start serving
+   * @param {Object} opts
+   * @param {number} opts.fallbackPort - Port of the HTTP server that takes
+   *   every request the proxy does not serve
+   * @param {string} [opts.fallbackHost='127.0.0.1'] - Its IPv4 address
+   * @param {number} [opts.port=0] - Port to listen on (0: any)
+   * @param {string} [opts.host='0.0.0.0'] - IPv4 address to listen on
+   * @returns {number} The bound port
+   */
+  listen(opts) {
+    const { fallbackPort, fallbackHost = '127.0.0.1', port = 0, host = '0.0.0.0' } = opts
+    this.port = binding.listen(this._proxy(), host, port, fallbackHost, fallbackPort)
+    return this.port
+  }
+
+  /**
+   * Serve /cast/<token> from `url`; extra path segments resolve against
+   * its directory
+   * @param {string} token
+   * @param {string} url - http URL on localhost or an IPv4 address
+   * @returns {boolean} false if the URL cannot be served natively (the
+   *   request then goes to the fallback server)
+   */
+  addSession(token, url) {
+    const handle = this._proxy()
+    let target
+    try {
+      target = new URL(url)
+    } catch {
+      return false
+    }
+    if (target.protocol !== 'http:') return false
+    const host = LOCALHOSTS.has(target.hostname) ? '127.0.0.1' : target.hostname
+    if (!IPV4.test(host)) return false
+    return binding.addSession(handle, token, host, Number(target.port) || 80, target.pathname || '/', target.search || '')
+  }
+
+  /**
+   * @param {string} token
+   */
+  removeSession(token) {
+    binding.removeSession(this._proxy(), token)
+  }
+
+  /**
+   * Stats of one session, or of all requests served. cpuTime and
+   * activeTime are in ms; throughput is bytesOut per second of activeTime.
+   * @param {string} [token]
+   * @returns {{requests: number, cacheHits: number, coalesced: number, fetches: number,
+   *   bytesOut: number, bytesForwarded: number, bytesCached: number, bytesUpstream: number,
+   *   bytesTunnelled: number, active: number, cpuTime: number, activeTime: number,
+   *   throughput: number, cpuPercent: number}|null} null for an unknown session
+   */
+  stats(token) {
+    const handle = this._proxy()
+    const stats = token === undefined ? binding.stats(handle) : binding.sessionStats(handle, token)
+    return stats && withRates(stats)
+  }
+
+  /**
+   * Stop serving and close every connection
+   */
+  close() {
+    binding.close(this._proxy())
+    this.port = 0
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+    this.port = 0
+  }
+}
+
+module.exports = {
+  CastProxy
+}
@@ -0,0 +1,1662 @@
+#include "cast_proxy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace bare_cast_proxy {
+
+namespace {
+
+constexpr uint64_t UNKNOWN = UINT64_MAX;
+
+// Largest request or response head
+constexpr size_t MAX_HEAD = 16 * 1024;
+
+// Bytes moved per splice() or read() of a forwarded body
+constexpr size_t RELAY_CHUNK = 64 * 1024;
+
+// Relay steps per wakeup, so one fast stream cannot starve the rest
+constexpr int RELAY_STEPS = 16;
+
+// Plans of one cached request before it is forwarded instead
+constexpr int MAX_PLANS = 3;
+
+const char CORS_HEADERS[] =
+  "Access-Control-Allow-Origin: *\r\n"
+  "Access-Control-Allow-Methods: GET,HEAD,OPTIONS\r\n"
+  "Access-Control-Allow-Headers: Range,Content-Type,Accept,Origin\r\n"
+  "Access-Control-Expose-Headers: Content-Length,Content-Range,Accept-Ranges\r\n";
+
+uint64_t
+clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+uint64_t
+now_ns() {
+  return clock_ns(CLOCK_MONOTONIC);
+}
+
+uint64_t
+thread_cpu_ns() {
+  return clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+bool
+ends_with(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool
+equals_lower(const std::string &s, const char *lower) {
+  size_t n = strlen(lower);
+  if (s.size() != n) return false;
+  for (size_t i = 0; i < n; i++) {
+    char ch = s[i];
+    if (ch >= 'A' && ch <= 'Z') ch = char(ch - 'A' + 'a');
+    if (ch != lower[i]) return false;
+  }
+  return true;
+}
+
+bool
+parse_u64(const std::string &s, size_t begin, size_t end, uint64_t *value) {
+  if (begin >= end || end - begin > 19) return false;
+  uint64_t v = 0;
+  for (size_t i = begin; i < end; i++) {
+    if (s[i] < '0' || s[i] > '9') return false;
+    v = v * 10 + uint64_t(s[i] - '0');
+  }
+  *value = v;
+  return true;
+}
+
+bool
+parse_ipv4(const std::string &host, uint32_t *addr) {
+#ifndef _WIN32
+  struct in_addr in;
+  if (inet_pton(AF_INET, host.c_str(), &in) != 1) return false;
+  *addr = in.s_addr;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Parsed request or response head
+struct head_t {
+  // Request: method, target, version. Response: version, status, reason
+  std::string first[3];
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  const std::string *get(const char *lower) const {
+    for (auto &h : headers) {
+      if (equals_lower(h.first, lower)) return &h.second;
+    }
+    return nullptr;
+  }
+};
+
+// Parse `text` up to its blank line
+bool
+parse_head(const std::string &text, size_t length, head_t *head) {
+  size_t pos = text.find("\r\n");
+  if (pos == std::string::npos || pos > length) return false;
+
+  size_t a = text.find(' ');
+  if (a == std::string::npos || a >= pos) return false;
+  size_t b = text.find(' ', a + 1);
+  if (b == std::string::npos || b > pos) b = pos;
+  head->first[0] = text.substr(0, a);
+  head->first[1] = text.substr(a + 1, b - a - 1);
+  head->first[2] = b < pos ? text.substr(b + 1, pos - b - 1) : std::string();
+
+  head->headers.clear();
+  pos += 2;
+  while (pos < length) {
+    size_t end = text.find("\r\n", pos);
+    if (end == std::string::npos || end > length) end = length;
+    if (end == pos) break;
+    size_t colon = text.find(':', pos);
+    if (colon == std::string::npos || colon > end) return false;
+    size_t value = colon + 1;
+    while (value < end && (text[value] == ' ' || text[value] == '\t')) value++;
+    size_t value_end = end;
+    while (value_end > value && (text[value_end - 1] == ' ' || text[value_end - 1] == '\t')) value_end--;
+    head->headers.emplace_back(text.substr(pos, colon - pos), text.substr(value, value_end - value));
+    pos = end + 2;
+  }
+  return true;
+}
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n"; a suffix range has first UNKNOWN
+bool
+parse_range(const std::string &value, uint64_t *first, uint64_t *last) {
+  if (value.compare(0, 6, "bytes=") != 0 || value.find(',') != std::string::npos) return false;
+  size_t dash = value.find('-', 6);
+  if (dash == std::string::npos) return false;
+  *first = UNKNOWN;
+  *last = UNKNOWN;
+  if (dash > 6 && !parse_u64(value, 6, dash, first)) return false;
+  if (dash + 1 < value.size() && !parse_u64(value, dash + 1, value.size(), last)) return false;
+  if (*first == UNKNOWN && *last == UNKNOWN) return false;
+  return *first == UNKNOWN || *last == UNKNOWN || *last >= *first;
+}
+
+// "bytes s-e/total"
+bool
+parse_content_range(const std::string &value, uint64_t *first, uint64_t *last, uint64_t *total) {
+  if (value.compare(0, 6, "bytes ") != 0) return false;
+  size_t dash = value.find('-', 6);
+  size_t slash = value.find('/', 6);
+  if (dash == std::string::npos || slash == std::string::npos || slash < dash) return false;
+  return parse_u64(value, 6, dash, first) && parse_u64(value, dash + 1, slash, last) && parse_u64(value, slash + 1, value.size(), total) && *last >= *first && *last < *total;
+}
+
+#ifndef _WIN32
+
+bool
+set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return false;
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  return true;
+}
+
+void
+close_fd(int &fd) {
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+ssize_t
+send_some(int fd, const void *data, size_t len) {
+#ifdef MSG_NOSIGNAL
+  return ::send(fd, data, len, MSG_NOSIGNAL);
+#else
+  return ::send(fd, data, len, 0);
+#endif
+}
+
+bool
+would_block() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+#ifdef __linux__
+// splice() into a socket raises SIGPIPE when the peer is gone; the loop
+// thread blocks it, so take the pending signal back after EPIPE
+void
+consume_sigpipe() {
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  struct timespec zero = {0, 0};
+  while (sigtimedwait(&set, NULL, &zero) > 0) {
+  }
+}
+#endif
+
+// Start a non-blocking connect
+int
+connect_to(uint32_t addr, uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (!set_nonblocking(fd)) {
+    ::close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = addr;
+  if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0 && errno != EINPROGRESS) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+#endif
+
+} // namespace
+
+struct chunk_t {
+  std::vector<uint8_t> data;
+  uint64_t used = 0;
+};
+
+// One upstream path of a session
+struct resource_t {
+  uint64_t total = UNKNOWN;
+  // When the upstream last reported the total; files can grow while cast
+  uint64_t total_at = 0;
+  std::string content_type;
+  // Upstream ignores ranges
+  bool uncacheable = false;
+  std::map<uint64_t, std::shared_ptr<chunk_t>> chunks;
+};
+
+struct session_t {
+  uint32_t addr = 0;
+  uint16_t port = 0;
+  std::string host;
+  std::string pathname;
+  std::string search;
+
+  std::map<std::string, resource_t> resources;
+  size_t cached = 0;
+  uint64_t tick = 0;
+
+  stats_t stats;
+  uint64_t active_since = 0;
+};
+
+#ifndef _WIN32
+
+namespace {
+
+// Moves bytes from src to dst: buffered bytes first (a response head, or
+// body bytes read along with it), then the rest of the stream, through a
+// pipe with splice() on Linux and a buffer elsewhere
+struct relay_t {
+  int src = -1;
+  int dst = -1;
+  std::string buf;
+  size_t off = 0;
+#ifdef __linux__
+  int pipe[2] = {-1, -1};
+  size_t pending = 0;
+#endif
+  // Bytes still to read from src
+  uint64_t remaining = UNKNOWN;
+  bool eof = false;
+  uint64_t received = 0;
+  uint64_t moved = 0;
+
+  bool open() {
+#ifdef __linux__
+    if (pipe2(pipe, O_NONBLOCK | O_CLOEXEC) < 0) return false;
+#endif
+    return true;
+  }
+
+  void close() {
+#ifdef __linux__
+    close_fd(pipe[0]);
+    close_fd(pipe[1]);
+    pending = 0;
+#endif
+    buf.clear();
+    off = 0;
+  }
+
+  size_t buffered() const {
+#ifdef __linux__
+    return buf.size() - off + pending;
+#else
+    return buf.size() - off;
+#endif
+  }
+
+  bool drained() const { return eof && buffered() == 0; }
+
+  short src_events() const {
+#ifdef __linux__
+    return !eof && pending < RELAY_CHUNK ? POLLIN : 0;
+#else
+    return !eof && off == buf.size() ? POLLIN : 0;
+#endif
+  }
+
+  short dst_events() const { return buffered() > 0 ? POLLOUT : 0; }
+
+  // Move what moves without blocking; false on error
+  bool pump() {
+    for (int step = 0; step < RELAY_STEPS; step++) {
+      bool progress = false;
+
+      if (off < buf.size()) {
+        ssize_t n = send_some(dst, buf.data() + off, buf.size() - off);
+        if (n > 0) {
+          off += size_t(n);
+          moved += uint64_t(n);
+          progress = true;
+          if (off == buf.size()) {
+            buf.clear();
+            off = 0;
+          }
+        } else if (n < 0 && !would_block()) {
+          return false;
+        }
+      }
+
+#ifdef __linux__
+      if (off == buf.size() && pending > 0) {
+        ssize_t n = splice(pipe[0], NULL, dst, NULL, pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+          pending -= size_t(n);
+          moved += uint64_t(n);
+          progress = true;
+        } else if (n < 0 && !would_block()) {
+          if (errno == EPIPE) consume_sigpipe();
+          return false;
+        }
+      }
+
+      if (!eof && pending < RELAY_CHUNK) {
+        size_t want = size_t(std::min<uint64_t>(RELAY_CHUNK - pending, remaining));
+        ssize_t n = splice(src, NULL, pipe[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+          pending += size_t(n);
+          received += uint64_t(n);
+          if (remaining != UNKNOWN) remaining -= uint64_t(n);
+          if (remaining == 0) eof = true;
+          progress = true;
+        } else if (n == 0) {
+          eof = true;
+          progress = true;
+        } else if (!would_block()) {
+          return false;
+        }
+      }
+#else
+      if (!eof && off == buf.size()) {
+        buf.resize(size_t(std::min<uint64_t>(RELAY_CHUNK, remaining)));
+        ssize_t n = ::recv(src, &buf[0], buf.size(), 0);
+        if (n > 0) {
+          buf.resize(size_t(n));
+          received += uint64_t(n);
+          if (remaining != UNKNOWN) remaining -= uint64_t(n);
+          if (remaining == 0) eof = true;
+          progress = true;
+        } else {
+          buf.clear();
+          if (n == 0) {
+            eof = true;
+            progress = true;
+          } else if (!would_block()) {
+            return false;
+          }
+        }
+      }
+#endif
+
+      if (!progress) break;
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+enum class state_t {
+  // Reading a request head
+  head,
+  // Connecting to the upstream (or fallback) and sending the request
+  requesting,
+  // Reading the upstream response head
+  upstream_head,
+  // Relaying the upstream body
+  forwarding,
+  // Waiting for cache fetches
+  waiting,
+  // Writing a response from memory (cached chunks or an error)
+  sending,
+  // Raw relay both ways with the fallback server
+  tunnel,
+  closed
+};
+
+struct client_t {
+  int fd = -1;
+  state_t state = state_t::head;
+  uint64_t last_active = 0;
+  short revents = 0;
+  short upstream_revents = 0;
+
+  // Bytes read from the client and not yet handled
+  std::string in;
+
+  // Current request
+  head_t request;
+  bool head_only = false;
+  bool keep_alive = false;
+  std::shared_ptr<session_t> session;
+  resource_t *resource = nullptr;
+  std::string upstream_path;
+  // Requested range; first UNKNOWN for a suffix range, last UNKNOWN if open
+  bool ranged = false;
+  uint64_t first = 0;
+  uint64_t last = UNKNOWN;
+  bool counted = false;
+  uint64_t requested_at = 0;
+  bool probed = false;
+
+  // Upstream (or fallback) connection
+  int upstream = -1;
+  bool connected = false;
+  bool to_fallback = false;
+  bool tunnelled = false;
+  std::string upstream_request;
+  size_t upstream_request_off = 0;
+  std::string upstream_head;
+
+  relay_t down;
+  relay_t up;
+  bool up_shut = false;
+  uint64_t accounted_down = 0;
+  uint64_t accounted_up = 0;
+  uint64_t accounted_received = 0;
+
+  // Cached response: head in `out`, then parts[i] from its offset
+  std::string out;
+  size_t out_off = 0;
+  std::vector<std::shared_ptr<chunk_t>> parts;
+  size_t part = 0;
+  size_t part_off = 0;
+  uint64_t body_left = 0;
+  int waits = 0;
+  int plans = 0;
+  bool fetch_failed = false;
+};
+
+struct fetch_t {
+  int fd = -1;
+  bool connected = false;
+  bool done = false;
+  short revents = 0;
+  std::shared_ptr<session_t> session;
+  resource_t *resource = nullptr;
+  uint64_t first = 0;
+  uint64_t last = 0;
+  // Asks for one byte, only to learn the current total
+  bool probe = false;
+
+  std::string request;
+  size_t request_off = 0;
+  std::string head;
+  bool in_body = false;
+  std::vector<std::shared_ptr<chunk_t>> chunks;
+  uint64_t body_first = 0;
+  uint64_t body_length = 0;
+  uint64_t body_pos = 0;
+
+  std::vector<client_t *> waiting;
+};
+
+CastProxy::CastProxy(const options_t &options) : options_(options) {
+  if (options_.chunk_size < 4096) options_.chunk_size = 4096;
+  // The cache must hold a whole cached range plus its read-ahead
+  size_t needed = (options_.max_cached_range + options_.chunk_size - 1) / options_.chunk_size + 2;
+  if (options_.cache_chunks < needed) options_.cache_chunks = needed;
+}
+
+CastProxy::~CastProxy() {
+  close();
+}
+
+int
+CastProxy::listen(const std::string &host, int port, const std::string &fallback_host, int fallback_port) {
+  if (thread_.joinable() || listen_fd_ >= 0) {
+    error_ = "Proxy is already listening";
+    return -1;
+  }
+
+  uint32_t addr;
+  if (!parse_ipv4(host, &addr) || !parse_ipv4(fallback_host, &fallback_addr_)) {
+    error_ = "Hosts must be IPv4 addresses";
+    return -1;
+  }
+  if (port < 0 || port > 65535 || fallback_port <= 0 || fallback_port > 65535) {
+    error_ = "Invalid port";
+    return -1;
+  }
+  fallback_port_ = uint16_t(fallback_port);
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    error_ = strerror(errno);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(uint16_t(port));
+  sa.sin_addr.s_addr = addr;
+  socklen_t sa_len = sizeof(sa);
+  if (bind(listen_fd_, (struct sockaddr *) &sa, sizeof(sa)) < 0 || ::listen(listen_fd_, 64) < 0 || getsockname(listen_fd_, (struct sockaddr *) &sa, &sa_len) < 0 || !set_nonblocking(listen_fd_)) {
+    error_ = strerror(errno);
+    close_fd(listen_fd_);
+    return -1;
+  }
+
+  if (pipe(wake_) < 0) {
+    error_ = strerror(errno);
+    close_fd(listen_fd_);
+    return -1;
+  }
+  set_nonblocking(wake_[0]);
+  set_nonblocking(wake_[1]);
+
+  stopping_ = false;
+  thread_ = std::thread([this] { run(); });
+  return ntohs(sa.sin_port);
+}
+
+void
+CastProxy::close() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stopping_ = true;
+    }
+    char byte = 1;
+    ssize_t n = write(wake_[1], &byte, 1);
+    (void) n;
+    thread_.join();
+  }
+
+  for (auto &client : clients_) close_client(client.get());
+  for (auto &fetch : fetches_) close_fd(fetch->fd);
+  clients_.clear();
+  fetches_.clear();
+
+  close_fd(listen_fd_);
+  close_fd(wake_[0]);
+  close_fd(wake_[1]);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  sessions_.clear();
+}
+
+bool
+CastProxy::add_session(const std::string &token, const std::string &host, int port, const std::string &pathname, const std::string &search) {
+  auto session = std::make_shared<session_t>();
+  if (!parse_ipv4(host, &session->addr) || port <= 0 || port > 65535) return false;
+  session->port = uint16_t(port);
+  session->host = host + ":" + std::to_string(port);
+  session->pathname = pathname.empty() ? "/" : pathname;
+  session->search = search;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  sessions_[token] = session;
+  return true;
+}
+
+void
+CastProxy::remove_session(const std::string &token) {
+  std::lock_guard<std::mutex> guard(lock_);
+  sessions_.erase(token);
+}
+
+bool
+CastProxy::session_stats(const std::string &token, stats_t *stats) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = sessions_.find(token);
+  if (it == sessions_.end()) return false;
+  *stats = it->second->stats;
+  if (it->second->active_since) stats->active_ns += now_ns() - it->second->active_since;
+  return true;
+}
+
+stats_t
+CastProxy::stats() {
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_t stats = totals_;
+  if (active_since_) stats.active_ns += now_ns() - active_since_;
+  return stats;
+}
+
+size_t
+CastProxy::sessions() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return sessions_.size();
+}
+
+void
+CastProxy::run() {
+#ifdef __linux__
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (stopping_) break;
+    }
+    step(1000);
+  }
+}
+
+void
+CastProxy::step(int timeout_ms) {
+  std::vector<struct pollfd> fds;
+  // Owner of each pollfd past the first two: client (upstream or not) or fetch
+  struct owner_t {
+    client_t *client;
+    fetch_t *fetch;
+    bool upstream;
+  };
+  std::vector<owner_t> owners;
+
+  fds.push_back({wake_[0], POLLIN, 0});
+  fds.push_back({listen_fd_, POLLIN, 0});
+
+  for (auto &c : clients_) {
+    short events = 0, upstream_events = 0;
+    switch (c->state) {
+    case state_t::head:
+      events = POLLIN;
+      break;
+    case state_t::requesting:
+      upstream_events = POLLOUT;
+      break;
+    case state_t::upstream_head:
+      upstream_events = POLLIN;
+      break;
+    case state_t::forwarding:
+      events = c->down.dst_events();
+      upstream_events = c->down.src_events();
+      break;
+    case state_t::waiting:
+      // To notice the client leaving
+      events = c->in.size() < MAX_HEAD ? POLLIN : 0;
+      break;
+    case state_t::sending:
+      events = POLLOUT;
+      break;
+    case state_t::tunnel:
+      events = c->up.src_events() | c->down.dst_events();
+      upstream_events = c->down.src_events() | c->up.dst_events();
+      break;
+    default:
+      break;
+    }
+    c->revents = 0;
+    c->upstream_revents = 0;
+    fds.push_back({c->fd, events, 0});
+    owners.push_back({c.get(), nullptr, false});
+    if (c->upstream >= 0) {
+      fds.push_back({c->upstream, upstream_events, 0});
+      owners.push_back({c.get(), nullptr, true});
+    }
+  }
+
+  for (auto &f : fetches_) {
+    f->revents = 0;
+    fds.push_back({f->fd, short(f->connected ? POLLIN : POLLOUT), 0});
+    owners.push_back({nullptr, f.get(), false});
+  }
+
+  int ready = poll(fds.data(), nfds_t(fds.size()), timeout_ms);
+  if (ready < 0 && errno != EINTR) return;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (stopping_) return;
+
+  if (fds[0].revents) {
+    char drain[64];
+    while (read(wake_[0], drain, sizeof(drain)) > 0) {
+    }
+  }
+  if (fds[1].revents & POLLIN) accept_clients();
+
+  for (size_t i = 0; i < owners.size(); i++) {
+    short revents = fds[i + 2].revents;
+    if (!revents) continue;
+    if (owners[i].fetch) owners[i].fetch->revents = revents;
+    else if (owners[i].upstream) owners[i].client->upstream_revents = revents;
+    else owners[i].client->revents = revents;
+  }
+
+  uint64_t now = now_ns();
+
+  // Fetches first: finishing one can hand waiting clients their data
+  for (size_t i = 0; i < fetches_.size(); i++) {
+    fetch_t *f = fetches_[i].get();
+    if (!f->revents || f->done) continue;
+    uint64_t cpu = thread_cpu_ns();
+    on_fetch(f);
+    charge(f->session.get(), cpu);
+  }
+
+  for (size_t i = 0; i < clients_.size(); i++) {
+    client_t *c = clients_[i].get();
+    if (c->state == state_t::closed) continue;
+    if (!c->revents && !c->upstream_revents) {
+      if (c->state == state_t::head && now - c->last_active > uint64_t(options_.idle_timeout_ms) * 1000000) close_client(c);
+      continue;
+    }
+    c->last_active = now;
+    uint64_t cpu = thread_cpu_ns();
+    std::shared_ptr<session_t> session = c->session;
+    on_client(c, c->revents);
+    charge(session.get(), cpu);
+  }
+
+  fetches_.erase(std::remove_if(fetches_.begin(), fetches_.end(), [](const std::unique_ptr<fetch_t> &f) { return f->done; }), fetches_.end());
+  clients_.erase(std::remove_if(clients_.begin(), clients_.end(), [](const std::unique_ptr<client_t> &c) { return c->state == state_t::closed; }), clients_.end());
+}
+
+void
+CastProxy::accept_clients() {
+  for (;;) {
+    int fd = accept(listen_fd_, NULL, NULL);
+    if (fd < 0) return;
+    if (!set_nonblocking(fd)) {
+      ::close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    auto client = std::make_unique<client_t>();
+    client->fd = fd;
+    client->last_active = now_ns();
+    client_t *c = client.get();
+    clients_.push_back(std::move(client));
+    // Requests often arrive with the connection
+    on_client(c, POLLIN);
+  }
+}
+
+void
+CastProxy::on_client(client_t *c, short revents) {
+  if ((revents & (POLLERR | POLLNVAL)) && c->state != state_t::tunnel && c->state != state_t::forwarding) {
+    close_client(c);
+    return;
+  }
+
+  for (;;) {
+    state_t before = c->state;
+
+    switch (c->state) {
+    case state_t::head:
+      read_head(c);
+      break;
+
+    case state_t::requesting: {
+      if (!c->connected) {
+        if (!(c->upstream_revents & (POLLOUT | POLLERR | POLLHUP))) return;
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(c->upstream, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+          if (c->tunnelled) {
+            close_client(c);
+          } else {
+            close_fd(c->upstream);
+            c->keep_alive = false;
+            c->out = "HTTP/1.1 502 Bad Gateway\r\nContent-Type: text/plain\r\nContent-Length: 26\r\nConnection: close\r\n\r\nCast proxy upstream error.";
+            c->out_off = 0;
+            c->parts.clear();
+            c->body_left = 0;
+            c->state = state_t::sending;
+          }
+          break;
+        }
+        c->connected = true;
+      }
+
+      if (c->tunnelled) {
+        // The client's bytes so far go first
+        c->up.src = c->fd;
+        c->up.dst = c->upstream;
+        c->up.buf.swap(c->in);
+        c->down.src = c->upstream;
+        c->down.dst = c->fd;
+        if (!c->up.open() || !c->down.open()) {
+          close_client(c);
+          return;
+        }
+        c->state = state_t::tunnel;
+        break;
+      }
+
+      while (c->upstream_request_off < c->upstream_request.size()) {
+        ssize_t n = send_some(c->upstream, c->upstream_request.data() + c->upstream_request_off, c->upstream_request.size() - c->upstream_request_off);
+        if (n < 0) {
+          if (would_block()) return;
+          close_client(c);
+          return;
+        }
+        c->upstream_request_off += size_t(n);
+      }
+      c->upstream_head.clear();
+      c->state = state_t::upstream_head;
+      break;
+    }
+
+    case state_t::upstream_head: {
+      char buf[4096];
+      ssize_t n = ::recv(c->upstream, buf, sizeof(buf), 0);
+      if (n < 0 && would_block()) return;
+      if (n <= 0) {
+        close_client(c);
+        return;
+      }
+      if (c->session) {
+        c->session->stats.bytes_upstream += uint64_t(n);
+        totals_.bytes_upstream += uint64_t(n);
+      }
+      c->upstream_head.append(buf, size_t(n));
+      size_t end = c->upstream_head.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        if (c->upstream_head.size() > MAX_HEAD) close_client(c);
+        break;
+      }
+
+      head_t response;
+      if (!parse_head(c->upstream_head, end + 2, &response)) {
+        close_client(c);
+        return;
+      }
+      uint64_t status = 0;
+      parse_u64(response.first[1], 0, response.first[1].size(), &status);
+
+      // Body length: none for HEAD, 1xx, 204 and 304; else Content-Length
+      // or until the upstream closes (it was asked to)
+      uint64_t length = UNKNOWN;
+      bool delimited = false;
+      const std::string *content_length = response.get("content-length");
+      const std::string *transfer_encoding = response.get("transfer-encoding");
+      if (c->head_only || status < 200 || status == 204 || status == 304) {
+        length = 0;
+        delimited = true;
+      } else if (transfer_encoding) {
+        delimited = true;
+      } else if (content_length && parse_u64(*content_length, 0, content_length->size(), &length)) {
+        delimited = true;
+      }
+      if (!delimited) c->keep_alive = false;
+
+      // What the upstream reveals about the resource helps later requests
+      if (c->resource && status < 300) {
+        uint64_t first, last, total;
+        const std::string *content_range = response.get("content-range");
+        if (status == 206 && content_range && parse_content_range(*content_range, &first, &last, &total)) {
+          set_total(c->session.get(), c->resource, total);
+        } else if (status == 200 && content_length && !c->head_only) {
+          set_total(c->session.get(), c->resource, length);
+        }
+        const std::string *content_type = response.get("content-type");
+        if (content_type) c->resource->content_type = *content_type;
+      }
+
+      std::string head = "HTTP/1.1 " + response.first[1] + " " + response.first[2] + "\r\n";
+      for (auto &h : response.headers) {
+        if (equals_lower(h.first, "connection") || equals_lower(h.first, "keep-alive")) continue;
+        // The fallback server sets its own CORS headers
+        if (!c->to_fallback && h.first.size() > 14 && equals_lower(h.first.substr(0, 14), "access-control")) continue;
+        head += h.first + ": " + h.second + "\r\n";
+      }
+      if (!c->to_fallback) head += CORS_HEADERS;
+      head += c->keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+      std::string body = c->upstream_head.substr(end + 4);
+      if (length != UNKNOWN && body.size() > length) body.resize(size_t(length));
+
+      c->down.src = c->upstream;
+      c->down.dst = c->fd;
+      c->down.buf = head + body;
+      c->down.off = 0;
+      c->down.remaining = length == UNKNOWN ? UNKNOWN : length - body.size();
+      c->down.eof = c->down.remaining == 0;
+      c->down.received = 0;
+      c->down.moved = 0;
+      c->accounted_down = 0;
+      c->accounted_received = 0;
+      if (!c->down.open()) {
+        close_client(c);
+        return;
+      }
+      c->state = state_t::forwarding;
+      break;
+    }
+
+    case state_t::forwarding: {
+      bool ok = c->down.pump();
+      uint64_t moved = c->down.moved - c->accounted_down;
+      uint64_t received = c->down.received - c->accounted_received;
+      c->accounted_down = c->down.moved;
+      c->accounted_received = c->down.received;
+      if (c->session) {
+        c->session->stats.bytes_out += moved;
+        c->session->stats.bytes_forwarded += moved;
+        c->session->stats.bytes_upstream += received;
+        totals_.bytes_out += moved;
+        totals_.bytes_forwarded += moved;
+        totals_.bytes_upstream += received;
+      } else {
+        totals_.bytes_tunnelled += moved + received;
+      }
+
+      if (!ok || (c->down.eof && c->down.remaining != UNKNOWN && c->down.remaining > 0)) {
+        close_client(c);
+        return;
+      }
+      if (c->down.drained()) finish_response(c);
+      break;
+    }
+
+    case state_t::waiting: {
+      // A client that hangs up is closed now rather than when its fetches
+      // land; pipelined bytes wait for the next request
+      if (!(revents & (POLLIN | POLLHUP))) return;
+      char buf[4096];
+      ssize_t n = ::recv(c->fd, buf, sizeof(buf), 0);
+      if (n < 0 && would_block()) return;
+      if (n <= 0) {
+        close_client(c);
+        return;
+      }
+      c->in.append(buf, size_t(n));
+      return;
+    }
+
+    case state_t::sending: {
+      while (c->out_off < c->out.size()) {
+        ssize_t n = send_some(c->fd, c->out.data() + c->out_off, c->out.size() - c->out_off);
+        if (n < 0) {
+          if (would_block()) return;
+          close_client(c);
+          return;
+        }
+        c->out_off += size_t(n);
+        if (c->session) c->session->stats.bytes_out += uint64_t(n);
+        totals_.bytes_out += uint64_t(n);
+      }
+      while (c->body_left > 0 && c->part < c->parts.size()) {
+        const chunk_t &chunk = *c->parts[c->part];
+        size_t len = size_t(std::min<uint64_t>(chunk.data.size() - c->part_off, c->body_left));
+        ssize_t n = send_some(c->fd, chunk.data.data() + c->part_off, len);
+        if (n < 0) {
+          if (would_block()) return;
+          close_client(c);
+          return;
+        }
+        c->part_off += size_t(n);
+        c->body_left -= uint64_t(n);
+        if (c->part_off == chunk.data.size()) {
+          c->part++;
+          c->part_off = 0;
+        }
+        if (c->session) {
+          c->session->stats.bytes_out += uint64_t(n);
+          c->session->stats.bytes_cached += uint64_t(n);
+        }
+        totals_.bytes_out += uint64_t(n);
+        totals_.bytes_cached += uint64_t(n);
+      }
+      finish_response(c);
+      break;
+    }
+
+    case state_t::tunnel: {
+      bool ok = c->up.pump() && c->down.pump();
+      uint64_t moved = (c->up.moved - c->accounted_up) + (c->down.moved - c->accounted_down);
+      c->accounted_up = c->up.moved;
+      c->accounted_down = c->down.moved;
+      totals_.bytes_tunnelled += moved;
+      if (!ok) {
+        close_client(c);
+        return;
+      }
+      if (c->up.drained() && !c->up_shut) {
+        shutdown(c->upstream, SHUT_WR);
+        c->up_shut = true;
+      }
+      if (c->down.drained()) {
+        close_client(c);
+        return;
+      }
+      return;
+    }
+
+    case state_t::closed:
+      return;
+    }
+
+    if (c->state == before) return;
+  }
+}
+
+void
+CastProxy::read_head(client_t *c) {
+  size_t end = c->in.find("\r\n\r\n");
+  while (end == std::string::npos) {
+    if (c->in.size() > MAX_HEAD) {
+      close_client(c);
+      return;
+    }
+    char buf[4096];
+    ssize_t n = ::recv(c->fd, buf, sizeof(buf), 0);
+    if (n < 0 && would_block()) return;
+    if (n <= 0) {
+      close_client(c);
+      return;
+    }
+    c->in.append(buf, size_t(n));
+    end = c->in.find("\r\n\r\n", c->in.size() > size_t(n) + 3 ? c->in.size() - size_t(n) - 3 : 0);
+  }
+
+  if (!parse_head(c->in, end + 2, &c->request)) {
+    close_client(c);
+    return;
+  }
+  route(c);
+  if (c->state == state_t::closed || c->tunnelled) return;
+  // The head is handled; pipelined bytes wait for the next request
+  c->in.erase(0, end + 4);
+}
+
+void
+CastProxy::route(client_t *c) {
+  const head_t &req = c->request;
+  const std::string &method = req.first[0];
+  const std::string &version = req.first[2];
+
+  const std::string *connection = req.get("connection");
+  c->keep_alive = version == "HTTP/1.1" && !(connection && equals_lower(*connection, "close"));
+  c->head_only = method == "HEAD";
+
+  // Requests with a body keep the connection on the fallback server
+  const std::string *content_length = req.get("content-length");
+  if (req.get("transfer-encoding") || (content_length && *content_length != "0")) {
+    start_tunnel(c);
+    return;
+  }
+
+  std::string path = req.first[1];
+  if (path.compare(0, 7, "http://") == 0) {
+    size_t slash = path.find('/', 7);
+    path = slash == std::string::npos ? "/" : path.substr(slash);
+  }
+  size_t query = path.find('?');
+  if (query != std::string::npos) path.resize(query);
+
+  c->session = nullptr;
+  c->resource = nullptr;
+  if ((method == "GET" || method == "HEAD") && path.compare(0, 6, "/cast/") == 0) {
+    size_t slash = path.find('/', 6);
+    std::string token = path.substr(6, slash == std::string::npos ? std::string::npos : slash - 6);
+    std::string extra = slash == std::string::npos ? std::string() : path.substr(slash + 1);
+
+    bool plain = !token.empty() && !ends_with(extra, ".m3u8");
+    for (size_t pos = 0; plain && pos <= extra.size();) {
+      size_t next = extra.find('/', pos);
+      if (next == std::string::npos) next = extra.size();
+      std::string segment = extra.substr(pos, next - pos);
+      if (segment == "." || segment == "..") plain = false;
+      pos = next + 1;
+    }
+
+    auto it = plain ? sessions_.find(token) : sessions_.end();
+    if (it != sessions_.end()) {
+      c->session = it->second;
+      const session_t &s = *c->session;
+
+      // Extra segments resolve against the target's directory (or the
+      // target itself when it has no extension)
+      std::string target = s.pathname;
+      if (!extra.empty()) {
+        size_t last = target.rfind('/');
+        size_t dot = target.rfind('.');
+        if (dot != std::string::npos && dot > last + 1) target.resize(last);
+        while (!target.empty() && target.back() == '/') target.pop_back();
+        for (size_t pos = 0; pos < extra.size();) {
+          size_t next = extra.find('/', pos);
+          if (next == std::string::npos) next = extra.size();
+          if (next > pos) target += "/" + extra.substr(pos, next - pos);
+          pos = next + 1;
+        }
+        if (target.empty()) target = "/";
+      }
+      c->upstream_path = target + s.search;
+      c->resource = &c->session->resources[c->upstream_path];
+    }
+  }
+
+  if (!c->session) {
+    // Same request to the fallback server, which closes after answering
+    c->to_fallback = true;
+    c->upstream_request = req.first[0] + " " + req.first[1] + " " + req.first[2] + "\r\n";
+    for (auto &h : req.headers) {
+      if (equals_lower(h.first, "connection") || equals_lower(h.first, "keep-alive")) continue;
+      c->upstream_request += h.first + ": " + h.second + "\r\n";
+    }
+    c->upstream_request += "Connection: close\r\n\r\n";
+    start_forward(c);
+    return;
+  }
+
+  c->to_fallback = false;
+  c->session->stats.requests++;
+  totals_.requests++;
+  begin_active(c->session.get());
+  c->counted = true;
+
+  const std::string *range = req.get("range");
+  c->ranged = range && parse_range(*range, &c->first, &c->last);
+  c->requested_at = now_ns();
+  c->probed = false;
+  c->plans = 0;
+  c->fetch_failed = false;
+  if (!c->head_only && c->ranged && plan_cached(c)) return;
+
+  c->upstream_request = method + " " + c->upstream_path + " HTTP/1.1\r\nHost: " + c->session->host + "\r\n";
+  if (range) c->upstream_request += "Range: " + *range + "\r\n";
+  c->upstream_request += "Connection: close\r\n\r\n";
+  start_forward(c);
+}
+
+void
+CastProxy::start_forward(client_t *c) {
+  uint32_t addr = c->to_fallback ? fallback_addr_ : c->session->addr;
+  uint16_t port = c->to_fallback ? fallback_port_ : c->session->port;
+  c->upstream = connect_to(addr, port);
+  c->connected = false;
+  c->upstream_revents = 0;
+  c->upstream_request_off = 0;
+  if (c->upstream < 0) {
+    close_client(c);
+    return;
+  }
+  c->state = state_t::requesting;
+}
+
+void
+CastProxy::start_tunnel(client_t *c) {
+  c->tunnelled = true;
+  c->to_fallback = true;
+  c->upstream = connect_to(fallback_addr_, fallback_port_);
+  c->connected = false;
+  c->upstream_revents = 0;
+  if (c->upstream < 0) {
+    close_client(c);
+    return;
+  }
+  c->state = state_t::requesting;
+}
+
+// Serve the client's range through the cache: true if it is being served
+// (now or once fetches land), false to forward it instead
+bool
+CastProxy::plan_cached(client_t *c) {
+  session_t &s = *c->session;
+  resource_t &r = *c->resource;
+  if (r.uncacheable || c->fetch_failed || c->plans++ >= MAX_PLANS) return false;
+
+  uint64_t first = c->first;
+  uint64_t last = c->last;
+  uint64_t max = options_.max_cached_range;
+  if (first == UNKNOWN) {
+    // Suffix range: the last `last` bytes
+    if (r.total == UNKNOWN || last == 0 || last > max) return false;
+    first = r.total > last ? r.total - last : 0;
+    last = r.total - 1;
+  } else if (last == UNKNOWN) {
+    // Open range near the end, like a seek to the index of a file
+    if (r.total == UNKNOWN || first >= r.total || r.total - first > max) return false;
+    last = r.total - 1;
+  } else if (last - first + 1 > max) {
+    return false;
+  }
+  if (r.total != UNKNOWN) {
+    if (first >= r.total) return false;
+    last = std::min(last, r.total - 1);
+  }
+
+  uint64_t cs = options_.chunk_size;
+  uint64_t c0 = first / cs;
+  uint64_t c1 = last / cs;
+
+  bool joined = false;
+  bool fetched = false;
+  uint64_t run = UNKNOWN;
+  for (uint64_t i = c0; i <= c1 + 1; i++) {
+    bool missing = false;
+    if (i <= c1) {
+      auto it = r.chunks.find(i);
+      if (it != r.chunks.end()) {
+        it->second->used = ++s.tick;
+      } else {
+        fetch_t *inflight = nullptr;
+        for (auto &f : fetches_) {
+          if (!f->done && f->resource == &r && f->first <= i && i <= f->last) inflight = f.get();
+        }
+        if (inflight) {
+          if (std::find(inflight->waiting.begin(), inflight->waiting.end(), c) == inflight->waiting.end()) {
+            inflight->waiting.push_back(c);
+            c->waits++;
+            joined = true;
+          }
+        } else {
+          missing = true;
+        }
+      }
+    }
+
+    if (missing && run == UNKNOWN) run = i;
+    if (!missing && run != UNKNOWN) {
+      // One fetch per run of missing chunks, the last with read-ahead
+      uint64_t end = i - 1;
+      if (i > c1 && (r.total == UNKNOWN || (end + 1) * cs < r.total) && !r.chunks.count(end + 1)) end++;
+      start_fetch(c, run, end);
+      fetched = true;
+      run = UNKNOWN;
+    }
+  }
+
+  if (c->waits == 0 && c->fetch_failed) return false;
+
+  // Every chunk is here, but the total may be older than the request: ask
+  // the upstream for it first, with a fetch whose head is still to come
+  if (c->waits == 0 && r.total_at < c->requested_at) {
+    fetch_t *inflight = nullptr;
+    for (auto &f : fetches_) {
+      if (!f->done && !f->in_body && f->resource == &r) inflight = f.get();
+    }
+    if (inflight) {
+      inflight->waiting.push_back(c);
+      c->waits++;
+    } else {
+      start_fetch(c, 0, 0, true);
+      if (c->fetch_failed) return false;
+    }
+    c->probed = true;
+    c->state = state_t::waiting;
+    return true;
+  }
+
+  if (c->waits > 0) {
+    if (joined && !fetched && c->plans == 1) {
+      s.stats.coalesced++;
+      totals_.coalesced++;
+    }
+    c->state = state_t::waiting;
+    return true;
+  }
+
+  // Every chunk is here
+  if (c->plans == (c->probed ? 2 : 1)) {
+    s.stats.cache_hits++;
+    totals_.cache_hits++;
+  }
+  c->first = first;
+  c->last = last;
+  send_cached(c);
+  return true;
+}
+
+void
+CastProxy::send_cached(client_t *c) {
+  resource_t &r = *c->resource;
+  uint64_t cs = options_.chunk_size;
+  uint64_t first = c->first;
+  uint64_t last = std::min(c->last, r.total - 1);
+
+  c->parts.clear();
+  for (uint64_t i = first / cs; i <= last / cs; i++) c->parts.push_back(r.chunks[i]);
+  c->part = 0;
+  c->part_off = size_t(first - (first / cs) * cs);
+  c->body_left = last - first + 1;
+
+  c->out = "HTTP/1.1 206 Partial Content\r\nContent-Type: ";
+  c->out += r.content_type.empty() ? "application/octet-stream" : r.content_type;
+  c->out += "\r\nContent-Length: " + std::to_string(c->body_left);
+  c->out += "\r\nContent-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(r.total);
+  c->out += "\r\nAccept-Ranges: bytes\r\n";
+  c->out += CORS_HEADERS;
+  c->out += c->keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+  c->out_off = 0;
+  c->state = state_t::sending;
+}
+
+void
+CastProxy::start_fetch(client_t *c, uint64_t first, uint64_t last, bool probe) {
+  session_t &s = *c->session;
+  uint64_t cs = options_.chunk_size;
+
+  auto fetch = std::make_unique<fetch_t>();
+  fetch->fd = connect_to(s.addr, s.port);
+  if (fetch->fd < 0) {
+    c->fetch_failed = true;
+    return;
+  }
+  fetch->session = c->session;
+  fetch->resource = c->resource;
+  fetch->first = first;
+  fetch->last = last;
+  fetch->probe = probe;
+  std::string range = probe ? "0-0" : std::to_string(first * cs) + "-" + std::to_string((last + 1) * cs - 1);
+  fetch->request = "GET " + c->upstream_path + " HTTP/1.1\r\nHost: " + s.host + "\r\nRange: bytes=" + range + "\r\nConnection: close\r\n\r\n";
+  fetch->waiting.push_back(c);
+  c->waits++;
+
+  s.stats.fetches++;
+  totals_.fetches++;
+  fetches_.push_back(std::move(fetch));
+}
+
+void
+CastProxy::on_fetch(fetch_t *f) {
+  if (!f->connected) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(f->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+      finish_fetch(f, false);
+      return;
+    }
+    f->connected = true;
+  }
+
+  while (f->request_off < f->request.size()) {
+    ssize_t n = send_some(f->fd, f->request.data() + f->request_off, f->request.size() - f->request_off);
+    if (n < 0) {
+      if (would_block()) return;
+      finish_fetch(f, false);
+      return;
+    }
+    f->request_off += size_t(n);
+  }
+
+  uint64_t cs = options_.chunk_size;
+  for (;;) {
+    if (!f->in_body) {
+      char buf[4096];
+      ssize_t n = ::recv(f->fd, buf, sizeof(buf), 0);
+      if (n < 0 && would_block()) return;
+      if (n <= 0) {
+        finish_fetch(f, false);
+        return;
+      }
+      f->session->stats.bytes_upstream += uint64_t(n);
+      totals_.bytes_upstream += uint64_t(n);
+      f->head.append(buf, size_t(n));
+      size_t end = f->head.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        if (f->head.size() > MAX_HEAD) {
+          finish_fetch(f, false);
+          return;
+        }
+        continue;
+      }
+
+      head_t response;
+      uint64_t first, last, total;
+      const std::string *content_range = nullptr;
+      if (!parse_head(f->head, end + 2, &response)) {
+        finish_fetch(f, false);
+        return;
+      }
+      if (response.first[1] == "200") f->resource->uncacheable = true;
+      if (response.first[1] != "206" || !(content_range = response.get("content-range")) || !parse_content_range(*content_range, &first, &last, &total) || first != f->first * cs) {
+        finish_fetch(f, false);
+        return;
+      }
+      set_total(f->session.get(), f->resource, total);
+      const std::string *content_type = response.get("content-type");
+      if (content_type) f->resource->content_type = *content_type;
+      if (f->probe) {
+        finish_fetch(f, true);
+        return;
+      }
+
+      // Chunks the body fills; a short last chunk only at the end of the file
+      f->body_first = first;
+      f->body_length = last - first + 1;
+      for (uint64_t off = 0; off < f->body_length; off += cs) {
+        auto chunk = std::make_shared<chunk_t>();
+        chunk->data.resize(size_t(std::min<uint64_t>(cs, f->body_length - off)));
+        f->chunks.push_back(chunk);
+      }
+      f->in_body = true;
+
+      std::string body = f->head.substr(end + 4);
+      f->head.clear();
+      for (size_t i = 0; i < body.size() && f->body_pos < f->body_length;) {
+        chunk_t &chunk = *f->chunks[size_t(f->body_pos / cs)];
+        size_t at = size_t(f->body_pos % cs);
+        size_t len = std::min(body.size() - i, chunk.data.size() - at);
+        memcpy(chunk.data.data() + at, body.data() + i, len);
+        i += len;
+        f->body_pos += len;
+      }
+    }
+
+    if (f->body_pos >= f->body_length) {
+      finish_fetch(f, true);
+      return;
+    }
+
+    chunk_t &chunk = *f->chunks[size_t(f->body_pos / cs)];
+    size_t at = size_t(f->body_pos % cs);
+    ssize_t n = ::recv(f->fd, chunk.data.data() + at, chunk.data.size() - at, 0);
+    if (n < 0 && would_block()) return;
+    if (n <= 0) {
+      finish_fetch(f, false);
+      return;
+    }
+    f->body_pos += uint64_t(n);
+    f->session->stats.bytes_upstream += uint64_t(n);
+    totals_.bytes_upstream += uint64_t(n);
+  }
+}
+
+void
+CastProxy::finish_fetch(fetch_t *f, bool ok) {
+  close_fd(f->fd);
+  f->done = true;
+  session_t &s = *f->session;
+  resource_t &r = *f->resource;
+  uint64_t cs = options_.chunk_size;
+
+  if (ok) {
+    for (size_t i = 0; i < f->chunks.size(); i++) {
+      auto &chunk = f->chunks[i];
+      uint64_t index = f->first + i;
+      if (chunk->data.size() < cs && index * cs + chunk->data.size() < r.total) break;
+      chunk->used = ++s.tick;
+      if (r.chunks.emplace(index, chunk).second) s.cached++;
+    }
+
+    // Least recently used chunks go first
+    while (s.cached > options_.cache_chunks) {
+      resource_t *oldest_resource = nullptr;
+      std::map<uint64_t, std::shared_ptr<chunk_t>>::iterator oldest;
+      for (auto &entry : s.resources) {
+        for (auto it = entry.second.chunks.begin(); it != entry.second.chunks.end(); ++it) {
+          if (!oldest_resource || it->second->used < oldest->second->used) {
+            oldest_resource = &entry.second;
+            oldest = it;
+          }
+        }
+      }
+      if (!oldest_resource) break;
+      oldest_resource->chunks.erase(oldest);
+      s.cached--;
+    }
+  }
+
+  std::vector<client_t *> waiting;
+  waiting.swap(f->waiting);
+  for (client_t *c : waiting) {
+    if (!ok) c->fetch_failed = true;
+    if (--c->waits > 0 || c->state != state_t::waiting) continue;
+
+    uint64_t cpu = thread_cpu_ns();
+    if (!plan_cached(c)) {
+      // Forward the request as it came
+      const std::string *range = c->request.get("range");
+      c->upstream_request = c->request.first[0] + " " + c->upstream_path + " HTTP/1.1\r\nHost: " + s.host + "\r\n";
+      if (range) c->upstream_request += "Range: " + *range + "\r\n";
+      c->upstream_request += "Connection: close\r\n\r\n";
+      start_forward(c);
+    }
+    // Make progress now rather than at the next poll
+    if (c->state == state_t::sending) on_client(c, 0);
+    charge(c->session.get(), cpu);
+  }
+}
+
+// Record the total the upstream reports. A different one (a file still
+// being written) makes the short chunk that ended the file stale, and
+// chunks past a shorter end
+void
+CastProxy::set_total(session_t *s, resource_t *r, uint64_t total) {
+  uint64_t cs = options_.chunk_size;
+  r->total_at = now_ns();
+  if (r->total == total) return;
+  r->total = total;
+  for (auto it = r->chunks.begin(); it != r->chunks.end();) {
+    if (it->second->data.size() < cs || it->first * cs + it->second->data.size() > total) {
+      it = r->chunks.erase(it);
+      s->cached--;
+    } else {
+      ++it;
+    }
+  }
+}
+
+void
+CastProxy::finish_response(client_t *c) {
+  close_fd(c->upstream);
+  c->down.close();
+  c->connected = false;
+  c->upstream_head.clear();
+  c->out.clear();
+  c->parts.clear();
+  if (c->counted) {
+    end_active(c->session.get());
+    c->counted = false;
+  }
+  c->session = nullptr;
+  c->resource = nullptr;
+  c->to_fallback = false;
+
+  if (!c->keep_alive) {
+    close_client(c);
+    return;
+  }
+  c->state = state_t::head;
+}
+
+void
+CastProxy::close_client(client_t *c) {
+  if (c->state == state_t::closed) return;
+  for (auto &f : fetches_) {
+    auto it = std::find(f->waiting.begin(), f->waiting.end(), c);
+    if (it != f->waiting.end()) f->waiting.erase(it);
+  }
+  if (c->counted) {
+    end_active(c->session.get());
+    c->counted = false;
+  }
+  close_fd(c->fd);
+  close_fd(c->upstream);
+  c->down.close();
+  c->up.close();
+  c->session = nullptr;
+  c->state = state_t::closed;
+}
+
+void
+CastProxy::begin_active(session_t *s) {
+  uint64_t now = now_ns();
+  if (s->stats.active++ == 0) s->active_since = now;
+  if (totals_.active++ == 0) active_since_ = now;
+}
+
+void
+CastProxy::end_active(session_t *s) {
+  uint64_t now = now_ns();
+  if (--s->stats.active == 0) {
+    s->stats.active_ns += now - s->active_since;
+    s->active_since = 0;
+  }
+  if (--totals_.active == 0) {
+    totals_.active_ns += now - active_since_;
+    active_since_ = 0;
+  }
+}
+
+void
+CastProxy::charge(session_t *s, uint64_t since_ns) {
+  if (!s) return;
+  uint64_t cpu = thread_cpu_ns() - since_ns;
+  s->stats.cpu_ns += cpu;
+  totals_.cpu_ns += cpu;
+}
+
+#else
+
+CastProxy::CastProxy(const options_t &options) : options_(options) {}
+
+CastProxy::~CastProxy() {}
+
+int
+CastProxy::listen(const std::string &, int, const std::string &, int) {
+  error_ = "Cast proxy is not supported on this platform";
+  return -1;
+}
+
+void
+CastProxy::close() {}
+
+bool
+CastProxy::add_session(const std::string &, const std::string &, int, const std::string &, const std::string &) {
+  return false;
+}
+
+void
+CastProxy::remove_session(const std::string &) {}
+
+bool
+CastProxy::session_stats(const std::string &, stats_t *) {
+  return false;
+}
+
+stats_t
+CastProxy::stats() {
+  return totals_;
+}
+
+size_t
+CastProxy::sessions() {
+  return 0;
+}
+
+#endif
+
+} // namespace bare_cast_proxy
@@ -0,0 +1,162 @@
+/**
+ * HTTP proxy between cast receivers (TVs) and the local media servers.
+ *
+ * Requests look like /cast/<token>[/<path>]; the token names a session
+ * whose upstream is a plain-HTTP URL on a numeric IPv4 host. Media requests
+ * for known sessions are served here:
+ *
+ *  - Streaming reads (no range, open-ended or large ranges) are forwarded
+ *    with splice() through a pipe on Linux, so the body never enters user
+ *    space; elsewhere through a fixed buffer.
+ *  - Small ranges (probes for headers and indexes, seeks near the end) go
+ *    through a per-session read-ahead cache of fixed-size chunks. Missing
+ *    chunks are fetched in contiguous runs plus one chunk of read-ahead,
+ *    and requests overlapping a fetch in flight wait for it rather than
+ *    fetching again. A range served from cached chunks alone first asks
+ *    the upstream for the file's size, which grows while a file is written.
+ *
+ * Everything else (playlists, unknown tokens, other methods, anything the
+ * proxy cannot parse) is tunnelled byte-for-byte to a fallback server,
+ * which does the rest.
+ *
+ * The proxy runs its own poll() loop on a thread; sessions are added and
+ * removed, and stats read, from any thread.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bare_cast_proxy {
+
+struct options_t {
+  // Read-ahead cache chunk
+  size_t chunk_size = 256 * 1024;
+  // Cached chunks per session
+  size_t cache_chunks = 16;
+  // Largest range served through the cache; larger ones are forwarded
+  size_t max_cached_range = 1024 * 1024;
+  // Idle connections are closed after this long
+  int idle_timeout_ms = 60000;
+};
+
+struct stats_t {
+  // Requests served natively
+  uint64_t requests = 0;
+  // ...of which answered from cached chunks without fetching
+  uint64_t cache_hits = 0;
+  // ...of which waited for a fetch started by another request
+  uint64_t coalesced = 0;
+  // Range fetches made for the cache
+  uint64_t fetches = 0;
+  // Response bytes (headers and body) written to clients
+  uint64_t bytes_out = 0;
+  // ...of which forwarded (spliced on Linux)
+  uint64_t bytes_forwarded = 0;
+  // ...of which copied from the cache
+  uint64_t bytes_cached = 0;
+  // Bytes read from upstreams
+  uint64_t bytes_upstream = 0;
+  // Bytes tunnelled to and from the fallback server (totals only)
+  uint64_t bytes_tunnelled = 0;
+  // Native responses in progress
+  uint32_t active = 0;
+  // Proxy thread CPU time spent on these requests
+  uint64_t cpu_ns = 0;
+  // Wall time with at least one native response in progress
+  uint64_t active_ns = 0;
+};
+
+struct session_t;
+struct resource_t;
+struct client_t;
+struct fetch_t;
+
+class CastProxy {
+public:
+  explicit CastProxy(const options_t &options);
+  ~CastProxy();
+
+  CastProxy(const CastProxy &) = delete;
+  CastProxy &operator=(const CastProxy &) = delete;
+
+  // Listen on host:port (port 0 picks one) and start the loop thread.
+  // Requests the proxy does not serve are tunnelled to
+  // fallback_host:fallback_port. Returns the bound port, or -1 with
+  // error() set.
+  int listen(const std::string &host, int port, const std::string &fallback_host, int fallback_port);
+
+  // Stop the loop thread and close every connection
+  void close();
+
+  const std::string &error() const { return error_; }
+
+  // Route /cast/<token> to http://host:port<pathname><search>. Replaces a
+  // session of the same token; false if host is not an IPv4 address.
+  bool add_session(const std::string &token, const std::string &host, int port, const std::string &pathname, const std::string &search);
+
+  // Later requests for the token go to the fallback server
+  void remove_session(const std::string &token);
+
+  // Stats of one session; false if there is no such session
+  bool session_stats(const std::string &token, stats_t *stats);
+
+  // Stats of every request served since listen()
+  stats_t stats();
+
+  size_t sessions();
+
+private:
+  void run();
+  void step(int timeout_ms);
+
+  void accept_clients();
+  void on_client(client_t *client, short revents);
+  void on_fetch(fetch_t *fetch);
+
+  void read_head(client_t *client);
+  void route(client_t *client);
+  void start_forward(client_t *client);
+  void start_tunnel(client_t *client);
+  bool plan_cached(client_t *client);
+  void send_cached(client_t *client);
+  void start_fetch(client_t *client, uint64_t first, uint64_t last, bool probe = false);
+  void finish_fetch(fetch_t *fetch, bool ok);
+  void set_total(session_t *session, resource_t *resource, uint64_t total);
+  void finish_response(client_t *client);
+  void close_client(client_t *client);
+
+  void begin_active(session_t *session);
+  void end_active(session_t *session);
+  void charge(session_t *session, uint64_t since_ns);
+
+  options_t options_;
+  std::string error_;
+
+  int listen_fd_ = -1;
+  int wake_[2] = {-1, -1};
+  uint32_t fallback_addr_ = 0;
+  uint16_t fallback_port_ = 0;
+
+  std::thread thread_;
+  bool stopping_ = false;
+
+  // Guards sessions_, totals_ and session stats; held by the loop while it
+  // handles events
+  std::mutex lock_;
+  std::map<std::string, std::shared_ptr<session_t>> sessions_;
+  stats_t totals_;
+  uint64_t active_since_ = 0;
+
+  std::vector<std::unique_ptr<client_t>> clients_;
+  std::vector<std::unique_ptr<fetch_t>> fetches_;
+};
+
+} // namespace bare_cast_proxy
@@ -0,0 +1,188 @@
+/**
+ * Simple test for bare-cast-proxy addon
+ * Runs the proxy between a local HTTP client, a range-capable upstream and
+ * a fallback server, and checks bodies, routing and the range cache.
+ */
+
+const http = require('bare-http1')
+const { CastProxy } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+const SIZE = 3 * 1024 * 1024 + 123
+const media = Buffer.alloc(SIZE)
+for (let i = 0; i < SIZE; i++) media[i] = (i * 31 + (i >> 8)) & 0xff
+
+const upstreamRanges = []
+// Size of /growing.mp4, a file still being written
+let grown = 100000
+
+function listen(server) {
+  return new Promise((resolve) => server.listen(0, '127.0.0.1', () => resolve(server.address().port)))
+}
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms))
+}
+
+function get(port, path, headers = {}, method = 'GET') {
+  return new Promise((resolve, reject) => {
+    const req = http.request({ method, hostname: '127.0.0.1', port, path, headers }, (res) => {
+      const chunks = []
+      res.on('data', (chunk) => chunks.push(chunk))
+      res.on('end', () => resolve({ status: res.statusCode, headers: res.headers, body: Buffer.concat(chunks) }))
+      res.on('error', reject)
+    })
+    req.on('error', reject)
+    req.end()
+  })
+}
+
+async function main() {
+  const upstream = http.createServer(async (req, res) => {
+    const range = req.headers.range
+    if (req.url.startsWith('/slow')) await sleep(1000)
+    const size = req.url.startsWith('/growing') ? grown : SIZE
+    upstreamRanges.push(range || 'none')
+    res.setHeader('Content-Type', 'video/mp4')
+    res.setHeader('Accept-Ranges', 'bytes')
+    if (!range) {
+      res.setHeader('Content-Length', size)
+      res.end(media)
+      return
+    }
+    const [, from, to] = /bytes=(\d*)-(\d*)/.exec(range)
+    const first = from === '' ? size - Number(to) : Number(from)
+    const last = from === '' || to === '' ? size - 1 : Math.min(Number(to), size - 1)
+    res.statusCode = 206
+    res.setHeader('Content-Range', `bytes ${first}-${last}/${size}`)
+    res.setHeader('Content-Length', last - first + 1)
+    res.end(media.subarray(first, last + 1))
+  })
+  const fallback = http.createServer((req, res) => {
+    const body = Buffer.from(`fallback ${req.url}`)
+    res.setHeader('Content-Length', body.byteLength)
+    res.end(body)
+  })
+
+  const upstreamPort = await listen(upstream)
+  const fallbackPort = await listen(fallback)
+
+  const proxy = new CastProxy({ chunkSize: 64 * 1024, maxCachedRange: 256 * 1024 })
+  const port = proxy.listen({ fallbackPort, host: '127.0.0.1' })
+  check('listening', port > 0, true)
+  check('ipv4 upstream only', proxy.addSession('remote', 'http://example.com/video.mp4'), false)
+  check('session added', proxy.addSession('t1', `http://localhost:${upstreamPort}/videos/video.mp4?x=1`), true)
+
+  // Whole file, forwarded
+  let res = await get(port, '/cast/t1')
+  check('full body', [res.status, res.body.equals(media)], [200, true])
+  check('cors header', res.headers['access-control-allow-origin'], '*')
+  check('upstream range', upstreamRanges.pop(), 'none')
+
+  // Small range: fetched through the cache, with read-ahead
+  res = await get(port, '/cast/t1', { range: 'bytes=100-199' })
+  check('range body', [res.status, res.headers['content-range'], res.body.equals(media.subarray(100, 200))], [206, `bytes 100-199/${SIZE}`, true])
+  check('chunk fetch', upstreamRanges.pop(), `bytes=0-${2 * 65536 - 1}`)
+
+  // Overlapping range inside the read-ahead: only the size is asked for
+  res = await get(port, '/cast/t1', { range: 'bytes=65000-70000' })
+  check('cached body', res.body.equals(media.subarray(65000, 70001)), true)
+  check('no new fetch', upstreamRanges.splice(0), ['bytes=0-0'])
+
+  // Tail probe, open-ended but near the end
+  res = await get(port, '/cast/t1', { range: `bytes=${SIZE - 1000}-` })
+  check('tail body', [res.status, res.body.equals(media.subarray(SIZE - 1000))], [206, true])
+  check('tail fetch', upstreamRanges.length, 1)
+  upstreamRanges.length = 0
+
+  res = await get(port, '/cast/t1', { range: 'bytes=-500' })
+  check('suffix from cache', [res.body.equals(media.subarray(SIZE - 500)), upstreamRanges.splice(0)], [true, ['bytes=0-0']])
+
+  // Concurrent overlapping ranges share one fetch
+  const results = await Promise.all([
+    get(port, '/cast/t1', { range: 'bytes=1000000-1050000' }),
+    get(port, '/cast/t1', { range: 'bytes=1040000-1100000' }),
+    get(port, '/cast/t1', { range: 'bytes=1010000-1020000' })
+  ])
+  check('coalesced bodies', [
+    results[0].body.equals(media.subarray(1000000, 1050001)),
+    results[1].body.equals(media.subarray(1040000, 1100001)),
+    results[2].body.equals(media.subarray(1010000, 1020001))
+  ], [true, true, true])
+  check('coalesced fetches', upstreamRanges.filter((range) => range !== 'bytes=0-0').length <= 2, true)
+  upstreamRanges.length = 0
+
+  // Large open range: forwarded as is
+  res = await get(port, '/cast/t1', { range: 'bytes=1000-' })
+  check('open range', [res.status, res.body.equals(media.subarray(1000))], [206, true])
+  check('open range upstream', upstreamRanges.pop(), 'bytes=1000-')
+
+  // HEAD is forwarded without a body
+  res = await get(port, '/cast/t1', {}, 'HEAD')
+  check('head', [res.status, res.headers['content-length'], res.body.byteLength], [200, String(SIZE), 0])
+
+  // Playlists, unknown tokens and unsafe paths go to the fallback server
+  check('playlist', (await get(port, '/cast/t1/index.m3u8')).body.toString(), 'fallback /cast/t1/index.m3u8')
+  check('unknown token', (await get(port, '/cast/nope')).body.toString(), 'fallback /cast/nope')
+  check('dot segments', (await get(port, '/cast/t1/../x')).body.toString(), 'fallback /cast/t1/../x')
+  check('ping', (await get(port, '/cast/ping')).body.toString(), 'fallback /cast/ping')
+
+  // A file that grows between requests: cached ranges report the new size,
+  // and the chunk that ended the file is fetched again
+  check('growing session', proxy.addSession('t2', `http://127.0.0.1:${upstreamPort}/growing.mp4`), true)
+  res = await get(port, '/cast/t2', { range: 'bytes=0-999' })
+  check('growing first', [res.headers['content-range'], res.body.equals(media.subarray(0, 1000))], ['bytes 0-999/100000', true])
+  grown = 200000
+  upstreamRanges.length = 0
+  res = await get(port, '/cast/t2', { range: 'bytes=90000-109999' })
+  check('growing cached', [res.headers['content-range'], res.body.equals(media.subarray(90000, 110000))], ['bytes 90000-109999/200000', true])
+  check('growing refetch', upstreamRanges.splice(0), ['bytes=0-0', `bytes=65536-${3 * 65536 - 1}`])
+  res = await get(port, '/cast/t2', { range: 'bytes=-1000' })
+  check('growing suffix', [res.headers['content-range'], res.body.equals(media.subarray(199000, 200000))], ['bytes 199000-199999/200000', true])
+  proxy.removeSession('t2')
+
+  // A client that hangs up while its fetch is in flight is closed at once
+  check('slow session', proxy.addSession('t3', `http://127.0.0.1:${upstreamPort}/slow.mp4`), true)
+  const req = http.request({ hostname: '127.0.0.1', port, path: '/cast/t3', headers: { range: 'bytes=0-99' } })
+  req.on('error', () => {})
+  req.end()
+  await sleep(100)
+  check('slow waiting', proxy.stats('t3').active, 1)
+  req.destroy()
+  await sleep(100)
+  check('hangup while waiting', proxy.stats('t3').active, 0)
+  proxy.removeSession('t3')
+
+  const stats = proxy.stats('t1')
+  check('session requests', stats.requests, 10)
+  check('cache hits', stats.cacheHits >= 2, true)
+  check('cached bytes', stats.bytesCached > 0 && stats.bytesForwarded > 2 * SIZE, true)
+  check('totals', proxy.stats().bytesTunnelled > 0, true)
+  check('rates', stats.throughput > 0 && stats.cpuTime > 0, true)
+
+  proxy.removeSession('t1')
+  check('removed session', (await get(port, '/cast/t1')).body.toString(), 'fallback /cast/t1')
+  check('removed stats', proxy.stats('t1'), null)
+
+  proxy.close()
+  proxy.destroy()
+  let threw = false
+  try { proxy.stats() } catch { threw = true }
+  check('destroyed proxy throws', threw, true)
+
+  upstream.close()
+  fallback.close()
+  console.log('all tests passed')
+}
+
+main().catch((err) => {
+  console.error(err)
+  if (typeof Bare !== 'undefined') Bare.exit(1)
+  else process.exit(1)
+})
@@ -0,0 +1,122 @@
+/**
+ * Benchmark for bare-embed at dim 384.
+ *
+ *   bare bench.js [hash|encoder] [args...]
+ *
+ * hash: native feature hashing (single and batched) vs the backend's
+ *       previous JS fallback, which re-hashed the whole string once per
+ *       dimension (args: text lengths, default 64 512 4096 characters)
+ * encoder: sentence encoder latency (one short text per call) and
+ *       throughput at several batch sizes and text lengths (args: a model
+ *       file from convert.js; default a random model with MiniLM-L6's
+ *       shape, which costs the same to run)
+ */
+
+const fs = require('bare-fs')
+const { hashEmbed, hashEmbedBatch, SentenceEncoder } = require('./index')
+const { encodeModel, randomModel } = require('./model-file')
+
+const DIMENSION = 384
+
+// The pre-native fallback, verbatim in behaviour
+function oldEmbed(text) {
+  const normalized = text.toLowerCase().trim()
+  const vector = new Float32Array(DIMENSION)
+  for (let i = 0; i < DIMENSION; i++) {
+    let hash = 0
+    for (let j = 0; j < normalized.length; j++) {
+      hash = ((hash << 5) - hash) + normalized.charCodeAt(j) + i
+      hash = hash & hash
+    }
+    vector[i] = (hash % 1000) / 1000 - 0.5
+  }
+  const norm = Math.sqrt(vector.reduce((sum, v) => sum + v * v, 0))
+  if (norm > 0) {
+    for (let i = 0; i < DIMENSION; i++) vector[i] /= norm
+  }
+  return vector
+}
+
+function text(length, seed) {
+  const words = ['video', 'music', 'cooking', 'travel', 'tutorial', 'review', 'live', 'stream', 'gaming', 'news', 'piano', 'guitar']
+  let out = ''
+  let i = seed
+  while (out.length < length) out += words[(i = (i * 7 + 3) % words.length)] + ' '
+  return out.slice(0, length)
+}
+
+function time(fn, iterations) {
+  const start = Date.now()
+  for (let i = 0; i < iterations; i++) fn(i)
+  return (Date.now() - start) / iterations
+}
+
+function benchHash(args) {
+  const lengths = args.map(Number).filter((n) => n > 0)
+
+  console.log(`bare-embed hash bench: dim=${DIMENSION}`)
+  for (const length of lengths.length > 0 ? lengths : [64, 512, 4096]) {
+    const texts = Array.from({ length: 256 }, (_, i) => text(length, i))
+    const nativeMs = time((i) => hashEmbed(texts[i % texts.length], DIMENSION), 2048)
+    const batchMs = time(() => hashEmbedBatch(texts, DIMENSION), 8) / texts.length
+    const oldMs = time((i) => oldEmbed(texts[i % texts.length]), length > 1000 ? 16 : 128)
+    console.log(`chars=${length} | native ${(nativeMs * 1000).toFixed(1)}us/text batch ${(batchMs * 1000).toFixed(1)}us/text | old js ${(oldMs * 1000).toFixed(1)}us/text | speedup ${(oldMs / nativeMs).toFixed(0)}x`)
+  }
+}
+
+function benchEncoder(args) {
+  let path = args[0]
+  let temporary = false
+
+  if (!path) {
+    // MiniLM-L6 shape: 30522 tokens, 6 layers, 384 hidden, 12 heads
+    const vocab = ['[PAD]', '[UNK]', '[CLS]', '[SEP]']
+    const words = ['video', 'music', 'cooking', 'travel', 'tutorial', 'review', 'live', 'stream', 'gaming', 'news', 'piano', 'guitar']
+    for (const word of words) vocab.push(word)
+    while (vocab.length < 30522) vocab.push('w' + vocab.length)
+
+    path = 'bench-model.bin'
+    temporary = true
+    fs.writeFileSync(path, encodeModel(randomModel({ vocab, name: 'random-minilm-l6' })))
+  }
+
+  const encoder = SentenceEncoder.open(path)
+  const stats = encoder.stats()
+  console.log(`bare-embed encoder bench: ${stats.name} dim=${stats.dimension} layers=${stats.layers} kernel=${stats.kernel} threads=${stats.threads}`)
+
+  // Latency: one title-sized text per call
+  const title = text(48, 1)
+  encoder.embed(title)
+  const samples = []
+  for (let i = 0; i < 32; i++) {
+    const start = Date.now()
+    encoder.embed(text(48, i))
+    samples.push(Date.now() - start)
+  }
+  samples.sort((a, b) => a - b)
+  console.log(`latency (${encoder.tokenize(title).length} tokens) | p50 ${samples[16]}ms p90 ${samples[28]}ms`)
+
+  // Throughput: title-sized and description-sized texts
+  for (const length of [48, 400]) {
+    const tokens = encoder.tokenize(text(length, 1)).length
+    for (const batch of [1, 8, 32]) {
+      const texts = Array.from({ length: batch }, (_, i) => text(length, i))
+      const iterations = Math.max(2, Math.round(64 / batch))
+      const ms = time(() => encoder.embedBatch(texts), iterations)
+      console.log(`tokens=${tokens} batch=${batch} | ${ms.toFixed(1)}ms/batch | ${((batch * 1000) / ms).toFixed(1)} texts/s`)
+    }
+  }
+
+  // The hash fallback for scale
+  const hashMs = time((i) => hashEmbed(text(48, i), DIMENSION), 2048)
+  console.log(`hash embed (same title) | ${(hashMs * 1000).toFixed(1)}us/text`)
+
+  encoder.close()
+  if (temporary) fs.unlinkSync(path)
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+const mode = args[0] === 'encoder' || args[0] === 'hash' ? args.shift() : 'hash'
+
+if (mode === 'encoder') benchEncoder(args)
+else benchHash(args)
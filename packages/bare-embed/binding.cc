@@ -0,0 +1,347 @@
+/**
+ * bare-embed - Bare native addon for text embeddings
+ * Feature-hashing embedder: one tokenising pass, murmur3 word / bigram /
+ * char-gram features, SIMD normalisation
+ * Sentence encoder: int8 BERT-style transformer over a mapped model file,
+ * SIMD GEMM on a worker pool
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/encoder.h"
+#include "src/gemm.h"
+#include "src/hash_embed.h"
+#include "src/thread_pool.h"
+
+using bare_embed::Encoder;
+using bare_embed::HashEmbedder;
+using bare_embed::ThreadPool;
+
+// Handle wrapper for Encoder
+typedef struct {
+  Encoder *encoder;
+} bare_embed_encoder_t;
+
+// Read a UTF-8 string argument into `out`
+static bool
+bare_embed__string(js_env_t *env, js_value_t *value, std::string &out) {
+  size_t len;
+  int err = js_get_value_string_utf8(env, value, NULL, 0, &len);
+  if (err != 0) return false;
+
+  out.resize(len + 1);
+  err = js_get_value_string_utf8(env, value, (utf8_t *) &out[0], len + 1, NULL);
+  if (err != 0) return false;
+
+  out.resize(len);
+  return true;
+}
+
+// Read a Float32Array argument holding at least `count` floats
+static float *
+bare_embed__floats(js_env_t *env, js_value_t *value, size_t count) {
+  js_typedarray_type_t type;
+  float *data;
+  size_t len;
+  int err = js_get_typedarray_info(env, value, &type, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_float32array || len < count) {
+    js_throw_error(env, NULL, "Output must be a Float32Array of count x dimension floats");
+    return NULL;
+  }
+
+  return data;
+}
+
+// Embed one text into a caller-provided Float32Array
+static js_value_t *
+bare_embed_hash_embed(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  std::string text;
+  if (!bare_embed__string(env, argv[0], text)) return NULL;
+
+  uint32_t dimension;
+  err = js_get_value_uint32(env, argv[1], &dimension);
+  if (err != 0) return NULL;
+
+  float *out = bare_embed__floats(env, argv[2], dimension);
+  if (out == NULL) return NULL;
+
+  HashEmbedder embedder(dimension);
+  embedder.embed(text.data(), text.size(), out);
+
+  return NULL;
+}
+
+// Embed an array of texts into one row-major matrix; non-strings embed as
+// the empty text (a zero row)
+static js_value_t *
+bare_embed_hash_embed_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t count;
+  err = js_get_array_length(env, argv[0], &count);
+  if (err != 0) return NULL;
+
+  uint32_t dimension;
+  err = js_get_value_uint32(env, argv[1], &dimension);
+  if (err != 0) return NULL;
+
+  float *matrix = bare_embed__floats(env, argv[2], size_t(count) * dimension);
+  if (matrix == NULL) return NULL;
+
+  HashEmbedder embedder(dimension);
+  std::string text;
+
+  for (uint32_t i = 0; i < count; i++) {
+    js_value_t *elem;
+    err = js_get_element(env, argv[0], i, &elem);
+    if (err != 0) return NULL;
+
+    js_value_type_t type;
+    js_typeof(env, elem, &type);
+
+    text.clear();
+    if (type == js_string && !bare_embed__string(env, elem, text)) return NULL;
+
+    embedder.embed(text.data(), text.size(), matrix + size_t(i) * dimension);
+  }
+
+  return NULL;
+}
+
+static bare_embed_encoder_t *
+bare_embed__encoder(js_env_t *env, js_value_t *value) {
+  bare_embed_encoder_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->encoder) {
+    js_throw_error(env, NULL, "Encoder has been closed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Map a model file: (path, maxTokens), returns a new handle
+static js_value_t *
+bare_embed_encoder_open(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  std::string path;
+  if (!bare_embed__string(env, argv[0], path)) return NULL;
+
+  uint32_t max_tokens;
+  err = js_get_value_uint32(env, argv[1], &max_tokens);
+  if (err != 0) return NULL;
+
+  std::string error;
+  std::unique_ptr<Encoder> encoder = Encoder::open(path.c_str(), max_tokens, error);
+  if (!encoder) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_embed_encoder_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_embed_encoder_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->encoder = encoder.release();
+  return result;
+}
+
+// Model shape: { name, dimension, layers, heads, vocab, maxTokens, threads, kernel }
+static js_value_t *
+bare_embed_encoder_info(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_embed_encoder_t *handle = bare_embed__encoder(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  Encoder *encoder = handle->encoder;
+  const bare_embed::model_config_t &config = encoder->model().config();
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+#define SET_STRING(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_string_utf8(env, (const utf8_t *) (value), -1, &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_STRING("name", encoder->model().name().c_str());
+  SET_NUMBER("dimension", encoder->dimension());
+  SET_NUMBER("layers", config.layers);
+  SET_NUMBER("heads", config.heads);
+  SET_NUMBER("vocab", config.vocab);
+  SET_NUMBER("maxTokens", encoder->max_tokens());
+  SET_NUMBER("threads", ThreadPool::shared().concurrency());
+  SET_STRING("kernel", bare_embed::gemm_kernel_name());
+
+#undef SET_STRING
+#undef SET_NUMBER
+
+  return result;
+}
+
+// Token ids of a text, [CLS] and [SEP] included
+static js_value_t *
+bare_embed_encoder_tokenize(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_embed_encoder_t *handle = bare_embed__encoder(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string text;
+  if (!bare_embed__string(env, argv[1], text)) return NULL;
+
+  std::vector<uint32_t> ids;
+  handle->encoder->tokenize(text.data(), text.size(), ids);
+
+  js_value_t *result;
+  err = js_create_array_with_length(env, ids.size(), &result);
+  if (err != 0) return NULL;
+
+  for (size_t i = 0; i < ids.size(); i++) {
+    js_value_t *id;
+    js_create_uint32(env, ids[i], &id);
+    js_set_element(env, result, uint32_t(i), id);
+  }
+
+  return result;
+}
+
+// Embed texts: (handle, texts, matrix) writes texts.length rows of the
+// model dimension into the Float32Array matrix; non-strings embed as ''
+static js_value_t *
+bare_embed_encoder_embed(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_embed_encoder_t *handle = bare_embed__encoder(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  Encoder *encoder = handle->encoder;
+
+  uint32_t count;
+  err = js_get_array_length(env, argv[1], &count);
+  if (err != 0) return NULL;
+
+  float *matrix = bare_embed__floats(env, argv[2], size_t(count) * encoder->dimension());
+  if (matrix == NULL) return NULL;
+
+  std::vector<std::string> texts(count);
+  for (uint32_t i = 0; i < count; i++) {
+    js_value_t *elem;
+    err = js_get_element(env, argv[1], i, &elem);
+    if (err != 0) return NULL;
+
+    js_value_type_t type;
+    js_typeof(env, elem, &type);
+
+    if (type == js_string && !bare_embed__string(env, elem, texts[i])) return NULL;
+  }
+
+  std::vector<std::string_view> views(texts.begin(), texts.end());
+  encoder->embed(views.data(), views.size(), matrix, ThreadPool::shared());
+
+  return NULL;
+}
+
+// Unmap the model; the handle is unusable afterwards
+static js_value_t *
+bare_embed_encoder_close(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_embed_encoder_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->encoder;
+  handle->encoder = NULL;
+
+  return NULL;
+}
+
+static js_value_t *
+bare_embed_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(hashEmbed, bare_embed_hash_embed);
+  EXPORT_FUNCTION(hashEmbedBatch, bare_embed_hash_embed_batch);
+  EXPORT_FUNCTION(encoderOpen, bare_embed_encoder_open);
+  EXPORT_FUNCTION(encoderInfo, bare_embed_encoder_info);
+  EXPORT_FUNCTION(encoderTokenize, bare_embed_encoder_tokenize);
+  EXPORT_FUNCTION(encoderEmbed, bare_embed_encoder_embed);
+  EXPORT_FUNCTION(encoderClose, bare_embed_encoder_close);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_embed, bare_embed_exports)
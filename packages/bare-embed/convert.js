@@ -0,0 +1,115 @@
+/**
+ * Convert a Hugging Face BERT-family sentence embedding model (e.g.
+ * sentence-transformers/all-MiniLM-L6-v2) to the encoder model file.
+ *
+ *   bare convert.js <model dir> <out file> [name]
+ *
+ * The directory needs config.json, vocab.txt and model.safetensors (F32,
+ * F16 or BF16), as downloaded from the hub. Linear layers and the word
+ * embeddings are quantised to int8 per output row; everything else stays
+ * f32. Runs offline.
+ */
+
+const fs = require('bare-fs')
+const { encodeModel } = require('./model-file')
+
+function halfToFloat(h) {
+  const sign = h & 0x8000 ? -1 : 1
+  const exponent = (h >> 10) & 0x1f
+  const fraction = h & 0x3ff
+  if (exponent === 0) return sign * fraction * 2 ** -24
+  if (exponent === 31) return fraction ? NaN : sign * Infinity
+  return sign * (1 + fraction / 1024) * 2 ** (exponent - 15)
+}
+
+/**
+ * Read every tensor of a .safetensors file as a Float32Array
+ * @param {Uint8Array} bytes
+ * @returns {Map<string, Float32Array>}
+ */
+function readSafetensors(bytes) {
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength)
+  const headerLength = Number(view.getBigUint64(0, true))
+  const header = JSON.parse(new TextDecoder().decode(bytes.subarray(8, 8 + headerLength)))
+  const base = 8 + headerLength
+  const tensors = new Map()
+
+  for (const [name, info] of Object.entries(header)) {
+    if (name === '__metadata__') continue
+
+    const [begin, end] = info.data_offsets
+    const count = info.shape.reduce((a, b) => a * b, 1)
+    const out = new Float32Array(count)
+
+    for (let i = 0; i < count; i++) {
+      const at = base + begin + i * (end - begin) / count
+      if (info.dtype === 'F32') out[i] = view.getFloat32(at, true)
+      else if (info.dtype === 'F16') out[i] = halfToFloat(view.getUint16(at, true))
+      else if (info.dtype === 'BF16') out[i] = new Float32Array(new Uint32Array([view.getUint16(at, true) << 16]).buffer)[0]
+      else throw new Error(`Unsupported tensor dtype ${info.dtype} for ${name}`)
+    }
+
+    // Checkpoints saved from BertModel lack the "bert." prefix others have
+    tensors.set(name.replace(/^bert\./, ''), out)
+  }
+
+  return tensors
+}
+
+function convert(dir, name) {
+  const config = JSON.parse(fs.readFileSync(dir + '/config.json', 'utf8'))
+  const vocab = fs.readFileSync(dir + '/vocab.txt', 'utf8').split('\n')
+  while (vocab.length > 0 && vocab[vocab.length - 1] === '') vocab.pop()
+  const tensors = readSafetensors(fs.readFileSync(dir + '/model.safetensors'))
+
+  const tensor = (key) => {
+    const t = tensors.get(key)
+    if (!t) throw new Error(`Missing tensor ${key}`)
+    return t
+  }
+  const pair = (prefix) => ({ weight: tensor(prefix + '.weight'), bias: tensor(prefix + '.bias') })
+
+  if (config.hidden_act && config.hidden_act !== 'gelu') throw new Error(`Unsupported activation ${config.hidden_act}`)
+  if (vocab.length !== config.vocab_size) throw new Error(`vocab.txt has ${vocab.length} tokens, config says ${config.vocab_size}`)
+
+  const layers = []
+  for (let i = 0; i < config.num_hidden_layers; i++) {
+    const p = `encoder.layer.${i}`
+    layers.push({
+      query: pair(`${p}.attention.self.query`),
+      key: pair(`${p}.attention.self.key`),
+      value: pair(`${p}.attention.self.value`),
+      attentionOutput: pair(`${p}.attention.output.dense`),
+      attentionNorm: pair(`${p}.attention.output.LayerNorm`),
+      intermediate: pair(`${p}.intermediate.dense`),
+      output: pair(`${p}.output.dense`),
+      outputNorm: pair(`${p}.output.LayerNorm`)
+    })
+  }
+
+  return encodeModel({
+    name,
+    hidden: config.hidden_size,
+    heads: config.num_attention_heads,
+    intermediate: config.intermediate_size,
+    maxPositions: config.max_position_embeddings,
+    eps: config.layer_norm_eps,
+    vocab,
+    wordEmbeddings: tensor('embeddings.word_embeddings.weight'),
+    positionEmbeddings: tensor('embeddings.position_embeddings.weight'),
+    tokenTypeEmbeddings: tensor('embeddings.token_type_embeddings.weight'),
+    embeddingNorm: pair('embeddings.LayerNorm'),
+    layers
+  })
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+if (args.length < 2) {
+  console.log('usage: bare convert.js <model dir> <out file> [name]')
+} else {
+  const dir = args[0].replace(/\/+$/, '')
+  const name = args[2] || dir.split('/').pop()
+  const file = convert(dir, name)
+  fs.writeFileSync(args[1], file)
+  console.log(`wrote ${args[1]}: ${name}, ${(file.length / 1048576).toFixed(1)} MB`)
+}
@@ -0,0 +1,137 @@
+/**
+ * bare-embed - Native text embeddings
+ * - hashEmbed / hashEmbedBatch: feature-hashing embedder (word, bigram and
+ *   char-gram features hashed with murmur3 into signed buckets), linear in
+ *   the text length and needing no model
+ * - SentenceEncoder: MiniLM-class transformer run on the CPU from a
+ *   memory-mapped int8 model file (see convert.js), batched and threaded
+ */
+
+const binding = require('./binding')
+
+const DEFAULT_DIMENSION = 384
+
+// Names the hashing scheme; indexes record it so vectors from a different
+// scheme are never compared against these
+const HASH_EMBEDDER = 'feature-hash-v1'
+
+/**
+ * Embed one text
+ * @param {string} text
+ * @param {number} [dimension] - Vector size (default 384)
+ * @returns {Float32Array} Unit-length vector (all zeros for text without words)
+ */
+function hashEmbed(text, dimension = DEFAULT_DIMENSION) {
+  const out = new Float32Array(dimension)
+  binding.hashEmbed(typeof text === 'string' ? text : '', dimension, out)
+  return out
+}
+
+/**
+ * Embed many texts in one native call
+ * @param {string[]} texts
+ * @param {number} [dimension] - Vector size (default 384)
+ * @returns {Float32Array[]} One vector per text, views into a shared buffer
+ */
+function hashEmbedBatch(texts, dimension = DEFAULT_DIMENSION) {
+  const matrix = new Float32Array(texts.length * dimension)
+  binding.hashEmbedBatch(texts, dimension, matrix)
+
+  const out = new Array(texts.length)
+  for (let i = 0; i < texts.length; i++) out[i] = matrix.subarray(i * dimension, (i + 1) * dimension)
+  return out
+}
+
+// Tokens per text, [CLS] and [SEP] included (sentence-transformers' MiniLM
+// default; longer texts are truncated)
+const DEFAULT_MAX_TOKENS = 256
+
+/**
+ * Sentence encoder over a model file written by convert.js. Embeddings are
+ * mean-pooled and L2-normalised, matching sentence-transformers.
+ *
+ * Inference runs synchronously on the calling thread plus a shared worker
+ * pool; embed many texts per call to keep the pool busy.
+ */
+class SentenceEncoder {
+  constructor(handle) {
+    this._handle = handle
+    const info = binding.encoderInfo(handle)
+    this.name = info.name
+    this.dimension = info.dimension
+    this.maxTokens = info.maxTokens
+    this._info = info
+  }
+
+  /**
+   * Map a model file
+   * @param {string} path
+   * @param {Object} [opts]
+   * @param {number} [opts.maxTokens] - Tokens per text (default 256, capped
+   *   by the model's position table)
+   * @returns {SentenceEncoder}
+   */
+  static open(path, opts = {}) {
+    return new SentenceEncoder(binding.encoderOpen(path, opts.maxTokens ?? DEFAULT_MAX_TOKENS))
+  }
+
+  _encoder() {
+    if (this._handle === null) throw new Error('Encoder has been closed')
+    return this._handle
+  }
+
+  /**
+   * Embed one text
+   * @param {string} text
+   * @returns {Float32Array}
+   */
+  embed(text) {
+    return this.embedBatch([text])[0]
+  }
+
+  /**
+   * Embed many texts in one pass
+   * @param {string[]} texts
+   * @returns {Float32Array[]} One vector per text, views into a shared buffer
+   */
+  embedBatch(texts) {
+    const dimension = this.dimension
+    const matrix = new Float32Array(texts.length * dimension)
+    if (texts.length > 0) binding.encoderEmbed(this._encoder(), texts, matrix)
+
+    const out = new Array(texts.length)
+    for (let i = 0; i < texts.length; i++) out[i] = matrix.subarray(i * dimension, (i + 1) * dimension)
+    return out
+  }
+
+  /**
+   * WordPiece ids of a text, [CLS] and [SEP] included
+   * @param {string} text
+   * @returns {number[]}
+   */
+  tokenize(text) {
+    return binding.encoderTokenize(this._encoder(), String(text ?? ''))
+  }
+
+  /**
+   * Model shape and runtime
+   * @returns {{name: string, dimension: number, layers: number, heads: number, vocab: number, maxTokens: number, threads: number, kernel: string}}
+   */
+  stats() {
+    return { ...this._info }
+  }
+
+  close() {
+    if (this._handle !== null) {
+      binding.encoderClose(this._handle)
+      this._handle = null
+    }
+  }
+}
+
+module.exports = {
+  HASH_EMBEDDER,
+  hashEmbed,
+  hashEmbedBatch,
+  SentenceEncoder
+}
@@ -0,0 +1,191 @@
+/**
+ * Writer for the encoder model file format (see src/model.h).
+ *
+ * Weights come in PyTorch layout ([out x in] row-major Float32Arrays) and
+ * are quantised here, per output row, to int8. Used by convert.js and to
+ * build random models for test.js / bench.js.
+ */
+
+const MAGIC = 'BEMODEL\0'
+const VERSION = 1
+const HEADER_SIZE = 256
+const NAME_OFFSET = 128
+const ALIGN = 64
+
+const stride = (n) => Math.ceil(n / ALIGN) * ALIGN
+
+/**
+ * Quantise rows symmetrically to [-127, 127]
+ * @param {Float32Array} matrix - rows x cols
+ * @returns {{ codes: Int8Array, scales: Float32Array }} codes padded to stride(cols)
+ */
+function quantizeRows(matrix, rows, cols) {
+  const padded = stride(cols)
+  const codes = new Int8Array(rows * padded)
+  const scales = new Float32Array(rows)
+
+  for (let r = 0; r < rows; r++) {
+    let max = 0
+    for (let i = 0; i < cols; i++) max = Math.max(max, Math.abs(matrix[r * cols + i]))
+    if (max === 0) continue
+
+    scales[r] = max / 127
+    const inverse = 127 / max
+    for (let i = 0; i < cols; i++) codes[r * padded + i] = Math.max(-127, Math.min(127, Math.round(matrix[r * cols + i] * inverse)))
+  }
+
+  return { codes, scales }
+}
+
+/**
+ * Encode a model
+ * @param {Object} model
+ * @param {string} model.name
+ * @param {number} model.hidden
+ * @param {number} model.heads
+ * @param {number} model.intermediate
+ * @param {number} model.maxPositions
+ * @param {number} [model.eps]
+ * @param {string[]} model.vocab
+ * @param {Float32Array} model.wordEmbeddings - vocab x hidden
+ * @param {Float32Array} model.positionEmbeddings - maxPositions x hidden
+ * @param {Float32Array} model.tokenTypeEmbeddings - hidden (type 0)
+ * @param {{weight: Float32Array, bias: Float32Array}} model.embeddingNorm
+ * @param {Object[]} model.layers - { query, key, value, attentionOutput,
+ *   attentionNorm, intermediate, output, outputNorm }, each {weight, bias}
+ * @returns {Uint8Array}
+ */
+function encodeModel(model) {
+  const { hidden, heads, intermediate, maxPositions, vocab, layers } = model
+  const chunks = []
+  let offset = 0
+
+  const push = (bytes) => {
+    chunks.push({ offset, bytes })
+    offset += bytes.byteLength
+  }
+  const align = () => {
+    offset = stride(offset)
+  }
+  const tensor = (array) => {
+    align()
+    push(new Uint8Array(array.buffer, array.byteOffset, array.byteLength))
+  }
+  const linear = ({ weight, bias }, out, inputs) => {
+    const { codes, scales } = quantizeRows(weight, out, inputs)
+    tensor(codes)
+    tensor(scales)
+    tensor(bias)
+  }
+  const norm = ({ weight, bias }) => {
+    tensor(weight)
+    tensor(bias)
+  }
+
+  // Vocab string table
+  const encoder = new TextEncoder()
+  const tokens = vocab.map((token) => encoder.encode(token))
+  const offsets = new BigUint64Array(vocab.length + 1)
+  for (let i = 0; i < tokens.length; i++) offsets[i + 1] = offsets[i] + BigInt(tokens[i].length)
+
+  offset = HEADER_SIZE
+  push(new Uint8Array(offsets.buffer))
+  for (const token of tokens) push(token)
+  const vocabBytes = offset - HEADER_SIZE
+
+  const words = quantizeRows(model.wordEmbeddings, vocab.length, hidden)
+  tensor(words.codes)
+  tensor(words.scales)
+  tensor(model.positionEmbeddings.subarray(0, maxPositions * hidden))
+  tensor(model.tokenTypeEmbeddings.subarray(0, hidden))
+  norm(model.embeddingNorm)
+
+  for (const layer of layers) {
+    // Q, K and V share one GEMM
+    const qkv = {
+      weight: new Float32Array(3 * hidden * hidden),
+      bias: new Float32Array(3 * hidden)
+    }
+    ;[layer.query, layer.key, layer.value].forEach((part, i) => {
+      qkv.weight.set(part.weight, i * hidden * hidden)
+      qkv.bias.set(part.bias, i * hidden)
+    })
+
+    linear(qkv, 3 * hidden, hidden)
+    linear(layer.attentionOutput, hidden, hidden)
+    norm(layer.attentionNorm)
+    linear(layer.intermediate, intermediate, hidden)
+    linear(layer.output, hidden, intermediate)
+    norm(layer.outputNorm)
+  }
+
+  const file = new Uint8Array(offset)
+  for (const chunk of chunks) file.set(chunk.bytes, chunk.offset)
+
+  const view = new DataView(file.buffer)
+  for (let i = 0; i < MAGIC.length; i++) file[i] = MAGIC.charCodeAt(i)
+  view.setUint32(8, VERSION, true)
+  view.setUint32(12, hidden, true)
+  view.setUint32(16, layers.length, true)
+  view.setUint32(20, heads, true)
+  view.setUint32(24, intermediate, true)
+  view.setUint32(28, vocab.length, true)
+  view.setUint32(32, maxPositions, true)
+  view.setFloat32(36, model.eps ?? 1e-12, true)
+  view.setBigUint64(40, BigInt(vocabBytes), true)
+  view.setBigUint64(48, BigInt(file.length), true)
+  file.set(encoder.encode(model.name || '').subarray(0, HEADER_SIZE - NAME_OFFSET - 1), NAME_OFFSET)
+
+  return file
+}
+
+/**
+ * Random model with the given shape (weights ~ N(0, 0.02)-ish, like a
+ * freshly initialised BERT), for tests and benchmarks
+ * @param {Object} opts
+ * @param {string[]} opts.vocab
+ * @returns {Object} model accepted by encodeModel()
+ */
+function randomModel({ vocab, hidden = 384, layers = 6, heads = 12, intermediate = 1536, maxPositions = 512, seed = 1, name = 'random' }) {
+  let state = seed >>> 0
+  const next = () => {
+    state = (state * 1664525 + 1013904223) >>> 0
+    return (state / 0x100000000 - 0.5) * 0.07
+  }
+  const fill = (n) => {
+    const a = new Float32Array(n)
+    for (let i = 0; i < n; i++) a[i] = next()
+    return a
+  }
+  const linear = (out, inputs) => ({ weight: fill(out * inputs), bias: fill(out) })
+  const norm = () => ({ weight: new Float32Array(hidden).fill(1), bias: fill(hidden) })
+
+  return {
+    name,
+    hidden,
+    heads,
+    intermediate,
+    maxPositions,
+    vocab,
+    wordEmbeddings: fill(vocab.length * hidden),
+    positionEmbeddings: fill(maxPositions * hidden),
+    tokenTypeEmbeddings: fill(hidden),
+    embeddingNorm: norm(),
+    layers: Array.from({ length: layers }, () => ({
+      query: linear(hidden, hidden),
+      key: linear(hidden, hidden),
+      value: linear(hidden, hidden),
+      attentionOutput: linear(hidden, hidden),
+      attentionNorm: norm(),
+      intermediate: linear(intermediate, hidden),
+      output: linear(hidden, intermediate),
+      outputNorm: norm()
+    }))
+  }
+}
+
+module.exports = {
+  encodeModel,
+  quantizeRows,
+  randomModel
+}
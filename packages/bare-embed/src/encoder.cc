@@ -0,0 +1,265 @@
+#include "encoder.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "gemm.h"
+#include "hash_embed.h"
+
+namespace bare_embed {
+
+namespace {
+
+// Token rows per embedding / layer norm task
+constexpr size_t row_block = 32;
+
+template <typename Fn>
+void
+for_rows(ThreadPool &pool, size_t rows, Fn fn) {
+  size_t tasks = (rows + row_block - 1) / row_block;
+  pool.run(tasks, [&](size_t task) {
+    size_t end = (task + 1) * row_block < rows ? (task + 1) * row_block : rows;
+    for (size_t r = task * row_block; r < end; r++) fn(r);
+  });
+}
+
+void
+layer_norm(float *x, size_t n, const norm_t &norm, float eps) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) sum += x[i];
+  float mean = float(sum / double(n));
+
+  double var = 0;
+  for (size_t i = 0; i < n; i++) {
+    double d = x[i] - mean;
+    var += d * d;
+  }
+  float inv = float(1.0 / std::sqrt(var / double(n) + eps));
+
+  for (size_t i = 0; i < n; i++) x[i] = (x[i] - mean) * inv * norm.gamma[i] + norm.beta[i];
+}
+
+} // namespace
+
+Encoder::Encoder(std::unique_ptr<Model> model, size_t max_tokens) : model_(std::move(model)), tokenizer_(*model_) {
+  const model_config_t &c = model_->config();
+
+  max_tokens_ = max_tokens < c.max_positions ? max_tokens : c.max_positions;
+  if (max_tokens_ < 2) max_tokens_ = 2;
+
+  hidden_stride_ = model_stride(c.hidden);
+  qkv_stride_ = model_stride(3 * size_t(c.hidden));
+  ffn_stride_ = model_stride(c.intermediate);
+}
+
+std::unique_ptr<Encoder>
+Encoder::open(const char *path, size_t max_tokens, std::string &error) {
+  std::unique_ptr<Model> model = Model::open(path, error);
+  if (!model) return nullptr;
+
+  std::unique_ptr<Encoder> encoder(new Encoder(std::move(model), max_tokens));
+  if (!encoder->tokenizer_.valid()) {
+    error = "Encoder model vocab lacks [CLS], [SEP] or [UNK]";
+    return nullptr;
+  }
+
+  return encoder;
+}
+
+void
+Encoder::tokenize(const char *text, size_t len, std::vector<uint32_t> &ids) const {
+  tokenizer_.encode(text, len, max_tokens_, ids);
+}
+
+void
+Encoder::embed(const std::string_view *texts, size_t count, float *out, ThreadPool &pool) {
+  size_t dimension = this->dimension();
+  size_t done = 0;
+
+  ids_.clear();
+  offsets_.assign(1, 0);
+
+  for (size_t i = 0; i < count; i++) {
+    tokenizer_.encode(texts[i].data(), texts[i].size(), max_tokens_, ids_);
+    offsets_.push_back(uint32_t(ids_.size()));
+
+    if (ids_.size() >= encoder_chunk_tokens || i + 1 == count) {
+      forward(out + done * dimension, pool);
+      done = i + 1;
+      ids_.clear();
+      offsets_.assign(1, 0);
+    }
+  }
+}
+
+void
+Encoder::forward(float *out, ThreadPool &pool) {
+  const model_config_t &c = model_->config();
+  size_t tokens = ids_.size();
+  size_t padded = gemm_padded_rows(tokens);
+  size_t sequences = offsets_.size() - 1;
+
+  // Grow-only scratch
+  if (x_.size() < tokens * hidden_stride_) {
+    x_.resize(tokens * hidden_stride_);
+    ctx_.resize(tokens * hidden_stride_);
+    qkv_.resize(tokens * qkv_stride_);
+    ffn_.resize(tokens * ffn_stride_);
+  }
+  size_t code_stride = hidden_stride_ > ffn_stride_ ? hidden_stride_ : ffn_stride_;
+  if (codes_.size() < padded * code_stride) {
+    codes_.resize(padded * code_stride);
+    code_scales_.resize(padded);
+  }
+  size_t longest = 0;
+  for (size_t s = 0; s < sequences; s++) {
+    size_t len = offsets_[s + 1] - offsets_[s];
+    if (len > longest) longest = len;
+  }
+  // Attention scratch per (sequence, head): K^T, V and a row of scores
+  size_t scratch = longest * (2 * (c.hidden / c.heads) + 1);
+  if (scores_.size() < sequences * c.heads * scratch) scores_.resize(sequences * c.heads * scratch);
+
+  positions_.resize(tokens);
+  for (size_t s = 0; s < sequences; s++) {
+    for (uint32_t t = offsets_[s]; t < offsets_[s + 1]; t++) positions_[t] = t - offsets_[s];
+  }
+
+  embeddings(pool);
+
+  for (const layer_t &layer : model_->layers()) {
+    quantize(x_.data(), c.hidden, hidden_stride_, pool);
+    linear_forward(pool, codes_.data(), code_scales_.data(), tokens, layer.qkv, qkv_.data(), qkv_stride_, activation_none);
+
+    attention(pool);
+
+    quantize(ctx_.data(), c.hidden, hidden_stride_, pool);
+    linear_forward(pool, codes_.data(), code_scales_.data(), tokens, layer.attn_out, ctx_.data(), hidden_stride_, activation_none);
+    residual_norm(ctx_.data(), layer.attn_norm, pool);
+
+    quantize(x_.data(), c.hidden, hidden_stride_, pool);
+    linear_forward(pool, codes_.data(), code_scales_.data(), tokens, layer.ffn_in, ffn_.data(), ffn_stride_, activation_gelu);
+
+    quantize(ffn_.data(), c.intermediate, ffn_stride_, pool);
+    linear_forward(pool, codes_.data(), code_scales_.data(), tokens, layer.ffn_out, ctx_.data(), hidden_stride_, activation_none);
+    residual_norm(ctx_.data(), layer.out_norm, pool);
+  }
+
+  // Mean pooling over each sequence's tokens
+  for (size_t s = 0; s < sequences; s++) {
+    float *v = out + s * c.hidden;
+    std::memset(v, 0, c.hidden * sizeof(float));
+
+    size_t begin = offsets_[s];
+    size_t end = offsets_[s + 1];
+    for (size_t t = begin; t < end; t++) {
+      const float *row = x_.data() + t * hidden_stride_;
+      for (size_t i = 0; i < c.hidden; i++) v[i] += row[i];
+    }
+
+    normalize(v, c.hidden);
+  }
+}
+
+void
+Encoder::embeddings(ThreadPool &pool) {
+  const model_config_t &c = model_->config();
+  const linear_t &words = model_->words();
+  const float *positions = model_->positions();
+  const float *token_type = model_->token_type();
+  const norm_t &norm = model_->embedding_norm();
+
+  for_rows(pool, ids_.size(), [&](size_t t) {
+    uint32_t id = ids_[t] < c.vocab ? ids_[t] : 0;
+    const int8_t *word = words.weights + size_t(id) * words.stride;
+    const float *position = positions + size_t(positions_[t]) * c.hidden;
+    float scale = words.scales[id];
+    float *row = x_.data() + t * hidden_stride_;
+
+    for (size_t i = 0; i < c.hidden; i++) row[i] = float(word[i]) * scale + position[i] + token_type[i];
+    layer_norm(row, c.hidden, norm, c.eps);
+  });
+}
+
+void
+Encoder::attention(ThreadPool &pool) {
+  const model_config_t &c = model_->config();
+  size_t heads = c.heads;
+  size_t head_dim = c.hidden / heads;
+  size_t sequences = offsets_.size() - 1;
+  // Per-task scratch, sized for the longest sequence
+  size_t scratch = scores_.size() / (sequences * heads);
+  float scale = float(1.0 / std::sqrt(double(head_dim)));
+
+  pool.run(sequences * heads, [&](size_t task) {
+    size_t s = task / heads;
+    size_t h = task % heads;
+    size_t begin = offsets_[s];
+    size_t len = offsets_[s + 1] - begin;
+
+    // K transposed (head_dim x len) and V packed (len x head_dim), so both
+    // products below run along contiguous rows and vectorise
+    float *keys = scores_.data() + task * scratch;
+    float *values = keys + head_dim * len;
+    float *scores = values + head_dim * len;
+
+    const float *q_base = qkv_.data() + begin * qkv_stride_ + h * head_dim;
+    const float *k_base = q_base + c.hidden;
+    const float *v_base = q_base + 2 * size_t(c.hidden);
+
+    for (size_t j = 0; j < len; j++) {
+      const float *k = k_base + j * qkv_stride_;
+      const float *v = v_base + j * qkv_stride_;
+      for (size_t d = 0; d < head_dim; d++) keys[d * len + j] = k[d];
+      std::memcpy(values + j * head_dim, v, head_dim * sizeof(float));
+    }
+
+    for (size_t i = 0; i < len; i++) {
+      const float *q = q_base + i * qkv_stride_;
+
+      std::memset(scores, 0, len * sizeof(float));
+      for (size_t d = 0; d < head_dim; d++) axpy_f32(q[d] * scale, keys + d * len, scores, len);
+
+      float max = scores[0];
+      for (size_t j = 1; j < len; j++) max = scores[j] > max ? scores[j] : max;
+
+      float sum = 0;
+      for (size_t j = 0; j < len; j++) {
+        scores[j] = std::exp(scores[j] - max);
+        sum += scores[j];
+      }
+      float inv = 1.0f / sum;
+
+      float *ctx = ctx_.data() + (begin + i) * hidden_stride_ + h * head_dim;
+      std::memset(ctx, 0, head_dim * sizeof(float));
+      for (size_t j = 0; j < len; j++) axpy_f32(scores[j] * inv, values + j * head_dim, ctx, head_dim);
+    }
+  });
+}
+
+void
+Encoder::quantize(const float *x, size_t cols, size_t stride, ThreadPool &pool) {
+  size_t tokens = ids_.size();
+  size_t padded = gemm_padded_rows(tokens);
+
+  quantize_rows(pool, x, tokens, cols, stride, codes_.data(), stride, code_scales_.data());
+
+  // Rows padding out the last group of four take part in the GEMM but are
+  // never stored; keep them zero so they cost nothing odd
+  std::memset(codes_.data() + tokens * stride, 0, (padded - tokens) * stride);
+  for (size_t r = tokens; r < padded; r++) code_scales_[r] = 0;
+}
+
+void
+Encoder::residual_norm(const float *y, const norm_t &norm, ThreadPool &pool) {
+  const model_config_t &c = model_->config();
+
+  for_rows(pool, ids_.size(), [&](size_t t) {
+    float *row = x_.data() + t * hidden_stride_;
+    const float *add = y + t * hidden_stride_;
+    for (size_t i = 0; i < c.hidden; i++) row[i] += add[i];
+    layer_norm(row, c.hidden, norm, c.eps);
+  });
+}
+
+} // namespace bare_embed
@@ -0,0 +1,82 @@
+/**
+ * Sentence encoder: a BERT-style transformer run on the CPU.
+ *
+ * Texts are tokenised, then packed back to back into one token matrix with
+ * no padding: the linear layers (most of the work) see every token of the
+ * batch as one int8 GEMM, while attention runs per sequence and head. The
+ * output is the mean of the last layer's token states, L2-normalised, as
+ * sentence-transformers models expect.
+ *
+ * Batches are cut into chunks of about encoder_chunk_tokens tokens so
+ * scratch memory stays bounded however many texts are passed.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "model.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+
+namespace bare_embed {
+
+constexpr size_t encoder_chunk_tokens = 4096;
+
+class Encoder {
+public:
+  // `max_tokens` per text including [CLS] / [SEP]; clamped to the model's
+  // position table
+  static std::unique_ptr<Encoder> open(const char *path, size_t max_tokens, std::string &error);
+
+  const Model &model() const { return *model_; }
+  size_t dimension() const { return model_->config().hidden; }
+  size_t max_tokens() const { return max_tokens_; }
+
+  // Token ids of one text, [CLS] and [SEP] included
+  void tokenize(const char *text, size_t len, std::vector<uint32_t> &ids) const;
+
+  // Embed `count` texts into `out` (count x dimension floats)
+  void embed(const std::string_view *texts, size_t count, float *out, ThreadPool &pool);
+
+private:
+  Encoder(std::unique_ptr<Model> model, size_t max_tokens);
+
+  // Run the packed sequences in ids_ / offsets_ and pool them into `out`
+  void forward(float *out, ThreadPool &pool);
+
+  void embeddings(ThreadPool &pool);
+  void attention(ThreadPool &pool);
+  void quantize(const float *x, size_t cols, size_t stride, ThreadPool &pool);
+  void residual_norm(const float *y, const norm_t &norm, ThreadPool &pool);
+
+  std::unique_ptr<Model> model_;
+  Tokenizer tokenizer_;
+  size_t max_tokens_;
+
+  // Strides (floats or codes per row) of the scratch matrices
+  size_t hidden_stride_;
+  size_t qkv_stride_;
+  size_t ffn_stride_;
+
+  // Current chunk: token ids and sequence start offsets (one past the end
+  // last)
+  std::vector<uint32_t> ids_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> positions_;
+
+  std::vector<float> x_;
+  std::vector<float> qkv_;
+  std::vector<float> ctx_;
+  std::vector<float> ffn_;
+  std::vector<float> scores_;
+  std::vector<int8_t> codes_;
+  std::vector<float> code_scales_;
+};
+
+} // namespace bare_embed
@@ -0,0 +1,282 @@
+#include "gemm.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BARE_EMBED_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define BARE_EMBED_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace bare_embed {
+
+namespace {
+
+// Output features per task
+constexpr size_t gemm_block = 16;
+
+// Rows per quantisation task
+constexpr size_t quantize_block = 64;
+
+// Four activation rows (`a`, `stride` bytes apart) against two weight rows
+// over `n` codes, `n` a multiple of 64; out[2 * row + weight]
+typedef void (*dot_i8_4x2_fn)(const int8_t *a, size_t stride, const int8_t *w0, const int8_t *w1, size_t n, int32_t *out);
+
+typedef void (*axpy_f32_fn)(float a, const float *x, float *y, size_t n);
+
+void
+dot_i8_4x2_scalar(const int8_t *a, size_t stride, const int8_t *w0, const int8_t *w1, size_t n, int32_t *out) {
+  for (size_t j = 0; j < gemm_rows; j++) {
+    const int8_t *x = a + j * stride;
+    int32_t s0 = 0, s1 = 0;
+    for (size_t i = 0; i < n; i++) {
+      s0 += int32_t(x[i]) * w0[i];
+      s1 += int32_t(x[i]) * w1[i];
+    }
+    out[2 * j] = s0;
+    out[2 * j + 1] = s1;
+  }
+}
+
+void
+axpy_f32_scalar(float a, const float *x, float *y, size_t n) {
+  for (size_t i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+#if defined(BARE_EMBED_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BARE_EMBED_AVX2 1
+
+// maddubs multiplies unsigned by signed bytes, so the weight's sign is
+// moved onto the activation: |w| * (x * sign(w)). Codes are clamped to
+// [-127, 127], so a pair of products (at most 2 * 127 * 127) never
+// saturates the int16 lane.
+__attribute__((target("avx2"), always_inline)) inline __m256i
+dot_i8_step_avx2(__m256i acc, __m256i wa, __m256i ws, __m256i x) {
+  return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(wa, _mm256_sign_epi8(x, ws)), _mm256_set1_epi16(1)));
+}
+
+// 4x2 register block: each activation load feeds two weight rows and each
+// weight load four activation rows
+__attribute__((target("avx2"))) void
+dot_i8_4x2_avx2(const int8_t *a, size_t stride, const int8_t *w0, const int8_t *w1, size_t n, int32_t *out) {
+  const int8_t *a0 = a;
+  const int8_t *a1 = a + stride;
+  const int8_t *a2 = a + 2 * stride;
+  const int8_t *a3 = a + 3 * stride;
+  __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+  __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+  __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+  __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+
+  for (size_t i = 0; i < n; i += 32) {
+    __m256i ws0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(w0 + i));
+    __m256i ws1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(w1 + i));
+    __m256i wa0 = _mm256_sign_epi8(ws0, ws0);
+    __m256i wa1 = _mm256_sign_epi8(ws1, ws1);
+    __m256i x;
+
+    x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a0 + i));
+    c00 = dot_i8_step_avx2(c00, wa0, ws0, x);
+    c01 = dot_i8_step_avx2(c01, wa1, ws1, x);
+    x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a1 + i));
+    c10 = dot_i8_step_avx2(c10, wa0, ws0, x);
+    c11 = dot_i8_step_avx2(c11, wa1, ws1, x);
+    x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a2 + i));
+    c20 = dot_i8_step_avx2(c20, wa0, ws0, x);
+    c21 = dot_i8_step_avx2(c21, wa1, ws1, x);
+    x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a3 + i));
+    c30 = dot_i8_step_avx2(c30, wa0, ws0, x);
+    c31 = dot_i8_step_avx2(c31, wa1, ws1, x);
+  }
+
+  // Horizontal sums of four accumulators at a time, in out[] order
+  __m256i s = _mm256_hadd_epi32(_mm256_hadd_epi32(c00, c01), _mm256_hadd_epi32(c10, c11));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+  s = _mm256_hadd_epi32(_mm256_hadd_epi32(c20, c21), _mm256_hadd_epi32(c30, c31));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+}
+
+__attribute__((target("avx2,fma"))) void
+axpy_f32_avx2(float a, const float *x, float *y, size_t n) {
+  __m256 av = _mm256_set1_ps(a);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+  }
+  for (; i + 8 <= n; i += 8) _mm256_storeu_ps(y + i, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  for (; i < n; i++) y[i] += a * x[i];
+}
+#endif
+
+#if defined(BARE_EMBED_NEON)
+void
+dot_i8_4x2_neon(const int8_t *a, size_t stride, const int8_t *w0, const int8_t *w1, size_t n, int32_t *out) {
+  int32x4_t acc[2 * gemm_rows];
+  for (size_t j = 0; j < 2 * gemm_rows; j++) acc[j] = vdupq_n_s32(0);
+
+  for (size_t i = 0; i < n; i += 16) {
+    int8x16_t wv0 = vld1q_s8(w0 + i);
+    int8x16_t wv1 = vld1q_s8(w1 + i);
+    for (size_t j = 0; j < gemm_rows; j++) {
+      int8x16_t x = vld1q_s8(a + j * stride + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+      acc[2 * j] = vdotq_s32(acc[2 * j], x, wv0);
+      acc[2 * j + 1] = vdotq_s32(acc[2 * j + 1], x, wv1);
+#else
+      // Two widening products of clamped codes still fit an int16 lane
+      int16x8_t p0 = vmlal_s8(vmull_s8(vget_low_s8(x), vget_low_s8(wv0)), vget_high_s8(x), vget_high_s8(wv0));
+      int16x8_t p1 = vmlal_s8(vmull_s8(vget_low_s8(x), vget_low_s8(wv1)), vget_high_s8(x), vget_high_s8(wv1));
+      acc[2 * j] = vpadalq_s16(acc[2 * j], p0);
+      acc[2 * j + 1] = vpadalq_s16(acc[2 * j + 1], p1);
+#endif
+    }
+  }
+
+  for (size_t j = 0; j < 2 * gemm_rows; j++) out[j] = vaddvq_s32(acc[j]);
+}
+
+void
+axpy_f32_neon(float a, const float *x, float *y, size_t n) {
+  float32x4_t av = vdupq_n_f32(a);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), av, vld1q_f32(x + i)));
+    vst1q_f32(y + i + 4, vfmaq_f32(vld1q_f32(y + i + 4), av, vld1q_f32(x + i + 4)));
+  }
+  for (; i < n; i++) y[i] += a * x[i];
+}
+#endif
+
+const char *kernel_name = "scalar";
+
+struct kernels_t {
+  dot_i8_4x2_fn dot_i8_4x2;
+  axpy_f32_fn axpy_f32;
+};
+
+kernels_t
+select_kernels() {
+#if defined(BARE_EMBED_NEON)
+#if defined(__ARM_FEATURE_DOTPROD)
+  kernel_name = "neon-dotprod";
+#else
+  kernel_name = "neon";
+#endif
+  return {dot_i8_4x2_neon, axpy_f32_neon};
+#elif defined(BARE_EMBED_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernel_name = "avx2";
+    return {dot_i8_4x2_avx2, axpy_f32_avx2};
+  }
+  return {dot_i8_4x2_scalar, axpy_f32_scalar};
+#else
+  return {dot_i8_4x2_scalar, axpy_f32_scalar};
+#endif
+}
+
+const kernels_t kernels = select_kernels();
+
+// GELU (erf form) by linear interpolation in a table over [-8, 8]: error
+// below 1e-5, and std::erf per element costs as much as the GEMM itself
+constexpr float gelu_range = 8.0f;
+constexpr size_t gelu_steps_per_unit = 128;
+constexpr size_t gelu_table_size = size_t(2 * gelu_range) * gelu_steps_per_unit + 1;
+
+struct gelu_table_t {
+  float values[gelu_table_size + 1];
+
+  gelu_table_t() {
+    for (size_t i = 0; i <= gelu_table_size; i++) {
+      double x = double(i) / gelu_steps_per_unit - gelu_range;
+      values[i] = float(0.5 * x * (1.0 + std::erf(x * 0.7071067811865476)));
+    }
+  }
+};
+
+const gelu_table_t gelu_table;
+
+inline float
+gelu(float x) {
+  if (x <= -gelu_range) return 0.0f;
+  if (x >= gelu_range) return x;
+
+  float t = (x + gelu_range) * gelu_steps_per_unit;
+  int i = int(t);
+  float f = t - float(i);
+  return gelu_table.values[i] + (gelu_table.values[i + 1] - gelu_table.values[i]) * f;
+}
+
+} // namespace
+
+void
+quantize_rows(ThreadPool &pool, const float *x, size_t rows, size_t cols, size_t x_stride, int8_t *q, size_t q_stride, float *scales) {
+  size_t tasks = (rows + quantize_block - 1) / quantize_block;
+
+  pool.run(tasks, [&](size_t task) {
+    size_t end = (task + 1) * quantize_block < rows ? (task + 1) * quantize_block : rows;
+
+    for (size_t r = task * quantize_block; r < end; r++) {
+      const float *row = x + r * x_stride;
+      int8_t *out = q + r * q_stride;
+
+      float max = 0;
+      for (size_t i = 0; i < cols; i++) max = std::fmax(max, std::fabs(row[i]));
+
+      float scale = max / 127.0f;
+      float inverse = max > 0 ? 127.0f / max : 0.0f;
+      for (size_t i = 0; i < cols; i++) out[i] = int8_t(std::lrintf(row[i] * inverse));
+      std::memset(out + cols, 0, q_stride - cols);
+
+      scales[r] = scale;
+    }
+  });
+}
+
+void
+linear_forward(ThreadPool &pool, const int8_t *x, const float *x_scales, size_t rows, const linear_t &w, float *y, size_t y_stride, activation_t activation) {
+  size_t tasks = (w.out + gemm_block - 1) / gemm_block;
+
+  pool.run(tasks, [&](size_t task) {
+    size_t begin = task * gemm_block;
+    size_t end = begin + gemm_block < w.out ? begin + gemm_block : w.out;
+    int32_t acc[2 * gemm_rows];
+
+    for (size_t r = 0; r < rows; r += gemm_rows) {
+      const int8_t *group = x + r * w.stride;
+      size_t live = rows - r < gemm_rows ? rows - r : gemm_rows;
+
+      for (size_t n = begin; n < end; n += 2) {
+        // An odd last feature is computed twice and stored once
+        size_t n1 = n + 1 < end ? n + 1 : n;
+        kernels.dot_i8_4x2(group, w.stride, w.weights + n * w.stride, w.weights + n1 * w.stride, w.stride, acc);
+
+        for (size_t j = 0; j < live; j++) {
+          float *out = y + (r + j) * y_stride;
+          for (size_t c = 0; c < 2 && n + c < end; c++) {
+            float v = float(acc[2 * j + c]) * x_scales[r + j] * w.scales[n + c] + w.bias[n + c];
+            out[n + c] = activation == activation_gelu ? gelu(v) : v;
+          }
+        }
+      }
+    }
+  });
+}
+
+void
+axpy_f32(float a, const float *x, float *y, size_t n) {
+  kernels.axpy_f32(a, x, y, n);
+}
+
+const char *
+gemm_kernel_name() {
+  return kernel_name;
+}
+
+} // namespace bare_embed
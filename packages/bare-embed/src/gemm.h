@@ -0,0 +1,61 @@
+/**
+ * int8 linear layers.
+ *
+ * Activations are quantised per row (symmetric, scale = max |x| / 127) and
+ * multiplied against the model's per-row quantised weights with int32
+ * accumulation, so a product is exact until the final rescale:
+ *
+ *   y[r][n] = acc(x[r], w[n]) * x_scale[r] * w_scale[n] + bias[n]
+ *
+ * Work is split into blocks of output features run on a ThreadPool; inside
+ * a block each weight row is loaded once for four activation rows. x86
+ * picks an AVX2 kernel at runtime (the addon is built for baseline
+ * x86-64); arm64 uses NEON, with SDOT when built for a CPU that has it.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "model.h"
+#include "thread_pool.h"
+
+namespace bare_embed {
+
+// Activation rows are processed in groups of this many; buffers handed to
+// linear_forward() hold a whole number of groups
+constexpr size_t gemm_rows = 4;
+
+inline size_t
+gemm_padded_rows(size_t rows) {
+  return (rows + gemm_rows - 1) / gemm_rows * gemm_rows;
+}
+
+enum activation_t {
+  activation_none,
+  activation_gelu,
+};
+
+// Quantise `rows` rows of `cols` floats (`x_stride` apart) into int8 rows
+// `q_stride` apart, zero-filling the padding, with one scale per row
+void
+quantize_rows(ThreadPool &pool, const float *x, size_t rows, size_t cols, size_t x_stride, int8_t *q, size_t q_stride, float *scales);
+
+// y = activation(x W^T * scales + bias) for `rows` rows. `x` holds
+// gemm_padded_rows(rows) rows of w.stride codes with their scales (rows
+// past `rows` zeroed); `y` receives `rows` rows of w.out floats,
+// `y_stride` apart
+void
+linear_forward(ThreadPool &pool, const int8_t *x, const float *x_scales, size_t rows, const linear_t &w, float *y, size_t y_stride, activation_t activation);
+
+// y[0..n) += a * x[0..n), any n (attention's score and value rows)
+void
+axpy_f32(float a, const float *x, float *y, size_t n);
+
+// Name of the kernel picked at load time ("avx2", "neon-dotprod", "neon"
+// or "scalar")
+const char *
+gemm_kernel_name();
+
+} // namespace bare_embed
@@ -0,0 +1,136 @@
+#include "hash_embed.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "murmur3.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BARE_EMBED_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define BARE_EMBED_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace bare_embed {
+
+namespace {
+
+constexpr double bigram_weight = 0.5;
+constexpr size_t min_gram = 3;
+constexpr size_t max_gram = 5;
+
+inline bool
+is_word_byte(uint8_t c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+inline uint8_t
+lower(uint8_t c) {
+  return c >= 'A' && c <= 'Z' ? uint8_t(c + 32) : c;
+}
+
+} // namespace
+
+void
+HashEmbedder::add(float *out, uint32_t hash, double weight) const {
+  size_t i = size_t((uint64_t(hash) * dimension_) >> 32);
+  // Accumulate in double and round once, as the JS fallback does
+  out[i] = float(double(out[i]) + ((hash & 1) ? -weight : weight));
+}
+
+void
+HashEmbedder::embed(const char *text, size_t len, float *out) {
+  std::memset(out, 0, dimension_ * sizeof(float));
+
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(text);
+  bool has_prev = false;
+  uint32_t prev = 0;
+  size_t i = 0;
+
+  while (i < len) {
+    while (i < len && !is_word_byte(bytes[i])) i++;
+    if (i == len) break;
+
+    // "<word>", lowercased
+    word_.clear();
+    word_.push_back('<');
+    while (i < len && is_word_byte(bytes[i])) word_.push_back(lower(bytes[i++]));
+    word_.push_back('>');
+
+    const uint8_t *word = word_.data() + 1;
+    size_t word_len = word_.size() - 2;
+
+    uint32_t hash = murmur3_32(word, word_len, 0);
+    add(out, hash, 1.0);
+    if (has_prev) add(out, murmur3_32(word, word_len, prev), bigram_weight);
+    prev = hash;
+    has_prev = true;
+
+    size_t grams = 0;
+    for (size_t n = min_gram; n <= max_gram; n++) {
+      if (word_.size() >= n) grams += word_.size() - n + 1;
+    }
+    if (grams == 0) continue;
+
+    double weight = 1.0 / std::sqrt(double(grams));
+    for (size_t n = min_gram; n <= max_gram; n++) {
+      for (size_t start = 0; start + n <= word_.size(); start++) {
+        add(out, murmur3_32(word_.data() + start, n, uint32_t(n)), weight);
+      }
+    }
+  }
+
+  normalize(out, dimension_);
+}
+
+void
+normalize(float *v, size_t n) {
+  size_t i = 0;
+  float sum = 0;
+
+#if defined(BARE_EMBED_NEON)
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t a = vld1q_f32(v + i);
+    float32x4_t b = vld1q_f32(v + i + 4);
+    acc0 = vfmaq_f32(acc0, a, a);
+    acc1 = vfmaq_f32(acc1, b, b);
+  }
+  sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#elif defined(BARE_EMBED_SSE2)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    __m128 a = _mm_loadu_ps(v + i);
+    __m128 b = _mm_loadu_ps(v + i + 4);
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+  for (; i < n; i++) sum += v[i] * v[i];
+  if (sum <= 0) return;
+
+  float scale = float(1.0 / std::sqrt(double(sum)));
+  i = 0;
+
+#if defined(BARE_EMBED_NEON)
+  float32x4_t s = vdupq_n_f32(scale);
+  for (; i + 4 <= n; i += 4) vst1q_f32(v + i, vmulq_f32(vld1q_f32(v + i), s));
+#elif defined(BARE_EMBED_SSE2)
+  __m128 s = _mm_set1_ps(scale);
+  for (; i + 4 <= n; i += 4) _mm_storeu_ps(v + i, _mm_mul_ps(_mm_loadu_ps(v + i), s));
+#endif
+
+  for (; i < n; i++) v[i] *= scale;
+}
+
+} // namespace bare_embed
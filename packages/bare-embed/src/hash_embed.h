@@ -0,0 +1,51 @@
+/**
+ * Feature-hashing text embedder.
+ *
+ * The text is tokenised once (runs of ASCII letters/digits and non-ASCII
+ * UTF-8 bytes, ASCII lowercased) and every token contributes three kinds of
+ * feature:
+ *
+ *   word        murmur3(word, seed 0), weight 1
+ *   bigram      murmur3(word, seed = previous word's hash), weight 0.5
+ *   char grams  murmur3 of each 3/4/5-byte gram of "<word>", seed = n,
+ *               weight 1 / sqrt(grams in the word)
+ *
+ * A feature hash h lands in dimension (h * dimension) >> 32 with sign
+ * (h & 1 ? -1 : +1), so collisions cancel out on average instead of piling
+ * up. The vector is then L2-normalised. Cost is linear in the text length.
+ *
+ * The backend's JS fallback implements the same scheme; accumulation is
+ * done in the same order and precision, so both produce the same vector up
+ * to rounding in the final normalisation.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bare_embed {
+
+class HashEmbedder {
+public:
+  explicit HashEmbedder(size_t dimension) : dimension_(dimension) {}
+
+  size_t dimension() const { return dimension_; }
+
+  // Embed `len` bytes of UTF-8 text into `out` (dimension() floats)
+  void embed(const char *text, size_t len, float *out);
+
+private:
+  void add(float *out, uint32_t hash, double weight) const;
+
+  size_t dimension_;
+  // "<word>" for char grams, reused across calls
+  std::vector<uint8_t> word_;
+};
+
+// Scale `n` floats to unit length; zero vectors stay zero
+void
+normalize(float *v, size_t n);
+
+} // namespace bare_embed
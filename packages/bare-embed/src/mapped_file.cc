@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bare_embed {
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void
+MappedFile::close() {
+  if (data_ != nullptr) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    munmap(data_, size_);
+#endif
+  }
+
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool
+MappedFile::open(const char *path, std::string &error) {
+  close();
+
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    error = "Could not open model file";
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    error = "Model file is empty";
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    error = "Could not map model file";
+    return false;
+  }
+
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == NULL) {
+    CloseHandle(mapping);
+    error = "Could not map model file";
+    return false;
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<uint8_t *>(data);
+  size_ = size_t(size.QuadPart);
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    error = "Could not open model file";
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    error = "Model file is empty";
+    return false;
+  }
+
+  void *data = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error = "Could not map model file";
+    return false;
+  }
+
+  data_ = static_cast<uint8_t *>(data);
+  size_ = size_t(st.st_size);
+#endif
+
+  return true;
+}
+
+} // namespace bare_embed
@@ -0,0 +1,40 @@
+/**
+ * Read-only file mapping.
+ *
+ * Pages are faulted in lazily on first touch and shared with the page
+ * cache, so a model file costs no heap and only the parts actually used
+ * stay resident.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bare_embed {
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile();
+
+  bool open(const char *path, std::string &error);
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  void close();
+
+  uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void *mapping_ = nullptr;
+#endif
+};
+
+} // namespace bare_embed
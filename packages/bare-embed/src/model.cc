@@ -0,0 +1,167 @@
+#include "model.h"
+
+#include <cstring>
+
+namespace bare_embed {
+
+namespace {
+
+const char model_magic[8] = {'B', 'E', 'M', 'O', 'D', 'E', 'L', '\0'};
+
+template <typename T>
+T
+read_le(const uint8_t *p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T)); // little-endian targets only
+  return v;
+}
+
+// Hands out 64-byte aligned tensors in file order, failing once the file
+// runs out
+class Cursor {
+public:
+  Cursor(const uint8_t *data, size_t size, size_t offset) : data_(data), size_(size), offset_(offset) {}
+
+  bool ok() const { return ok_; }
+  size_t offset() const { return offset_; }
+
+  template <typename T>
+  const T *take(size_t count) {
+    size_t start = model_stride(offset_);
+    size_t bytes = count * sizeof(T);
+    if (!ok_ || start > size_ || bytes > size_ - start) {
+      ok_ = false;
+      return nullptr;
+    }
+    offset_ = start + bytes;
+    return reinterpret_cast<const T *>(data_ + start);
+  }
+
+  linear_t linear(uint32_t out, uint32_t in) {
+    linear_t l;
+    l.out = out;
+    l.in = in;
+    l.stride = uint32_t(model_stride(in));
+    l.weights = take<int8_t>(size_t(out) * l.stride);
+    l.scales = take<float>(out);
+    l.bias = take<float>(out);
+    return l;
+  }
+
+  norm_t norm(uint32_t n) {
+    norm_t m;
+    m.gamma = take<float>(n);
+    m.beta = take<float>(n);
+    return m;
+  }
+
+private:
+  const uint8_t *data_;
+  size_t size_;
+  size_t offset_;
+  bool ok_ = true;
+};
+
+} // namespace
+
+std::unique_ptr<Model>
+Model::open(const char *path, std::string &error) {
+  std::unique_ptr<Model> model(new Model());
+  if (!model->file_.open(path, error)) return nullptr;
+  if (!model->parse(error)) return nullptr;
+  return model;
+}
+
+bool
+Model::parse(std::string &error) {
+  const uint8_t *data = file_.data();
+  size_t size = file_.size();
+
+  if (size < model_header_size || std::memcmp(data, model_magic, sizeof(model_magic)) != 0) {
+    error = "Not an encoder model file";
+    return false;
+  }
+
+  if (read_le<uint32_t>(data + 8) != model_file_version) {
+    error = "Unsupported encoder model version";
+    return false;
+  }
+
+  config_.hidden = read_le<uint32_t>(data + 12);
+  config_.layers = read_le<uint32_t>(data + 16);
+  config_.heads = read_le<uint32_t>(data + 20);
+  config_.intermediate = read_le<uint32_t>(data + 24);
+  config_.vocab = read_le<uint32_t>(data + 28);
+  config_.max_positions = read_le<uint32_t>(data + 32);
+  config_.eps = read_le<float>(data + 36);
+  uint64_t vocab_bytes = read_le<uint64_t>(data + 40);
+  uint64_t file_bytes = read_le<uint64_t>(data + 48);
+
+  const model_config_t &c = config_;
+  if (c.hidden == 0 || c.layers == 0 || c.heads == 0 || c.hidden % c.heads != 0 || c.intermediate == 0 || c.vocab == 0 || c.max_positions < 2) {
+    error = "Invalid encoder model config";
+    return false;
+  }
+
+  if (file_bytes != size) {
+    error = "Encoder model file is truncated";
+    return false;
+  }
+
+  const char *name = reinterpret_cast<const char *>(data + 128);
+  name_.assign(name, strnlen(name, model_header_size - 128));
+
+  // Vocab string table
+  size_t offsets_bytes = (size_t(c.vocab) + 1) * sizeof(uint64_t);
+  if (vocab_bytes < offsets_bytes || vocab_bytes > size - model_header_size) {
+    error = "Invalid encoder model vocab";
+    return false;
+  }
+
+  vocab_offsets_ = reinterpret_cast<const uint64_t *>(data + model_header_size);
+  vocab_bytes_ = reinterpret_cast<const char *>(data + model_header_size + offsets_bytes);
+  uint64_t payload = vocab_bytes - offsets_bytes;
+  for (uint32_t i = 0; i < c.vocab; i++) {
+    if (vocab_offsets_[i] > vocab_offsets_[i + 1] || vocab_offsets_[i + 1] > payload) {
+      error = "Invalid encoder model vocab";
+      return false;
+    }
+  }
+
+  Cursor cursor(data, size, model_header_size + vocab_bytes);
+
+  words_.out = c.vocab;
+  words_.in = c.hidden;
+  words_.stride = uint32_t(model_stride(c.hidden));
+  words_.weights = cursor.take<int8_t>(size_t(c.vocab) * words_.stride);
+  words_.scales = cursor.take<float>(c.vocab);
+
+  positions_ = cursor.take<float>(size_t(c.max_positions) * c.hidden);
+  token_type_ = cursor.take<float>(c.hidden);
+  embedding_norm_ = cursor.norm(c.hidden);
+
+  layers_.resize(c.layers);
+  for (layer_t &layer : layers_) {
+    layer.qkv = cursor.linear(3 * c.hidden, c.hidden);
+    layer.attn_out = cursor.linear(c.hidden, c.hidden);
+    layer.attn_norm = cursor.norm(c.hidden);
+    layer.ffn_in = cursor.linear(c.intermediate, c.hidden);
+    layer.ffn_out = cursor.linear(c.hidden, c.intermediate);
+    layer.out_norm = cursor.norm(c.hidden);
+  }
+
+  if (!cursor.ok() || cursor.offset() != size) {
+    error = "Encoder model tensors do not match its config";
+    return false;
+  }
+
+  return true;
+}
+
+std::string_view
+Model::token(uint32_t id) const {
+  if (id >= config_.vocab) return std::string_view();
+  return std::string_view(vocab_bytes_ + vocab_offsets_[id], size_t(vocab_offsets_[id + 1] - vocab_offsets_[id]));
+}
+
+} // namespace bare_embed
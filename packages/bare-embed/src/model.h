@@ -0,0 +1,121 @@
+/**
+ * On-disk encoder model (version 1, little endian).
+ *
+ *   header   256 bytes: magic "BEMODEL\0", version, hidden size, layers,
+ *            attention heads, intermediate size, vocab size, max positions,
+ *            layer norm epsilon, vocab section bytes, total file bytes and
+ *            the model name (NUL-padded, at offset 128)
+ *   vocab    u64 offsets[vocab + 1] relative to the end of the array, then
+ *            the WordPiece token bytes ("##" marks a continuation piece)
+ *   tensors  in the order below, each starting on a 64-byte boundary:
+ *
+ *     word embeddings     int8 [vocab x stride(hidden)], f32 scales [vocab]
+ *     position embeddings f32 [max positions x hidden]
+ *     token type 0        f32 [hidden]
+ *     embedding norm      f32 gamma [hidden], beta [hidden]
+ *     per layer           qkv linear (3 hidden x hidden), attention output
+ *                         linear (hidden x hidden), attention norm, ffn in
+ *                         linear (intermediate x hidden), ffn out linear
+ *                         (hidden x intermediate), output norm
+ *
+ * A linear is int8 weights [out x stride(in)] quantised symmetrically per
+ * output row to [-127, 127], one f32 scale per row and an f32 bias [out].
+ * stride(n) rounds n up to 64 so kernels never need a scalar tail.
+ *
+ * The file is used straight from a read-only mapping; nothing is copied
+ * except the vocab lookup table.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace bare_embed {
+
+constexpr uint32_t model_file_version = 1;
+constexpr size_t model_header_size = 256;
+constexpr size_t model_align = 64;
+
+inline size_t
+model_stride(size_t n) {
+  return (n + model_align - 1) / model_align * model_align;
+}
+
+struct model_config_t {
+  uint32_t hidden = 0;
+  uint32_t layers = 0;
+  uint32_t heads = 0;
+  uint32_t intermediate = 0;
+  uint32_t vocab = 0;
+  uint32_t max_positions = 0;
+  float eps = 1e-12f;
+};
+
+// y = (W x) * scale + bias, W int8 [out x stride]
+struct linear_t {
+  const int8_t *weights = nullptr;
+  const float *scales = nullptr;
+  const float *bias = nullptr;
+  uint32_t out = 0;
+  uint32_t in = 0;
+  uint32_t stride = 0;
+};
+
+struct norm_t {
+  const float *gamma = nullptr;
+  const float *beta = nullptr;
+};
+
+struct layer_t {
+  linear_t qkv;
+  linear_t attn_out;
+  norm_t attn_norm;
+  linear_t ffn_in;
+  linear_t ffn_out;
+  norm_t out_norm;
+};
+
+class Model {
+public:
+  static std::unique_ptr<Model> open(const char *path, std::string &error);
+
+  const model_config_t &config() const { return config_; }
+  const std::string &name() const { return name_; }
+
+  uint32_t vocab_size() const { return config_.vocab; }
+  std::string_view token(uint32_t id) const;
+
+  // Word embedding rows (bias unused)
+  const linear_t &words() const { return words_; }
+  const float *positions() const { return positions_; }
+  const float *token_type() const { return token_type_; }
+  const norm_t &embedding_norm() const { return embedding_norm_; }
+  const std::vector<layer_t> &layers() const { return layers_; }
+
+private:
+  Model() = default;
+
+  bool parse(std::string &error);
+
+  MappedFile file_;
+  model_config_t config_;
+  std::string name_;
+
+  const uint64_t *vocab_offsets_ = nullptr;
+  const char *vocab_bytes_ = nullptr;
+
+  linear_t words_;
+  const float *positions_ = nullptr;
+  const float *token_type_ = nullptr;
+  norm_t embedding_norm_;
+  std::vector<layer_t> layers_;
+};
+
+} // namespace bare_embed
@@ -0,0 +1,64 @@
+/**
+ * MurmurHash3 x86_32 (Austin Appleby, public domain).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace bare_embed {
+
+inline uint32_t
+rotl32(uint32_t x, int r) {
+  return (x << r) | (x >> (32 - r));
+}
+
+inline uint32_t
+murmur3_32(const uint8_t *data, size_t len, uint32_t seed) {
+  const uint32_t c1 = 0xcc9e2d51;
+  const uint32_t c2 = 0x1b873593;
+
+  uint32_t h = seed;
+  size_t blocks = len / 4;
+
+  for (size_t i = 0; i < blocks; i++) {
+    uint32_t k;
+    std::memcpy(&k, data + i * 4, 4); // little-endian targets only
+    k *= c1;
+    k = rotl32(k, 15);
+    k *= c2;
+
+    h ^= k;
+    h = rotl32(h, 13);
+    h = h * 5 + 0xe6546b64;
+  }
+
+  const uint8_t *tail = data + blocks * 4;
+  uint32_t k = 0;
+  switch (len & 3) {
+  case 3:
+    k ^= uint32_t(tail[2]) << 16;
+    // fallthrough
+  case 2:
+    k ^= uint32_t(tail[1]) << 8;
+    // fallthrough
+  case 1:
+    k ^= tail[0];
+    k *= c1;
+    k = rotl32(k, 15);
+    k *= c2;
+    h ^= k;
+  }
+
+  h ^= uint32_t(len);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+} // namespace bare_embed
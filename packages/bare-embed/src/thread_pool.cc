@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+
+namespace bare_embed {
+
+namespace {
+
+// Beyond this, extra workers mostly contend for memory bandwidth (and on
+// phones land on efficiency cores)
+constexpr size_t max_shared_workers = 7;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+  workers_.reserve(threads);
+  for (size_t i = 0; i < threads; i++) workers_.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+void
+ThreadPool::drain() {
+  size_t i;
+  while ((i = next_.fetch_add(1, std::memory_order_relaxed)) < tasks_) (*fn_)(i);
+}
+
+void
+ThreadPool::work() {
+  uint64_t seen = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) return;
+      seen = generation_;
+    }
+
+    drain();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--active_ == 0) done_.notify_one();
+  }
+}
+
+void
+ThreadPool::run(size_t tasks, const std::function<void(size_t)> &fn) {
+  if (workers_.empty() || tasks <= 1) {
+    for (size_t i = 0; i < tasks; i++) fn(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    tasks_ = tasks;
+    next_.store(0, std::memory_order_relaxed);
+    active_ = workers_.size();
+    generation_++;
+  }
+  wake_.notify_all();
+
+  drain();
+
+  // Every worker has to check in, even one that found no task left, before
+  // fn_ can go out of scope
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&] { return active_ == 0; });
+  fn_ = nullptr;
+}
+
+ThreadPool &
+ThreadPool::shared() {
+  // Never destroyed: joining workers from a static destructor can deadlock
+  // while the addon is being unloaded, and the OS reaps them at exit anyway
+  static ThreadPool *pool = [] {
+    size_t cores = std::thread::hardware_concurrency();
+    size_t workers = cores > 1 ? cores - 1 : 0;
+    return new ThreadPool(workers < max_shared_workers ? workers : max_shared_workers);
+  }();
+  return *pool;
+}
+
+} // namespace bare_embed
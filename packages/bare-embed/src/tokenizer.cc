@@ -0,0 +1,225 @@
+#include "tokenizer.h"
+
+namespace bare_embed {
+
+namespace {
+
+// Words longer than this become a single [UNK], as in BERT
+constexpr size_t max_word_chars = 100;
+
+// Lowercase + accent strip of U+00C0-U+024F (NFD, marks dropped), generated
+// from the Unicode character database
+const uint16_t latin_fold[] = {
+  0x061, 0x061, 0x061, 0x061, 0x061, 0x061, 0x0e6, 0x063, 0x065, 0x065, 0x065, 0x065,
+  0x069, 0x069, 0x069, 0x069, 0x0f0, 0x06e, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x0d7,
+  0x0f8, 0x075, 0x075, 0x075, 0x075, 0x079, 0x0fe, 0x0df, 0x061, 0x061, 0x061, 0x061,
+  0x061, 0x061, 0x0e6, 0x063, 0x065, 0x065, 0x065, 0x065, 0x069, 0x069, 0x069, 0x069,
+  0x0f0, 0x06e, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x0f7, 0x0f8, 0x075, 0x075, 0x075,
+  0x075, 0x079, 0x0fe, 0x079, 0x061, 0x061, 0x061, 0x061, 0x061, 0x061, 0x063, 0x063,
+  0x063, 0x063, 0x063, 0x063, 0x063, 0x063, 0x064, 0x064, 0x111, 0x111, 0x065, 0x065,
+  0x065, 0x065, 0x065, 0x065, 0x065, 0x065, 0x065, 0x065, 0x067, 0x067, 0x067, 0x067,
+  0x067, 0x067, 0x067, 0x067, 0x068, 0x068, 0x127, 0x127, 0x069, 0x069, 0x069, 0x069,
+  0x069, 0x069, 0x069, 0x069, 0x069, 0x131, 0x133, 0x133, 0x06a, 0x06a, 0x06b, 0x06b,
+  0x138, 0x06c, 0x06c, 0x06c, 0x06c, 0x06c, 0x06c, 0x140, 0x140, 0x142, 0x142, 0x06e,
+  0x06e, 0x06e, 0x06e, 0x06e, 0x06e, 0x149, 0x14b, 0x14b, 0x06f, 0x06f, 0x06f, 0x06f,
+  0x06f, 0x06f, 0x153, 0x153, 0x072, 0x072, 0x072, 0x072, 0x072, 0x072, 0x073, 0x073,
+  0x073, 0x073, 0x073, 0x073, 0x073, 0x073, 0x074, 0x074, 0x074, 0x074, 0x167, 0x167,
+  0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075,
+  0x077, 0x077, 0x079, 0x079, 0x079, 0x07a, 0x07a, 0x07a, 0x07a, 0x07a, 0x07a, 0x17f,
+  0x180, 0x253, 0x183, 0x183, 0x185, 0x185, 0x254, 0x188, 0x188, 0x256, 0x257, 0x18c,
+  0x18c, 0x18d, 0x1dd, 0x259, 0x25b, 0x192, 0x192, 0x260, 0x263, 0x195, 0x269, 0x268,
+  0x199, 0x199, 0x19a, 0x19b, 0x26f, 0x272, 0x19e, 0x275, 0x06f, 0x06f, 0x1a3, 0x1a3,
+  0x1a5, 0x1a5, 0x280, 0x1a8, 0x1a8, 0x283, 0x1aa, 0x1ab, 0x1ad, 0x1ad, 0x288, 0x075,
+  0x075, 0x28a, 0x28b, 0x1b4, 0x1b4, 0x1b6, 0x1b6, 0x292, 0x1b9, 0x1b9, 0x1ba, 0x1bb,
+  0x1bd, 0x1bd, 0x1be, 0x1bf, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c6, 0x1c6, 0x1c6, 0x1c9,
+  0x1c9, 0x1c9, 0x1cc, 0x1cc, 0x1cc, 0x061, 0x061, 0x069, 0x069, 0x06f, 0x06f, 0x075,
+  0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x075, 0x1dd, 0x061, 0x061,
+  0x061, 0x061, 0x0e6, 0x0e6, 0x1e5, 0x1e5, 0x067, 0x067, 0x06b, 0x06b, 0x06f, 0x06f,
+  0x06f, 0x06f, 0x292, 0x292, 0x06a, 0x1f3, 0x1f3, 0x1f3, 0x067, 0x067, 0x195, 0x1bf,
+  0x06e, 0x06e, 0x061, 0x061, 0x0e6, 0x0e6, 0x0f8, 0x0f8, 0x061, 0x061, 0x061, 0x061,
+  0x065, 0x065, 0x065, 0x065, 0x069, 0x069, 0x069, 0x069, 0x06f, 0x06f, 0x06f, 0x06f,
+  0x072, 0x072, 0x072, 0x072, 0x075, 0x075, 0x075, 0x075, 0x073, 0x073, 0x074, 0x074,
+  0x21d, 0x21d, 0x068, 0x068, 0x19e, 0x221, 0x223, 0x223, 0x225, 0x225, 0x061, 0x061,
+  0x065, 0x065, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x06f, 0x079, 0x079,
+  0x234, 0x235, 0x236, 0x237, 0x238, 0x239, 0x2c65, 0x23c, 0x23c, 0x19a, 0x2c66, 0x23f,
+  0x240, 0x242, 0x242, 0x180, 0x289, 0x28c, 0x247, 0x247, 0x249, 0x249, 0x24b, 0x24b,
+  0x24d, 0x24d, 0x24f, 0x24f,};
+
+// Decode one UTF-8 sequence at `p`; malformed bytes decode as U+FFFD
+uint32_t
+next_codepoint(const uint8_t *&p, const uint8_t *end) {
+  uint32_t c = *p++;
+  if (c < 0x80) return c;
+
+  size_t extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+  if (extra == 0 || size_t(end - p) < extra) return 0xfffd;
+
+  c &= 0x3f >> extra;
+  for (size_t i = 0; i < extra; i++) {
+    if ((*p & 0xc0) != 0x80) return 0xfffd;
+    c = (c << 6) | (*p++ & 0x3f);
+  }
+  return c;
+}
+
+void
+append_utf8(std::string &out, uint32_t c) {
+  if (c < 0x80) {
+    out.push_back(char(c));
+  } else if (c < 0x800) {
+    out.push_back(char(0xc0 | (c >> 6)));
+    out.push_back(char(0x80 | (c & 0x3f)));
+  } else if (c < 0x10000) {
+    out.push_back(char(0xe0 | (c >> 12)));
+    out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+    out.push_back(char(0x80 | (c & 0x3f)));
+  } else {
+    out.push_back(char(0xf0 | (c >> 18)));
+    out.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+    out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+    out.push_back(char(0x80 | (c & 0x3f)));
+  }
+}
+
+bool
+is_whitespace(uint32_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == 0xa0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200a) || c == 0x202f || c == 0x205f || c == 0x3000;
+}
+
+bool
+is_control(uint32_t c) {
+  return c < 0x20 || (c >= 0x7f && c <= 0x9f) || c == 0xfffd || (c >= 0x200b && c <= 0x200f) || c == 0xfeff;
+}
+
+bool
+is_punctuation(uint32_t c) {
+  // BERT treats all non-alphanumeric ASCII as punctuation
+  if ((c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) || (c >= 123 && c <= 126)) return true;
+  return c == 0xa1 || c == 0xa7 || c == 0xab || c == 0xb6 || c == 0xb7 || c == 0xbb || c == 0xbf || (c >= 0x2010 && c <= 0x2027) || (c >= 0x2030 && c <= 0x205e) || (c >= 0x3001 && c <= 0x3003) || (c >= 0x3008 && c <= 0x3011) || (c >= 0xff01 && c <= 0xff0f);
+}
+
+bool
+is_cjk(uint32_t c) {
+  return (c >= 0x4e00 && c <= 0x9fff) || (c >= 0x3400 && c <= 0x4dbf) || (c >= 0x20000 && c <= 0x2a6df) || (c >= 0x2a700 && c <= 0x2ceaf) || (c >= 0xf900 && c <= 0xfaff) || (c >= 0x2f800 && c <= 0x2fa1f);
+}
+
+bool
+is_mark(uint32_t c) {
+  return (c >= 0x300 && c <= 0x36f) || (c >= 0x1ab0 && c <= 0x1aff) || (c >= 0x1dc0 && c <= 0x1dff) || (c >= 0x20d0 && c <= 0x20ff) || (c >= 0xfe20 && c <= 0xfe2f);
+}
+
+uint32_t
+fold(uint32_t c) {
+  if (c < 0x80) return c >= 'A' && c <= 'Z' ? c + 32 : c;
+  if (c >= 0xc0 && c <= 0x24f) return latin_fold[c - 0xc0];
+  if ((c >= 0x391 && c <= 0x3a9) || (c >= 0x410 && c <= 0x42f)) return c + 0x20; // Greek, Cyrillic capitals
+  if (c >= 0x400 && c <= 0x40f) return c + 0x50;
+  return c;
+}
+
+} // namespace
+
+Tokenizer::Tokenizer(const Model &model) {
+  uint32_t count = model.vocab_size();
+  vocab_.reserve(count);
+  // First occurrence wins, like the reference vocab loader
+  for (uint32_t id = 0; id < count; id++) vocab_.emplace(model.token(id), id);
+
+  auto cls = vocab_.find("[CLS]");
+  auto sep = vocab_.find("[SEP]");
+  auto unk = vocab_.find("[UNK]");
+  valid_ = cls != vocab_.end() && sep != vocab_.end() && unk != vocab_.end();
+  if (!valid_) return;
+
+  cls_ = cls->second;
+  sep_ = sep->second;
+  unk_ = unk->second;
+}
+
+void
+Tokenizer::pieces(std::string_view word, std::vector<uint32_t> &ids) const {
+  size_t chars = 0;
+  for (char ch : word) chars += (uint8_t(ch) & 0xc0) != 0x80;
+  if (chars > max_word_chars) {
+    ids.push_back(unk_);
+    return;
+  }
+
+  size_t mark = ids.size();
+  size_t start = 0;
+
+  while (start < word.size()) {
+    size_t end = word.size();
+    bool found = false;
+
+    while (end > start) {
+      std::string_view sub = word.substr(start, end - start);
+      auto it = vocab_.end();
+      if (start == 0) {
+        it = vocab_.find(sub);
+      } else {
+        piece_.assign("##");
+        piece_.append(sub);
+        it = vocab_.find(piece_);
+      }
+
+      if (it != vocab_.end()) {
+        ids.push_back(it->second);
+        found = true;
+        break;
+      }
+
+      // Back off one whole UTF-8 character
+      do end--;
+      while (end > start && (uint8_t(word[end]) & 0xc0) == 0x80);
+    }
+
+    if (!found) {
+      ids.resize(mark);
+      ids.push_back(unk_);
+      return;
+    }
+
+    start = end;
+  }
+}
+
+void
+Tokenizer::encode(const char *text, size_t len, size_t max_tokens, std::vector<uint32_t> &ids) const {
+  size_t first = ids.size();
+  ids.push_back(cls_);
+
+  // Room left for pieces before [SEP]
+  size_t limit = first + (max_tokens > 2 ? max_tokens - 1 : 1);
+
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(text);
+  const uint8_t *end = p + len;
+  std::string word;
+
+  auto flush = [&] {
+    if (!word.empty()) pieces(word, ids);
+    word.clear();
+  };
+
+  while (p < end && ids.size() < limit) {
+    uint32_t c = next_codepoint(p, end);
+
+    if (is_whitespace(c)) {
+      flush();
+    } else if (is_control(c) || is_mark(c)) {
+      continue;
+    } else if (is_punctuation(c) || is_cjk(c)) {
+      flush();
+      append_utf8(word, c);
+      flush();
+    } else {
+      append_utf8(word, fold(c));
+    }
+  }
+
+  if (ids.size() < limit) flush();
+  if (ids.size() > limit) ids.resize(limit);
+  ids.push_back(sep_);
+}
+
+} // namespace bare_embed
@@ -0,0 +1,53 @@
+/**
+ * BERT WordPiece tokenizer over a model's vocab.
+ *
+ * Follows the uncased BERT pipeline: control characters are dropped,
+ * whitespace splits words, punctuation and CJK ideographs become words of
+ * their own, text is lowercased with accents stripped, and each word is
+ * split greedily into the longest vocab pieces ("##" for continuations),
+ * falling back to [UNK].
+ *
+ * Case folding and accent stripping cover ASCII, Latin (U+00C0-U+024F),
+ * Greek and Cyrillic by table; other scripts pass through unchanged, which
+ * matches the reference tokenizer for scripts without case.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "model.h"
+
+namespace bare_embed {
+
+class Tokenizer {
+public:
+  explicit Tokenizer(const Model &model);
+
+  // False when the vocab lacks [CLS], [SEP] or [UNK]
+  bool valid() const { return valid_; }
+
+  // Append the ids of "[CLS] text [SEP]" to `ids`, at most `max_tokens`
+  // of them (the text is truncated, [SEP] is always kept)
+  void encode(const char *text, size_t len, size_t max_tokens, std::vector<uint32_t> &ids) const;
+
+private:
+  // Append the WordPiece ids of one lowercased word
+  void pieces(std::string_view word, std::vector<uint32_t> &ids) const;
+
+  std::unordered_map<std::string_view, uint32_t> vocab_;
+  uint32_t cls_ = 0;
+  uint32_t sep_ = 0;
+  uint32_t unk_ = 0;
+  bool valid_ = false;
+
+  // Scratch for "##" continuation lookups
+  mutable std::string piece_;
+};
+
+} // namespace bare_embed
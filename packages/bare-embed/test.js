@@ -0,0 +1,118 @@
+/**
+ * Simple test for bare-embed addon
+ * Checks the hashing embedder's invariants and that related texts land
+ * closer together than unrelated ones, then runs the sentence encoder on a
+ * small random model.
+ */
+
+const fs = require('bare-fs')
+const { HASH_EMBEDDER, hashEmbed, hashEmbedBatch, SentenceEncoder } = require('./index')
+const { encodeModel, randomModel } = require('./model-file')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+function dot(a, b) {
+  let s = 0
+  for (let i = 0; i < a.length; i++) s += a[i] * b[i]
+  return s
+}
+
+function norm(v) {
+  return Math.sqrt(dot(v, v))
+}
+
+console.log('embedder:', HASH_EMBEDDER)
+
+const v = hashEmbed('Cats playing the piano')
+check('default dimension', v.length, 384)
+check('unit length', Math.abs(norm(v) - 1) < 1e-5, true)
+check('deterministic', Array.from(hashEmbed('Cats playing the piano')), Array.from(v))
+check('custom dimension', hashEmbed('Cats playing the piano', 64).length, 64)
+
+// ASCII case and punctuation do not change the tokens
+check('case and punctuation fold', dot(v, hashEmbed('cats, PLAYING -- the piano!')) > 0.9999, true)
+
+// Shared words and word pieces score well above unrelated text
+const lesson = hashEmbed('piano lessons for beginners')
+const related = dot(lesson, hashEmbed('beginner piano lesson'))
+const unrelated = dot(lesson, hashEmbed('skateboarding dogs compilation'))
+check('related text is closer', related > unrelated + 0.2, true)
+check('word order matters a little', dot(hashEmbed('red car'), hashEmbed('car red')) < 0.9999, true)
+
+// Text without words embeds as the zero vector
+check('empty text', norm(hashEmbed('')), 0)
+check('punctuation only', norm(hashEmbed(' ,.;- ')), 0)
+check('non-string input', norm(hashEmbed(null)), 0)
+
+// UTF-8 bytes are word bytes
+check('non-ASCII text embeds', Math.abs(norm(hashEmbed('日本語のテスト')) - 1) < 1e-5, true)
+
+// Batch matches single calls
+const texts = ['first video', '', 'Second Video about cooking', 'x'.repeat(5000)]
+const batch = hashEmbedBatch(texts)
+check('batch length', batch.length, texts.length)
+check('batch matches single', batch.every((row, i) => Array.from(row).join() === Array.from(hashEmbed(texts[i])).join()), true)
+check('batch of none', hashEmbedBatch([]), [])
+
+// Sentence encoder on a small random model
+const vocab = ['[PAD]', '[UNK]', '[CLS]', '[SEP]', 'the', 'cat', 'play', '##ing', 'piano', ',', '!', 'cafe']
+const modelPath = 'test-model.bin'
+fs.writeFileSync(modelPath, encodeModel(randomModel({ vocab, hidden: 64, layers: 2, heads: 4, intermediate: 128, maxPositions: 32, name: 'test-model' })))
+
+const encoder = SentenceEncoder.open(modelPath, { maxTokens: 8 })
+check('encoder name', encoder.name, 'test-model')
+check('encoder dimension', encoder.dimension, 64)
+check('encoder stats', encoder.stats().layers, 2)
+
+// Lowercased, accents stripped, punctuation split, unknown words -> [UNK]
+check('tokenize', encoder.tokenize('The cat, playing Café!'), [2, 4, 5, 9, 6, 7, 11, 3])
+check('tokenize unknown', encoder.tokenize('the zebra'), [2, 4, 1, 3])
+check('tokenize empty', encoder.tokenize(''), [2, 3])
+check('tokenize truncates', encoder.tokenize('the the the the the the the the the').length, 8)
+
+const sentences = ['the cat playing piano', 'Cafe!', '', 'the zebra, the cat']
+const vectors = encoder.embedBatch(sentences)
+check('encoder batch length', vectors.length, sentences.length)
+check('encoder unit length', vectors.every((row) => Math.abs(norm(row) - 1) < 1e-4), true)
+check('encoder batch matches single', vectors.every((row, i) => dot(row, encoder.embed(sentences[i])) > 0.9999), true)
+check('encoder deterministic', Array.from(encoder.embed('the cat')), Array.from(encoder.embed('the cat')))
+check('encoder case folding', dot(encoder.embed('THE CAT'), encoder.embed('the cat')) > 0.9999, true)
+check('encoder empty batch', encoder.embedBatch([]), [])
+
+// Batches larger than one internal chunk come out the same as one by one
+const many = Array.from({ length: 1500 }, (_, i) => sentences[i % sentences.length])
+check('encoder large batch', encoder.embedBatch(many).every((row, i) => dot(row, vectors[i % sentences.length]) > 0.9999), true)
+
+encoder.close()
+let closed = false
+try {
+  encoder.embed('the cat')
+} catch {
+  closed = true
+}
+check('encoder closed', closed, true)
+
+// Truncated and foreign files are rejected
+const bytes = fs.readFileSync(modelPath)
+fs.writeFileSync(modelPath, bytes.subarray(0, bytes.length - 64))
+let rejected = 0
+try {
+  SentenceEncoder.open(modelPath)
+} catch {
+  rejected++
+}
+fs.writeFileSync(modelPath, new Uint8Array(1024))
+try {
+  SentenceEncoder.open(modelPath)
+} catch {
+  rejected++
+}
+check('bad model files rejected', rejected, 2)
+fs.unlinkSync(modelPath)
+
+console.log('Test complete!')
@@ -0,0 +1,126 @@
+/**
+ * Benchmark for bare-event-store.
+ *
+ *   bare bench.js [sizes...]
+ *
+ * Synthetic watch streams (default sizes 1000000 5000000) over 50k videos,
+ * two events a second with Zipf-ish popularity. Reports bytes per event
+ * (against the JSON each event takes in the view) and the latency of
+ * per-video aggregations: all-time counts, decayed popularity (7 day
+ * half-life), a trailing 7 day window and one video's totals. The JS
+ * baseline runs the same aggregations over plain event objects, the way
+ * the backend keeps them, and is skipped above 1M events.
+ */
+
+const { EventStore } = require('./index')
+
+const VIDEOS = 50000
+const EVENT_INTERVAL = 500
+const DAY = 24 * 3600 * 1000
+const JS_BASELINE_MAX = 1000000
+const RUNS = 5
+
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000
+  }
+}
+
+function events(size, seed) {
+  const next = rng(seed)
+  const out = new Array(size)
+  for (let i = 0; i < size; i++) {
+    const video = Math.floor(VIDEOS * Math.pow(next(), 3))
+    const completed = next() < 0.3
+    out[i] = {
+      eventId: i.toString(16).padStart(32, '0'),
+      videoId: `video-${video}`,
+      timestamp: i * EVENT_INTERVAL,
+      duration: Math.floor(next() * 1800),
+      completed
+    }
+  }
+  return out
+}
+
+function time(fn) {
+  fn()
+  const start = Date.now()
+  for (let i = 0; i < RUNS; i++) fn()
+  return (Date.now() - start) / RUNS
+}
+
+function jsAggregate(list, { since = -Infinity, halfLife = 0, now = 0 } = {}) {
+  const totals = new Map()
+  for (const e of list) {
+    if (e.timestamp < since) continue
+    const w = halfLife > 0 ? Math.pow(2, Math.min(0, (e.timestamp - now) / halfLife)) : 1
+    const row = totals.get(e.videoId)
+    if (row) {
+      row.weight += w
+      row.value += w * e.duration
+    } else {
+      totals.set(e.videoId, { weight: w, value: w * e.duration })
+    }
+  }
+  return totals
+}
+
+function jsTotals(list, videoId) {
+  let weight = 0
+  let value = 0
+  for (const e of list) {
+    if (e.videoId !== videoId) continue
+    weight++
+    value += e.duration
+  }
+  return { weight, value }
+}
+
+function bench(size) {
+  const list = events(size, 1)
+  const now = size * EVENT_INTERVAL
+  const decayed = { halfLife: 7 * DAY, now }
+  const window = { since: now - 7 * DAY, now }
+
+  const store = new EventStore()
+  const ingestStart = Date.now()
+  const BATCH = 65536
+  for (let i = 0; i < size; i += BATCH) {
+    store.appendBatch(list.slice(i, i + BATCH).map((e) => ({
+      id: e.videoId,
+      time: e.timestamp,
+      type: e.completed ? 1 : 0,
+      value: e.duration
+    })))
+  }
+  const ingestMs = Date.now() - ingestStart
+
+  const stats = store.stats()
+  const jsonBytes = JSON.stringify(list.slice(0, 1000)).length / 1000
+
+  console.log(`\n${size} events, ${stats.videos} videos`)
+  console.log(`  native: ${stats.bytesPerEvent.toFixed(2)} bytes/event (${(stats.memory / 1048576).toFixed(1)} MB), view JSON ~${jsonBytes.toFixed(0)} bytes/event`)
+  console.log(`  ingest: ${ingestMs} ms (${(size / ingestMs / 1000).toFixed(1)}M events/s incl. interning)`)
+
+  const rows = [
+    ['counts', () => store.aggregate(), () => jsAggregate(list)],
+    ['decayed', () => store.aggregate(decayed), () => jsAggregate(list, decayed)],
+    ['window 7d', () => store.aggregate(window), () => jsAggregate(list, window)],
+    ['one video', () => store.totals('video-0'), () => jsTotals(list, 'video-0')]
+  ]
+
+  for (const [label, native, js] of rows) {
+    const nativeMs = time(native)
+    const jsMs = size <= JS_BASELINE_MAX ? time(js) : null
+    const speedup = jsMs !== null && nativeMs > 0 ? ` (${(jsMs / nativeMs).toFixed(1)}x)` : ''
+    console.log(`  ${label.padEnd(10)} native ${nativeMs.toFixed(2)} ms   js ${jsMs === null ? 'skipped' : jsMs.toFixed(2) + ' ms'}${speedup}`)
+  }
+
+  store.destroy()
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+const sizes = args.length > 0 ? args.map(Number) : [1000000, 5000000]
+for (const size of sizes) bench(size)
@@ -0,0 +1,364 @@
+/**
+ * bare-event-store - Bare native addon for compact event storage
+ * Append-only columnar store of timestamped per-video events (watch events)
+ * with windowed, time-decayed aggregations
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/event_store.h"
+
+using bare_event_store::EventStore;
+using bare_event_store::query_t;
+using bare_event_store::totals_t;
+
+// Handle wrapper for EventStore
+typedef struct {
+  EventStore *store;
+} bare_event_store_t;
+
+static bare_event_store_t *
+bare_event_store__store(js_env_t *env, js_value_t *value) {
+  bare_event_store_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->store) {
+    js_throw_error(env, NULL, "Event store has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Millisecond time from a JS number; infinities clamp to the int64 range
+static int64_t
+bare_event_store__time(double time) {
+  if (std::isnan(time)) return 0;
+  if (time <= -9.2e18) return INT64_MIN;
+  if (time >= 9.2e18) return INT64_MAX;
+  return int64_t(time);
+}
+
+// Read (since, until, typeWeights, halfLife, now) from argv
+static bool
+bare_event_store__query(js_env_t *env, js_value_t **argv, query_t *query) {
+  int err;
+
+  double since, until, half_life, now;
+  err = js_get_value_double(env, argv[0], &since);
+  if (err != 0) return false;
+  err = js_get_value_double(env, argv[1], &until);
+  if (err != 0) return false;
+  err = js_get_value_double(env, argv[3], &half_life);
+  if (err != 0) return false;
+  err = js_get_value_double(env, argv[4], &now);
+  if (err != 0) return false;
+
+  js_typedarray_type_t type;
+  float *weights;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], &type, (void **) &weights, &len, NULL, NULL);
+  if (err != 0) return false;
+
+  if (type != js_float32array || len > 256) {
+    js_throw_error(env, NULL, "Type weights must be a Float32Array of at most 256 entries");
+    return false;
+  }
+
+  if (!(half_life >= 0)) {
+    js_throw_error(env, NULL, "Invalid half-life");
+    return false;
+  }
+
+  query->since = bare_event_store__time(since);
+  query->until = bare_event_store__time(until);
+  for (size_t i = 0; i < len; i++) query->type_weights[i] = weights[i];
+  query->half_life = std::isfinite(half_life) ? half_life : 0;
+  query->now = bare_event_store__time(now);
+
+  return true;
+}
+
+static js_value_t *
+bare_event_store_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+
+  js_value_t *result;
+  bare_event_store_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_event_store_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->store = new EventStore();
+  return result;
+}
+
+static js_value_t *
+bare_event_store_append(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t video, type, value;
+  double time;
+  err = js_get_value_uint32(env, argv[1], &video);
+  if (err != 0) return NULL;
+  err = js_get_value_double(env, argv[2], &time);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[3], &type);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[4], &value);
+  if (err != 0) return NULL;
+
+  if (type > UINT8_MAX) {
+    js_throw_error(env, NULL, "Event type must be below 256");
+    return NULL;
+  }
+
+  handle->store->append(video, bare_event_store__time(time), uint8_t(type), uint16_t(std::min<uint32_t>(value, UINT16_MAX)));
+  return NULL;
+}
+
+// Append events column-wise: (handle, Uint32Array videos, Float64Array
+// times, Uint8Array types, Uint16Array values), all of one length
+static js_value_t *
+bare_event_store_append_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  js_typedarray_type_t types[4];
+  void *data[4];
+  size_t lens[4];
+  for (size_t i = 0; i < 4; i++) {
+    err = js_get_typedarray_info(env, argv[i + 1], &types[i], &data[i], &lens[i], NULL, NULL);
+    if (err != 0) return NULL;
+  }
+
+  if (types[0] != js_uint32array || types[1] != js_float64array || types[2] != js_uint8array || types[3] != js_uint16array) {
+    js_throw_error(env, NULL, "Expected Uint32Array, Float64Array, Uint8Array and Uint16Array columns");
+    return NULL;
+  }
+
+  size_t count = lens[0];
+  if (lens[1] != count || lens[2] != count || lens[3] != count) {
+    js_throw_error(env, NULL, "Columns must have the same length");
+    return NULL;
+  }
+
+  const uint32_t *videos = (const uint32_t *) data[0];
+  const double *times = (const double *) data[1];
+  const uint8_t *event_types = (const uint8_t *) data[2];
+  const uint16_t *values = (const uint16_t *) data[3];
+
+  EventStore *store = handle->store;
+  for (size_t i = 0; i < count; i++) store->append(videos[i], bare_event_store__time(times[i]), event_types[i], values[i]);
+
+  return NULL;
+}
+
+// Per-video totals: (handle, since, until, typeWeights, halfLife, now,
+// Float32Array weights, Float32Array values | null); indexes past the
+// output length are skipped
+static js_value_t *
+bare_event_store_aggregate(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 8;
+  js_value_t *argv[8];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  query_t query;
+  if (!bare_event_store__query(env, argv + 1, &query)) return NULL;
+
+  js_typedarray_type_t type;
+  float *weights;
+  size_t count;
+  err = js_get_typedarray_info(env, argv[6], &type, (void **) &weights, &count, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_float32array) {
+    js_throw_error(env, NULL, "Weights must be a Float32Array");
+    return NULL;
+  }
+
+  float *values = NULL;
+  bool has_values;
+  err = js_is_typedarray(env, argv[7], &has_values);
+  if (err != 0) return NULL;
+
+  if (has_values) {
+    size_t len;
+    err = js_get_typedarray_info(env, argv[7], &type, (void **) &values, &len, NULL, NULL);
+    if (err != 0) return NULL;
+
+    if (type != js_float32array || len != count) {
+      js_throw_error(env, NULL, "Values must be a Float32Array of the weights length");
+      return NULL;
+    }
+  }
+
+  handle->store->aggregate(query, weights, values, count);
+  return NULL;
+}
+
+// Totals of one video's events, or of all events when video is -1:
+// (handle, video, since, until, typeWeights, halfLife, now) -> {weight, value}
+static js_value_t *
+bare_event_store_totals(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 7;
+  js_value_t *argv[7];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  int64_t video;
+  err = js_get_value_int64(env, argv[1], &video);
+  if (err != 0) return NULL;
+
+  query_t query;
+  if (!bare_event_store__query(env, argv + 2, &query)) return NULL;
+
+  EventStore *store = handle->store;
+  totals_t totals = video < 0 ? store->totals(query) : store->totals(uint32_t(video), query);
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+  js_value_t *weight, *value;
+  err = js_create_double(env, totals.weight, &weight);
+  if (err != 0) return NULL;
+  err = js_create_double(env, totals.value, &value);
+  if (err != 0) return NULL;
+
+  js_set_named_property(env, result, "weight", weight);
+  js_set_named_property(env, result, "value", value);
+
+  return result;
+}
+
+static js_value_t *
+bare_event_store_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  EventStore *store = handle->store;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("size", store->size());
+  SET_NUMBER("videos", store->videos());
+  SET_NUMBER("bytesPerEvent", store->bytes_per_event());
+  SET_NUMBER("memory", store->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_event_store_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle = bare_event_store__store(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->store->clear();
+  return NULL;
+}
+
+static js_value_t *
+bare_event_store_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_event_store_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->store;
+  handle->store = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_event_store_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_event_store_create);
+  EXPORT_FUNCTION(append, bare_event_store_append);
+  EXPORT_FUNCTION(appendBatch, bare_event_store_append_batch);
+  EXPORT_FUNCTION(aggregate, bare_event_store_aggregate);
+  EXPORT_FUNCTION(totals, bare_event_store_totals);
+  EXPORT_FUNCTION(stats, bare_event_store_stats);
+  EXPORT_FUNCTION(clear, bare_event_store_clear);
+  EXPORT_FUNCTION(destroy, bare_event_store_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_event_store, bare_event_store_exports)
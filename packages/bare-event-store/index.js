@@ -0,0 +1,178 @@
+/**
+ * bare-event-store - Native columnar store for watch events
+ * Append-only (video, time, type, value) events in compressed fixed-width
+ * columns, with windowed and time-decayed aggregations (counts, summed
+ * values, decayed popularity) computed in native passes over the blocks.
+ * Video ids are interned to dense indexes on the JS side.
+ */
+
+const binding = require('./binding')
+
+// Event types are small integers (0-255) chosen by the caller; queries
+// weight each type, so e.g. a retraction type weighted -1 cancels a watch
+const MAX_TYPES = 256
+const MAX_VALUE = 0xffff
+
+function typeWeights(types) {
+  const weights = new Float32Array(MAX_TYPES)
+  if (!types) {
+    weights.fill(1)
+    return weights
+  }
+  for (const [type, weight] of Array.isArray(types) ? types.entries() : Object.entries(types)) {
+    const t = Number(type)
+    if (t >= 0 && t < MAX_TYPES) weights[t] = weight
+  }
+  return weights
+}
+
+function toValue(value) {
+  return Math.min(MAX_VALUE, Math.max(0, Math.round(value || 0)))
+}
+
+class EventStore {
+  constructor() {
+    this._handle = binding.create()
+    /** @type {string[]} index -> id */
+    this._ids = []
+    /** @type {Map<string, number>} id -> index */
+    this._indexes = new Map()
+  }
+
+  _store() {
+    if (this._handle === null) throw new Error('Event store has been destroyed')
+    return this._handle
+  }
+
+  _index(id) {
+    let index = this._indexes.get(id)
+    if (index === undefined) {
+      index = this._ids.length
+      this._ids.push(id)
+      this._indexes.set(id, index)
+    }
+    return index
+  }
+
+  /**
+   * @param {Object} [opts]
+   * @returns {[number, number, Float32Array, number, number]}
+   */
+  _query(opts = {}) {
+    return [
+      opts.since ?? -Infinity,
+      opts.until ?? Infinity,
+      typeWeights(opts.types),
+      opts.halfLife || 0,
+      opts.now ?? Date.now()
+    ]
+  }
+
+  /**
+   * Record one event
+   * @param {string} id - Video id
+   * @param {number} time - Event time in ms
+   * @param {number} [type=0] - Event type (0-255)
+   * @param {number} [value=0] - Event value, e.g. watched seconds; rounded
+   *   and capped to 0-65535
+   */
+  append(id, time, type = 0, value = 0) {
+    binding.append(this._store(), this._index(id), time || 0, type, toValue(value))
+  }
+
+  /**
+   * Record many events in one native call
+   * @param {Array<{id: string, time: number, type?: number, value?: number}>} events
+   */
+  appendBatch(events) {
+    const handle = this._store()
+    const count = events.length
+    const indexes = new Uint32Array(count)
+    const times = new Float64Array(count)
+    const types = new Uint8Array(count)
+    const values = new Uint16Array(count)
+    for (let i = 0; i < count; i++) {
+      const event = events[i]
+      indexes[i] = this._index(event.id)
+      times[i] = event.time || 0
+      types[i] = event.type || 0
+      values[i] = toValue(event.value)
+    }
+    binding.appendBatch(handle, indexes, times, types, values)
+  }
+
+  /**
+   * Per-video totals of the matching events. Each event weighs its type's
+   * weight, times 2^-((now - time) / halfLife) when decaying.
+   * @param {Object} [opts]
+   * @param {number} [opts.since] - Window start in ms (inclusive)
+   * @param {number} [opts.until] - Window end in ms (exclusive)
+   * @param {Object<number, number>|number[]} [opts.types] - Weight per event
+   *   type; unlisted types are left out (default: every type weighs 1)
+   * @param {number} [opts.halfLife] - Decay half-life in ms (0: no decay)
+   * @param {number} [opts.now] - Decay reference time (default Date.now())
+   * @returns {Map<string, {weight: number, value: number}>} Videos with a
+   *   non-zero total; value sums weight x event value
+   */
+  aggregate(opts = {}) {
+    const handle = this._store()
+    const weights = new Float32Array(this._ids.length)
+    const values = new Float32Array(this._ids.length)
+    binding.aggregate(handle, ...this._query(opts), weights, values)
+
+    const totals = new Map()
+    for (let i = 0; i < weights.length; i++) {
+      if (weights[i] !== 0 || values[i] !== 0) totals.set(this._ids[i], { weight: weights[i], value: values[i] })
+    }
+    return totals
+  }
+
+  /**
+   * Totals of one video's matching events, or of all events
+   * @param {string|null} id
+   * @param {Object} [opts] - As for aggregate()
+   * @returns {{weight: number, value: number}}
+   */
+  totals(id = null, opts = {}) {
+    const handle = this._store()
+    let index = -1
+    if (id !== null) {
+      index = this._indexes.get(id)
+      if (index === undefined) return { weight: 0, value: 0 }
+    }
+    return binding.totals(handle, index, ...this._query(opts))
+  }
+
+  /**
+   * Stored event count
+   * @returns {number}
+   */
+  size() {
+    return binding.stats(this._store()).size
+  }
+
+  /**
+   * @returns {{size: number, videos: number, bytesPerEvent: number, memory: number}}
+   */
+  stats() {
+    return binding.stats(this._store())
+  }
+
+  clear() {
+    binding.clear(this._store())
+    this._ids = []
+    this._indexes.clear()
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+    this._ids = []
+    this._indexes.clear()
+  }
+}
+
+module.exports = {
+  EventStore
+}
@@ -0,0 +1,379 @@
+#include "event_store.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bare_event_store {
+
+namespace {
+
+// 2^x for x in [-126, 0] without a libm call, so the decay loop
+// vectorises: biased by 127 the integer part is the exponent bits, and a
+// degree-6 polynomial covers the fraction (relative error ~2e-7)
+inline float
+fast_exp2(float x) {
+  float y = x + 127.0f;
+  int32_t i = int32_t(y);
+  float f = y - float(i);
+  float p = 1.0f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041087f + f * (0.00961812911f + f * (0.00133335581f + f * 0.000154035304f)))));
+  int32_t bits = i << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+// Zero the weights of events outside [since, until), given as deltas from
+// the block's earliest time
+template <typename T>
+void
+mask_window(const T *deltas, size_t n, int64_t since, int64_t until, float *w) {
+  // Bounds clamped into the delta range so the compare stays in T
+  uint64_t lo = since <= 0 ? 0 : uint64_t(since);
+  uint64_t hi = until <= 0 ? 0 : uint64_t(until);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t d = deltas[i];
+    w[i] = (d >= lo && d < hi) ? w[i] : 0.0f;
+  }
+}
+
+// exponents[i] = deltas[i] * k + offset clamped to [-126, 0]; events
+// newer than `now` weigh 1, and weights below 2^-126 flush to 0
+template <typename T>
+void
+decay_exponents(const T *deltas, size_t n, float k, float offset, float *out) {
+  for (size_t i = 0; i < n; i++) out[i] = std::max(-126.0f, std::min(0.0f, float(deltas[i]) * k + offset));
+}
+
+// Add each event's weight (and weight x value) to its video's totals
+template <typename V>
+void
+scatter(const V *videos, const float *w, const uint16_t *v, size_t n, float *weights, float *values, size_t count) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t video = videos[i];
+    if (video >= count) continue;
+    weights[video] += w[i];
+    if (values) values[video] += w[i] * float(v[i]);
+  }
+}
+
+// Add the totals of the events of `video`
+template <typename V>
+void
+sum_video(const V *videos, size_t n, uint32_t video, const float *w, const uint16_t *v, totals_t &out) {
+  float sum = 0;
+  float value_sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    float m = videos[i] == video ? w[i] : 0.0f;
+    sum += m;
+    value_sum += m * float(v[i]);
+  }
+  out.weight += sum;
+  out.value += value_sum;
+}
+
+template <typename V>
+bool
+contains(const V *videos, size_t n, uint32_t video) {
+  size_t matches = 0;
+  for (size_t i = 0; i < n; i++) matches += videos[i] == video;
+  return matches > 0;
+}
+
+} // namespace
+
+void
+EventStore::append(uint32_t video, int64_t time, uint8_t type, uint16_t value) {
+  open_times_.push_back(time);
+  open_videos_.push_back(video);
+  open_types_.push_back(type);
+  open_values_.push_back(value);
+  open_min_ = std::min(open_min_, time);
+  open_max_ = std::max(open_max_, time);
+
+  size_++;
+  if (video >= videos_) videos_ = video + 1;
+
+  if (open_times_.size() == block_size) seal();
+}
+
+void
+EventStore::seal() {
+  size_t n = open_times_.size();
+  if (n == 0) return;
+
+  blocks_.emplace_back();
+  block_t &block = blocks_.back();
+  block.min_time = open_min_;
+  block.max_time = open_max_;
+  block.count = uint32_t(n);
+
+  uint64_t span = uint64_t(open_max_ - open_min_);
+  if (span <= UINT16_MAX) {
+    block.time_width = 2;
+    block.times16.resize(n);
+    for (size_t i = 0; i < n; i++) block.times16[i] = uint16_t(open_times_[i] - open_min_);
+  } else if (span <= UINT32_MAX) {
+    block.time_width = 4;
+    block.times32.resize(n);
+    for (size_t i = 0; i < n; i++) block.times32[i] = uint32_t(open_times_[i] - open_min_);
+  } else {
+    block.time_width = 8;
+    block.times64.resize(n);
+    for (size_t i = 0; i < n; i++) block.times64[i] = uint64_t(open_times_[i] - open_min_);
+  }
+
+  size_t runs = 1;
+  for (size_t i = 1; i < n; i++) runs += open_videos_[i] != open_videos_[i - 1];
+
+  // Pairs cost two words a run: worth it once they halve the column
+  block.runs = runs * 4 <= n;
+  if (block.runs) {
+    block.videos.reserve(runs * 2);
+    size_t start = 0;
+    for (size_t i = 1; i <= n; i++) {
+      if (i == n || open_videos_[i] != open_videos_[start]) {
+        block.videos.push_back(open_videos_[start]);
+        block.videos.push_back(uint32_t(i - start));
+        start = i;
+      }
+    }
+  } else if (*std::max_element(open_videos_.begin(), open_videos_.end()) <= UINT16_MAX) {
+    block.video_width = 2;
+    block.videos16.assign(open_videos_.begin(), open_videos_.end());
+  } else {
+    block.video_width = 4;
+    block.videos = open_videos_;
+  }
+
+  block.types = open_types_;
+  block.values = open_values_;
+
+  open_times_.clear();
+  open_videos_.clear();
+  open_types_.clear();
+  open_values_.clear();
+  open_min_ = INT64_MAX;
+  open_max_ = INT64_MIN;
+}
+
+bool
+EventStore::weigh(const block_t *block, const query_t &q) {
+  size_t n = block ? block->count : open_times_.size();
+  int64_t min_time = block ? block->min_time : open_min_;
+  int64_t max_time = block ? block->max_time : open_max_;
+  if (n == 0 || !overlaps(min_time, max_time, q)) return false;
+
+  weights_.resize(n);
+  float *w = weights_.data();
+
+  const uint8_t *types = block ? block->types.data() : open_types_.data();
+  bool any = false;
+  for (size_t i = 0; i < n; i++) {
+    w[i] = q.type_weights[types[i]];
+    any |= w[i] != 0;
+  }
+  if (!any) return false;
+
+  // Per-event window tests only for blocks straddling an edge
+  if (min_time < q.since || max_time >= q.until) {
+    int64_t since = q.since == INT64_MIN ? 0 : q.since - min_time;
+    int64_t until = q.until == INT64_MAX ? INT64_MAX : q.until - min_time;
+
+    if (block == nullptr) {
+      for (size_t i = 0; i < n; i++) {
+        int64_t t = open_times_[i];
+        w[i] = (t >= q.since && t < q.until) ? w[i] : 0.0f;
+      }
+    } else if (block->time_width == 2) {
+      mask_window(block->times16.data(), n, since, until, w);
+    } else if (block->time_width == 4) {
+      mask_window(block->times32.data(), n, since, until, w);
+    } else {
+      mask_window(block->times64.data(), n, since, until, w);
+    }
+  }
+
+  if (q.half_life > 0) {
+    // Exponent (time - now) / half_life as delta * k + offset
+    float k = float(1.0 / q.half_life);
+    float offset = float(double(min_time - q.now) / q.half_life);
+
+    exponents_.resize(n);
+    float *e = exponents_.data();
+
+    if (block == nullptr) {
+      for (size_t i = 0; i < n; i++) e[i] = std::max(-126.0f, std::min(0.0f, float(open_times_[i] - min_time) * k + offset));
+    } else if (block->time_width == 2) {
+      decay_exponents(block->times16.data(), n, k, offset, e);
+    } else if (block->time_width == 4) {
+      decay_exponents(block->times32.data(), n, k, offset, e);
+    } else {
+      decay_exponents(block->times64.data(), n, k, offset, e);
+    }
+
+    // Separate passes keep each loop free of selects and aliasing checks
+    for (size_t i = 0; i < n; i++) e[i] = fast_exp2(e[i]);
+    for (size_t i = 0; i < n; i++) w[i] *= e[i];
+  }
+
+  return true;
+}
+
+void
+EventStore::aggregate(const query_t &q, float *weights, float *values, size_t count) {
+  auto add = [&](const block_t *block) {
+    if (!weigh(block, q)) return;
+
+    const float *w = weights_.data();
+    const uint16_t *v = block ? block->values.data() : open_values_.data();
+
+    if (block != nullptr && block->runs) {
+      const uint32_t *runs = block->videos.data();
+      size_t pos = 0;
+      for (size_t r = 0; r < block->videos.size(); r += 2) {
+        uint32_t video = runs[r];
+        size_t end = pos + runs[r + 1];
+        if (video < count) {
+          float sum = 0;
+          float value_sum = 0;
+          for (size_t i = pos; i < end; i++) {
+            sum += w[i];
+            value_sum += w[i] * float(v[i]);
+          }
+          weights[video] += sum;
+          if (values) values[video] += value_sum;
+        }
+        pos = end;
+      }
+      return;
+    }
+
+    if (block == nullptr) {
+      scatter(open_videos_.data(), w, v, open_videos_.size(), weights, values, count);
+    } else if (block->video_width == 2) {
+      scatter(block->videos16.data(), w, v, block->count, weights, values, count);
+    } else {
+      scatter(block->videos.data(), w, v, block->count, weights, values, count);
+    }
+  };
+
+  for (const block_t &block : blocks_) add(&block);
+  add(nullptr);
+}
+
+totals_t
+EventStore::totals(uint32_t video, const query_t &q) {
+  totals_t out;
+
+  auto add = [&](const block_t *block) {
+    const uint16_t *v = block ? block->values.data() : open_values_.data();
+
+    if (block != nullptr && block->runs) {
+      const uint32_t *videos = block->videos.data();
+
+      // Only runs of this video are weighed
+      bool present = false;
+      for (size_t r = 0; r < block->videos.size() && !present; r += 2) present = videos[r] == video;
+      if (!present || !weigh(block, q)) return;
+
+      const float *w = weights_.data();
+      size_t pos = 0;
+      for (size_t r = 0; r < block->videos.size(); r += 2) {
+        size_t end = pos + videos[r + 1];
+        if (videos[r] == video) {
+          for (size_t i = pos; i < end; i++) {
+            out.weight += w[i];
+            out.value += double(w[i]) * v[i];
+          }
+        }
+        pos = end;
+      }
+      return;
+    }
+
+    // Weigh only blocks holding the video
+    if (block == nullptr) {
+      size_t n = open_videos_.size();
+      if (contains(open_videos_.data(), n, video) && weigh(nullptr, q)) sum_video(open_videos_.data(), n, video, weights_.data(), v, out);
+    } else if (block->video_width == 2) {
+      if (video <= UINT16_MAX && contains(block->videos16.data(), block->count, video) && weigh(block, q)) sum_video(block->videos16.data(), block->count, video, weights_.data(), v, out);
+    } else {
+      if (contains(block->videos.data(), block->count, video) && weigh(block, q)) sum_video(block->videos.data(), block->count, video, weights_.data(), v, out);
+    }
+  };
+
+  for (const block_t &block : blocks_) add(&block);
+  add(nullptr);
+
+  return out;
+}
+
+totals_t
+EventStore::totals(const query_t &q) {
+  totals_t out;
+
+  auto add = [&](const block_t *block) {
+    if (!weigh(block, q)) return;
+
+    const float *w = weights_.data();
+    const uint16_t *v = block ? block->values.data() : open_values_.data();
+    size_t n = block ? block->count : open_values_.size();
+
+    float sum = 0;
+    float value_sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      sum += w[i];
+      value_sum += w[i] * float(v[i]);
+    }
+    out.weight += sum;
+    out.value += value_sum;
+  };
+
+  for (const block_t &block : blocks_) add(&block);
+  add(nullptr);
+
+  return out;
+}
+
+void
+EventStore::clear() {
+  blocks_.clear();
+  open_times_.clear();
+  open_videos_.clear();
+  open_types_.clear();
+  open_values_.clear();
+  open_min_ = INT64_MAX;
+  open_max_ = INT64_MIN;
+  size_ = 0;
+  videos_ = 0;
+}
+
+size_t
+EventStore::memory_usage() const {
+  size_t bytes = blocks_.capacity() * sizeof(block_t);
+  for (const block_t &block : blocks_) {
+    bytes += block.times16.capacity() * sizeof(uint16_t) + block.times32.capacity() * sizeof(uint32_t) + block.times64.capacity() * sizeof(uint64_t);
+    bytes += block.videos.capacity() * sizeof(uint32_t) + block.videos16.capacity() * sizeof(uint16_t) + block.types.capacity() + block.values.capacity() * sizeof(uint16_t);
+  }
+  bytes += open_times_.capacity() * sizeof(int64_t) + open_videos_.capacity() * sizeof(uint32_t);
+  bytes += open_types_.capacity() + open_values_.capacity() * sizeof(uint16_t);
+  bytes += (weights_.capacity() + exponents_.capacity()) * sizeof(float);
+  return bytes;
+}
+
+double
+EventStore::bytes_per_event() const {
+  if (size_ == 0) return 0;
+
+  size_t bytes = blocks_.size() * sizeof(block_t);
+  for (const block_t &block : blocks_) {
+    bytes += block.times16.size() * sizeof(uint16_t) + block.times32.size() * sizeof(uint32_t) + block.times64.size() * sizeof(uint64_t);
+    bytes += block.videos.size() * sizeof(uint32_t) + block.videos16.size() * sizeof(uint16_t) + block.types.size() + block.values.size() * sizeof(uint16_t);
+  }
+  bytes += open_times_.size() * sizeof(int64_t) + open_videos_.size() * sizeof(uint32_t);
+  bytes += open_types_.size() + open_values_.size() * sizeof(uint16_t);
+
+  return double(bytes) / double(size_);
+}
+
+} // namespace bare_event_store
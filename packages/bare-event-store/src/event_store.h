@@ -0,0 +1,127 @@
+/**
+ * Append-only columnar store for small timestamped events (watch events).
+ *
+ * An event is (video index, time in ms, type, 16-bit value). Events fill
+ * an open block of block_size rows held as plain columns; a full block is
+ * sealed into compact fixed-width columns:
+ *
+ * - time:  delta from the block's earliest event, 2, 4 or 8 bytes wide as
+ *          the block's time span needs (events may arrive out of order)
+ * - video: run-length encoded (video, length) pairs when runs halve it,
+ *          raw indexes otherwise, 2 bytes wide when they all fit
+ * - type:  1 byte
+ * - value: 2 bytes
+ *
+ * so a sealed event costs 5-15 bytes (7-9 for a steady stream of views). Each block keeps its time range, so
+ * windowed queries skip blocks outside the window and drop per-event time
+ * tests for blocks inside it. Aggregations turn a block into per-event
+ * weights in one branch-free pass (type weight x window mask x decay) and
+ * then add the weights up per video, once per run for run-encoded blocks.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bare_event_store {
+
+struct query_t {
+  // Window [since, until) in ms
+  int64_t since = INT64_MIN;
+  int64_t until = INT64_MAX;
+  // Weight of each event type; 0 leaves the type out
+  float type_weights[256] = {};
+  // Exponential decay: events weigh 2^-((now - time) / half_life), newer
+  // than `now` weigh 1. 0 disables decay.
+  double half_life = 0;
+  int64_t now = 0;
+};
+
+struct totals_t {
+  // Sum of event weights
+  double weight = 0;
+  // Sum of weight x value
+  double value = 0;
+};
+
+class EventStore {
+public:
+  static constexpr size_t block_size = 4096;
+
+  // Events stored
+  size_t size() const { return size_; }
+
+  // Highest video index appended plus one
+  uint32_t videos() const { return videos_; }
+
+  void append(uint32_t video, int64_t time, uint8_t type, uint16_t value);
+
+  // Per-video totals over the events matching `q`: weights[v] and (when
+  // not null) values[v] are added to for v < count
+  void aggregate(const query_t &q, float *weights, float *values, size_t count);
+
+  // Totals of one video's events matching `q`
+  totals_t totals(uint32_t video, const query_t &q);
+
+  // Totals of all events matching `q`
+  totals_t totals(const query_t &q);
+
+  void clear();
+
+  size_t memory_usage() const;
+
+  // Bytes of event data per stored event (block overhead included)
+  double bytes_per_event() const;
+
+private:
+  struct block_t {
+    int64_t min_time;
+    int64_t max_time;
+    uint32_t count;
+    uint8_t time_width;
+    // Raw video index width (2 or 4) when not `runs`
+    uint8_t video_width;
+    bool runs;
+    // `count` deltas from min_time; only the vector of time_width is used
+    std::vector<uint16_t> times16;
+    std::vector<uint32_t> times32;
+    std::vector<uint64_t> times64;
+    // (video, length) pairs when `runs`, else raw indexes in the vector of
+    // video_width
+    std::vector<uint32_t> videos;
+    std::vector<uint16_t> videos16;
+    std::vector<uint8_t> types;
+    std::vector<uint16_t> values;
+  };
+
+  void seal();
+
+  // Weights of block events (or of the open block when `block` is null)
+  // under `q` into weights_; returns false when none can be non-zero
+  bool weigh(const block_t *block, const query_t &q);
+
+  bool overlaps(int64_t min_time, int64_t max_time, const query_t &q) const {
+    return max_time >= q.since && min_time < q.until;
+  }
+
+  std::vector<block_t> blocks_;
+
+  // Open block
+  std::vector<int64_t> open_times_;
+  std::vector<uint32_t> open_videos_;
+  std::vector<uint8_t> open_types_;
+  std::vector<uint16_t> open_values_;
+  int64_t open_min_ = INT64_MAX;
+  int64_t open_max_ = INT64_MIN;
+
+  size_t size_ = 0;
+  uint32_t videos_ = 0;
+
+  // Per-event scratch for weigh()
+  std::vector<float> weights_;
+  std::vector<float> exponents_;
+};
+
+} // namespace bare_event_store
@@ -0,0 +1,115 @@
+/**
+ * Simple test for bare-event-store addon
+ * Checks native aggregations against plain JS sums over the same events.
+ */
+
+const { EventStore } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+function near(label, actual, expected) {
+  if (Math.abs(actual - expected) > 1e-4 * Math.max(1, Math.abs(expected))) {
+    throw new Error(`${label}: expected ${expected}, got ${actual}`)
+  }
+  console.log('ok -', label)
+}
+
+// Deterministic PRNG so failures reproduce
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000
+  }
+}
+
+const DAY = 24 * 3600 * 1000
+const BASE = 1700000000000
+
+// Small store: open block only
+{
+  const store = new EventStore()
+  store.append('a', BASE, 0, 30)
+  store.append('b', BASE + 1000, 1, 600)
+  store.append('a', BASE + 2000, 1, 45.4)
+  store.append('a', BASE + 3000, 2, 30)
+
+  check('size', store.size(), 4)
+  check('all events', store.totals(), { weight: 4, value: 705 })
+  check('one video', store.totals('a', { types: { 0: 1, 1: 1 } }), { weight: 2, value: 75 })
+  check('retraction type cancels', store.totals('a', { types: { 0: 1, 1: 1, 2: -1 } }).weight, 1)
+  check('unknown video', store.totals('zzz'), { weight: 0, value: 0 })
+  check('window', store.totals(null, { since: BASE + 1000, until: BASE + 3000 }).weight, 2)
+
+  const counts = store.aggregate({ types: [1, 1] })
+  check('aggregate', [...counts].sort(), [['a', { weight: 2, value: 75 }], ['b', { weight: 1, value: 600 }]])
+
+  store.append('c', BASE, 0, 1e9)
+  check('value capped', store.totals('c').value, 65535)
+
+  store.clear()
+  check('clear', [store.size(), store.totals()], [0, { weight: 0, value: 0 }])
+
+  store.destroy()
+  let threw = false
+  try { store.size() } catch { threw = true }
+  check('destroyed store throws', threw, true)
+}
+
+// Many blocks: ordered (narrow deltas), bursty (run-encoded videos) and
+// scattered (wide deltas) streams against a JS reference
+for (const [name, make] of [
+  ['ordered', (i, next) => ({ id: `v${Math.floor(next() * 500)}`, time: BASE + i * 500 + Math.floor(next() * 1000) })],
+  ['bursty', (i, next) => ({ id: `v${Math.floor(i / 40) % 300}`, time: BASE + i * 10 })],
+  ['scattered', (i, next) => ({ id: `v${Math.floor(next() * 500)}`, time: BASE + Math.floor(next() * 365 * DAY) })]
+]) {
+  const next = rng(7)
+  const events = []
+  for (let i = 0; i < 30000; i++) {
+    const event = make(i, next)
+    event.type = Math.floor(next() * 3)
+    event.value = Math.floor(next() * 3600)
+    events.push(event)
+  }
+
+  const store = new EventStore()
+  store.appendBatch(events.slice(0, 20000))
+  for (const event of events.slice(20000)) store.append(event.id, event.time, event.type, event.value)
+  check(`${name}: size`, store.size(), events.length)
+
+  const now = BASE + 20 * DAY
+  const query = { since: BASE + 1000000, until: BASE + 20 * DAY, types: { 0: 1, 1: 2 }, halfLife: 7 * DAY, now }
+  const expected = new Map()
+  let total = 0
+  for (const e of events) {
+    if (e.time < query.since || e.time >= query.until || e.type === 2) continue
+    const w = query.types[e.type] * Math.pow(2, Math.min(0, (e.time - now) / query.halfLife))
+    const row = expected.get(e.id) || { weight: 0, value: 0 }
+    row.weight += w
+    row.value += w * e.value
+    expected.set(e.id, row)
+    total += w
+  }
+
+  const actual = store.aggregate(query)
+  check(`${name}: aggregate videos`, actual.size, expected.size)
+  let worst = 0
+  for (const [id, row] of expected) {
+    const got = actual.get(id)
+    worst = Math.max(worst, Math.abs(got.weight - row.weight) / Math.max(1, row.weight), Math.abs(got.value - row.value) / Math.max(1, row.value))
+  }
+  check(`${name}: aggregate matches`, worst < 1e-4, true)
+  near(`${name}: totals`, store.totals(null, query).weight, total)
+  near(`${name}: video totals`, store.totals('v17', query).weight, expected.get('v17')?.weight || 0)
+
+  const stats = store.stats()
+  check(`${name}: compact`, stats.bytesPerEvent < 17, true)
+  console.log(`  ${stats.bytesPerEvent.toFixed(2)} bytes/event`)
+  store.destroy()
+}
+
+console.log('all tests passed')
@@ -0,0 +1,68 @@
+/**
+ * Benchmark for bare-ingest.
+ *
+ *   bare bench.js [threads...]
+ *
+ * Writes a 256 MB temp file and reads it back through fs.createReadStream
+ * (what the upload path did) and through the native pipeline with 1..N
+ * worker threads (default 1, 2 and 4). The file is warm in the page cache
+ * after the first pass, so this measures pipeline overhead rather than the
+ * disk.
+ */
+
+const fs = require('bare-fs')
+const { Ingest } = require('./index')
+
+const SIZE = 256 * 1024 * 1024
+const path = __dirname + '/bench-ingest.bin'
+
+function mbps(bytes, ms) {
+  return (bytes / 1048576 / (ms / 1000)).toFixed(0).padStart(6)
+}
+
+function streamRead() {
+  return new Promise((resolve, reject) => {
+    let bytes = 0
+    let chunks = 0
+    const stream = fs.createReadStream(path)
+    stream.on('data', (chunk) => {
+      bytes += chunk.length
+      chunks++
+    })
+    stream.on('end', () => resolve({ bytes, chunks }))
+    stream.on('error', reject)
+  })
+}
+
+async function main() {
+  const block = Buffer.alloc(4 * 1024 * 1024)
+  for (let i = 0; i < block.length; i++) block[i] = (i * 131) & 0xff
+  const fd = fs.openSync(path, 'w')
+  for (let at = 0; at < SIZE; at += block.length) fs.writeSync(fd, block, 0, block.length, at)
+  fs.closeSync(fd)
+
+  await streamRead()
+
+  let start = Date.now()
+  const { bytes, chunks } = await streamRead()
+  let ms = Date.now() - start
+  console.log(`  stream    ${mbps(bytes, ms)} MB/s   ${chunks} JS chunks`)
+
+  const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+  const counts = args.length > 0 ? args.map(Number) : [1, 2, 4]
+
+  for (const threads of counts) {
+    const ingest = new Ingest(path, { threads, depth: Math.max(4, threads * 2) })
+    start = Date.now()
+    let batches = 0
+    for await (const batch of ingest) batches += batch.blocks > 0 ? 1 : 0
+    ms = Date.now() - start
+    const stats = ingest.stats()
+    ingest.destroy()
+    console.log(`  native x${threads} ${mbps(stats.bytes, ms)} MB/s   ${batches} JS batches, read ${stats.readTime.toFixed(0)} ms, waited ${stats.waitTime.toFixed(0)} ms`)
+  }
+
+  fs.unlinkSync(path)
+}
+
+main()
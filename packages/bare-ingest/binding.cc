@@ -0,0 +1,395 @@
+/**
+ * bare-ingest - Bare native addon for the upload ingest pipeline
+ * Reads upload sources ahead on worker threads into aligned buffers and
+ * hands batches to JS in order; a uv async handle wakes JS when a batch it
+ * is waiting on is ready
+ */
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <bare.h>
+#include <js.h>
+#include <uv.h>
+
+#include "src/ingest.h"
+
+using bare_ingest::Ingest;
+using bare_ingest::batch_t;
+using bare_ingest::options_t;
+using bare_ingest::segment_t;
+using bare_ingest::stats_t;
+
+// Wakes JS from the worker threads; heap allocated, as it must outlive the
+// handle until uv_close() calls back
+typedef struct {
+  uv_async_t async;
+
+  js_env_t *env;
+  js_ref_t *ctx;
+  js_ref_t *on_ready;
+} bare_ingest_wakeup_t;
+
+// Handle wrapper for Ingest
+typedef struct {
+  Ingest *ingest;
+  bare_ingest_wakeup_t *wakeup;
+} bare_ingest_t;
+
+static bare_ingest_t *
+bare_ingest__ingest(js_env_t *env, js_value_t *value) {
+  bare_ingest_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->ingest) {
+    js_throw_error(env, NULL, "Ingest has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static bool
+bare_ingest__string(js_env_t *env, js_value_t *value, std::string *out) {
+  size_t len;
+  int err = js_get_value_string_utf8(env, value, NULL, 0, &len);
+  if (err != 0) return false;
+
+  out->assign(len + 1, '\0');
+  err = js_get_value_string_utf8(env, value, (utf8_t *) &(*out)[0], len + 1, NULL);
+  if (err != 0) return false;
+
+  out->resize(len);
+  return true;
+}
+
+static js_value_t *
+bare_ingest__bytes(js_env_t *env, const uint8_t *data, size_t len) {
+  int err;
+
+  void *copy;
+  js_value_t *arraybuffer;
+  err = js_create_arraybuffer(env, len, &copy, &arraybuffer);
+  if (err != 0) return NULL;
+
+  if (len > 0) memcpy(copy, data, len);
+
+  js_value_t *result;
+  err = js_create_typedarray(env, js_uint8array, len, arraybuffer, 0, &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+static void
+bare_ingest__on_wakeup(uv_async_t *async) {
+  int err;
+
+  bare_ingest_wakeup_t *wakeup = (bare_ingest_wakeup_t *) async->data;
+  js_env_t *env = wakeup->env;
+
+  js_handle_scope_t *scope;
+  err = js_open_handle_scope(env, &scope);
+  assert(err == 0);
+
+  js_value_t *ctx;
+  err = js_get_reference_value(env, wakeup->ctx, &ctx);
+  assert(err == 0);
+
+  js_value_t *on_ready;
+  err = js_get_reference_value(env, wakeup->on_ready, &on_ready);
+  assert(err == 0);
+
+  js_call_function(env, ctx, on_ready, 0, NULL, NULL);
+
+  err = js_close_handle_scope(env, scope);
+  assert(err == 0);
+}
+
+static void
+bare_ingest__on_close(uv_handle_t *handle) {
+  delete (bare_ingest_wakeup_t *) handle->data;
+}
+
+// (blockSize, batchBlocks, depth, threads, ctx, onready)
+static js_value_t *
+bare_ingest_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 6;
+  js_value_t *argv[6];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t block_size, batch_blocks, depth, threads;
+  err = js_get_value_uint32(env, argv[0], &block_size);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[1], &batch_blocks);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &depth);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[3], &threads);
+  if (err != 0) return NULL;
+
+  options_t options;
+  options.block_size = block_size;
+  options.batch_blocks = batch_blocks;
+  options.depth = depth;
+  options.threads = threads;
+
+  js_value_t *result;
+  bare_ingest_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_ingest_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  uv_loop_t *loop;
+  err = js_get_env_loop(env, &loop);
+  if (err != 0) return NULL;
+
+  bare_ingest_wakeup_t *wakeup = new bare_ingest_wakeup_t();
+  wakeup->env = env;
+  wakeup->async.data = wakeup;
+
+  err = js_create_reference(env, argv[4], 1, &wakeup->ctx);
+  assert(err == 0);
+  err = js_create_reference(env, argv[5], 1, &wakeup->on_ready);
+  assert(err == 0);
+
+  err = uv_async_init(loop, &wakeup->async, bare_ingest__on_wakeup);
+  assert(err == 0);
+
+  // Only keeps the loop alive while JS waits on a batch
+  uv_unref((uv_handle_t *) &wakeup->async);
+
+  handle->wakeup = wakeup;
+  handle->ingest = new Ingest(options);
+  handle->ingest->on_ready([wakeup] { uv_async_send(&wakeup->async); });
+  return result;
+}
+
+// (handle, path, segments) where each segment is a Uint8Array of inline
+// bytes or a [start, end] source range; an empty list reads the whole file
+static js_value_t *
+bare_ingest_start(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_ingest_t *handle = bare_ingest__ingest(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string path;
+  if (!bare_ingest__string(env, argv[1], &path)) return NULL;
+
+  uint32_t count;
+  err = js_get_array_length(env, argv[2], &count);
+  if (err != 0) return NULL;
+
+  std::vector<segment_t> segments(count);
+  for (uint32_t i = 0; i < count; i++) {
+    js_value_t *entry;
+    err = js_get_element(env, argv[2], i, &entry);
+    if (err != 0) return NULL;
+
+    bool is_bytes;
+    err = js_is_typedarray(env, entry, &is_bytes);
+    if (err != 0) return NULL;
+
+    if (is_bytes) {
+      uint8_t *data;
+      size_t len;
+      err = js_get_typedarray_info(env, entry, NULL, (void **) &data, &len, NULL, NULL);
+      if (err != 0) return NULL;
+
+      segments[i].inline_bytes = true;
+      segments[i].bytes.assign(data, data + len);
+      continue;
+    }
+
+    js_value_t *start, *end;
+    int64_t start_value, end_value;
+    err = js_get_element(env, entry, 0, &start);
+    if (err != 0) return NULL;
+    err = js_get_element(env, entry, 1, &end);
+    if (err != 0) return NULL;
+    err = js_get_value_int64(env, start, &start_value);
+    if (err != 0) return NULL;
+    err = js_get_value_int64(env, end, &end_value);
+    if (err != 0) return NULL;
+
+    if (start_value < 0 || end_value < start_value) {
+      js_throw_error(env, NULL, "Invalid segment range");
+      return NULL;
+    }
+
+    segments[i].start = uint64_t(start_value);
+    segments[i].end = uint64_t(end_value);
+  }
+
+  if (!handle->ingest->start(path, std::move(segments))) {
+    js_throw_error(env, NULL, handle->ingest->error().c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Next batch in order: { offset, blocks, data }, null at the end, or
+// undefined while it is being read, in which case onready is called once it
+// is ready
+static js_value_t *
+bare_ingest_next(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_ingest_t *handle = bare_ingest__ingest(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  Ingest *ingest = handle->ingest;
+  bool pending;
+  const batch_t *batch = ingest->next(pending);
+
+  js_value_t *result;
+  if (pending) {
+    uv_ref((uv_handle_t *) &handle->wakeup->async);
+    err = js_get_undefined(env, &result);
+    if (err != 0) return NULL;
+    return result;
+  }
+
+  uv_unref((uv_handle_t *) &handle->wakeup->async);
+
+  if (batch == NULL) {
+    if (!ingest->error().empty()) {
+      js_throw_error(env, NULL, ingest->error().c_str());
+      return NULL;
+    }
+    err = js_get_null(env, &result);
+    if (err != 0) return NULL;
+    return result;
+  }
+
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+  js_value_t *offset, *blocks;
+  js_create_double(env, double(batch->offset), &offset);
+  js_create_double(env, double(batch->blocks), &blocks);
+  js_set_named_property(env, result, "offset", offset);
+  js_set_named_property(env, result, "blocks", blocks);
+
+  js_value_t *data = bare_ingest__bytes(env, batch->data, batch->length);
+  if (data == NULL) return NULL;
+  js_set_named_property(env, result, "data", data);
+
+  ingest->release();
+  return result;
+}
+
+static js_value_t *
+bare_ingest_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_ingest_t *handle = bare_ingest__ingest(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  stats_t stats = handle->ingest->stats();
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("totalBytes", stats.total_bytes);
+  SET_NUMBER("bytes", stats.delivered_bytes);
+  SET_NUMBER("blocks", stats.delivered_blocks);
+  SET_NUMBER("readTime", stats.read_ns / 1e6);
+  SET_NUMBER("waitTime", stats.wait_ns / 1e6);
+  SET_NUMBER("elapsedTime", stats.elapsed_ns / 1e6);
+  SET_NUMBER("threads", stats.threads);
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_ingest_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_ingest_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (handle->ingest == NULL) return NULL;
+
+  // Joins the workers, so nothing signals the async handle after this
+  delete handle->ingest;
+  handle->ingest = NULL;
+
+  bare_ingest_wakeup_t *wakeup = handle->wakeup;
+  handle->wakeup = NULL;
+
+  err = js_delete_reference(env, wakeup->on_ready);
+  assert(err == 0);
+  err = js_delete_reference(env, wakeup->ctx);
+  assert(err == 0);
+
+  uv_close((uv_handle_t *) &wakeup->async, bare_ingest__on_close);
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_ingest_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_ingest_create);
+  EXPORT_FUNCTION(start, bare_ingest_start);
+  EXPORT_FUNCTION(next, bare_ingest_next);
+  EXPORT_FUNCTION(stats, bare_ingest_stats);
+  EXPORT_FUNCTION(destroy, bare_ingest_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_ingest, bare_ingest_exports)
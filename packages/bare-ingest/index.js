@@ -0,0 +1,103 @@
+/**
+ * bare-ingest - Read-ahead pipeline for uploads
+ * Worker threads read the source into large page-aligned buffers with
+ * pread(), several batches ahead of the consumer. Batches come out in
+ * order, so JS only touches the data once per batch rather than once per
+ * read chunk, and waiting for a batch never blocks the event loop.
+ */
+
+const binding = require('./binding')
+
+const DEFAULT_BLOCK_SIZE = 64 * 1024
+const DEFAULT_BATCH_BLOCKS = 64
+const DEFAULT_DEPTH = 4
+
+class Ingest {
+  /**
+   * Start reading a file
+   * @param {string} path
+   * @param {Object} [opts]
+   * @param {Array<{start: number, end: number}|{bytes: Uint8Array}>} [opts.segments] - Output
+   *   in order: source ranges and inline bytes (planFaststart() segments). Defaults to the
+   *   whole file.
+   * @param {number} [opts.blockSize=65536] - Hypercore block size
+   * @param {number} [opts.batchBlocks=64] - Blocks per batch
+   * @param {number} [opts.depth=4] - Batches read ahead
+   * @param {number} [opts.threads=0] - Worker threads (0: up to 4, by core count)
+   */
+  constructor(path, opts = {}) {
+    this._waiting = null
+    this._handle = binding.create(
+      opts.blockSize || DEFAULT_BLOCK_SIZE,
+      opts.batchBlocks || DEFAULT_BATCH_BLOCKS,
+      opts.depth || DEFAULT_DEPTH,
+      opts.threads || 0,
+      this,
+      this._onready
+    )
+
+    const segments = (opts.segments || []).map((s) => (s.bytes ? s.bytes : [s.start, s.end]))
+    try {
+      binding.start(this._handle, path, segments)
+    } catch (err) {
+      this.destroy()
+      throw err
+    }
+  }
+
+  _ingest() {
+    if (this._handle === null) throw new Error('Ingest has been destroyed')
+    return this._handle
+  }
+
+  _onready() {
+    const wake = this._waiting
+    this._waiting = null
+    if (wake) wake()
+  }
+
+  /**
+   * Next batch in output order, once it is read; with the read-ahead that
+   * is usually already the case
+   * @returns {Promise<{offset: number, blocks: number, data: Uint8Array}|null>} null after the last batch
+   */
+  async next() {
+    for (;;) {
+      const batch = binding.next(this._ingest())
+      if (batch !== undefined) return batch
+      await new Promise((resolve) => {
+        this._waiting = resolve
+      })
+    }
+  }
+
+  async * [Symbol.asyncIterator]() {
+    let batch
+    while ((batch = await this.next()) !== null) yield batch
+  }
+
+  /**
+   * Times are in ms; throughput is delivered bytes per second of elapsed
+   * time, progress the delivered fraction.
+   * @returns {{totalBytes: number, bytes: number, blocks: number, readTime: number, waitTime: number,
+   *   elapsedTime: number, threads: number, throughput: number, progress: number}}
+   */
+  stats() {
+    const stats = binding.stats(this._ingest())
+    stats.throughput = stats.elapsedTime > 0 ? stats.bytes / (stats.elapsedTime / 1000) : 0
+    stats.progress = stats.totalBytes > 0 ? stats.bytes / stats.totalBytes : 1
+    return stats
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+    // A pending next() wakes up and throws
+    this._onready()
+  }
+}
+
+module.exports = {
+  Ingest
+}
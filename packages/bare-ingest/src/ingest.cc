@@ -0,0 +1,292 @@
+#include "ingest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bare_ingest {
+
+namespace {
+
+// Buffers are page aligned so the kernel can copy (or DMA) straight in
+constexpr size_t buffer_alignment = 4096;
+
+// Past this, more threads only queue on the disk
+constexpr size_t max_default_threads = 4;
+
+uint64_t
+now_ns() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+void
+Ingest::buffer_deleter::operator()(uint8_t *p) const {
+  ::operator delete[](p, std::align_val_t(buffer_alignment));
+}
+
+Ingest::Ingest(const options_t &options) : options_(options) {
+  if (options_.block_size == 0) options_.block_size = 64 * 1024;
+  if (options_.batch_blocks == 0) options_.batch_blocks = 1;
+  if (options_.depth == 0) options_.depth = 1;
+  batch_size_ = options_.block_size * options_.batch_blocks;
+}
+
+Ingest::~Ingest() {
+  stop();
+
+#ifdef _WIN32
+  if (fd_ != -1) CloseHandle(HANDLE(fd_));
+#else
+  if (fd_ != -1) ::close(int(fd_));
+#endif
+}
+
+void
+Ingest::stop() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread &t : workers_) t.join();
+  workers_.clear();
+}
+
+bool
+Ingest::start(const std::string &path, std::vector<segment_t> segments) {
+  if (fd_ != -1) {
+    error_ = "Ingest already started";
+    return false;
+  }
+
+  uint64_t file_size;
+
+#ifdef _WIN32
+  int wlen = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+  std::wstring wpath(size_t(wlen > 0 ? wlen : 1), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], wlen);
+
+  HANDLE handle = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (handle == INVALID_HANDLE_VALUE) {
+    error_ = "Cannot open " + path;
+    return false;
+  }
+  fd_ = intptr_t(handle);
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size)) {
+    error_ = "Cannot stat " + path;
+    return false;
+  }
+  file_size = uint64_t(size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error_ = "Cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  fd_ = fd;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    error_ = "Cannot stat " + path + ": " + strerror(errno);
+    return false;
+  }
+  file_size = uint64_t(st.st_size);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+
+  if (segments.empty()) {
+    segment_t whole;
+    whole.end = file_size;
+    segments.push_back(std::move(whole));
+  }
+
+  for (segment_t &s : segments) {
+    uint64_t length = s.inline_bytes ? s.bytes.size() : s.end - s.start;
+    if (!s.inline_bytes && (s.start > s.end || s.end > file_size)) {
+      error_ = "Segment lies outside the file";
+      return false;
+    }
+    if (length == 0) continue;
+
+    segment_offsets_.push_back(total_);
+    total_ += length;
+    segments_.push_back(std::move(s));
+  }
+
+  batches_ = (total_ + batch_size_ - 1) / batch_size_;
+  stats_.total_bytes = total_;
+
+  size_t slots = size_t(std::min<uint64_t>(options_.depth, std::max<uint64_t>(batches_, 1)));
+  slots_.resize(slots);
+  for (size_t i = 0; i < slots; i++) {
+    buffers_.emplace_back(static_cast<uint8_t *>(::operator new[](batch_size_, std::align_val_t(buffer_alignment))));
+    slots_[i].data = buffers_.back().get();
+  }
+
+  size_t threads = options_.threads;
+  if (threads == 0) threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), max_default_threads);
+  threads = std::max<size_t>(1, std::min(threads, slots));
+  stats_.threads = uint32_t(threads);
+
+  started_ns_ = now_ns();
+
+  for (size_t i = 0; i < threads; i++) workers_.emplace_back([this] { work(); });
+  return true;
+}
+
+bool
+Ingest::read_at(uint64_t offset, uint8_t *out, size_t len) {
+  while (len > 0) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = DWORD(offset);
+    overlapped.OffsetHigh = DWORD(offset >> 32);
+    DWORD n = 0;
+    DWORD want = DWORD(std::min<size_t>(len, 1u << 30));
+    if (!ReadFile(HANDLE(fd_), out, want, &n, &overlapped) || n == 0) return false;
+#else
+    ssize_t n = pread(int(fd_), out, len, off_t(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+#endif
+    out += n;
+    offset += uint64_t(n);
+    len -= size_t(n);
+  }
+  return true;
+}
+
+bool
+Ingest::fill(batch_t *batch) {
+  uint64_t pos = batch->offset;
+  uint64_t end = pos + batch->length;
+  uint8_t *out = batch->data;
+
+  size_t i = size_t(std::upper_bound(segment_offsets_.begin(), segment_offsets_.end(), pos) - segment_offsets_.begin()) - 1;
+  while (pos < end) {
+    const segment_t &s = segments_[i];
+    uint64_t length = s.inline_bytes ? s.bytes.size() : s.end - s.start;
+    uint64_t skip = pos - segment_offsets_[i];
+    size_t n = size_t(std::min(end - pos, length - skip));
+
+    if (s.inline_bytes) {
+      memcpy(out, s.bytes.data() + skip, n);
+    } else if (!read_at(s.start + skip, out, n)) {
+      return false;
+    }
+
+    out += n;
+    pos += n;
+    i++;
+  }
+  return true;
+}
+
+void
+Ingest::work() {
+  for (;;) {
+    uint64_t k;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      work_cv_.wait(lock, [&] { return stopping_ || claimed_ >= batches_ || claimed_ < consumed_ + slots_.size(); });
+      if (stopping_ || claimed_ >= batches_) return;
+      k = claimed_++;
+    }
+
+    // The slot is ours until ready is set: its previous batch was released
+    batch_t *batch = &slots_[k % slots_.size()];
+    batch->index = k;
+    batch->offset = k * batch_size_;
+    batch->length = size_t(std::min<uint64_t>(batch_size_, total_ - batch->offset));
+    batch->blocks = (batch->length + options_.block_size - 1) / options_.block_size;
+
+    uint64_t t0 = now_ns();
+    bool ok = fill(batch);
+    uint64_t t1 = now_ns();
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      stats_.read_ns += t1 - t0;
+      if (!ok) {
+        if (error_.empty()) error_ = "Read failed at offset " + std::to_string(batch->offset);
+        stopping_ = true;
+      }
+      batch->ready = ok;
+    }
+    if (on_ready_) on_ready_();
+    if (!ok) {
+      work_cv_.notify_all();
+      return;
+    }
+  }
+}
+
+const batch_t *
+Ingest::next(bool &pending) {
+  if (holding_) release();
+  pending = false;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!error_.empty()) return NULL;
+
+  batch_t *batch = NULL;
+  if (consumed_ < batches_) {
+    batch = &slots_[consumed_ % slots_.size()];
+    if (!batch->ready || batch->index != consumed_) {
+      if (waiting_ns_ == 0) waiting_ns_ = now_ns();
+      pending = true;
+      return NULL;
+    }
+    holding_ = true;
+  } else {
+    done_ = true;
+  }
+
+  if (waiting_ns_ != 0) {
+    stats_.wait_ns += now_ns() - waiting_ns_;
+    waiting_ns_ = 0;
+  }
+  return batch;
+}
+
+void
+Ingest::release() {
+  if (!holding_) return;
+  holding_ = false;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    batch_t &batch = slots_[consumed_ % slots_.size()];
+    batch.ready = false;
+    stats_.delivered_bytes += batch.length;
+    stats_.delivered_blocks += batch.blocks;
+    stats_.elapsed_ns = now_ns() - started_ns_;
+    consumed_++;
+  }
+  work_cv_.notify_all();
+}
+
+stats_t
+Ingest::stats() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return stats_;
+}
+
+} // namespace bare_ingest
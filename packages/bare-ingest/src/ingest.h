@@ -0,0 +1,142 @@
+/**
+ * Read-ahead pipeline for uploads.
+ *
+ * The output is a list of segments, each a range of one source file or a
+ * few inline bytes (a rewritten moov, say), cut into batches of whole
+ * blocks the way hyperblobs cuts its write stream. Worker threads claim
+ * batches in order and fill page-aligned buffers with pread(). Up to
+ * `depth` batches are read ahead of the consumer, so several reads are in
+ * flight while JS appends the previous batch.
+ *
+ * next() hands batches out strictly in order and never blocks: while the
+ * next batch is still being read it reports it as pending, and the ready
+ * callback fires (on a worker thread) once it is. release() returns the
+ * batch's buffer to the workers.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bare_ingest {
+
+struct options_t {
+  // Hypercore block size; batches are whole blocks
+  size_t block_size = 64 * 1024;
+  // Blocks per batch handed to JS
+  size_t batch_blocks = 64;
+  // Batches read ahead of the consumer
+  size_t depth = 4;
+  // Reader/hasher threads (0: hardware concurrency, capped)
+  size_t threads = 0;
+};
+
+struct segment_t {
+  // Source range [start, end) of the file, unless inline_bytes is set
+  uint64_t start = 0;
+  uint64_t end = 0;
+  bool inline_bytes = false;
+  std::vector<uint8_t> bytes;
+};
+
+struct batch_t {
+  uint64_t index = 0;
+  // Output offset of data[0]
+  uint64_t offset = 0;
+  size_t length = 0;
+  size_t blocks = 0;
+  uint8_t *data = nullptr;
+  bool ready = false;
+};
+
+struct stats_t {
+  uint64_t total_bytes = 0;
+  // Bytes handed to the consumer
+  uint64_t delivered_bytes = 0;
+  uint64_t delivered_blocks = 0;
+  // Thread time reading, summed over workers
+  uint64_t read_ns = 0;
+  // Time the consumer waited on a pending batch
+  uint64_t wait_ns = 0;
+  // Wall time from start() to the last delivery
+  uint64_t elapsed_ns = 0;
+  uint32_t threads = 0;
+};
+
+class Ingest {
+public:
+  explicit Ingest(const options_t &options);
+  ~Ingest();
+
+  Ingest(const Ingest &) = delete;
+  Ingest &operator=(const Ingest &) = delete;
+
+  // Called on a worker thread when a batch is ready or reading fails; set
+  // before start()
+  void on_ready(std::function<void()> fn) { on_ready_ = std::move(fn); }
+
+  // Open `path` and start reading. An empty segment list means the whole
+  // file. False with error() set if the file cannot be opened or a segment
+  // lies outside it.
+  bool start(const std::string &path, std::vector<segment_t> segments);
+
+  // Next batch in output order. NULL at the end, on a read error (error()
+  // set), or with `pending` set while the batch is still being read. The
+  // batch stays valid until release().
+  const batch_t *next(bool &pending);
+  void release();
+
+  // Every batch was handed out
+  bool done() const { return done_; }
+
+  const std::string &error() const { return error_; }
+  stats_t stats();
+
+private:
+  struct buffer_deleter {
+    void operator()(uint8_t *p) const;
+  };
+
+  void work();
+  bool fill(batch_t *batch);
+  bool read_at(uint64_t offset, uint8_t *out, size_t len);
+  void stop();
+
+  options_t options_;
+  size_t batch_size_;
+
+  intptr_t fd_ = -1;
+  std::vector<segment_t> segments_;
+  std::vector<uint64_t> segment_offsets_; // output offset of each segment
+  uint64_t total_ = 0;
+  uint64_t batches_ = 0;
+
+  std::vector<batch_t> slots_;
+  std::vector<std::unique_ptr<uint8_t, buffer_deleter>> buffers_;
+  std::vector<std::thread> workers_;
+
+  std::mutex lock_;
+  std::condition_variable work_cv_;
+  std::function<void()> on_ready_;
+  bool stopping_ = false;
+  uint64_t claimed_ = 0;
+  uint64_t consumed_ = 0;
+  bool holding_ = false;
+  std::string error_;
+  bool done_ = false;
+
+  stats_t stats_;
+  uint64_t started_ns_ = 0;
+  // When the consumer first found the current batch pending, or 0
+  uint64_t waiting_ns_ = 0;
+};
+
+} // namespace bare_ingest
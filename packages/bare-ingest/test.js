@@ -0,0 +1,96 @@
+/**
+ * Simple test for bare-ingest addon
+ * Ingests a temp file whole and as faststart-style segments, and checks the
+ * bytes and the batch order.
+ */
+
+const fs = require('bare-fs')
+const { Ingest } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+async function collect(ingest) {
+  const data = []
+  const offsets = []
+  let blocks = 0
+  for await (const batch of ingest) {
+    offsets.push(batch.offset)
+    data.push(batch.data)
+    blocks += batch.blocks
+  }
+  return { data: Buffer.concat(data), offsets, blocks }
+}
+
+const BLOCK = 64 * 1024
+const path = __dirname + '/test-ingest.bin'
+
+async function main() {
+  // Six identical blocks, then a short tail
+  const file = Buffer.alloc(6 * BLOCK + 3, 7)
+  file.write('abc', 6 * BLOCK)
+  fs.writeFileSync(path, file)
+
+  // Whole file, 2 blocks per batch, more threads than batches in flight
+  let ingest = new Ingest(path, { batchBlocks: 2, depth: 2, threads: 4 })
+  let out = await collect(ingest)
+  check('bytes', out.data.equals(file), true)
+  check('batches in order', out.offsets, [0, 2 * BLOCK, 4 * BLOCK, 6 * BLOCK])
+  check('block count', out.blocks, 7)
+
+  const stats = ingest.stats()
+  check('stats', [stats.bytes, stats.blocks, stats.totalBytes, stats.progress], [file.length, 7, file.length, 1])
+  check('threads capped by depth', stats.threads, 2)
+  check('throughput', stats.throughput > 0, true)
+  check('null after the end', await ingest.next(), null)
+  ingest.destroy()
+
+  // Segments: source ranges with inline bytes between them, cut into blocks
+  // across segment boundaries
+  const moov = Buffer.from('moov-bytes')
+  const segments = [{ start: 0, end: 100 }, { bytes: moov }, { start: 100, end: file.length }]
+  ingest = new Ingest(path, { segments, batchBlocks: 1 })
+  out = await collect(ingest)
+  check('segment bytes', out.data.equals(Buffer.concat([file.subarray(0, 100), moov, file.subarray(100)])), true)
+  check('segment blocks', out.blocks, 7)
+  ingest.destroy()
+
+  // Reading stops at the end of each range
+  ingest = new Ingest(path, { segments: [{ start: 6 * BLOCK, end: 6 * BLOCK + 3 }] })
+  out = await collect(ingest)
+  check('range only', out.data.toString(), 'abc')
+  ingest.destroy()
+
+  // next() hands back a promise rather than waiting on the reader threads
+  ingest = new Ingest(path, { batchBlocks: 1, depth: 1, threads: 1 })
+  const first = ingest.next()
+  check('next() does not block', first instanceof Promise, true)
+  check('first batch', (await first).offset, 0)
+  out = await collect(ingest)
+  check('rest after it', out.data.equals(file.subarray(BLOCK)), true)
+  ingest.destroy()
+
+  let threw = false
+  try { new Ingest(path, { segments: [{ start: 0, end: file.length + 1 }] }) } catch { threw = true }
+  check('range past the end throws', threw, true)
+
+  threw = false
+  try { new Ingest(__dirname + '/missing.bin') } catch { threw = true }
+  check('missing file throws', threw, true)
+
+  ingest = new Ingest(path)
+  ingest.destroy()
+  ingest.destroy()
+  threw = false
+  try { await ingest.next() } catch { threw = true }
+  check('destroyed ingest throws', threw, true)
+
+  fs.unlinkSync(path)
+  console.log('all tests passed')
+}
+
+main()
@@ -0,0 +1,423 @@
+/**
+ * bare-media-index - Bare native addon for container index planning
+ * Locates MKV Cues / MP4 moov ranges so readers prefetch exactly what FFmpeg needs,
+ * and plans upload-time faststart remuxes with a keyframe index
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/container.h"
+#include "src/faststart.h"
+
+using bare_media_index::ContainerPlanner;
+using bare_media_index::FaststartPlanner;
+using bare_media_index::byte_range_t;
+using bare_media_index::output_segment_t;
+
+// Handle wrapper for ContainerPlanner
+typedef struct {
+  ContainerPlanner *planner;
+} bare_media_index_planner_t;
+
+static bare_media_index_planner_t *
+bare_media_index__planner(js_env_t *env, js_value_t *value) {
+  bare_media_index_planner_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->planner) {
+    js_throw_error(env, NULL, "Planner has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Create planner for a file of the given size
+static js_value_t *
+bare_media_index_planner_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  int64_t file_size;
+  err = js_get_value_int64(env, argv[0], &file_size);
+  if (err != 0) return NULL;
+
+  if (file_size < 0) {
+    js_throw_error(env, NULL, "File size must be non-negative");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_media_index_planner_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_media_index_planner_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->planner = new ContainerPlanner(uint64_t(file_size));
+  return result;
+}
+
+// Feed bytes at an absolute offset, returns planner status
+static js_value_t *
+bare_media_index_planner_feed(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_planner_t *handle = bare_media_index__planner(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  int64_t offset;
+  err = js_get_value_int64(env, argv[1], &offset);
+  if (err != 0) return NULL;
+
+  uint8_t *data;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], NULL, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  int status = offset < 0 ? handle->planner->status() : handle->planner->feed(uint64_t(offset), data, len);
+
+  js_value_t *result;
+  js_create_int32(env, status, &result);
+  return result;
+}
+
+// Get current state: { status, container, needOffset, needLength, ranges }
+static js_value_t *
+bare_media_index_planner_state(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_planner_t *handle = bare_media_index__planner(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  ContainerPlanner *planner = handle->planner;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("status", planner->status());
+  SET_NUMBER("container", planner->container());
+  SET_NUMBER("needOffset", planner->need_offset());
+  SET_NUMBER("needLength", planner->need_length());
+  SET_NUMBER("bytesFed", planner->bytes_fed());
+
+#undef SET_NUMBER
+
+  const auto &ranges = planner->ranges();
+
+  js_value_t *array;
+  err = js_create_array_with_length(env, ranges.size(), &array);
+  if (err != 0) return NULL;
+
+  for (uint32_t i = 0; i < ranges.size(); i++) {
+    const byte_range_t &r = ranges[i];
+
+    js_value_t *entry, *start, *end, *kind;
+    js_create_object(env, &entry);
+    js_create_double(env, double(r.start), &start);
+    js_create_double(env, double(r.end), &end);
+    js_create_int32(env, r.kind, &kind);
+    js_set_named_property(env, entry, "start", start);
+    js_set_named_property(env, entry, "end", end);
+    js_set_named_property(env, entry, "kind", kind);
+    js_set_element(env, array, i, entry);
+  }
+
+  js_set_named_property(env, result, "ranges", array);
+  return result;
+}
+
+// Destroy planner
+static js_value_t *
+bare_media_index_planner_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_planner_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->planner;
+  handle->planner = NULL;
+
+  return NULL;
+}
+
+// Handle wrapper for FaststartPlanner
+typedef struct {
+  FaststartPlanner *planner;
+} bare_media_index_faststart_t;
+
+static bare_media_index_faststart_t *
+bare_media_index__faststart(js_env_t *env, js_value_t *value) {
+  bare_media_index_faststart_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->planner) {
+    js_throw_error(env, NULL, "Faststart planner has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static js_value_t *
+bare_media_index__bytes(js_env_t *env, const std::vector<uint8_t> &bytes) {
+  int err;
+
+  js_value_t *result;
+  if (bytes.empty()) {
+    err = js_get_null(env, &result);
+    if (err != 0) return NULL;
+    return result;
+  }
+
+  void *data;
+  js_value_t *arraybuffer;
+  err = js_create_arraybuffer(env, bytes.size(), &data, &arraybuffer);
+  if (err != 0) return NULL;
+
+  memcpy(data, bytes.data(), bytes.size());
+
+  err = js_create_typedarray(env, js_uint8array, bytes.size(), arraybuffer, 0, &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+// Create faststart planner for a file of the given size
+static js_value_t *
+bare_media_index_faststart_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  int64_t file_size;
+  err = js_get_value_int64(env, argv[0], &file_size);
+  if (err != 0) return NULL;
+
+  if (file_size < 0) {
+    js_throw_error(env, NULL, "File size must be non-negative");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_media_index_faststart_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_media_index_faststart_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->planner = new FaststartPlanner(uint64_t(file_size));
+  return result;
+}
+
+// Feed bytes at an absolute offset, returns planner status
+static js_value_t *
+bare_media_index_faststart_feed(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_faststart_t *handle = bare_media_index__faststart(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  int64_t offset;
+  err = js_get_value_int64(env, argv[1], &offset);
+  if (err != 0) return NULL;
+
+  uint8_t *data;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], NULL, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  int status = offset < 0 ? handle->planner->status() : handle->planner->feed(uint64_t(offset), data, len);
+
+  js_value_t *result;
+  js_create_int32(env, status, &result);
+  return result;
+}
+
+// Get current state: { status, needOffset, needLength, bytesFed, remux,
+// outputSize, keyframes, layout }
+static js_value_t *
+bare_media_index_faststart_state(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_faststart_t *handle = bare_media_index__faststart(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  FaststartPlanner *planner = handle->planner;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("status", planner->status());
+  SET_NUMBER("needOffset", planner->need_offset());
+  SET_NUMBER("needLength", planner->need_length());
+  SET_NUMBER("bytesFed", planner->bytes_fed());
+  SET_NUMBER("outputSize", planner->output_size());
+  SET_NUMBER("keyframes", planner->keyframes());
+
+#undef SET_NUMBER
+
+  js_value_t *remux;
+  js_get_boolean(env, planner->remux(), &remux);
+  js_set_named_property(env, result, "remux", remux);
+
+  const auto &layout = planner->layout();
+
+  js_value_t *array;
+  err = js_create_array_with_length(env, layout.size(), &array);
+  if (err != 0) return NULL;
+
+  for (uint32_t i = 0; i < layout.size(); i++) {
+    const output_segment_t &s = layout[i];
+
+    js_value_t *entry, *start, *end, *moov;
+    js_create_object(env, &entry);
+    js_create_double(env, double(s.start), &start);
+    js_create_double(env, double(s.end), &end);
+    js_get_boolean(env, s.moov, &moov);
+    js_set_named_property(env, entry, "start", start);
+    js_set_named_property(env, entry, "end", end);
+    js_set_named_property(env, entry, "moov", moov);
+    js_set_element(env, array, i, entry);
+  }
+
+  js_set_named_property(env, result, "layout", array);
+  return result;
+}
+
+// Rewritten moov bytes, or null when the file needs no remux
+static js_value_t *
+bare_media_index_faststart_moov(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_faststart_t *handle = bare_media_index__faststart(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  return bare_media_index__bytes(env, handle->planner->moov());
+}
+
+// Encoded keyframe index, or null when there is no usable video track
+static js_value_t *
+bare_media_index_faststart_index(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_faststart_t *handle = bare_media_index__faststart(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  return bare_media_index__bytes(env, handle->planner->keyframe_index());
+}
+
+// Destroy faststart planner
+static js_value_t *
+bare_media_index_faststart_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_media_index_faststart_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->planner;
+  handle->planner = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_media_index_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(plannerCreate, bare_media_index_planner_create);
+  EXPORT_FUNCTION(plannerFeed, bare_media_index_planner_feed);
+  EXPORT_FUNCTION(plannerState, bare_media_index_planner_state);
+  EXPORT_FUNCTION(plannerDestroy, bare_media_index_planner_destroy);
+  EXPORT_FUNCTION(faststartCreate, bare_media_index_faststart_create);
+  EXPORT_FUNCTION(faststartFeed, bare_media_index_faststart_feed);
+  EXPORT_FUNCTION(faststartState, bare_media_index_faststart_state);
+  EXPORT_FUNCTION(faststartMoov, bare_media_index_faststart_moov);
+  EXPORT_FUNCTION(faststartIndex, bare_media_index_faststart_index);
+  EXPORT_FUNCTION(faststartDestroy, bare_media_index_faststart_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_media_index, bare_media_index_exports)
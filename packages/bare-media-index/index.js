@@ -0,0 +1,304 @@
+/**
+ * bare-media-index - Container index planning for progressive readers
+ * Finds the exact byte ranges of MKV Cues / MP4 moov so readers can prefetch
+ * them instead of guessing a fixed tail size. At upload time, plans a
+ * faststart copy of MP4s (moov moved in front of the media data) and builds
+ * a keyframe time -> byte offset index to store next to the blob.
+ */
+
+const binding = require('./binding')
+
+const STATUS_NEED_DATA = 0
+const STATUS_DONE = 1
+const STATUS_UNSUPPORTED = 2
+
+const CONTAINERS = ['unknown', 'matroska', 'mp4']
+const RANGE_KINDS = { 1: 'cues', 2: 'moov', 3: 'sidx' }
+
+// Max planner round trips before giving up (each one is a tiny read)
+const DEFAULT_MAX_ROUND_TRIPS = 8
+
+// Faststart walks one header per top-level atom, then reads moov
+const DEFAULT_FASTSTART_ROUND_TRIPS = 64
+
+const KEYFRAME_INDEX_MAGIC = 'PKFI'
+const KEYFRAME_INDEX_VERSION = 1
+
+class ContainerPlanner {
+  /**
+   * @param {number} fileSize - Total size of the file in bytes
+   */
+  constructor(fileSize) {
+    this._handle = binding.plannerCreate(fileSize)
+  }
+
+  /**
+   * Feed bytes located at an absolute file offset
+   * @param {number} offset - Absolute offset of data[0]
+   * @param {Uint8Array} data - Bytes read from the file
+   * @returns {number} Planner status
+   */
+  feed(offset, data) {
+    return binding.plannerFeed(this._handle, offset, data)
+  }
+
+  /**
+   * Current planner state
+   * @returns {{status: number, container: string, need: {offset: number, length: number}|null, ranges: Array<{start: number, end: number, kind: string}>, bytesFed: number}}
+   */
+  get state() {
+    const raw = binding.plannerState(this._handle)
+    return {
+      status: raw.status,
+      container: CONTAINERS[raw.container] || 'unknown',
+      need: raw.status === STATUS_NEED_DATA ? { offset: raw.needOffset, length: raw.needLength } : null,
+      ranges: raw.ranges.map((r) => ({ start: r.start, end: r.end, kind: RANGE_KINDS[r.kind] || 'unknown' })),
+      bytesFed: raw.bytesFed
+    }
+  }
+
+  /**
+   * Free the native planner
+   */
+  destroy() {
+    if (this._handle) {
+      binding.plannerDestroy(this._handle)
+      this._handle = null
+    }
+  }
+}
+
+/**
+ * Plan the index prefetch for a file.
+ *
+ * @param {number} fileSize - Total size of the file in bytes
+ * @param {(offset: number, length: number) => Promise<Uint8Array|null>} read - Range reader
+ * @param {Object} [opts]
+ * @param {number} [opts.maxRoundTrips] - Give up after this many reads
+ * @returns {Promise<{container: string, ranges: Array<{start: number, end: number, kind: string}>, bytesFed: number, roundTrips: number}|null>}
+ *   null when the container is not recognised or the walk did not finish
+ */
+async function planPrefetch(fileSize, read, opts = {}) {
+  const maxRoundTrips = opts.maxRoundTrips || DEFAULT_MAX_ROUND_TRIPS
+  const planner = new ContainerPlanner(fileSize)
+  let roundTrips = 0
+
+  try {
+    let state = planner.state
+    while (state.status === STATUS_NEED_DATA && roundTrips < maxRoundTrips) {
+      const { offset, length } = state.need
+      const data = await read(offset, length)
+      roundTrips++
+      if (!data || data.length === 0) return null
+      planner.feed(offset, data)
+      state = planner.state
+    }
+
+    if (state.status !== STATUS_DONE) return null
+
+    return {
+      container: state.container,
+      ranges: state.ranges,
+      bytesFed: state.bytesFed,
+      roundTrips
+    }
+  } finally {
+    planner.destroy()
+  }
+}
+
+class FaststartPlanner {
+  /**
+   * @param {number} fileSize - Total size of the file in bytes
+   */
+  constructor(fileSize) {
+    this._handle = binding.faststartCreate(fileSize)
+  }
+
+  /**
+   * Feed bytes located at an absolute file offset
+   * @param {number} offset - Absolute offset of data[0]
+   * @param {Uint8Array} data - Bytes read from the file
+   * @returns {number} Planner status
+   */
+  feed(offset, data) {
+    return binding.faststartFeed(this._handle, offset, data)
+  }
+
+  /**
+   * Current planner state. layout lists the output in order: source ranges
+   * to copy, and one entry with moov set where the rewritten moov goes.
+   * @returns {{status: number, need: {offset: number, length: number}|null, remux: boolean, outputSize: number, keyframes: number, layout: Array<{start: number, end: number, moov: boolean}>, bytesFed: number}}
+   */
+  get state() {
+    const raw = binding.faststartState(this._handle)
+    return {
+      status: raw.status,
+      need: raw.status === STATUS_NEED_DATA ? { offset: raw.needOffset, length: raw.needLength } : null,
+      remux: raw.remux,
+      outputSize: raw.outputSize,
+      keyframes: raw.keyframes,
+      layout: raw.layout,
+      bytesFed: raw.bytesFed
+    }
+  }
+
+  /**
+   * Rewritten moov, or null when the file needs no remux
+   * @returns {Uint8Array|null}
+   */
+  get moov() {
+    return binding.faststartMoov(this._handle)
+  }
+
+  /**
+   * Encoded keyframe index (see decodeKeyframeIndex), or null when the
+   * file has no usable video track
+   * @returns {Uint8Array|null}
+   */
+  get keyframeIndex() {
+    return binding.faststartIndex(this._handle)
+  }
+
+  /**
+   * Free the native planner
+   */
+  destroy() {
+    if (this._handle) {
+      binding.faststartDestroy(this._handle)
+      this._handle = null
+    }
+  }
+}
+
+/**
+ * Plan a faststart copy of an MP4 and build its keyframe index.
+ *
+ * The copy is the concatenation of `segments` in order: `{start, end}`
+ * source ranges and `{bytes}` for the rewritten moov. When `remux` is false
+ * the file is already faststart and the single segment is the whole file.
+ *
+ * @param {number} fileSize - Total size of the file in bytes
+ * @param {(offset: number, length: number) => Promise<Uint8Array|null>} read - Range reader
+ * @param {Object} [opts]
+ * @param {number} [opts.maxRoundTrips] - Give up after this many reads
+ * @returns {Promise<{remux: boolean, segments: Array<{start: number, end: number}|{bytes: Uint8Array}>, outputSize: number, keyframeIndex: Uint8Array|null, keyframes: number, bytesFed: number, roundTrips: number}|null>}
+ *   null for anything but a non-fragmented MP4 the planner can read
+ */
+async function planFaststart(fileSize, read, opts = {}) {
+  const maxRoundTrips = opts.maxRoundTrips || DEFAULT_FASTSTART_ROUND_TRIPS
+  const planner = new FaststartPlanner(fileSize)
+  let roundTrips = 0
+
+  try {
+    let state = planner.state
+    while (state.status === STATUS_NEED_DATA && roundTrips < maxRoundTrips) {
+      const { offset, length } = state.need
+      const data = await read(offset, length)
+      roundTrips++
+      if (!data || data.length === 0) return null
+      planner.feed(offset, data)
+      state = planner.state
+    }
+
+    if (state.status !== STATUS_DONE) return null
+
+    const moov = planner.moov
+    return {
+      remux: state.remux,
+      segments: state.layout.map((s) => (s.moov ? { bytes: moov } : { start: s.start, end: s.end })),
+      outputSize: state.outputSize,
+      keyframeIndex: planner.keyframeIndex,
+      keyframes: state.keyframes,
+      bytesFed: state.bytesFed,
+      roundTrips
+    }
+  } finally {
+    planner.destroy()
+  }
+}
+
+/**
+ * Decode a keyframe index built by planFaststart()
+ *
+ * @param {Uint8Array} bytes
+ * @returns {{durationMs: number, headEnd: number, times: Float64Array, offsets: Float64Array}|null}
+ *   times (ms) and byte offsets of each keyframe in decode order; headEnd is
+ *   where moov ends. null if the bytes are not an index.
+ */
+function decodeKeyframeIndex(bytes) {
+  if (!bytes || bytes.length < 5) return null
+  for (let i = 0; i < 4; i++) {
+    if (bytes[i] !== KEYFRAME_INDEX_MAGIC.charCodeAt(i)) return null
+  }
+  if (bytes[4] !== KEYFRAME_INDEX_VERSION) return null
+
+  let at = 5
+  const uvarint = () => {
+    let value = 0
+    let scale = 1
+    while (at < bytes.length) {
+      const b = bytes[at++]
+      value += (b & 0x7f) * scale
+      if (b < 0x80) return value
+      scale *= 128
+    }
+    throw new Error('Truncated keyframe index')
+  }
+  const svarint = () => {
+    const v = uvarint()
+    return v % 2 === 0 ? v / 2 : -(v + 1) / 2
+  }
+
+  try {
+    const durationMs = uvarint()
+    const headEnd = uvarint()
+    const count = uvarint()
+    const times = new Float64Array(count)
+    const offsets = new Float64Array(count)
+    let time = 0
+    let offset = 0
+    for (let i = 0; i < count; i++) {
+      time += svarint()
+      offset += svarint()
+      times[i] = time
+      offsets[i] = offset
+    }
+    return { durationMs, headEnd, times, offsets }
+  } catch {
+    return null
+  }
+}
+
+/**
+ * Last keyframe at or before a time
+ *
+ * @param {{times: Float64Array, offsets: Float64Array}} index - From decodeKeyframeIndex()
+ * @param {number} timeMs
+ * @returns {{time: number, offset: number}|null}
+ */
+function findKeyframe(index, timeMs) {
+  const { times, offsets } = index
+  if (times.length === 0) return null
+
+  let lo = 0
+  let hi = times.length - 1
+  while (lo < hi) {
+    const mid = (lo + hi + 1) >>> 1
+    if (times[mid] <= timeMs) lo = mid
+    else hi = mid - 1
+  }
+  return { time: times[lo], offset: offsets[lo] }
+}
+
+module.exports = {
+  ContainerPlanner,
+  FaststartPlanner,
+  planPrefetch,
+  planFaststart,
+  decodeKeyframeIndex,
+  findKeyframe,
+  STATUS_NEED_DATA,
+  STATUS_DONE,
+  STATUS_UNSUPPORTED
+}
@@ -0,0 +1,421 @@
+#include "container.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bare_media_index {
+
+namespace {
+
+// EBML element IDs (marker bits included, as they appear on the wire)
+constexpr uint32_t ebml_id_header = 0x1A45DFA3;
+constexpr uint32_t mkv_id_segment = 0x18538067;
+constexpr uint32_t mkv_id_seekhead = 0x114D9B74;
+constexpr uint32_t mkv_id_seek = 0x4DBB;
+constexpr uint32_t mkv_id_seek_id = 0x53AB;
+constexpr uint32_t mkv_id_seek_position = 0x53AC;
+constexpr uint32_t mkv_id_cues = 0x1C53BB6B;
+constexpr uint32_t mkv_id_cluster = 0x1F43B675;
+
+// Largest EBML element header: 4 byte ID + 8 byte size
+constexpr uint32_t ebml_max_header = 12;
+
+// Largest ISO-BMFF box header: 4 byte size + 4 byte type + 8 byte largesize
+constexpr uint32_t mp4_max_header = 16;
+
+// SeekHeads are a few hundred bytes; anything larger is not worth chasing
+constexpr uint64_t max_seekhead_size = 1024 * 1024;
+
+// Bound the walks so corrupt files cannot spin the planner
+constexpr int max_level1_elements = 256;
+constexpr int max_mp4_boxes = 1024;
+
+constexpr uint32_t
+fourcc(const char *s) {
+  return (uint32_t(uint8_t(s[0])) << 24) | (uint32_t(uint8_t(s[1])) << 16) | (uint32_t(uint8_t(s[2])) << 8) | uint32_t(uint8_t(s[3]));
+}
+
+inline uint32_t
+read_be32(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t
+read_be64(const uint8_t *p) {
+  return (uint64_t(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+// EBML variable-length ID. Returns encoded length (1-4) or 0 if invalid/short.
+uint32_t
+ebml_read_id(const uint8_t *p, uint64_t avail, uint32_t *id) {
+  if (avail < 1 || p[0] == 0) return 0;
+
+  uint32_t len = 1;
+  for (uint8_t mask = 0x80; !(p[0] & mask); mask >>= 1) len++;
+  if (len > 4 || len > avail) return 0;
+
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < len; i++) value = (value << 8) | p[i];
+
+  *id = value;
+  return len;
+}
+
+// EBML variable-length size. Returns encoded length (1-8) or 0 if invalid/short.
+// An all-ones payload means "unknown size" and is reported as UINT64_MAX.
+uint32_t
+ebml_read_size(const uint8_t *p, uint64_t avail, uint64_t *size) {
+  if (avail < 1 || p[0] == 0) return 0;
+
+  uint32_t len = 1;
+  uint8_t mask = 0x80;
+  while (!(p[0] & mask)) {
+    mask >>= 1;
+    len++;
+  }
+  if (len > avail) return 0;
+
+  uint64_t value = p[0] & (mask - 1);
+  bool all_ones = value == uint64_t(mask - 1);
+  for (uint32_t i = 1; i < len; i++) {
+    value = (value << 8) | p[i];
+    all_ones = all_ones && p[i] == 0xff;
+  }
+
+  *size = all_ones ? UINT64_MAX : value;
+  return len;
+}
+
+bool
+is_mp4_box_type(uint32_t type) {
+  switch (type) {
+  case fourcc("ftyp"):
+  case fourcc("styp"):
+  case fourcc("moov"):
+  case fourcc("mdat"):
+  case fourcc("free"):
+  case fourcc("skip"):
+  case fourcc("wide"):
+  case fourcc("pnot"):
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+ContainerPlanner::ContainerPlanner(uint64_t file_size) : file_size_(file_size) {
+  need_length_ = uint32_t(std::min<uint64_t>(head_probe_size, file_size));
+  if (file_size == 0) status_ = planner_unsupported;
+}
+
+planner_status_t
+ContainerPlanner::feed(uint64_t offset, const uint8_t *data, size_t len) {
+  if (status_ != planner_need_data) return status_;
+  if (offset >= file_size_ || len == 0) return status_;
+
+  len = size_t(std::min<uint64_t>(len, file_size_ - offset));
+
+  chunk_t chunk;
+  chunk.offset = offset;
+  chunk.data.assign(data, data + len);
+  chunks_.push_back(std::move(chunk));
+  bytes_fed_ += len;
+
+  run();
+  return status_;
+}
+
+bool
+ContainerPlanner::read(uint64_t offset, uint64_t len, const uint8_t **out) const {
+  for (const chunk_t &chunk : chunks_) {
+    if (offset >= chunk.offset && offset + len <= chunk.offset + chunk.data.size()) {
+      *out = chunk.data.data() + (offset - chunk.offset);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+ContainerPlanner::require(uint64_t offset, uint64_t len, const uint8_t **out) {
+  if (offset >= file_size_) return false;
+  len = std::min(len, file_size_ - offset);
+
+  if (read(offset, len, out)) return true;
+
+  need_offset_ = offset;
+  need_length_ = uint32_t(len);
+  status_ = planner_need_data;
+  return false;
+}
+
+void
+ContainerPlanner::add_range(uint64_t start, uint64_t end, range_kind_t kind) {
+  end = std::min(end, file_size_);
+  if (start >= end) return;
+  ranges_.push_back({start, end, kind});
+}
+
+void
+ContainerPlanner::finish() {
+  std::sort(ranges_.begin(), ranges_.end(), [](const byte_range_t &a, const byte_range_t &b) {
+    return a.start < b.start;
+  });
+
+  std::vector<byte_range_t> merged;
+  for (const byte_range_t &r : ranges_) {
+    if (!merged.empty() && merged.back().kind == r.kind && r.start <= merged.back().end) {
+      merged.back().end = std::max(merged.back().end, r.end);
+    } else {
+      merged.push_back(r);
+    }
+  }
+
+  ranges_ = std::move(merged);
+  status_ = planner_done;
+}
+
+void
+ContainerPlanner::run() {
+  ranges_.clear();
+
+  if (container_ == container_unknown) {
+    const uint8_t *p;
+    uint64_t probe = std::min<uint64_t>(12, file_size_);
+    if (!read(0, probe, &p)) {
+      need_offset_ = 0;
+      need_length_ = uint32_t(std::min<uint64_t>(head_probe_size, file_size_));
+      return;
+    }
+
+    if (probe >= 4 && read_be32(p) == ebml_id_header) {
+      container_ = container_matroska;
+    } else if (probe >= 8 && is_mp4_box_type(read_be32(p + 4))) {
+      container_ = container_mp4;
+    } else {
+      status_ = planner_unsupported;
+      return;
+    }
+  }
+
+  if (container_ == container_matroska) run_matroska();
+  else run_mp4();
+}
+
+// Returns 1 when the header was parsed, 0 when more data is needed (need_*
+// updated) and -1 when the bytes do not form a valid element header.
+int
+ContainerPlanner::read_element(uint64_t offset, uint32_t *id, uint64_t *size, uint32_t *header_len) {
+  const uint8_t *p;
+  if (!require(offset, ebml_max_header, &p)) return offset >= file_size_ ? -1 : 0;
+
+  uint64_t avail = std::min<uint64_t>(ebml_max_header, file_size_ - offset);
+
+  uint32_t id_len = ebml_read_id(p, avail, id);
+  if (id_len == 0) return -1;
+
+  uint32_t size_len = ebml_read_size(p + id_len, avail - id_len, size);
+  if (size_len == 0) return -1;
+
+  *header_len = id_len + size_len;
+  return 1;
+}
+
+bool
+ContainerPlanner::parse_seekhead(const uint8_t *body, uint64_t len) {
+  bool found_cues = false;
+  uint64_t pos = 0;
+
+  while (pos < len) {
+    uint32_t id;
+    uint64_t size;
+    uint32_t id_len = ebml_read_id(body + pos, len - pos, &id);
+    if (id_len == 0) break;
+    uint32_t size_len = ebml_read_size(body + pos + id_len, len - pos - id_len, &size);
+    if (size_len == 0 || size == UINT64_MAX) break;
+
+    uint64_t child = pos + id_len + size_len;
+    if (child + size > len) break;
+
+    if (id == mkv_id_seek) {
+      uint32_t target = 0;
+      uint64_t position = UINT64_MAX;
+      uint64_t q = child;
+
+      while (q < child + size) {
+        uint32_t sub_id;
+        uint64_t sub_size;
+        uint32_t sub_id_len = ebml_read_id(body + q, child + size - q, &sub_id);
+        if (sub_id_len == 0) break;
+        uint32_t sub_size_len = ebml_read_size(body + q + sub_id_len, child + size - q - sub_id_len, &sub_size);
+        if (sub_size_len == 0 || sub_size > 8) break;
+
+        const uint8_t *value = body + q + sub_id_len + sub_size_len;
+        if (value + sub_size > body + child + size) break;
+
+        uint64_t v = 0;
+        for (uint64_t i = 0; i < sub_size; i++) v = (v << 8) | value[i];
+
+        if (sub_id == mkv_id_seek_id) target = uint32_t(v);
+        else if (sub_id == mkv_id_seek_position) position = v;
+
+        q += sub_id_len + sub_size_len + sub_size;
+      }
+
+      if (position != UINT64_MAX) {
+        uint64_t absolute = segment_data_ + position;
+        if (target == mkv_id_cues) {
+          seek_cues_.push_back(absolute);
+          found_cues = true;
+        } else if (target == mkv_id_seekhead) {
+          seek_heads_.push_back(absolute);
+        }
+      }
+    }
+
+    pos = child + size;
+  }
+
+  return found_cues;
+}
+
+void
+ContainerPlanner::run_matroska() {
+  seek_cues_.clear();
+  seek_heads_.clear();
+
+  uint32_t id;
+  uint64_t size;
+  uint32_t header_len;
+
+  // EBML header
+  int res = read_element(0, &id, &size, &header_len);
+  if (res == 0) return;
+  if (res < 0 || id != ebml_id_header || size == UINT64_MAX) {
+    status_ = planner_unsupported;
+    return;
+  }
+
+  // Segment
+  uint64_t pos = header_len + size;
+  res = read_element(pos, &id, &size, &header_len);
+  if (res == 0) return;
+  if (res < 0 || id != mkv_id_segment) {
+    status_ = planner_unsupported;
+    return;
+  }
+
+  segment_data_ = pos + header_len;
+  uint64_t segment_end = size == UINT64_MAX ? file_size_ : std::min(file_size_, segment_data_ + size);
+
+  // Walk level-1 elements until we reach media data or a SeekHead tells us
+  // where the Cues are. Cues written before the first Cluster are picked up
+  // directly by the walk.
+  std::vector<uint64_t> parsed_seekheads;
+  bool have_cues = false;
+
+  pos = segment_data_;
+  for (int i = 0; i < max_level1_elements && pos < segment_end && !have_cues; i++) {
+    res = read_element(pos, &id, &size, &header_len);
+    if (res == 0) return;
+    if (res < 0 || size == UINT64_MAX) break;
+
+    if (id == mkv_id_cluster) break;
+
+    if (id == mkv_id_cues) {
+      add_range(pos, pos + header_len + size, range_mkv_cues);
+      have_cues = true;
+    } else if (id == mkv_id_seekhead && size <= max_seekhead_size) {
+      const uint8_t *body;
+      if (!require(pos + header_len, size, &body)) return;
+      parsed_seekheads.push_back(pos);
+      have_cues = parse_seekhead(body, size);
+    }
+
+    pos += header_len + size;
+  }
+
+  // Follow secondary SeekHeads (muxers that write a short one up front and
+  // the full table after the clusters).
+  for (size_t i = 0; i < seek_heads_.size() && seek_cues_.empty(); i++) {
+    uint64_t at = seek_heads_[i];
+    if (std::find(parsed_seekheads.begin(), parsed_seekheads.end(), at) != parsed_seekheads.end()) continue;
+
+    res = read_element(at, &id, &size, &header_len);
+    if (res == 0) return;
+    if (res < 0 || id != mkv_id_seekhead || size > max_seekhead_size) continue;
+
+    const uint8_t *body;
+    if (!require(at + header_len, size, &body)) return;
+    parsed_seekheads.push_back(at);
+    parse_seekhead(body, size);
+  }
+
+  // Resolve the exact extent of every Cues element the SeekHeads point at.
+  for (uint64_t at : seek_cues_) {
+    res = read_element(at, &id, &size, &header_len);
+    if (res == 0) return;
+    if (res < 0 || id != mkv_id_cues || size == UINT64_MAX) continue;
+
+    add_range(at, at + header_len + size, range_mkv_cues);
+  }
+
+  finish();
+}
+
+void
+ContainerPlanner::run_mp4() {
+  bool have_moov = false;
+  uint64_t pos = 0;
+
+  for (int i = 0; i < max_mp4_boxes && pos + 8 <= file_size_; i++) {
+    const uint8_t *p;
+
+    // Once moov is known, only keep walking over boxes we already have so a
+    // trailing sidx is picked up without another round trip.
+    if (have_moov) {
+      if (!read(pos, std::min<uint64_t>(mp4_max_header, file_size_ - pos), &p)) break;
+    } else if (!require(pos, mp4_max_header, &p)) {
+      return;
+    }
+
+    uint64_t avail = std::min<uint64_t>(mp4_max_header, file_size_ - pos);
+    uint64_t size = read_be32(p);
+    uint32_t type = read_be32(p + 4);
+    uint64_t header_len = 8;
+
+    if (size == 1) {
+      if (avail < 16) {
+        status_ = planner_unsupported;
+        return;
+      }
+      size = read_be64(p + 8);
+      header_len = 16;
+    } else if (size == 0) {
+      size = file_size_ - pos;
+    }
+
+    if (size < header_len) {
+      status_ = planner_unsupported;
+      return;
+    }
+
+    if (type == fourcc("moov")) {
+      add_range(pos, pos + size, range_mp4_moov);
+      have_moov = true;
+    } else if (type == fourcc("sidx")) {
+      add_range(pos, pos + size, range_mp4_sidx);
+    } else if (type == fourcc("moof")) {
+      // Fragmented file: moov (and sidx) precede the first fragment.
+      break;
+    }
+
+    pos += size;
+  }
+
+  finish();
+}
+
+} // namespace bare_media_index
@@ -0,0 +1,110 @@
+/**
+ * Container index planner
+ *
+ * Walks the top-level structure of a Matroska/WebM or ISO-BMFF (MP4/MOV)
+ * file from the bytes it is fed and works out exactly where the seek index
+ * lives (MKV Cues via the EBML SeekHead, MP4 moov/sidx via the atom chain).
+ *
+ * The planner never reads on its own: it reports the next (offset, length)
+ * it needs and the caller fetches it however it likes (HTTP range, hypercore
+ * blob, temp file). Each step only asks for element headers or the SeekHead
+ * body, so a plan over a slow peer costs a handful of tiny round trips
+ * instead of a blind multi-megabyte tail download.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bare_media_index {
+
+enum container_t {
+  container_unknown = 0,
+  container_matroska = 1,
+  container_mp4 = 2,
+};
+
+enum range_kind_t {
+  range_mkv_cues = 1,
+  range_mp4_moov = 2,
+  range_mp4_sidx = 3,
+};
+
+enum planner_status_t {
+  planner_need_data = 0,
+  planner_done = 1,
+  planner_unsupported = 2,
+};
+
+struct byte_range_t {
+  uint64_t start;
+  uint64_t end; // exclusive
+  range_kind_t kind;
+};
+
+class ContainerPlanner {
+public:
+  // Bytes requested for the first probe; enough for the EBML header, the
+  // SeekHead and Info of virtually every muxer, and for ftyp + the first
+  // couple of atom headers in MP4.
+  static constexpr uint32_t head_probe_size = 64 * 1024;
+
+  explicit ContainerPlanner(uint64_t file_size);
+
+  // Hand the planner bytes located at an absolute file offset. Chunks may
+  // arrive in any order and may overlap; the planner re-runs its walk after
+  // every feed and stops at the first byte it does not have.
+  planner_status_t feed(uint64_t offset, const uint8_t *data, size_t len);
+
+  planner_status_t status() const { return status_; }
+  container_t container() const { return container_; }
+
+  // Valid while status() == planner_need_data.
+  uint64_t need_offset() const { return need_offset_; }
+  uint32_t need_length() const { return need_length_; }
+
+  // Valid once status() == planner_done. Sorted by start offset, with
+  // overlapping/adjacent ranges of the same kind merged.
+  const std::vector<byte_range_t> &ranges() const { return ranges_; }
+
+  // Bytes that the caller has fed so far (for stats/logging).
+  uint64_t bytes_fed() const { return bytes_fed_; }
+
+private:
+  struct chunk_t {
+    uint64_t offset;
+    std::vector<uint8_t> data;
+  };
+
+  bool read(uint64_t offset, uint64_t len, const uint8_t **out) const;
+  bool require(uint64_t offset, uint64_t len, const uint8_t **out);
+
+  void run();
+  void run_matroska();
+  void run_mp4();
+
+  int read_element(uint64_t offset, uint32_t *id, uint64_t *size, uint32_t *header_len);
+  bool parse_seekhead(const uint8_t *body, uint64_t len);
+  void add_range(uint64_t start, uint64_t end, range_kind_t kind);
+  void finish();
+
+  uint64_t file_size_;
+  uint64_t bytes_fed_ = 0;
+  std::vector<chunk_t> chunks_;
+
+  planner_status_t status_ = planner_need_data;
+  container_t container_ = container_unknown;
+  uint64_t need_offset_ = 0;
+  uint32_t need_length_ = head_probe_size;
+
+  // Matroska state, rebuilt on every run() from cached chunks.
+  uint64_t segment_data_ = 0;
+  std::vector<uint64_t> seek_cues_;
+  std::vector<uint64_t> seek_heads_;
+
+  std::vector<byte_range_t> ranges_;
+};
+
+} // namespace bare_media_index
@@ -0,0 +1,528 @@
+#include "faststart.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bare_media_index {
+
+namespace {
+
+// Bound the walk so corrupt files cannot spin the planner
+constexpr size_t max_atoms = 1024;
+
+// Keyframe index layout, all integers LEB128 varints:
+//
+//   "PKFI" u8(version) duration_ms head_end count
+//   count x (zigzag(time_ms delta), zigzag(offset delta))
+//
+// head_end is the output offset where moov ends, so a reader can fetch
+// everything up to the first sample in one request. Entries are sync
+// samples in decode order; deltas are against the previous entry (the
+// first against zero).
+constexpr uint8_t index_magic[4] = {'P', 'K', 'F', 'I'};
+constexpr uint8_t index_version = 1;
+
+constexpr uint32_t
+fourcc(const char *s) {
+  return (uint32_t(uint8_t(s[0])) << 24) | (uint32_t(uint8_t(s[1])) << 16) | (uint32_t(uint8_t(s[2])) << 8) | uint32_t(uint8_t(s[3]));
+}
+
+inline uint32_t
+read_be32(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t
+read_be64(const uint8_t *p) {
+  return (uint64_t(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+inline void
+write_be32(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(uint8_t(v >> 24));
+  out.push_back(uint8_t(v >> 16));
+  out.push_back(uint8_t(v >> 8));
+  out.push_back(uint8_t(v));
+}
+
+inline void
+write_be64(std::vector<uint8_t> &out, uint64_t v) {
+  write_be32(out, uint32_t(v >> 32));
+  write_be32(out, uint32_t(v));
+}
+
+inline void
+patch_be32(std::vector<uint8_t> &out, size_t at, uint32_t v) {
+  out[at] = uint8_t(v >> 24);
+  out[at + 1] = uint8_t(v >> 16);
+  out[at + 2] = uint8_t(v >> 8);
+  out[at + 3] = uint8_t(v);
+}
+
+inline void
+write_uvarint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(uint8_t(v));
+}
+
+inline void
+write_svarint(std::vector<uint8_t> &out, int64_t v) {
+  write_uvarint(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+}
+
+struct box_t {
+  uint32_t type;
+  const uint8_t *body;
+  size_t body_len;
+  size_t size;
+};
+
+// Parse the box at p. Size 0 (to the end of the parent) is allowed.
+bool
+parse_box(const uint8_t *p, size_t avail, box_t *box) {
+  if (avail < 8) return false;
+
+  uint64_t size = read_be32(p);
+  size_t header = 8;
+  if (size == 1) {
+    if (avail < 16) return false;
+    size = read_be64(p + 8);
+    header = 16;
+  } else if (size == 0) {
+    size = avail;
+  }
+  if (size < header || size > avail) return false;
+
+  box->type = read_be32(p + 4);
+  box->body = p + header;
+  box->body_len = size_t(size) - header;
+  box->size = size_t(size);
+  return true;
+}
+
+bool
+find_box(const uint8_t *p, size_t len, uint32_t type, box_t *out) {
+  box_t box;
+  while (len > 0 && parse_box(p, len, &box)) {
+    if (box.type == type) {
+      *out = box;
+      return true;
+    }
+    p += box.size;
+    len -= box.size;
+  }
+  return false;
+}
+
+// Full box table: version/flags, entry count, then count entries of
+// entry_size bytes. Returns the entries or NULL when truncated.
+const uint8_t *
+table(const box_t &box, size_t skip, size_t entry_size, uint32_t *count) {
+  if (box.body_len < skip + 8) return NULL;
+  *count = read_be32(box.body + skip + 4);
+  if (uint64_t(*count) * entry_size > box.body_len - skip - 8) return NULL;
+  return box.body + skip + 8;
+}
+
+bool
+is_rebuilt_container(uint32_t type) {
+  return type == fourcc("trak") || type == fourcc("mdia") || type == fourcc("minf") || type == fourcc("stbl");
+}
+
+} // namespace
+
+FaststartPlanner::FaststartPlanner(uint64_t file_size) : file_size_(file_size) {
+  if (file_size_ < 8) status_ = planner_unsupported;
+}
+
+planner_status_t
+FaststartPlanner::feed(uint64_t offset, const uint8_t *data, size_t len) {
+  if (status_ != planner_need_data) return status_;
+
+  bytes_fed_ += len;
+
+  if (walking_) {
+    walk(offset, data, len);
+    return status_;
+  }
+
+  // moov body, in order; anything overlapping the next missing byte counts
+  const atom_t &moov = atoms_[moov_atom_];
+  uint64_t want = moov.offset + moov_filled_;
+  if (offset <= want && offset + len > want) {
+    size_t skip = size_t(want - offset);
+    size_t take = size_t(std::min<uint64_t>(len - skip, moov.size - moov_filled_));
+    memcpy(moov_in_.data() + moov_filled_, data + skip, take);
+    moov_filled_ += take;
+  }
+
+  if (moov_filled_ == moov.size) {
+    process();
+  } else {
+    need_offset_ = moov.offset + moov_filled_;
+    need_length_ = uint32_t(std::min<uint64_t>(moov.size - moov_filled_, UINT32_MAX));
+  }
+
+  return status_;
+}
+
+void
+FaststartPlanner::walk(uint64_t offset, const uint8_t *data, size_t len) {
+  while (walk_ < file_size_) {
+    if (atoms_.size() >= max_atoms) {
+      status_ = planner_unsupported;
+      return;
+    }
+
+    uint64_t header = std::min<uint64_t>(atom_header_size, file_size_ - walk_);
+    if (walk_ < offset || walk_ + header > offset + len) {
+      need_offset_ = walk_;
+      need_length_ = uint32_t(header);
+      return;
+    }
+
+    const uint8_t *p = data + (walk_ - offset);
+    if (header < 8) {
+      status_ = planner_unsupported;
+      return;
+    }
+
+    uint64_t size = read_be32(p);
+    uint32_t type = read_be32(p + 4);
+    if (size == 1) {
+      if (header < 16) {
+        status_ = planner_unsupported;
+        return;
+      }
+      size = read_be64(p + 8);
+    } else if (size == 0) {
+      size = file_size_ - walk_;
+    }
+
+    if (size < 8 || size > file_size_ - walk_) {
+      status_ = planner_unsupported;
+      return;
+    }
+
+    // Fragmented files carry their sample tables in moof, not moov
+    if (type == fourcc("moof")) {
+      status_ = planner_unsupported;
+      return;
+    }
+
+    // Keep walking past moov: a moof later on still rules the file out
+    if (type == fourcc("moov")) {
+      if (moov_atom_ >= 0) {
+        status_ = planner_unsupported;
+        return;
+      }
+      moov_atom_ = int(atoms_.size());
+    } else if (type == fourcc("mdat") && first_mdat_ < 0) {
+      first_mdat_ = int(atoms_.size());
+    }
+
+    atoms_.push_back({type, walk_, size});
+    walk_ += size;
+  }
+
+  end_walk();
+}
+
+void
+FaststartPlanner::end_walk() {
+  walking_ = false;
+
+  if (moov_atom_ < 0 || atoms_[moov_atom_].size > max_moov_size) {
+    status_ = planner_unsupported;
+    return;
+  }
+
+  const atom_t &moov = atoms_[moov_atom_];
+  moov_in_.resize(size_t(moov.size));
+  moov_filled_ = 0;
+  need_offset_ = moov.offset;
+  need_length_ = uint32_t(moov.size);
+}
+
+uint64_t
+FaststartPlanner::map_offset(uint64_t offset, uint64_t new_moov_size) const {
+  if (!remux_) return offset;
+
+  const atom_t &moov = atoms_[moov_atom_];
+  uint64_t insert = atoms_[first_mdat_].offset;
+
+  if (offset < insert) return offset;
+  if (offset < moov.offset) return offset + new_moov_size;
+  if (offset >= moov.offset + moov.size) return offset - moov.size + new_moov_size;
+  return offset; // inside moov; not a sample
+}
+
+bool
+FaststartPlanner::rebuild_box(const uint8_t *p, size_t len, uint64_t new_moov_size, std::vector<uint8_t> &out) const {
+  box_t box;
+  while (len > 0) {
+    if (!parse_box(p, len, &box)) return false;
+
+    if (is_rebuilt_container(box.type)) {
+      size_t at = out.size();
+      write_be32(out, 0);
+      write_be32(out, box.type);
+      if (!rebuild_box(box.body, box.body_len, new_moov_size, out)) return false;
+      uint64_t size = out.size() - at;
+      if (size > UINT32_MAX) return false;
+      patch_be32(out, at, uint32_t(size));
+    } else if (box.type == fourcc("stco") || box.type == fourcc("co64")) {
+      bool co64 = box.type == fourcc("co64");
+      size_t width = co64 ? 8 : 4;
+      uint32_t count;
+      const uint8_t *entries = table(box, 0, width, &count);
+      if (entries == NULL) return false;
+
+      std::vector<uint64_t> offsets(count);
+      bool wide = co64;
+      for (uint32_t i = 0; i < count; i++) {
+        uint64_t v = co64 ? read_be64(entries + i * 8) : read_be32(entries + i * 4);
+        offsets[i] = map_offset(v, new_moov_size);
+        if (offsets[i] > UINT32_MAX) wide = true;
+      }
+
+      write_be32(out, uint32_t(16 + count * (wide ? 8 : 4)));
+      write_be32(out, wide ? fourcc("co64") : fourcc("stco"));
+      write_be32(out, 0); // version/flags
+      write_be32(out, count);
+      for (uint64_t v : offsets) {
+        if (wide) write_be64(out, v);
+        else write_be32(out, uint32_t(v));
+      }
+    } else {
+      out.insert(out.end(), p, p + box.size);
+    }
+
+    p += box.size;
+    len -= box.size;
+  }
+  return true;
+}
+
+bool
+FaststartPlanner::rebuild(uint64_t new_moov_size, std::vector<uint8_t> &out) const {
+  box_t moov;
+  if (!parse_box(moov_in_.data(), moov_in_.size(), &moov)) return false;
+
+  out.clear();
+  out.reserve(moov_in_.size());
+  write_be32(out, 0);
+  write_be32(out, fourcc("moov"));
+  if (!rebuild_box(moov.body, moov.body_len, new_moov_size, out)) return false;
+  if (out.size() > UINT32_MAX) return false;
+  patch_be32(out, 0, uint32_t(out.size()));
+  return true;
+}
+
+void
+FaststartPlanner::process() {
+  box_t moov;
+  if (!parse_box(moov_in_.data(), moov_in_.size(), &moov)) {
+    status_ = planner_unsupported;
+    return;
+  }
+
+  // Fragmented (mvex) or compressed (cmov) movies have no usable tables
+  box_t skip;
+  if (find_box(moov.body, moov.body_len, fourcc("mvex"), &skip) || find_box(moov.body, moov.body_len, fourcc("cmov"), &skip)) {
+    status_ = planner_unsupported;
+    return;
+  }
+
+  const atom_t &in = atoms_[moov_atom_];
+  remux_ = first_mdat_ >= 0 && in.offset > atoms_[first_mdat_].offset;
+
+  if (remux_) {
+    // The new moov size shifts the offsets it stores, which may widen stco
+    // tables and grow it again; converges in a step or two
+    uint64_t size = in.size;
+    for (int i = 0; i < 4; i++) {
+      if (!rebuild(size, moov_out_)) {
+        status_ = planner_unsupported;
+        return;
+      }
+      if (moov_out_.size() == size) break;
+      size = moov_out_.size();
+    }
+    if (moov_out_.size() != size) {
+      status_ = planner_unsupported;
+      return;
+    }
+    new_moov_size_ = size;
+
+    uint64_t insert = atoms_[first_mdat_].offset;
+    if (insert > 0) layout_.push_back({0, insert, false});
+    layout_.push_back({0, 0, true});
+    layout_.push_back({insert, in.offset, false});
+    if (in.offset + in.size < file_size_) layout_.push_back({in.offset + in.size, file_size_, false});
+    output_size_ = file_size_ - in.size + new_moov_size_;
+  } else {
+    new_moov_size_ = in.size;
+    layout_.push_back({0, file_size_, false});
+    output_size_ = file_size_;
+  }
+
+  index_video();
+  status_ = planner_done;
+}
+
+void
+FaststartPlanner::index_video() {
+  box_t moov;
+  parse_box(moov_in_.data(), moov_in_.size(), &moov);
+
+  const uint8_t *p = moov.body;
+  size_t len = moov.body_len;
+  box_t trak;
+  while (len > 0 && parse_box(p, len, &trak)) {
+    p += trak.size;
+    len -= trak.size;
+    if (trak.type != fourcc("trak")) continue;
+
+    box_t mdia, hdlr, mdhd, minf, stbl;
+    if (!find_box(trak.body, trak.body_len, fourcc("mdia"), &mdia)) continue;
+    if (!find_box(mdia.body, mdia.body_len, fourcc("hdlr"), &hdlr) || hdlr.body_len < 12) continue;
+    if (read_be32(hdlr.body + 8) != fourcc("vide")) continue;
+    if (!find_box(mdia.body, mdia.body_len, fourcc("mdhd"), &mdhd) || mdhd.body_len < 1) return;
+    if (!find_box(mdia.body, mdia.body_len, fourcc("minf"), &minf)) return;
+    if (!find_box(minf.body, minf.body_len, fourcc("stbl"), &stbl)) return;
+
+    uint32_t timescale;
+    uint64_t duration;
+    if (mdhd.body[0] == 1) {
+      if (mdhd.body_len < 32) return;
+      timescale = read_be32(mdhd.body + 20);
+      duration = read_be64(mdhd.body + 24);
+    } else {
+      if (mdhd.body_len < 20) return;
+      timescale = read_be32(mdhd.body + 12);
+      duration = read_be32(mdhd.body + 16);
+    }
+    if (timescale == 0) return;
+
+    // First non-empty edit: where presentation starts in media time
+    int64_t media_time = 0;
+    box_t edts, elst;
+    if (find_box(trak.body, trak.body_len, fourcc("edts"), &edts) && find_box(edts.body, edts.body_len, fourcc("elst"), &elst) && elst.body_len >= 1) {
+      bool v1 = elst.body[0] == 1;
+      uint32_t count;
+      const uint8_t *e = table(elst, 0, v1 ? 20 : 12, &count);
+      for (uint32_t i = 0; e != NULL && i < count; i++, e += v1 ? 20 : 12) {
+        int64_t t = v1 ? int64_t(read_be64(e + 8)) : int64_t(int32_t(read_be32(e + 4)));
+        if (t >= 0) {
+          media_time = t;
+          break;
+        }
+      }
+    }
+
+    box_t stts, ctts, stss, stsz, stsc, stco;
+    bool co64 = false;
+    if (!find_box(stbl.body, stbl.body_len, fourcc("stts"), &stts)) return;
+    if (!find_box(stbl.body, stbl.body_len, fourcc("stsz"), &stsz)) return;
+    if (!find_box(stbl.body, stbl.body_len, fourcc("stsc"), &stsc)) return;
+    if (!find_box(stbl.body, stbl.body_len, fourcc("stco"), &stco)) {
+      if (!find_box(stbl.body, stbl.body_len, fourcc("co64"), &stco)) return;
+      co64 = true;
+    }
+    bool has_ctts = find_box(stbl.body, stbl.body_len, fourcc("ctts"), &ctts);
+    bool has_stss = find_box(stbl.body, stbl.body_len, fourcc("stss"), &stss);
+
+    uint32_t stts_n, ctts_n = 0, stss_n = 0, stsc_n, chunk_n, sample_n;
+    const uint8_t *stts_e = table(stts, 0, 8, &stts_n);
+    const uint8_t *ctts_e = has_ctts ? table(ctts, 0, 8, &ctts_n) : NULL;
+    const uint8_t *stss_e = has_stss ? table(stss, 0, 4, &stss_n) : NULL;
+    const uint8_t *stsc_e = table(stsc, 0, 12, &stsc_n);
+    const uint8_t *chunk_e = table(stco, 0, co64 ? 8 : 4, &chunk_n);
+    if (stts_e == NULL || stsc_e == NULL || chunk_e == NULL || stsc_n == 0) return;
+    if ((has_ctts && ctts_e == NULL) || (has_stss && stss_e == NULL)) return;
+
+    // stsz: version/flags, uniform size, count, then sizes when not uniform
+    if (stsz.body_len < 12) return;
+    uint32_t uniform = read_be32(stsz.body + 4);
+    sample_n = read_be32(stsz.body + 8);
+    const uint8_t *sizes = stsz.body + 12;
+    if (uniform == 0 && uint64_t(sample_n) * 4 > stsz.body_len - 12) return;
+
+    std::vector<uint64_t> times, offsets;
+
+    uint32_t stts_i = 0, stts_left = stts_n > 0 ? read_be32(stts_e) : 0;
+    uint32_t ctts_i = 0, ctts_left = ctts_n > 0 ? read_be32(ctts_e) : 0;
+    uint32_t stss_i = 0, stsc_i = 0;
+    uint64_t dts = 0;
+
+    uint64_t chunk = read_be32(stsc_e);
+    if (chunk == 0) return;
+    chunk--; // 1-based
+    uint32_t left = read_be32(stsc_e + 4);
+    if (left == 0 || chunk >= chunk_n) return;
+    uint64_t pos = co64 ? read_be64(chunk_e + chunk * 8) : read_be32(chunk_e + chunk * 4);
+
+    for (uint32_t s = 0; s < sample_n; s++) {
+      bool sync = !has_stss;
+      if (has_stss) {
+        while (stss_i < stss_n && read_be32(stss_e + stss_i * 4) < s + 1) stss_i++;
+        sync = stss_i < stss_n && read_be32(stss_e + stss_i * 4) == s + 1;
+      }
+
+      if (sync) {
+        int64_t cts = 0;
+        if (ctts_i < ctts_n) cts = int32_t(read_be32(ctts_e + ctts_i * 8 + 4));
+        int64_t pts = int64_t(dts) + cts - media_time;
+        times.push_back(pts <= 0 ? 0 : uint64_t(pts) * 1000 / timescale);
+        offsets.push_back(map_offset(pos, new_moov_size_));
+      }
+
+      pos += uniform != 0 ? uniform : read_be32(sizes + s * 4);
+
+      while (stts_left == 0 && stts_i + 1 < stts_n) stts_left = read_be32(stts_e + ++stts_i * 8);
+      if (stts_i < stts_n) dts += read_be32(stts_e + stts_i * 8 + 4);
+      if (stts_left > 0) stts_left--;
+
+      if (ctts_n > 0) {
+        if (ctts_left > 0) ctts_left--;
+        while (ctts_left == 0 && ctts_i < ctts_n) {
+          if (++ctts_i < ctts_n) ctts_left = read_be32(ctts_e + ctts_i * 8);
+        }
+      }
+
+      if (--left == 0) {
+        chunk++;
+        if (chunk >= chunk_n) break;
+        if (stsc_i + 1 < stsc_n && chunk + 1 >= read_be32(stsc_e + (stsc_i + 1) * 12)) stsc_i++;
+        left = read_be32(stsc_e + stsc_i * 12 + 4);
+        if (left == 0) return;
+        pos = co64 ? read_be64(chunk_e + chunk * 8) : read_be32(chunk_e + chunk * 4);
+      }
+    }
+
+    if (times.empty()) return;
+
+    uint64_t head_end = remux_ ? atoms_[first_mdat_].offset + new_moov_size_ : atoms_[moov_atom_].offset + atoms_[moov_atom_].size;
+
+    index_.assign(index_magic, index_magic + 4);
+    index_.push_back(index_version);
+    write_uvarint(index_, duration * 1000 / timescale);
+    write_uvarint(index_, head_end);
+    write_uvarint(index_, times.size());
+    uint64_t prev_time = 0, prev_offset = 0;
+    for (size_t i = 0; i < times.size(); i++) {
+      write_svarint(index_, int64_t(times[i] - prev_time));
+      write_svarint(index_, int64_t(offsets[i] - prev_offset));
+      prev_time = times[i];
+      prev_offset = offsets[i];
+    }
+    keyframes_ = times.size();
+    return;
+  }
+}
+
+} // namespace bare_media_index
@@ -0,0 +1,124 @@
+/**
+ * Faststart planner and keyframe indexer for ISO-BMFF (MP4/MOV)
+ *
+ * Walks the top-level atoms of a file from the bytes it is fed, then reads
+ * the moov atom and works out:
+ *
+ *  - whether moov sits after the media data, and if so the layout of a
+ *    faststart copy: the same atoms in the same order, with moov moved in
+ *    front of the first mdat and every stco/co64 chunk offset shifted by
+ *    the move (stco tables widen to co64 if an offset outgrows 32 bits).
+ *    Media bytes are never touched, so the copy is a plain streaming pass
+ *    over ranges of the source plus the rewritten moov.
+ *
+ *  - a compact keyframe index for the first video track: presentation time
+ *    (ms) and output byte offset of every sync sample, delta-encoded as
+ *    varints (see encode_keyframe_index in faststart.cc for the layout).
+ *
+ * Like ContainerPlanner it never reads on its own: it reports the next
+ * (offset, length) it needs. The walk costs one small read per top-level
+ * atom plus one read of moov itself.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "container.h"
+
+namespace bare_media_index {
+
+struct output_segment_t {
+  // Source range copied as is; ignored when moov is set
+  uint64_t start;
+  uint64_t end; // exclusive
+  // The rewritten moov goes here
+  bool moov;
+};
+
+class FaststartPlanner {
+public:
+  // Bytes requested per atom header: size, type and a 64-bit largesize
+  static constexpr uint32_t atom_header_size = 16;
+
+  // moov atoms larger than this are not rewritten (hours of dense samples
+  // are a few MB; anything bigger is corrupt or not worth holding)
+  static constexpr uint64_t max_moov_size = 64 * 1024 * 1024;
+
+  explicit FaststartPlanner(uint64_t file_size);
+
+  // Hand the planner bytes located at an absolute file offset. During the
+  // atom walk any chunk covering the next header advances it (a large head
+  // read walks several atoms at once); moov may then arrive in pieces, in
+  // order.
+  planner_status_t feed(uint64_t offset, const uint8_t *data, size_t len);
+
+  planner_status_t status() const { return status_; }
+
+  // Valid while status() == planner_need_data.
+  uint64_t need_offset() const { return need_offset_; }
+  uint32_t need_length() const { return need_length_; }
+
+  // Valid once status() == planner_done.
+  //
+  // True when the output differs from the input (moov moved). Otherwise the
+  // layout is the whole file and moov() is empty.
+  bool remux() const { return remux_; }
+  const std::vector<uint8_t> &moov() const { return moov_out_; }
+  const std::vector<output_segment_t> &layout() const { return layout_; }
+  uint64_t output_size() const { return output_size_; }
+
+  // Empty when the file has no video track with usable sample tables.
+  const std::vector<uint8_t> &keyframe_index() const { return index_; }
+  size_t keyframes() const { return keyframes_; }
+
+  uint64_t bytes_fed() const { return bytes_fed_; }
+
+private:
+  struct atom_t {
+    uint32_t type;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  void walk(uint64_t offset, const uint8_t *data, size_t len);
+  void end_walk();
+  void process();
+
+  bool rebuild(uint64_t new_moov_size, std::vector<uint8_t> &out) const;
+  bool rebuild_box(const uint8_t *p, size_t len, uint64_t new_moov_size, std::vector<uint8_t> &out) const;
+  uint64_t map_offset(uint64_t offset, uint64_t new_moov_size) const;
+
+  void index_video();
+
+  uint64_t file_size_;
+  uint64_t bytes_fed_ = 0;
+
+  planner_status_t status_ = planner_need_data;
+  uint64_t need_offset_ = 0;
+  uint32_t need_length_ = atom_header_size;
+
+  // Atom walk
+  bool walking_ = true;
+  uint64_t walk_ = 0;
+  std::vector<atom_t> atoms_;
+  int moov_atom_ = -1;
+  int first_mdat_ = -1;
+
+  // moov as read, header included
+  std::vector<uint8_t> moov_in_;
+  uint64_t moov_filled_ = 0;
+
+  bool remux_ = false;
+  uint64_t new_moov_size_ = 0;
+  std::vector<uint8_t> moov_out_;
+  std::vector<output_segment_t> layout_;
+  uint64_t output_size_ = 0;
+
+  std::vector<uint8_t> index_;
+  size_t keyframes_ = 0;
+};
+
+} // namespace bare_media_index
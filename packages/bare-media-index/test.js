@@ -0,0 +1,219 @@
+/**
+ * Simple test for bare-media-index addon
+ * Builds tiny synthetic MKV/MP4 files in memory and checks the planned ranges,
+ * the faststart remux and the keyframe index.
+ */
+
+const { planPrefetch, planFaststart, decodeKeyframeIndex, findKeyframe } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+function concat(parts) {
+  const out = new Uint8Array(parts.reduce((n, p) => n + p.length, 0))
+  let at = 0
+  for (const p of parts) {
+    out.set(p, at)
+    at += p.length
+  }
+  return out
+}
+
+function hex(s) {
+  return Uint8Array.from(s.match(/../g).map((b) => parseInt(b, 16)))
+}
+
+// EBML element with an 8-byte size field
+function el(id, body) {
+  const size = new Uint8Array(8)
+  size[0] = 0x01
+  let n = body.length
+  for (let i = 7; i > 0; i--) {
+    size[i] = n & 0xff
+    n = Math.floor(n / 256)
+  }
+  return concat([hex(id), size, body])
+}
+
+function uintEl(id, v) {
+  const body = new Uint8Array(4)
+  new DataView(body.buffer).setUint32(0, v)
+  return concat([hex(id), Uint8Array.of(0x84), body])
+}
+
+function box(type, body) {
+  const head = new Uint8Array(8)
+  new DataView(head.buffer).setUint32(0, 8 + body.length)
+  head.set(Array.from(type, (c) => c.charCodeAt(0)), 4)
+  return concat([head, body])
+}
+
+function u32(...values) {
+  const out = new Uint8Array(values.length * 4)
+  const view = new DataView(out.buffer)
+  values.forEach((v, i) => view.setUint32(i * 4, v))
+  return out
+}
+
+// Full box: version/flags then body
+function fullBox(type, body, version = 0) {
+  return box(type, concat([Uint8Array.of(version, 0, 0, 0), body]))
+}
+
+function trak(handler, tables) {
+  const mdhd = fullBox('mdhd', u32(0, 0, 1000, 1000, 0))
+  const hdlr = fullBox('hdlr', concat([u32(0), Uint8Array.from(handler, (c) => c.charCodeAt(0)), u32(0, 0, 0), new Uint8Array(1)]))
+  return box('trak', box('mdia', concat([mdhd, hdlr, box('minf', box('stbl', concat(tables)))])))
+}
+
+function stco(offsets) {
+  return fullBox('stco', u32(offsets.length, ...offsets))
+}
+
+// Chunk offsets of every trak, in order
+function chunkOffsets(file) {
+  const view = new DataView(file.buffer, file.byteOffset)
+  const found = []
+  const walk = (start, end) => {
+    for (let at = start; at < end;) {
+      const size = view.getUint32(at)
+      const type = String.fromCharCode(...file.subarray(at + 4, at + 8))
+      if (['moov', 'trak', 'mdia', 'minf', 'stbl'].includes(type)) walk(at + 8, at + size)
+      if (type === 'stco') {
+        const n = view.getUint32(at + 12)
+        found.push(Array.from({ length: n }, (_, i) => view.getUint32(at + 16 + i * 4)))
+      }
+      at += size
+    }
+  }
+  walk(0, file.length)
+  return found
+}
+
+// MP4 with 10 video samples (2 per chunk, keyframes 1, 5, 9) and 2 audio
+// chunks in one mdat. Sample bytes are filled with the sample number.
+function movie(moovFirst) {
+  const ftyp = box('ftyp', new Uint8Array(16))
+  const samples = Array.from({ length: 10 }, (_, i) => new Uint8Array(1000).fill(i + 1))
+  const audio = new Uint8Array(1000).fill(0xaa)
+  const payload = concat([...samples, audio])
+
+  const build = (dataStart) => {
+    const video = trak('vide', [
+      fullBox('stts', u32(1, 10, 100)),
+      fullBox('stss', u32(3, 1, 5, 9)),
+      fullBox('stsc', u32(1, 1, 2, 1)),
+      fullBox('stsz', u32(1000, 10)),
+      stco([0, 1, 2, 3, 4].map((c) => dataStart + c * 2000))
+    ])
+    const sound = trak('soun', [
+      fullBox('stts', u32(1, 2, 1000)),
+      fullBox('stsc', u32(1, 1, 1, 1)),
+      fullBox('stsz', u32(500, 2)),
+      stco([dataStart + 10000, dataStart + 10500])
+    ])
+    return box('moov', concat([fullBox('mvhd', new Uint8Array(96)), video, sound]))
+  }
+
+  // moov size does not depend on the offsets it holds
+  const moovSize = build(0).length
+  if (moovFirst) return concat([ftyp, build(ftyp.length + moovSize + 8), box('mdat', payload)])
+  return concat([ftyp, box('mdat', payload), build(ftyp.length + 8)])
+}
+
+async function remux(file) {
+  const plan = await planFaststart(file.length, reader(file))
+  const parts = plan.segments.map((s) => (s.bytes ? s.bytes : file.subarray(s.start, s.end)))
+  return { plan, output: concat(parts) }
+}
+
+function reader(file) {
+  let reads = 0
+  const read = async (offset, length) => {
+    reads++
+    return file.subarray(offset, offset + length)
+  }
+  read.count = () => reads
+  return read
+}
+
+async function main() {
+  // MKV: SeekHead -> Cues after a 2MB cluster, Tags after Cues
+  const ebml = el('1A45DFA3', el('4282', Uint8Array.from('webm', (c) => c.charCodeAt(0))))
+  const info = el('1549A966', new Uint8Array(100))
+  const cluster = el('1F43B675', new Uint8Array(2 * 1024 * 1024))
+  const cues = el('1C53BB6B', new Uint8Array(1500).fill(1))
+  const tags = el('1254C367', new Uint8Array(400))
+  const seekhead = (pos) => el('114D9B74', el('4DBB', concat([el('53AB', hex('1C53BB6B')), uintEl('53AC', pos)])))
+  const cuesRel = seekhead(0).length + info.length + cluster.length
+  const segmentBody = concat([seekhead(cuesRel), info, cluster, cues, tags])
+  const mkv = concat([ebml, hex('1853806701FFFFFFFFFFFFFF'), segmentBody])
+  const cuesStart = ebml.length + 12 + cuesRel
+
+  const mkvRead = reader(mkv)
+  const mkvPlan = await planPrefetch(mkv.length, mkvRead)
+  check('mkv container', mkvPlan.container, 'matroska')
+  check('mkv cues range', mkvPlan.ranges, [{ start: cuesStart, end: cuesStart + cues.length, kind: 'cues' }])
+  check('mkv round trips', mkvRead.count(), 2)
+
+  // MP4 with moov at the end
+  const mdat = box('mdat', new Uint8Array(2 * 1024 * 1024))
+  const moov = box('moov', new Uint8Array(3000).fill(2))
+  const ftyp = box('ftyp', new Uint8Array(16))
+  const mp4 = concat([ftyp, mdat, moov])
+
+  const mp4Plan = await planPrefetch(mp4.length, reader(mp4))
+  check('mp4 container', mp4Plan.container, 'mp4')
+  check('mp4 moov range', mp4Plan.ranges, [{ start: ftyp.length + mdat.length, end: mp4.length, kind: 'moov' }])
+
+  // Faststart MP4: moov inside the head probe, no extra reads
+  const fast = concat([ftyp, moov, mdat])
+  const fastRead = reader(fast)
+  const fastPlan = await planPrefetch(fast.length, fastRead)
+  check('faststart moov range', fastPlan.ranges, [{ start: ftyp.length, end: ftyp.length + moov.length, kind: 'moov' }])
+  check('faststart round trips', fastRead.count(), 1)
+
+  // Unknown container
+  check('unknown container', await planPrefetch(1024, reader(new Uint8Array(1024))), null)
+
+  // Faststart: moov moved in front of mdat, chunk offsets follow the samples
+  const slow = movie(false)
+  const { plan: slowPlan, output } = await remux(slow)
+  check('remux planned', [slowPlan.remux, slowPlan.outputSize, output.length], [true, slow.length, slow.length])
+  check('remux layout', slowPlan.segments.map((s) => (s.bytes ? 'moov' : 'copy')), ['copy', 'moov', 'copy'])
+  check('remux output', Array.from(output), Array.from(movie(true)))
+  const offsets = chunkOffsets(output)
+  check('video chunks', offsets[0].map((o) => output[o]), [1, 3, 5, 7, 9])
+  check('audio chunks', offsets[1].map((o) => output[o]), [0xaa, 0xaa])
+
+  // Keyframe index: times and output offsets of samples 1, 5 and 9
+  const index = decodeKeyframeIndex(slowPlan.keyframeIndex)
+  check('keyframe count', slowPlan.keyframes, 3)
+  check('keyframe times', Array.from(index.times), [0, 400, 800])
+  check('keyframe offsets', Array.from(index.offsets).map((o) => output[o]), [1, 5, 9])
+  check('index head', [index.durationMs, index.headEnd], [1000, offsets[0][0] - 8])
+  check('find keyframe', findKeyframe(index, 650).time, 400)
+  check('find before first', findKeyframe(index, -1).time, 0)
+
+  // Already faststart: nothing to move, same index
+  const { plan: fastStartPlan } = await remux(output)
+  check('no remux', [fastStartPlan.remux, fastStartPlan.segments], [false, [{ start: 0, end: output.length }]])
+  check('same index', Array.from(fastStartPlan.keyframeIndex), Array.from(slowPlan.keyframeIndex))
+
+  // Fragmented and non-MP4 files are left alone
+  const fragmented = concat([box('ftyp', new Uint8Array(16)), box('moov', new Uint8Array(8)), box('moof', new Uint8Array(8)), box('mdat', new Uint8Array(64))])
+  check('fragmented', await planFaststart(fragmented.length, reader(fragmented)), null)
+  check('not mp4', await planFaststart(mkv.length, reader(mkv)), null)
+  check('bad index', decodeKeyframeIndex(new Uint8Array(8)), null)
+
+  console.log('Test complete!')
+}
+
+main().catch((err) => {
+  console.error(err)
+  Bare.exit(1)
+})
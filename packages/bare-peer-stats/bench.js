@@ -0,0 +1,132 @@
+/**
+ * Benchmark for bare-peer-stats.
+ *
+ *   bare bench.js [samples...]
+ *
+ * Replication-like sample streams (default 1000000 10000000) spread over
+ * 50 peers and 2000 cores: mostly 64 KiB block downloads with their fetch
+ * latency, some uploads and a round trip per peer every second. Reports
+ * the cost per recorded sample and the latency of a peer and a core
+ * snapshot. The JS baseline keeps the same decayed rates with a sorted
+ * latency window per series (the usual hand-rolled approach) and is
+ * skipped above 1M samples.
+ */
+
+const { PeerStats } = require('./index')
+
+const PEERS = 50
+const CORES = 2000
+const BLOCK = 65536
+const WINDOW = 1024
+const JS_BASELINE_MAX = 1000000
+const RUNS = 5
+
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000
+  }
+}
+
+function stream(size, seed) {
+  const next = rng(seed)
+  const peers = Array.from({ length: PEERS }, (_, i) => `peer-${i}`)
+  const cores = Array.from({ length: CORES }, (_, i) => `core-${i}`)
+  const out = new Array(size)
+  for (let i = 0; i < size; i++) {
+    const peer = peers[Math.floor(PEERS * Math.pow(next(), 2))]
+    const core = cores[Math.floor(CORES * Math.pow(next(), 3))]
+    const r = next()
+    const kind = r < 0.6 ? 0 : r < 0.9 ? 2 : r < 0.99 ? 1 : 3
+    const value = kind === 2 ? 5 + next() * 300 : kind === 3 ? 20 + next() * 200 : BLOCK
+    out[i] = { kind, peer, core, time: i, value }
+  }
+  return out
+}
+
+function time(fn) {
+  fn()
+  const start = Date.now()
+  for (let i = 0; i < RUNS; i++) fn()
+  return (Date.now() - start) / RUNS
+}
+
+class JsStats {
+  constructor() {
+    this.peers = new Map()
+    this.cores = new Map()
+  }
+
+  _series(map, key) {
+    let s = map.get(key)
+    if (!s) {
+      s = { t: 0, rx: 0, tx: 0, latency: [] }
+      map.set(key, s)
+    }
+    return s
+  }
+
+  record(e) {
+    for (const s of [this._series(this.peers, e.peer), e.kind === 3 ? null : this._series(this.cores, e.core)]) {
+      if (!s) continue
+      const f = Math.pow(2, -(e.time - s.t) / 2000)
+      s.rx *= f
+      s.tx *= f
+      s.t = e.time
+      if (e.kind === 0) s.rx += e.value
+      else if (e.kind === 1) s.tx += e.value
+      else if (e.kind === 2) {
+        s.latency.push(e.value)
+        if (s.latency.length > WINDOW) s.latency.shift()
+      }
+    }
+  }
+
+  snapshot(map) {
+    const out = []
+    for (const [key, s] of map) {
+      const sorted = s.latency.slice().sort((a, b) => a - b)
+      const at = (q) => sorted[Math.max(0, Math.ceil(q * sorted.length) - 1)] || 0
+      out.push({ key, rxRate: s.rx * Math.LN2 / 2, p50: at(0.5), p90: at(0.9), p99: at(0.99) })
+    }
+    return out
+  }
+}
+
+function record(stats, e) {
+  if (e.kind === 0) stats.received(e.peer, e.core, e.value, e.time)
+  else if (e.kind === 1) stats.sent(e.peer, e.core, e.value, e.time)
+  else if (e.kind === 2) stats.fetch(e.peer, e.core, e.value, e.time)
+  else stats.rtt(e.peer, e.value, e.time)
+}
+
+function bench(size) {
+  const list = stream(size, 1)
+  const now = size
+
+  const stats = new PeerStats()
+  const start = Date.now()
+  for (let i = 0; i < size; i++) record(stats, list[i])
+  stats.flush()
+  const nativeMs = Date.now() - start
+  const info = stats.stats()
+
+  console.log(`\n${size} samples, ${info.peers} peers, ${info.cores} cores, ${(info.memory / 1048576).toFixed(1)} MB`)
+  console.log(`  record:   native ${(nativeMs * 1e6 / size).toFixed(0)} ns/sample`)
+  console.log(`  snapshot: peers ${time(() => stats.snapshot('peers', now)).toFixed(2)} ms, cores ${time(() => stats.snapshot('cores', now)).toFixed(2)} ms`)
+
+  if (size <= JS_BASELINE_MAX) {
+    const js = new JsStats()
+    const jsStart = Date.now()
+    for (let i = 0; i < size; i++) js.record(list[i])
+    const jsMs = Date.now() - jsStart
+    console.log(`  record:   js ${(jsMs * 1e6 / size).toFixed(0)} ns/sample`)
+    console.log(`  snapshot: js peers ${time(() => js.snapshot(js.peers)).toFixed(2)} ms, cores ${time(() => js.snapshot(js.cores)).toFixed(2)} ms`)
+  }
+
+  stats.destroy()
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+const sizes = args.length > 0 ? args.map(Number) : [1000000, 10000000]
+for (const size of sizes) bench(size)
@@ -0,0 +1,296 @@
+/**
+ * bare-peer-stats - Bare native addon for per-peer network statistics
+ * Decayed byte rates, fetch latency histograms and round-trip times per
+ * peer and per core, fed in batches of samples and read as snapshot rows
+ */
+
+#include <cmath>
+#include <cstdint>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/peer_stats.h"
+
+using bare_peer_stats::config_t;
+using bare_peer_stats::field_count;
+using bare_peer_stats::PeerStats;
+
+// Doubles per sample in an ingest batch: kind, peer, core, time, value
+static constexpr size_t sample_width = 5;
+
+// Handle wrapper for PeerStats
+typedef struct {
+  PeerStats *stats;
+} bare_peer_stats_t;
+
+static bare_peer_stats_t *
+bare_peer_stats__stats(js_env_t *env, js_value_t *value) {
+  bare_peer_stats_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->stats) {
+    js_throw_error(env, NULL, "Peer stats have been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Index column of a sample: -1 (or anything out of range) is `none`
+static uint32_t
+bare_peer_stats__index(double value) {
+  if (!(value >= 0) || value >= double(bare_peer_stats::none)) return bare_peer_stats::none;
+  return uint32_t(value);
+}
+
+// (rateHalfLife, slowHalfLife, latencyHalfLife) in ms
+static js_value_t *
+bare_peer_stats_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  double half_lives[3];
+  for (size_t i = 0; i < 3; i++) {
+    err = js_get_value_double(env, argv[i], &half_lives[i]);
+    if (err != 0) return NULL;
+
+    if (!(half_lives[i] > 0) || !std::isfinite(half_lives[i])) {
+      js_throw_error(env, NULL, "Half lives must be positive");
+      return NULL;
+    }
+  }
+
+  config_t config;
+  config.rate_half_life = half_lives[0];
+  config.slow_half_life = half_lives[1];
+  config.latency_half_life = half_lives[2];
+
+  js_value_t *result;
+  bare_peer_stats_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_peer_stats_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->stats = new PeerStats(config);
+  return result;
+}
+
+// Record the first `count` samples of a Float64Array of sample_width rows:
+// (handle, samples, count)
+static js_value_t *
+bare_peer_stats_ingest(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle = bare_peer_stats__stats(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  js_typedarray_type_t type;
+  double *samples;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[1], &type, (void **) &samples, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t count;
+  err = js_get_value_uint32(env, argv[2], &count);
+  if (err != 0) return NULL;
+
+  if (type != js_float64array || size_t(count) * sample_width > len) {
+    js_throw_error(env, NULL, "Samples must be a Float64Array of at least count x 5 entries");
+    return NULL;
+  }
+
+  PeerStats *stats = handle->stats;
+  for (size_t i = 0; i < count; i++) {
+    const double *s = samples + i * sample_width;
+    if (!(s[0] >= 0)) continue;
+    stats->record(uint32_t(s[0]), bare_peer_stats__index(s[1]), bare_peer_stats__index(s[2]), int64_t(s[3]), s[4]);
+  }
+
+  return NULL;
+}
+
+// Write rows for a scope into a Float64Array: (handle, scope, now, out) ->
+// rows written; the array holds floor(length / fieldCount) rows
+static js_value_t *
+bare_peer_stats_snapshot(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle = bare_peer_stats__stats(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t scope;
+  err = js_get_value_uint32(env, argv[1], &scope);
+  if (err != 0) return NULL;
+
+  double now;
+  err = js_get_value_double(env, argv[2], &now);
+  if (err != 0) return NULL;
+
+  js_typedarray_type_t type;
+  double *out;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[3], &type, (void **) &out, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_float64array) {
+    js_throw_error(env, NULL, "Output must be a Float64Array");
+    return NULL;
+  }
+
+  size_t rows = handle->stats->snapshot(scope, int64_t(now), out, len / field_count);
+
+  js_value_t *result;
+  err = js_create_uint32(env, uint32_t(rows), &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+// Live series in a scope: (handle, scope) -> count
+static js_value_t *
+bare_peer_stats_live(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle = bare_peer_stats__stats(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t scope;
+  err = js_get_value_uint32(env, argv[1], &scope);
+  if (err != 0) return NULL;
+
+  js_value_t *result;
+  err = js_create_uint32(env, uint32_t(handle->stats->live(scope)), &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+// (handle, scope, index)
+static js_value_t *
+bare_peer_stats_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle = bare_peer_stats__stats(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t scope, index;
+  err = js_get_value_uint32(env, argv[1], &scope);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &index);
+  if (err != 0) return NULL;
+
+  handle->stats->clear(scope, index);
+  return NULL;
+}
+
+static js_value_t *
+bare_peer_stats_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle = bare_peer_stats__stats(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  PeerStats *stats = handle->stats;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("samples", stats->samples());
+  SET_NUMBER("peers", stats->live(bare_peer_stats::scope_peers));
+  SET_NUMBER("cores", stats->live(bare_peer_stats::scope_cores));
+  SET_NUMBER("memory", stats->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_peer_stats_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_peer_stats_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->stats;
+  handle->stats = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_peer_stats_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_peer_stats_create);
+  EXPORT_FUNCTION(ingest, bare_peer_stats_ingest);
+  EXPORT_FUNCTION(snapshot, bare_peer_stats_snapshot);
+  EXPORT_FUNCTION(live, bare_peer_stats_live);
+  EXPORT_FUNCTION(clear, bare_peer_stats_clear);
+  EXPORT_FUNCTION(stats, bare_peer_stats_stats);
+  EXPORT_FUNCTION(destroy, bare_peer_stats_destroy);
+
+#undef EXPORT_FUNCTION
+
+  js_value_t *fields;
+  err = js_create_uint32(env, uint32_t(field_count), &fields);
+  if (err == 0) js_set_named_property(env, exports, "fieldCount", fields);
+
+  return exports;
+}
+
+BARE_MODULE(bare_peer_stats, bare_peer_stats_exports)
@@ -0,0 +1,221 @@
+/**
+ * bare-peer-stats - Native per-peer and per-core network statistics
+ * Byte, fetch latency and round-trip samples are queued in a Float64Array
+ * and handed to the addon in batches, so recording one costs a few array
+ * stores. Natively each series keeps fast and slow exponentially decayed
+ * byte rates, an HDR-style fetch latency histogram (halved every latency
+ * half life) and a smoothed round trip. Snapshots are fixed-width rows,
+ * decoded into plain objects keyed by the peer / core keys given here.
+ */
+
+const binding = require('./binding')
+
+const KIND_RX = 0
+const KIND_TX = 1
+const KIND_FETCH = 2
+const KIND_RTT = 3
+
+const SCOPES = { peers: 0, cores: 1 }
+
+// Snapshot row layout (src/peer_stats.h field_t)
+const FIELDS = [
+  'index',
+  'rxRate',
+  'txRate',
+  'rxRateSlow',
+  'txRateSlow',
+  'rxBytes',
+  'txBytes',
+  'rtt',
+  'fetches',
+  'fetchP50',
+  'fetchP90',
+  'fetchP99',
+  'fetchMax',
+  'lastSeen'
+]
+
+const SAMPLE_WIDTH = 5
+const BATCH_SAMPLES = 1024
+
+class Keys {
+  constructor() {
+    /** @type {Array<string|null>} index -> key */
+    this.keys = []
+    /** @type {Map<string, number>} key -> index */
+    this.indexes = new Map()
+    /** @type {number[]} indexes freed by forget() */
+    this.free = []
+  }
+
+  index(key) {
+    let index = this.indexes.get(key)
+    if (index === undefined) {
+      index = this.free.length > 0 ? this.free.pop() : this.keys.length
+      this.keys[index] = key
+      this.indexes.set(key, index)
+    }
+    return index
+  }
+
+  release(key) {
+    const index = this.indexes.get(key)
+    if (index === undefined) return -1
+    this.indexes.delete(key)
+    this.keys[index] = null
+    this.free.push(index)
+    return index
+  }
+}
+
+class PeerStats {
+  /**
+   * @param {Object} [opts]
+   * @param {number} [opts.rateHalfLife=2000] - Fast rate half life in ms
+   * @param {number} [opts.slowHalfLife=30000] - Slow rate half life in ms
+   * @param {number} [opts.latencyHalfLife=60000] - Fetch histogram half life in ms
+   */
+  constructor(opts = {}) {
+    if (binding.fieldCount !== FIELDS.length) throw new Error('bare-peer-stats binding layout mismatch')
+    this._handle = binding.create(
+      opts.rateHalfLife || 2000,
+      opts.slowHalfLife || 30000,
+      opts.latencyHalfLife || 60000
+    )
+    this._peers = new Keys()
+    this._cores = new Keys()
+    this._batch = new Float64Array(BATCH_SAMPLES * SAMPLE_WIDTH)
+    this._pending = 0
+    this._rows = new Float64Array(64 * FIELDS.length)
+  }
+
+  _stats() {
+    if (this._handle === null) throw new Error('Peer stats have been destroyed')
+    return this._handle
+  }
+
+  _push(kind, peer, core, value, time) {
+    this._stats()
+    const i = this._pending * SAMPLE_WIDTH
+    const batch = this._batch
+    batch[i] = kind
+    batch[i + 1] = peer ? this._peers.index(peer) : -1
+    batch[i + 2] = core ? this._cores.index(core) : -1
+    batch[i + 3] = time ?? Date.now()
+    batch[i + 4] = value
+    if (++this._pending === BATCH_SAMPLES) this.flush()
+  }
+
+  /**
+   * Bytes received
+   * @param {string|null} peer - Remote peer key
+   * @param {string|null} core - Core key
+   * @param {number} bytes
+   * @param {number} [time] - ms (default Date.now())
+   */
+  received(peer, core, bytes, time) {
+    this._push(KIND_RX, peer, core, bytes, time)
+  }
+
+  /**
+   * Bytes sent
+   * @param {string|null} peer
+   * @param {string|null} core
+   * @param {number} bytes
+   * @param {number} [time]
+   */
+  sent(peer, core, bytes, time) {
+    this._push(KIND_TX, peer, core, bytes, time)
+  }
+
+  /**
+   * Time from requesting a block to receiving it
+   * @param {string|null} peer
+   * @param {string|null} core
+   * @param {number} ms
+   * @param {number} [time]
+   */
+  fetch(peer, core, ms, time) {
+    this._push(KIND_FETCH, peer, core, Math.round(ms * 1000), time)
+  }
+
+  /**
+   * Transport round trip of a peer connection
+   * @param {string} peer
+   * @param {number} ms
+   * @param {number} [time]
+   */
+  rtt(peer, ms, time) {
+    this._push(KIND_RTT, peer, null, Math.round(ms * 1000), time)
+  }
+
+  /**
+   * Hand queued samples to the native aggregator
+   */
+  flush() {
+    if (this._pending === 0) return
+    binding.ingest(this._stats(), this._batch, this._pending)
+    this._pending = 0
+  }
+
+  /**
+   * Current stats of every peer or core. Rates are bytes/s, latencies ms.
+   * @param {'peers'|'cores'} [scope='peers']
+   * @param {number} [now] - Evaluate decayed rates at this time (default Date.now())
+   * @returns {Array<{key: string, rxRate: number, txRate: number, rxRateSlow: number, txRateSlow: number, rxBytes: number, txBytes: number, rtt: number, fetches: number, fetchP50: number, fetchP90: number, fetchP99: number, fetchMax: number, lastSeen: number}>}
+   */
+  snapshot(scope = 'peers', now = Date.now()) {
+    const handle = this._stats()
+    this.flush()
+
+    const scopeId = SCOPES[scope]
+    if (scopeId === undefined) throw new Error('Unknown scope: ' + scope)
+    const keys = scopeId === 0 ? this._peers : this._cores
+
+    const live = binding.live(handle, scopeId)
+    if (this._rows.length < live * FIELDS.length) this._rows = new Float64Array(live * FIELDS.length * 2)
+    const rows = binding.snapshot(handle, scopeId, now, this._rows)
+
+    const out = []
+    for (let r = 0; r < rows; r++) {
+      const base = r * FIELDS.length
+      const key = keys.keys[this._rows[base]]
+      if (!key) continue
+      const entry = { key }
+      for (let f = 1; f < FIELDS.length; f++) entry[FIELDS[f]] = this._rows[base + f]
+      out.push(entry)
+    }
+    return out
+  }
+
+  /**
+   * Drop a peer's or core's series (e.g. long disconnected)
+   * @param {'peers'|'cores'} scope
+   * @param {string} key
+   */
+  forget(scope, key) {
+    const handle = this._stats()
+    this.flush()
+    const scopeId = SCOPES[scope]
+    if (scopeId === undefined) throw new Error('Unknown scope: ' + scope)
+    const index = (scopeId === 0 ? this._peers : this._cores).release(key)
+    if (index !== -1) binding.clear(handle, scopeId, index)
+  }
+
+  /**
+   * @returns {{samples: number, peers: number, cores: number, memory: number}}
+   */
+  stats() {
+    const handle = this._stats()
+    this.flush()
+    return binding.stats(handle)
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+  }
+}
+
+module.exports = { PeerStats, FIELDS }
@@ -0,0 +1,220 @@
+#include "peer_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace bare_peer_stats {
+
+namespace {
+
+constexpr double ln2 = 0.6931471805599453;
+
+// Indexes are interned densely on the JS side; this bounds a bad one
+constexpr uint32_t max_index = 1 << 20;
+
+inline uint32_t
+log2_floor(uint64_t v) {
+  return 63 - uint32_t(__builtin_clzll(v));
+}
+
+// Decay factor over dt ms for a half life; times going backwards do not
+// decay (samples may arrive slightly out of order)
+inline double
+decay(int64_t dt, double half_life) {
+  if (dt <= 0 || half_life <= 0) return 1;
+  return std::exp2(-double(dt) / half_life);
+}
+
+} // namespace
+
+uint32_t
+histogram_t::bucket(uint64_t value) {
+  if (value < sub_count) return uint32_t(value);
+  if (value >= (uint64_t(1) << max_bits)) value = (uint64_t(1) << max_bits) - 1;
+  uint32_t shift = log2_floor(value) - sub_bits;
+  return (shift + 1) * sub_count + uint32_t(value >> shift) - sub_count;
+}
+
+double
+histogram_t::value(uint32_t bucket) {
+  if (bucket < sub_count) return bucket;
+  uint32_t shift = bucket / sub_count - 1;
+  uint64_t lower = uint64_t(bucket % sub_count + sub_count) << shift;
+  uint64_t width = uint64_t(1) << shift;
+  return double(lower) + double(width - 1) / 2;
+}
+
+void
+histogram_t::add(uint64_t value) {
+  counts[bucket(value)]++;
+  total++;
+}
+
+void
+histogram_t::halve(uint32_t times) {
+  if (total == 0) return;
+  if (times >= 32) {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+    return;
+  }
+  total = 0;
+  for (uint32_t i = 0; i < bucket_count; i++) {
+    counts[i] >>= times;
+    total += counts[i];
+  }
+}
+
+PeerStats::PeerStats(const config_t &config) : config_(config) {}
+
+series_t *
+PeerStats::series(uint32_t scope, uint32_t index) {
+  if (index == none || index >= max_index) return nullptr;
+  std::vector<series_t> &list = scope == scope_peers ? peers_ : cores_;
+  if (index >= list.size()) list.resize(index + 1);
+  series_t *s = &list[index];
+  if (!s->live) {
+    *s = series_t();
+    s->live = true;
+  }
+  return s;
+}
+
+void
+PeerStats::update(series_t *s, uint32_t kind, int64_t time, double value) {
+  if (time > s->last_seen) s->last_seen = time;
+
+  switch (kind) {
+  case kind_rx:
+  case kind_tx: {
+    int64_t dt = time - s->rate_time;
+    if (dt > 0) {
+      double fast = decay(dt, config_.rate_half_life);
+      double slow = decay(dt, config_.slow_half_life);
+      s->rx_fast *= fast;
+      s->tx_fast *= fast;
+      s->rx_slow *= slow;
+      s->tx_slow *= slow;
+      s->rate_time = time;
+    }
+    if (kind == kind_rx) {
+      s->rx_fast += value;
+      s->rx_slow += value;
+      s->rx_bytes += uint64_t(value);
+    } else {
+      s->tx_fast += value;
+      s->tx_slow += value;
+      s->tx_bytes += uint64_t(value);
+    }
+    break;
+  }
+
+  case kind_fetch: {
+    histogram_t &h = s->fetch;
+    if (h.total == 0) {
+      h.last_decay = time;
+    } else if (config_.latency_half_life > 0 && time - h.last_decay >= config_.latency_half_life) {
+      int64_t steps = int64_t(double(time - h.last_decay) / config_.latency_half_life);
+      h.halve(uint32_t(std::min<int64_t>(steps, 32)));
+      h.last_decay += int64_t(double(steps) * config_.latency_half_life);
+    }
+    h.add(uint64_t(value));
+    break;
+  }
+
+  case kind_rtt:
+    s->rtt = s->rtt == 0 ? value : s->rtt + config_.rtt_alpha * (value - s->rtt);
+    break;
+  }
+}
+
+void
+PeerStats::record(uint32_t kind, uint32_t peer, uint32_t core, int64_t time, double value) {
+  if (kind > kind_rtt || !(value >= 0) || !std::isfinite(value)) return;
+  samples_++;
+
+  series_t *p = series(scope_peers, peer);
+  if (p) update(p, kind, time, value);
+
+  // Transport round trips belong to the connection, not a core
+  if (kind == kind_rtt) return;
+
+  series_t *c = series(scope_cores, core);
+  if (c) update(c, kind, time, value);
+}
+
+void
+PeerStats::row(const series_t &s, uint32_t index, int64_t now, double *out) const {
+  int64_t dt = now - s.rate_time;
+  double fast = decay(dt, config_.rate_half_life);
+  double slow = decay(dt, config_.slow_half_life);
+  double fast_rate = config_.rate_half_life > 0 ? ln2 / config_.rate_half_life * 1000 : 0;
+  double slow_rate = config_.slow_half_life > 0 ? ln2 / config_.slow_half_life * 1000 : 0;
+
+  out[field_index] = index;
+  out[field_rx_rate] = s.rx_fast * fast * fast_rate;
+  out[field_tx_rate] = s.tx_fast * fast * fast_rate;
+  out[field_rx_rate_slow] = s.rx_slow * slow * slow_rate;
+  out[field_tx_rate_slow] = s.tx_slow * slow * slow_rate;
+  out[field_rx_bytes] = double(s.rx_bytes);
+  out[field_tx_bytes] = double(s.tx_bytes);
+  out[field_rtt] = s.rtt / 1000;
+
+  // Percentiles in one pass over the buckets
+  const histogram_t &h = s.fetch;
+  out[field_fetches] = double(h.total);
+  out[field_fetch_p50] = out[field_fetch_p90] = out[field_fetch_p99] = out[field_fetch_max] = 0;
+  if (h.total > 0) {
+    const double qs[3] = {0.5, 0.9, 0.99};
+    const size_t fields[3] = {field_fetch_p50, field_fetch_p90, field_fetch_p99};
+    uint64_t ranks[3];
+    for (int i = 0; i < 3; i++) ranks[i] = std::max<uint64_t>(1, uint64_t(std::ceil(qs[i] * double(h.total))));
+
+    uint64_t seen = 0;
+    int next = 0;
+    uint32_t last = 0;
+    for (uint32_t b = 0; b < histogram_t::bucket_count; b++) {
+      if (h.counts[b] == 0) continue;
+      seen += h.counts[b];
+      last = b;
+      while (next < 3 && seen >= ranks[next]) out[fields[next++]] = histogram_t::value(b) / 1000;
+    }
+    out[field_fetch_max] = histogram_t::value(last) / 1000;
+  }
+
+  out[field_last_seen] = double(s.last_seen);
+}
+
+size_t
+PeerStats::snapshot(uint32_t scope, int64_t now, double *out, size_t max_rows) const {
+  const std::vector<series_t> &list = scope == scope_peers ? peers_ : cores_;
+  size_t rows = 0;
+  for (size_t i = 0; i < list.size() && rows < max_rows; i++) {
+    if (!list[i].live) continue;
+    row(list[i], uint32_t(i), now, out + rows * field_count);
+    rows++;
+  }
+  return rows;
+}
+
+size_t
+PeerStats::live(uint32_t scope) const {
+  const std::vector<series_t> &list = scope == scope_peers ? peers_ : cores_;
+  size_t n = 0;
+  for (const series_t &s : list) n += s.live;
+  return n;
+}
+
+void
+PeerStats::clear(uint32_t scope, uint32_t index) {
+  std::vector<series_t> &list = scope == scope_peers ? peers_ : cores_;
+  if (index < list.size()) list[index].live = false;
+}
+
+size_t
+PeerStats::memory_usage() const {
+  return (peers_.capacity() + cores_.capacity()) * sizeof(series_t);
+}
+
+} // namespace bare_peer_stats
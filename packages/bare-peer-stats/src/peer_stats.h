@@ -0,0 +1,133 @@
+/**
+ * Per-peer and per-core network statistics.
+ *
+ * Samples are (kind, peer, core, time in ms, value): received or sent
+ * bytes, a block fetch latency, or a transport round-trip time. A sample
+ * updates the series of its peer and of its core (either may be `none`),
+ * at a fixed cost independent of history:
+ *
+ * - rates: exponentially decayed byte counters, one fast and one slow half
+ *          life per direction; c = c * 2^-(dt / h) + bytes, and the rate is
+ *          c * ln 2 / h
+ * - fetch: HDR-style log-linear histogram of block fetch latency in
+ *          microseconds (16 sub-buckets per power of two, ~6% precision,
+ *          1us to ~67s), halved once per latency half life so it follows
+ *          current conditions
+ * - rtt:   exponentially weighted transport round trip
+ *
+ * Snapshots write fixed-stride rows of doubles (see field_t) for every live
+ * series, evaluated at a given time without changing state.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bare_peer_stats {
+
+constexpr uint32_t none = UINT32_MAX;
+
+enum kind_t : uint32_t {
+  kind_rx = 0,
+  kind_tx = 1,
+  kind_fetch = 2,
+  kind_rtt = 3,
+};
+
+enum scope_t : uint32_t {
+  scope_peers = 0,
+  scope_cores = 1,
+};
+
+// Columns of a snapshot row
+enum field_t : size_t {
+  field_index = 0,
+  field_rx_rate,      // bytes/s, fast half life
+  field_tx_rate,
+  field_rx_rate_slow, // bytes/s, slow half life
+  field_tx_rate_slow,
+  field_rx_bytes,     // totals
+  field_tx_bytes,
+  field_rtt,          // ms, 0 if never sampled
+  field_fetches,      // decayed fetch count in the histogram
+  field_fetch_p50,    // ms
+  field_fetch_p90,
+  field_fetch_p99,
+  field_fetch_max,
+  field_last_seen,    // ms
+  field_count
+};
+
+struct config_t {
+  double rate_half_life = 2000;
+  double slow_half_life = 30000;
+  double latency_half_life = 60000;
+  // Weight of a new rtt sample
+  double rtt_alpha = 0.2;
+};
+
+struct histogram_t {
+  static constexpr uint32_t sub_bits = 4;
+  static constexpr uint32_t sub_count = 1 << sub_bits;
+  // Values are clamped to 2^26 - 1 us (~67 s)
+  static constexpr uint32_t max_bits = 26;
+  static constexpr uint32_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+  uint32_t counts[bucket_count] = {};
+  uint64_t total = 0;
+  int64_t last_decay = 0;
+
+  static uint32_t bucket(uint64_t value);
+  // Midpoint of a bucket's value range
+  static double value(uint32_t bucket);
+
+  void add(uint64_t value);
+  void halve(uint32_t times);
+};
+
+struct series_t {
+  bool live = false;
+  int64_t rate_time = 0;
+  double rx_fast = 0, tx_fast = 0, rx_slow = 0, tx_slow = 0;
+  uint64_t rx_bytes = 0, tx_bytes = 0;
+  double rtt = 0; // us
+  int64_t last_seen = 0;
+  histogram_t fetch;
+};
+
+class PeerStats {
+public:
+  explicit PeerStats(const config_t &config);
+
+  void record(uint32_t kind, uint32_t peer, uint32_t core, int64_t time, double value);
+
+  // Rows of field_count doubles for up to `max_rows` live series of `scope`;
+  // returns the number of rows written
+  size_t snapshot(uint32_t scope, int64_t now, double *out, size_t max_rows) const;
+
+  // Live series in a scope
+  size_t live(uint32_t scope) const;
+
+  // Drop one series (its index may be reused)
+  void clear(uint32_t scope, uint32_t index);
+
+  uint64_t samples() const { return samples_; }
+
+  size_t memory_usage() const;
+
+private:
+  series_t *series(uint32_t scope, uint32_t index);
+
+  void update(series_t *s, uint32_t kind, int64_t time, double value);
+
+  void row(const series_t &s, uint32_t index, int64_t now, double *out) const;
+
+  config_t config_;
+  std::vector<series_t> peers_;
+  std::vector<series_t> cores_;
+  uint64_t samples_ = 0;
+};
+
+} // namespace bare_peer_stats
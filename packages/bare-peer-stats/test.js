@@ -0,0 +1,122 @@
+/**
+ * Simple test for bare-peer-stats addon
+ * Checks decayed rates and latency percentiles against closed forms and
+ * sorted sample lists.
+ */
+
+const { PeerStats } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+function near(label, actual, expected, tolerance = 1e-3) {
+  if (Math.abs(actual - expected) > tolerance * Math.max(1, Math.abs(expected))) {
+    throw new Error(`${label}: expected ${expected}, got ${actual}`)
+  }
+  console.log('ok -', label)
+}
+
+// Deterministic PRNG so failures reproduce
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000
+  }
+}
+
+// Rates: a steady stream converges on its rate; with samples every `step`
+// ms the decayed sum is a geometric series, so the estimate is exact
+{
+  const stats = new PeerStats({ rateHalfLife: 2000, slowHalfLife: 30000 })
+  const step = 100
+  const bytes = 50000 // 500 KB/s
+  for (let t = 0; t <= 600000; t += step) {
+    stats.received('peer-a', 'core-1', bytes, t)
+    stats.sent('peer-a', 'core-1', bytes / 10, t)
+  }
+
+  const series = (h) => bytes / (1 - Math.pow(2, -step / h)) * Math.LN2 / h * 1000
+  const [peer] = stats.snapshot('peers', 600000)
+  check('peer key', peer.key, 'peer-a')
+  near('fast rx rate', peer.rxRate, series(2000))
+  near('slow rx rate', peer.rxRateSlow, series(30000))
+  near('tx rate', peer.txRate, series(2000) / 10)
+  check('rx bytes', peer.rxBytes, 6001 * bytes)
+
+  const [core] = stats.snapshot('cores', 600000)
+  check('core key', core.key, 'core-1')
+  check('core bytes', core.rxBytes, peer.rxBytes)
+
+  // Idle for one fast half life: the rate halves, totals stay
+  const [idle] = stats.snapshot('peers', 602000)
+  near('idle rate halves', idle.rxRate, peer.rxRate / 2)
+  check('idle totals', idle.rxBytes, peer.rxBytes)
+  stats.destroy()
+}
+
+// Latency: percentiles within the histogram's ~6% bucket precision
+{
+  const stats = new PeerStats({ latencyHalfLife: 60000 })
+  const next = rng(3)
+  const samples = []
+  for (let i = 0; i < 20000; i++) {
+    // Mostly fast peers with a slow tail
+    const ms = next() < 0.95 ? 5 + next() * 40 : 200 + next() * 2000
+    samples.push(ms)
+    stats.fetch('peer-b', 'core-2', ms, 1000)
+  }
+  stats.rtt('peer-b', 80, 1000)
+  stats.rtt('peer-b', 40, 1000)
+  samples.sort((a, b) => a - b)
+
+  const rank = (q) => samples[Math.ceil(q * samples.length) - 1]
+  const [peer] = stats.snapshot('peers', 1000)
+  check('fetch count', peer.fetches, samples.length)
+  near('p50', peer.fetchP50, rank(0.5), 0.07)
+  near('p90', peer.fetchP90, rank(0.9), 0.07)
+  near('p99', peer.fetchP99, rank(0.99), 0.07)
+  near('max', peer.fetchMax, samples[samples.length - 1], 0.07)
+  near('smoothed rtt', peer.rtt, 80 + 0.2 * (40 - 80))
+
+  const [core] = stats.snapshot('cores', 1000)
+  check('rtt is per connection only', core.rtt, 0)
+  check('core fetches', core.fetches, samples.length)
+
+  // Two latency half lives later the old samples weigh a quarter (bucket
+  // counts are halved as integers, so a little less)
+  stats.fetch('peer-b', 'core-2', 10, 121000)
+  near('histogram decays', stats.snapshot('peers', 121000)[0].fetches, samples.length / 4, 0.05)
+  stats.destroy()
+}
+
+// Peers and cores are optional; forgotten keys drop out and indexes are reused
+{
+  const stats = new PeerStats()
+  stats.received(null, 'core-only', 100, 0)
+  stats.received('peer-only', null, 100, 0)
+  check('no core series for peer-only sample', stats.snapshot('cores', 0).map((s) => s.key), ['core-only'])
+  check('no peer series for core-only sample', stats.snapshot('peers', 0).map((s) => s.key), ['peer-only'])
+
+  stats.forget('peers', 'peer-only')
+  check('forgotten', stats.snapshot('peers', 0), [])
+  stats.received('peer-new', null, 7, 0)
+  const [fresh] = stats.snapshot('peers', 0)
+  check('reused index starts clean', [fresh.key, fresh.rxBytes], ['peer-new', 7])
+
+  // More samples than one batch
+  for (let i = 0; i < 5000; i++) stats.received(`p${i % 100}`, `c${i % 300}`, 1, i)
+  check('batched', stats.stats().samples, 5003)
+  check('many peers', stats.snapshot('peers', 5000).length, 101)
+  check('many cores', stats.snapshot('cores', 5000).length, 301)
+
+  stats.destroy()
+  let threw = false
+  try { stats.snapshot() } catch { threw = true }
+  check('destroyed stats throw', threw, true)
+}
+
+console.log('all tests passed')
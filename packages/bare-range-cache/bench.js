@@ -0,0 +1,95 @@
+/**
+ * Benchmark for bare-range-cache.
+ *
+ *   bare bench.js [megabytes]
+ *
+ * Reads a blob of 64 KB blocks (default 64 MB) front to back in 128 KB
+ * demuxer-sized reads, the way an IOContext onread sees it: through JS
+ * block lookup and Buffer.copy per read (what HypercoreIOReader did, with
+ * its per-read block scan and with direct block math), and through the
+ * native cache's cursor.
+ */
+
+const { RangeCache } = require('./index')
+
+const BLOCK = 64 * 1024
+const READ = 128 * 1024
+const PASSES = 3
+
+function mbps(bytes, ms) {
+  return (bytes / 1048576 / (ms / 1000)).toFixed(0).padStart(6)
+}
+
+const size = Number(Bare.argv[2] || 64) * 1024 * 1024
+const count = Math.ceil(size / BLOCK)
+
+const blocks = new Map()
+for (let i = 0; i < count; i++) {
+  const block = Buffer.alloc(Math.min(BLOCK, size - i * BLOCK))
+  for (let j = 0; j < block.length; j += 4096) block[j] = (i + j) & 0xff
+  blocks.set(i, block)
+}
+
+function jsRead(buffer, position, locate) {
+  let written = 0
+  let remaining = Math.min(buffer.length, size - position)
+  while (remaining > 0) {
+    const { index, offset } = locate(position + written)
+    const block = blocks.get(index)
+    const n = Math.min(remaining, block.length - offset)
+    block.copy(buffer, written, offset, offset + n)
+    written += n
+    remaining -= n
+  }
+  return written
+}
+
+// HypercoreIOReader.getBlockPosition(): walk block lengths from the start
+function scan(pos) {
+  let at = 0
+  for (let i = 0; i < count; i++) {
+    const len = blocks.get(i).length
+    if (at + len > pos) return { index: i, offset: pos - at }
+    at += len
+  }
+  return null
+}
+
+function direct(pos) {
+  return { index: Math.floor(pos / BLOCK), offset: pos % BLOCK }
+}
+
+function run(label, read) {
+  const buffer = Buffer.alloc(READ)
+  let best = Infinity
+  let reads = 0
+  for (let pass = 0; pass < PASSES; pass++) {
+    const start = Date.now()
+    let position = 0
+    reads = 0
+    while (position < size) {
+      position += read(buffer, position)
+      reads++
+    }
+    best = Math.min(best, Date.now() - start)
+  }
+  console.log(`  ${label.padEnd(18)} ${mbps(size, best)} MB/s   ${reads} reads, ${(best * 1000 / reads).toFixed(1)} us/read`)
+}
+
+const cache = new RangeCache(size, { pageSize: BLOCK })
+let offset = 0
+for (let i = 0; i < count; i++) {
+  offset += cache.write(offset, blocks.get(i))
+}
+
+console.log(`${Math.round(size / 1048576)} MB, ${count} blocks, ${READ / 1024} KB reads`)
+run('js block scan', (buffer, position) => jsRead(buffer, position, scan))
+run('js block math', (buffer, position) => jsRead(buffer, position, direct))
+run('native cursor', (buffer, position) => {
+  if (position === 0) cache.seek(0, 0)
+  return cache.read(buffer)
+})
+
+const stats = cache.stats()
+console.log(`  cached ${Math.round(stats.bytesCached / 1048576)} MB in ${stats.pages} pages, hit rate ${stats.hitRate}`)
+cache.destroy()
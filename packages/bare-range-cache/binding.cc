@@ -0,0 +1,348 @@
+/**
+ * bare-range-cache - Bare native addon for demuxer input caching
+ * Keeps a file's bytes in native pages and serves FFmpeg-style read/seek
+ * straight into the caller's buffer
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/range_cache.h"
+
+using bare_range_cache::RangeCache;
+using bare_range_cache::miss_t;
+using bare_range_cache::stats_t;
+
+// Handle wrapper for RangeCache
+typedef struct {
+  RangeCache *cache;
+} bare_range_cache_t;
+
+static RangeCache *
+bare_range_cache__cache(js_env_t *env, js_value_t *value) {
+  bare_range_cache_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->cache) {
+    js_throw_error(env, NULL, "RangeCache has been destroyed");
+    return NULL;
+  }
+
+  return handle->cache;
+}
+
+static bool
+bare_range_cache__offset(js_env_t *env, js_value_t *value, uint64_t *out) {
+  int64_t offset;
+  int err = js_get_value_int64(env, value, &offset);
+  if (err != 0) return false;
+
+  if (offset < 0) {
+    js_throw_error(env, NULL, "Offset must not be negative");
+    return false;
+  }
+
+  *out = uint64_t(offset);
+  return true;
+}
+
+static js_value_t *
+bare_range_cache__number(js_env_t *env, double value) {
+  js_value_t *result;
+  int err = js_create_double(env, value, &result);
+  if (err != 0) return NULL;
+  return result;
+}
+
+// (size, pageSize, capacity)
+static js_value_t *
+bare_range_cache_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint64_t size, capacity;
+  uint32_t page_size;
+  if (!bare_range_cache__offset(env, argv[0], &size)) return NULL;
+  err = js_get_value_uint32(env, argv[1], &page_size);
+  if (err != 0) return NULL;
+  if (!bare_range_cache__offset(env, argv[2], &capacity)) return NULL;
+
+  if (page_size == 0) {
+    js_throw_error(env, NULL, "Page size must be positive");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_range_cache_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_range_cache_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->cache = new RangeCache(size, page_size, capacity);
+  return result;
+}
+
+// (handle, offset, data) -> bytes kept
+static js_value_t *
+bare_range_cache_write(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  uint64_t offset;
+  if (!bare_range_cache__offset(env, argv[1], &offset)) return NULL;
+
+  uint8_t *data;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], NULL, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  return bare_range_cache__number(env, double(cache->write(offset, data, len)));
+}
+
+// (handle, offset, length) -> boolean
+static js_value_t *
+bare_range_cache_has(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  uint64_t offset, length;
+  if (!bare_range_cache__offset(env, argv[1], &offset)) return NULL;
+  if (!bare_range_cache__offset(env, argv[2], &length)) return NULL;
+
+  js_value_t *result;
+  err = js_get_boolean(env, cache->has(offset, length), &result);
+  if (err != 0) return NULL;
+  return result;
+}
+
+// (handle, buffer) -> bytes read at the position, 0 at the end, -1 on a miss
+static js_value_t *
+bare_range_cache_read(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  uint8_t *data;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[1], NULL, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  return bare_range_cache__number(env, double(cache->read(data, len)));
+}
+
+// (handle, offset, buffer) -> bytes read, 0 at the end, -1 on a miss
+static js_value_t *
+bare_range_cache_read_at(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  uint64_t offset;
+  if (!bare_range_cache__offset(env, argv[1], &offset)) return NULL;
+
+  uint8_t *data;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[2], NULL, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  return bare_range_cache__number(env, double(cache->read_at(offset, data, len)));
+}
+
+// (handle, offset, whence) -> new position
+static js_value_t *
+bare_range_cache_seek(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  int64_t offset;
+  int32_t whence;
+  err = js_get_value_int64(env, argv[1], &offset);
+  if (err != 0) return NULL;
+  err = js_get_value_int32(env, argv[2], &whence);
+  if (err != 0) return NULL;
+
+  return bare_range_cache__number(env, double(cache->seek(offset, whence)));
+}
+
+static js_value_t *
+bare_range_cache_position(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  return bare_range_cache__number(env, double(cache->position()));
+}
+
+// Queued misses as a flat [offset, length, ...] array, or null if none
+static js_value_t *
+bare_range_cache_misses(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  std::vector<miss_t> misses = cache->take_misses();
+
+  js_value_t *result;
+  if (misses.empty()) {
+    err = js_get_null(env, &result);
+    if (err != 0) return NULL;
+    return result;
+  }
+
+  err = js_create_array_with_length(env, misses.size() * 2, &result);
+  if (err != 0) return NULL;
+
+  for (size_t i = 0; i < misses.size(); i++) {
+    js_value_t *offset = bare_range_cache__number(env, double(misses[i].offset));
+    js_value_t *length = bare_range_cache__number(env, double(misses[i].length));
+    if (offset == NULL || length == NULL) return NULL;
+    js_set_element(env, result, uint32_t(i * 2), offset);
+    js_set_element(env, result, uint32_t(i * 2 + 1), length);
+  }
+
+  return result;
+}
+
+static js_value_t *
+bare_range_cache_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  RangeCache *cache = bare_range_cache__cache(env, argv[0]);
+  if (cache == NULL) return NULL;
+
+  stats_t stats = cache->stats();
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("size", cache->size());
+  SET_NUMBER("position", cache->position());
+  SET_NUMBER("hits", stats.hits);
+  SET_NUMBER("misses", stats.misses);
+  SET_NUMBER("seeks", stats.seeks);
+  SET_NUMBER("bytesRead", stats.bytes_read);
+  SET_NUMBER("bytesWritten", stats.bytes_written);
+  SET_NUMBER("bytesCached", stats.bytes_cached);
+  SET_NUMBER("pages", stats.pages);
+  SET_NUMBER("evictions", stats.evictions);
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_range_cache_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_range_cache_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->cache;
+  handle->cache = NULL;
+
+  return NULL;
+}
+
+// Module exports
+static js_value_t *
+bare_range_cache_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(create, bare_range_cache_create);
+  EXPORT_FUNCTION(write, bare_range_cache_write);
+  EXPORT_FUNCTION(has, bare_range_cache_has);
+  EXPORT_FUNCTION(read, bare_range_cache_read);
+  EXPORT_FUNCTION(readAt, bare_range_cache_read_at);
+  EXPORT_FUNCTION(seek, bare_range_cache_seek);
+  EXPORT_FUNCTION(position, bare_range_cache_position);
+  EXPORT_FUNCTION(misses, bare_range_cache_misses);
+  EXPORT_FUNCTION(stats, bare_range_cache_stats);
+  EXPORT_FUNCTION(destroy, bare_range_cache_destroy);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_range_cache, bare_range_cache_exports)
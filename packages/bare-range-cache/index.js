@@ -0,0 +1,172 @@
+/**
+ * bare-range-cache - Native input cache for FFmpeg IOContexts
+ * The bytes a demuxer reads (hypercore blocks, HTTP ranges) live in native
+ * pages, and read/seek run against a native position, so an IOContext's
+ * callbacks are a single native call that copies straight into FFmpeg's
+ * buffer: no block lookup, copy or position bookkeeping in JS per read.
+ * Reads never wait for data; a read with nothing cached returns MISS and
+ * the missing ranges reach onmiss asynchronously, batched and merged.
+ */
+
+const binding = require('./binding')
+
+const DEFAULT_PAGE_SIZE = 64 * 1024
+const DEFAULT_IO_BUFFER_SIZE = 128 * 1024
+
+// read()/readAt() result when nothing is cached at the position
+const MISS = -1
+
+class RangeCache {
+  /**
+   * @param {number} size - Total size of the file in bytes
+   * @param {Object} [opts]
+   * @param {number} [opts.pageSize=65536] - Cache granularity; misses are whole pages
+   * @param {number} [opts.capacity=0] - Max cached bytes, least recently read evicted
+   *   first; 0 keeps everything
+   * @param {(offset: number, length: number) => void} [opts.onmiss] - Called after a
+   *   read found a gap, once per merged missing range
+   */
+  constructor(size, opts = {}) {
+    this._handle = binding.create(size, opts.pageSize || DEFAULT_PAGE_SIZE, opts.capacity || 0)
+    this.size = size
+    this.onmiss = opts.onmiss || null
+    this._missScheduled = false
+  }
+
+  _cache() {
+    if (this._handle === null) throw new Error('RangeCache has been destroyed')
+    return this._handle
+  }
+
+  /**
+   * Copy bytes located at an absolute offset into the cache
+   * @param {number} offset
+   * @param {Uint8Array} data
+   * @returns {number} Bytes kept
+   */
+  write(offset, data) {
+    return binding.write(this._cache(), offset, data)
+  }
+
+  /**
+   * @param {number} offset
+   * @param {number} length
+   * @returns {boolean} Whether the whole range (clipped to the size) is cached
+   */
+  has(offset, length) {
+    return binding.has(this._cache(), offset, length)
+  }
+
+  /**
+   * Read at the position and advance it, stopping at the first gap
+   * @param {Uint8Array} buffer
+   * @returns {number} Bytes read, 0 at the end, or MISS
+   */
+  read(buffer) {
+    const n = binding.read(this._cache(), buffer)
+    if (n !== buffer.length) this._scheduleMisses()
+    return n
+  }
+
+  /**
+   * Read at an absolute offset without moving the position
+   * @param {number} offset
+   * @param {Uint8Array} buffer
+   * @returns {number} Bytes read, 0 at the end, or MISS
+   */
+  readAt(offset, buffer) {
+    const n = binding.readAt(this._cache(), offset, buffer)
+    if (n !== buffer.length) this._scheduleMisses()
+    return n
+  }
+
+  /**
+   * FFmpeg seek: SEEK_SET/CUR/END, or AVSEEK_SIZE for the size
+   * @param {number} offset
+   * @param {number} whence
+   * @returns {number} New position, or -1 for an unknown whence
+   */
+  seek(offset, whence) {
+    return binding.seek(this._cache(), offset, whence)
+  }
+
+  get position() {
+    return binding.position(this._cache())
+  }
+
+  /**
+   * Missing ranges queued since the last call (or onmiss delivery)
+   * @returns {Array<{offset: number, length: number}>}
+   */
+  takeMisses() {
+    const flat = binding.misses(this._cache())
+    const misses = []
+    if (flat === null) return misses
+    for (let i = 0; i < flat.length; i += 2) misses.push({ offset: flat[i], length: flat[i + 1] })
+    return misses
+  }
+
+  _scheduleMisses() {
+    if (this.onmiss === null || this._missScheduled) return
+    this._missScheduled = true
+    queueMicrotask(() => {
+      this._missScheduled = false
+      if (this._handle === null || this.onmiss === null) return
+      for (const miss of this.takeMisses()) this.onmiss(miss.offset, miss.length)
+    })
+  }
+
+  /**
+   * IOContext whose callbacks read and seek this cache natively
+   * @param {Object} ffmpeg - bare-ffmpeg module
+   * @param {Object} [opts]
+   * @param {number} [opts.bufferSize=131072] - IOContext buffer size
+   * @param {(buffer: Uint8Array) => number} [opts.onmissread] - Result for a read with
+   *   nothing cached; defaults to 0 (EOF), which FFmpeg handles without erroring
+   * @returns {Object} IOContext
+   */
+  createIOContext(ffmpeg, opts = {}) {
+    this._cache()
+    const onmissread = opts.onmissread || null
+
+    // Errors rather than throws once destroyed, as FFmpeg may still be
+    // reading while the owner tears down
+    return new ffmpeg.IOContext(opts.bufferSize || DEFAULT_IO_BUFFER_SIZE, {
+      onread: (buffer) => {
+        if (this._handle === null) return -1
+        const n = binding.read(this._handle, buffer)
+        if (n === buffer.length) return n
+        this._scheduleMisses()
+        if (n === MISS) return onmissread ? onmissread(buffer) : 0
+        return n
+      },
+      onseek: (offset, whence) => {
+        if (this._handle === null) return -1
+        return binding.seek(this._handle, offset, whence)
+      }
+    })
+  }
+
+  /**
+   * @returns {{size: number, position: number, hits: number, misses: number, seeks: number,
+   *   bytesRead: number, bytesWritten: number, bytesCached: number, pages: number,
+   *   evictions: number, hitRate: number}}
+   */
+  stats() {
+    const stats = binding.stats(this._cache())
+    const reads = stats.hits + stats.misses
+    stats.hitRate = reads > 0 ? stats.hits / reads : 1
+    return stats
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.destroy(this._handle)
+    this._handle = null
+  }
+}
+
+module.exports = {
+  RangeCache,
+  MISS
+}
@@ -0,0 +1,246 @@
+#include "range_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bare_range_cache {
+
+RangeCache::RangeCache(uint64_t size, uint32_t page_size, uint64_t capacity)
+    : size_(size),
+      page_size_(page_size),
+      max_pages_(capacity == 0 ? 0 : (capacity + page_size - 1) / page_size) {
+  // Eviction never drops the page being written, so keep room for two
+  if (max_pages_ != 0 && max_pages_ < 2) max_pages_ = 2;
+}
+
+RangeCache::~RangeCache() {
+  for (auto &entry : pages_) {
+    delete[] entry.second->data;
+    delete entry.second;
+  }
+  for (uint8_t *data : free_) delete[] data;
+}
+
+RangeCache::page_t *
+RangeCache::find(uint64_t index) {
+  auto it = pages_.find(index);
+  return it == pages_.end() ? nullptr : it->second;
+}
+
+void
+RangeCache::unlink(page_t *page) {
+  if (page->prev) page->prev->next = page->next;
+  else head_ = page->next;
+  if (page->next) page->next->prev = page->prev;
+  else tail_ = page->prev;
+  page->prev = page->next = nullptr;
+}
+
+void
+RangeCache::touch(page_t *page) {
+  if (head_ == page) return;
+  if (page->prev || page->next || tail_ == page) unlink(page);
+  page->next = head_;
+  if (head_) head_->prev = page;
+  head_ = page;
+  if (!tail_) tail_ = page;
+}
+
+void
+RangeCache::evict() {
+  page_t *victim = tail_;
+  unlink(victim);
+  pages_.erase(victim->index);
+  stats_.bytes_cached -= victim->hi - victim->lo;
+  stats_.evictions++;
+  free_.push_back(victim->data);
+  delete victim;
+}
+
+RangeCache::page_t *
+RangeCache::acquire(uint64_t index) {
+  page_t *page = find(index);
+  if (page) return page;
+
+  if (max_pages_ != 0 && pages_.size() >= max_pages_) evict();
+
+  page = new page_t();
+  page->index = index;
+  page->lo = page->hi = 0;
+  if (!free_.empty()) {
+    page->data = free_.back();
+    free_.pop_back();
+  } else {
+    page->data = new uint8_t[page_size_];
+  }
+  page->prev = page->next = nullptr;
+  pages_.emplace(index, page);
+  touch(page);
+  return page;
+}
+
+size_t
+RangeCache::write(uint64_t offset, const uint8_t *data, size_t len) {
+  if (offset >= size_) return 0;
+  len = size_t(std::min<uint64_t>(len, size_ - offset));
+
+  size_t kept = 0;
+  size_t done = 0;
+  while (done < len) {
+    uint64_t pos = offset + done;
+    uint64_t index = pos / page_size_;
+    uint32_t lo = uint32_t(pos % page_size_);
+    uint32_t hi = uint32_t(std::min<uint64_t>(page_size_, lo + (len - done)));
+    const uint8_t *src = data + done;
+    done += hi - lo;
+
+    page_t *page = acquire(index);
+    miss_pending_.erase(index);
+
+    uint32_t old = page->hi - page->lo;
+    if (old == 0 || (lo <= page->hi && hi >= page->lo)) {
+      // Empty, overlapping or adjacent: extend the run
+      memcpy(page->data + lo, src, hi - lo);
+      uint32_t new_lo = old == 0 ? lo : std::min(page->lo, lo);
+      uint32_t new_hi = old == 0 ? hi : std::max(page->hi, hi);
+      page->lo = new_lo;
+      page->hi = new_hi;
+    } else if (hi - lo > old) {
+      memcpy(page->data + lo, src, hi - lo);
+      page->lo = lo;
+      page->hi = hi;
+    } else {
+      continue;
+    }
+
+    stats_.bytes_cached += (page->hi - page->lo) - old;
+    kept += hi - lo;
+  }
+
+  stats_.bytes_written += kept;
+  return kept;
+}
+
+bool
+RangeCache::has(uint64_t offset, uint64_t len) const {
+  if (offset >= size_) return false;
+  uint64_t end = std::min(size_, offset + len);
+
+  for (uint64_t pos = offset; pos < end;) {
+    uint64_t index = pos / page_size_;
+    auto it = pages_.find(index);
+    if (it == pages_.end()) return false;
+
+    const page_t *page = it->second;
+    uint64_t base = index * page_size_;
+    if (pos < base + page->lo || pos >= base + page->hi) return false;
+    pos = base + page->hi;
+    if (pos < end && page->hi < page_size_) return false;
+  }
+  return true;
+}
+
+void
+RangeCache::note_miss(uint64_t offset) {
+  uint64_t index = offset / page_size_;
+  if (miss_pending_.insert(index).second) miss_queue_.push_back(index);
+}
+
+int64_t
+RangeCache::read_at(uint64_t offset, uint8_t *out, size_t len) {
+  if (offset >= size_ || len == 0) return 0;
+  len = size_t(std::min<uint64_t>(len, size_ - offset));
+
+  size_t copied = 0;
+  while (copied < len) {
+    uint64_t pos = offset + copied;
+    uint64_t index = pos / page_size_;
+    uint32_t in = uint32_t(pos % page_size_);
+
+    page_t *page = find(index);
+    if (!page || in < page->lo || in >= page->hi) break;
+
+    size_t n = std::min<size_t>(page->hi - in, len - copied);
+    memcpy(out + copied, page->data + in, n);
+    copied += n;
+    touch(page);
+
+    // A run that ends short of its page leaves a gap after it
+    if (page->hi < page_size_) break;
+  }
+
+  if (copied < len) note_miss(offset + copied);
+
+  if (copied == 0) {
+    stats_.misses++;
+    return read_miss;
+  }
+
+  stats_.hits++;
+  stats_.bytes_read += copied;
+  return int64_t(copied);
+}
+
+int64_t
+RangeCache::read(uint8_t *out, size_t len) {
+  int64_t n = read_at(position_, out, len);
+  if (n > 0) position_ += uint64_t(n);
+  return n;
+}
+
+int64_t
+RangeCache::seek(int64_t offset, int whence) {
+  whence &= ~avseek_force;
+  if (whence == avseek_size) return int64_t(size_);
+
+  int64_t pos;
+  switch (whence) {
+  case seek_set:
+    pos = offset;
+    break;
+  case seek_cur:
+    pos = int64_t(position_) + offset;
+    break;
+  case seek_end:
+    pos = int64_t(size_) + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  if (pos < 0) pos = 0;
+  if (uint64_t(pos) > size_) pos = int64_t(size_);
+  position_ = uint64_t(pos);
+  stats_.seeks++;
+  return pos;
+}
+
+std::vector<miss_t>
+RangeCache::take_misses() {
+  std::vector<miss_t> result;
+  if (miss_queue_.empty()) return result;
+
+  std::sort(miss_queue_.begin(), miss_queue_.end());
+  for (uint64_t index : miss_queue_) {
+    uint64_t offset = index * page_size_;
+    uint64_t length = std::min<uint64_t>(page_size_, size_ - offset);
+    if (!result.empty() && result.back().offset + result.back().length == offset) {
+      result.back().length += length;
+    } else {
+      result.push_back({offset, length});
+    }
+  }
+
+  miss_queue_.clear();
+  miss_pending_.clear();
+  return result;
+}
+
+stats_t
+RangeCache::stats() const {
+  stats_t stats = stats_;
+  stats.pages = pages_.size();
+  return stats;
+}
+
+} // namespace bare_range_cache
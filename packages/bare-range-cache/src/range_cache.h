@@ -0,0 +1,125 @@
+/**
+ * Byte range cache with an FFmpeg-style cursor.
+ *
+ * Holds the bytes of one file (a hyperblobs blob, an HTTP resource) in
+ * fixed-size pages. Each page keeps one contiguous run of valid bytes, so
+ * data can arrive at any offset and in any order: hypercore blocks, HTTP
+ * ranges, a tail prefetch. Pages past the capacity are evicted least
+ * recently read first.
+ *
+ * read() and seek() follow AVIOContext read_packet/seek semantics on an
+ * internal position, so a demuxer's IO callbacks are one call each with no
+ * per-read bookkeeping on the caller's side. A read that finds no bytes at
+ * the position returns read_miss instead of blocking; the missing pages are
+ * queued and the caller collects them with take_misses() whenever it can
+ * fetch, off the read path.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bare_range_cache {
+
+// FFmpeg whence values (libavformat/avio.h)
+constexpr int seek_set = 0;
+constexpr int seek_cur = 1;
+constexpr int seek_end = 2;
+constexpr int avseek_size = 0x10000;
+constexpr int avseek_force = 0x20000;
+
+// read() result when nothing is cached at the position
+constexpr int64_t read_miss = -1;
+
+struct miss_t {
+  uint64_t offset;
+  uint64_t length;
+};
+
+struct stats_t {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t bytes_cached = 0;
+  uint64_t pages = 0;
+  uint64_t evictions = 0;
+  uint64_t seeks = 0;
+};
+
+class RangeCache {
+public:
+  // capacity in bytes, rounded up to whole pages; 0 keeps everything
+  RangeCache(uint64_t size, uint32_t page_size, uint64_t capacity);
+  ~RangeCache();
+
+  RangeCache(const RangeCache &) = delete;
+  RangeCache &operator=(const RangeCache &) = delete;
+
+  uint64_t size() const { return size_; }
+  uint64_t position() const { return position_; }
+
+  // Copy bytes located at an absolute offset in. Returns the bytes kept: a
+  // run that is not contiguous with a page's current run replaces it only
+  // if longer.
+  size_t write(uint64_t offset, const uint8_t *data, size_t len);
+
+  // True if [offset, offset + len) is cached, clipped to the file size
+  bool has(uint64_t offset, uint64_t len) const;
+
+  // Copy cached bytes at offset, stopping at the first gap. Returns bytes
+  // copied, 0 at or past the end, or read_miss if the first byte is not
+  // cached. The first missing page is queued either way.
+  int64_t read_at(uint64_t offset, uint8_t *out, size_t len);
+
+  // read_at() at the position, advancing it
+  int64_t read(uint8_t *out, size_t len);
+
+  // AVIOContext seek: new position, or the size for avseek_size; -1 for an
+  // unknown whence. Positions are clamped to [0, size].
+  int64_t seek(int64_t offset, int whence);
+
+  // Missing page runs queued since the last call, merged and in order
+  std::vector<miss_t> take_misses();
+
+  stats_t stats() const;
+
+private:
+  struct page_t {
+    uint64_t index;
+    uint32_t lo; // valid bytes are [lo, hi)
+    uint32_t hi;
+    uint8_t *data;
+    page_t *prev; // LRU list, most recently used first
+    page_t *next;
+  };
+
+  page_t *find(uint64_t index);
+  page_t *acquire(uint64_t index);
+  void touch(page_t *page);
+  void unlink(page_t *page);
+  void evict();
+  void note_miss(uint64_t offset);
+
+  uint64_t size_;
+  uint32_t page_size_;
+  uint64_t max_pages_;
+  uint64_t position_ = 0;
+
+  std::unordered_map<uint64_t, page_t *> pages_;
+  page_t *head_ = nullptr;
+  page_t *tail_ = nullptr;
+  // Page buffers of evicted pages, reused before allocating
+  std::vector<uint8_t *> free_;
+
+  std::vector<uint64_t> miss_queue_;
+  std::unordered_set<uint64_t> miss_pending_;
+
+  stats_t stats_;
+};
+
+} // namespace bare_range_cache
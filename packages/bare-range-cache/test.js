@@ -0,0 +1,102 @@
+/**
+ * Simple test for bare-range-cache addon
+ * Fills a cache out of order, reads it through the cursor and at offsets,
+ * and checks seeks, misses, run merging and eviction.
+ */
+
+const { RangeCache, MISS } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+const PAGE = 1000
+const SIZE = 10 * PAGE + 7
+
+const file = Buffer.alloc(SIZE)
+for (let i = 0; i < SIZE; i++) file[i] = (i * 31 + 7) & 0xff
+
+async function main() {
+  const missed = []
+  let cache = new RangeCache(SIZE, { pageSize: PAGE, onmiss: (offset, length) => missed.push([offset, length]) })
+  const buffer = Buffer.alloc(4096)
+
+  check('empty read misses', cache.read(buffer.subarray(0, 100)), MISS)
+  check('onmiss is async', missed, [])
+  await Promise.resolve()
+  check('onmiss page', missed, [[0, PAGE]])
+
+  // Unaligned writes out of order
+  cache.write(2500, file.subarray(2500, 5500))
+  cache.write(0, file.subarray(0, 1200))
+  check('has', [cache.has(0, 1200), cache.has(0, 1300), cache.has(2500, 3000)], [true, false, true])
+
+  check('read stops at gap', cache.read(buffer), 1200)
+  check('read bytes', buffer.subarray(0, 1200).equals(file.subarray(0, 1200)), true)
+  check('gap misses', cache.read(buffer), MISS)
+  check('position', cache.position, 1200)
+
+  cache.write(1200, file.subarray(1200, 2500))
+  check('filled', cache.has(0, 5500), true)
+  check('seek set', cache.seek(0, 0), 0)
+  check('read across pages', [cache.read(buffer), buffer.equals(file.subarray(0, 4096))], [4096, true])
+
+  const at = Buffer.alloc(300)
+  check('readAt', [cache.readAt(2400, at), at.equals(file.subarray(2400, 2700))], [300, true])
+  check('readAt keeps position', cache.position, 4096)
+
+  // Seeks follow FFmpeg's whence values
+  check('seek end', cache.seek(-7, 2), SIZE - 7)
+  cache.write(9000, file.subarray(9000))
+  check('tail', [cache.read(buffer.subarray(0, 10)), buffer.subarray(0, 7).equals(file.subarray(SIZE - 7))], [7, true])
+  check('eof', cache.read(buffer.subarray(0, 10)), 0)
+  check('size query', cache.seek(0, 0x10000), SIZE)
+  check('seek clamps', [cache.seek(-5, 0), cache.seek(5, 1 | 0x20000), cache.seek(SIZE * 2, 0)], [0, 5, SIZE])
+  check('bad whence', cache.seek(0, 9), -1)
+
+  // Misses queued by several reads come out merged
+  missed.length = 0
+  const probe = Buffer.alloc(1)
+  cache = new RangeCache(SIZE, { pageSize: PAGE })
+  for (const offset of [3500, 2000, 4999, 9000, 2001]) cache.readAt(offset, probe)
+  check('merged misses', cache.takeMisses(), [{ offset: 2000, length: 3000 }, { offset: 9000, length: PAGE }])
+  check('taken', cache.takeMisses(), [])
+  cache.destroy()
+
+  // A disjoint shorter run does not replace a longer one; adjacent runs merge
+  cache = new RangeCache(SIZE, { pageSize: PAGE })
+  cache.write(100, file.subarray(100, 150))
+  cache.write(20, file.subarray(20, 25))
+  check('longer run kept', [cache.has(100, 50), cache.has(20, 5)], [true, false])
+  cache.write(150, file.subarray(150, 200))
+  cache.write(90, file.subarray(90, 100))
+  check('runs merged', [cache.has(90, 110), cache.stats().bytesCached], [true, 110])
+  cache.destroy()
+
+  // Least recently read pages go first
+  cache = new RangeCache(SIZE, { pageSize: PAGE, capacity: 3 * PAGE })
+  for (let p = 0; p < 5; p++) cache.write(p * PAGE, file.subarray(p * PAGE, (p + 1) * PAGE))
+  let stats = cache.stats()
+  check('evicted', [stats.pages, stats.evictions, stats.bytesCached], [3, 2, 3 * PAGE])
+  cache.readAt(2 * PAGE, probe)
+  cache.write(5 * PAGE, file.subarray(5 * PAGE, 6 * PAGE))
+  check('lru', [cache.has(2 * PAGE, PAGE), cache.has(3 * PAGE, 1), cache.has(4 * PAGE, 2 * PAGE)], [true, false, true])
+
+  stats = cache.stats()
+  check('stats', [stats.hits, stats.misses, stats.hitRate], [1, 0, 1])
+
+  cache.destroy()
+  let threw = false
+  try { cache.read(buffer) } catch { threw = true }
+  check('destroyed cache throws', threw, true)
+
+  console.log('all tests passed')
+}
+
+main().catch((err) => {
+  console.error(err)
+  Bare.exit(1)
+})
@@ -0,0 +1,441 @@
+/**
+ * Benchmark for bare-vector-index at dim 384.
+ *
+ *   bare bench.js [flat|hnsw|quant|persist|batch|filter|recommend|merge] [sizes...]
+ *
+ * flat: native SIMD scan vs the backend's JS Map + sort scan
+ *       (default sizes 10000 100000 1000000; JS baseline skipped above 100k,
+ *       where it needs ~1.5GB of boxed Float32Arrays and seconds per query)
+ * hnsw: build time, memory, recall@10 and latency vs the exact scan for a
+ *       few ef values (default sizes 10000 100000)
+ * quant: bytes/vector, recall@10 against the float scan and QPS for each
+ *       storage mode, with and without re-ranking (default sizes 10000 100000)
+ * persist: save and load time of the binary index file vs the JSON +
+ *       base64 blob the backend used to keep in metaDb (default 10000 100000)
+ * batch: searchBatch() throughput vs one search() per query, for the flat
+ *       scan and the HNSW graph (default sizes 10000 100000)
+ * filter: in-index exclusion of a watch history vs over-fetching 2x and
+ *       filtering in JS (latency and how often the JS way comes up short),
+ *       and hybrid vector + BM25 search vs vector only (default 10000 100000)
+ * recommend: CandidateTable.rank() plus one incremental watch update vs the
+ *       recommender's old per-request JS pipeline (filter with includes,
+ *       dedupe with find, full sort), with stats already in memory; the JS
+ *       baseline is quadratic and skipped above 10k (default 10000 100000)
+ * merge: ResultMerger over packed (hash, score) responses of 100 results
+ *       each vs the old JS merge of result objects; sizes are peer counts
+ *       (default 10 50 200)
+ *
+ * Vectors are drawn around random cluster centres so neighbourhoods look
+ * more like real embeddings than uniform noise does.
+ */
+
+const fs = require('bare-fs')
+const { VectorIndex, HnswIndex, CandidateTable, ResultMerger, simdKernel } = require('./index')
+
+const DIMENSION = 384
+const TOP_K = 10
+const JS_BASELINE_MAX = 100000
+const QUERIES = 64
+const RECOMMEND_JS_MAX = 10000
+
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000 - 0.5
+  }
+}
+
+function dataset(size, seed) {
+  const next = rng(seed)
+  const centres = Array.from({ length: Math.max(16, Math.floor(size / 100)) }, () => {
+    const c = new Float32Array(DIMENSION)
+    for (let i = 0; i < DIMENSION; i++) c[i] = next()
+    return c
+  })
+
+  return () => {
+    const c = centres[Math.floor((next() + 0.5) * centres.length) % centres.length]
+    const v = new Float32Array(DIMENSION)
+    for (let i = 0; i < DIMENSION; i++) v[i] = c[i] + next() * 0.8
+    return v
+  }
+}
+
+// The pre-native implementation, verbatim in behaviour
+function jsSearch(vectors, query, topK) {
+  const results = []
+  for (const [id, vector] of vectors) {
+    let dot = 0
+    let na = 0
+    let nb = 0
+    for (let i = 0; i < query.length; i++) {
+      dot += query[i] * vector[i]
+      na += query[i] * query[i]
+      nb += vector[i] * vector[i]
+    }
+    const d = Math.sqrt(na) * Math.sqrt(nb)
+    results.push({ id, score: d === 0 ? 0 : dot / d })
+  }
+  results.sort((a, b) => b.score - a.score)
+  return results.slice(0, topK)
+}
+
+function time(fn, iterations) {
+  const start = Date.now()
+  for (let i = 0; i < iterations; i++) fn(i)
+  return (Date.now() - start) / iterations
+}
+
+function benchFlat(size) {
+  const next = dataset(size, size)
+  const index = new VectorIndex({ dimension: DIMENSION })
+  const js = size <= JS_BASELINE_MAX ? new Map() : null
+
+  index.reserve(size)
+  const addStart = Date.now()
+  for (let i = 0; i < size; i++) {
+    const v = next()
+    index.add('v' + i, v)
+    if (js) js.set('v' + i, v)
+  }
+  const addMs = Date.now() - addStart
+
+  const queries = Array.from({ length: 16 }, next)
+  const iterations = size >= 1000000 ? 16 : size >= 100000 ? 64 : 256
+
+  const nativeMs = time((i) => index.search(queries[i % queries.length], TOP_K), iterations)
+  const line = [
+    `n=${size}`,
+    `build ${addMs}ms`,
+    `native ${nativeMs.toFixed(3)}ms/query (${Math.round(1000 / nativeMs)} qps)`
+  ]
+
+  if (js) {
+    const jsMs = time((i) => jsSearch(js, queries[i % queries.length], TOP_K), Math.max(4, iterations >> 4))
+    const same = index.search(queries[0], TOP_K).map((r) => r.id).join() === jsSearch(js, queries[0], TOP_K).map((r) => r.id).join()
+    line.push(`js ${jsMs.toFixed(3)}ms/query`, `speedup ${(jsMs / nativeMs).toFixed(1)}x`, same ? 'results match' : 'RESULTS DIFFER')
+  }
+
+  console.log(line.join(' | '))
+  index.destroy()
+}
+
+function benchHnsw(size) {
+  const next = dataset(size, size)
+  const index = new HnswIndex({ dimension: DIMENSION })
+
+  index.reserve(size)
+  const addStart = Date.now()
+  for (let i = 0; i < size; i++) index.add('v' + i, next(), { channelKey: 'c' + (i % 64) })
+  const addMs = Date.now() - addStart
+
+  const queries = Array.from({ length: QUERIES }, next)
+  const exact = queries.map((q) => new Set(index.search(q, TOP_K, { exact: true }).map((r) => r.id)))
+  const exactMs = time((i) => index.search(queries[i % QUERIES], TOP_K, { exact: true }), QUERIES)
+
+  const stats = index.stats()
+  console.log(`n=${size} | build ${addMs}ms (${((addMs * 1000) / size).toFixed(0)}us/insert) | ${(stats.memory / size).toFixed(0)} bytes/vector | exact ${exactMs.toFixed(3)}ms/query`)
+
+  for (const ef of [32, 64, 128, 256]) {
+    let hit = 0
+    const ms = time((i) => {
+      for (const r of index.search(queries[i], TOP_K, { ef })) if (exact[i].has(r.id)) hit++
+    }, QUERIES)
+    console.log(`  ef=${ef} | recall@10 ${(hit / (QUERIES * TOP_K)).toFixed(4)} | ${ms.toFixed(3)}ms/query (${Math.round(1000 / ms)} qps)`)
+  }
+
+  // One channel out of 64: served by the exact member scan or a widened beam
+  const filteredMs = time((i) => index.search(queries[i % QUERIES], TOP_K, { channelKey: 'c7' }), QUERIES)
+  console.log(`  channel filter (1/64) | ${filteredMs.toFixed(3)}ms/query`)
+
+  index.destroy()
+}
+
+function benchQuant(size) {
+  const next = dataset(size, size)
+  const vectors = Array.from({ length: size }, next)
+  const queries = Array.from({ length: QUERIES }, next)
+
+  const exact = new VectorIndex({ dimension: DIMENSION })
+  exact.reserve(size)
+  vectors.forEach((v, i) => exact.add('v' + i, v))
+  const truth = queries.map((q) => new Set(exact.search(q, TOP_K).map((r) => r.id)))
+  exact.destroy()
+
+  console.log(`n=${size}`)
+  const modes = [
+    ['none'],
+    ['int8', 0],
+    ['int8'],
+    ['binary', 0],
+    ['binary'],
+    ['binary', 30]
+  ]
+
+  for (const [quantization, rerank] of modes) {
+    const index = new VectorIndex({ dimension: DIMENSION, quantization, rerank })
+    index.reserve(size)
+    vectors.forEach((v, i) => index.add('v' + i, v))
+
+    let hit = 0
+    const ms = time((i) => {
+      for (const r of index.search(queries[i], TOP_K)) if (truth[i].has(r.id)) hit++
+    }, QUERIES)
+
+    const label = quantization === 'none' ? 'float32' : `${quantization} rerank=${index.rerank}`
+    console.log(`  ${label.padEnd(18)} | ${index.stats().bytesPerVector} bytes/vector | recall@10 ${(hit / (QUERIES * TOP_K)).toFixed(4)} | ${ms.toFixed(3)}ms/query (${Math.round(1000 / ms)} qps)`)
+    index.destroy()
+  }
+}
+
+function benchPersist(size) {
+  const next = dataset(size, size)
+  const index = new HnswIndex({ dimension: DIMENSION })
+  index.reserve(size)
+  for (let i = 0; i < size; i++) index.add('v' + i, next(), { channelKey: 'c' + (i % 64), title: 'video ' + i })
+
+  const path = __dirname + '/bench-index.bvi'
+  const query = next()
+
+  let start = Date.now()
+  const blob = index.serialize().toString('base64')
+  const jsonSaveMs = Date.now() - start
+
+  start = Date.now()
+  const fromJson = new HnswIndex({ dimension: DIMENSION })
+  fromJson.deserialize(Buffer.from(blob, 'base64'))
+  fromJson.search(query, TOP_K)
+  const jsonLoadMs = Date.now() - start
+  fromJson.destroy()
+
+  start = Date.now()
+  index.save(path)
+  const saveMs = Date.now() - start
+
+  start = Date.now()
+  const opened = HnswIndex.open(path)
+  opened.search(query, TOP_K)
+  const openMs = Date.now() - start
+
+  start = Date.now()
+  opened.verify()
+  const verifyMs = Date.now() - start
+
+  const bytes = fs.statSync(path).size
+  console.log(`n=${size} | json+base64 ${(blob.length / 1e6).toFixed(1)}MB save ${jsonSaveMs}ms load ${jsonLoadMs}ms | binary ${(bytes / 1e6).toFixed(1)}MB save ${saveMs}ms open+first query ${openMs}ms verify ${verifyMs}ms`)
+
+  opened.destroy()
+  index.destroy()
+  fs.unlinkSync(path)
+}
+
+function benchBatch(size) {
+  const next = dataset(size, size)
+  const flat = new VectorIndex({ dimension: DIMENSION })
+  const hnsw = new HnswIndex({ dimension: DIMENSION })
+  flat.reserve(size)
+  hnsw.reserve(size)
+  for (let i = 0; i < size; i++) {
+    const v = next()
+    flat.add('v' + i, v)
+    hnsw.add('v' + i, v)
+  }
+
+  const queries = Array.from({ length: 256 }, next)
+  console.log(`n=${size}`)
+
+  for (const batch of [1, 16, 64, 256]) {
+    const group = queries.slice(0, batch)
+    const iterations = Math.max(1, Math.floor(256 / batch))
+    const singleMs = time(() => group.forEach((q) => flat.search(q, TOP_K)), iterations) / batch
+    const batchMs = time(() => flat.searchBatch(group, TOP_K), iterations) / batch
+    const graphMs = time(() => group.forEach((q) => hnsw.search(q, TOP_K)), iterations) / batch
+    const hnswBatchMs = time(() => hnsw.searchBatch(group, TOP_K), iterations) / batch
+    console.log(`  batch=${String(batch).padEnd(3)} | flat search ${singleMs.toFixed(3)}ms/query searchBatch ${batchMs.toFixed(3)}ms/query (${(singleMs / batchMs).toFixed(1)}x) | hnsw graph ${graphMs.toFixed(3)}ms/query exact searchBatch ${hnswBatchMs.toFixed(3)}ms/query`)
+  }
+
+  flat.destroy()
+  hnsw.destroy()
+}
+
+// Titles drawn from a Zipf-like vocabulary: a few common words, a long tail
+function titleGenerator(seed) {
+  const next = rng(seed)
+  const vocabulary = Array.from({ length: 5000 }, (_, i) => 'w' + i.toString(36))
+  return () => {
+    const words = []
+    const count = 4 + Math.floor((next() + 0.5) * 8)
+    for (let i = 0; i < count; i++) words.push(vocabulary[Math.floor(Math.pow(next() + 0.5, 3) * vocabulary.length)])
+    return words.join(' ')
+  }
+}
+
+function benchFilter(size) {
+  const next = dataset(size, size)
+  const title = titleGenerator(size)
+  const hnsw = new HnswIndex({ dimension: DIMENSION, textKeys: ['title'] })
+  hnsw.reserve(size)
+  for (let i = 0; i < size; i++) hnsw.add('v' + i, next(), { title: title() })
+
+  const queries = Array.from({ length: QUERIES }, next)
+  console.log(`n=${size}`)
+
+  for (const watched of [50, 500]) {
+    // A history concentrated near the queries, as a real one would be
+    const history = queries.map((q) => new Set(hnsw.search(q, watched, { ef: watched * 2 }).map((r) => r.id)))
+
+    let short = 0
+    const postMs = time((i) => {
+      const hits = hnsw.search(queries[i], TOP_K * 2).filter((r) => !history[i].has(r.id)).slice(0, TOP_K)
+      if (hits.length < TOP_K) short++
+    }, QUERIES)
+
+    let nativeShort = 0
+    const nativeMs = time((i) => {
+      if (hnsw.search(queries[i], TOP_K, { exclude: history[i] }).length < TOP_K) nativeShort++
+    }, QUERIES)
+
+    console.log(`  exclude ${String(watched).padEnd(3)} | over-fetch + JS filter ${postMs.toFixed(3)}ms/query, short ${short}/${QUERIES} | in-index ${nativeMs.toFixed(3)}ms/query, short ${nativeShort}/${QUERIES}`)
+  }
+
+  const texts = queries.map(() => title().split(' ').slice(0, 2).join(' '))
+  const vectorMs = time((i) => hnsw.search(queries[i], TOP_K), QUERIES)
+  const hybridMs = time((i) => hnsw.search(queries[i], TOP_K, { text: texts[i] }), QUERIES)
+  console.log(`  hybrid | vector only ${vectorMs.toFixed(3)}ms/query | vector + BM25 ${hybridMs.toFixed(3)}ms/query`)
+
+  hnsw.destroy()
+}
+
+// The recommender's pipeline before CandidateTable, minus the per-video
+// view scans it also made for watch stats
+function legacyRecommend(videos, stats, similar, watched, excluded, limit) {
+  const candidates = videos.filter((v) => !watched.has(v.id) && !excluded.includes(v.id))
+  const recommendations = []
+  for (const [videoId, score] of similar) recommendations.push({ videoId, score: score * 0.6, reason: 'similar_content' })
+
+  const popular = candidates
+    .map((v) => ({ id: v.id, popularityScore: stats.get(v.id).watches * 0.5 + stats.get(v.id).completionRate * 0.5 }))
+    .sort((a, b) => b.popularityScore - a.popularityScore)
+    .slice(0, limit)
+  for (const video of popular) {
+    if (!recommendations.find((r) => r.videoId === video.id)) recommendations.push({ videoId: video.id, score: video.popularityScore * 0.4, reason: 'popular' })
+  }
+  for (const video of candidates) {
+    if (!recommendations.find((r) => r.videoId === video.id)) recommendations.push({ videoId: video.id, score: 0.2, reason: 'channel_content' })
+  }
+
+  const deduplicated = new Map()
+  for (const rec of recommendations) {
+    const existing = deduplicated.get(rec.videoId)
+    if (!existing || existing.score < rec.score) deduplicated.set(rec.videoId, rec)
+  }
+  return Array.from(deduplicated.values()).sort((a, b) => b.score - a.score).slice(0, limit)
+}
+
+function benchRecommend(size) {
+  const next = rng(size)
+  const now = Date.now()
+  const videos = []
+  const stats = new Map()
+  for (let i = 0; i < size; i++) {
+    const watches = (next() + 0.5) < 0.25 ? Math.floor((next() + 0.5) * 100) : 0
+    videos.push({ id: 'v' + i, uploadedAt: now - Math.floor((next() + 0.5) * 365) * 86400000, channelKey: 'c' + (i % 50) })
+    stats.set('v' + i, { watches, completed: Math.floor(watches * (next() + 0.5)), completionRate: 0 })
+  }
+  for (const s of stats.values()) s.completionRate = s.watches > 0 ? s.completed / s.watches : 0
+  const similar = new Map(Array.from({ length: 150 }, () => ['v' + Math.floor((next() + 0.5) * size), next() + 0.5]))
+  const watched = new Set(Array.from({ length: 50 }, () => 'v' + Math.floor((next() + 0.5) * size)))
+  const excluded = Array.from({ length: 20 }, () => 'v' + Math.floor((next() + 0.5) * size))
+
+  let start = Date.now()
+  const table = new CandidateTable()
+  for (const video of videos) {
+    table.set(video.id, { createdAt: video.uploadedAt, channelKey: video.channelKey })
+    const s = stats.get(video.id)
+    if (s.watches > 0) table.watch(video.id, s.watches, s.completed)
+  }
+  table.setSimilarity(similar)
+  table.setAffinity([['c0', 0.5], ['c1', 0.5]])
+  const buildMs = Date.now() - start
+
+  const exclude = [...watched, ...excluded]
+  const nativeMs = time((i) => {
+    table.watch(videos[i].id, 1, 1)
+    table.rank(TOP_K, { exclude, now })
+  }, QUERIES)
+
+  let line = `n=${size} | table build ${buildMs}ms, ${(table.stats().memory / 1048576).toFixed(1)}MB | rank + update ${nativeMs.toFixed(3)}ms/request`
+  if (size <= RECOMMEND_JS_MAX) {
+    const jsMs = time(() => legacyRecommend(videos, stats, similar, watched, excluded, TOP_K), 4)
+    line += ` | JS pipeline ${jsMs.toFixed(1)}ms/request`
+  }
+  console.log(line)
+
+  table.destroy()
+}
+
+// FederatedSearch._mergeResults before the native merge: a Map of every
+// result, scores of duplicates averaged pairwise, full sort
+function legacyMerge(localResults, peerResults, topK) {
+  const merged = new Map()
+  for (const result of localResults) merged.set(result.id, { ...result })
+  for (const peerResultSet of peerResults) {
+    for (const result of peerResultSet) {
+      const existing = merged.get(result.id)
+      if (existing) existing.score = (existing.score + result.score) / 2
+      else merged.set(result.id, { ...result })
+    }
+  }
+  return Array.from(merged.values()).sort((a, b) => b.score - a.score).slice(0, topK)
+}
+
+function benchMerge(peers) {
+  const next = rng(peers)
+  const catalogue = Math.max(1000, peers * 20)
+  const lists = Array.from({ length: peers + 1 }, () => {
+    const results = Array.from({ length: 100 }, () => {
+      const n = Math.floor((next() + 0.5) * catalogue)
+      return { id: n.toString(16).padStart(64, '0'), n, score: next() + 0.5, metadata: null }
+    })
+    return results.sort((a, b) => b.score - a.score)
+  })
+  // What arrives on the wire: id hashes and scores per response
+  const packed = lists.map((results) => ({
+    hashes: Uint32Array.from(results.flatMap((r) => [r.n, 0])),
+    scores: Float32Array.from(results.map((r) => r.score))
+  }))
+
+  const merger = new ResultMerger()
+  const nativeMs = time(() => {
+    merger.clear()
+    for (const p of packed) merger.add(p.hashes, p.scores, TOP_K * 10)
+    merger.merge(TOP_K)
+  }, QUERIES)
+  const jsMs = time(() => legacyMerge(lists[0], lists.slice(1), TOP_K), QUERIES)
+
+  console.log(`peers=${peers} x 100 results | native merge ${nativeMs.toFixed(3)}ms | JS merge ${jsMs.toFixed(3)}ms`)
+  merger.destroy()
+}
+
+const args = (typeof Bare !== 'undefined' ? Bare.argv : process.argv).slice(2)
+const mode = ['flat', 'hnsw', 'quant', 'persist', 'batch', 'filter', 'recommend', 'merge'].includes(args[0]) ? args.shift() : 'flat'
+const sizes = args.map(Number).filter((n) => n > 0)
+
+console.log(`bare-vector-index bench: mode=${mode} dim=${DIMENSION} k=${TOP_K} kernel=${simdKernel()}`)
+if (mode === 'hnsw') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchHnsw(size)
+} else if (mode === 'persist') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchPersist(size)
+} else if (mode === 'batch') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchBatch(size)
+} else if (mode === 'filter') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchFilter(size)
+} else if (mode === 'recommend') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchRecommend(size)
+} else if (mode === 'merge') {
+  for (const peers of sizes.length > 0 ? sizes : [10, 50, 200]) benchMerge(peers)
+} else if (mode === 'quant') {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000]) benchQuant(size)
+} else {
+  for (const size of sizes.length > 0 ? sizes : [10000, 100000, 1000000]) benchFlat(size)
+}
@@ -0,0 +1,2277 @@
+/**
+ * bare-vector-index - Bare native addon for embedding similarity search
+ * Contiguous, pre-normalised float matrix scanned with SIMD dot products
+ * HNSW graph for large collections; BM25 text index for hybrid search
+ * Columnar candidate table for recommendation ranking
+ * K-way merge of ranked result lists (federated search)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bare.h>
+#include <js.h>
+
+#include "src/base64.h"
+#include "src/candidate_table.h"
+#include "src/delta_log.h"
+#include "src/flat_index.h"
+#include "src/hnsw.h"
+#include "src/result_merger.h"
+#include "src/simd.h"
+#include "src/slot_set.h"
+#include "src/text_index.h"
+#include "src/thread_pool.h"
+
+using bare_vector_index::CandidateTable;
+using bare_vector_index::DeltaLog;
+using bare_vector_index::FlatIndex;
+using bare_vector_index::HnswIndex;
+using bare_vector_index::ResultMerger;
+using bare_vector_index::SlotSet;
+using bare_vector_index::StringTable;
+using bare_vector_index::TextIndex;
+using bare_vector_index::TopK;
+using bare_vector_index::ThreadPool;
+using bare_vector_index::candidate_weights_t;
+using bare_vector_index::hit_t;
+using bare_vector_index::hnsw_params_t;
+using bare_vector_index::merged_t;
+
+// Handle wrapper for FlatIndex
+typedef struct {
+  FlatIndex *index;
+} bare_vector_index_flat_t;
+
+// Handle wrapper for HnswIndex
+typedef struct {
+  HnswIndex *index;
+} bare_vector_index_hnsw_t;
+
+// Handle wrapper for DeltaLog
+typedef struct {
+  DeltaLog *log;
+} bare_vector_index_log_t;
+
+// Handle wrapper for TextIndex
+typedef struct {
+  TextIndex *index;
+} bare_vector_index_text_t;
+
+// Handle wrapper for CandidateTable
+typedef struct {
+  CandidateTable *table;
+} bare_vector_index_candidates_t;
+
+// Handle wrapper for ResultMerger
+typedef struct {
+  ResultMerger *merger;
+} bare_vector_index_merger_t;
+
+static bare_vector_index_flat_t *
+bare_vector_index__flat(js_env_t *env, js_value_t *value) {
+  bare_vector_index_flat_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->index) {
+    js_throw_error(env, NULL, "Index has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Read a Float32Array argument holding exactly `dimension` floats
+static float *
+bare_vector_index__vector(js_env_t *env, js_value_t *value, size_t dimension) {
+  js_typedarray_type_t type;
+  float *data;
+  size_t len;
+  int err = js_get_typedarray_info(env, value, &type, (void **) &data, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_float32array || len != dimension) {
+    js_throw_error(env, NULL, "Vector must be a Float32Array matching the index dimension");
+    return NULL;
+  }
+
+  return data;
+}
+
+// Read a typed array argument of `expected` type
+static void *
+bare_vector_index__typed(js_env_t *env, js_value_t *value, js_typedarray_type_t expected, size_t *len, const char *message) {
+  js_typedarray_type_t type;
+  void *data;
+  int err = js_get_typedarray_info(env, value, &type, &data, len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != expected) {
+    js_throw_error(env, NULL, message);
+    return NULL;
+  }
+
+  return data;
+}
+
+// Read the row matrix of a batch: `count` rows of `dimension` floats
+static float *
+bare_vector_index__matrix(js_env_t *env, js_value_t *value, size_t count, size_t dimension) {
+  size_t len;
+  float *data = (float *) bare_vector_index__typed(env, value, js_float32array, &len, "Matrix must be a Float32Array");
+  if (data == NULL) return NULL;
+
+  if (len < count * dimension) {
+    js_throw_error(env, NULL, "Matrix is smaller than count x dimension");
+    return NULL;
+  }
+
+  return data;
+}
+
+// Copy hits into caller-provided slots (Uint32Array) / scores (Float32Array)
+static js_value_t *
+bare_vector_index__hits(js_env_t *env, const std::vector<hit_t> &hits, uint32_t *slots, float *scores) {
+  for (size_t i = 0; i < hits.size(); i++) {
+    slots[i] = hits[i].slot;
+    scores[i] = hits[i].score;
+  }
+
+  js_value_t *result;
+  js_create_uint32(env, uint32_t(hits.size()), &result);
+  return result;
+}
+
+// Read the output arrays for a search; returns k (the shorter length)
+static bool
+bare_vector_index__outputs(js_env_t *env, js_value_t *slots_value, js_value_t *scores_value, uint32_t **slots, float **scores, size_t *k) {
+  size_t slots_len, scores_len;
+  int err = js_get_typedarray_info(env, slots_value, NULL, (void **) slots, &slots_len, NULL, NULL);
+  if (err != 0) return false;
+
+  err = js_get_typedarray_info(env, scores_value, NULL, (void **) scores, &scores_len, NULL, NULL);
+  if (err != 0) return false;
+
+  *k = slots_len < scores_len ? slots_len : scores_len;
+  return true;
+}
+
+// Read the outputs of a batched search: counts (Uint32Array, one per query)
+// and slots / scores holding `k` entries per query
+static bool
+bare_vector_index__batch_outputs(js_env_t *env, js_value_t **argv, size_t k, uint32_t **slots, float **scores, uint32_t **counts, size_t *count) {
+  size_t slots_len, scores_len;
+  *slots = (uint32_t *) bare_vector_index__typed(env, argv[0], js_uint32array, &slots_len, "Slots must be a Uint32Array");
+  if (*slots == NULL) return false;
+
+  *scores = (float *) bare_vector_index__typed(env, argv[1], js_float32array, &scores_len, "Scores must be a Float32Array");
+  if (*scores == NULL) return false;
+
+  *counts = (uint32_t *) bare_vector_index__typed(env, argv[2], js_uint32array, count, "Counts must be a Uint32Array");
+  if (*counts == NULL) return false;
+
+  if (slots_len < *count * k || scores_len < *count * k) {
+    js_throw_error(env, NULL, "Outputs are smaller than queries x k");
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+bare_vector_index__string(js_env_t *env, js_value_t *value, std::string &out) {
+  size_t len;
+  int err = js_get_value_string_utf8(env, value, NULL, 0, &len);
+  if (err != 0) return false;
+
+  out.resize(len + 1);
+  err = js_get_value_string_utf8(env, value, (utf8_t *) &out[0], len + 1, NULL);
+  if (err != 0) return false;
+
+  out.resize(len);
+  return true;
+}
+
+static bare_vector_index_text_t *
+bare_vector_index__text(js_env_t *env, js_value_t *value) {
+  bare_vector_index_text_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->index) {
+    js_throw_error(env, NULL, "Text index has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static bool
+bare_vector_index__absent(js_env_t *env, js_value_t *value) {
+  js_value_type_t type;
+  js_typeof(env, value, &type);
+  return type == js_undefined || type == js_null;
+}
+
+// Read an optional exclusion bitset: a Uint32Array whose bit i excludes
+// slot / label i. null or undefined excludes nothing.
+static bool
+bare_vector_index__exclude(js_env_t *env, js_value_t *value, SlotSet *exclude) {
+  if (bare_vector_index__absent(env, value)) return true;
+
+  js_typedarray_type_t type;
+  uint32_t *words;
+  size_t len;
+  int err = js_get_typedarray_info(env, value, &type, (void **) &words, &len, NULL, NULL);
+  if (err != 0) return false;
+
+  if (type != js_uint32array) {
+    js_throw_error(env, NULL, "Exclude must be a Uint32Array bitset");
+    return false;
+  }
+
+  *exclude = SlotSet(words, len);
+  return true;
+}
+
+// Read the optional hybrid arguments (text index, query text, weight) and
+// score the query text. *hits stays NULL when no text index was passed.
+static bool
+bare_vector_index__text_hits(js_env_t *env, js_value_t **argv, std::vector<hit_t> **hits, double *weight) {
+  if (bare_vector_index__absent(env, argv[0])) return true;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return false;
+
+  std::string query;
+  if (!bare_vector_index__string(env, argv[1], query)) return false;
+
+  int err = js_get_value_double(env, argv[2], weight);
+  if (err != 0) return false;
+
+  if (!(*weight >= 0 && *weight <= 1)) {
+    js_throw_range_error(env, NULL, "Text weight must be between 0 and 1");
+    return false;
+  }
+
+  *hits = &handle->index->score(query.data(), query.size());
+  return true;
+}
+
+static bool
+bare_vector_index__slot(js_env_t *env, js_value_t *value, FlatIndex *index, uint32_t *slot) {
+  int err = js_get_value_uint32(env, value, slot);
+  if (err != 0) return false;
+
+  if (*slot >= index->size()) {
+    js_throw_range_error(env, NULL, "Slot out of range");
+    return false;
+  }
+
+  return true;
+}
+
+// Create index: (dimension, quantization, rerank)
+static js_value_t *
+bare_vector_index_flat_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t dimension;
+  err = js_get_value_uint32(env, argv[0], &dimension);
+  if (err != 0) return NULL;
+
+  uint32_t quantization = bare_vector_index::quant_none;
+  uint32_t rerank = 0;
+  if (argc > 1) {
+    err = js_get_value_uint32(env, argv[1], &quantization);
+    if (err != 0) return NULL;
+  }
+  if (argc > 2) {
+    err = js_get_value_uint32(env, argv[2], &rerank);
+    if (err != 0) return NULL;
+  }
+
+  if (dimension == 0) {
+    js_throw_error(env, NULL, "Dimension must be positive");
+    return NULL;
+  }
+
+  if (quantization > bare_vector_index::quant_binary) {
+    js_throw_error(env, NULL, "Unknown quantization");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_vector_index_flat_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_flat_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->index = new FlatIndex(dimension, bare_vector_index::quantization_t(quantization), rerank);
+  return result;
+}
+
+// Preallocate room for `count` vectors
+static js_value_t *
+bare_vector_index_flat_reserve(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t count;
+  err = js_get_value_uint32(env, argv[1], &count);
+  if (err != 0) return NULL;
+
+  handle->index->reserve(count);
+  return NULL;
+}
+
+// Append a vector, returns its slot
+static js_value_t *
+bare_vector_index_flat_add(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  float *vector = bare_vector_index__vector(env, argv[1], handle->index->dimension());
+  if (vector == NULL) return NULL;
+
+  uint32_t slot = handle->index->add(vector);
+
+  js_value_t *result;
+  js_create_uint32(env, slot, &result);
+  return result;
+}
+
+// Append rows: (handle, matrix, slots) adds slots.length rows of the
+// Float32Array matrix and writes their slots
+static js_value_t *
+bare_vector_index_flat_add_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  size_t count;
+  uint32_t *slots = (uint32_t *) bare_vector_index__typed(env, argv[2], js_uint32array, &count, "Slots must be a Uint32Array");
+  if (slots == NULL) return NULL;
+
+  FlatIndex *index = handle->index;
+  float *matrix = bare_vector_index__matrix(env, argv[1], count, index->dimension());
+  if (matrix == NULL) return NULL;
+
+  index->reserve(index->size() + count);
+  for (size_t i = 0; i < count; i++) slots[i] = index->add(matrix + i * index->dimension());
+
+  return NULL;
+}
+
+// Overwrite the vector at a slot
+static js_value_t *
+bare_vector_index_flat_set(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  if (!bare_vector_index__slot(env, argv[1], handle->index, &slot)) return NULL;
+
+  float *vector = bare_vector_index__vector(env, argv[2], handle->index->dimension());
+  if (vector == NULL) return NULL;
+
+  handle->index->set(slot, vector);
+  return NULL;
+}
+
+// Remove a slot, returns the slot moved into its place or -1
+static js_value_t *
+bare_vector_index_flat_remove(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  if (!bare_vector_index__slot(env, argv[1], handle->index, &slot)) return NULL;
+
+  int64_t moved = handle->index->remove(slot);
+
+  js_value_t *result;
+  js_create_int64(env, moved, &result);
+  return result;
+}
+
+// Copy the stored (normalised, dequantised when codes-only) vector at a slot
+// into a Float32Array
+static js_value_t *
+bare_vector_index_flat_get(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  if (!bare_vector_index__slot(env, argv[1], handle->index, &slot)) return NULL;
+
+  float *out = bare_vector_index__vector(env, argv[2], handle->index->dimension());
+  if (out == NULL) return NULL;
+
+  handle->index->get(slot, out);
+  return NULL;
+}
+
+// Search: (handle, query, slots, scores, exclude, text, textQuery, weight)
+// fills slots (Uint32Array) and scores (Float32Array), returns hit count.
+// exclude is an optional bitset over slots; with a text index the scan is
+// fused with the BM25 scores of textQuery (weight = text share).
+static js_value_t *
+bare_vector_index_flat_search(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 8;
+  js_value_t *argv[8];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  float *query = bare_vector_index__vector(env, argv[1], handle->index->dimension());
+  if (query == NULL) return NULL;
+
+  uint32_t *slots;
+  float *scores;
+  size_t k;
+  if (!bare_vector_index__outputs(env, argv[2], argv[3], &slots, &scores, &k)) return NULL;
+
+  SlotSet exclude;
+  std::vector<hit_t> *text_hits = NULL;
+  double weight = 0;
+  if (argc > 4 && !bare_vector_index__exclude(env, argv[4], &exclude)) return NULL;
+  if (argc > 7 && !bare_vector_index__text_hits(env, argv + 5, &text_hits, &weight)) return NULL;
+
+  FlatIndex *index = handle->index;
+  const auto &hits = text_hits ? index->search_hybrid(query, k, exclude, *text_hits, float(weight)) : index->search(query, k, exclude);
+  return bare_vector_index__hits(env, hits, slots, scores);
+}
+
+// Search many queries at once on the worker pool: (handle, queries, k,
+// slots, scores, counts, exclude). Results packed k per query into slots /
+// scores, hit counts into counts; exclude applies to every query.
+static js_value_t *
+bare_vector_index_flat_search_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 7;
+  js_value_t *argv[7];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t k;
+  err = js_get_value_uint32(env, argv[2], &k);
+  if (err != 0) return NULL;
+
+  uint32_t *slots, *counts;
+  float *scores;
+  size_t count;
+  if (!bare_vector_index__batch_outputs(env, argv + 3, k, &slots, &scores, &counts, &count)) return NULL;
+
+  FlatIndex *index = handle->index;
+  float *queries = bare_vector_index__matrix(env, argv[1], count, index->dimension());
+  if (queries == NULL) return NULL;
+
+  SlotSet exclude;
+  if (argc > 6 && !bare_vector_index__exclude(env, argv[6], &exclude)) return NULL;
+
+  index->search_batch(queries, count, k, exclude, ThreadPool::shared(), slots, scores, counts);
+
+  return NULL;
+}
+
+// Number of stored vectors
+static js_value_t *
+bare_vector_index_flat_size(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  js_value_t *result;
+  js_create_uint32(env, uint32_t(handle->index->size()), &result);
+  return result;
+}
+
+// Get stats: { size, bytesPerVector, memory }
+static js_value_t *
+bare_vector_index_flat_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  FlatIndex *index = handle->index;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("size", index->size());
+  SET_NUMBER("bytesPerVector", index->bytes_per_vector());
+  SET_NUMBER("memory", index->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+// Drop all vectors and release the matrix
+static js_value_t *
+bare_vector_index_flat_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle = bare_vector_index__flat(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->index->clear();
+  return NULL;
+}
+
+// Destroy index
+static js_value_t *
+bare_vector_index_flat_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_flat_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->index;
+  handle->index = NULL;
+
+  return NULL;
+}
+
+// Read an array of strings. With `nullable`, null/undefined entries become
+// views with a null data() pointer (HnswIndex::save() passthrough).
+static bool
+bare_vector_index__strings(js_env_t *env, js_value_t *array, bool nullable, std::vector<std::string> &strings, std::vector<std::string_view> &views) {
+  uint32_t len;
+  int err = js_get_array_length(env, array, &len);
+  if (err != 0) return false;
+
+  strings.resize(len);
+  views.resize(len);
+
+  for (uint32_t i = 0; i < len; i++) {
+    js_value_t *elem;
+    err = js_get_element(env, array, i, &elem);
+    if (err != 0) return false;
+
+    js_value_type_t type;
+    js_typeof(env, elem, &type);
+
+    if (nullable && (type == js_null || type == js_undefined)) continue;
+
+    if (!bare_vector_index__string(env, elem, strings[i])) return false;
+    views[i] = strings[i];
+  }
+
+  return true;
+}
+
+static js_value_t *
+bare_vector_index__string_value(js_env_t *env, std::string_view str) {
+  js_value_t *result;
+  js_create_string_utf8(env, (const utf8_t *) str.data(), str.size(), &result);
+  return result;
+}
+
+// Copy a string table of the opened file into a JS array
+static js_value_t *
+bare_vector_index__table(js_env_t *env, const StringTable &table) {
+  js_value_t *array;
+  int err = js_create_array_with_length(env, table.size(), &array);
+  if (err != 0) return NULL;
+
+  for (uint32_t i = 0; i < table.size(); i++) {
+    js_set_element(env, array, i, bare_vector_index__string_value(env, table.get(i)));
+  }
+
+  return array;
+}
+
+static bare_vector_index_hnsw_t *
+bare_vector_index__hnsw(js_env_t *env, js_value_t *value) {
+  bare_vector_index_hnsw_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->index) {
+    js_throw_error(env, NULL, "Index has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static bool
+bare_vector_index__label(js_env_t *env, js_value_t *value, HnswIndex *index, uint32_t *label) {
+  int err = js_get_value_uint32(env, value, label);
+  if (err != 0) return false;
+
+  if (!index->live(*label)) {
+    js_throw_range_error(env, NULL, "Label is not live");
+    return false;
+  }
+
+  return true;
+}
+
+// Create HNSW index: (dimension, m, efConstruction, efSearch, seed)
+static js_value_t *
+bare_vector_index_hnsw_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t dimension;
+  hnsw_params_t params;
+  err = js_get_value_uint32(env, argv[0], &dimension);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[1], &params.m);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[2], &params.ef_construction);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[3], &params.ef_search);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[4], &params.seed);
+  if (err != 0) return NULL;
+
+  if (dimension == 0 || params.m < 2 || params.ef_construction == 0 || params.ef_search == 0) {
+    js_throw_error(env, NULL, "Invalid HNSW parameters");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_vector_index_hnsw_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_hnsw_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->index = new HnswIndex(dimension, params);
+  return result;
+}
+
+// Preallocate room for `count` nodes
+static js_value_t *
+bare_vector_index_hnsw_reserve(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t count;
+  err = js_get_value_uint32(env, argv[1], &count);
+  if (err != 0) return NULL;
+
+  handle->index->reserve(count);
+  return NULL;
+}
+
+// Insert a vector with a tag, returns its label
+static js_value_t *
+bare_vector_index_hnsw_add(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  float *vector = bare_vector_index__vector(env, argv[1], handle->index->dimension());
+  if (vector == NULL) return NULL;
+
+  uint32_t tag;
+  err = js_get_value_uint32(env, argv[2], &tag);
+  if (err != 0) return NULL;
+
+  uint32_t label = handle->index->add(vector, tag);
+
+  js_value_t *result;
+  js_create_uint32(env, label, &result);
+  return result;
+}
+
+// Insert rows: (handle, matrix, tags, labels) inserts tags.length rows of
+// the Float32Array matrix with their tags and writes their labels
+static js_value_t *
+bare_vector_index_hnsw_add_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  size_t count, labels_len;
+  uint32_t *tags = (uint32_t *) bare_vector_index__typed(env, argv[2], js_uint32array, &count, "Tags must be a Uint32Array");
+  if (tags == NULL) return NULL;
+
+  uint32_t *labels = (uint32_t *) bare_vector_index__typed(env, argv[3], js_uint32array, &labels_len, "Labels must be a Uint32Array");
+  if (labels == NULL) return NULL;
+
+  if (labels_len < count) {
+    js_throw_error(env, NULL, "Labels is shorter than tags");
+    return NULL;
+  }
+
+  HnswIndex *index = handle->index;
+  float *matrix = bare_vector_index__matrix(env, argv[1], count, index->dimension());
+  if (matrix == NULL) return NULL;
+
+  index->reserve(index->slots() + count);
+  for (size_t i = 0; i < count; i++) labels[i] = index->add(matrix + i * index->dimension(), tags[i]);
+
+  return NULL;
+}
+
+// Tombstone a label
+static js_value_t *
+bare_vector_index_hnsw_remove(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t label;
+  err = js_get_value_uint32(env, argv[1], &label);
+  if (err != 0) return NULL;
+
+  js_value_t *result;
+  js_get_boolean(env, handle->index->remove(label), &result);
+  return result;
+}
+
+// Repair up to `budget` nodes, returns outstanding tombstones
+static js_value_t *
+bare_vector_index_hnsw_repair(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t budget;
+  err = js_get_value_uint32(env, argv[1], &budget);
+  if (err != 0) return NULL;
+
+  js_value_t *result;
+  js_create_uint32(env, uint32_t(handle->index->repair(budget)), &result);
+  return result;
+}
+
+// Copy the stored (normalised) vector for a label into a Float32Array
+static js_value_t *
+bare_vector_index_hnsw_get(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t label;
+  if (!bare_vector_index__label(env, argv[1], handle->index, &label)) return NULL;
+
+  float *out = bare_vector_index__vector(env, argv[2], handle->index->dimension());
+  if (out == NULL) return NULL;
+
+  handle->index->get(label, out);
+  return NULL;
+}
+
+// Search: (handle, query, ef, tag, labels, scores, exclude, text,
+// textQuery, weight) -> hit count. ef 0 uses the index default, 0xffffffff
+// forces an exact scan; tag -1 searches every channel. exclude and the
+// hybrid arguments are optional, as for flatSearch.
+static js_value_t *
+bare_vector_index_hnsw_search(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 10;
+  js_value_t *argv[10];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  float *query = bare_vector_index__vector(env, argv[1], handle->index->dimension());
+  if (query == NULL) return NULL;
+
+  uint32_t ef;
+  err = js_get_value_uint32(env, argv[2], &ef);
+  if (err != 0) return NULL;
+
+  int64_t tag;
+  err = js_get_value_int64(env, argv[3], &tag);
+  if (err != 0) return NULL;
+
+  uint32_t *labels;
+  float *scores;
+  size_t k;
+  if (!bare_vector_index__outputs(env, argv[4], argv[5], &labels, &scores, &k)) return NULL;
+
+  SlotSet exclude;
+  std::vector<hit_t> *text_hits = NULL;
+  double weight = 0;
+  if (argc > 6 && !bare_vector_index__exclude(env, argv[6], &exclude)) return NULL;
+  if (argc > 9 && !bare_vector_index__text_hits(env, argv + 7, &text_hits, &weight)) return NULL;
+
+  HnswIndex *index = handle->index;
+  if (text_hits) return bare_vector_index__hits(env, index->search_hybrid(query, k, ef, tag, exclude, *text_hits, float(weight)), labels, scores);
+
+  const auto &hits = ef == UINT32_MAX ? index->search_exact(query, k, tag, exclude) : index->search(query, k, ef, tag, exclude);
+  return bare_vector_index__hits(env, hits, labels, scores);
+}
+
+// Exact search of many queries at once on the worker pool, optionally
+// restricted to a tag: (handle, queries, k, tag, labels, scores, counts,
+// exclude); outputs as for flatSearchBatch
+static js_value_t *
+bare_vector_index_hnsw_search_batch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 8;
+  js_value_t *argv[8];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t k;
+  err = js_get_value_uint32(env, argv[2], &k);
+  if (err != 0) return NULL;
+
+  int64_t tag;
+  err = js_get_value_int64(env, argv[3], &tag);
+  if (err != 0) return NULL;
+
+  uint32_t *labels, *counts;
+  float *scores;
+  size_t count;
+  if (!bare_vector_index__batch_outputs(env, argv + 4, k, &labels, &scores, &counts, &count)) return NULL;
+
+  HnswIndex *index = handle->index;
+  float *queries = bare_vector_index__matrix(env, argv[1], count, index->dimension());
+  if (queries == NULL) return NULL;
+
+  SlotSet exclude;
+  if (argc > 7 && !bare_vector_index__exclude(env, argv[7], &exclude)) return NULL;
+
+  index->search_batch(queries, count, k, tag, exclude, ThreadPool::shared(), labels, scores, counts);
+
+  return NULL;
+}
+
+// Get stats: { dimension, size, tombstones, slots, memory, mapped }
+static js_value_t *
+bare_vector_index_hnsw_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  HnswIndex *index = handle->index;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("dimension", index->dimension());
+  SET_NUMBER("size", index->size());
+  SET_NUMBER("tombstones", index->tombstones());
+  SET_NUMBER("slots", index->slots());
+  SET_NUMBER("memory", index->memory_usage());
+  SET_NUMBER("mapped", index->mapped_bytes());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+// Write the index to a file: (handle, path, ids, metas, tags). A null meta
+// entry is copied from the file the index was opened from.
+static js_value_t *
+bare_vector_index_hnsw_save(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string path;
+  if (!bare_vector_index__string(env, argv[1], path)) return NULL;
+
+  std::vector<std::string> ids, metas, tags;
+  std::vector<std::string_view> id_views, meta_views, tag_views;
+  if (!bare_vector_index__strings(env, argv[2], false, ids, id_views)) return NULL;
+  if (!bare_vector_index__strings(env, argv[3], true, metas, meta_views)) return NULL;
+  if (!bare_vector_index__strings(env, argv[4], false, tags, tag_views)) return NULL;
+
+  std::string error;
+  if (!handle->index->save(path.c_str(), id_views, meta_views, tag_views, error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Map an index file written by hnswSave, returns a new handle
+static js_value_t *
+bare_vector_index_hnsw_open(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  std::string path;
+  if (!bare_vector_index__string(env, argv[0], path)) return NULL;
+
+  std::string error;
+  std::unique_ptr<HnswIndex> index = HnswIndex::open(path.c_str(), error);
+  if (!index) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_vector_index_hnsw_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_hnsw_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->index = index.release();
+  return result;
+}
+
+// Ids stored in the opened file, indexed by label ('' for free slots)
+static js_value_t *
+bare_vector_index_hnsw_file_ids(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  return bare_vector_index__table(env, handle->index->file_ids());
+}
+
+// Tag names stored in the opened file, indexed by tag
+static js_value_t *
+bare_vector_index_hnsw_file_tags(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  return bare_vector_index__table(env, handle->index->file_tags());
+}
+
+// Metadata string stored in the opened file for a label, or null
+static js_value_t *
+bare_vector_index_hnsw_file_meta(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t label;
+  err = js_get_value_uint32(env, argv[1], &label);
+  if (err != 0) return NULL;
+
+  const StringTable &meta = handle->index->file_meta();
+
+  js_value_t *result;
+  if (label >= meta.size() || meta.get(label).empty()) {
+    js_get_null(env, &result);
+    return result;
+  }
+
+  return bare_vector_index__string_value(env, meta.get(label));
+}
+
+// Check the section checksums of the opened file, throws on mismatch
+static js_value_t *
+bare_vector_index_hnsw_verify(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string error;
+  if (!handle->index->verify(error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Drop all nodes
+static js_value_t *
+bare_vector_index_hnsw_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle = bare_vector_index__hnsw(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->index->clear();
+  return NULL;
+}
+
+// Destroy HNSW index
+static js_value_t *
+bare_vector_index_hnsw_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_hnsw_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->index;
+  handle->index = NULL;
+
+  return NULL;
+}
+
+// Create a BM25 text index (slots / labels shared with a vector index)
+static js_value_t *
+bare_vector_index_text_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+
+  js_value_t *result;
+  bare_vector_index_text_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_text_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->index = new TextIndex();
+  return result;
+}
+
+// Index a text under a slot: (handle, slot, text), replacing what was there
+static js_value_t *
+bare_vector_index_text_set(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  err = js_get_value_uint32(env, argv[1], &slot);
+  if (err != 0) return NULL;
+
+  std::string text;
+  if (!bare_vector_index__string(env, argv[2], text)) return NULL;
+
+  handle->index->set(slot, text.data(), text.size());
+  return NULL;
+}
+
+// Drop the text of a slot
+static js_value_t *
+bare_vector_index_text_remove(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  err = js_get_value_uint32(env, argv[1], &slot);
+  if (err != 0) return NULL;
+
+  handle->index->remove(slot);
+  return NULL;
+}
+
+// Re-key a text after flatRemove() moved a row: (handle, to, from)
+static js_value_t *
+bare_vector_index_text_move(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t to, from;
+  err = js_get_value_uint32(env, argv[1], &to);
+  if (err != 0) return NULL;
+
+  err = js_get_value_uint32(env, argv[2], &from);
+  if (err != 0) return NULL;
+
+  handle->index->move(to, from);
+  return NULL;
+}
+
+// Keyword-only search: (handle, query, slots, scores) -> hit count, best
+// BM25 score first
+static js_value_t *
+bare_vector_index_text_search(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string query;
+  if (!bare_vector_index__string(env, argv[1], query)) return NULL;
+
+  uint32_t *slots;
+  float *scores;
+  size_t k;
+  if (!bare_vector_index__outputs(env, argv[2], argv[3], &slots, &scores, &k)) return NULL;
+
+  TopK topk;
+  topk.reset(k);
+  for (const hit_t &h : handle->index->score(query.data(), query.size())) topk.push(h.score, h.slot);
+
+  return bare_vector_index__hits(env, topk.finish(), slots, scores);
+}
+
+// Get stats: { documents, terms, memory }
+static js_value_t *
+bare_vector_index_text_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  TextIndex *index = handle->index;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("documents", index->size());
+  SET_NUMBER("terms", index->terms());
+  SET_NUMBER("memory", index->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+// Drop all texts
+static js_value_t *
+bare_vector_index_text_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle = bare_vector_index__text(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->index->clear();
+  return NULL;
+}
+
+// Destroy text index
+static js_value_t *
+bare_vector_index_text_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_text_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->index;
+  handle->index = NULL;
+
+  return NULL;
+}
+
+static bare_vector_index_candidates_t *
+bare_vector_index__candidates(js_env_t *env, js_value_t *value) {
+  bare_vector_index_candidates_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->table) {
+    js_throw_error(env, NULL, "Candidate table has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Read a (Uint32Array keys, Float32Array values) column pair
+static bool
+bare_vector_index__column(js_env_t *env, js_value_t *keys_value, js_value_t *values_value, uint32_t **keys, float **values, size_t *count) {
+  js_typedarray_type_t keys_type, values_type;
+  size_t keys_len, values_len;
+  int err = js_get_typedarray_info(env, keys_value, &keys_type, (void **) keys, &keys_len, NULL, NULL);
+  if (err != 0) return false;
+
+  err = js_get_typedarray_info(env, values_value, &values_type, (void **) values, &values_len, NULL, NULL);
+  if (err != 0) return false;
+
+  if (keys_type != js_uint32array || values_type != js_float32array || keys_len != values_len) {
+    js_throw_error(env, NULL, "Expected a Uint32Array and a Float32Array of the same length");
+    return false;
+  }
+
+  *count = keys_len;
+  return true;
+}
+
+static js_value_t *
+bare_vector_index_candidates_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 6;
+  js_value_t *argv[6];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  double values[6];
+  for (size_t i = 0; i < 6; i++) {
+    err = js_get_value_double(env, argv[i], &values[i]);
+    if (err != 0) return NULL;
+    if (!(values[i] >= 0)) {
+      js_throw_error(env, NULL, "Invalid candidate weights");
+      return NULL;
+    }
+  }
+
+  candidate_weights_t weights;
+  weights.similarity = float(values[0]);
+  weights.popularity = float(values[1]);
+  weights.recency = float(values[2]);
+  weights.affinity = float(values[3]);
+  weights.popularity_half = float(values[4]);
+  weights.recency_half_life = values[5];
+
+  if (weights.popularity_half <= 0 || weights.recency_half_life <= 0) {
+    js_throw_error(env, NULL, "Invalid candidate weights");
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_vector_index_candidates_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_candidates_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->table = new CandidateTable(weights);
+  return result;
+}
+
+static js_value_t *
+bare_vector_index_candidates_set(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot, channel;
+  double created;
+  err = js_get_value_uint32(env, argv[1], &slot);
+  if (err != 0) return NULL;
+  err = js_get_value_double(env, argv[2], &created);
+  if (err != 0) return NULL;
+  err = js_get_value_uint32(env, argv[3], &channel);
+  if (err != 0) return NULL;
+
+  handle->table->set(slot, std::isfinite(created) ? created : 0, channel);
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_remove(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  err = js_get_value_uint32(env, argv[1], &slot);
+  if (err != 0) return NULL;
+
+  handle->table->remove(slot);
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_watch(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t slot;
+  double count, completed;
+  err = js_get_value_uint32(env, argv[1], &slot);
+  if (err != 0) return NULL;
+  err = js_get_value_double(env, argv[2], &count);
+  if (err != 0) return NULL;
+  err = js_get_value_double(env, argv[3], &completed);
+  if (err != 0) return NULL;
+
+  handle->table->watch(slot, float(count), float(completed));
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_similarity(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t *slots;
+  float *scores;
+  size_t count;
+  if (!bare_vector_index__column(env, argv[1], argv[2], &slots, &scores, &count)) return NULL;
+
+  handle->table->set_similarity(slots, scores, count);
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_affinity(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 3;
+  js_value_t *argv[3];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t *channels;
+  float *shares;
+  size_t count;
+  if (!bare_vector_index__column(env, argv[1], argv[2], &channels, &shares, &count)) return NULL;
+
+  handle->table->set_affinity(channels, shares, count);
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_rank(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 6;
+  js_value_t *argv[6];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  double now;
+  err = js_get_value_double(env, argv[1], &now);
+  if (err != 0) return NULL;
+
+  uint32_t *slots;
+  float *scores;
+  size_t k;
+  if (!bare_vector_index__outputs(env, argv[2], argv[3], &slots, &scores, &k)) return NULL;
+
+  js_typedarray_type_t type;
+  uint8_t *reasons;
+  size_t reasons_len;
+  err = js_get_typedarray_info(env, argv[4], &type, (void **) &reasons, &reasons_len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_uint8array || reasons_len < k) {
+    js_throw_error(env, NULL, "Reasons must be a Uint8Array of the output length");
+    return NULL;
+  }
+
+  SlotSet exclude;
+  if (!bare_vector_index__exclude(env, argv[5], &exclude)) return NULL;
+
+  CandidateTable *table = handle->table;
+  std::vector<hit_t> &hits = table->rank(k, now, exclude);
+  for (size_t i = 0; i < hits.size(); i++) reasons[i] = table->reason(hits[i].slot, now);
+
+  return bare_vector_index__hits(env, hits, slots, scores);
+}
+
+static js_value_t *
+bare_vector_index_candidates_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  CandidateTable *table = handle->table;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("size", table->size());
+  SET_NUMBER("slots", table->slots());
+  SET_NUMBER("memory", table->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_vector_index_candidates_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle = bare_vector_index__candidates(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->table->clear();
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_candidates_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_candidates_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->table;
+  handle->table = NULL;
+
+  return NULL;
+}
+
+static bare_vector_index_merger_t *
+bare_vector_index__merger(js_env_t *env, js_value_t *value) {
+  bare_vector_index_merger_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->merger) {
+    js_throw_error(env, NULL, "Result merger has been destroyed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+static js_value_t *
+bare_vector_index_merger_create(js_env_t *env, js_callback_info_t *info) {
+  int err;
+
+  js_value_t *result;
+  bare_vector_index_merger_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_merger_t), (void **) &handle, &result);
+  if (err != 0) return NULL;
+
+  handle->merger = new ResultMerger();
+  return result;
+}
+
+// Add a source: (handle, hashes, scores, limit) -> source index. Hashes are
+// a Uint32Array of (low, high) word pairs, one pair per score.
+static js_value_t *
+bare_vector_index_merger_add(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_merger_t *handle = bare_vector_index__merger(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  size_t words_len, count;
+  uint32_t *words = (uint32_t *) bare_vector_index__typed(env, argv[1], js_uint32array, &words_len, "Hashes must be a Uint32Array");
+  if (words == NULL) return NULL;
+
+  float *scores = (float *) bare_vector_index__typed(env, argv[2], js_float32array, &count, "Scores must be a Float32Array");
+  if (scores == NULL) return NULL;
+
+  if (words_len != count * 2) {
+    js_throw_error(env, NULL, "Expected two hash words per score");
+    return NULL;
+  }
+
+  uint32_t limit;
+  err = js_get_value_uint32(env, argv[3], &limit);
+  if (err != 0) return NULL;
+
+  std::vector<uint64_t> hashes(count);
+  for (size_t i = 0; i < count; i++) hashes[i] = uint64_t(words[i * 2]) | uint64_t(words[i * 2 + 1]) << 32;
+
+  uint32_t source = handle->merger->add(hashes.data(), scores, count, limit);
+
+  js_value_t *result;
+  err = js_create_uint32(env, source, &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+// Merge: (handle, sources, positions, scores) -> count; k is the shortest
+// output length
+static js_value_t *
+bare_vector_index_merger_merge(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_merger_t *handle = bare_vector_index__merger(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  size_t sources_len, positions_len, scores_len;
+  uint32_t *sources = (uint32_t *) bare_vector_index__typed(env, argv[1], js_uint32array, &sources_len, "Sources must be a Uint32Array");
+  if (sources == NULL) return NULL;
+
+  uint32_t *positions = (uint32_t *) bare_vector_index__typed(env, argv[2], js_uint32array, &positions_len, "Positions must be a Uint32Array");
+  if (positions == NULL) return NULL;
+
+  float *scores = (float *) bare_vector_index__typed(env, argv[3], js_float32array, &scores_len, "Scores must be a Float32Array");
+  if (scores == NULL) return NULL;
+
+  size_t k = std::min(sources_len, std::min(positions_len, scores_len));
+
+  std::vector<merged_t> &merged = handle->merger->merge(k);
+  for (size_t i = 0; i < merged.size(); i++) {
+    sources[i] = merged[i].source;
+    positions[i] = merged[i].position;
+    scores[i] = merged[i].score;
+  }
+
+  js_value_t *result;
+  err = js_create_uint32(env, uint32_t(merged.size()), &result);
+  if (err != 0) return NULL;
+
+  return result;
+}
+
+static js_value_t *
+bare_vector_index_merger_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_merger_t *handle = bare_vector_index__merger(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  ResultMerger *merger = handle->merger;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+#define SET_NUMBER(name, value) \
+  do { \
+    js_value_t *v; \
+    js_create_double(env, double(value), &v); \
+    js_set_named_property(env, result, name, v); \
+  } while (0)
+
+  SET_NUMBER("sources", merger->sources());
+  SET_NUMBER("size", merger->size());
+  SET_NUMBER("memory", merger->memory_usage());
+
+#undef SET_NUMBER
+
+  return result;
+}
+
+static js_value_t *
+bare_vector_index_merger_clear(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_merger_t *handle = bare_vector_index__merger(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  handle->merger->clear();
+  return NULL;
+}
+
+static js_value_t *
+bare_vector_index_merger_destroy(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_merger_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->merger;
+  handle->merger = NULL;
+
+  return NULL;
+}
+
+static bare_vector_index_log_t *
+bare_vector_index__log(js_env_t *env, js_value_t *value) {
+  bare_vector_index_log_t *handle;
+  size_t len;
+  int err = js_get_arraybuffer_info(env, value, (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  if (!handle->log) {
+    js_throw_error(env, NULL, "Delta log has been closed");
+    return NULL;
+  }
+
+  return handle;
+}
+
+// Open or create a delta log: (path, dimension) -> handle
+static js_value_t *
+bare_vector_index_log_open(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  std::string path;
+  if (!bare_vector_index__string(env, argv[0], path)) return NULL;
+
+  uint32_t dimension;
+  err = js_get_value_uint32(env, argv[1], &dimension);
+  if (err != 0) return NULL;
+
+  if (dimension == 0) {
+    js_throw_error(env, NULL, "Dimension must be positive");
+    return NULL;
+  }
+
+  DeltaLog *log = new DeltaLog();
+
+  std::string error;
+  if (!log->open(path.c_str(), dimension, error)) {
+    delete log;
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  js_value_t *result;
+  bare_vector_index_log_t *handle;
+  err = js_create_arraybuffer(env, sizeof(bare_vector_index_log_t), (void **) &handle, &result);
+  if (err != 0) {
+    delete log;
+    return NULL;
+  }
+
+  handle->log = log;
+  return result;
+}
+
+// Records found by logOpen as [{ op, id, tag, meta, vector }], then frees
+// them. op is 1 for add, 2 for remove (tag, meta and vector only for adds).
+static js_value_t *
+bare_vector_index_log_records(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  uint32_t dimension = handle->log->dimension();
+  const auto &records = handle->log->records();
+
+  js_value_t *array;
+  err = js_create_array_with_length(env, records.size(), &array);
+  if (err != 0) return NULL;
+
+  for (uint32_t i = 0; i < records.size(); i++) {
+    const auto &r = records[i];
+
+    js_value_t *entry, *op;
+    js_create_object(env, &entry);
+    js_create_uint32(env, r.op, &op);
+    js_set_named_property(env, entry, "op", op);
+    js_set_named_property(env, entry, "id", bare_vector_index__string_value(env, r.id));
+
+    if (r.op == bare_vector_index::delta_add) {
+      js_set_named_property(env, entry, "tag", bare_vector_index__string_value(env, r.tag));
+      js_set_named_property(env, entry, "meta", bare_vector_index__string_value(env, r.meta));
+
+      js_value_t *buffer, *vector;
+      void *data;
+      js_create_arraybuffer(env, dimension * sizeof(float), &data, &buffer);
+      std::memcpy(data, r.vector, dimension * sizeof(float));
+      js_create_typedarray(env, js_float32array, dimension, buffer, 0, &vector);
+      js_set_named_property(env, entry, "vector", vector);
+    }
+
+    js_set_element(env, array, i, entry);
+  }
+
+  handle->log->release_records();
+  return array;
+}
+
+// Append an add: (handle, id, tag, meta, vector)
+static js_value_t *
+bare_vector_index_log_add(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 5;
+  js_value_t *argv[5];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string id, tag, meta;
+  if (!bare_vector_index__string(env, argv[1], id)) return NULL;
+  if (!bare_vector_index__string(env, argv[2], tag)) return NULL;
+  if (!bare_vector_index__string(env, argv[3], meta)) return NULL;
+
+  js_typedarray_type_t type;
+  float *vector;
+  size_t len;
+  err = js_get_typedarray_info(env, argv[4], &type, (void **) &vector, &len, NULL, NULL);
+  if (err != 0) return NULL;
+
+  if (type != js_float32array || len != handle->log->dimension()) {
+    js_throw_error(env, NULL, "Vector must be a Float32Array matching the log dimension");
+    return NULL;
+  }
+
+  std::string error;
+  if (!handle->log->append_add(id, tag, meta, vector, error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Append a remove: (handle, id)
+static js_value_t *
+bare_vector_index_log_remove(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 2;
+  js_value_t *argv[2];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string id;
+  if (!bare_vector_index__string(env, argv[1], id)) return NULL;
+
+  std::string error;
+  if (!handle->log->append_remove(id, error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// fsync the log
+static js_value_t *
+bare_vector_index_log_sync(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string error;
+  if (!handle->log->sync(error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Drop every record once the base file has been rewritten
+static js_value_t *
+bare_vector_index_log_reset(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  std::string error;
+  if (!handle->log->reset(error)) {
+    js_throw_error(env, NULL, error.c_str());
+    return NULL;
+  }
+
+  return NULL;
+}
+
+// Get stats: { bytes, records }
+static js_value_t *
+bare_vector_index_log_stats(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle = bare_vector_index__log(env, argv[0]);
+  if (handle == NULL) return NULL;
+
+  js_value_t *result;
+  err = js_create_object(env, &result);
+  if (err != 0) return NULL;
+
+  js_value_t *bytes, *records;
+  js_create_double(env, double(handle->log->bytes()), &bytes);
+  js_create_double(env, double(handle->log->count()), &records);
+  js_set_named_property(env, result, "bytes", bytes);
+  js_set_named_property(env, result, "records", records);
+
+  return result;
+}
+
+// Close the log
+static js_value_t *
+bare_vector_index_log_close(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 1;
+  js_value_t *argv[1];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  bare_vector_index_log_t *handle;
+  size_t len;
+  err = js_get_arraybuffer_info(env, argv[0], (void **) &handle, &len);
+  if (err != 0) return NULL;
+
+  delete handle->log;
+  handle->log = NULL;
+
+  return NULL;
+}
+
+// Decode base64 vectors: (strings, dimension, matrix, valid) writes row i of
+// the Float32Array matrix and valid[i] = 1 for each string that holds
+// exactly `dimension` packed floats, returns how many did
+static js_value_t *
+bare_vector_index_decode_vectors(js_env_t *env, js_callback_info_t *info) {
+  int err;
+  size_t argc = 4;
+  js_value_t *argv[4];
+
+  err = js_get_callback_info(env, info, &argc, argv, NULL, NULL);
+  if (err != 0) return NULL;
+
+  uint32_t count;
+  err = js_get_array_length(env, argv[0], &count);
+  if (err != 0) return NULL;
+
+  uint32_t dimension;
+  err = js_get_value_uint32(env, argv[1], &dimension);
+  if (err != 0) return NULL;
+
+  float *matrix = bare_vector_index__matrix(env, argv[2], count, dimension);
+  if (matrix == NULL) return NULL;
+
+  size_t valid_len;
+  uint8_t *valid = (uint8_t *) bare_vector_index__typed(env, argv[3], js_uint8array, &valid_len, "Valid must be a Uint8Array");
+  if (valid == NULL) return NULL;
+
+  if (valid_len < count) {
+    js_throw_error(env, NULL, "Valid is shorter than strings");
+    return NULL;
+  }
+
+  std::string text;
+  uint32_t decoded = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    valid[i] = 0;
+
+    js_value_t *elem;
+    err = js_get_element(env, argv[0], i, &elem);
+    if (err != 0) return NULL;
+
+    js_value_type_t type;
+    js_typeof(env, elem, &type);
+    if (type != js_string) continue;
+
+    if (!bare_vector_index__string(env, elem, text)) return NULL;
+
+    if (bare_vector_index::decode_base64_vector(text.data(), text.size(), matrix + size_t(i) * dimension, dimension)) {
+      valid[i] = 1;
+      decoded++;
+    }
+  }
+
+  js_value_t *result;
+  js_create_uint32(env, decoded, &result);
+  return result;
+}
+
+// Name of the dot-product kernel selected for this CPU
+static js_value_t *
+bare_vector_index_simd_kernel(js_env_t *env, js_callback_info_t *info) {
+  const char *name = bare_vector_index::simd_kernel_name();
+
+  js_value_t *result;
+  js_create_string_utf8(env, (const utf8_t *) name, strlen(name), &result);
+  return result;
+}
+
+// Module exports
+static js_value_t *
+bare_vector_index_exports(js_env_t *env, js_value_t *exports) {
+  int err;
+
+#define EXPORT_FUNCTION(name, fn) \
+  do { \
+    js_value_t *func; \
+    err = js_create_function(env, #name, -1, fn, NULL, &func); \
+    if (err == 0) js_set_named_property(env, exports, #name, func); \
+  } while (0)
+
+  EXPORT_FUNCTION(flatCreate, bare_vector_index_flat_create);
+  EXPORT_FUNCTION(flatReserve, bare_vector_index_flat_reserve);
+  EXPORT_FUNCTION(flatAdd, bare_vector_index_flat_add);
+  EXPORT_FUNCTION(flatAddBatch, bare_vector_index_flat_add_batch);
+  EXPORT_FUNCTION(flatSet, bare_vector_index_flat_set);
+  EXPORT_FUNCTION(flatRemove, bare_vector_index_flat_remove);
+  EXPORT_FUNCTION(flatGet, bare_vector_index_flat_get);
+  EXPORT_FUNCTION(flatSearch, bare_vector_index_flat_search);
+  EXPORT_FUNCTION(flatSearchBatch, bare_vector_index_flat_search_batch);
+  EXPORT_FUNCTION(flatSize, bare_vector_index_flat_size);
+  EXPORT_FUNCTION(flatStats, bare_vector_index_flat_stats);
+  EXPORT_FUNCTION(flatClear, bare_vector_index_flat_clear);
+  EXPORT_FUNCTION(flatDestroy, bare_vector_index_flat_destroy);
+  EXPORT_FUNCTION(hnswCreate, bare_vector_index_hnsw_create);
+  EXPORT_FUNCTION(hnswReserve, bare_vector_index_hnsw_reserve);
+  EXPORT_FUNCTION(hnswAdd, bare_vector_index_hnsw_add);
+  EXPORT_FUNCTION(hnswAddBatch, bare_vector_index_hnsw_add_batch);
+  EXPORT_FUNCTION(hnswRemove, bare_vector_index_hnsw_remove);
+  EXPORT_FUNCTION(hnswRepair, bare_vector_index_hnsw_repair);
+  EXPORT_FUNCTION(hnswGet, bare_vector_index_hnsw_get);
+  EXPORT_FUNCTION(hnswSearch, bare_vector_index_hnsw_search);
+  EXPORT_FUNCTION(hnswSearchBatch, bare_vector_index_hnsw_search_batch);
+  EXPORT_FUNCTION(hnswStats, bare_vector_index_hnsw_stats);
+  EXPORT_FUNCTION(hnswSave, bare_vector_index_hnsw_save);
+  EXPORT_FUNCTION(hnswOpen, bare_vector_index_hnsw_open);
+  EXPORT_FUNCTION(hnswFileIds, bare_vector_index_hnsw_file_ids);
+  EXPORT_FUNCTION(hnswFileTags, bare_vector_index_hnsw_file_tags);
+  EXPORT_FUNCTION(hnswFileMeta, bare_vector_index_hnsw_file_meta);
+  EXPORT_FUNCTION(hnswVerify, bare_vector_index_hnsw_verify);
+  EXPORT_FUNCTION(hnswClear, bare_vector_index_hnsw_clear);
+  EXPORT_FUNCTION(hnswDestroy, bare_vector_index_hnsw_destroy);
+  EXPORT_FUNCTION(textCreate, bare_vector_index_text_create);
+  EXPORT_FUNCTION(textSet, bare_vector_index_text_set);
+  EXPORT_FUNCTION(textRemove, bare_vector_index_text_remove);
+  EXPORT_FUNCTION(textMove, bare_vector_index_text_move);
+  EXPORT_FUNCTION(textSearch, bare_vector_index_text_search);
+  EXPORT_FUNCTION(textStats, bare_vector_index_text_stats);
+  EXPORT_FUNCTION(textClear, bare_vector_index_text_clear);
+  EXPORT_FUNCTION(textDestroy, bare_vector_index_text_destroy);
+  EXPORT_FUNCTION(candidatesCreate, bare_vector_index_candidates_create);
+  EXPORT_FUNCTION(candidatesSet, bare_vector_index_candidates_set);
+  EXPORT_FUNCTION(candidatesRemove, bare_vector_index_candidates_remove);
+  EXPORT_FUNCTION(candidatesWatch, bare_vector_index_candidates_watch);
+  EXPORT_FUNCTION(candidatesSimilarity, bare_vector_index_candidates_similarity);
+  EXPORT_FUNCTION(candidatesAffinity, bare_vector_index_candidates_affinity);
+  EXPORT_FUNCTION(candidatesRank, bare_vector_index_candidates_rank);
+  EXPORT_FUNCTION(candidatesStats, bare_vector_index_candidates_stats);
+  EXPORT_FUNCTION(candidatesClear, bare_vector_index_candidates_clear);
+  EXPORT_FUNCTION(candidatesDestroy, bare_vector_index_candidates_destroy);
+  EXPORT_FUNCTION(mergerCreate, bare_vector_index_merger_create);
+  EXPORT_FUNCTION(mergerAdd, bare_vector_index_merger_add);
+  EXPORT_FUNCTION(mergerMerge, bare_vector_index_merger_merge);
+  EXPORT_FUNCTION(mergerStats, bare_vector_index_merger_stats);
+  EXPORT_FUNCTION(mergerClear, bare_vector_index_merger_clear);
+  EXPORT_FUNCTION(mergerDestroy, bare_vector_index_merger_destroy);
+  EXPORT_FUNCTION(logOpen, bare_vector_index_log_open);
+  EXPORT_FUNCTION(logRecords, bare_vector_index_log_records);
+  EXPORT_FUNCTION(logAdd, bare_vector_index_log_add);
+  EXPORT_FUNCTION(logRemove, bare_vector_index_log_remove);
+  EXPORT_FUNCTION(logSync, bare_vector_index_log_sync);
+  EXPORT_FUNCTION(logReset, bare_vector_index_log_reset);
+  EXPORT_FUNCTION(logStats, bare_vector_index_log_stats);
+  EXPORT_FUNCTION(logClose, bare_vector_index_log_close);
+  EXPORT_FUNCTION(decodeVectors, bare_vector_index_decode_vectors);
+  EXPORT_FUNCTION(simdKernel, bare_vector_index_simd_kernel);
+
+#undef EXPORT_FUNCTION
+
+  return exports;
+}
+
+BARE_MODULE(bare_vector_index, bare_vector_index_exports)
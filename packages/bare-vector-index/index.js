@@ -0,0 +1,1275 @@
+/**
+ * bare-vector-index - Native embedding similarity search
+ * Drop-in replacements for the backend's JS VectorIndex (same add/remove/
+ * search/size/clear/serialize API):
+ * - VectorIndex: exact SIMD scan over one aligned native matrix
+ * - HnswIndex: approximate HNSW graph with channel-filtered search
+ * Both can skip excluded ids inside the native search and, given
+ * `textKeys`, keep a BM25 index over those metadata fields for hybrid
+ * (vector + keyword) ranking fused natively.
+ * CandidateTable keeps recommendation features in native columns and ranks
+ * them with a top-K heap.
+ * ResultMerger k-way merges ranked result lists (federated search).
+ */
+
+const binding = require('./binding')
+
+const DEFAULT_DIMENSION = 384
+
+// HNSW defaults: M links per node, beam widths for insert/search
+const DEFAULT_M = 16
+const DEFAULT_EF_CONSTRUCTION = 100
+const DEFAULT_EF_SEARCH = 64
+
+// Nodes repaired per background tick after deletes
+const REPAIR_BATCH = 2048
+
+// hnswSearch ef value that forces an exact scan
+const EF_EXACT = 0xffffffff
+
+// Flat index storage modes and their default re-rank factors (candidates
+// per requested hit re-scored with the float rows)
+const QUANTIZATION = { none: 0, int8: 1, binary: 2 }
+const DEFAULT_RERANK = { none: 0, int8: 4, binary: 10 }
+
+// Share of the (max-normalised) BM25 score in hybrid results
+const DEFAULT_TEXT_WEIGHT = 0.3
+
+function toVector(vector, dimension, label) {
+  const vec = vector instanceof Float32Array ? vector : new Float32Array(vector)
+  if (vec.length !== dimension) {
+    throw new Error(`${label} dimension mismatch: expected ${dimension}, got ${vec.length}`)
+  }
+  return vec
+}
+
+// Decode base64 vectors into one matrix; rows that are not exactly
+// `dimension` packed floats are flagged invalid
+function decodeBatch(encoded, dimension) {
+  const matrix = new Float32Array(encoded.length * dimension)
+  const valid = new Uint8Array(encoded.length)
+  binding.decodeVectors(encoded, dimension, matrix, valid)
+  return { matrix, valid }
+}
+
+// Move the rows of `matrix` that are new ids to the front (later duplicates
+// of an id replace the earlier row). `existing(id)` handles ids already in
+// the index. Returns the original positions of the packed rows.
+function packBatch(ids, matrix, valid, dimension, existing) {
+  const order = []
+  const pending = new Map()
+  for (let i = 0; i < ids.length; i++) {
+    if (!valid[i]) continue
+    const id = ids[i]
+    if (existing(id, i)) continue
+
+    let row = pending.get(id)
+    if (row === undefined) {
+      row = order.length
+      pending.set(id, row)
+      order.push(i)
+    } else {
+      order[row] = i
+    }
+    if (row !== i) matrix.copyWithin(row * dimension, i * dimension, (i + 1) * dimension)
+  }
+  return order
+}
+
+// Pack query vectors into one matrix for a batched search
+function toMatrix(queries, dimension) {
+  const matrix = new Float32Array(queries.length * dimension)
+  for (let i = 0; i < queries.length; i++) matrix.set(toVector(queries[i], dimension, 'Query vector'), i * dimension)
+  return matrix
+}
+
+// Bitset over slots / labels of the indexed ids among `ids` (any iterable),
+// for the native exclude filter; null when none of them is indexed
+function excludeBits(ids, slots, size) {
+  if (!ids) return null
+  let bits = null
+  for (const id of ids) {
+    const slot = slots.get(id)
+    if (slot === undefined) continue
+    if (bits === null) bits = new Uint32Array((size + 31) >>> 5)
+    bits[slot >>> 5] |= 1 << (slot & 31)
+  }
+  return bits
+}
+
+// Text indexed for hybrid search: the string `keys` fields of metadata
+function textOf(metadata, keys) {
+  let text = ''
+  for (const key of keys) {
+    const value = metadata?.[key]
+    if (typeof value === 'string' && value !== '') text = text === '' ? value : text + ' ' + value
+  }
+  return text
+}
+
+// Hybrid arguments for flatSearch / hnswSearch: [text index, query, weight]
+function hybridArgs(text, opts) {
+  if (text === null || typeof opts.text !== 'string' || opts.text === '') return [null, '', 0]
+  return [text, opts.text, opts.textWeight ?? DEFAULT_TEXT_WEIGHT]
+}
+
+// Unpack batched results: query q owns entries [q * k, q * k + counts[q])
+function unpackBatch(counts, slots, scores, k, result) {
+  const out = new Array(counts.length)
+  for (let q = 0; q < counts.length; q++) {
+    const hits = new Array(counts[q])
+    for (let i = 0; i < counts[q]; i++) hits[i] = result(slots[q * k + i], scores[q * k + i])
+    out[q] = hits
+  }
+  return out
+}
+
+class VectorIndex {
+  /**
+   * @param {Object} [opts]
+   * @param {number} [opts.dimension] - Vector dimension (default 384)
+   * @param {'none'|'int8'|'binary'} [opts.quantization] - Row storage (default 'none')
+   * @param {number} [opts.rerank] - Re-rank factor for quantised modes
+   *   (default 4 for int8, 10 for binary). 0 keeps only the codes: smallest
+   *   footprint, approximate scores, and serialize() writes dequantised vectors.
+   * @param {string[]} [opts.textKeys] - Metadata fields kept in a BM25 index
+   *   for hybrid search (default none)
+   */
+  constructor(opts = {}) {
+    this._dimension = opts.dimension || DEFAULT_DIMENSION
+    this.quantization = opts.quantization || 'none'
+    if (!(this.quantization in QUANTIZATION)) throw new Error(`Unknown quantization: ${this.quantization}`)
+    this.rerank = opts.rerank ?? DEFAULT_RERANK[this.quantization]
+    this.textKeys = opts.textKeys || null
+    this._handle = null
+    this._text = null
+    /** @type {string[]} slot -> id */
+    this._ids = []
+    /** @type {any[]} slot -> metadata */
+    this._metadata = []
+    /** @type {Map<string, number>} id -> slot */
+    this._slots = new Map()
+    this._hitSlots = null
+    this._hitScores = null
+  }
+
+  get dimension() {
+    return this._dimension
+  }
+
+  /**
+   * Changing the dimension of a populated index drops its vectors; they could
+   * never be compared against queries of the new size anyway.
+   */
+  set dimension(value) {
+    if (value === this._dimension) return
+    this._release()
+    this._dimension = value
+  }
+
+  _index() {
+    if (this._handle === null) {
+      this._handle = binding.flatCreate(this._dimension, QUANTIZATION[this.quantization], this.rerank)
+      if (this.textKeys !== null) this._text = binding.textCreate()
+    }
+    return this._handle
+  }
+
+  _setText(slot, metadata) {
+    if (this._text !== null) binding.textSet(this._text, slot, textOf(metadata, this.textKeys))
+  }
+
+  /**
+   * Preallocate room for `count` vectors (avoids regrowth during bulk loads)
+   * @param {number} count
+   */
+  reserve(count) {
+    binding.flatReserve(this._index(), count)
+  }
+
+  /**
+   * Add a vector to the index
+   * @param {string} id - Video ID or document ID
+   * @param {Float32Array|number[]} vector - Embedding vector
+   * @param {any} metadata - Associated metadata
+   */
+  add(id, vector, metadata = {}) {
+    const vec = toVector(vector, this._dimension, 'Vector')
+    const handle = this._index()
+
+    const existing = this._slots.get(id)
+    if (existing !== undefined) {
+      binding.flatSet(handle, existing, vec)
+      this._metadata[existing] = metadata
+      this._setText(existing, metadata)
+      return
+    }
+
+    const slot = binding.flatAdd(handle, vec)
+    this._ids[slot] = id
+    this._metadata[slot] = metadata
+    this._slots.set(id, slot)
+    this._setText(slot, metadata)
+  }
+
+  /**
+   * Add a batch of base64-encoded vectors (packed little-endian float32, as
+   * stored in channel views) without building a Float32Array per entry.
+   * Entries that do not decode to `dimension` floats are skipped; ids
+   * already indexed are updated in place.
+   * @param {string[]} ids
+   * @param {string[]} encoded
+   * @param {any[]} [metadata] - Per-entry metadata (default {})
+   * @returns {number} Vectors added or updated
+   */
+  addEncoded(ids, encoded, metadata = []) {
+    const dimension = this._dimension
+    const handle = this._index()
+    const { matrix, valid } = decodeBatch(encoded, dimension)
+
+    let updated = 0
+    const order = packBatch(ids, matrix, valid, dimension, (id, i) => {
+      const slot = this._slots.get(id)
+      if (slot === undefined) return false
+      binding.flatSet(handle, slot, matrix.subarray(i * dimension, (i + 1) * dimension))
+      this._metadata[slot] = metadata[i] ?? {}
+      this._setText(slot, this._metadata[slot])
+      updated++
+      return true
+    })
+
+    const slots = new Uint32Array(order.length)
+    binding.flatAddBatch(handle, matrix, slots)
+    for (let row = 0; row < order.length; row++) {
+      const i = order[row]
+      const slot = slots[row]
+      this._ids[slot] = ids[i]
+      this._metadata[slot] = metadata[i] ?? {}
+      this._slots.set(ids[i], slot)
+      this._setText(slot, this._metadata[slot])
+    }
+
+    return updated + order.length
+  }
+
+  /**
+   * Remove a vector from the index
+   * @param {string} id - Video ID or document ID
+   */
+  remove(id) {
+    const slot = this._slots.get(id)
+    if (slot === undefined) return
+
+    const moved = binding.flatRemove(this._handle, slot)
+    this._slots.delete(id)
+
+    if (moved >= 0) {
+      // Last row was moved into the freed slot
+      const movedId = this._ids[moved]
+      this._ids[slot] = movedId
+      this._metadata[slot] = this._metadata[moved]
+      this._slots.set(movedId, slot)
+      if (this._text !== null) binding.textMove(this._text, slot, moved)
+    } else if (this._text !== null) {
+      binding.textRemove(this._text, slot)
+    }
+
+    this._ids.pop()
+    this._metadata.pop()
+  }
+
+  /**
+   * Search for similar vectors
+   * @param {Float32Array|number[]} queryVector - Query embedding
+   * @param {number} topK - Number of results to return
+   * @param {Object} [opts]
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned (skipped
+   *   inside the scan, so topK results still come back)
+   * @param {string} [opts.text] - Keyword query for hybrid ranking (needs
+   *   `textKeys`): scores become (1 - textWeight) * cosine +
+   *   textWeight * BM25 / best BM25
+   * @param {number} [opts.textWeight] - Share of the text score (default 0.3)
+   * @returns {Array<{id: string, score: number, metadata: any}>}
+   */
+  search(queryVector, topK = 10, opts = {}) {
+    const query = toVector(queryVector, this._dimension, 'Query vector')
+    if (this._ids.length === 0 || topK <= 0) return []
+
+    if (this._hitSlots === null || this._hitSlots.length !== topK) {
+      this._hitSlots = new Uint32Array(topK)
+      this._hitScores = new Float32Array(topK)
+    }
+
+    const exclude = excludeBits(opts.exclude, this._slots, this._ids.length)
+    const [text, textQuery, textWeight] = hybridArgs(this._text, opts)
+    const count = binding.flatSearch(this._handle, query, this._hitSlots, this._hitScores, exclude, text, textQuery, textWeight)
+
+    const results = new Array(count)
+    for (let i = 0; i < count; i++) {
+      const slot = this._hitSlots[i]
+      results[i] = { id: this._ids[slot], score: this._hitScores[i], metadata: this._metadata[slot] }
+    }
+    return results
+  }
+
+  /**
+   * Search many queries in one native call: the scan runs as a blocked
+   * matrix product on a worker pool, so a burst of queries costs about as
+   * much memory traffic as one. Quantised indexes that keep float rows
+   * answer exactly (no re-ranking needed).
+   * @param {Array<Float32Array|number[]>} queryVectors
+   * @param {number} topK - Results per query
+   * @param {Object} [opts]
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned, for every query
+   * @returns {Array<Array<{id: string, score: number, metadata: any}>>}
+   */
+  searchBatch(queryVectors, topK = 10, opts = {}) {
+    const queries = toMatrix(queryVectors, this._dimension)
+    if (this._ids.length === 0 || topK <= 0) return queryVectors.map(() => [])
+
+    const count = queryVectors.length
+    const slots = new Uint32Array(count * topK)
+    const scores = new Float32Array(count * topK)
+    const counts = new Uint32Array(count)
+    const exclude = excludeBits(opts.exclude, this._slots, this._ids.length)
+    binding.flatSearchBatch(this._handle, queries, topK, slots, scores, counts, exclude)
+
+    return unpackBatch(counts, slots, scores, topK, (slot, score) => ({ id: this._ids[slot], score, metadata: this._metadata[slot] }))
+  }
+
+  /**
+   * Check whether an id is indexed
+   * @param {string} id
+   * @returns {boolean}
+   */
+  has(id) {
+    return this._slots.has(id)
+  }
+
+  /**
+   * Indexed ids
+   * @returns {IterableIterator<string>}
+   */
+  ids() {
+    return this._slots.keys()
+  }
+
+  /**
+   * Get vector count
+   * @returns {number}
+   */
+  size() {
+    return this._ids.length
+  }
+
+  /**
+   * Storage stats
+   * @returns {{size: number, bytesPerVector: number, memory: number}}
+   */
+  stats() {
+    return binding.flatStats(this._index())
+  }
+
+  /**
+   * Clear all vectors
+   */
+  clear() {
+    if (this._handle !== null) binding.flatClear(this._handle)
+    if (this._text !== null) binding.textClear(this._text)
+    this._ids = []
+    this._metadata = []
+    this._slots.clear()
+  }
+
+  /**
+   * Serialize index to buffer (for persistence). Same JSON layout as the JS
+   * index; stored vectors are already normalised, which cosine ignores.
+   * @returns {Buffer}
+   */
+  serialize() {
+    const out = new Float32Array(this._dimension)
+    const data = {
+      dimension: this._dimension,
+      vectors: this._ids.map((id, slot) => {
+        binding.flatGet(this._handle, slot, out)
+        return { id, vector: Array.from(out), metadata: this._metadata[slot] }
+      })
+    }
+    return Buffer.from(JSON.stringify(data))
+  }
+
+  /**
+   * Deserialize index from buffer
+   * @param {Buffer} buffer
+   */
+  deserialize(buffer) {
+    const data = JSON.parse(buffer.toString())
+    this.dimension = data.dimension
+    this.clear()
+    this.reserve(data.vectors.length)
+    for (const { id, vector, metadata } of data.vectors) {
+      this.add(id, vector, metadata)
+    }
+  }
+
+  _release() {
+    if (this._handle !== null) {
+      binding.flatDestroy(this._handle)
+      this._handle = null
+    }
+    if (this._text !== null) {
+      binding.textDestroy(this._text)
+      this._text = null
+    }
+    this._ids = []
+    this._metadata = []
+    this._slots.clear()
+  }
+
+  /**
+   * Free the native matrix
+   */
+  destroy() {
+    this._release()
+  }
+}
+
+// Metadata of an opened index that has not been decoded from the file yet
+const UNLOADED = Symbol('unloaded')
+
+// Delta log record ops (src/delta_log.h)
+const LOG_REMOVE = 2
+
+class HnswIndex {
+  /**
+   * @param {Object} [opts]
+   * @param {number} [opts.dimension] - Vector dimension (default 384)
+   * @param {number} [opts.m] - Links per node (default 16, level 0 keeps 2x)
+   * @param {number} [opts.efConstruction] - Insert beam width (default 100)
+   * @param {number} [opts.efSearch] - Default search beam width (default 64)
+   * @param {number} [opts.seed] - Level generator seed
+   * @param {string} [opts.tagKey] - Metadata field used for filtered search (default 'channelKey')
+   * @param {string[]} [opts.textKeys] - Metadata fields kept in a BM25 index
+   *   for hybrid search (default none)
+   */
+  constructor(opts = {}) {
+    this._dimension = opts.dimension || DEFAULT_DIMENSION
+    this.m = opts.m || DEFAULT_M
+    this.efConstruction = opts.efConstruction || DEFAULT_EF_CONSTRUCTION
+    this.efSearch = opts.efSearch || DEFAULT_EF_SEARCH
+    this.seed = opts.seed || 100
+    this.tagKey = opts.tagKey || 'channelKey'
+    this.textKeys = opts.textKeys || null
+    this._handle = null
+    this._text = null
+    // Set while labels loaded from a file have no text indexed yet; the
+    // text index is then rebuilt by the first hybrid search
+    this._textStale = false
+    /** @type {Map<string, number>} id -> label */
+    this._labels = new Map()
+    /** @type {string[]} label -> id */
+    this._ids = []
+    /** @type {any[]} label -> metadata */
+    this._metadata = []
+    /** @type {Map<string, number>} tag value (channel key) -> native tag */
+    this._tags = new Map()
+    this._repairTimer = null
+    this._mapped = false
+    // Base file and delta log handle when opened with load()
+    this._path = null
+    this._log = null
+    this._hitLabels = null
+    this._hitScores = null
+  }
+
+  get dimension() {
+    return this._dimension
+  }
+
+  /**
+   * Changing the dimension of a populated index drops its vectors (and
+   * detaches the delta log of an index opened with load()).
+   */
+  set dimension(value) {
+    if (value === this._dimension) return
+    this._release()
+    this._dimension = value
+  }
+
+  _index() {
+    if (this._handle === null) {
+      this._handle = binding.hnswCreate(this._dimension, this.m, this.efConstruction, this.efSearch, this.seed)
+    }
+    return this._handle
+  }
+
+  _setText(label, metadata) {
+    if (this.textKeys === null || this._textStale) return
+    if (this._text === null) this._text = binding.textCreate()
+    binding.textSet(this._text, label, textOf(metadata, this.textKeys))
+  }
+
+  // Text index for a hybrid search, indexing any labels opened from a file
+  _textIndex() {
+    if (this.textKeys === null) return null
+    if (this._text === null) this._text = binding.textCreate()
+    if (this._textStale) {
+      this._textStale = false
+      binding.textClear(this._text)
+      for (const label of this._labels.values()) this._setText(label, this._meta(label))
+    }
+    return this._text
+  }
+
+  _tagFor(value, create) {
+    const key = value === undefined || value === null ? '' : String(value)
+    let tag = this._tags.get(key)
+    if (tag === undefined && create) {
+      tag = this._tags.size
+      this._tags.set(key, tag)
+    }
+    return tag
+  }
+
+  /**
+   * Preallocate room for `count` vectors
+   * @param {number} count
+   */
+  reserve(count) {
+    binding.hnswReserve(this._index(), count)
+  }
+
+  /**
+   * Add a vector to the index (re-adding an id replaces it)
+   * @param {string} id - Video ID or document ID
+   * @param {Float32Array|number[]} vector - Embedding vector
+   * @param {any} metadata - Associated metadata; metadata[tagKey] is filterable
+   */
+  add(id, vector, metadata = {}) {
+    const vec = toVector(vector, this._dimension, 'Vector')
+    const handle = this._index()
+
+    if (this._labels.has(id)) this.remove(id)
+
+    const tagValue = metadata?.[this.tagKey]
+    const tag = this._tagFor(tagValue, true)
+    const label = binding.hnswAdd(handle, vec, tag)
+    this._ids[label] = id
+    this._metadata[label] = metadata
+    this._labels.set(id, label)
+    this._setText(label, metadata)
+
+    if (this._log !== null) {
+      const key = tagValue === undefined || tagValue === null ? '' : String(tagValue)
+      binding.logAdd(this._log, id, key, JSON.stringify(metadata ?? {}), vec)
+    }
+  }
+
+  /**
+   * Add a batch of base64-encoded vectors (packed little-endian float32, as
+   * stored in channel views) in one native call. Entries that do not decode
+   * to `dimension` floats are skipped; ids already indexed are replaced.
+   * @param {string[]} ids
+   * @param {string[]} encoded
+   * @param {any[]} [metadata] - Per-entry metadata; metadata[tagKey] is filterable
+   * @returns {number} Vectors added
+   */
+  addEncoded(ids, encoded, metadata = []) {
+    const dimension = this._dimension
+    const handle = this._index()
+    const { matrix, valid } = decodeBatch(encoded, dimension)
+
+    const order = packBatch(ids, matrix, valid, dimension, (id) => {
+      if (this._labels.has(id)) this.remove(id)
+      return false
+    })
+
+    const tags = new Uint32Array(order.length)
+    for (let row = 0; row < order.length; row++) {
+      tags[row] = this._tagFor(metadata[order[row]]?.[this.tagKey], true)
+    }
+
+    const labels = new Uint32Array(order.length)
+    binding.hnswAddBatch(handle, matrix, tags, labels)
+
+    for (let row = 0; row < order.length; row++) {
+      const i = order[row]
+      const label = labels[row]
+      const meta = metadata[i] ?? {}
+      this._ids[label] = ids[i]
+      this._metadata[label] = meta
+      this._labels.set(ids[i], label)
+      this._setText(label, meta)
+
+      if (this._log !== null) {
+        const tagValue = meta[this.tagKey]
+        const key = tagValue === undefined || tagValue === null ? '' : String(tagValue)
+        binding.logAdd(this._log, ids[i], key, JSON.stringify(meta), matrix.subarray(row * dimension, (row + 1) * dimension))
+      }
+    }
+
+    return order.length
+  }
+
+  /**
+   * Remove a vector from the index. The node is tombstoned immediately and
+   * unlinked from the graph by background repair.
+   * @param {string} id - Video ID or document ID
+   */
+  remove(id) {
+    const label = this._labels.get(id)
+    if (label === undefined) return
+
+    binding.hnswRemove(this._handle, label)
+    if (this._text !== null && !this._textStale) binding.textRemove(this._text, label)
+    this._labels.delete(id)
+    this._ids[label] = undefined
+    this._metadata[label] = undefined
+    this._scheduleRepair()
+
+    if (this._log !== null) binding.logRemove(this._log, id)
+  }
+
+  _scheduleRepair() {
+    if (this._repairTimer !== null) return
+    this._repairTimer = setTimeout(() => {
+      this._repairTimer = null
+      if (this._handle === null) return
+      if (binding.hnswRepair(this._handle, REPAIR_BATCH) > 0) this._scheduleRepair()
+    }, 0)
+    this._repairTimer.unref?.()
+  }
+
+  /**
+   * Run repair to completion (tests, or before persisting)
+   */
+  repair() {
+    if (this._handle === null) return
+    while (binding.hnswRepair(this._handle, REPAIR_BATCH) > 0) {}
+  }
+
+  /**
+   * Search for similar vectors
+   * @param {Float32Array|number[]} queryVector - Query embedding
+   * @param {number} topK - Number of results to return
+   * @param {Object} [opts]
+   * @param {string} [opts.channelKey] - Only return vectors whose metadata[tagKey] matches
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned; the walk
+   *   passes through them and widens its beam to still find topK
+   * @param {string} [opts.text] - Keyword query for hybrid ranking (needs
+   *   `textKeys`), fused as for VectorIndex.search()
+   * @param {number} [opts.textWeight] - Share of the text score (default 0.3)
+   * @param {number} [opts.ef] - Beam width for this query
+   * @param {boolean} [opts.exact] - Exact scan instead of the graph
+   * @returns {Array<{id: string, score: number, metadata: any}>}
+   */
+  search(queryVector, topK = 10, opts = {}) {
+    const query = toVector(queryVector, this._dimension, 'Query vector')
+    if (this._labels.size === 0 || topK <= 0) return []
+
+    let tag = -1
+    const filter = opts[this.tagKey]
+    if (filter !== undefined && filter !== null) {
+      tag = this._tagFor(filter, false)
+      if (tag === undefined) return []
+    }
+
+    if (this._hitLabels === null || this._hitLabels.length !== topK) {
+      this._hitLabels = new Uint32Array(topK)
+      this._hitScores = new Float32Array(topK)
+    }
+
+    const ef = opts.exact ? EF_EXACT : opts.ef || 0
+    const exclude = excludeBits(opts.exclude, this._labels, this._ids.length)
+    const hybrid = typeof opts.text === 'string' && opts.text !== ''
+    const [text, textQuery, textWeight] = hybridArgs(hybrid ? this._textIndex() : null, opts)
+    const count = binding.hnswSearch(this._handle, query, ef, tag, this._hitLabels, this._hitScores, exclude, text, textQuery, textWeight)
+
+    const results = new Array(count)
+    for (let i = 0; i < count; i++) {
+      const label = this._hitLabels[i]
+      results[i] = { id: this._ids[label], score: this._hitScores[i], metadata: this._meta(label) }
+    }
+    return results
+  }
+
+  /**
+   * Exact search of many queries in one native call, run as a blocked
+   * matrix product over the stored rows on a worker pool. Past a handful
+   * of queries this beats one graph walk per query and returns exact
+   * results.
+   * @param {Array<Float32Array|number[]>} queryVectors
+   * @param {number} topK - Results per query
+   * @param {Object} [opts]
+   * @param {string} [opts.channelKey] - Only return vectors whose metadata[tagKey] matches
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned, for every query
+   * @returns {Array<Array<{id: string, score: number, metadata: any}>>}
+   */
+  searchBatch(queryVectors, topK = 10, opts = {}) {
+    const queries = toMatrix(queryVectors, this._dimension)
+    if (this._labels.size === 0 || topK <= 0) return queryVectors.map(() => [])
+
+    let tag = -1
+    const filter = opts[this.tagKey]
+    if (filter !== undefined && filter !== null) {
+      tag = this._tagFor(filter, false)
+      if (tag === undefined) return queryVectors.map(() => [])
+    }
+
+    const count = queryVectors.length
+    const labels = new Uint32Array(count * topK)
+    const scores = new Float32Array(count * topK)
+    const counts = new Uint32Array(count)
+    const exclude = excludeBits(opts.exclude, this._labels, this._ids.length)
+    binding.hnswSearchBatch(this._handle, queries, topK, tag, labels, scores, counts, exclude)
+
+    return unpackBatch(counts, labels, scores, topK, (label, score) => ({ id: this._ids[label], score, metadata: this._meta(label) }))
+  }
+
+  _meta(label) {
+    let metadata = this._metadata[label]
+    if (metadata === UNLOADED) {
+      const json = binding.hnswFileMeta(this._handle, label)
+      metadata = json === null ? {} : JSON.parse(json)
+      this._metadata[label] = metadata
+    }
+    return metadata
+  }
+
+  /**
+   * Check whether an id is indexed
+   * @param {string} id
+   * @returns {boolean}
+   */
+  has(id) {
+    return this._labels.has(id)
+  }
+
+  /**
+   * Indexed ids
+   * @returns {IterableIterator<string>}
+   */
+  ids() {
+    return this._labels.keys()
+  }
+
+  /**
+   * Get vector count
+   * @returns {number}
+   */
+  size() {
+    return this._labels.size
+  }
+
+  /**
+   * Graph stats
+   * @returns {{size: number, tombstones: number, slots: number, memory: number, mapped: number}}
+   */
+  stats() {
+    if (this._handle === null) return { size: 0, tombstones: 0, slots: 0, memory: 0, mapped: 0 }
+    return binding.hnswStats(this._handle)
+  }
+
+  /**
+   * Clear all vectors
+   */
+  clear() {
+    if (this._handle !== null) binding.hnswClear(this._handle)
+    this._mapped = false
+    this._labels.clear()
+    this._ids = []
+    this._metadata = []
+    this._tags.clear()
+    if (this._text !== null) binding.textClear(this._text)
+    this._textStale = false
+    // An empty base is cheap to write and keeps the clear durable
+    if (this._log !== null) this.compact()
+  }
+
+  /**
+   * Serialize index to buffer (same JSON layout as VectorIndex; the graph is
+   * rebuilt on load)
+   * @returns {Buffer}
+   */
+  serialize() {
+    const out = new Float32Array(this._dimension)
+    const vectors = []
+    for (const [id, label] of this._labels) {
+      binding.hnswGet(this._handle, label, out)
+      vectors.push({ id, vector: Array.from(out), metadata: this._meta(label) })
+    }
+    return Buffer.from(JSON.stringify({ dimension: this._dimension, vectors }))
+  }
+
+  /**
+   * Deserialize index from buffer
+   * @param {Buffer} buffer
+   */
+  deserialize(buffer) {
+    const data = JSON.parse(buffer.toString())
+    this.dimension = data.dimension
+    this.clear()
+    this.reserve(data.vectors.length)
+    for (const { id, vector, metadata } of data.vectors) {
+      this.add(id, vector, metadata)
+    }
+  }
+
+  /**
+   * Write the index to a binary file (vectors, graph, ids and metadata).
+   * The file is written beside `path` and renamed over it, so a crash
+   * leaves the previous file intact. Pending deletes are repaired first.
+   * @param {string} path
+   */
+  save(path) {
+    const handle = this._index()
+    const slots = binding.hnswStats(handle).slots
+    const ids = new Array(slots)
+    const metas = new Array(slots)
+    for (let label = 0; label < slots; label++) {
+      const metadata = this._metadata[label]
+      ids[label] = this._ids[label] || ''
+      // Undecoded metadata is copied straight from the mapped file
+      metas[label] = metadata === UNLOADED ? null : metadata === undefined ? '' : JSON.stringify(metadata)
+    }
+    binding.hnswSave(handle, path, ids, metas, Array.from(this._tags.keys()))
+  }
+
+  /**
+   * Open an index written by save(). Vectors stay in the memory-mapped file
+   * and are paged in as searches touch them; metadata is decoded on first
+   * use. Throws if the file is missing, truncated or has a bad header.
+   * @param {string} path
+   * @param {Object} [opts] - Same options as the constructor; graph
+   *   parameters and the dimension come from the file
+   * @returns {HnswIndex}
+   */
+  static open(path, opts = {}) {
+    const handle = binding.hnswOpen(path)
+    const index = new HnswIndex(opts)
+    index._handle = handle
+    index._mapped = true
+    index._dimension = binding.hnswStats(handle).dimension
+
+    const ids = binding.hnswFileIds(handle)
+    for (let label = 0; label < ids.length; label++) {
+      const id = ids[label]
+      if (id === '') continue
+      index._ids[label] = id
+      index._metadata[label] = UNLOADED
+      index._labels.set(id, label)
+    }
+
+    const tags = binding.hnswFileTags(handle)
+    for (let tag = 0; tag < tags.length; tag++) index._tags.set(tags[tag], tag)
+
+    index._textStale = index.textKeys !== null && index._labels.size > 0
+
+    return index
+  }
+
+  /**
+   * Open an index with incremental persistence: the base file at `path`
+   * (if present and of the requested dimension) plus the delta log at
+   * `path + '.log'`, which is replayed on top. From then on every add and
+   * remove is appended to the log, costing one small write whatever the
+   * index size; compact() folds the log back into the base file.
+   * @param {string} path
+   * @param {Object} [opts] - Constructor options; `dimension` selects which
+   *   files are usable (a base or log of another dimension is discarded)
+   * @returns {HnswIndex}
+   */
+  static load(path, opts = {}) {
+    const dimension = opts.dimension || DEFAULT_DIMENSION
+
+    let index = null
+    try {
+      index = HnswIndex.open(path, opts)
+    } catch {}
+
+    if (index !== null && index.dimension !== dimension) {
+      index.destroy()
+      index = null
+    }
+    if (index === null) index = new HnswIndex(opts)
+
+    const log = binding.logOpen(path + '.log', dimension)
+    for (const record of binding.logRecords(log)) {
+      if (record.op === LOG_REMOVE) {
+        index.remove(record.id)
+      } else {
+        const metadata = record.meta === '' ? {} : JSON.parse(record.meta)
+        index.add(record.id, record.vector, metadata)
+      }
+    }
+
+    index._path = path
+    index._log = log
+    return index
+  }
+
+  /**
+   * Fold the delta log into the base file: rewrite the base (atomically)
+   * and empty the log. Replaying a log over a base that already includes
+   * it is harmless, so a crash between the two steps loses nothing.
+   */
+  compact() {
+    if (this._log === null) throw new Error('Index was not opened with load()')
+    this.save(this._path)
+    binding.logReset(this._log)
+  }
+
+  /**
+   * Flush the delta log to stable storage (appends reach the OS at once;
+   * this also survives power loss)
+   */
+  sync() {
+    if (this._log !== null) binding.logSync(this._log)
+  }
+
+  /**
+   * Delta log size, for deciding when to compact
+   * @returns {{bytes: number, records: number}}
+   */
+  logStats() {
+    if (this._log === null) return { bytes: 0, records: 0 }
+    return binding.logStats(this._log)
+  }
+
+  /**
+   * Check the checksums of the file this index was opened from (a full read
+   * of the file, so callers usually defer it). Throws on corruption.
+   */
+  verify() {
+    if (this._mapped) binding.hnswVerify(this._handle)
+  }
+
+  _release() {
+    if (this._repairTimer !== null) {
+      clearTimeout(this._repairTimer)
+      this._repairTimer = null
+    }
+    if (this._handle !== null) {
+      binding.hnswDestroy(this._handle)
+      this._handle = null
+    }
+    if (this._log !== null) {
+      binding.logClose(this._log)
+      this._log = null
+      this._path = null
+    }
+    if (this._text !== null) {
+      binding.textDestroy(this._text)
+      this._text = null
+    }
+    this._textStale = false
+    this._mapped = false
+    this._labels.clear()
+    this._ids = []
+    this._metadata = []
+    this._tags.clear()
+  }
+
+  /**
+   * Free the native graph
+   */
+  destroy() {
+    this._release()
+  }
+}
+
+// Recommendation reasons by CandidateTable reason code
+const REASONS = ['similar_content', 'popular', 'recent', 'channel_content']
+
+// CandidateTable defaults: term weights, watches at which the volume half
+// of popularity reaches 0.5, and the recency half-life
+const DEFAULT_CANDIDATE_WEIGHTS = { similarity: 0.6, popularity: 0.4, recency: 0.1, affinity: 0.2 }
+const DEFAULT_POPULARITY_HALF = 10
+const DEFAULT_RECENCY_HALF_LIFE = 14 * 24 * 3600 * 1000
+
+/**
+ * Recommendation candidates with their ranking features held natively in
+ * columns (watches, completions, similarity to recent watches, creation
+ * time, channel), updated one event at a time and ranked with a top-K heap
+ * in one call. Scores are
+ *   w.similarity * similarity + w.popularity * popularity +
+ *   w.recency * recency + w.affinity * channel affinity
+ * with every term in [0, 1]; each result carries its dominant term as the
+ * reason.
+ */
+class CandidateTable {
+  /**
+   * @param {Object} [opts]
+   * @param {{similarity?: number, popularity?: number, recency?: number, affinity?: number}} [opts.weights]
+   * @param {number} [opts.popularityHalf] - Watches at which the volume
+   *   half of popularity reaches 0.5 (default 10)
+   * @param {number} [opts.recencyHalfLife] - Age in ms at which recency
+   *   halves (default 14 days)
+   */
+  constructor(opts = {}) {
+    const weights = { ...DEFAULT_CANDIDATE_WEIGHTS, ...opts.weights }
+    this._handle = binding.candidatesCreate(
+      weights.similarity,
+      weights.popularity,
+      weights.recency,
+      weights.affinity,
+      opts.popularityHalf ?? DEFAULT_POPULARITY_HALF,
+      opts.recencyHalfLife ?? DEFAULT_RECENCY_HALF_LIFE
+    )
+    /** @type {string[]} slot -> id */
+    this._ids = []
+    /** @type {Map<string, number>} id -> slot */
+    this._slots = new Map()
+    /** @type {Map<string, number>} channelKey -> channel id */
+    this._channels = new Map()
+    this._live = new Set()
+    this._hitSlots = null
+    this._hitScores = null
+    this._hitReasons = null
+  }
+
+  _table() {
+    if (this._handle === null) throw new Error('Candidate table has been destroyed')
+    return this._handle
+  }
+
+  _slot(id) {
+    let slot = this._slots.get(id)
+    if (slot === undefined) {
+      slot = this._ids.length
+      this._ids.push(id)
+      this._slots.set(id, slot)
+    }
+    return slot
+  }
+
+  _channel(channelKey) {
+    let channel = this._channels.get(channelKey)
+    if (channel === undefined) {
+      channel = this._channels.size
+      this._channels.set(channelKey, channel)
+    }
+    return channel
+  }
+
+  /**
+   * Offer a video (or update its features); watch counts are kept
+   * @param {string} id
+   * @param {Object} [features]
+   * @param {number} [features.createdAt] - Upload time in ms (recency)
+   * @param {string|null} [features.channelKey] - Channel (affinity)
+   */
+  set(id, features = {}) {
+    const slot = this._slot(id)
+    binding.candidatesSet(this._table(), slot, features.createdAt || 0, this._channel(features.channelKey ?? null))
+    this._live.add(id)
+  }
+
+  /**
+   * Stop offering a video; its watch counts are kept should it return
+   * @param {string} id
+   */
+  remove(id) {
+    const slot = this._slots.get(id)
+    if (slot === undefined) return
+    binding.candidatesRemove(this._table(), slot)
+    this._live.delete(id)
+  }
+
+  /**
+   * Check whether a video is offered
+   * @param {string} id
+   * @returns {boolean}
+   */
+  has(id) {
+    return this._live.has(id)
+  }
+
+  /**
+   * Count watches of a video (need not be offered yet)
+   * @param {string} id
+   * @param {number} [count] - Watches to add; negative retracts
+   * @param {number} [completed] - How many of them were completed
+   */
+  watch(id, count = 1, completed = 0) {
+    binding.candidatesWatch(this._table(), this._slot(id), count, completed)
+  }
+
+  /**
+   * Replace the similarity column (scores in [0, 1]; unlisted ids get 0)
+   * @param {Map<string, number>|Iterable<[string, number]>} scores
+   */
+  setSimilarity(scores) {
+    const entries = Array.from(scores)
+    const slots = new Uint32Array(entries.length)
+    const values = new Float32Array(entries.length)
+    entries.forEach(([id, score], i) => {
+      slots[i] = this._slot(id)
+      values[i] = score
+    })
+    binding.candidatesSimilarity(this._table(), slots, values)
+  }
+
+  /**
+   * Replace the channel affinities (share of recent watches per channel)
+   * @param {Map<string|null, number>|Iterable<[string|null, number]>} shares
+   */
+  setAffinity(shares) {
+    const entries = Array.from(shares)
+    const channels = new Uint32Array(entries.length)
+    const values = new Float32Array(entries.length)
+    entries.forEach(([channelKey, share], i) => {
+      channels[i] = this._channel(channelKey)
+      values[i] = share
+    })
+    binding.candidatesAffinity(this._table(), channels, values)
+  }
+
+  /**
+   * Best offered videos
+   * @param {number} topK
+   * @param {Object} [opts]
+   * @param {Iterable<string>} [opts.exclude] - Ids never returned
+   * @param {number} [opts.now] - Time recency is measured at (default now)
+   * @returns {Array<{id: string, score: number, reason: string}>}
+   */
+  rank(topK = 10, opts = {}) {
+    const table = this._table()
+    if (this._live.size === 0 || topK <= 0) return []
+
+    if (this._hitSlots === null || this._hitSlots.length !== topK) {
+      this._hitSlots = new Uint32Array(topK)
+      this._hitScores = new Float32Array(topK)
+      this._hitReasons = new Uint8Array(topK)
+    }
+
+    const exclude = excludeBits(opts.exclude, this._slots, this._ids.length)
+    const count = binding.candidatesRank(table, opts.now ?? Date.now(), this._hitSlots, this._hitScores, this._hitReasons, exclude)
+
+    const results = new Array(count)
+    for (let i = 0; i < count; i++) {
+      results[i] = { id: this._ids[this._hitSlots[i]], score: this._hitScores[i], reason: REASONS[this._hitReasons[i]] }
+    }
+    return results
+  }
+
+  /**
+   * Offered video count
+   * @returns {number}
+   */
+  size() {
+    return this._live.size
+  }
+
+  /**
+   * Table stats
+   * @returns {{size: number, slots: number, memory: number}}
+   */
+  stats() {
+    return binding.candidatesStats(this._table())
+  }
+
+  /**
+   * Drop every row, watch counts included
+   */
+  clear() {
+    binding.candidatesClear(this._table())
+    this._ids = []
+    this._slots.clear()
+    this._channels.clear()
+    this._live.clear()
+  }
+
+  /**
+   * Free the native table
+   */
+  destroy() {
+    if (this._handle === null) return
+    binding.candidatesDestroy(this._handle)
+    this._handle = null
+    this._ids = []
+    this._slots.clear()
+    this._channels.clear()
+    this._live.clear()
+  }
+}
+
+/**
+ * K-way merge of ranked result lists from several sources, e.g. the local
+ * index and each peer answering a federated search. Results are identified
+ * by 64-bit id hashes (two Uint32Array words each, low word first) so the
+ * merge never touches ids; a duplicate keeps its best score.
+ */
+class ResultMerger {
+  constructor() {
+    this._handle = binding.mergerCreate()
+  }
+
+  _merger() {
+    if (this._handle === null) throw new Error('Result merger has been destroyed')
+    return this._handle
+  }
+
+  /**
+   * Add one source's results
+   * @param {Uint32Array} hashes - Two words per result
+   * @param {Float32Array} scores
+   * @param {number} [limit] - Keep at most this many of its best results
+   * @returns {number} Source index
+   */
+  add(hashes, scores, limit = scores.length) {
+    return binding.mergerAdd(this._merger(), hashes, scores, limit)
+  }
+
+  /**
+   * Best distinct results across the sources added so far
+   * @param {number} topK
+   * @returns {Array<{source: number, position: number, score: number}>}
+   *   Best-first; position indexes the source's arrays as added
+   */
+  merge(topK) {
+    const handle = this._merger()
+    const sources = new Uint32Array(topK)
+    const positions = new Uint32Array(topK)
+    const scores = new Float32Array(topK)
+    const count = binding.mergerMerge(handle, sources, positions, scores)
+
+    const results = new Array(count)
+    for (let i = 0; i < count; i++) results[i] = { source: sources[i], position: positions[i], score: scores[i] }
+    return results
+  }
+
+  /**
+   * Sources added
+   * @returns {number}
+   */
+  sources() {
+    return binding.mergerStats(this._merger()).sources
+  }
+
+  clear() {
+    binding.mergerClear(this._merger())
+  }
+
+  destroy() {
+    if (this._handle === null) return
+    binding.mergerDestroy(this._handle)
+    this._handle = null
+  }
+}
+
+/**
+ * Dot-product kernel selected for this CPU ('avx2', 'neon' or 'scalar')
+ * @returns {string}
+ */
+function simdKernel() {
+  return binding.simdKernel()
+}
+
+module.exports = {
+  VectorIndex,
+  HnswIndex,
+  CandidateTable,
+  ResultMerger,
+  simdKernel
+}
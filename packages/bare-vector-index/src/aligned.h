@@ -0,0 +1,66 @@
+/**
+ * Cache-line aligned growable buffer for vector storage.
+ *
+ * std::vector cannot promise 64-byte alignment portably (MSVC, older NDKs),
+ * so rows are kept in an over-allocated malloc block with the data pointer
+ * rounded up to the alignment boundary.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace bare_vector_index {
+
+constexpr size_t cache_line = 64;
+
+template <typename T>
+class AlignedBuffer {
+public:
+  AlignedBuffer() = default;
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+  ~AlignedBuffer() { std::free(raw_); }
+
+  T *data() { return data_; }
+  const T *data() const { return data_; }
+  size_t capacity() const { return capacity_; }
+
+  // Grow to hold at least `count` elements, preserving the first `keep`.
+  // New memory is zero-filled so padded lanes never contain garbage.
+  void reserve(size_t count, size_t keep) {
+    if (count <= capacity_) return;
+
+    size_t bytes = count * sizeof(T);
+    void *raw = std::malloc(bytes + cache_line);
+    if (raw == nullptr) throw std::bad_alloc();
+
+    T *data = reinterpret_cast<T *>((reinterpret_cast<uintptr_t>(raw) + cache_line) & ~uintptr_t(cache_line - 1));
+    std::memset(data, 0, bytes);
+    if (keep > 0) std::memcpy(data, data_, keep * sizeof(T));
+
+    std::free(raw_);
+    raw_ = raw;
+    data_ = data;
+    capacity_ = count;
+  }
+
+  void release() {
+    std::free(raw_);
+    raw_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+  }
+
+private:
+  void *raw_ = nullptr;
+  T *data_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+} // namespace bare_vector_index
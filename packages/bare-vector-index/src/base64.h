@@ -0,0 +1,66 @@
+/**
+ * Base64 decoding of packed little-endian float vectors, as stored in the
+ * channel views' `vectors/` records.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace bare_vector_index {
+
+namespace detail {
+
+struct base64_table_t {
+  int8_t t[256];
+
+  base64_table_t() {
+    std::memset(t, -1, sizeof(t));
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; i++) t[uint8_t(alphabet[i])] = int8_t(i);
+  }
+};
+
+inline const base64_table_t &
+base64_table() {
+  static const base64_table_t table;
+  return table;
+}
+
+} // namespace detail
+
+// Decode padded base64 `src` into exactly `dimension` floats. False when
+// the text is not base64 or does not hold exactly dimension * 4 bytes.
+inline bool
+decode_base64_vector(const char *src, size_t len, float *out, size_t dimension) {
+  if (len % 4 != 0) return false;
+
+  size_t padding = 0;
+  if (len > 0 && src[len - 1] == '=') padding++;
+  if (len > 1 && src[len - 2] == '=') padding++;
+  if (len / 4 * 3 - padding != dimension * sizeof(float)) return false;
+
+  const int8_t *t = detail::base64_table().t;
+  uint8_t *dst = reinterpret_cast<uint8_t *>(out);
+  size_t n = 0;
+  size_t bytes = dimension * sizeof(float);
+
+  for (size_t i = 0; i < len; i += 4) {
+    int a = t[uint8_t(src[i])];
+    int b = t[uint8_t(src[i + 1])];
+    int c = src[i + 2] == '=' && i + 4 == len ? 0 : t[uint8_t(src[i + 2])];
+    int d = src[i + 3] == '=' && i + 4 == len ? 0 : t[uint8_t(src[i + 3])];
+    if ((a | b | c | d) < 0) return false;
+
+    uint32_t v = uint32_t(a) << 18 | uint32_t(b) << 12 | uint32_t(c) << 6 | uint32_t(d);
+    if (n < bytes) dst[n++] = uint8_t(v >> 16);
+    if (n < bytes) dst[n++] = uint8_t(v >> 8);
+    if (n < bytes) dst[n++] = uint8_t(v);
+  }
+
+  return true;
+}
+
+} // namespace bare_vector_index
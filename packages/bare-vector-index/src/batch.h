@@ -0,0 +1,117 @@
+/**
+ * Blocked top-k scan of many queries against one set of rows.
+ *
+ * The query x row score matrix is computed tile by tile: a block of rows
+ * small enough to stay in L2 is scored against every query, four queries
+ * per kernel call so each row is loaded once per group, before the scan
+ * moves on. Rows are split into shards run on a ThreadPool, each keeping
+ * its own top-k per query, and the shard results are merged per query.
+ *
+ * A scorer supplies the rows:
+ *
+ *   size_t items() const              rows to scan
+ *   bool accept(size_t item) const    false to skip a row (deleted, ...)
+ *   uint32_t slot(size_t item) const  slot reported for a row
+ *   void score(size_t item, size_t q, float *out) const
+ *                                     scores of queries q .. q + 3
+ *
+ * Query counts are padded to a multiple of four by the caller, so score()
+ * never sees a partial group.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+#include "topk.h"
+
+namespace bare_vector_index {
+
+// Queries scored per kernel call
+constexpr size_t batch_group = 4;
+
+// Rows below this are not worth a shard of their own
+constexpr size_t batch_min_shard_rows = 1024;
+
+// Bytes of rows per tile
+constexpr size_t batch_tile_bytes = 128 * 1024;
+
+inline size_t
+batch_padded(size_t queries) {
+  return (queries + batch_group - 1) / batch_group * batch_group;
+}
+
+// Best `k` rows for each of `queries` queries. Results are packed: query q
+// owns slots / scores [q * k, q * k + counts[q]), best first.
+template <typename Scorer>
+void
+search_blocked(ThreadPool &pool, const Scorer &scorer, size_t queries, size_t k, size_t row_bytes, uint32_t *slots, float *scores, uint32_t *counts) {
+  size_t items = scorer.items();
+  size_t padded = batch_padded(queries);
+
+  if (k == 0 || items == 0) {
+    for (size_t q = 0; q < queries; q++) counts[q] = 0;
+    return;
+  }
+
+  size_t shards = items / batch_min_shard_rows;
+  if (shards > pool.concurrency() * 2) shards = pool.concurrency() * 2;
+  if (shards == 0) shards = 1;
+
+  // Hits kept per query; `k` stays the stride of the packed output
+  size_t keep = k < items ? k : items;
+
+  size_t block = row_bytes > 0 ? batch_tile_bytes / row_bytes : 0;
+  if (block < 16) block = 16;
+
+  // Heaps are sized here so the workers never allocate (run() tasks must
+  // not throw)
+  std::vector<std::vector<TopK>> heaps(shards, std::vector<TopK>(padded));
+  for (std::vector<TopK> &shard : heaps) {
+    for (TopK &t : shard) t.reset(keep);
+  }
+
+  pool.run(shards, [&](size_t shard) {
+    std::vector<TopK> &topk = heaps[shard];
+
+    size_t begin = items * shard / shards;
+    size_t end = items * (shard + 1) / shards;
+    float out[batch_group];
+
+    for (size_t b = begin; b < end; b += block) {
+      size_t b_end = b + block < end ? b + block : end;
+
+      for (size_t q = 0; q < padded; q += batch_group) {
+        for (size_t i = b; i < b_end; i++) {
+          if (!scorer.accept(i)) continue;
+
+          scorer.score(i, q, out);
+          uint32_t slot = scorer.slot(i);
+          for (size_t j = 0; j < batch_group; j++) {
+            if (out[j] > topk[q + j].threshold()) topk[q + j].push(out[j], slot);
+          }
+        }
+      }
+    }
+  });
+
+  TopK merged;
+  for (size_t q = 0; q < queries; q++) {
+    merged.reset(keep);
+    for (size_t s = 0; s < shards; s++) {
+      for (const hit_t &h : heaps[s][q].finish()) merged.push(h.score, h.slot);
+    }
+
+    const std::vector<hit_t> &hits = merged.finish();
+    for (size_t i = 0; i < hits.size(); i++) {
+      slots[q * k + i] = hits[i].slot;
+      scores[q * k + i] = hits[i].score;
+    }
+    counts[q] = uint32_t(hits.size());
+  }
+}
+
+} // namespace bare_vector_index
@@ -0,0 +1,148 @@
+#include "candidate_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bare_vector_index {
+
+void
+CandidateTable::grow(uint32_t slot) {
+  if (slot < live_.size()) return;
+
+  size_t size = size_t(slot) + 1;
+  live_.resize(size, 0);
+  watches_.resize(size, 0);
+  completed_.resize(size, 0);
+  similarity_.resize(size, 0);
+  created_.resize(size, 0);
+  channel_.resize(size, 0);
+}
+
+void
+CandidateTable::set(uint32_t slot, double created, uint32_t channel) {
+  grow(slot);
+  if (!live_[slot]) live_count_++;
+  live_[slot] = 1;
+  created_[slot] = created;
+  channel_[slot] = channel;
+}
+
+void
+CandidateTable::remove(uint32_t slot) {
+  if (slot >= live_.size() || !live_[slot]) return;
+  live_[slot] = 0;
+  live_count_--;
+}
+
+void
+CandidateTable::watch(uint32_t slot, float count, float completed) {
+  grow(slot);
+  watches_[slot] = std::max(0.0f, watches_[slot] + count);
+  completed_[slot] = std::min(watches_[slot], std::max(0.0f, completed_[slot] + completed));
+}
+
+void
+CandidateTable::set_similarity(const uint32_t *slots, const float *scores, size_t count) {
+  for (uint32_t slot : similar_) {
+    if (slot < similarity_.size()) similarity_[slot] = 0;
+  }
+  similar_.clear();
+
+  for (size_t i = 0; i < count; i++) {
+    grow(slots[i]);
+    similarity_[slots[i]] = std::min(1.0f, std::max(0.0f, scores[i]));
+    similar_.push_back(slots[i]);
+  }
+}
+
+void
+CandidateTable::set_affinity(const uint32_t *channels, const float *shares, size_t count) {
+  affinity_.clear();
+  for (size_t i = 0; i < count; i++) {
+    if (channels[i] >= affinity_.size()) affinity_.resize(size_t(channels[i]) + 1, 0);
+    affinity_[channels[i]] = std::min(1.0f, std::max(0.0f, shares[i]));
+  }
+}
+
+float
+CandidateTable::popularity(uint32_t slot) const {
+  float watches = watches_[slot];
+  if (watches <= 0) return 0;
+  return 0.5f * watches / (watches + weights_.popularity_half) + 0.5f * completed_[slot] / watches;
+}
+
+float
+CandidateTable::recency(uint32_t slot, double now) const {
+  double created = created_[slot];
+  if (created <= 0) return 0;
+  if (created >= now) return 1;
+  return std::exp2(float((created - now) / weights_.recency_half_life));
+}
+
+std::vector<hit_t> &
+CandidateTable::rank(size_t k, double now, const SlotSet &exclude) {
+  topk_.reset(k);
+
+  const candidate_weights_t &w = weights_;
+  size_t n = live_.size();
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (!live_[i]) continue;
+
+    float score = w.similarity * similarity_[i] + w.popularity * popularity(i) + w.affinity * affinity(i);
+
+    // recency <= 1: skip the exp2 (and the exclusion test) for rows that
+    // cannot enter the heap
+    if (score + w.recency <= topk_.threshold()) continue;
+    score += w.recency * recency(i, now);
+    if (score <= topk_.threshold() || exclude.has(i)) continue;
+
+    topk_.push(score, i);
+  }
+
+  return topk_.finish();
+}
+
+candidate_reason_t
+CandidateTable::reason(uint32_t slot, double now) const {
+  const candidate_weights_t &w = weights_;
+
+  float terms[4] = {
+    w.similarity * similarity_[slot],
+    w.popularity * popularity(slot),
+    w.recency * recency(slot, now),
+    w.affinity * affinity(slot),
+  };
+
+  int best = 0;
+  for (int i = 1; i < 4; i++) {
+    if (terms[i] > terms[best]) best = i;
+  }
+
+  return candidate_reason_t(best);
+}
+
+void
+CandidateTable::clear() {
+  live_.clear();
+  watches_.clear();
+  completed_.clear();
+  similarity_.clear();
+  created_.clear();
+  channel_.clear();
+  similar_.clear();
+  affinity_.clear();
+  live_count_ = 0;
+}
+
+size_t
+CandidateTable::memory_usage() const {
+  return live_.capacity() * sizeof(uint8_t) +
+         (watches_.capacity() + completed_.capacity() + similarity_.capacity()) * sizeof(float) +
+         created_.capacity() * sizeof(double) +
+         channel_.capacity() * sizeof(uint32_t) +
+         similar_.capacity() * sizeof(uint32_t) +
+         affinity_.capacity() * sizeof(float);
+}
+
+} // namespace bare_vector_index
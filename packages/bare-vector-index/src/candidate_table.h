@@ -0,0 +1,114 @@
+/**
+ * Columnar feature table for recommendation candidates.
+ *
+ * One row per video, keyed by slot, with each feature in its own array so
+ * ranking streams through memory:
+ *
+ *   popularity(i) = 0.5 * watches / (watches + popularity_half)
+ *                 + 0.5 * completed / watches
+ *   recency(i)    = 2 ^ -((now - created) / recency_half_life)
+ *   affinity(i)   = share of recent watches on the row's channel
+ *   score(i)      = w_sim * similarity + w_pop * popularity
+ *                 + w_rec * recency + w_aff * affinity
+ *
+ * Every term lies in [0, 1], so once the top-K heap is full a row whose
+ * cheap terms plus w_rec cannot beat the threshold skips the exp2.
+ * Watch counts may arrive before the video is listed; such rows are kept
+ * but are not candidates until set().
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "slot_set.h"
+#include "topk.h"
+
+namespace bare_vector_index {
+
+struct candidate_weights_t {
+  float similarity = 0.6f;
+  float popularity = 0.4f;
+  float recency = 0.1f;
+  float affinity = 0.2f;
+  // Watches at which the volume half of popularity reaches 0.5
+  float popularity_half = 10;
+  // Age (ms) at which recency halves
+  double recency_half_life = 14 * 24 * 3600 * 1000.0;
+};
+
+// Dominant term of a ranked row, reported as the recommendation reason
+enum candidate_reason_t : uint8_t {
+  candidate_similar = 0,
+  candidate_popular = 1,
+  candidate_recent = 2,
+  candidate_channel = 3,
+};
+
+class CandidateTable {
+public:
+  explicit CandidateTable(const candidate_weights_t &weights = candidate_weights_t()) : weights_(weights) {}
+
+  // Rows that are candidates
+  size_t size() const { return live_count_; }
+
+  // Rows allocated (candidates plus watch-only rows)
+  size_t slots() const { return live_.size(); }
+
+  // Make `slot` a candidate created at `created` (ms, 0 if unknown) on
+  // channel `channel`; its watch counts are kept
+  void set(uint32_t slot, double created, uint32_t channel);
+
+  // Stop offering `slot`; its watch counts are kept
+  void remove(uint32_t slot);
+
+  // Add `count` watches, `completed` of them completed (negative to retract)
+  void watch(uint32_t slot, float count, float completed);
+
+  // Replace the similarity column: `scores[i]` for `slots[i]`, 0 elsewhere
+  void set_similarity(const uint32_t *slots, const float *scores, size_t count);
+
+  // Replace the per-channel affinities
+  void set_affinity(const uint32_t *channels, const float *shares, size_t count);
+
+  // Best `k` candidates at time `now` (ms), skipping `exclude`; sorted
+  // best-first, reused by the next call
+  std::vector<hit_t> &rank(size_t k, double now, const SlotSet &exclude = SlotSet());
+
+  candidate_reason_t reason(uint32_t slot, double now) const;
+
+  void clear();
+
+  size_t memory_usage() const;
+
+private:
+  void grow(uint32_t slot);
+
+  float popularity(uint32_t slot) const;
+  float recency(uint32_t slot, double now) const;
+  float affinity(uint32_t slot) const {
+    uint32_t channel = channel_[slot];
+    return channel < affinity_.size() ? affinity_[channel] : 0;
+  }
+
+  candidate_weights_t weights_;
+
+  std::vector<uint8_t> live_;
+  std::vector<float> watches_;
+  std::vector<float> completed_;
+  std::vector<float> similarity_;
+  std::vector<double> created_;
+  std::vector<uint32_t> channel_;
+  size_t live_count_ = 0;
+
+  // Slots with a non-zero similarity, so replacing the column is O(changed)
+  std::vector<uint32_t> similar_;
+
+  std::vector<float> affinity_;
+
+  TopK topk_;
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,245 @@
+#include "delta_log.h"
+
+#include <cstring>
+
+#include "index_file.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace bare_vector_index {
+
+namespace {
+
+const char magic[8] = {'B', 'V', 'D', 'E', 'L', 'T', 'A', '\0'};
+
+constexpr uint32_t delta_log_version = 1;
+constexpr size_t header_size = 16;
+constexpr size_t record_prefix = 8;
+constexpr size_t payload_fixed = 16;
+
+inline uint32_t
+load_u32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline void
+store_u32(uint8_t *p, uint32_t v) {
+  std::memcpy(p, &v, 4);
+}
+
+bool
+read_file(const char *path, std::vector<uint8_t> &out) {
+  out.clear();
+
+  std::FILE *file = std::fopen(path, "rb");
+  if (file == nullptr) return false;
+
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), file)) > 0) out.insert(out.end(), buf, buf + n);
+
+  std::fclose(file);
+  return true;
+}
+
+} // namespace
+
+DeltaLog::~DeltaLog() {
+  close();
+}
+
+void
+DeltaLog::close() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  release_records();
+}
+
+void
+DeltaLog::release_records() {
+  records_.clear();
+  records_.shrink_to_fit();
+  replay_.clear();
+  replay_.shrink_to_fit();
+}
+
+bool
+DeltaLog::open(const char *path, uint32_t dimension, std::string &error) {
+  close();
+
+  path_ = path;
+  dimension_ = dimension;
+  count_ = 0;
+
+  bool exists = read_file(path, replay_);
+  const uint8_t *data = replay_.data();
+  size_t size = replay_.size();
+
+  bool valid = exists && size >= header_size && std::memcmp(data, magic, sizeof(magic)) == 0 && load_u32(data + 8) == delta_log_version && load_u32(data + 12) == dimension;
+
+  if (!valid) {
+    replay_.clear();
+
+    uint8_t header[header_size];
+    std::memcpy(header, magic, sizeof(magic));
+    store_u32(header + 8, delta_log_version);
+    store_u32(header + 12, dimension);
+
+    std::FILE *file = std::fopen(path, "wb");
+    bool ok = file != nullptr && std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    if (file != nullptr && std::fclose(file) != 0) ok = false;
+    if (!ok) {
+      error = "Could not create delta log";
+      return false;
+    }
+
+    size = header_size;
+  }
+
+  size_t end = header_size;
+  size_t vector_bytes = size_t(dimension) * sizeof(float);
+
+  while (valid && size - end >= record_prefix) {
+    uint32_t len = load_u32(data + end);
+    uint32_t crc = load_u32(data + end + 4);
+    if (len < payload_fixed || len > size - end - record_prefix) break;
+
+    const uint8_t *payload = data + end + record_prefix;
+    if (crc32c(payload, len) != crc) break;
+
+    delta_op_t op = delta_op_t(payload[0]);
+    size_t id_len = load_u32(payload + 4);
+    size_t tag_len = load_u32(payload + 8);
+    size_t meta_len = load_u32(payload + 12);
+    size_t expected = payload_fixed + id_len + tag_len + meta_len + (op == delta_add ? vector_bytes : 0);
+    if ((op != delta_add && op != delta_remove) || expected != len) break;
+
+    const char *strings = reinterpret_cast<const char *>(payload + payload_fixed);
+
+    delta_record_t record;
+    record.op = op;
+    record.id = std::string_view(strings, id_len);
+    record.tag = std::string_view(strings + id_len, tag_len);
+    record.meta = std::string_view(strings + id_len + tag_len, meta_len);
+    record.vector = op == delta_add ? payload + payload_fixed + id_len + tag_len + meta_len : nullptr;
+    records_.push_back(record);
+
+    end += record_prefix + len;
+  }
+
+  file_ = std::fopen(path, "ab");
+  if (file_ == nullptr) {
+    release_records();
+    error = "Could not open delta log";
+    return false;
+  }
+
+  // Cut a torn or corrupt tail so new records follow the last intact one
+  if (end < size && !truncate(end, error)) {
+    close();
+    return false;
+  }
+
+  bytes_ = end;
+  count_ = records_.size();
+  return true;
+}
+
+bool
+DeltaLog::truncate(uint64_t size, std::string &error) {
+  std::fflush(file_);
+#if defined(_WIN32)
+  bool ok = _chsize_s(_fileno(file_), int64_t(size)) == 0;
+#else
+  bool ok = ftruncate(fileno(file_), off_t(size)) == 0;
+#endif
+  if (!ok) error = "Could not truncate delta log";
+  return ok;
+}
+
+bool
+DeltaLog::append(delta_op_t op, std::string_view id, std::string_view tag, std::string_view meta, const float *vector, std::string &error) {
+  if (file_ == nullptr) {
+    error = "Delta log is not open";
+    return false;
+  }
+
+  size_t vector_bytes = op == delta_add ? size_t(dimension_) * sizeof(float) : 0;
+  size_t len = payload_fixed + id.size() + tag.size() + meta.size() + vector_bytes;
+
+  scratch_.assign(record_prefix + payload_fixed, 0);
+  uint8_t *p = scratch_.data() + record_prefix;
+  p[0] = op;
+  store_u32(p + 4, uint32_t(id.size()));
+  store_u32(p + 8, uint32_t(tag.size()));
+  store_u32(p + 12, uint32_t(meta.size()));
+  scratch_.insert(scratch_.end(), id.begin(), id.end());
+  scratch_.insert(scratch_.end(), tag.begin(), tag.end());
+  scratch_.insert(scratch_.end(), meta.begin(), meta.end());
+  if (vector_bytes > 0) {
+    const uint8_t *v = reinterpret_cast<const uint8_t *>(vector);
+    scratch_.insert(scratch_.end(), v, v + vector_bytes);
+  }
+
+  store_u32(scratch_.data(), uint32_t(len));
+  store_u32(scratch_.data() + 4, crc32c(scratch_.data() + record_prefix, len));
+
+  if (std::fwrite(scratch_.data(), 1, scratch_.size(), file_) != scratch_.size() || std::fflush(file_) != 0) {
+    // Drop whatever part of the record reached the file
+    std::string ignored;
+    truncate(bytes_, ignored);
+    error = "Failed writing delta log";
+    return false;
+  }
+
+  bytes_ += scratch_.size();
+  count_++;
+  return true;
+}
+
+bool
+DeltaLog::append_add(std::string_view id, std::string_view tag, std::string_view meta, const float *vector, std::string &error) {
+  return append(delta_add, id, tag, meta, vector, error);
+}
+
+bool
+DeltaLog::append_remove(std::string_view id, std::string &error) {
+  return append(delta_remove, id, std::string_view(), std::string_view(), nullptr, error);
+}
+
+bool
+DeltaLog::sync(std::string &error) {
+  if (file_ == nullptr) return true;
+
+  bool ok = std::fflush(file_) == 0;
+#if defined(_WIN32)
+  ok = ok && _commit(_fileno(file_)) == 0;
+#else
+  ok = ok && fsync(fileno(file_)) == 0;
+#endif
+  if (!ok) error = "Failed syncing delta log";
+  return ok;
+}
+
+bool
+DeltaLog::reset(std::string &error) {
+  if (file_ == nullptr) return true;
+
+  release_records();
+  if (!truncate(header_size, error)) return false;
+
+  bytes_ = header_size;
+  count_ = 0;
+  return sync(error);
+}
+
+} // namespace bare_vector_index
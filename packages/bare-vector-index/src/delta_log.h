@@ -0,0 +1,93 @@
+/**
+ * Append-only log of index changes since the last full save.
+ *
+ *   header   16 bytes: magic "BVDELTA\0", version, dimension
+ *   record   u32 payload length, u32 CRC-32C of the payload, payload
+ *   payload  u8 op, 3 pad bytes, u32 id / tag / meta lengths, the three
+ *            strings, then `dimension` floats for an add
+ *
+ * Every append is one fwrite + fflush, so persisting a change costs the
+ * same however large the base file is. sync() adds the fsync for callers
+ * that batch durability. Records are applied by id with last-writer-wins
+ * semantics, which makes replaying a log over a base file that already
+ * contains it harmless: compaction can save the base and then reset() the
+ * log without the two steps having to be atomic.
+ *
+ * open() reads every intact record and truncates a torn tail (a crash
+ * mid-append), so the log is always left ending on a record boundary.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bare_vector_index {
+
+enum delta_op_t : uint8_t {
+  delta_add = 1,
+  delta_remove = 2,
+};
+
+struct delta_record_t {
+  delta_op_t op;
+  std::string_view id;
+  std::string_view tag;
+  std::string_view meta;
+  // `dimension` floats for delta_add (unaligned, copy before use)
+  const uint8_t *vector;
+};
+
+class DeltaLog {
+public:
+  DeltaLog() = default;
+  DeltaLog(const DeltaLog &) = delete;
+  DeltaLog &operator=(const DeltaLog &) = delete;
+
+  ~DeltaLog();
+
+  // Open or create the log at `path`. A log written for another dimension
+  // (or with a damaged header) is discarded and started afresh.
+  bool open(const char *path, uint32_t dimension, std::string &error);
+
+  uint32_t dimension() const { return dimension_; }
+
+  // Records read by open(); valid until release_records()
+  const std::vector<delta_record_t> &records() const { return records_; }
+  void release_records();
+
+  bool append_add(std::string_view id, std::string_view tag, std::string_view meta, const float *vector, std::string &error);
+  bool append_remove(std::string_view id, std::string &error);
+
+  // Flush appended records to stable storage
+  bool sync(std::string &error);
+
+  // Drop every record (after the base file has been rewritten)
+  bool reset(std::string &error);
+
+  // Log size in bytes and records appended since the last reset()
+  uint64_t bytes() const { return bytes_; }
+  uint64_t count() const { return count_; }
+
+  void close();
+
+private:
+  bool append(delta_op_t op, std::string_view id, std::string_view tag, std::string_view meta, const float *vector, std::string &error);
+  bool truncate(uint64_t size, std::string &error);
+
+  std::string path_;
+  std::FILE *file_ = nullptr;
+  uint32_t dimension_ = 0;
+  uint64_t bytes_ = 0;
+  uint64_t count_ = 0;
+
+  std::vector<uint8_t> replay_;
+  std::vector<delta_record_t> records_;
+  std::vector<uint8_t> scratch_;
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,348 @@
+#include "flat_index.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "batch.h"
+#include "hybrid.h"
+#include "simd.h"
+
+namespace bare_vector_index {
+
+namespace {
+
+struct float_scorer_t {
+  const float *rows;
+  const float *queries;
+  size_t count;
+  size_t stride;
+  const SlotSet *exclude;
+
+  size_t items() const { return count; }
+  bool accept(size_t item) const { return !exclude->has(uint32_t(item)); }
+  uint32_t slot(size_t item) const { return uint32_t(item); }
+
+  void score(size_t item, size_t q, float *out) const {
+    dot_f32_x4(queries + q * stride, stride, rows + item * stride, stride, out);
+  }
+};
+
+struct int8_scorer_t {
+  const int8_t *codes;
+  const float *scales;
+  const int8_t *queries;
+  const float *query_scales;
+  size_t count;
+  size_t stride;
+  const SlotSet *exclude;
+
+  size_t items() const { return count; }
+  bool accept(size_t item) const { return !exclude->has(uint32_t(item)); }
+  uint32_t slot(size_t item) const { return uint32_t(item); }
+
+  void score(size_t item, size_t q, float *out) const {
+    const int8_t *row = codes + item * stride;
+    for (size_t j = 0; j < batch_group; j++) {
+      out[j] = float(dot_i8(queries + (q + j) * stride, row, stride)) * query_scales[q + j] * scales[item];
+    }
+  }
+};
+
+struct binary_scorer_t {
+  const uint64_t *bits;
+  const uint64_t *queries;
+  size_t count;
+  size_t words;
+  float scale;
+  const SlotSet *exclude;
+
+  size_t items() const { return count; }
+  bool accept(size_t item) const { return !exclude->has(uint32_t(item)); }
+  uint32_t slot(size_t item) const { return uint32_t(item); }
+
+  void score(size_t item, size_t q, float *out) const {
+    const uint64_t *row = bits + item * words;
+    for (size_t j = 0; j < batch_group; j++) {
+      out[j] = 1.0f - float(hamming(queries + (q + j) * words, row, words)) * scale;
+    }
+  }
+};
+
+} // namespace
+
+FlatIndex::FlatIndex(size_t dimension, quantization_t quantization, uint32_t rerank)
+    : dimension_(dimension),
+      stride_(padded_dimension(dimension)),
+      code_stride_(padded_codes(dimension)),
+      word_stride_(padded_words(dimension)),
+      quantization_(quantization),
+      rerank_(quantization == quant_none ? 0 : rerank) {
+  query_.reserve(stride_, 0);
+  if (quantization_ == quant_int8) query_codes_.reserve(code_stride_, 0);
+  if (quantization_ == quant_binary) query_bits_.reserve(word_stride_, 0);
+}
+
+void
+FlatIndex::reserve(size_t count) {
+  if (count <= capacity_) return;
+
+  if (has_full()) floats_.reserve(count * stride_, count_ * stride_);
+  if (quantization_ == quant_int8) {
+    codes_.reserve(count * code_stride_, count_ * code_stride_);
+    scales_.reserve(count, count_);
+  }
+  if (quantization_ == quant_binary) bits_.reserve(count * word_stride_, count_ * word_stride_);
+
+  capacity_ = count;
+}
+
+float
+FlatIndex::quantize_int8(const float *row, int8_t *codes) const {
+  float max = 0;
+  for (size_t i = 0; i < dimension_; i++) max = std::fmax(max, std::fabs(row[i]));
+
+  std::memset(codes, 0, code_stride_);
+  if (max == 0) return 0;
+
+  // Symmetric [-127, 127] keeps the NEON int16 accumulation exact
+  float inv = 127.0f / max;
+  for (size_t i = 0; i < dimension_; i++) codes[i] = int8_t(std::lrintf(row[i] * inv));
+  return max / 127.0f;
+}
+
+void
+FlatIndex::quantize_binary(const float *row, uint64_t *bits) const {
+  std::memset(bits, 0, word_stride_ * sizeof(uint64_t));
+  for (size_t i = 0; i < dimension_; i++) {
+    if (row[i] > 0) bits[i / 64] |= uint64_t(1) << (i % 64);
+  }
+}
+
+void
+FlatIndex::store(uint32_t slot, const float *vector) {
+  // Zero vectors stay zero and score 0 against everything, matching the JS
+  // cosineSimilarity fallback
+  float *normalized = query_.data();
+  normalize_f32(normalized, vector, dimension_, stride_);
+
+  if (has_full()) std::memcpy(floats_.data() + size_t(slot) * stride_, normalized, stride_ * sizeof(float));
+
+  if (quantization_ == quant_int8) {
+    scales_.data()[slot] = quantize_int8(normalized, codes_.data() + size_t(slot) * code_stride_);
+  } else if (quantization_ == quant_binary) {
+    quantize_binary(normalized, bits_.data() + size_t(slot) * word_stride_);
+  }
+}
+
+uint32_t
+FlatIndex::add(const float *vector) {
+  if (count_ == capacity_) reserve(count_ < 64 ? 64 : count_ * 2);
+
+  uint32_t slot = uint32_t(count_++);
+  store(slot, vector);
+  return slot;
+}
+
+void
+FlatIndex::set(uint32_t slot, const float *vector) {
+  store(slot, vector);
+}
+
+void
+FlatIndex::move_row(uint32_t to, uint32_t from) {
+  if (has_full()) {
+    std::memcpy(floats_.data() + size_t(to) * stride_, row(from), stride_ * sizeof(float));
+  }
+  if (quantization_ == quant_int8) {
+    std::memcpy(codes_.data() + size_t(to) * code_stride_, codes_.data() + size_t(from) * code_stride_, code_stride_);
+    scales_.data()[to] = scales_.data()[from];
+  } else if (quantization_ == quant_binary) {
+    std::memcpy(bits_.data() + size_t(to) * word_stride_, bits_.data() + size_t(from) * word_stride_, word_stride_ * sizeof(uint64_t));
+  }
+}
+
+int64_t
+FlatIndex::remove(uint32_t slot) {
+  uint32_t last = uint32_t(count_ - 1);
+  count_--;
+  if (slot == last) return -1;
+
+  move_row(slot, last);
+  return last;
+}
+
+void
+FlatIndex::clear() {
+  count_ = 0;
+  capacity_ = 0;
+  floats_.release();
+  codes_.release();
+  scales_.release();
+  bits_.release();
+}
+
+void
+FlatIndex::get(uint32_t slot, float *out) const {
+  if (has_full()) {
+    std::memcpy(out, row(slot), dimension_ * sizeof(float));
+    return;
+  }
+
+  if (quantization_ == quant_int8) {
+    const int8_t *codes = codes_.data() + size_t(slot) * code_stride_;
+    float scale = scales_.data()[slot];
+    for (size_t i = 0; i < dimension_; i++) out[i] = codes[i] * scale;
+  } else {
+    const uint64_t *bits = bits_.data() + size_t(slot) * word_stride_;
+    float unit = float(1.0 / std::sqrt(double(dimension_)));
+    for (size_t i = 0; i < dimension_; i++) out[i] = (bits[i / 64] >> (i % 64)) & 1 ? unit : -unit;
+  }
+}
+
+void
+FlatIndex::scan_int8(size_t k, const SlotSet &exclude) {
+  const int8_t *q = query_codes_.data();
+  const int8_t *codes = codes_.data();
+  const float *scales = scales_.data();
+
+  topk_.reset(k);
+  float threshold = topk_.threshold();
+  for (size_t i = 0; i < count_; i++) {
+    float score = float(dot_i8(q, codes + i * code_stride_, code_stride_)) * scales[i] * query_scale_;
+    if (score > threshold && !exclude.has(uint32_t(i))) {
+      topk_.push(score, uint32_t(i));
+      threshold = topk_.threshold();
+    }
+  }
+}
+
+void
+FlatIndex::scan_binary(size_t k, const SlotSet &exclude) {
+  const uint64_t *q = query_bits_.data();
+  const uint64_t *bits = bits_.data();
+
+  // Sign agreement mapped onto [-1, 1], a coarse cosine estimate
+  float scale = 2.0f / float(dimension_);
+
+  topk_.reset(k);
+  float threshold = topk_.threshold();
+  for (size_t i = 0; i < count_; i++) {
+    float score = 1.0f - float(hamming(q, bits + i * word_stride_, word_stride_)) * scale;
+    if (score > threshold && !exclude.has(uint32_t(i))) {
+      topk_.push(score, uint32_t(i));
+      threshold = topk_.threshold();
+    }
+  }
+}
+
+const std::vector<hit_t> &
+FlatIndex::search(const float *query, size_t k, const SlotSet &exclude) {
+  float *q = query_.data();
+  normalize_f32(q, query, dimension_, stride_);
+
+  if (k > count_) k = count_;
+
+  if (quantization_ == quant_none) {
+    topk_.reset(k);
+
+    const float *rows = floats_.data();
+    float threshold = topk_.threshold();
+    for (size_t i = 0; i < count_; i++) {
+      float score = dot_f32(q, rows + i * stride_, stride_);
+      if (score > threshold && !exclude.has(uint32_t(i))) {
+        topk_.push(score, uint32_t(i));
+        threshold = topk_.threshold();
+      }
+    }
+
+    return topk_.finish();
+  }
+
+  size_t first = has_full() ? k * rerank_ : k;
+  if (first > count_) first = count_;
+
+  if (quantization_ == quant_int8) {
+    query_scale_ = quantize_int8(q, query_codes_.data());
+    scan_int8(first, exclude);
+  } else {
+    quantize_binary(q, query_bits_.data());
+    scan_binary(first, exclude);
+  }
+
+  if (!has_full()) return topk_.finish();
+
+  // Re-rank the quantised shortlist with the exact float rows
+  candidates_ = topk_.finish();
+  topk_.reset(k);
+  for (const hit_t &c : candidates_) topk_.push(dot_f32(q, row(c.slot), stride_), c.slot);
+
+  return topk_.finish();
+}
+
+float
+FlatIndex::similarity(uint32_t slot) const {
+  if (has_full()) return dot_f32(query_.data(), row(slot), stride_);
+
+  if (quantization_ == quant_int8) {
+    return float(dot_i8(query_codes_.data(), codes_.data() + size_t(slot) * code_stride_, code_stride_)) * scales_.data()[slot] * query_scale_;
+  }
+
+  return 1.0f - float(hamming(query_bits_.data(), bits_.data() + size_t(slot) * word_stride_, word_stride_)) * (2.0f / float(dimension_));
+}
+
+const std::vector<hit_t> &
+FlatIndex::search_hybrid(const float *query, size_t k, const SlotSet &exclude, std::vector<hit_t> &text_hits, float weight) {
+  candidates_ = search(query, k, exclude);
+
+  return fuse_hybrid(
+    candidates_, text_hits, weight, k, SIZE_MAX,
+    [&](uint32_t slot) { return similarity(slot); },
+    [&](uint32_t slot) { return slot < count_ && !exclude.has(slot); },
+    topk_
+  );
+}
+
+void
+FlatIndex::search_batch(const float *queries, size_t count, size_t k, const SlotSet &exclude, ThreadPool &pool, uint32_t *slots, float *scores, uint32_t *counts) const {
+  // Padding queries stay zero; their heaps are never read
+  size_t padded = batch_padded(count);
+  AlignedBuffer<float> normalized;
+  normalized.reserve(padded * stride_, 0);
+  for (size_t q = 0; q < count; q++) normalize_f32(normalized.data() + q * stride_, queries + q * dimension_, dimension_, stride_);
+
+  if (has_full()) {
+    float_scorer_t scorer = {floats_.data(), normalized.data(), count_, stride_, &exclude};
+    search_blocked(pool, scorer, count, k, stride_ * sizeof(float), slots, scores, counts);
+  } else if (quantization_ == quant_int8) {
+    AlignedBuffer<int8_t> codes;
+    AlignedBuffer<float> scales;
+    codes.reserve(padded * code_stride_, 0);
+    scales.reserve(padded, 0);
+    for (size_t q = 0; q < count; q++) scales.data()[q] = quantize_int8(normalized.data() + q * stride_, codes.data() + q * code_stride_);
+
+    int8_scorer_t scorer = {codes_.data(), scales_.data(), codes.data(), scales.data(), count_, code_stride_, &exclude};
+    search_blocked(pool, scorer, count, k, code_stride_, slots, scores, counts);
+  } else {
+    AlignedBuffer<uint64_t> bits;
+    bits.reserve(padded * word_stride_, 0);
+    for (size_t q = 0; q < count; q++) quantize_binary(normalized.data() + q * stride_, bits.data() + q * word_stride_);
+
+    binary_scorer_t scorer = {bits_.data(), bits.data(), count_, word_stride_, 2.0f / float(dimension_), &exclude};
+    search_blocked(pool, scorer, count, k, word_stride_ * sizeof(uint64_t), slots, scores, counts);
+  }
+}
+
+size_t
+FlatIndex::bytes_per_vector() const {
+  size_t bytes = has_full() ? stride_ * sizeof(float) : 0;
+  if (quantization_ == quant_int8) bytes += code_stride_ + sizeof(float);
+  if (quantization_ == quant_binary) bytes += word_stride_ * sizeof(uint64_t);
+  return bytes;
+}
+
+size_t
+FlatIndex::memory_usage() const {
+  return floats_.capacity() * sizeof(float) + codes_.capacity() + scales_.capacity() * sizeof(float) + bits_.capacity() * sizeof(uint64_t);
+}
+
+} // namespace bare_vector_index
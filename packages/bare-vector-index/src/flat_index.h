@@ -0,0 +1,135 @@
+/**
+ * Exact cosine-similarity index over a contiguous matrix.
+ *
+ * Vectors are L2-normalised on insert, so search is a plain dot product per
+ * row. Rows live back to back in 64-byte aligned blocks with the stride
+ * padded to a whole number of cache lines. Slots are dense: removing a row
+ * moves the last row into its place and reports which slot moved, so the
+ * caller can keep its id <-> slot map in step.
+ *
+ * Rows can also be kept quantised: int8 (one code per dimension plus a
+ * per-row scale, scored with integer dot products) or binary (one sign bit
+ * per dimension, scored by Hamming distance). With a rerank factor the
+ * float rows are kept as well and the best k * rerank candidates of the
+ * quantised pass are re-scored exactly; without one only the codes are
+ * stored and scores are the quantised approximations.
+ *
+ * Searches take a SlotSet of slots to skip, tested only for rows that
+ * would enter the top k, and search_hybrid() fuses the scan with BM25
+ * scores from a TextIndex kept over the same slots (hybrid.h).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "slot_set.h"
+#include "thread_pool.h"
+#include "topk.h"
+
+namespace bare_vector_index {
+
+enum quantization_t : uint32_t {
+  quant_none = 0,
+  quant_int8 = 1,
+  quant_binary = 2,
+};
+
+class FlatIndex {
+public:
+  // `rerank` is ignored for quant_none
+  explicit FlatIndex(size_t dimension, quantization_t quantization = quant_none, uint32_t rerank = 0);
+
+  size_t dimension() const { return dimension_; }
+  size_t stride() const { return stride_; }
+  size_t size() const { return count_; }
+  quantization_t quantization() const { return quantization_; }
+
+  // Full-precision rows are stored (always true for quant_none)
+  bool has_full() const { return quantization_ == quant_none || rerank_ > 0; }
+
+  void reserve(size_t count);
+
+  // Append a vector of `dimension()` floats; returns its slot
+  uint32_t add(const float *vector);
+
+  // Overwrite the vector stored at `slot`
+  void set(uint32_t slot, const float *vector);
+
+  // Remove `slot`. Returns the slot whose row was moved into it, or -1 when
+  // `slot` was the last row.
+  int64_t remove(uint32_t slot);
+
+  void clear();
+
+  // Normalised float row for `slot` (stride() floats, zero padded); only
+  // valid when has_full()
+  const float *row(uint32_t slot) const { return floats_.data() + size_t(slot) * stride_; }
+
+  // Copy the stored (normalised) vector for `slot` into `out`, dequantised
+  // when only codes are kept
+  void get(uint32_t slot, float *out) const;
+
+  // Best `k` rows by cosine similarity to `query` that are not in
+  // `exclude`, best first
+  const std::vector<hit_t> &search(const float *query, size_t k, const SlotSet &exclude = SlotSet());
+
+  // search() fused with the BM25 scores of `text_hits` (TextIndex::score()
+  // over this index's slots; reordered in place), `weight` being the share
+  // of the text score as described in hybrid.h
+  const std::vector<hit_t> &search_hybrid(const float *query, size_t k, const SlotSet &exclude, std::vector<hit_t> &text_hits, float weight);
+
+  // Best `k` rows not in `exclude` for each of `count` queries (back to
+  // back, dimension() floats each), scanned as one blocked matrix product
+  // on `pool`. Scores use the float rows when they are kept (so quantised
+  // indexes with a rerank factor return exact results) and the codes
+  // otherwise. Results are packed per query as described in batch.h.
+  void search_batch(const float *queries, size_t count, size_t k, const SlotSet &exclude, ThreadPool &pool, uint32_t *slots, float *scores, uint32_t *counts) const;
+
+  // Storage per row in bytes, and for the whole index
+  size_t bytes_per_vector() const;
+  size_t memory_usage() const;
+
+private:
+  void store(uint32_t slot, const float *vector);
+  void move_row(uint32_t to, uint32_t from);
+
+  // Quantise a normalised float row into codes; returns the scale
+  float quantize_int8(const float *row, int8_t *codes) const;
+  void quantize_binary(const float *row, uint64_t *bits) const;
+
+  // First pass over the quantised rows into topk_
+  void scan_int8(size_t k, const SlotSet &exclude);
+  void scan_binary(size_t k, const SlotSet &exclude);
+
+  // Score of `slot` against the query of the last search(), on the same
+  // scale as that search's results
+  float similarity(uint32_t slot) const;
+
+  size_t dimension_;
+  size_t stride_;
+  size_t code_stride_;
+  size_t word_stride_;
+  quantization_t quantization_;
+  uint32_t rerank_;
+  size_t count_ = 0;
+  size_t capacity_ = 0;
+
+  AlignedBuffer<float> floats_;
+  AlignedBuffer<int8_t> codes_;
+  AlignedBuffer<float> scales_;
+  AlignedBuffer<uint64_t> bits_;
+
+  AlignedBuffer<float> query_;
+  AlignedBuffer<int8_t> query_codes_;
+  AlignedBuffer<uint64_t> query_bits_;
+  float query_scale_ = 0;
+
+  TopK topk_;
+  std::vector<hit_t> candidates_;
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,811 @@
+#include "hnsw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "batch.h"
+#include "hybrid.h"
+#include "simd.h"
+
+namespace bare_vector_index {
+
+namespace {
+
+// candidates_: best on top
+bool
+best_first(const hit_t &a, const hit_t &b) {
+  return a.score < b.score;
+}
+
+// results_: worst on top
+bool
+worst_first(const hit_t &a, const hit_t &b) {
+  return a.score > b.score;
+}
+
+constexpr int max_level_cap = 15;
+
+} // namespace
+
+HnswIndex::HnswIndex(size_t dimension, const hnsw_params_t &params)
+    : dimension_(dimension),
+      stride_(padded_dimension(dimension)),
+      params_(params),
+      m0_(params.m * 2),
+      level_mult_(1.0 / std::log(double(params.m < 2 ? 2 : params.m))),
+      rng_(params.seed),
+      rows_(stride_) {
+  query_.reserve(stride_, 0);
+}
+
+float
+HnswIndex::similarity(const float *q, uint32_t node) const {
+  return dot_f32(q, row(node), stride_);
+}
+
+void
+HnswIndex::store(float *dst, const float *vector) const {
+  normalize_f32(dst, vector, dimension_, stride_);
+}
+
+int
+HnswIndex::random_level() {
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double r = uniform(rng_);
+  if (r <= 0) r = 1e-12;
+  int level = int(-std::log(r) * level_mult_);
+  return level > max_level_cap ? max_level_cap : level;
+}
+
+void
+HnswIndex::reserve(size_t count) {
+  rows_.ensure(count);
+  state_.reserve(count);
+  levels_.reserve(count);
+  tags_.reserve(count);
+  links0_.reserve(count * (m0_ + 1));
+  upper_.reserve(count);
+  member_pos_.reserve(count);
+  visited_.reserve(count);
+}
+
+void
+HnswIndex::begin_visit() {
+  if (visited_.size() < count_) visited_.resize(count_, 0);
+  if (++visit_mark_ == 0) {
+    std::fill(visited_.begin(), visited_.end(), 0);
+    visit_mark_ = 1;
+  }
+}
+
+bool
+HnswIndex::visit(uint32_t node) {
+  if (visited_[node] == visit_mark_) return false;
+  visited_[node] = visit_mark_;
+  return true;
+}
+
+uint32_t
+HnswIndex::greedy(const float *q, uint32_t entry, int from_level, int to_level) {
+  uint32_t cur = entry;
+  float best = similarity(q, cur);
+
+  for (int level = from_level; level > to_level; level--) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      const uint32_t *list = links(cur, level);
+      for (uint32_t i = 1; i <= list[0]; i++) {
+        float s = similarity(q, list[i]);
+        if (s > best) {
+          best = s;
+          cur = list[i];
+          changed = true;
+        }
+      }
+    }
+  }
+
+  return cur;
+}
+
+void
+HnswIndex::search_level(const float *q, uint32_t entry, size_t ef, int level, int64_t tag, const SlotSet &exclude) {
+  candidates_.clear();
+  results_.clear();
+  begin_visit();
+
+  auto accept = [&](uint32_t node) {
+    return state_[node] == state_live && (tag == hnsw_no_tag || tags_[node] == uint32_t(tag)) && !exclude.has(node);
+  };
+
+  float s = similarity(q, entry);
+  visit(entry);
+  candidates_.push_back({s, entry});
+  if (accept(entry)) results_.push_back({s, entry});
+
+  float lower = results_.empty() ? -INFINITY : s;
+
+  while (!candidates_.empty()) {
+    hit_t current = candidates_.front();
+    if (current.score < lower && results_.size() >= ef) break;
+
+    std::pop_heap(candidates_.begin(), candidates_.end(), best_first);
+    candidates_.pop_back();
+
+    const uint32_t *list = links(current.slot, level);
+    for (uint32_t i = 1; i <= list[0]; i++) {
+      uint32_t next = list[i];
+      if (!visit(next)) continue;
+
+      float score = similarity(q, next);
+      if (results_.size() < ef || score > lower) {
+        candidates_.push_back({score, next});
+        std::push_heap(candidates_.begin(), candidates_.end(), best_first);
+
+        if (accept(next)) {
+          results_.push_back({score, next});
+          std::push_heap(results_.begin(), results_.end(), worst_first);
+          if (results_.size() > ef) {
+            std::pop_heap(results_.begin(), results_.end(), worst_first);
+            results_.pop_back();
+          }
+        }
+
+        if (!results_.empty()) lower = results_.front().score;
+      }
+    }
+  }
+}
+
+void
+HnswIndex::select_neighbors(candidates_t &candidates, size_t max, std::vector<uint32_t> &out) {
+  out.clear();
+
+  for (const hit_t &c : candidates) {
+    if (out.size() >= max) break;
+
+    const float *v = row(c.slot);
+    bool keep = true;
+    for (uint32_t kept : out) {
+      if (similarity(v, kept) > c.score) {
+        keep = false;
+        break;
+      }
+    }
+
+    if (keep) out.push_back(c.slot);
+  }
+}
+
+void
+HnswIndex::connect(uint32_t node, int level, uint32_t neighbor) {
+  uint32_t *list = links(node, level);
+  uint32_t max = max_links(level);
+
+  for (uint32_t i = 1; i <= list[0]; i++) {
+    if (list[i] == neighbor) return;
+  }
+
+  if (list[0] < max) {
+    list[++list[0]] = neighbor;
+    return;
+  }
+
+  // Full: re-select among the existing links plus the newcomer
+  const float *v = row(node);
+  scratch_.clear();
+  for (uint32_t i = 1; i <= list[0]; i++) scratch_.push_back({similarity(v, list[i]), list[i]});
+  scratch_.push_back({similarity(v, neighbor), neighbor});
+  std::sort(scratch_.begin(), scratch_.end(), worst_first);
+
+  select_neighbors(scratch_, max, selected_);
+
+  list[0] = uint32_t(selected_.size());
+  for (size_t i = 0; i < selected_.size(); i++) list[i + 1] = selected_[i];
+}
+
+uint32_t
+HnswIndex::add(const float *vector, uint32_t tag) {
+  uint32_t node;
+  if (!free_.empty()) {
+    node = free_.back();
+    free_.pop_back();
+  } else {
+    rows_.ensure(count_ + 1);
+
+    node = uint32_t(count_++);
+    state_.push_back(state_free);
+    levels_.push_back(0);
+    tags_.push_back(0);
+    links0_.resize(count_ * (m0_ + 1), 0);
+    upper_.emplace_back();
+    member_pos_.push_back(0);
+  }
+
+  if (node < file_rows_) file_rows_written_ = true;
+  store(row(node), vector);
+
+  int level = random_level();
+  state_[node] = state_live;
+  levels_[node] = uint8_t(level);
+  links(node, 0)[0] = 0;
+  upper_[node].assign(size_t(level) * (params_.m + 1), 0);
+  add_member(node, tag);
+  live_++;
+
+  if (entry_ == no_node) {
+    entry_ = node;
+    max_level_ = level;
+    return node;
+  }
+
+  const float *q = row(node);
+  uint32_t cur = greedy(q, entry_, max_level_, level);
+
+  for (int l = std::min(level, max_level_); l >= 0; l--) {
+    search_level(q, cur, params_.ef_construction, l, hnsw_no_tag, SlotSet());
+    if (results_.empty()) continue;
+
+    std::sort(results_.begin(), results_.end(), worst_first);
+    cur = results_.front().slot;
+
+    select_neighbors(results_, params_.m, selected_);
+
+    // selected_ is reused by connect(), so take a copy first
+    std::vector<uint32_t> neighbors(selected_);
+    uint32_t *list = links(node, l);
+    list[0] = uint32_t(neighbors.size());
+    for (size_t i = 0; i < neighbors.size(); i++) list[i + 1] = neighbors[i];
+
+    for (uint32_t n : neighbors) connect(n, l, node);
+  }
+
+  if (level > max_level_) {
+    entry_ = node;
+    max_level_ = level;
+  }
+
+  return node;
+}
+
+void
+HnswIndex::pick_entry() {
+  entry_ = no_node;
+  max_level_ = -1;
+
+  for (uint32_t n = 0; n < count_; n++) {
+    if (state_[n] == state_live && int(levels_[n]) > max_level_) {
+      entry_ = n;
+      max_level_ = levels_[n];
+    }
+  }
+}
+
+bool
+HnswIndex::remove(uint32_t label) {
+  if (!live(label)) return false;
+
+  state_[label] = state_deleted;
+  live_--;
+  remove_member(label);
+  pending_.push_back(label);
+
+  // The entry point must stay live so every search starts inside the graph
+  // that repair() keeps connected
+  if (label == entry_) pick_entry();
+
+  return true;
+}
+
+void
+HnswIndex::repair_links(uint32_t node, int level) {
+  uint32_t *list = links(node, level);
+
+  bool dirty = false;
+  for (uint32_t i = 1; i <= list[0]; i++) {
+    if (state_[list[i]] != state_live) {
+      dirty = true;
+      break;
+    }
+  }
+  if (!dirty) return;
+
+  // Tombstones only need their dead edges dropped; they are freed later
+  if (state_[node] != state_live) {
+    uint32_t kept = 0;
+    for (uint32_t i = 1; i <= list[0]; i++) {
+      if (state_[list[i]] == state_live) list[++kept] = list[i];
+    }
+    list[0] = kept;
+    return;
+  }
+
+  // Live node: replace each dead neighbour with that neighbour's live links
+  const float *v = row(node);
+  begin_visit();
+  visit(node);
+  scratch_.clear();
+
+  for (uint32_t i = 1; i <= list[0]; i++) {
+    uint32_t n = list[i];
+
+    if (state_[n] == state_live) {
+      if (visit(n)) scratch_.push_back({similarity(v, n), n});
+      continue;
+    }
+
+    if (levels_[n] < level) continue;
+
+    const uint32_t *dead = links(n, level);
+    for (uint32_t j = 1; j <= dead[0]; j++) {
+      uint32_t c = dead[j];
+      if (state_[c] == state_live && visit(c)) scratch_.push_back({similarity(v, c), c});
+    }
+  }
+
+  std::sort(scratch_.begin(), scratch_.end(), worst_first);
+  select_neighbors(scratch_, max_links(level), selected_);
+
+  list[0] = uint32_t(selected_.size());
+  for (size_t i = 0; i < selected_.size(); i++) list[i + 1] = selected_[i];
+}
+
+size_t
+HnswIndex::repair(size_t budget) {
+  if (sweeping_.empty()) {
+    if (pending_.empty()) return 0;
+    sweeping_.swap(pending_);
+    repair_cursor_ = 0;
+  }
+
+  size_t end = std::min(count_, repair_cursor_ + budget);
+  for (size_t n = repair_cursor_; n < end; n++) {
+    if (state_[n] == state_free) continue;
+    for (int l = levels_[n]; l >= 0; l--) repair_links(uint32_t(n), l);
+  }
+  repair_cursor_ = end;
+
+  if (repair_cursor_ >= count_) {
+    // Every node has been visited since these were deleted: nothing links
+    // to them any more, so their slots can be reused
+    for (uint32_t n : sweeping_) {
+      state_[n] = state_free;
+      links(n, 0)[0] = 0;
+      upper_[n].clear();
+      upper_[n].shrink_to_fit();
+      free_.push_back(n);
+    }
+    sweeping_.clear();
+    repair_cursor_ = 0;
+  }
+
+  return tombstones();
+}
+
+void
+HnswIndex::get(uint32_t label, float *out) const {
+  std::memcpy(out, row(label), dimension_ * sizeof(float));
+}
+
+void
+HnswIndex::add_member(uint32_t node, uint32_t tag) {
+  if (tag >= members_.size()) members_.resize(size_t(tag) + 1);
+
+  tags_[node] = tag;
+  member_pos_[node] = uint32_t(members_[tag].size());
+  members_[tag].push_back(node);
+}
+
+void
+HnswIndex::remove_member(uint32_t node) {
+  std::vector<uint32_t> &list = members_[tags_[node]];
+  uint32_t pos = member_pos_[node];
+  uint32_t last = list.back();
+
+  list[pos] = last;
+  member_pos_[last] = pos;
+  list.pop_back();
+}
+
+const std::vector<hit_t> &
+HnswIndex::search_exact(const float *query, size_t k, int64_t tag, const SlotSet &exclude) {
+  float *q = query_.data();
+  store(q, query);
+  topk_.reset(k);
+
+  if (tag != hnsw_no_tag) {
+    if (size_t(tag) < members_.size()) {
+      for (uint32_t n : members_[size_t(tag)]) {
+        if (!exclude.has(n)) topk_.push(similarity(q, n), n);
+      }
+    }
+  } else {
+    for (uint32_t n = 0; n < count_; n++) {
+      if (state_[n] == state_live && !exclude.has(n)) topk_.push(similarity(q, n), n);
+    }
+  }
+
+  return topk_.finish();
+}
+
+void
+HnswIndex::search_batch(const float *queries, size_t count, size_t k, int64_t tag, const SlotSet &exclude, ThreadPool &pool, uint32_t *slots, float *scores, uint32_t *counts) const {
+  // Every live node, or just the members of `tag`
+  struct scorer_t {
+    const HnswIndex *index;
+    const std::vector<uint32_t> *members;
+    const float *queries;
+    const SlotSet *exclude;
+
+    size_t items() const { return members ? members->size() : index->count_; }
+
+    bool accept(size_t item) const {
+      return (members || index->state_[item] == state_live) && !exclude->has(slot(item));
+    }
+
+    uint32_t slot(size_t item) const { return members ? (*members)[item] : uint32_t(item); }
+
+    void score(size_t item, size_t q, float *out) const {
+      dot_f32_x4(queries + q * index->stride_, index->stride_, index->row(slot(item)), index->stride_, out);
+    }
+  };
+
+  static const std::vector<uint32_t> no_members;
+
+  scorer_t scorer = {this, nullptr, nullptr, &exclude};
+  if (tag != hnsw_no_tag) scorer.members = size_t(tag) < members_.size() ? &members_[size_t(tag)] : &no_members;
+
+  AlignedBuffer<float> normalized;
+  normalized.reserve(batch_padded(count) * stride_, 0);
+  for (size_t q = 0; q < count; q++) store(normalized.data() + q * stride_, queries + q * dimension_);
+  scorer.queries = normalized.data();
+
+  search_blocked(pool, scorer, count, k, stride_ * sizeof(float), slots, scores, counts);
+}
+
+const std::vector<hit_t> &
+HnswIndex::search(const float *query, size_t k, size_t ef, int64_t tag, const SlotSet &exclude) {
+  if (tag != hnsw_no_tag) {
+    if (size_t(tag) >= members_.size() || members_[size_t(tag)].size() <= exact_tag_threshold) {
+      return search_exact(query, k, tag, exclude);
+    }
+  }
+
+  float *q = query_.data();
+  store(q, query);
+  topk_.reset(k);
+
+  if (entry_ == no_node || k == 0) return topk_.finish();
+
+  if (ef == 0) ef = params_.ef_search;
+  if (ef < k) ef = k;
+
+  if (tag != hnsw_no_tag) {
+    // Widen the beam in proportion to how much of the graph the filter hides
+    size_t members = members_[size_t(tag)].size();
+    size_t widen = std::min<size_t>((live_ + members - 1) / members, 16);
+    ef *= widen;
+  }
+
+  // Room for the excluded nodes the walk will pass over, up to the same cap
+  if (!exclude.empty()) ef = std::min(ef + exclude.count(), ef * 16);
+
+  uint32_t cur = greedy(q, entry_, max_level_, 0);
+  search_level(q, cur, ef, 0, tag, exclude);
+
+  for (const hit_t &h : results_) topk_.push(h.score, h.slot);
+  return topk_.finish();
+}
+
+const std::vector<hit_t> &
+HnswIndex::search_hybrid(const float *query, size_t k, size_t ef, int64_t tag, const SlotSet &exclude, std::vector<hit_t> &text_hits, float weight) {
+  scratch_ = ef == UINT32_MAX ? search_exact(query, k, tag, exclude) : search(query, k, ef, tag, exclude);
+
+  // search() left the normalised query in query_
+  const float *q = query_.data();
+
+  return fuse_hybrid(
+    scratch_, text_hits, weight, k, ef == UINT32_MAX ? SIZE_MAX : hybrid_text_candidates,
+    [&](uint32_t node) { return similarity(q, node); },
+    [&](uint32_t node) {
+      return live(node) && (tag == hnsw_no_tag || tags_[node] == uint32_t(tag)) && !exclude.has(node);
+    },
+    topk_
+  );
+}
+
+size_t
+HnswIndex::memory_usage() const {
+  size_t bytes = rows_.heap_bytes();
+  bytes += state_.capacity() + levels_.capacity();
+  bytes += (tags_.capacity() + member_pos_.capacity() + visited_.capacity()) * sizeof(uint32_t);
+  bytes += links0_.capacity() * sizeof(uint32_t);
+  for (const auto &u : upper_) bytes += u.capacity() * sizeof(uint32_t) + sizeof(u);
+  for (const auto &m : members_) bytes += m.capacity() * sizeof(uint32_t) + sizeof(m);
+  return bytes;
+}
+
+void
+HnswIndex::clear() {
+  count_ = 0;
+  live_ = 0;
+  entry_ = no_node;
+  max_level_ = -1;
+  repair_cursor_ = 0;
+
+  rows_.clear();
+  state_.clear();
+  levels_.clear();
+  tags_.clear();
+  links0_.clear();
+  upper_.clear();
+  free_.clear();
+  members_.clear();
+  member_pos_.clear();
+  pending_.clear();
+  sweeping_.clear();
+  visited_.clear();
+
+  file_.reset();
+  file_ids_ = StringTable();
+  file_meta_ = StringTable();
+  file_tags_ = StringTable();
+  file_rows_ = 0;
+  file_rows_written_ = false;
+}
+
+namespace {
+
+// Graph section: fixed header, then per-node arrays (8-byte aligned)
+struct graph_header_t {
+  uint32_t m;
+  uint32_t ef_construction;
+  uint32_t ef_search;
+  uint32_t seed;
+  uint32_t entry;
+  uint32_t max_level;
+  uint32_t m0;
+  uint32_t reserved;
+};
+
+inline size_t
+align8(size_t n) {
+  return (n + 7) & ~size_t(7);
+}
+
+} // namespace
+
+void
+HnswIndex::write_graph(IndexFileWriter &writer) const {
+  static const uint8_t zero[8] = {0};
+
+  graph_header_t gh = {};
+  gh.m = params_.m;
+  gh.ef_construction = params_.ef_construction;
+  gh.ef_search = params_.ef_search;
+  gh.seed = params_.seed;
+  gh.entry = entry_;
+  gh.max_level = uint32_t(max_level_);
+  gh.m0 = m0_;
+
+  writer.begin_section(section_graph);
+  writer.write(&gh, sizeof(gh));
+  writer.write(state_.data(), count_);
+  writer.write(zero, align8(count_) - count_);
+  writer.write(levels_.data(), count_);
+  writer.write(zero, align8(count_) - count_);
+  writer.write(tags_.data(), count_ * sizeof(uint32_t));
+  writer.write(zero, align8(count_ * sizeof(uint32_t)) - count_ * sizeof(uint32_t));
+  writer.write(links0_.data(), count_ * (m0_ + 1) * sizeof(uint32_t));
+  writer.write(zero, align8(count_ * (m0_ + 1) * sizeof(uint32_t)) - count_ * (m0_ + 1) * sizeof(uint32_t));
+
+  uint64_t offset = 0;
+  writer.write(&offset, sizeof(offset));
+  for (size_t n = 0; n < count_; n++) {
+    offset += upper_[n].size();
+    writer.write(&offset, sizeof(offset));
+  }
+  for (size_t n = 0; n < count_; n++) {
+    writer.write(upper_[n].data(), upper_[n].size() * sizeof(uint32_t));
+  }
+  writer.end_section();
+}
+
+bool
+HnswIndex::load_graph(const uint8_t *data, uint64_t bytes, std::string &error) {
+  error = "Corrupt index graph";
+
+  size_t n = count_;
+  size_t fixed = sizeof(graph_header_t) + align8(n) * 2 + align8(n * 4) + align8(n * (m0_ + 1) * 4) + (n + 1) * 8;
+  if (bytes < fixed) return false;
+
+  const uint8_t *p = data + sizeof(graph_header_t);
+  state_.assign(p, p + n);
+  p += align8(n);
+  levels_.assign(p, p + n);
+  p += align8(n);
+  tags_.resize(n);
+  std::memcpy(tags_.data(), p, n * 4);
+  p += align8(n * 4);
+  links0_.resize(n * (m0_ + 1));
+  std::memcpy(links0_.data(), p, n * (m0_ + 1) * 4);
+  p += align8(n * (m0_ + 1) * 4);
+
+  const uint8_t *offsets = p;
+  const uint8_t *upper = p + (n + 1) * 8;
+  uint64_t upper_words = (bytes - fixed) / 4;
+
+  upper_.resize(n);
+  uint64_t prev;
+  std::memcpy(&prev, offsets, 8);
+  if (prev != 0) return false;
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t end;
+    std::memcpy(&end, offsets + (i + 1) * 8, 8);
+    if (end < prev || end > upper_words) return false;
+    if (state_[i] > state_deleted || levels_[i] > max_level_cap) return false;
+    uint64_t words = state_[i] == state_free ? 0 : uint64_t(levels_[i]) * (params_.m + 1);
+    if (end - prev != words) return false;
+
+    upper_[i].resize(size_t(end - prev));
+    if (end > prev) std::memcpy(upper_[i].data(), upper + prev * 4, size_t(end - prev) * 4);
+    prev = end;
+  }
+
+  // The file's CRCs are only checked by verify(), so bound every link
+  // before the graph is walked
+  for (size_t i = 0; i < n; i++) {
+    if (state_[i] == state_free) continue;
+    for (int l = 0; l <= levels_[i]; l++) {
+      const uint32_t *list = links(uint32_t(i), l);
+      if (list[0] > max_links(l)) return false;
+      for (uint32_t j = 1; j <= list[0]; j++) {
+        if (list[j] >= n) return false;
+      }
+    }
+  }
+
+  if (entry_ != no_node && (entry_ >= n || state_[entry_] != state_live || levels_[entry_] != max_level_)) return false;
+
+  member_pos_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    if (state_[i] == state_free) {
+      free_.push_back(uint32_t(i));
+      continue;
+    }
+    if (state_[i] == state_deleted) {
+      pending_.push_back(uint32_t(i));
+      continue;
+    }
+    add_member(uint32_t(i), tags_[i]);
+    live_++;
+  }
+
+  error.clear();
+  return true;
+}
+
+void
+HnswIndex::attach_tables() {
+  const uint8_t *data = file_->data();
+  const index_section_info_t *s = file_header_.sections;
+  file_ids_ = StringTable(data + s[section_ids].offset, s[section_ids].bytes);
+  file_meta_ = StringTable(data + s[section_meta].offset, s[section_meta].bytes);
+  file_tags_ = StringTable(data + s[section_tags].offset, s[section_tags].bytes);
+}
+
+bool
+HnswIndex::save(const char *path, const std::vector<std::string_view> &ids, const std::vector<std::string_view> &metas, const std::vector<std::string_view> &tags, std::string &error) {
+  while (repair(count_ + 1) > 0) {
+  }
+
+#if defined(_WIN32)
+  // The file being replaced may be the one we have mapped
+  if (file_) {
+    uint8_t *old_base;
+    if (!file_->detach(&old_base, error)) return false;
+    rows_.rebase(old_base, file_->data());
+    attach_tables();
+  }
+#endif
+
+  IndexFileWriter writer;
+  if (!writer.begin(path, error)) return false;
+
+  writer.begin_section(section_matrix);
+  for (size_t c = 0; c * RowStore::chunk_rows < count_; c++) {
+    size_t rows = std::min(RowStore::chunk_rows, count_ - c * RowStore::chunk_rows);
+    writer.write(rows_.row(uint32_t(c * RowStore::chunk_rows)), rows * stride_ * sizeof(float));
+  }
+  writer.end_section();
+
+  auto id_at = [&](uint32_t i) {
+    return i < ids.size() && state_[i] == state_live ? ids[i] : std::string_view();
+  };
+  auto meta_at = [&](uint32_t i) {
+    if (state_[i] != state_live || i >= metas.size()) return std::string_view();
+    if (metas[i].data() == nullptr) return file_meta_.get(i);
+    return metas[i];
+  };
+
+  writer.write_strings(section_ids, uint32_t(count_), id_at);
+  writer.write_strings(section_meta, uint32_t(count_), meta_at);
+  writer.write_strings(section_tags, uint32_t(tags.size()), [&](uint32_t i) { return tags[i]; });
+  write_graph(writer);
+
+  index_header_t header;
+  header.kind = index_kind_hnsw;
+  header.dimension = uint32_t(dimension_);
+  header.stride = uint32_t(stride_);
+  header.count = uint32_t(count_);
+  return writer.finish(header, error);
+}
+
+std::unique_ptr<HnswIndex>
+HnswIndex::open(const char *path, std::string &error) {
+  auto file = std::make_unique<MappedFile>();
+  if (!file->open(path, error)) return nullptr;
+
+  index_header_t header;
+  if (!read_index_header(file->data(), file->size(), header, error)) return nullptr;
+
+  if (header.kind != index_kind_hnsw) {
+    error = "Index file is not an HNSW index";
+    return nullptr;
+  }
+
+  const index_section_info_t &graph = header.sections[section_graph];
+  if (header.dimension == 0 || header.stride != padded_dimension(header.dimension) || graph.bytes < sizeof(graph_header_t)) {
+    error = "Corrupt index header";
+    return nullptr;
+  }
+
+  graph_header_t gh;
+  std::memcpy(&gh, file->data() + graph.offset, sizeof(gh));
+  if (gh.m < 2 || gh.m0 != gh.m * 2 || gh.ef_construction == 0 || gh.ef_search == 0) {
+    error = "Corrupt index graph";
+    return nullptr;
+  }
+
+  hnsw_params_t params;
+  params.m = gh.m;
+  params.ef_construction = gh.ef_construction;
+  params.ef_search = gh.ef_search;
+  params.seed = gh.seed;
+
+  auto index = std::make_unique<HnswIndex>(header.dimension, params);
+  index->count_ = header.count;
+  index->entry_ = gh.entry;
+  index->max_level_ = gh.entry == no_node ? -1 : int(gh.max_level);
+
+  if (!index->load_graph(file->data() + graph.offset, graph.bytes, error)) return nullptr;
+
+  // Continue the level sequence instead of replaying the saved seed
+  index->rng_.seed(params.seed ^ header.count);
+
+  index->rows_.map(reinterpret_cast<float *>(file->data() + header.sections[section_matrix].offset), header.count);
+  index->file_rows_ = header.count;
+  index->file_header_ = header;
+  index->file_ = std::move(file);
+  index->attach_tables();
+
+  return index;
+}
+
+bool
+HnswIndex::verify(std::string &error) const {
+  if (!file_) return true;
+
+  index_header_t header = file_header_;
+  if (file_rows_written_) {
+    // Rows were overwritten through the private mapping; skip the matrix
+    header.sections[section_matrix] = index_section_info_t();
+  }
+
+  return verify_index_sections(file_->data(), header, error);
+}
+
+} // namespace bare_vector_index
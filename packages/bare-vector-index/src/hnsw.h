@@ -0,0 +1,237 @@
+/**
+ * HNSW approximate nearest-neighbour graph over cosine similarity.
+ *
+ * Nodes are identified by stable labels (slot numbers that are only reused
+ * after the node is fully unlinked). Deletes are tombstones: the node stays
+ * traversable but is never returned, and repair() walks the graph in bounded
+ * batches, patching every neighbour list that points at a tombstone with the
+ * tombstone's own live neighbours. Once a full pass has completed, the
+ * tombstones that existed when it started are freed for reuse.
+ *
+ * Each node carries a 32-bit tag (the JS side maps channel keys to tags) so
+ * searches can be restricted to one channel. Small tags are answered with an
+ * exact scan of their members; large ones with a filtered graph walk.
+ * Searches can also skip a SlotSet of labels (watched or excluded videos):
+ * like tombstones, excluded nodes are walked through but never returned,
+ * and the beam widens by the number excluded so k results still come back.
+ *
+ * save() writes the index_file.h format; open() maps it back with the
+ * matrix left in the mapping (paged in as the graph touches it) and only
+ * the adjacency copied out.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aligned.h"
+#include "index_file.h"
+#include "mapped_file.h"
+#include "row_store.h"
+#include "slot_set.h"
+#include "thread_pool.h"
+#include "topk.h"
+
+namespace bare_vector_index {
+
+struct hnsw_params_t {
+  // Max links per node on upper levels (level 0 keeps 2 * m)
+  uint32_t m = 16;
+  // Candidate list size while inserting
+  uint32_t ef_construction = 100;
+  // Default candidate list size while searching
+  uint32_t ef_search = 64;
+  uint32_t seed = 100;
+};
+
+constexpr int64_t hnsw_no_tag = -1;
+
+class HnswIndex {
+public:
+  HnswIndex(size_t dimension, const hnsw_params_t &params);
+
+  size_t dimension() const { return dimension_; }
+  const hnsw_params_t &params() const { return params_; }
+
+  // Live (searchable) nodes
+  size_t size() const { return live_; }
+
+  // Deleted nodes still waiting for repair
+  size_t tombstones() const { return pending_.size() + sweeping_.size(); }
+
+  // Slots ever allocated (live + tombstoned + free)
+  size_t slots() const { return count_; }
+
+  void reserve(size_t count);
+
+  // Insert a vector of `dimension()` floats; returns its label
+  uint32_t add(const float *vector, uint32_t tag);
+
+  // Tombstone `label`; false when it is not live
+  bool remove(uint32_t label);
+
+  // Repair up to `budget` nodes; returns the tombstones still outstanding
+  size_t repair(size_t budget);
+
+  bool live(uint32_t label) const { return label < count_ && state_[label] == state_live; }
+
+  uint32_t tag(uint32_t label) const { return tags_[label]; }
+
+  // Copy the stored (normalised) vector for `label` into `out`
+  void get(uint32_t label, float *out) const;
+
+  // Best `k` live nodes not in `exclude`, optionally restricted to `tag`,
+  // best first. `ef` of 0 uses params().ef_search.
+  const std::vector<hit_t> &search(const float *query, size_t k, size_t ef, int64_t tag, const SlotSet &exclude = SlotSet());
+
+  // Exact scan, for recall measurement
+  const std::vector<hit_t> &search_exact(const float *query, size_t k, int64_t tag, const SlotSet &exclude = SlotSet());
+
+  // search() (or search_exact() when `ef` is UINT32_MAX) fused with the
+  // BM25 scores of `text_hits` (TextIndex::score() over this index's
+  // labels; reordered in place) as described in hybrid.h
+  const std::vector<hit_t> &search_hybrid(const float *query, size_t k, size_t ef, int64_t tag, const SlotSet &exclude, std::vector<hit_t> &text_hits, float weight);
+
+  // Exact best `k` live nodes not in `exclude` for each of `count` queries
+  // (back to back, dimension() floats each), optionally restricted to
+  // `tag`: one blocked matrix product over the rows on `pool` instead of
+  // `count` graph walks. Results are packed per query as described in
+  // batch.h.
+  void search_batch(const float *queries, size_t count, size_t k, int64_t tag, const SlotSet &exclude, ThreadPool &pool, uint32_t *slots, float *scores, uint32_t *counts) const;
+
+  // Approximate heap footprint in bytes, and bytes served from a mapping
+  size_t memory_usage() const;
+  size_t mapped_bytes() const { return rows_.mapped_bytes(); }
+
+  void clear();
+
+  // Write the index to `path` (atomically). `ids` and `metas` are indexed
+  // by label; a meta entry with a null data() pointer is copied from the
+  // file this index was opened from. Outstanding tombstones are repaired
+  // first.
+  bool save(const char *path, const std::vector<std::string_view> &ids, const std::vector<std::string_view> &metas, const std::vector<std::string_view> &tags, std::string &error);
+
+  // Map an index written by save(); nullptr and `error` on failure
+  static std::unique_ptr<HnswIndex> open(const char *path, std::string &error);
+
+  // Check every section CRC of the opened file. The matrix is skipped once
+  // rows inside the mapping have been overwritten.
+  bool verify(std::string &error) const;
+
+  // String tables of the opened file (empty when not opened from a file)
+  const StringTable &file_ids() const { return file_ids_; }
+  const StringTable &file_meta() const { return file_meta_; }
+  const StringTable &file_tags() const { return file_tags_; }
+
+private:
+  enum : uint8_t {
+    state_free = 0,
+    state_live = 1,
+    state_deleted = 2,
+  };
+
+  static constexpr uint32_t no_node = UINT32_MAX;
+
+  // Tag members at or below this size are searched exactly
+  static constexpr size_t exact_tag_threshold = 4096;
+
+  typedef std::vector<hit_t> candidates_t;
+
+  const float *row(uint32_t node) const { return rows_.row(node); }
+  float *row(uint32_t node) { return rows_.row(node); }
+
+  float similarity(const float *q, uint32_t node) const;
+
+  uint32_t *links(uint32_t node, int level) {
+    return level == 0 ? &links0_[size_t(node) * (m0_ + 1)] : &upper_[node][size_t(level - 1) * (params_.m + 1)];
+  }
+
+  uint32_t max_links(int level) const { return level == 0 ? m0_ : params_.m; }
+
+  int random_level();
+
+  void store(float *dst, const float *vector) const;
+
+  void begin_visit();
+  bool visit(uint32_t node);
+
+  uint32_t greedy(const float *q, uint32_t entry, int from_level, int to_level);
+
+  // Best-first walk of one level. Results (worst-first heap in `results_`)
+  // only admit live nodes matching `tag` outside `exclude`; every node is
+  // traversable.
+  void search_level(const float *q, uint32_t entry, size_t ef, int level, int64_t tag, const SlotSet &exclude);
+
+  // Diversity heuristic: keep candidates closer to `base` than to any
+  // already kept neighbour. `candidates` must be sorted best-first.
+  void select_neighbors(candidates_t &candidates, size_t max, std::vector<uint32_t> &out);
+
+  void connect(uint32_t node, int level, uint32_t neighbor);
+
+  void repair_links(uint32_t node, int level);
+
+  void pick_entry();
+
+  void add_member(uint32_t node, uint32_t tag);
+  void remove_member(uint32_t node);
+
+  bool load_graph(const uint8_t *data, uint64_t bytes, std::string &error);
+  void write_graph(IndexFileWriter &writer) const;
+  void attach_tables();
+
+  size_t dimension_;
+  size_t stride_;
+  hnsw_params_t params_;
+  uint32_t m0_;
+  double level_mult_;
+  std::mt19937 rng_;
+
+  size_t count_ = 0;
+  size_t live_ = 0;
+  uint32_t entry_ = no_node;
+  int max_level_ = -1;
+
+  RowStore rows_;
+  std::vector<uint8_t> state_;
+  std::vector<uint8_t> levels_;
+  std::vector<uint32_t> tags_;
+  std::vector<uint32_t> links0_;
+  std::vector<std::vector<uint32_t>> upper_;
+  std::vector<uint32_t> free_;
+
+  // Per-tag member lists with each node's position for O(1) removal
+  std::vector<std::vector<uint32_t>> members_;
+  std::vector<uint32_t> member_pos_;
+
+  // Tombstones queued for the next pass / being cleared by the current one
+  std::vector<uint32_t> pending_;
+  std::vector<uint32_t> sweeping_;
+  size_t repair_cursor_ = 0;
+
+  std::vector<uint32_t> visited_;
+  uint32_t visit_mark_ = 0;
+
+  candidates_t candidates_;
+  candidates_t results_;
+  candidates_t scratch_;
+  std::vector<uint32_t> selected_;
+
+  AlignedBuffer<float> query_;
+  TopK topk_;
+
+  std::unique_ptr<MappedFile> file_;
+  index_header_t file_header_;
+  StringTable file_ids_;
+  StringTable file_meta_;
+  StringTable file_tags_;
+  size_t file_rows_ = 0;
+  bool file_rows_written_ = false;
+};
+
+} // namespace bare_vector_index
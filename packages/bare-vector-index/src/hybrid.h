@@ -0,0 +1,68 @@
+/**
+ * Score fusion for hybrid (vector + BM25) search.
+ *
+ *   fused = (1 - weight) * cosine + weight * bm25 / best bm25
+ *
+ * BM25 is scaled by the best score among the accepted text matches, so both
+ * terms lie in [0, 1] whatever the query. Candidates are the vector
+ * search's top k plus the text matches, each text match re-scored with one
+ * dot product. A document without a text match fuses to
+ * (1 - weight) * cosine, so it can only reach the top k if it is already
+ * among the vector hits. With every text match re-scored the fusion is
+ * exact over the vector hits it is given; approximate indexes cap the
+ * matches at the best hybrid_text_candidates by BM25 to bound the cost of
+ * very common terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "topk.h"
+
+namespace bare_vector_index {
+
+// Text matches re-scored per query by approximate (graph) searches
+constexpr size_t hybrid_text_candidates = 4096;
+
+// `similarity(slot)` is the cosine of the query against a slot and
+// `accept(slot)` applies the search filters to text matches (vector hits
+// are already filtered). At most `max_text` matches are re-scored.
+// `text_hits` is reordered in place.
+template <typename Similarity, typename Accept>
+const std::vector<hit_t> &
+fuse_hybrid(const std::vector<hit_t> &vector_hits, std::vector<hit_t> &text_hits, float weight, size_t k, size_t max_text, Similarity similarity, Accept accept, TopK &topk) {
+  text_hits.erase(std::remove_if(text_hits.begin(), text_hits.end(), [&](const hit_t &h) { return !accept(h.slot); }), text_hits.end());
+
+  auto better = [](const hit_t &a, const hit_t &b) { return a.score > b.score; };
+  if (text_hits.size() > max_text) {
+    std::nth_element(text_hits.begin(), text_hits.begin() + max_text, text_hits.end(), better);
+    text_hits.resize(max_text);
+  }
+
+  float best = 0;
+  for (const hit_t &h : text_hits) best = std::max(best, h.score);
+  float text_scale = best > 0 ? weight / best : 0;
+  float vector_scale = 1 - weight;
+
+  std::sort(text_hits.begin(), text_hits.end(), [](const hit_t &a, const hit_t &b) { return a.slot < b.slot; });
+  auto matched = [&](uint32_t slot) {
+    return std::binary_search(text_hits.begin(), text_hits.end(), hit_t{0, slot}, [](const hit_t &a, const hit_t &b) { return a.slot < b.slot; });
+  };
+
+  topk.reset(k);
+  for (const hit_t &h : vector_hits) {
+    if (!matched(h.slot)) topk.push(vector_scale * h.score, h.slot);
+  }
+  for (const hit_t &h : text_hits) {
+    float fused = vector_scale * similarity(h.slot) + text_scale * h.score;
+    if (fused > topk.threshold()) topk.push(fused, h.slot);
+  }
+
+  return topk.finish();
+}
+
+} // namespace bare_vector_index
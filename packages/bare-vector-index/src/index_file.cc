@@ -0,0 +1,324 @@
+#include "index_file.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bare_vector_index {
+
+namespace {
+
+const char magic[8] = {'B', 'V', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+// Header layout offsets
+constexpr size_t header_sections = 32;
+constexpr size_t header_section_size = 24;
+constexpr size_t header_crc = index_header_size - 4;
+
+struct crc_table_t {
+  uint32_t t[8][256];
+
+  crc_table_t() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+      t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int s = 1; s < 8; s++) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+    }
+  }
+};
+
+const crc_table_t crc_table;
+
+#if defined(_WIN32)
+std::wstring
+wide_path(const std::string &path) {
+  int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+  if (n <= 0) return std::wstring();
+  std::wstring out(size_t(n), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &out[0], n);
+  out.resize(size_t(n - 1));
+  return out;
+}
+#endif
+
+// Atomically replace `to` with `from`. Windows rename() fails when the
+// target exists, and removing it first leaves a window without an index.
+bool
+replace_file(const std::string &from, const std::string &to) {
+#if defined(_WIN32)
+  std::wstring wfrom = wide_path(from);
+  std::wstring wto = wide_path(to);
+  if (wfrom.empty() || wto.empty()) return false;
+  return MoveFileExW(wfrom.c_str(), wto.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// Make the rename itself durable: on POSIX the new directory entry only
+// survives power loss once the directory is fsynced. MOVEFILE_WRITE_THROUGH
+// covers this on Windows.
+bool
+sync_parent(const std::string &path) {
+#if defined(_WIN32)
+  (void) path;
+  return true;
+#else
+  size_t slash = path.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+
+  int fd = ::open(dir.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  // Some filesystems do not support fsync on directories
+  bool ok = fsync(fd) == 0 || errno == EINVAL;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+inline uint32_t
+load_u32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline uint64_t
+load_u64(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+inline void
+store_u32(uint8_t *p, uint32_t v) {
+  std::memcpy(p, &v, 4);
+}
+
+inline void
+store_u64(uint8_t *p, uint64_t v) {
+  std::memcpy(p, &v, 8);
+}
+
+} // namespace
+
+// Slicing-by-8 CRC-32C (Castagnoli)
+uint32_t
+crc32c(const void *data, size_t len, uint32_t crc) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  const auto &t = crc_table.t;
+  crc = ~crc;
+
+  while (len >= 8) {
+    uint32_t lo = load_u32(p) ^ crc;
+    uint32_t hi = load_u32(p + 4);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+
+  while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+  return ~crc;
+}
+
+bool
+read_index_header(const uint8_t *data, size_t size, index_header_t &header, std::string &error) {
+  if (size < index_header_size || std::memcmp(data, magic, sizeof(magic)) != 0) {
+    error = "Not an index file";
+    return false;
+  }
+
+  if (crc32c(data, header_crc) != load_u32(data + header_crc)) {
+    error = "Index header checksum mismatch";
+    return false;
+  }
+
+  header.version = load_u32(data + 8);
+  if (header.version != index_file_version) {
+    error = "Unsupported index file version";
+    return false;
+  }
+
+  header.kind = load_u32(data + 12);
+  header.dimension = load_u32(data + 16);
+  header.stride = load_u32(data + 20);
+  header.count = load_u32(data + 24);
+  header.flags = load_u32(data + 28);
+
+  for (uint32_t s = 0; s < section_slots; s++) {
+    const uint8_t *p = data + header_sections + s * header_section_size;
+    index_section_info_t &info = header.sections[s];
+    info.offset = load_u64(p);
+    info.bytes = load_u64(p + 8);
+    info.crc = load_u32(p + 16);
+
+    if (info.offset > size || info.bytes > size - info.offset || info.offset % index_section_align != 0) {
+      error = "Index section out of bounds";
+      return false;
+    }
+  }
+
+  if (header.sections[section_matrix].bytes != uint64_t(header.count) * header.stride * sizeof(float)) {
+    error = "Index matrix size mismatch";
+    return false;
+  }
+
+  return true;
+}
+
+bool
+verify_index_sections(const uint8_t *data, const index_header_t &header, std::string &error) {
+  for (uint32_t s = 0; s < section_slots; s++) {
+    const index_section_info_t &info = header.sections[s];
+    if (crc32c(data + info.offset, size_t(info.bytes)) != info.crc) {
+      error = "Index section checksum mismatch";
+      return false;
+    }
+  }
+  return true;
+}
+
+StringTable::StringTable(const uint8_t *data, uint64_t bytes) {
+  if (bytes < 16) return;
+
+  uint64_t n = load_u64(data);
+  if (n >= UINT32_MAX || (n + 2) * 8 > bytes) return;
+
+  const uint8_t *offsets = data + 8;
+  uint64_t payload = bytes - (n + 2) * 8;
+  if (load_u64(offsets) != 0 || load_u64(offsets + n * 8) > payload) return;
+
+  offsets_ = offsets;
+  bytes_ = offsets + (n + 1) * 8;
+  payload_ = payload;
+  count_ = uint32_t(n);
+  valid_ = true;
+}
+
+std::string_view
+StringTable::get(uint32_t i) const {
+  if (i >= count_) return std::string_view();
+  uint64_t start = load_u64(offsets_ + size_t(i) * 8);
+  uint64_t end = load_u64(offsets_ + size_t(i + 1) * 8);
+  if (end < start || end > payload_) return std::string_view();
+  return std::string_view(reinterpret_cast<const char *>(bytes_ + start), size_t(end - start));
+}
+
+IndexFileWriter::~IndexFileWriter() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    std::remove(tmp_.c_str());
+  }
+}
+
+bool
+IndexFileWriter::begin(const char *path, std::string &error) {
+  path_ = path;
+  tmp_ = path_ + ".tmp";
+  file_ = std::fopen(tmp_.c_str(), "wb");
+  if (file_ == nullptr) {
+    error = "Could not create index file";
+    return false;
+  }
+
+  uint8_t zero[index_header_size] = {0};
+  write(zero, sizeof(zero));
+  return true;
+}
+
+void
+IndexFileWriter::write(const void *data, size_t len) {
+  if (failed_ || len == 0) return;
+  if (std::fwrite(data, 1, len, file_) != len) failed_ = true;
+  sections_[section_].crc = crc32c(data, len, sections_[section_].crc);
+  offset_ += len;
+}
+
+void
+IndexFileWriter::pad() {
+  static const uint8_t zero[index_section_align] = {0};
+  size_t rem = size_t(offset_ % index_section_align);
+  if (rem == 0) return;
+
+  size_t len = index_section_align - rem;
+  if (std::fwrite(zero, 1, len, file_) != len) failed_ = true;
+  offset_ += len;
+}
+
+void
+IndexFileWriter::begin_section(index_section_t section) {
+  pad();
+  section_ = section;
+  sections_[section] = index_section_info_t();
+  sections_[section].offset = offset_;
+}
+
+void
+IndexFileWriter::end_section() {
+  sections_[section_].bytes = offset_ - sections_[section_].offset;
+}
+
+bool
+IndexFileWriter::finish(index_header_t &header, std::string &error) {
+  for (uint32_t s = 0; s < section_slots; s++) header.sections[s] = sections_[s];
+
+  uint8_t buf[index_header_size] = {0};
+  std::memcpy(buf, magic, sizeof(magic));
+  store_u32(buf + 8, header.version);
+  store_u32(buf + 12, header.kind);
+  store_u32(buf + 16, header.dimension);
+  store_u32(buf + 20, header.stride);
+  store_u32(buf + 24, header.count);
+  store_u32(buf + 28, header.flags);
+  for (uint32_t s = 0; s < section_slots; s++) {
+    uint8_t *p = buf + header_sections + s * header_section_size;
+    store_u64(p, header.sections[s].offset);
+    store_u64(p + 8, header.sections[s].bytes);
+    store_u32(p + 16, header.sections[s].crc);
+  }
+  store_u32(buf + header_crc, crc32c(buf, header_crc));
+
+  if (!failed_ && std::fseek(file_, 0, SEEK_SET) != 0) failed_ = true;
+  if (!failed_ && std::fwrite(buf, 1, sizeof(buf), file_) != sizeof(buf)) failed_ = true;
+  if (!failed_ && std::fflush(file_) != 0) failed_ = true;
+#if defined(_WIN32)
+  if (!failed_ && _commit(_fileno(file_)) != 0) failed_ = true;
+#else
+  if (!failed_ && fsync(fileno(file_)) != 0) failed_ = true;
+#endif
+
+  std::fclose(file_);
+  file_ = nullptr;
+
+  if (failed_) {
+    std::remove(tmp_.c_str());
+    error = "Failed writing index file";
+    return false;
+  }
+
+  if (!replace_file(tmp_, path_)) {
+    std::remove(tmp_.c_str());
+    error = "Failed replacing index file";
+    return false;
+  }
+
+  if (!sync_parent(path_)) {
+    error = "Failed syncing index directory";
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace bare_vector_index
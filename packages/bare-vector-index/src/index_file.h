@@ -0,0 +1,139 @@
+/**
+ * On-disk index format (version 1, little endian).
+ *
+ *   header   192 bytes: magic "BVINDEX\0", version, kind, dimension, stride,
+ *            slot count, flags, a table of six sections ({offset, bytes,
+ *            crc32c} each) and a CRC-32C over the header itself
+ *   matrix   slot count x stride floats, normalised, cache-line padded
+ *   ids      string table, one entry per slot (empty for free slots)
+ *   meta     string table, one JSON document per slot
+ *   tags     string table, tag number -> channel key
+ *   graph    index-specific structure (HNSW links)
+ *
+ * A string table is u64 n, u64 offsets[n + 1] relative to the end of the
+ * offset array, then the bytes. Every section starts on a 64-byte boundary
+ * so the matrix can be used straight from a mapping.
+ *
+ * Opening checks only the header (magic, version, CRC, section bounds);
+ * section CRCs are checked by verify() so a load stays O(1).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace bare_vector_index {
+
+constexpr uint32_t index_file_version = 1;
+constexpr size_t index_header_size = 192;
+constexpr size_t index_section_align = 64;
+
+enum index_kind_t : uint32_t {
+  index_kind_hnsw = 1,
+};
+
+enum index_section_t : uint32_t {
+  section_matrix = 0,
+  section_ids = 1,
+  section_meta = 2,
+  section_tags = 3,
+  section_graph = 4,
+  section_slots = 6,
+};
+
+struct index_section_info_t {
+  uint64_t offset = 0;
+  uint64_t bytes = 0;
+  uint32_t crc = 0;
+};
+
+struct index_header_t {
+  uint32_t version = index_file_version;
+  uint32_t kind = 0;
+  uint32_t dimension = 0;
+  uint32_t stride = 0;
+  uint32_t count = 0;
+  uint32_t flags = 0;
+  index_section_info_t sections[section_slots];
+};
+
+uint32_t
+crc32c(const void *data, size_t len, uint32_t crc = 0);
+
+// Validate and decode the header of a `size`-byte file
+bool
+read_index_header(const uint8_t *data, size_t size, index_header_t &header, std::string &error);
+
+// Check every section CRC
+bool
+verify_index_sections(const uint8_t *data, const index_header_t &header, std::string &error);
+
+// View of a string table section
+class StringTable {
+public:
+  StringTable() = default;
+  StringTable(const uint8_t *data, uint64_t bytes);
+
+  bool valid() const { return valid_; }
+  uint32_t size() const { return count_; }
+
+  std::string_view get(uint32_t i) const;
+
+private:
+  const uint8_t *offsets_ = nullptr;
+  const uint8_t *bytes_ = nullptr;
+  uint64_t payload_ = 0;
+  uint32_t count_ = 0;
+  bool valid_ = false;
+};
+
+// Streams sections to `<path>.tmp`, then fsyncs and renames over `path`,
+// fsyncing the directory so the rename is durable too
+class IndexFileWriter {
+public:
+  ~IndexFileWriter();
+
+  bool begin(const char *path, std::string &error);
+
+  void begin_section(index_section_t section);
+  void write(const void *data, size_t len);
+  void end_section();
+
+  // Write a string table from `count` entries produced by `get(i)`
+  template <typename Get>
+  void write_strings(index_section_t section, uint32_t count, Get get) {
+    begin_section(section);
+    uint64_t n = count;
+    write(&n, sizeof(n));
+    uint64_t offset = 0;
+    write(&offset, sizeof(offset));
+    for (uint32_t i = 0; i < count; i++) {
+      offset += get(i).size();
+      write(&offset, sizeof(offset));
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      std::string_view s = get(i);
+      write(s.data(), s.size());
+    }
+    end_section();
+  }
+
+  bool finish(index_header_t &header, std::string &error);
+
+private:
+  void pad();
+
+  FILE *file_ = nullptr;
+  std::string path_;
+  std::string tmp_;
+  uint64_t offset_ = 0;
+  bool failed_ = false;
+  index_section_t section_ = section_matrix;
+  index_section_info_t sections_[section_slots];
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,127 @@
+#include "mapped_file.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bare_vector_index {
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void
+MappedFile::close() {
+  if (heap_ != nullptr) {
+    std::free(heap_);
+    heap_ = nullptr;
+  } else if (data_ != nullptr) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    munmap(data_, size_);
+#endif
+  }
+
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool
+MappedFile::open(const char *path, std::string &error) {
+  close();
+
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    error = "Could not open index file";
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    error = "Index file is empty";
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    error = "Could not map index file";
+    return false;
+  }
+
+  void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if (data == NULL) {
+    CloseHandle(mapping);
+    error = "Could not map index file";
+    return false;
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<uint8_t *>(data);
+  size_ = size_t(size.QuadPart);
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    error = "Could not open index file";
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    error = "Index file is empty";
+    return false;
+  }
+
+  void *data = mmap(NULL, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error = "Could not map index file";
+    return false;
+  }
+
+  data_ = static_cast<uint8_t *>(data);
+  size_ = size_t(st.st_size);
+#endif
+
+  return true;
+}
+
+bool
+MappedFile::detach(uint8_t **old_base, std::string &error) {
+  *old_base = data_;
+  if (heap_ != nullptr || data_ == nullptr) return true;
+
+  // 64 bytes of slack so the copy keeps the mapping's cache-line alignment
+  void *heap = std::malloc(size_ + 64);
+  if (heap == nullptr) {
+    error = "Out of memory detaching index file";
+    return false;
+  }
+
+  uint8_t *copy = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(heap) + 63) & ~uintptr_t(63));
+  std::memcpy(copy, data_, size_);
+
+  size_t size = size_;
+  close();
+
+  heap_ = heap;
+  data_ = copy;
+  size_ = size;
+  return true;
+}
+
+} // namespace bare_vector_index
@@ -0,0 +1,46 @@
+/**
+ * Read-only file mapped copy-on-write.
+ *
+ * Pages are faulted in lazily on first touch; writes through the mapping go
+ * to private copies and never reach the file. detach() swaps the mapping
+ * for a heap copy so the file itself can be replaced (Windows refuses to
+ * rename over a mapped file).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bare_vector_index {
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile();
+
+  bool open(const char *path, std::string &error);
+
+  uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Replace the mapping with a heap copy at a new address; returns the old
+  // base so callers can rebase pointers into it
+  bool detach(uint8_t **old_base, std::string &error);
+
+private:
+  void close();
+
+  uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  void *heap_ = nullptr;
+#if defined(_WIN32)
+  void *mapping_ = nullptr;
+#endif
+};
+
+} // namespace bare_vector_index
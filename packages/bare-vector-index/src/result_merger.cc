@@ -0,0 +1,108 @@
+#include "result_merger.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bare_vector_index {
+
+uint32_t
+ResultMerger::add(const uint64_t *hashes, const float *scores, size_t count, size_t limit) {
+  size_t start = entries_.size();
+  for (size_t i = 0; i < count; i++) {
+    if (std::isnan(scores[i])) continue;
+    entries_.push_back({hashes[i], scores[i], uint32_t(i)});
+  }
+
+  // Sources normally arrive sorted; sorting anyway keeps a bad peer from
+  // breaking the merge order
+  auto begin = entries_.begin() + std::ptrdiff_t(start);
+  std::stable_sort(begin, entries_.end(), [](const entry_t &a, const entry_t &b) {
+    return a.score > b.score;
+  });
+  if (entries_.size() - start > limit) entries_.resize(start + limit);
+
+  offsets_.push_back(entries_.size());
+  return uint32_t(offsets_.size() - 2);
+}
+
+bool
+ResultMerger::mark(uint64_t hash) {
+  if (hash == 0) {
+    if (seen_zero_) return false;
+    seen_zero_ = true;
+    return true;
+  }
+
+  size_t mask = seen_.size() - 1;
+  // Fibonacci hashing spreads clustered ids over the table
+  size_t i = size_t((hash * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+  while (seen_[i] != 0) {
+    if (seen_[i] == hash) return false;
+    i = (i + 1) & mask;
+  }
+  seen_[i] = hash;
+  return true;
+}
+
+std::vector<merged_t> &
+ResultMerger::merge(size_t k) {
+  out_.clear();
+
+  size_t n = sources();
+  if (k == 0 || entries_.empty()) return out_;
+
+  // Room for every entry at under half load
+  size_t cells = 16;
+  while (cells < entries_.size() * 2) cells <<= 1;
+  seen_.assign(cells, 0);
+  seen_zero_ = false;
+
+  cursors_.assign(offsets_.begin(), offsets_.end() - 1);
+
+  // Max-heap of sources by head score; ties to the lower source
+  auto worse = [this](uint32_t a, uint32_t b) {
+    float sa = entries_[cursors_[a]].score;
+    float sb = entries_[cursors_[b]].score;
+    return sa < sb || (sa == sb && a > b);
+  };
+
+  heap_.clear();
+  for (uint32_t s = 0; s < n; s++) {
+    if (cursors_[s] < offsets_[s + 1]) heap_.push_back(s);
+  }
+  std::make_heap(heap_.begin(), heap_.end(), worse);
+
+  while (!heap_.empty() && out_.size() < k) {
+    std::pop_heap(heap_.begin(), heap_.end(), worse);
+    uint32_t s = heap_.back();
+    const entry_t &entry = entries_[cursors_[s]];
+
+    if (mark(entry.hash)) out_.push_back({entry.score, s, entry.position});
+
+    if (++cursors_[s] < offsets_[s + 1]) {
+      std::push_heap(heap_.begin(), heap_.end(), worse);
+    } else {
+      heap_.pop_back();
+    }
+  }
+
+  return out_;
+}
+
+void
+ResultMerger::clear() {
+  entries_.clear();
+  offsets_.assign(1, 0);
+}
+
+size_t
+ResultMerger::memory_usage() const {
+  return entries_.capacity() * sizeof(entry_t) +
+         offsets_.capacity() * sizeof(size_t) +
+         heap_.capacity() * sizeof(uint32_t) +
+         cursors_.capacity() * sizeof(size_t) +
+         seen_.capacity() * sizeof(uint64_t) +
+         out_.capacity() * sizeof(merged_t);
+}
+
+} // namespace bare_vector_index
@@ -0,0 +1,71 @@
+/**
+ * K-way merge of ranked result lists from several sources (the local index
+ * and each peer answering a federated search).
+ *
+ * A source is a list of (64-bit id hash, score) pairs, kept sorted
+ * best-first. merge() pops the best head across sources from a heap of
+ * cursors, skips hashes already emitted and stops after K distinct hits,
+ * so it costs O((K + duplicates) log sources) rather than a sort of every
+ * result. A duplicate keeps its best score; ties go to the earlier source,
+ * then the earlier position.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bare_vector_index {
+
+struct merged_t {
+  float score;
+  uint32_t source;
+  // Index in the source's list as added
+  uint32_t position;
+};
+
+class ResultMerger {
+public:
+  // Sources added
+  size_t sources() const { return offsets_.size() - 1; }
+
+  // Entries held across sources
+  size_t size() const { return entries_.size(); }
+
+  // Add a source's results (any order; NaN scores are dropped), keeping at
+  // most `limit` best; returns its source index
+  uint32_t add(const uint64_t *hashes, const float *scores, size_t count, size_t limit);
+
+  // Best `k` distinct hashes across sources, best-first; reused by the
+  // next call
+  std::vector<merged_t> &merge(size_t k);
+
+  void clear();
+
+  size_t memory_usage() const;
+
+private:
+  struct entry_t {
+    uint64_t hash;
+    float score;
+    uint32_t position;
+  };
+
+  // Insert into the emitted-hash table; false if already there
+  bool mark(uint64_t hash);
+
+  std::vector<entry_t> entries_;
+  // Source s holds entries_[offsets_[s], offsets_[s + 1])
+  std::vector<size_t> offsets_ = {0};
+
+  // Scratch for merge(): cursor heap, open-addressing hash table (0 marks an
+  // empty cell, so hash 0 is tracked by a flag) and the output
+  std::vector<uint32_t> heap_;
+  std::vector<size_t> cursors_;
+  std::vector<uint64_t> seen_;
+  bool seen_zero_ = false;
+  std::vector<merged_t> out_;
+};
+
+} // namespace bare_vector_index
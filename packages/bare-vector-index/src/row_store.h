@@ -0,0 +1,95 @@
+/**
+ * Float rows in fixed-size chunks.
+ *
+ * Chunks are either 64-byte aligned heap blocks or windows into a mapped
+ * index file, so a loaded index can keep its matrix on disk (paged in on
+ * first touch) while new rows go to heap chunks without copying the old
+ * ones.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "aligned.h"
+
+namespace bare_vector_index {
+
+class RowStore {
+public:
+  static constexpr size_t chunk_shift = 10;
+  static constexpr size_t chunk_rows = size_t(1) << chunk_shift;
+
+  explicit RowStore(size_t stride) : stride_(stride) {}
+
+  float *row(uint32_t r) const {
+    return chunks_[r >> chunk_shift] + size_t(r & (chunk_rows - 1)) * stride_;
+  }
+
+  size_t capacity() const { return chunks_.size() * chunk_rows; }
+
+  // Allocate zeroed heap chunks until `rows` rows fit
+  void ensure(size_t rows) {
+    while (capacity() < rows) {
+      auto chunk = std::make_unique<AlignedBuffer<float>>();
+      chunk->reserve(chunk_rows * stride_, 0);
+      chunks_.push_back(chunk->data());
+      owned_.push_back(std::move(chunk));
+    }
+  }
+
+  // Serve the first `rows` rows from `base` (64-byte aligned, not owned).
+  // A trailing partial chunk is copied to the heap so later rows in that
+  // chunk never write past the mapping.
+  void map(float *base, size_t rows) {
+    clear();
+
+    size_t full = rows >> chunk_shift;
+    for (size_t c = 0; c < full; c++) {
+      chunks_.push_back(base + c * chunk_rows * stride_);
+      owned_.emplace_back();
+    }
+
+    size_t tail = rows - full * chunk_rows;
+    if (tail > 0) {
+      ensure(capacity() + 1);
+      std::memcpy(chunks_.back(), base + full * chunk_rows * stride_, tail * stride_ * sizeof(float));
+    }
+  }
+
+  // The mapping moved (see MappedFile::detach); point mapped chunks at the
+  // same offsets in the new block
+  void rebase(const uint8_t *from, const uint8_t *to) {
+    for (size_t c = 0; c < chunks_.size(); c++) {
+      if (owned_[c]) continue;
+      const uint8_t *p = reinterpret_cast<const uint8_t *>(chunks_[c]);
+      chunks_[c] = reinterpret_cast<float *>(const_cast<uint8_t *>(to + (p - from)));
+    }
+  }
+
+  size_t heap_bytes() const {
+    size_t n = 0;
+    for (const auto &c : owned_) {
+      if (c) n += chunk_rows * stride_ * sizeof(float);
+    }
+    return n;
+  }
+
+  size_t mapped_bytes() const { return capacity() * stride_ * sizeof(float) - heap_bytes(); }
+
+  void clear() {
+    chunks_.clear();
+    owned_.clear();
+  }
+
+private:
+  size_t stride_;
+  std::vector<float *> chunks_;
+  std::vector<std::unique_ptr<AlignedBuffer<float>>> owned_;
+};
+
+} // namespace bare_vector_index
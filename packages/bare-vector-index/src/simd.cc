@@ -0,0 +1,277 @@
+#include "simd.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BARE_VECTOR_INDEX_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define BARE_VECTOR_INDEX_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace bare_vector_index {
+
+namespace {
+
+float
+dot_f32_scalar(const float *a, const float *b, size_t n) {
+  float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (size_t i = 0; i < n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+void
+dot_f32_x4_scalar(const float *q, size_t q_stride, const float *b, size_t n, float *out) {
+  for (size_t j = 0; j < 4; j++) out[j] = dot_f32_scalar(q + j * q_stride, b, n);
+}
+
+int32_t
+dot_i8_scalar(const int8_t *a, const int8_t *b, size_t n) {
+  int32_t s0 = 0, s1 = 0;
+  for (size_t i = 0; i < n; i += 2) {
+    s0 += int32_t(a[i]) * b[i];
+    s1 += int32_t(a[i + 1]) * b[i + 1];
+  }
+  return s0 + s1;
+}
+
+inline uint32_t
+popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return uint32_t(__builtin_popcountll(x));
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return uint32_t((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+uint32_t
+hamming_scalar(const uint64_t *a, const uint64_t *b, size_t words) {
+  uint32_t d = 0;
+  for (size_t i = 0; i < words; i++) d += popcount64(a[i] ^ b[i]);
+  return d;
+}
+
+#if defined(BARE_VECTOR_INDEX_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BARE_VECTOR_INDEX_AVX2 1
+
+__attribute__((target("avx2,fma"))) float
+dot_f32_avx2(const float *a, const float *b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_load_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_load_ps(a + i + 8), _mm256_load_ps(b + i + 8), acc1);
+  }
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 lo = _mm256_castps256_ps128(acc);
+  __m128 hi = _mm256_extractf128_ps(acc, 1);
+  __m128 sum = _mm_add_ps(lo, hi);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+// 4x1 register block: one row load feeds four FMA chains
+__attribute__((target("avx2,fma"))) void
+dot_f32_x4_avx2(const float *q, size_t q_stride, const float *b, size_t n, float *out) {
+  const float *q0 = q;
+  const float *q1 = q + q_stride;
+  const float *q2 = q + 2 * q_stride;
+  const float *q3 = q + 3 * q_stride;
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps();
+  __m256 acc3 = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 r = _mm256_load_ps(b + i);
+    acc0 = _mm256_fmadd_ps(_mm256_load_ps(q0 + i), r, acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_load_ps(q1 + i), r, acc1);
+    acc2 = _mm256_fmadd_ps(_mm256_load_ps(q2 + i), r, acc2);
+    acc3 = _mm256_fmadd_ps(_mm256_load_ps(q3 + i), r, acc3);
+  }
+  // Horizontal sums of all four accumulators at once
+  __m256 s01 = _mm256_hadd_ps(acc0, acc1);
+  __m256 s23 = _mm256_hadd_ps(acc2, acc3);
+  __m256 s = _mm256_hadd_ps(s01, s23);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+  _mm_storeu_ps(out, sum);
+}
+
+// Sign-extend to int16 and multiply-add pairs into int32 lanes: exact for
+// the full int8 range, no saturation
+__attribute__((target("avx2"))) int32_t
+dot_i8_avx2(const int8_t *a, const int8_t *b, size_t n) {
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  for (size_t i = 0; i < n; i += 32) {
+    __m256i a0 = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(a + i)));
+    __m256i b0 = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(b + i)));
+    __m256i a1 = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(a + i + 16)));
+    __m256i b1 = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(b + i + 16)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+  }
+  __m256i acc = _mm256_add_epi32(acc0, acc1);
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("popcnt"))) uint32_t
+hamming_popcnt(const uint64_t *a, const uint64_t *b, size_t words) {
+  uint64_t d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+  for (size_t i = 0; i < words; i += 4) {
+    d0 += __builtin_popcountll(a[i] ^ b[i]);
+    d1 += __builtin_popcountll(a[i + 1] ^ b[i + 1]);
+    d2 += __builtin_popcountll(a[i + 2] ^ b[i + 2]);
+    d3 += __builtin_popcountll(a[i + 3] ^ b[i + 3]);
+  }
+  return uint32_t(d0 + d1 + d2 + d3);
+}
+#endif
+
+#if defined(BARE_VECTOR_INDEX_NEON)
+float
+dot_f32_neon(const float *a, const float *b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  float32x4_t acc2 = vdupq_n_f32(0);
+  float32x4_t acc3 = vdupq_n_f32(0);
+  for (size_t i = 0; i < n; i += 16) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc2 = vfmaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+    acc3 = vfmaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+  }
+  return vaddvq_f32(vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+}
+
+void
+dot_f32_x4_neon(const float *q, size_t q_stride, const float *b, size_t n, float *out) {
+  const float *q0 = q;
+  const float *q1 = q + q_stride;
+  const float *q2 = q + 2 * q_stride;
+  const float *q3 = q + 3 * q_stride;
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  float32x4_t acc2 = vdupq_n_f32(0);
+  float32x4_t acc3 = vdupq_n_f32(0);
+  for (size_t i = 0; i < n; i += 4) {
+    float32x4_t r = vld1q_f32(b + i);
+    acc0 = vfmaq_f32(acc0, vld1q_f32(q0 + i), r);
+    acc1 = vfmaq_f32(acc1, vld1q_f32(q1 + i), r);
+    acc2 = vfmaq_f32(acc2, vld1q_f32(q2 + i), r);
+    acc3 = vfmaq_f32(acc3, vld1q_f32(q3 + i), r);
+  }
+  out[0] = vaddvq_f32(acc0);
+  out[1] = vaddvq_f32(acc1);
+  out[2] = vaddvq_f32(acc2);
+  out[3] = vaddvq_f32(acc3);
+}
+
+// Codes are clamped to [-127, 127], so two widening products still fit an
+// int16 lane before pairs are accumulated into int32
+int32_t
+dot_i8_neon(const int8_t *a, const int8_t *b, size_t n) {
+  int32x4_t acc0 = vdupq_n_s32(0);
+  int32x4_t acc1 = vdupq_n_s32(0);
+  for (size_t i = 0; i < n; i += 32) {
+    int8x16_t a0 = vld1q_s8(a + i), b0 = vld1q_s8(b + i);
+    int8x16_t a1 = vld1q_s8(a + i + 16), b1 = vld1q_s8(b + i + 16);
+    int16x8_t p0 = vmlal_s8(vmull_s8(vget_low_s8(a0), vget_low_s8(b0)), vget_high_s8(a0), vget_high_s8(b0));
+    int16x8_t p1 = vmlal_s8(vmull_s8(vget_low_s8(a1), vget_low_s8(b1)), vget_high_s8(a1), vget_high_s8(b1));
+    acc0 = vpadalq_s16(acc0, p0);
+    acc1 = vpadalq_s16(acc1, p1);
+  }
+  return vaddvq_s32(vaddq_s32(acc0, acc1));
+}
+
+uint32_t
+hamming_neon(const uint64_t *a, const uint64_t *b, size_t words) {
+  uint32x4_t acc = vdupq_n_u32(0);
+  const uint8_t *pa = reinterpret_cast<const uint8_t *>(a);
+  const uint8_t *pb = reinterpret_cast<const uint8_t *>(b);
+  for (size_t i = 0; i < words * 8; i += 64) {
+    uint8x16_t c0 = vcntq_u8(veorq_u8(vld1q_u8(pa + i), vld1q_u8(pb + i)));
+    uint8x16_t c1 = vcntq_u8(veorq_u8(vld1q_u8(pa + i + 16), vld1q_u8(pb + i + 16)));
+    uint8x16_t c2 = vcntq_u8(veorq_u8(vld1q_u8(pa + i + 32), vld1q_u8(pb + i + 32)));
+    uint8x16_t c3 = vcntq_u8(veorq_u8(vld1q_u8(pa + i + 48), vld1q_u8(pb + i + 48)));
+    uint16x8_t s = vaddq_u16(vpaddlq_u8(vaddq_u8(c0, c1)), vpaddlq_u8(vaddq_u8(c2, c3)));
+    acc = vpadalq_u16(acc, s);
+  }
+  return vaddvq_u32(acc);
+}
+#endif
+
+const char *kernel_name = "scalar";
+
+struct kernels_t {
+  dot_f32_fn dot_f32;
+  dot_f32_x4_fn dot_f32_x4;
+  dot_i8_fn dot_i8;
+  hamming_fn hamming;
+};
+
+kernels_t
+select_kernels() {
+#if defined(BARE_VECTOR_INDEX_NEON)
+  kernel_name = "neon";
+  return {dot_f32_neon, dot_f32_x4_neon, dot_i8_neon, hamming_neon};
+#elif defined(BARE_VECTOR_INDEX_AVX2)
+  __builtin_cpu_init();
+  kernels_t k = {dot_f32_scalar, dot_f32_x4_scalar, dot_i8_scalar, hamming_scalar};
+  if (__builtin_cpu_supports("popcnt")) k.hamming = hamming_popcnt;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernel_name = "avx2";
+    k.dot_f32 = dot_f32_avx2;
+    k.dot_f32_x4 = dot_f32_x4_avx2;
+    k.dot_i8 = dot_i8_avx2;
+  }
+  return k;
+#else
+  return {dot_f32_scalar, dot_f32_x4_scalar, dot_i8_scalar, hamming_scalar};
+#endif
+}
+
+const kernels_t kernels = select_kernels();
+
+} // namespace
+
+dot_f32_fn dot_f32 = kernels.dot_f32;
+dot_f32_x4_fn dot_f32_x4 = kernels.dot_f32_x4;
+dot_i8_fn dot_i8 = kernels.dot_i8;
+hamming_fn hamming = kernels.hamming;
+
+void
+normalize_f32(float *dst, const float *src, size_t dimension, size_t stride) {
+  double norm = 0;
+  for (size_t i = 0; i < dimension; i++) norm += double(src[i]) * src[i];
+
+  float scale = norm > 0 ? float(1.0 / std::sqrt(norm)) : 0.0f;
+  for (size_t i = 0; i < dimension; i++) dst[i] = src[i] * scale;
+  std::memset(dst + dimension, 0, (stride - dimension) * sizeof(float));
+}
+
+const char *
+simd_kernel_name() {
+  return kernel_name;
+}
+
+} // namespace bare_vector_index
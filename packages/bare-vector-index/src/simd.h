@@ -0,0 +1,67 @@
+/**
+ * SIMD distance kernels.
+ *
+ * Rows are padded to a whole cache line (16 floats, 64 int8 codes or 512
+ * sign bits), so kernels never need a scalar tail. x86 picks AVX2+FMA and
+ * POPCNT at runtime when the CPU has them (the addon itself is built for
+ * baseline x86-64); arm64 always has NEON.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bare_vector_index {
+
+// Floats per padded lane group (64 bytes)
+constexpr size_t simd_width = 16;
+
+inline size_t
+padded_dimension(size_t dimension) {
+  return (dimension + simd_width - 1) / simd_width * simd_width;
+}
+
+// int8 codes per row, padded to 64 bytes
+inline size_t
+padded_codes(size_t dimension) {
+  return (dimension + 63) / 64 * 64;
+}
+
+// 64-bit words per sign-bit row, padded to 64 bytes
+inline size_t
+padded_words(size_t dimension) {
+  return (dimension + 511) / 512 * 8;
+}
+
+typedef float (*dot_f32_fn)(const float *a, const float *b, size_t n);
+typedef int32_t (*dot_i8_fn)(const int8_t *a, const int8_t *b, size_t n);
+typedef uint32_t (*hamming_fn)(const uint64_t *a, const uint64_t *b, size_t words);
+typedef void (*dot_f32_x4_fn)(const float *q, size_t q_stride, const float *b, size_t n, float *out);
+
+// Dot product over `n` floats, `n` a multiple of 16, both pointers 64-byte
+// aligned.
+extern dot_f32_fn dot_f32;
+
+// Dot products of four queries (`q`, `q_stride` floats apart) against one
+// row `b`, into out[0..3]: the row is loaded once for all four. Same size
+// and alignment rules as dot_f32.
+extern dot_f32_x4_fn dot_f32_x4;
+
+// Dot product over `n` int8 codes, `n` a multiple of 64, both pointers
+// 64-byte aligned.
+extern dot_i8_fn dot_i8;
+
+// Differing bits over `words` 64-bit words, `words` a multiple of 8.
+extern hamming_fn hamming;
+
+// L2-normalise `dimension` floats from `src` into `dst` and zero the padding
+// up to `stride`. Zero vectors stay zero.
+void
+normalize_f32(float *dst, const float *src, size_t dimension, size_t stride);
+
+// Name of the kernel set picked at load time ("avx2", "neon" or "scalar").
+const char *
+simd_kernel_name();
+
+} // namespace bare_vector_index
@@ -0,0 +1,40 @@
+/**
+ * Read-only bitset over slots (flat index) or labels (HNSW), used as a
+ * search filter: a set bit excludes that slot from the results.
+ *
+ * The words are owned by the caller (a Uint32Array from JS), so building a
+ * filter costs nothing here and testing a slot is one load and a shift.
+ * Slots past the end of the words are not in the set.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bare_vector_index {
+
+class SlotSet {
+public:
+  SlotSet() = default;
+
+  SlotSet(const uint32_t *words, size_t word_count) : words_(words), bits_(word_count * 32) {
+    for (size_t i = 0; i < word_count; i++) count_ += size_t(__builtin_popcount(words[i]));
+  }
+
+  bool empty() const { return count_ == 0; }
+
+  // Slots in the set
+  size_t count() const { return count_; }
+
+  bool has(uint32_t slot) const {
+    return slot < bits_ && (words_[slot >> 5] >> (slot & 31)) & 1;
+  }
+
+private:
+  const uint32_t *words_ = nullptr;
+  size_t bits_ = 0;
+  size_t count_ = 0;
+};
+
+} // namespace bare_vector_index
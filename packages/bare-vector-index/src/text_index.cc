@@ -0,0 +1,208 @@
+#include "text_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bare_vector_index {
+
+namespace {
+
+bool
+is_word_byte(uint8_t c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+} // namespace
+
+uint32_t
+TextIndex::analyze(const char *text, size_t len, bool create) {
+  analyzed_.clear();
+  uint32_t tokens = 0;
+  size_t i = 0;
+
+  while (i < len) {
+    while (i < len && !is_word_byte(uint8_t(text[i]))) i++;
+    if (i == len) break;
+
+    token_.clear();
+    while (i < len && is_word_byte(uint8_t(text[i]))) {
+      char c = text[i++];
+      token_.push_back(c >= 'A' && c <= 'Z' ? char(c + 32) : c);
+    }
+    tokens++;
+
+    auto it = term_ids_.find(token_);
+    uint32_t term;
+    if (it != term_ids_.end()) {
+      term = it->second;
+    } else if (create) {
+      term = uint32_t(postings_.size());
+      term_ids_.emplace(token_, term);
+      postings_.emplace_back();
+    } else {
+      continue;
+    }
+
+    analyzed_.push_back({term, 1});
+  }
+
+  // Collapse repeats into (term, count); texts are short, so a sort beats
+  // a map here
+  std::sort(analyzed_.begin(), analyzed_.end(), [](const posting_t &a, const posting_t &b) { return a.slot < b.slot; });
+  size_t out = 0;
+  for (size_t j = 0; j < analyzed_.size(); j++) {
+    if (out > 0 && analyzed_[out - 1].slot == analyzed_[j].slot) {
+      analyzed_[out - 1].tf++;
+    } else {
+      analyzed_[out++] = analyzed_[j];
+    }
+  }
+  analyzed_.resize(out);
+
+  return tokens;
+}
+
+void
+TextIndex::unlink(uint32_t slot) {
+  document_t &doc = docs_[slot];
+  for (uint32_t term : doc.terms) {
+    std::vector<posting_t> &list = postings_[term];
+    for (size_t i = 0; i < list.size(); i++) {
+      if (list[i].slot == slot) {
+        list[i] = list.back();
+        list.pop_back();
+        break;
+      }
+    }
+  }
+
+  total_length_ -= lengths_[slot];
+  documents_--;
+  doc.terms.clear();
+  doc.live = false;
+  lengths_[slot] = 0;
+}
+
+void
+TextIndex::set(uint32_t slot, const char *text, size_t len) {
+  if (slot >= docs_.size()) {
+    docs_.resize(size_t(slot) + 1);
+    lengths_.resize(size_t(slot) + 1, 0);
+  }
+  if (docs_[slot].live) unlink(slot);
+
+  uint32_t length = analyze(text, len, true);
+
+  document_t &doc = docs_[slot];
+  doc.terms.reserve(analyzed_.size());
+  for (const posting_t &p : analyzed_) {
+    postings_[p.slot].push_back({slot, p.tf});
+    doc.terms.push_back(p.slot);
+  }
+  doc.live = true;
+  lengths_[slot] = length;
+
+  total_length_ += length;
+  documents_++;
+}
+
+void
+TextIndex::remove(uint32_t slot) {
+  if (slot < docs_.size() && docs_[slot].live) unlink(slot);
+}
+
+void
+TextIndex::move(uint32_t to, uint32_t from) {
+  remove(to);
+  if (from >= docs_.size() || !docs_[from].live) return;
+
+  for (uint32_t term : docs_[from].terms) {
+    for (posting_t &p : postings_[term]) {
+      if (p.slot == from) {
+        p.slot = to;
+        break;
+      }
+    }
+  }
+
+  if (to >= docs_.size()) {
+    docs_.resize(size_t(to) + 1);
+    lengths_.resize(size_t(to) + 1, 0);
+  }
+  docs_[to] = std::move(docs_[from]);
+  docs_[from] = document_t();
+  lengths_[to] = lengths_[from];
+  lengths_[from] = 0;
+}
+
+void
+TextIndex::clear() {
+  term_ids_.clear();
+  postings_.clear();
+  docs_.clear();
+  lengths_.clear();
+  documents_ = 0;
+  total_length_ = 0;
+  accumulator_.clear();
+}
+
+std::vector<hit_t> &
+TextIndex::score(const char *query, size_t len) {
+  hits_.clear();
+  if (documents_ == 0) return hits_;
+
+  analyze(query, len, false);
+  if (analyzed_.empty()) return hits_;
+
+  if (accumulator_.size() < docs_.size()) accumulator_.resize(docs_.size(), 0);
+  touched_.clear();
+
+  double n = double(documents_);
+  float k1 = params_.k1;
+  float b = params_.b;
+  float avg = float(double(total_length_) / n);
+  if (avg <= 0) avg = 1;
+
+  // tf * (k1 + 1) / (tf + k1 * (1 - b + b * len / avg)) with the
+  // per-query constants folded
+  float base = k1 * (1 - b);
+  float slope = k1 * b / avg;
+  const uint32_t *lengths = lengths_.data();
+  float *acc = accumulator_.data();
+
+  for (const posting_t &q : analyzed_) {
+    const std::vector<posting_t> &list = postings_[q.slot];
+    if (list.empty()) continue;
+
+    double df = double(list.size());
+    float idf = float(std::log(1.0 + (n - df + 0.5) / (df + 0.5)));
+
+    float scale = idf * (k1 + 1);
+
+    for (const posting_t &p : list) {
+      float tf = float(p.tf);
+      if (acc[p.slot] == 0) touched_.push_back(p.slot);
+      acc[p.slot] += scale * tf / (tf + base + slope * float(lengths[p.slot]));
+    }
+  }
+
+  hits_.reserve(touched_.size());
+  for (uint32_t slot : touched_) {
+    hits_.push_back({accumulator_[slot], slot});
+    accumulator_[slot] = 0;
+  }
+
+  return hits_;
+}
+
+size_t
+TextIndex::memory_usage() const {
+  size_t bytes = docs_.capacity() * sizeof(document_t) + lengths_.capacity() * sizeof(uint32_t);
+  for (const document_t &doc : docs_) bytes += doc.terms.capacity() * sizeof(uint32_t);
+  for (const auto &list : postings_) bytes += list.capacity() * sizeof(posting_t) + sizeof(list);
+  for (const auto &entry : term_ids_) bytes += entry.first.capacity() + sizeof(entry) + sizeof(void *);
+  bytes += accumulator_.capacity() * sizeof(float) + touched_.capacity() * sizeof(uint32_t);
+  return bytes;
+}
+
+} // namespace bare_vector_index
@@ -0,0 +1,99 @@
+/**
+ * BM25 inverted index over short texts (video titles and descriptions).
+ *
+ * Documents are keyed by the slot or label of the vector index they sit
+ * beside, so a hybrid search can fuse both scores per candidate without a
+ * lookup. Text is tokenised the way the feature-hashing embedder does it:
+ * runs of ASCII letters/digits and non-ASCII UTF-8 bytes, ASCII lowercased.
+ *
+ * Each term keeps a posting list of (slot, term frequency); each document
+ * keeps its distinct terms and length, so removing or moving a document
+ * touches only its own postings. Scoring walks the postings of the query
+ * terms into a dense accumulator and reports every matching document:
+ *
+ *   idf(t)   = ln(1 + (N - df + 0.5) / (df + 0.5))
+ *   score(d) = sum over query terms of
+ *              idf(t) * tf * (k1 + 1) / (tf + k1 * (1 - b + b * len / avglen))
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "topk.h"
+
+namespace bare_vector_index {
+
+struct bm25_params_t {
+  float k1 = 1.2f;
+  float b = 0.75f;
+};
+
+class TextIndex {
+public:
+  explicit TextIndex(const bm25_params_t &params = bm25_params_t()) : params_(params) {}
+
+  // Indexed documents
+  size_t size() const { return documents_; }
+
+  // Distinct terms seen (terms whose postings emptied are kept for reuse)
+  size_t terms() const { return postings_.size(); }
+
+  // Index `len` bytes of UTF-8 text under `slot`, replacing what was there
+  void set(uint32_t slot, const char *text, size_t len);
+
+  void remove(uint32_t slot);
+
+  // Re-key the document at `from` as `to` (the flat index moved a row);
+  // whatever was at `to` is dropped
+  void move(uint32_t to, uint32_t from);
+
+  void clear();
+
+  // BM25 score of every document matching at least one term of `query`,
+  // in no particular order. The returned vector is reused by the next call.
+  std::vector<hit_t> &score(const char *query, size_t len);
+
+  size_t memory_usage() const;
+
+private:
+  struct posting_t {
+    uint32_t slot;
+    uint32_t tf;
+  };
+
+  struct document_t {
+    std::vector<uint32_t> terms;
+    bool live = false;
+  };
+
+  // Distinct terms of a text (ids, created on demand when `create`) with
+  // their counts; returns the token count
+  uint32_t analyze(const char *text, size_t len, bool create);
+
+  void unlink(uint32_t slot);
+
+  bm25_params_t params_;
+
+  std::unordered_map<std::string, uint32_t> term_ids_;
+  std::vector<std::vector<posting_t>> postings_;
+  std::vector<document_t> docs_;
+  // Token count per slot, apart from docs_ so scoring reads 4 bytes a hit
+  std::vector<uint32_t> lengths_;
+  size_t documents_ = 0;
+  uint64_t total_length_ = 0;
+
+  // analyze() output as (term id, count) pairs, and its token scratch
+  std::vector<posting_t> analyzed_;
+  std::string token_;
+
+  std::vector<float> accumulator_;
+  std::vector<uint32_t> touched_;
+  std::vector<hit_t> hits_;
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,58 @@
+/**
+ * Fixed pool of worker threads for data-parallel loops.
+ *
+ * run() hands out task indices from a shared counter to the workers and the
+ * calling thread alike and returns once every task has finished, so it can
+ * be called synchronously from a JS callback. Only one run() is in flight
+ * at a time; the addon only calls it from the JS thread.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bare_vector_index {
+
+class ThreadPool {
+public:
+  // `threads` workers besides the caller; 0 runs everything inline
+  explicit ThreadPool(size_t threads);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool();
+
+  // Threads that take part in run(), the caller included
+  size_t concurrency() const { return workers_.size() + 1; }
+
+  // Call fn(i) for every i in [0, tasks); fn must not throw
+  void run(size_t tasks, const std::function<void(size_t)> &fn);
+
+  // Process-wide pool sized to the hardware, started on first use
+  static ThreadPool &shared();
+
+private:
+  void work();
+  void drain();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  bool stopping_ = false;
+  uint64_t generation_ = 0;
+  size_t active_ = 0;
+
+  const std::function<void(size_t)> *fn_ = nullptr;
+  size_t tasks_ = 0;
+  std::atomic<size_t> next_{0};
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,66 @@
+/**
+ * Fixed-capacity top-K collector.
+ *
+ * Keeps the K best (highest score) hits in a min-heap so each candidate costs
+ * one compare against the current worst; only hits that beat it touch the
+ * heap. Storage is reused across searches.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace bare_vector_index {
+
+struct hit_t {
+  float score;
+  uint32_t slot;
+};
+
+class TopK {
+public:
+  void reset(size_t k) {
+    k_ = k;
+    heap_.clear();
+    heap_.reserve(k);
+  }
+
+  size_t size() const { return heap_.size(); }
+
+  // Score a candidate must beat to enter; -inf until the heap is full
+  float threshold() const {
+    return heap_.size() < k_ ? -std::numeric_limits<float>::infinity() : heap_.front().score;
+  }
+
+  void push(float score, uint32_t slot) {
+    if (k_ == 0) return;
+    if (heap_.size() < k_) {
+      heap_.push_back({score, slot});
+      std::push_heap(heap_.begin(), heap_.end(), worse_first);
+    } else if (score > heap_.front().score) {
+      std::pop_heap(heap_.begin(), heap_.end(), worse_first);
+      heap_.back() = {score, slot};
+      std::push_heap(heap_.begin(), heap_.end(), worse_first);
+    }
+  }
+
+  // Sorted best-first; leaves the collector empty
+  std::vector<hit_t> &finish() {
+    std::sort_heap(heap_.begin(), heap_.end(), worse_first);
+    return heap_;
+  }
+
+private:
+  // Heap comparator: the root is the worst retained hit
+  static bool worse_first(const hit_t &a, const hit_t &b) {
+    return a.score > b.score || (a.score == b.score && a.slot < b.slot);
+  }
+
+  size_t k_ = 0;
+  std::vector<hit_t> heap_;
+};
+
+} // namespace bare_vector_index
@@ -0,0 +1,396 @@
+/**
+ * Simple test for bare-vector-index addon
+ * Checks native search against a plain JS cosine scan.
+ */
+
+const fs = require('bare-fs')
+const { VectorIndex, HnswIndex, CandidateTable, ResultMerger, simdKernel } = require('./index')
+
+function check(label, actual, expected) {
+  const a = JSON.stringify(actual)
+  const e = JSON.stringify(expected)
+  if (a !== e) throw new Error(`${label}: expected ${e}, got ${a}`)
+  console.log('ok -', label)
+}
+
+// Deterministic PRNG so failures reproduce
+function rng(seed) {
+  return () => {
+    seed = (seed * 1664525 + 1013904223) >>> 0
+    return seed / 0x100000000 - 0.5
+  }
+}
+
+function randomVector(next, dim) {
+  const v = new Float32Array(dim)
+  for (let i = 0; i < dim; i++) v[i] = next()
+  return v
+}
+
+function cosine(a, b) {
+  let dot = 0
+  let na = 0
+  let nb = 0
+  for (let i = 0; i < a.length; i++) {
+    dot += a[i] * b[i]
+    na += a[i] * a[i]
+    nb += b[i] * b[i]
+  }
+  const d = Math.sqrt(na) * Math.sqrt(nb)
+  return d === 0 ? 0 : dot / d
+}
+
+function bruteForce(vectors, query, k) {
+  return Array.from(vectors.entries())
+    .map(([id, v]) => ({ id, score: cosine(query, v) }))
+    .sort((a, b) => b.score - a.score)
+    .slice(0, k)
+    .map((r) => r.id)
+}
+
+console.log('kernel:', simdKernel())
+
+const dim = 37 // not a multiple of the SIMD width, exercises padding
+const next = rng(42)
+const index = new VectorIndex({ dimension: dim })
+const vectors = new Map()
+
+for (let i = 0; i < 500; i++) {
+  const v = randomVector(next, dim)
+  vectors.set('v' + i, v)
+  index.add('v' + i, v, { n: i })
+}
+check('size', index.size(), 500)
+
+const query = randomVector(next, dim)
+const hits = index.search(query, 10)
+check('top 10 matches brute force', hits.map((h) => h.id), bruteForce(vectors, query, 10))
+check('metadata follows id', hits[0].metadata.n, Number(hits[0].id.slice(1)))
+
+// Remove half; swapped slots must keep ids and metadata aligned
+for (let i = 0; i < 500; i += 2) {
+  index.remove('v' + i)
+  vectors.delete('v' + i)
+}
+check('size after remove', index.size(), 250)
+const afterRemove = index.search(query, 10)
+check('top 10 after remove', afterRemove.map((h) => h.id), bruteForce(vectors, query, 10))
+check('metadata after remove', afterRemove.every((h) => h.metadata.n === Number(h.id.slice(1))), true)
+
+// Re-adding an id replaces its vector in place
+index.add('v1', query, { n: 1 })
+check('replace keeps size', index.size(), 250)
+check('replaced vector ranks first', index.search(query, 1)[0].id, 'v1')
+
+// Zero vector scores 0, like the JS index
+const zero = new VectorIndex({ dimension: 4 })
+zero.add('z', [0, 0, 0, 0])
+check('zero vector', zero.search([1, 0, 0, 0], 5).map((h) => h.score), [0])
+
+// Round trip through serialize
+const copy = new VectorIndex()
+copy.deserialize(index.serialize())
+check('deserialize dimension', copy.dimension, dim)
+check('deserialize search', copy.search(query, 10).map((h) => h.id), index.search(query, 10).map((h) => h.id))
+
+check('dimension mismatch throws', (() => {
+  try {
+    index.search(new Float32Array(dim + 1))
+    return false
+  } catch {
+    return true
+  }
+})(), true)
+
+index.destroy()
+zero.destroy()
+copy.destroy()
+
+// Quantised modes: re-ranked results match the float scan, codes-only
+// results stay close. One sign bit per dimension is coarse at dim 37, so
+// the binary shortlist is allowed to miss a few.
+for (const [quantization, minHits] of [['int8', 9], ['binary', 7]]) {
+  const q = new VectorIndex({ dimension: dim, quantization })
+  const codesOnly = new VectorIndex({ dimension: dim, quantization, rerank: 0 })
+  for (const [id, v] of vectors) {
+    q.add(id, v)
+    codesOnly.add(id, v)
+  }
+
+  const exact = bruteForce(vectors, query, 10)
+  const reranked = q.search(query, 10).map((h) => h.id)
+  check(`${quantization} re-ranked recall@10 >= ${minHits / 10}`, reranked.filter((id) => exact.includes(id)).length >= minHits, true)
+  check(`${quantization} codes-only is smaller`, codesOnly.stats().bytesPerVector < q.stats().bytesPerVector, true)
+  check(`${quantization} remove keeps codes aligned`, (() => {
+    codesOnly.remove(exact[0])
+    return codesOnly.search(query, 10).every((h) => h.id !== exact[0] && vectors.has(h.id))
+  })(), true)
+
+  q.destroy()
+  codesOnly.destroy()
+}
+const int8 = new VectorIndex({ dimension: dim, quantization: 'int8', rerank: 0 })
+for (const [id, v] of vectors) int8.add(id, v)
+const int8Hits = int8.search(query, 10).map((h) => h.id)
+check('int8 codes-only recall@10 >= 0.8', int8Hits.filter((id) => bruteForce(vectors, query, 10).includes(id)).length >= 8, true)
+int8.destroy()
+
+// Batch ingest of base64 records: bad entries skipped, duplicates collapse,
+// known ids updated
+const encode = (v) => Buffer.from(v.buffer, v.byteOffset, v.byteLength).toString('base64')
+const ingestIds = Array.from(vectors.keys()).slice(0, 20)
+const ingestEncoded = ingestIds.map((id) => encode(vectors.get(id)))
+for (const Index of [VectorIndex, HnswIndex]) {
+  const batch = new Index({ dimension: dim })
+  batch.add(ingestIds[3], randomVector(next, dim), { channelKey: 'old' })
+  const added = batch.addEncoded(
+    [...ingestIds, 'short', 'junk', ingestIds[0]],
+    [...ingestEncoded, encode(new Float32Array(dim - 1)), 'not base64!', ingestEncoded[0]],
+    [...ingestIds.map((id) => ({ channelKey: 'c' + id })), {}, {}, { channelKey: 'again' }]
+  )
+  const name = Index.name
+  check(`${name} addEncoded skips bad entries`, batch.size(), 20)
+  check(`${name} addEncoded count`, added >= 20, true)
+  check(`${name} addEncoded matches add`, batch.search(query, 5, { exact: true }).map((r) => r.id), bruteForce(new Map(ingestIds.map((id) => [id, vectors.get(id)])), query, 5))
+  check(`${name} addEncoded updates known id`, batch.search(vectors.get(ingestIds[3]), 1)[0].metadata.channelKey, 'c' + ingestIds[3])
+  check(`${name} addEncoded keeps last duplicate`, batch.search(vectors.get(ingestIds[0]), 1)[0].metadata.channelKey, 'again')
+  batch.destroy()
+}
+
+// Batched search returns what one search per query would
+const batchQueries = Array.from({ length: 6 }, () => randomVector(next, dim))
+const batchFlat = new VectorIndex({ dimension: dim })
+for (const [id, v] of vectors) batchFlat.add(id, v)
+const batchHits = batchFlat.searchBatch(batchQueries, 10)
+check('searchBatch one result list per query', batchHits.length, batchQueries.length)
+check('searchBatch matches brute force', batchHits.map((hits) => hits.map((h) => h.id)), batchQueries.map((q) => bruteForce(vectors, q, 10)))
+check('searchBatch scores match search', batchHits[2].map((h) => h.score.toFixed(5)), batchFlat.search(batchQueries[2], 10).map((h) => h.score.toFixed(5)))
+check('searchBatch more than size', batchFlat.searchBatch([query], 1000)[0].length, vectors.size)
+check('searchBatch empty', batchFlat.searchBatch([], 10), [])
+batchFlat.destroy()
+
+// HNSW: recall against brute force, channel filter, tombstones + repair
+const hnsw = new HnswIndex({ dimension: dim, m: 8, efConstruction: 64 })
+const hnswVectors = new Map()
+for (let i = 0; i < 2000; i++) {
+  const v = randomVector(next, dim)
+  hnswVectors.set('h' + i, v)
+  hnsw.add('h' + i, v, { channelKey: 'c' + (i % 4) })
+}
+
+function recall(queries, filter) {
+  let hit = 0
+  let total = 0
+  for (const q of queries) {
+    const candidates = filter ? new Map(Array.from(hnswVectors).filter(([id]) => Number(id.slice(1)) % 4 === 1)) : hnswVectors
+    const exact = new Set(bruteForce(candidates, q, 10))
+    for (const r of hnsw.search(q, 10, filter ? { channelKey: 'c1', ef: 128 } : { ef: 128 })) {
+      if (exact.has(r.id)) hit++
+    }
+    total += exact.size
+  }
+  return hit / total
+}
+
+const queries = Array.from({ length: 20 }, () => randomVector(next, dim))
+check('hnsw recall@10 >= 0.9', recall(queries) >= 0.9, true)
+check('hnsw filtered results stay in channel', hnsw.search(queries[0], 10, { channelKey: 'c1' }).every((r) => r.metadata.channelKey === 'c1'), true)
+check('hnsw filtered recall@10 >= 0.9', recall(queries, true) >= 0.9, true)
+check('hnsw unknown channel', hnsw.search(queries[0], 10, { channelKey: 'nope' }), [])
+
+for (let i = 0; i < 2000; i += 3) {
+  hnsw.remove('h' + i)
+  hnswVectors.delete('h' + i)
+}
+check('hnsw deleted never returned', queries.every((q) => hnsw.search(q, 10).every((r) => hnswVectors.has(r.id))), true)
+hnsw.repair()
+check('hnsw repair clears tombstones', hnsw.stats().tombstones, 0)
+check('hnsw recall after repair >= 0.9', recall(queries) >= 0.9, true)
+
+check('hnsw searchBatch is exact', hnsw.searchBatch(queries.slice(0, 4), 10).map((hits) => hits.map((r) => r.id)), queries.slice(0, 4).map((q) => bruteForce(hnswVectors, q, 10)))
+check('hnsw searchBatch channel filter', hnsw.searchBatch(queries.slice(0, 4), 10, { channelKey: 'c1' }).every((hits) => hits.length === 10 && hits.every((r) => r.metadata.channelKey === 'c1')), true)
+
+// Freed slots are reused by later inserts
+const slotsBefore = hnsw.stats().slots
+for (let i = 0; i < 2000; i += 3) {
+  const v = randomVector(next, dim)
+  hnswVectors.set('h' + i, v)
+  hnsw.add('h' + i, v, { channelKey: 'c' + (i % 4) })
+}
+check('hnsw reuses freed slots', hnsw.stats().slots, slotsBefore)
+check('hnsw size', hnsw.size(), 2000)
+check('hnsw exact search', hnsw.search(queries[0], 10, { exact: true }).map((r) => r.id), bruteForce(hnswVectors, queries[0], 10))
+
+// Binary file round trip: same results, metadata decoded lazily
+const indexPath = __dirname + '/test-index.bvi'
+hnsw.remove('h1')
+hnsw.save(indexPath)
+const opened = HnswIndex.open(indexPath)
+check('hnsw open size', opened.size(), hnsw.size())
+check('hnsw open dimension', opened.dimension, dim)
+check('hnsw open same results', opened.search(queries[1], 10).map((r) => r.id), hnsw.search(queries[1], 10).map((r) => r.id))
+check('hnsw open metadata', opened.search(queries[2], 1, { channelKey: 'c2' })[0].metadata.channelKey, 'c2')
+opened.verify()
+check('hnsw open verifies', true, true)
+
+// Adds after open land beside the mapping; a re-save keeps undecoded metadata
+opened.add('extra', queries[3], { channelKey: 'c9' })
+opened.save(indexPath)
+opened.destroy()
+const reopened = HnswIndex.open(indexPath)
+check('hnsw reopen keeps new rows', reopened.search(queries[3], 1)[0].id, 'extra')
+check('hnsw reopen keeps metadata', reopened.search(queries[0], 1, { channelKey: 'c0' })[0].metadata.channelKey, 'c0')
+reopened.destroy()
+
+// A flipped byte in the vectors is caught by verify()
+const fd = fs.openSync(indexPath, 'r+')
+fs.writeSync(fd, Buffer.from([0x55]), 0, 1, 4096)
+fs.closeSync(fd)
+const corrupt = HnswIndex.open(indexPath)
+let verifyError = null
+try {
+  corrupt.verify()
+} catch (err) {
+  verifyError = err
+}
+check('hnsw verify detects corruption', verifyError !== null, true)
+corrupt.destroy()
+fs.unlinkSync(indexPath)
+
+// Delta log: changes survive a restart without a full save
+const logPath = __dirname + '/test-log-index.bvi'
+let logged = HnswIndex.load(logPath, { dimension: dim })
+for (let i = 0; i < 50; i++) logged.add('d' + i, hnswVectors.get('h' + (i * 3 + 1)), { channelKey: 'c' + (i % 2) })
+logged.remove('d7')
+const loggedTop = logged.search(queries[4], 5).map((r) => r.id)
+check('log records appends', logged.logStats().records, 51)
+logged.destroy()
+
+logged = HnswIndex.load(logPath, { dimension: dim })
+check('log replay size', logged.size(), 49)
+check('log replay results', logged.search(queries[4], 5).map((r) => r.id), loggedTop)
+check('log replay metadata', logged.search(queries[4], 1, { channelKey: 'c1' })[0].metadata.channelKey, 'c1')
+
+logged.compact()
+check('compact empties log', logged.logStats().records, 0)
+logged.add('late', queries[5], { channelKey: 'c0' })
+logged.destroy()
+
+// A record torn by a crash is dropped; everything before it is kept
+const logBytes = fs.readFileSync(logPath + '.log')
+fs.writeFileSync(logPath + '.log', logBytes.subarray(0, logBytes.length - 10))
+logged = HnswIndex.load(logPath, { dimension: dim })
+check('torn log keeps base', logged.size(), 49)
+check('torn log drops partial add', logged.has('late'), false)
+logged.destroy()
+fs.unlinkSync(logPath)
+fs.unlinkSync(logPath + '.log')
+
+// Exclusions are applied inside the search, so topK results still come back
+const top = bruteForce(hnswVectors, queries[6], 13)
+const excluded = new Set(top.slice(0, 3))
+check('hnsw exclude skips ids', hnsw.search(queries[6], 10, { exact: true, exclude: excluded }).map((r) => r.id), top.slice(3))
+check('hnsw graph exclude never returns them', hnsw.search(queries[6], 10, { exclude: excluded }).every((r) => !excluded.has(r.id)), true)
+check('hnsw searchBatch exclude', hnsw.searchBatch([queries[6]], 10, { exclude: excluded })[0].map((r) => r.id), top.slice(3))
+check('hnsw exclude unknown ids', hnsw.search(queries[6], 3, { exact: true, exclude: ['nope'] }).map((r) => r.id), top.slice(0, 3))
+
+hnsw.destroy()
+
+const flatExclude = new VectorIndex({ dimension: dim })
+for (const [id, v] of vectors) flatExclude.add(id, v)
+const flatTop = bruteForce(vectors, query, 12)
+check('flat exclude skips ids', flatExclude.search(query, 10, { exclude: flatTop.slice(0, 2) }).map((h) => h.id), flatTop.slice(2))
+check('flat searchBatch exclude', flatExclude.searchBatch([query], 10, { exclude: flatTop.slice(0, 2) })[0].map((h) => h.id), flatTop.slice(2))
+flatExclude.destroy()
+
+// Hybrid: BM25 over the text keys fused with cosine. A keyword-only match
+// overtakes the nearest vector as the text weight grows.
+const titles = ['piano lesson for beginners', 'jazz piano improvisation', 'pasta carbonara recipe', 'travel vlog japan', 'guitar chords', 'rust programming tutorial']
+function hybridIndex(Index) {
+  const hy = new Index({ dimension: dim, textKeys: ['title', 'description'] })
+  titles.forEach((title, i) => hy.add('t' + i, randomVector(next, dim), { title, description: i === 3 ? 'tokyo kyoto' : '' }))
+  return hy
+}
+for (const Index of [VectorIndex, HnswIndex]) {
+  const name = Index === VectorIndex ? 'flat' : 'hnsw'
+  const hy = hybridIndex(Index)
+  const q = randomVector(next, dim)
+  const nearest = hy.search(q, 1)[0].id
+  check(`${name} hybrid weight 0 is vector order`, hy.search(q, 1, { text: 'kyoto', textWeight: 0 })[0].id, nearest)
+  check(`${name} hybrid weight 1 is keyword order`, hy.search(q, 1, { text: 'kyoto', textWeight: 1 })[0].id, 't3')
+  check(`${name} hybrid best keyword match scores weight`, hy.search(q, 1, { text: 'Carbonara', textWeight: 1 })[0].score.toFixed(5), (1).toFixed(5))
+  check(`${name} hybrid respects exclude`, hy.search(q, 1, { text: 'kyoto', textWeight: 1, exclude: ['t3'] })[0].id !== 't3', true)
+  hy.remove('t0')
+  check(`${name} hybrid after remove`, hy.search(q, 2, { text: 'piano', textWeight: 1 }).map((h) => h.id)[0], 't1')
+  hy.destroy()
+}
+
+// Text of an opened index is rebuilt on the first hybrid search
+const hybridPath = __dirname + '/test-hybrid.bvi'
+const saved = hybridIndex(HnswIndex)
+saved.save(hybridPath)
+saved.destroy()
+const reloaded = HnswIndex.open(hybridPath, { textKeys: ['title', 'description'] })
+check('hybrid after open', reloaded.search(randomVector(next, dim), 1, { text: 'tokyo', textWeight: 1 })[0].id, 't3')
+reloaded.destroy()
+fs.unlinkSync(hybridPath)
+
+// Candidate table: each feature alone decides the order, reasons name the
+// dominant term, exclusions and removals are honoured
+const now = 1e12
+const day = 24 * 3600 * 1000
+const candidates = new CandidateTable()
+candidates.set('old', { createdAt: now - 60 * day, channelKey: 'a' })
+candidates.set('new', { createdAt: now - day, channelKey: 'a' })
+candidates.set('hit', { createdAt: now - 60 * day, channelKey: 'b' })
+candidates.set('near', { createdAt: now - 60 * day, channelKey: 'b' })
+check('candidates recency order', candidates.rank(2, { now }).map((r) => r.id + ':' + r.reason), ['new:recent', 'old:recent'])
+
+for (let i = 0; i < 30; i++) candidates.watch('hit', 1, 1)
+candidates.watch('unlisted', 50, 50)
+check('candidates popularity', candidates.rank(1, { now })[0].id + ':' + candidates.rank(1, { now })[0].reason, 'hit:popular')
+check('candidates watch-only rows are not offered', candidates.rank(10, { now }).some((r) => r.id === 'unlisted'), false)
+
+candidates.setSimilarity([['near', 0.95]])
+check('candidates similarity', candidates.rank(1, { now }).map((r) => r.id + ':' + r.reason), ['near:similar_content'])
+candidates.setSimilarity(new Map([['old', 0.9]]))
+check('candidates similarity replaced', candidates.rank(1, { now })[0].id, 'old')
+
+candidates.setSimilarity([])
+candidates.setAffinity([['a', 1]])
+const withAffinity = candidates.rank(4, { now })
+check('candidates affinity', withAffinity[0].id, 'hit')
+check('candidates affinity reason', withAffinity.find((r) => r.id === 'old').reason, 'channel_content')
+check('candidates exclude', candidates.rank(4, { now, exclude: ['hit', 'new'] }).map((r) => r.id).sort(), ['near', 'old'])
+
+candidates.remove('hit')
+check('candidates remove', candidates.rank(4, { now }).some((r) => r.id === 'hit'), false)
+candidates.set('hit', { createdAt: now - 60 * day, channelKey: 'b' })
+check('candidates keep watches across remove', candidates.rank(1, { now })[0].id, 'hit')
+check('candidates size', candidates.size(), 4)
+candidates.watch('hit', -30, -30)
+check('candidates retract watches', candidates.rank(1, { now })[0].id !== 'hit', true)
+candidates.destroy()
+
+// Result merger: k-way merge of ranked lists, duplicates at their best
+// score, unsorted and NaN input tolerated, per-source limits honoured
+const merger = new ResultMerger()
+const hashWords = (ids) => Uint32Array.from(ids.flatMap((id) => [id, id === 7 ? 1 : 0]))
+check('merger first source', merger.add(hashWords([1, 2, 3]), Float32Array.from([0.9, 0.5, 0.1])), 0)
+merger.add(hashWords([2, 4, 7]), Float32Array.from([0.3, 0.8, 0.6]))
+merger.add(hashWords([3, 5, 6]), Float32Array.from([0.7, NaN, 0.05]), 1)
+check('merger sources', merger.sources(), 3)
+check('merger order', merger.merge(10).map((r) => `${r.source}:${r.position}`), ['0:0', '1:1', '2:0', '1:2', '0:1'])
+check('merger top-k', merger.merge(2).map((r) => r.score.toFixed(1)), ['0.9', '0.8'])
+merger.add(Uint32Array.from([7, 0]), Float32Array.from([0.2]))
+check('merger 64-bit hashes', merger.merge(10).map((r) => r.source).includes(3), true)
+
+const peers = Array.from({ length: 20 }, (_, p) => Array.from({ length: 50 }, (_, i) => ({ id: (p * 7 + i * 13) % 400, score: Math.round(next() * 1e4) / 1e4 + 1 })))
+const best = new Map()
+for (const list of peers) for (const r of list) best.set(r.id, Math.max(best.get(r.id) ?? -Infinity, Math.fround(r.score)))
+merger.clear()
+for (const list of peers) merger.add(hashWords(list.map((r) => r.id)), Float32Array.from(list.map((r) => r.score)))
+check('merger matches sort', merger.merge(25).map((r) => r.score), [...best.values()].sort((a, b) => b - a).slice(0, 25))
+merger.destroy()
+
+console.log('Test complete!')
@@ -204,6 +204,8 @@ export const events = {
 export async function initPlatformRPC(config: {
   backendSource: string;
   downloaderWorkerSource?: string;
+  codecProbeWorkerSource?: string;
+  hlsLadderWorkerSource?: string;
   storagePath?: string;
 }): Promise<void> {
   if (_isInitialized && worklet) {
@@ -240,6 +242,24 @@ export async function initPlatformRPC(config: {
     throw new Error(`Failed to write downloader worker bundle: ${err?.message || err}`);
   }
 
+  // Optional: without it the backend skips the codec probe and keeps default codec order
+  if (config.codecProbeWorkerSource) {
+    try {
+      await FS.writeAsStringAsync(`file://${storageDir}codec-probe-worker.bundle.js`, config.codecProbeWorkerSource, { encoding });
+    } catch (err: any) {
+      console.warn('[Platform RPC] Failed to write codec probe worker bundle:', err?.message || err);
+    }
+  }
+
+  // Optional: without it uploads skip the multi-bitrate HLS ladder
+  if (config.hlsLadderWorkerSource) {
+    try {
+      await FS.writeAsStringAsync(`file://${storageDir}hls-ladder-worker.bundle.js`, config.hlsLadderWorkerSource, { encoding });
+    } catch (err: any) {
+      console.warn('[Platform RPC] Failed to write HLS ladder worker bundle:', err?.message || err);
+    }
+  }
+
   // Create worklet and HRPC client before starting to avoid missing early events.
   worklet = new WorkletClass();
   hrpc = new HRPCClass(worklet.IPC);
@@ -239,7 +239,8 @@ ns.register({
     { name: 'title', type: 'string', required: true },
     { name: 'description', type: 'string', required: false },
     { name: 'category', type: 'string', required: false },
-    { name: 'skipThumbnailGeneration', type: 'bool', required: false }
+    { name: 'skipThumbnailGeneration', type: 'bool', required: false },
+    { name: 'hlsLadder', type: 'bool', required: false }
   ]
 })
 